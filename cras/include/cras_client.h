@@ -475,6 +475,23 @@ int cras_client_reload_dsp(struct cras_client* client);
  */
 int cras_client_dump_dsp_info(struct cras_client* client);
 
+/* Asks the server to set an input control port of a dsp plugin, such as a
+ * gain of an eq, in all pipelines. Ports the running pipelines can follow
+ * change without a reload.
+ *
+ * Args:
+ *    client - The client from cras_client_create.
+ *    title - The title of the plugin in the dsp ini.
+ *    port - The index of the port in the plugin.
+ *    value - The new value.
+ * Returns:
+ *    0 on success, -EINVAL if the client isn't valid or isn't running.
+ */
+int cras_client_set_dsp_control(struct cras_client* client,
+                                const char* title,
+                                int port,
+                                float value);
+
 /* Asks the server to dump current audio thread information.
  *
  * Args:
@@ -496,6 +513,16 @@ int cras_client_update_audio_debug_info(struct cras_client* client,
 int cras_client_update_main_thread_debug_info(struct cras_client* client,
                                               void (*cb)(struct cras_client*));
 
+/* Asks the server to dump the profile of its dsp pipelines.
+ * Args:
+ *    client - The client from cras_client_create.
+ *    cb - A function to call when the data is received.
+ * Returns:
+ *    0 on success, -EINVAL if the client isn't valid or isn't running.
+ */
+int cras_client_update_dsp_debug_info(struct cras_client* client,
+                                      void (*cb)(struct cras_client*));
+
 /* Asks the server to dump bluetooth debug information.
  * Args:
  *    client - The client from cras_client_create.
@@ -930,6 +957,16 @@ const struct audio_debug_info* cras_client_get_audio_debug_info(
 const struct cras_bt_debug_info* cras_client_get_bt_debug_info(
     const struct cras_client* client);
 
+/* Gets the stats of the SCO socket I/O.
+ * Args:
+ *    client - The client from cras_client_create.
+ * Returns:
+ *    A pointer to the stats. They are updated along with the bluetooth debug
+ *    info by calling cras_client_update_bt_debug_info.
+ */
+const struct cras_sco_io_stats* cras_client_get_sco_io_stats(
+    const struct cras_client* client);
+
 /* Gets main thread debug info.
  * Args:
  *    client - The client from cras_client_create.
@@ -940,6 +977,16 @@ const struct cras_bt_debug_info* cras_client_get_bt_debug_info(
 const struct main_thread_debug_info* cras_client_get_main_thread_debug_info(
     const struct cras_client* client);
 
+/* Gets the profile of the dsp pipelines.
+ * Args:
+ *    client - The client from cras_client_create.
+ * Returns:
+ *    A pointer to the debug info. This info is updated and requested by
+ *    calling cras_client_update_dsp_debug_info.
+ */
+const struct cras_dsp_debug_info* cras_client_get_dsp_debug_info(
+    const struct cras_client* client);
+
 /* Gets audio thread snapshot buffer.
  *
  * Requires that the connection to the server has been established.
@@ -60,6 +60,8 @@ enum CRAS_SERVER_MESSAGE_ID {
   CRAS_SERVER_DUMP_MAIN,
   CRAS_SERVER_SET_AEC_REF,
   CRAS_SERVER_REQUEST_FLOOP,
+  CRAS_SERVER_DUMP_DSP_PROFILE,
+  CRAS_SERVER_SET_DSP_CONTROL,
 };
 
 enum CRAS_CLIENT_MESSAGE_ID {
@@ -322,6 +324,37 @@ static inline void cras_fill_dump_dsp_info(struct cras_dump_dsp_info* m) {
   m->header.length = sizeof(*m);
 }
 
+// Dump the profile of the dsp pipelines to shared memory with the client.
+struct __attribute__((__packed__)) cras_dump_dsp_profile {
+  struct cras_server_message header;
+};
+
+static inline void cras_fill_dump_dsp_profile(
+    struct cras_dump_dsp_profile* m) {
+  m->header.id = CRAS_SERVER_DUMP_DSP_PROFILE;
+  m->header.length = sizeof(*m);
+}
+
+// Set an input control port of a dsp plugin in all pipelines.
+struct __attribute__((__packed__)) cras_set_dsp_control {
+  struct cras_server_message header;
+  char title[CRAS_DSP_DEBUG_NAME_SIZE];
+  int32_t port;
+  float value;
+};
+
+static inline void cras_fill_set_dsp_control(struct cras_set_dsp_control* m,
+                                             const char* title,
+                                             int32_t port,
+                                             float value) {
+  m->header.id = CRAS_SERVER_SET_DSP_CONTROL;
+  m->header.length = sizeof(*m);
+  strncpy(m->title, title, CRAS_DSP_DEBUG_NAME_SIZE - 1);
+  m->title[CRAS_DSP_DEBUG_NAME_SIZE - 1] = '\0';
+  m->port = port;
+  m->value = value;
+}
+
 // Dump current audio thread information to syslog.
 struct __attribute__((__packed__)) cras_dump_audio_thread {
   struct cras_server_message header;
@@ -533,7 +566,9 @@ static inline void cras_fill_client_connected(struct cras_client_connected* m,
 
 /*
  * Reply from server that a stream has been successfully added.
- * Two file descriptors are added, input shm followed by out shm.
+ * Two file descriptors are added, input shm followed by out shm. Streams
+ * connected with EVENTFD_WAKEUPS get two more when the server supports it,
+ * the eventfd the server signals followed by the one the client signals.
  *
  * |samples_shm_size| is valid for normal streams, not client-provided
  * shm streams.
@@ -7,6 +7,7 @@
 #define CRAS_INCLUDE_CRAS_SHM_H_
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/mman.h>
 #include <sys/param.h>
@@ -72,8 +73,35 @@ struct __attribute__((__packed__)) cras_audio_shm_header {
   // Only applies to output streams, always 0 for input streams.
   // The value is cumulative.
   struct cras_timespec underrun_duration;
+  // For streams with EVENTFD_WAKEUPS, the frames requested from the client
+  // for playback, or the frames ready for the client to capture.
+  uint32_t wakeup_frames;
+  // For streams with EVENTFD_WAKEUPS, the error of the last reply from the
+  // client, 0 on success.
+  int32_t reply_error;
+  // Non-zero when the samples area is a single ring of this many frames
+  // (a power of 2) instead of CRAS_NUM_SHM_BUFFERS buffers. Set by the server
+  // for SHM_RING_BUFFER streams. Servers without ring support never write it
+  // and clients read it as 0 from the zero filled header page.
+  uint32_t ring_frames;
+  // Total frames read from the ring. Only advanced by the reader. Accessed
+  // with cras_shm_ring_load/store only.
+  uint64_t ring_read_frames __attribute__((aligned(8)));
+  // Total frames written to the ring. Only advanced by the writer. Accessed
+  // with cras_shm_ring_load/store only.
+  uint64_t ring_write_frames __attribute__((aligned(8)));
 };
 
+/* The ring counters are 64 bit atomics shared with the other process. Keep
+ * them naturally aligned, the header itself starts on a page, so that 32 bit
+ * targets don't tear them. */
+static_assert(offsetof(struct cras_audio_shm_header, ring_read_frames) % 8 ==
+                  0,
+              "ring_read_frames must be 8 byte aligned");
+static_assert(offsetof(struct cras_audio_shm_header, ring_write_frames) % 8 ==
+                  0,
+              "ring_write_frames must be 8 byte aligned");
+
 // Returns the number of bytes needed to hold a cras_audio_shm_header.
 static inline uint32_t cras_shm_header_size() {
   return sizeof(struct cras_audio_shm_header);
@@ -140,6 +168,9 @@ struct cras_audio_shm {
   struct cras_shm_info samples_info;
   // Shm region containing audio data.
   uint8_t* samples;
+  // Frames in the sample ring, 0 for the double buffer layout. Kept separate
+  // from the header so it can be checked.
+  uint32_t ring_frames;
 };
 
 /* Sets up a cras_audio_shm given info about the shared memory to use
@@ -170,6 +201,64 @@ int cras_audio_shm_create(struct cras_shm_info* header_info,
  */
 void cras_audio_shm_destroy(struct cras_audio_shm* shm);
 
+/* Loads a ring counter written by the other side. The acquire pairs with the
+ * release in cras_shm_ring_store, so the samples the writer published, or
+ * the space the reader handed back, are visible once the count is. */
+static inline uint64_t cras_shm_ring_load(const uint64_t* counter) {
+  return __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+}
+
+/* Publishes a ring counter after the samples it covers were written, or
+ * read. */
+static inline void cras_shm_ring_store(uint64_t* counter, uint64_t frames) {
+  __atomic_store_n(counter, frames, __ATOMIC_RELEASE);
+}
+
+// Returns non-zero if the samples area is used as a ring.
+static inline int cras_shm_is_ring(const struct cras_audio_shm* shm) {
+  return shm->ring_frames != 0;
+}
+
+/* Gets the number of frames queued in the ring. Capped at the ring size in
+ * case the other side wrote garbage counters. */
+static inline uint32_t cras_shm_ring_queued(const struct cras_audio_shm* shm) {
+  uint64_t read_frames = cras_shm_ring_load(&shm->header->ring_read_frames);
+  uint64_t write_frames =
+      cras_shm_ring_load(&shm->header->ring_write_frames);
+
+  if (write_frames <= read_frames) {
+    return 0;
+  }
+  return MIN(write_frames - read_frames, shm->ring_frames);
+}
+
+/* Gets the number of frames that can be written to the ring. A ring takes
+ * writes until it holds used_size bytes. */
+static inline uint32_t cras_shm_ring_writeable(
+    const struct cras_audio_shm* shm) {
+  uint32_t depth = shm->config.used_size / shm->config.frame_bytes;
+  uint32_t queued = cras_shm_ring_queued(shm);
+
+  return (depth > queued) ? depth - queued : 0;
+}
+
+// Gets a pointer to the frame at ring position "pos".
+static inline uint8_t* cras_shm_ring_ptr(const struct cras_audio_shm* shm,
+                                         uint64_t pos) {
+  uint32_t idx = pos & (shm->ring_frames - 1);
+
+  return shm->samples + idx * shm->config.frame_bytes;
+}
+
+/* Gets the number of frames that can be written to the ring at the write
+ * position before it wraps. */
+static inline uint32_t cras_shm_ring_frames_to_wrap(
+    const struct cras_audio_shm* shm) {
+  uint64_t pos = cras_shm_ring_load(&shm->header->ring_write_frames);
+
+  return shm->ring_frames - (pos & (shm->ring_frames - 1));
+}
+
 // Limit a buffer offset to within the samples area size.
 static inline unsigned cras_shm_get_checked_buffer_offset(
     const struct cras_audio_shm* shm,
@@ -256,6 +345,11 @@ static inline uint8_t* cras_shm_get_write_buffer_base(
     const struct cras_audio_shm* shm) {
   unsigned i = shm->header->write_buf_idx & CRAS_SHM_BUFFERS_MASK;
 
+  if (cras_shm_is_ring(shm)) {
+    return cras_shm_ring_ptr(
+        shm, cras_shm_ring_load(&shm->header->ring_write_frames));
+  }
+
   return cras_shm_buff_for_idx(shm, i);
 }
 
@@ -295,6 +389,20 @@ static inline uint8_t* cras_shm_get_readable_frames(
 
   assert(frames != NULL);
 
+  if (cras_shm_is_ring(shm)) {
+    uint32_t queued = cras_shm_ring_queued(shm);
+    uint64_t pos =
+        cras_shm_ring_load(&shm->header->ring_read_frames) + offset;
+
+    if (offset >= queued) {
+      *frames = 0;
+      return NULL;
+    }
+    *frames = MIN(queued - offset,
+                  shm->ring_frames - (pos & (shm->ring_frames - 1)));
+    return cras_shm_ring_ptr(shm, pos);
+  }
+
   read_offset = cras_shm_get_checked_read_offset(shm, buf_idx);
   write_offset = cras_shm_get_checked_write_offset(shm, buf_idx);
   final_offset = read_offset + offset * shm->config.frame_bytes;
@@ -319,6 +427,10 @@ static inline size_t cras_shm_get_bytes_queued(
   size_t total, i;
   const unsigned used_size = shm->config.used_size;
 
+  if (cras_shm_is_ring(shm)) {
+    return (size_t)cras_shm_ring_queued(shm) * shm->config.frame_bytes;
+  }
+
   total = 0;
   for (i = 0; i < CRAS_NUM_SHM_BUFFERS; i++) {
     unsigned read_offset, write_offset;
@@ -351,6 +463,10 @@ static inline size_t cras_shm_get_frames_in_curr_buffer(
   unsigned read_offset, write_offset;
   const unsigned used_size = shm->config.used_size;
 
+  if (cras_shm_is_ring(shm)) {
+    return cras_shm_ring_queued(shm);
+  }
+
   read_offset = MIN(shm->header->read_offset[buf_idx], used_size);
   write_offset = MIN(shm->header->write_offset[buf_idx], used_size);
 
@@ -361,17 +477,25 @@ static inline size_t cras_shm_get_frames_in_curr_buffer(
   return (write_offset - read_offset) / shm->config.frame_bytes;
 }
 
-// Return 1 if there is an empty buffer in the list.
+// Return 1 if there is an empty buffer in the list, or room in the ring.
 static inline int cras_shm_is_buffer_available(
     const struct cras_audio_shm* shm) {
   size_t buf_idx = shm->header->write_buf_idx & CRAS_SHM_BUFFERS_MASK;
 
+  if (cras_shm_is_ring(shm)) {
+    return cras_shm_ring_writeable(shm) > 0;
+  }
+
   return (shm->header->write_offset[buf_idx] == 0);
 }
 
 // How many are available to be written?
 static inline size_t cras_shm_get_num_writeable(
     const struct cras_audio_shm* shm) {
+  if (cras_shm_is_ring(shm)) {
+    return cras_shm_ring_writeable(shm);
+  }
+
   // Not allowed to write to a buffer twice.
   if (!cras_shm_is_buffer_available(shm)) {
     return 0;
@@ -428,6 +552,11 @@ static inline unsigned int cras_shm_frames_written(
 static inline void cras_shm_buffer_write_complete(struct cras_audio_shm* shm) {
   size_t buf_idx = shm->header->write_buf_idx & CRAS_SHM_BUFFERS_MASK;
 
+  // Ring writes are published as they are counted.
+  if (cras_shm_is_ring(shm)) {
+    return;
+  }
+
   shm->header->write_in_progress[buf_idx] = 0;
 
   assert_on_compile_is_power_of_2(CRAS_NUM_SHM_BUFFERS);
@@ -435,11 +564,21 @@ static inline void cras_shm_buffer_write_complete(struct cras_audio_shm* shm) {
   shm->header->write_buf_idx = buf_idx;
 }
 
-// Set the write pointer for the current buffer and complete the write.
+/* Set the write pointer for the current buffer and complete the write. For a
+ * ring, publishes "frames" more frames at the write position. */
 static inline void cras_shm_buffer_written_start(struct cras_audio_shm* shm,
                                                  size_t frames) {
   size_t buf_idx = shm->header->write_buf_idx & CRAS_SHM_BUFFERS_MASK;
 
+  if (cras_shm_is_ring(shm)) {
+    uint64_t* write_frames = &shm->header->ring_write_frames;
+
+    // Only the writer advances it, the release publishes the samples.
+    cras_shm_ring_store(write_frames,
+                        cras_shm_ring_load(write_frames) + frames);
+    return;
+  }
+
   shm->header->write_offset[buf_idx] = frames * shm->config.frame_bytes;
   shm->header->read_offset[buf_idx] = 0;
   cras_shm_buffer_write_complete(shm);
@@ -458,6 +597,16 @@ static inline void cras_shm_buffer_read(struct cras_audio_shm* shm,
     return;
   }
 
+  if (cras_shm_is_ring(shm)) {
+    uint64_t* read_frames = &header->ring_read_frames;
+
+    frames = MIN(frames, cras_shm_ring_queued(shm));
+    // The release hands the space back after the samples were read.
+    cras_shm_ring_store(read_frames,
+                        cras_shm_ring_load(read_frames) + frames);
+    return;
+  }
+
   header->read_offset[buf_idx] += frames * config->frame_bytes;
   if (header->read_offset[buf_idx] >= header->write_offset[buf_idx]) {
     remainder = header->read_offset[buf_idx] - header->write_offset[buf_idx];
@@ -542,6 +691,30 @@ static inline int cras_shm_callback_pending(const struct cras_audio_shm* shm) {
   return shm->header->callback_pending;
 }
 
+// Sets the frames carried by the next eventfd wakeup to the client.
+static inline void cras_shm_set_wakeup_frames(struct cras_audio_shm* shm,
+                                              uint32_t frames) {
+  shm->header->wakeup_frames = frames;
+}
+
+// Gets the frames carried by the last eventfd wakeup from the server.
+static inline uint32_t cras_shm_get_wakeup_frames(
+    const struct cras_audio_shm* shm) {
+  return shm->header->wakeup_frames;
+}
+
+// Sets the error carried by the next eventfd reply to the server.
+static inline void cras_shm_set_reply_error(struct cras_audio_shm* shm,
+                                            int32_t error) {
+  shm->header->reply_error = error;
+}
+
+// Gets the error carried by the last eventfd reply from the client.
+static inline int32_t cras_shm_get_reply_error(
+    const struct cras_audio_shm* shm) {
+  return shm->header->reply_error;
+}
+
 // Sets the starting offset of a buffer
 static inline void cras_shm_set_buffer_offset(struct cras_audio_shm* shm,
                                               uint32_t buf_idx,
@@ -583,6 +756,16 @@ static inline uint64_t cras_shm_samples_size(const struct cras_audio_shm* shm) {
   return shm->samples_info.length;
 }
 
+/* Makes the samples area a ring of "ring_frames" frames, a power of 2 that
+ * must fit in the samples area. Pass 0 for the double buffer layout. */
+static inline void cras_shm_set_ring_frames(struct cras_audio_shm* shm,
+                                            uint32_t ring_frames) {
+  shm->ring_frames = ring_frames;
+  shm->header->ring_frames = ring_frames;
+  cras_shm_ring_store(&shm->header->ring_read_frames, 0);
+  cras_shm_ring_store(&shm->header->ring_write_frames, 0);
+}
+
 // Gets the counter of over-runs.
 static inline unsigned cras_shm_num_overruns(const struct cras_audio_shm* shm) {
   return shm->header->num_overruns;
@@ -598,7 +781,18 @@ static inline unsigned cras_shm_overrun_frames(
  * when initially setting up the region.
  */
 static inline void cras_shm_copy_shared_config(struct cras_audio_shm* shm) {
+  uint32_t ring_frames = shm->header->ring_frames;
+
   memcpy(&shm->config, &shm->header->config, sizeof(shm->config));
+
+  // Only take a ring that fits in the mapped samples area.
+  shm->ring_frames = 0;
+  if (ring_frames && (ring_frames & (ring_frames - 1)) == 0 &&
+      (uint64_t)ring_frames * shm->config.frame_bytes <=
+          shm->samples_info.length &&
+      shm->config.used_size <= ring_frames * shm->config.frame_bytes) {
+    shm->ring_frames = ring_frames;
+  }
 }
 
 /* Update the duration of dropped data due to too many samples in the
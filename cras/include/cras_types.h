@@ -114,6 +114,16 @@ enum CRAS_INPUT_STREAM_FLAG {
   // This stream doesn't associate to a client. It's used mainly
   // for audio data to flow from hardware through iodev's dsp pipeline.
   SERVER_ONLY = 0x08,
+  // Signal audio requests and replies through a pair of eventfds passed
+  // back with CRAS_CLIENT_STREAM_CONNECTED, with the frame counts kept in
+  // the shm header, instead of audio_message on the audio socket. Servers
+  // that do not support it reply with only the two shm fds.
+  EVENTFD_WAKEUPS = 0x10,
+  // Use the samples shm as a ring holding up to buffer_frames, instead of
+  // two buffers of buffer_frames each, so the client can queue more than two
+  // callbacks ahead. Output streams only, others keep the double buffer.
+  // The server reports the ring in cras_audio_shm_header.ring_frames.
+  SHM_RING_BUFFER = 0x20,
 };
 
 /*
@@ -322,6 +332,7 @@ enum AUDIO_THREAD_LOG_EVENTS {
   AUDIO_THREAD_LOOPBACK_GET,
   AUDIO_THREAD_LOOPBACK_SAMPLE_HOOK,
   AUDIO_THREAD_DEV_OVERRUN,
+  AUDIO_THREAD_A2DP_FLOW_CTRL,
 };
 
 // Important events in main thread.
@@ -403,6 +414,9 @@ enum CRAS_BT_LOG_EVENTS {
   BT_RESET,                            // BlueZ
   BT_SCO_CONNECT,
   BT_TRANSPORT_RELEASE,  // BlueZ
+  BT_A2DP_ENCODER_QUEUE,
+  BT_A2DP_ENCODER_UNDERRUN,
+  BT_A2DP_FLOW_CTRL,
 };
 
 struct __attribute__((__packed__)) audio_thread_event {
@@ -513,12 +527,101 @@ struct __attribute__((__packed__)) cras_bt_event_log {
   struct cras_bt_event log[CRAS_BT_EVENT_LOG_SIZE];
 };
 
+/* The max number of SCO packets read or written in one wake up of the
+ * HFP audio path. */
+#define CRAS_SCO_MAX_BATCH 8
+
+/* Stats of the SCO socket I/O of the last HFP call, the packets queued on
+ * the socket are read and written in batches each wake up. */
+struct __attribute__((__packed__)) cras_sco_io_stats {
+  // Number of wake ups to read and write the SCO socket.
+  uint32_t wakeups;
+  // Number of recvmmsg and sendmmsg calls.
+  uint32_t recv_calls;
+  uint32_t send_calls;
+  // Number of packets read and written.
+  uint32_t packets_read;
+  uint32_t packets_written;
+  // Number of packets read with a non zero HCI packet status flag.
+  uint32_t packets_erroneous;
+  // read_batches[i] counts the batches of i + 1 packets read.
+  uint32_t read_batches[CRAS_SCO_MAX_BATCH];
+  /* The time from the kernel receiving the first packet of a batch to the
+   * batch being read in microseconds, over the timestamped batches. */
+  uint32_t max_read_delay_us;
+  uint64_t sum_read_delay_us;
+  uint32_t num_read_delays;
+};
+
 struct __attribute__((__packed__)) cras_bt_debug_info {
   struct cras_bt_event_log bt_log;
   struct packet_status_logger wbs_logger;
   int32_t floss_enabled;
 };
 
+#define CRAS_DSP_DEBUG_MAX_PIPELINES 8
+#define CRAS_DSP_DEBUG_MAX_MODULES 16
+#define CRAS_DSP_DEBUG_NAME_SIZE 32
+/* The run time histograms of dsp modules have log2 buckets in nanoseconds.
+ * Bucket 0 counts blocks shorter than 2^CRAS_DSP_HISTOGRAM_MIN_SHIFT ns,
+ * bucket i counts blocks in [2^(MIN_SHIFT + i - 1), 2^(MIN_SHIFT + i)) ns,
+ * and the last bucket also counts all longer blocks. */
+#define CRAS_DSP_HISTOGRAM_BUCKETS 16
+#define CRAS_DSP_HISTOGRAM_MIN_SHIFT 10
+
+/* Profile of a module in a dsp pipeline.
+ *    title - The title of the plugin in the dsp ini.
+ *    label - The label of the plugin, like "eq2" or "drc".
+ *    run - 0 if the module is skipped or fused into the next module, which
+ *        then also accounts for its processing.
+ *    blocks - The number of blocks the module processed.
+ *    samples - The number of frames the module processed.
+ *    total_ns - The thread CPU time spent in run(), in nanoseconds.
+ *    max_ns - The longest run() of a block, in nanoseconds.
+ *    denormals - The number of denormal output samples.
+ *    nans - The number of NaN output samples.
+ *    histogram - The number of blocks in each run time bucket.
+ */
+struct __attribute__((__packed__)) dsp_module_debug_info {
+  char title[CRAS_DSP_DEBUG_NAME_SIZE];
+  char label[CRAS_DSP_DEBUG_NAME_SIZE];
+  uint32_t run;
+  uint64_t blocks;
+  uint64_t samples;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t denormals;
+  uint64_t nans;
+  uint32_t histogram[CRAS_DSP_HISTOGRAM_BUCKETS];
+};
+
+/* Profile of a dsp pipeline.
+ *    purpose - "playback" or "capture".
+ *    sample_rate - The rate the pipeline is instantiated with.
+ *    input_channels, output_channels - The channel counts of the pipeline.
+ *    blocks, samples, total_ns, max_ns, min_ns - Like those of the modules,
+ *        for the whole cras_dsp_pipeline_apply() call.
+ *    num_modules - The number of valid entries in modules.
+ */
+struct __attribute__((__packed__)) dsp_pipeline_debug_info {
+  char purpose[CRAS_DSP_DEBUG_NAME_SIZE];
+  uint32_t sample_rate;
+  uint32_t input_channels;
+  uint32_t output_channels;
+  uint64_t blocks;
+  uint64_t samples;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t min_ns;
+  uint32_t num_modules;
+  struct dsp_module_debug_info modules[CRAS_DSP_DEBUG_MAX_MODULES];
+};
+
+struct __attribute__((__packed__)) cras_dsp_debug_info {
+  uint32_t num_pipelines;
+  struct dsp_pipeline_debug_info pipelines[CRAS_DSP_DEBUG_MAX_PIPELINES];
+};
+
 /*
  * All event enums should be less then AUDIO_THREAD_EVENT_TYPE_COUNT,
  * or they will be ignored by the handler.
@@ -638,6 +741,10 @@ static inline bool cras_floop_params_eq(const struct cras_floop_params* a,
  *        and lineout.
  *    num_non_chrome_output_streams - Number of streams that are not from
  *        CLIENT_TYPE_CHROME or CLIENT_TYPE_LACROS
+ *    dsp_debug_info - Profile of the dsp pipelines filled in when a client
+ *        requests it. Like audio_debug_info, only one client should use it.
+ *    sco_io_stats - Stats of the SCO socket I/O, filled in along with
+ *        bt_debug_info.
  */
 #define CRAS_SERVER_STATE_VERSION 2
 struct __attribute__((packed, aligned(4))) cras_server_state {
@@ -695,6 +802,8 @@ struct __attribute__((packed, aligned(4))) cras_server_state {
   int32_t max_internal_speaker_channels;
   int32_t max_headphone_channels;
   int32_t num_non_chrome_output_streams;
+  struct cras_dsp_debug_info dsp_debug_info;
+  struct cras_sco_io_stats sco_io_stats;
 };
 
 // Actions for card add/remove/change.
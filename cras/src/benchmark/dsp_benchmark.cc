@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <cmath>
 #include <random>
 #include <vector>
 
@@ -11,49 +12,39 @@
 
 namespace {
 extern "C" {
+#include "cras/src/dsp/convolver.h"
 #include "cras/src/dsp/drc.h"
+#include "cras/src/dsp/dsp_util.h"
 #include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
 }
 
-constexpr int NUM_CHANNELS = 2;
-
 class BM_Dsp : public benchmark::Fixture {
  public:
   void SetUp(const ::benchmark::State& state) {
     std::random_device rnd_device;
     std::mt19937 engine{rnd_device()};
     frames = state.range(0);
-    samples = gen_float_samples(frames * NUM_CHANNELS, engine);
+    channels = state.range(1);
+    samples = gen_float_samples(frames * channels, engine);
   }
 
   void TearDown(const ::benchmark::State& state) {}
 
   // Number of |frames|
   size_t frames;
-  // |frames| * |NUM_CHANNELS| of samples.
+  // Number of |channels|
+  size_t channels;
+  // |frames| * |channels| of samples.
   std::vector<float> samples;
 };
 
-BENCHMARK_DEFINE_F(BM_Dsp, Eq2)(benchmark::State& state) {
-  const double NQ = 44100 / 2;  // nyquist frequency
-  // eq chain
-  struct eq2* eq2 = eq2_new();
-  eq2_append_biquad(eq2, 0, BQ_PEAKING, 380 / NQ, 3, -10);
-  eq2_append_biquad(eq2, 0, BQ_PEAKING, 720 / NQ, 3, -12);
-  eq2_append_biquad(eq2, 0, BQ_PEAKING, 1705 / NQ, 3, -8);
-  eq2_append_biquad(eq2, 0, BQ_HIGHPASS, 218 / NQ, 0.7, -10.2);
-  eq2_append_biquad(eq2, 0, BQ_PEAKING, 580 / NQ, 6, -8);
-  eq2_append_biquad(eq2, 0, BQ_HIGHSHELF, 8000 / NQ, 3, 2);
-  eq2_append_biquad(eq2, 1, BQ_PEAKING, 450 / NQ, 3, -12);
-  eq2_append_biquad(eq2, 1, BQ_PEAKING, 721 / NQ, 3, -12);
-  eq2_append_biquad(eq2, 1, BQ_PEAKING, 1800 / NQ, 8, -10.2);
-  eq2_append_biquad(eq2, 1, BQ_PEAKING, 580 / NQ, 6, -8);
-  eq2_append_biquad(eq2, 1, BQ_HIGHPASS, 250 / NQ, 0.6578, 0);
-  eq2_append_biquad(eq2, 1, BQ_HIGHSHELF, 8000 / NQ, 0, 2);
-  for (auto _ : state) {
-    eq2_process(eq2, samples.data(), samples.data() + frames, frames);
-  }
-  eq2_free(eq2);
+static void dsp_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"frames", "channels"});
+  b->ArgsProduct({benchmark::CreateRange(256, 8 << 10, 2), {2, 4, 8}});
+}
+
+static void set_dsp_counters(benchmark::State& state, size_t frames) {
   state.counters["frames_per_second"] = benchmark::Counter(
       int64_t(state.iterations()) * frames, benchmark::Counter::kIsRate);
   state.counters["time_per_48k_frames"] = benchmark::Counter(
@@ -61,12 +52,74 @@ BENCHMARK_DEFINE_F(BM_Dsp, Eq2)(benchmark::State& state) {
       benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
 }
 
-BENCHMARK_REGISTER_F(BM_Dsp, Eq2)->RangeMultiplier(2)->Range(256, 8 << 10);
+/* The eq chain of a stereo speaker, |append| is called with
+ * (channel, type, freq, Q, gain) for channel 0 and 1. */
+template <typename F>
+static void append_eq_chain(F append) {
+  const double NQ = 44100 / 2;  // nyquist frequency
+  append(0, BQ_PEAKING, 380 / NQ, 3, -10);
+  append(0, BQ_PEAKING, 720 / NQ, 3, -12);
+  append(0, BQ_PEAKING, 1705 / NQ, 3, -8);
+  append(0, BQ_HIGHPASS, 218 / NQ, 0.7, -10.2);
+  append(0, BQ_PEAKING, 580 / NQ, 6, -8);
+  append(0, BQ_HIGHSHELF, 8000 / NQ, 3, 2);
+  append(1, BQ_PEAKING, 450 / NQ, 3, -12);
+  append(1, BQ_PEAKING, 721 / NQ, 3, -12);
+  append(1, BQ_PEAKING, 1800 / NQ, 8, -10.2);
+  append(1, BQ_PEAKING, 580 / NQ, 6, -8);
+  append(1, BQ_HIGHPASS, 250 / NQ, 0.6578, 0);
+  append(1, BQ_HIGHSHELF, 8000 / NQ, 0, 2);
+}
 
-BENCHMARK_DEFINE_F(BM_Dsp, Drc)(benchmark::State& state) {
+// One eq2 per channel pair, as boards with more speakers configure today.
+BENCHMARK_DEFINE_F(BM_Dsp, Eq2)(benchmark::State& state) {
+  std::vector<struct eq2*> eq2s;
+  for (size_t c = 0; c < channels; c += 2) {
+    struct eq2* eq2 = eq2_new();
+    append_eq_chain([eq2](int ch, enum biquad_type type, float freq, float Q,
+                          float gain) {
+      eq2_append_biquad(eq2, ch, type, freq, Q, gain);
+    });
+    eq2s.push_back(eq2);
+  }
+  for (auto _ : state) {
+    for (size_t c = 0; c < channels; c += 2) {
+      eq2_process(eq2s[c / 2], samples.data() + c * frames,
+                  samples.data() + (c + 1) * frames, frames);
+    }
+  }
+  for (auto eq2 : eq2s) {
+    eq2_free(eq2);
+  }
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, Eq2)->Apply(dsp_args);
+
+BENCHMARK_DEFINE_F(BM_Dsp, EqN)(benchmark::State& state) {
+  struct eqn* eqn = eqn_new(channels);
+  std::vector<float*> data;
+  for (size_t c = 0; c < channels; c += 2) {
+    append_eq_chain([eqn, c](int ch, enum biquad_type type, float freq,
+                             float Q, float gain) {
+      eqn_append_biquad(eqn, c + ch, type, freq, Q, gain);
+    });
+  }
+  for (size_t c = 0; c < channels; c++) {
+    data.push_back(samples.data() + c * frames);
+  }
+  for (auto _ : state) {
+    eqn_process(eqn, data.data(), frames);
+  }
+  eqn_free(eqn);
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, EqN)->Apply(dsp_args);
+
+static void set_drc_params(struct drc* drc) {
   const double NQ = 44100 / 2;  // nyquist frequency
 
-  struct drc* drc = drc_new(44100);
   drc->emphasis_disabled = 0;
   drc_set_param(drc, 0, PARAM_CROSSOVER_LOWER_FREQ, 0);
   drc_set_param(drc, 0, PARAM_ENABLED, 1);
@@ -96,24 +149,211 @@ BENCHMARK_DEFINE_F(BM_Dsp, Drc)(benchmark::State& state) {
   drc_set_param(drc, 2, PARAM_POST_GAIN, 0);
 
   drc_init(drc);
+}
+
+// Runs |drc| over |channels| channels of |samples| starting at |channel|.
+static void run_drc(struct drc* drc,
+                    std::vector<float>& samples,
+                    size_t frames,
+                    size_t channel,
+                    size_t channels) {
+  std::vector<float*> data(channels);
+
+  for (size_t start = 0; start < frames;) {
+    const int chunk = std::min(DRC_PROCESS_MAX_FRAMES, (int)(frames - start));
+    for (size_t c = 0; c < channels; c++) {
+      data[c] = samples.data() + (channel + c) * frames + start;
+    }
+    drc_process(drc, data.data(), chunk);
+    start += chunk;
+  }
+}
+
+// One stereo drc per channel pair, as boards with more speakers configure
+// today.
+BENCHMARK_DEFINE_F(BM_Dsp, Drc)(benchmark::State& state) {
+  std::vector<struct drc*> drcs;
+  for (size_t c = 0; c < channels; c += 2) {
+    struct drc* drc = drc_new(44100);
+    set_drc_params(drc);
+    drcs.push_back(drc);
+  }
   for (auto _ : state) {
-    for (size_t start = 0; start < frames;) {
-      float* data[2] = {samples.data() + start,
-                        samples.data() + frames + start};
-      const int chunk = std::min(DRC_PROCESS_MAX_FRAMES, (int)(frames - start));
-      drc_process(drc, data, chunk);
-      start += chunk;
+    for (size_t c = 0; c < channels; c += 2) {
+      run_drc(drcs[c / 2], samples, frames, c, 2);
     }
   }
+  for (auto drc : drcs) {
+    drc_free(drc);
+  }
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, Drc)->Apply(dsp_args);
+
+BENCHMARK_DEFINE_F(BM_Dsp, DrcN)(benchmark::State& state) {
+  struct drc* drc = drc_new_multichannel(44100, channels, DRC_NUM_KERNELS);
+  set_drc_params(drc);
+  for (auto _ : state) {
+    run_drc(drc, samples, frames, 0, channels);
+  }
   drc_free(drc);
+  set_dsp_counters(state, frames);
+}
 
-  state.counters["frames_per_second"] = benchmark::Counter(
-      int64_t(state.iterations()) * frames, benchmark::Counter::kIsRate);
-  state.counters["time_per_48k_frames"] = benchmark::Counter(
-      int64_t(state.iterations()) * frames / 48000,
-      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+BENCHMARK_REGISTER_F(BM_Dsp, DrcN)->Apply(dsp_args);
+
+/* An eqN in front of a drcN, as the pipeline runs them when not fused. The
+ * eq boosts some bands, so both this and DrcNInputEq start from the same
+ * samples each time to stay away from overflows. */
+BENCHMARK_DEFINE_F(BM_Dsp, EqNThenDrcN)(benchmark::State& state) {
+  struct eqn* eqn = eqn_new(channels);
+  struct drc* drc = drc_new_multichannel(44100, channels, DRC_NUM_KERNELS);
+  std::vector<float> buf(samples.size());
+  std::vector<float*> data;
+  for (size_t c = 0; c < channels; c += 2) {
+    append_eq_chain([eqn, c](int ch, enum biquad_type type, float freq,
+                             float Q, float gain) {
+      eqn_append_biquad(eqn, c + ch, type, freq, Q, gain);
+    });
+  }
+  for (size_t c = 0; c < channels; c++) {
+    data.push_back(buf.data() + c * frames);
+  }
+  set_drc_params(drc);
+  for (auto _ : state) {
+    std::copy(samples.begin(), samples.end(), buf.begin());
+    eqn_process(eqn, data.data(), frames);
+    run_drc(drc, buf, frames, 0, channels);
+  }
+  eqn_free(eqn);
+  drc_free(drc);
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, EqNThenDrcN)->Apply(dsp_args);
+
+// The same eq run by the emphasis filter of the drc, see drc_fuse().
+BENCHMARK_DEFINE_F(BM_Dsp, DrcNInputEq)(benchmark::State& state) {
+  struct drc* drc = drc_new_multichannel(44100, channels, DRC_NUM_KERNELS);
+  for (size_t c = 0; c < channels; c += 2) {
+    append_eq_chain([drc, c](int ch, enum biquad_type type, float freq,
+                             float Q, float gain) {
+      struct biquad bq;
+      biquad_set(&bq, type, freq, Q, gain);
+      drc_append_input_biquad(drc, c + ch, &bq);
+    });
+  }
+  std::vector<float> buf(samples.size());
+  set_drc_params(drc);
+  for (auto _ : state) {
+    std::copy(samples.begin(), samples.end(), buf.begin());
+    run_drc(drc, buf, frames, 0, channels);
+  }
+  drc_free(drc);
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, DrcNInputEq)->Apply(dsp_args);
+
+static void decay_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"frames", "channels", "ftz"});
+  b->ArgsProduct({{1024}, {2, 8}, {0, 1}});
+}
+
+/* The end of a fade out, decaying from the smallest normal float past the
+ * smallest denormal. The filter states follow it, so every block works on
+ * denormals as when the audio goes quiet. */
+static void fill_decaying_samples(std::vector<float>& samples,
+                                  size_t frames,
+                                  size_t channels) {
+  for (size_t c = 0; c < channels; c++) {
+    for (size_t i = 0; i < frames; i++) {
+      samples[c * frames + i] = 1.2e-38f * std::pow(1e-7f, (float)i / frames) *
+                                std::sin(0.05f * (i + 7 * c));
+    }
+  }
+}
+
+/* Runs |process| once per iteration on a fresh copy of the decaying
+ * samples, with denormals flushed to zero if the "ftz" argument is set. */
+template <typename F>
+static void run_decaying(benchmark::State& state,
+                         std::vector<float>& samples,
+                         std::vector<float>& buf,
+                         F process) {
+  struct dsp_fp_mode mode = {};
+
+  if (state.range(2)) {
+    dsp_fp_mode_flush_denormal(&mode);
+  }
+  for (auto _ : state) {
+    std::copy(samples.begin(), samples.end(), buf.begin());
+    process();
+  }
+  dsp_fp_mode_restore(&mode);
+}
+
+BENCHMARK_DEFINE_F(BM_Dsp, EqNDecay)(benchmark::State& state) {
+  struct eqn* eqn = eqn_new(channels);
+  std::vector<float> buf(samples.size());
+  std::vector<float*> data;
+  for (size_t c = 0; c < channels; c += 2) {
+    append_eq_chain([eqn, c](int ch, enum biquad_type type, float freq,
+                             float Q, float gain) {
+      eqn_append_biquad(eqn, c + ch, type, freq, Q, gain);
+    });
+  }
+  for (size_t c = 0; c < channels; c++) {
+    data.push_back(buf.data() + c * frames);
+  }
+  fill_decaying_samples(samples, frames, channels);
+  run_decaying(state, samples, buf,
+               [&]() { eqn_process(eqn, data.data(), frames); });
+  eqn_free(eqn);
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, EqNDecay)->Apply(decay_args);
+
+BENCHMARK_DEFINE_F(BM_Dsp, DrcNDecay)(benchmark::State& state) {
+  struct drc* drc = drc_new_multichannel(44100, channels, DRC_NUM_KERNELS);
+  std::vector<float> buf(samples.size());
+  set_drc_params(drc);
+  fill_decaying_samples(samples, frames, channels);
+  run_decaying(state, samples, buf,
+               [&]() { run_drc(drc, buf, frames, 0, channels); });
+  drc_free(drc);
+  set_dsp_counters(state, frames);
+}
+
+BENCHMARK_REGISTER_F(BM_Dsp, DrcNDecay)->Apply(decay_args);
+
+static void convolver_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"frames", "channels", "ir_len", "block"});
+  b->ArgsProduct(
+      {{1024}, {2}, {4 << 10, 16 << 10, 64 << 10}, {128, 512, 2048}});
+}
+
+// A room correction filter of |ir_len| taps on each channel.
+BENCHMARK_DEFINE_F(BM_Dsp, Convolver)(benchmark::State& state) {
+  std::mt19937 engine{0};
+  std::vector<float> ir = gen_float_samples(state.range(2), engine);
+  std::vector<struct convolver*> convs;
+  for (size_t c = 0; c < channels; c++) {
+    convs.push_back(convolver_new(ir.data(), ir.size(), state.range(3)));
+  }
+  for (auto _ : state) {
+    for (size_t c = 0; c < channels; c++) {
+      convolver_process(convs[c], samples.data() + c * frames, frames);
+    }
+  }
+  for (auto conv : convs) {
+    convolver_free(conv);
+  }
+  set_dsp_counters(state, frames);
 }
 
-BENCHMARK_REGISTER_F(BM_Dsp, Drc)->RangeMultiplier(2)->Range(256, 8 << 10);
+BENCHMARK_REGISTER_F(BM_Dsp, Convolver)->Apply(convolver_args);
 
 }  // namespace
@@ -0,0 +1,108 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cras/src/benchmark/benchmark_util.h"
+
+namespace {
+extern "C" {
+#include "cras/src/server/cras_fmt_conv_ch.h"
+#include "cras/src/server/cras_fmt_conv_ops.h"
+}
+
+/*
+ * The benchmarks below take (number of frames, use SIMD) and compare the
+ * portable C channel converters with the variant picked for the running CPU.
+ */
+static const struct cras_fmt_conv_ch_ops* init_ch_ops(
+    benchmark::State& state) {
+  if (state.range(1)) {
+    cras_fmt_conv_ch_init();
+  } else {
+    cras_fmt_conv_ch_init_with_flags(0);
+  }
+  return cras_fmt_conv_ch_get_ops();
+}
+
+static void ch_ops_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"frames", "simd"});
+  b->ArgsProduct({{256, 1024, 8 << 10}, {0, 1}});
+}
+
+static void BM_FmtConvChStereoTo51(benchmark::State& state) {
+  const struct cras_fmt_conv_ch_ops* ops = init_ch_ops(state);
+  size_t frames = state.range(0);
+  std::mt19937 engine{std::random_device()()};
+  std::vector<int16_t> in = gen_s16_le_samples(frames * 2, engine);
+  std::vector<int16_t> out(frames * 6);
+
+  for (auto _ : state) {
+    if (ops) {
+      ops->s16_stereo_to_51(0, 1, 4, (uint8_t*)in.data(), frames,
+                            (uint8_t*)out.data());
+    } else {
+      s16_stereo_to_51(0, 1, 4, (uint8_t*)in.data(), frames,
+                       (uint8_t*)out.data());
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(frames));
+}
+
+BENCHMARK(BM_FmtConvChStereoTo51)->Apply(ch_ops_args);
+
+static void BM_FmtConvCh51ToStereo(benchmark::State& state) {
+  const struct cras_fmt_conv_ch_ops* ops = init_ch_ops(state);
+  size_t frames = state.range(0);
+  std::mt19937 engine{std::random_device()()};
+  std::vector<int16_t> in = gen_s16_le_samples(frames * 6, engine);
+  std::vector<int16_t> out(frames * 2);
+
+  for (auto _ : state) {
+    if (ops) {
+      ops->s16_51_to_stereo((uint8_t*)in.data(), frames, (uint8_t*)out.data());
+    } else {
+      s16_51_to_stereo((uint8_t*)in.data(), frames, (uint8_t*)out.data());
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(frames));
+}
+
+BENCHMARK(BM_FmtConvCh51ToStereo)->Apply(ch_ops_args);
+
+// 7.1 to 5.1 through a channel conversion matrix, folding SL/SR into RL/RR.
+static void BM_FmtConvChConvertChannels(benchmark::State& state) {
+  const struct cras_fmt_conv_ch_ops* ops = init_ch_ops(state);
+  size_t frames = state.range(0);
+  std::mt19937 engine{std::random_device()()};
+  std::vector<int16_t> in = gen_s16_le_samples(frames * 8, engine);
+  std::vector<int16_t> out(frames * 6);
+  std::vector<std::vector<float>> mtx(6, std::vector<float>(8));
+  std::vector<float*> rows;
+
+  for (size_t ch = 0; ch < 6; ch++) {
+    mtx[ch][ch] = 0.707;
+    rows.push_back(mtx[ch].data());
+  }
+  mtx[4][6] = 0.707;
+  mtx[5][7] = 0.707;
+
+  for (auto _ : state) {
+    if (ops) {
+      ops->s16_convert_channels(rows.data(), 8, 6, (uint8_t*)in.data(),
+                                frames, (uint8_t*)out.data());
+    } else {
+      s16_convert_channels(rows.data(), 8, 6, (uint8_t*)in.data(), frames,
+                           (uint8_t*)out.data());
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(frames));
+}
+
+BENCHMARK(BM_FmtConvChConvertChannels)->Apply(ch_ops_args);
+
+}  // namespace
@@ -0,0 +1,71 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cras/src/benchmark/benchmark_util.h"
+
+namespace {
+extern "C" {
+#include "cras/src/server/linear_resampler.h"
+#include "cras_audio_format.h"
+}
+
+static const unsigned int kFrames = 1024;
+
+/*
+ * The benchmark takes (channels, format, use SIMD) and resamples kFrames
+ * frames from 44100 to 48000, comparing the portable C kernels with the
+ * variant picked for the running CPU.
+ */
+static void BM_LinearResampler(benchmark::State& state) {
+  unsigned int channels = state.range(0);
+  snd_pcm_format_t format = static_cast<snd_pcm_format_t>(state.range(1));
+  std::mt19937 engine{std::random_device()()};
+  std::vector<float> samples = gen_float_samples(kFrames * channels, engine);
+  size_t sample_bytes = snd_pcm_format_physical_width(format) / 8;
+  std::vector<uint8_t> in(kFrames * channels * sample_bytes);
+  std::vector<uint8_t> out(2 * in.size());
+  struct linear_resampler* lr =
+      linear_resampler_create_with_format(channels, format, 44100, 48000);
+
+  if (state.range(2)) {
+    linear_resampler_init();
+  } else {
+    linear_resampler_init_with_flags(0);
+  }
+  for (size_t i = 0; i < samples.size(); i++) {
+    switch (format) {
+      case SND_PCM_FORMAT_S16_LE:
+        ((int16_t*)in.data())[i] = samples[i] * INT16_MAX;
+        break;
+      case SND_PCM_FORMAT_S32_LE:
+        ((int32_t*)in.data())[i] = samples[i] * INT32_MAX;
+        break;
+      default:
+        ((float*)in.data())[i] = samples[i];
+        break;
+    }
+  }
+  for (auto _ : state) {
+    unsigned int count = kFrames;
+
+    benchmark::DoNotOptimize(linear_resampler_resample(
+        lr, in.data(), &count, out.data(), 2 * kFrames));
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(kFrames));
+  linear_resampler_destroy(lr);
+}
+
+BENCHMARK(BM_LinearResampler)
+    ->ArgNames({"channels", "format", "simd"})
+    ->ArgsProduct({{1, 2, 6},
+                   {SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S32_LE,
+                    SND_PCM_FORMAT_FLOAT_LE},
+                   {0, 1}});
+
+}  // namespace
@@ -51,4 +51,118 @@ static void BM_CrasMixerOpsMixAdd(benchmark::State& state) {
 }
 
 BENCHMARK(BM_CrasMixerOpsMixAdd)->RangeMultiplier(2)->Range(256, 8 << 10);
+
+/*
+ * The benchmarks below take (number of samples, sample format, use SIMD)
+ * so each format can be compared between the portable C ops and the
+ * variant picked for the running CPU.
+ */
+static void init_mixer_ops(benchmark::State& state) {
+  if (state.range(2)) {
+    cras_mix_init();
+  } else {
+    cras_mix_init_with_flags(0);
+  }
+}
+
+static std::vector<uint8_t> gen_mixer_buffer(benchmark::State& state,
+                                             std::mt19937& engine) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  size_t bytes = state.range(0) * snd_pcm_format_physical_width(fmt) / 8;
+  std::vector<int16_t> samples = gen_s16_le_samples(bytes / 2, engine);
+  const uint8_t* data = (const uint8_t*)samples.data();
+
+  return std::vector<uint8_t>(data, data + bytes);
+}
+
+static void set_mixer_bytes_processed(benchmark::State& state) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(state.range(0)) *
+                          snd_pcm_format_physical_width(fmt) / 8);
+}
+
+static void mixer_ops_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"samples", "format", "simd"});
+  b->ArgsProduct({{256, 1024, 8 << 10},
+                  {SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S24_LE,
+                   SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE},
+                  {0, 1}});
+}
+
+static void BM_CrasMixerOpsScaleBufferFormat(benchmark::State& state) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  std::mt19937 engine{std::random_device()()};
+  std::vector<uint8_t> buf = gen_mixer_buffer(state, engine);
+
+  init_mixer_ops(state);
+  for (auto _ : state) {
+    cras_scale_buffer(fmt, buf.data(), state.range(0), 0.5);
+  }
+  set_mixer_bytes_processed(state);
+}
+
+BENCHMARK(BM_CrasMixerOpsScaleBufferFormat)->Apply(mixer_ops_args);
+
+static void BM_CrasMixerOpsScaleBufferIncrement(benchmark::State& state) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  std::mt19937 engine{std::random_device()()};
+  std::vector<uint8_t> buf = gen_mixer_buffer(state, engine);
+
+  init_mixer_ops(state);
+  for (auto _ : state) {
+    cras_scale_buffer_increment(fmt, buf.data(), state.range(0) / 2, 0.1,
+                                0.0001, 0.9, 2);
+  }
+  set_mixer_bytes_processed(state);
+}
+
+BENCHMARK(BM_CrasMixerOpsScaleBufferIncrement)->Apply(mixer_ops_args);
+
+static void BM_CrasMixerOpsMixAddFormat(benchmark::State& state) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  std::mt19937 engine{std::random_device()()};
+  std::vector<uint8_t> src = gen_mixer_buffer(state, engine);
+  std::vector<uint8_t> dst = gen_mixer_buffer(state, engine);
+
+  init_mixer_ops(state);
+  for (auto _ : state) {
+    cras_mix_add(fmt, dst.data(), src.data(), state.range(0), 1, 0, 0.7);
+  }
+  set_mixer_bytes_processed(state);
+}
+
+BENCHMARK(BM_CrasMixerOpsMixAddFormat)->Apply(mixer_ops_args);
+
+static void BM_CrasMixerOpsMixAddScaleStride(benchmark::State& state) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  unsigned int width = snd_pcm_format_physical_width(fmt) / 8;
+  std::mt19937 engine{std::random_device()()};
+  std::vector<uint8_t> src = gen_mixer_buffer(state, engine);
+  std::vector<uint8_t> dst = gen_mixer_buffer(state, engine);
+
+  init_mixer_ops(state);
+  for (auto _ : state) {
+    cras_mix_add_scale_stride(fmt, dst.data(), src.data(), state.range(0),
+                              width, width, 0.7);
+  }
+  set_mixer_bytes_processed(state);
+}
+
+BENCHMARK(BM_CrasMixerOpsMixAddScaleStride)->Apply(mixer_ops_args);
+
+static void BM_CrasMixerOpsMuteBuffer(benchmark::State& state) {
+  snd_pcm_format_t fmt = (snd_pcm_format_t)state.range(1);
+  unsigned int width = snd_pcm_format_physical_width(fmt) / 8;
+  std::mt19937 engine{std::random_device()()};
+  std::vector<uint8_t> buf = gen_mixer_buffer(state, engine);
+
+  init_mixer_ops(state);
+  for (auto _ : state) {
+    cras_mix_mute_buffer(buf.data(), width, state.range(0));
+  }
+  set_mixer_bytes_processed(state);
+}
+
+BENCHMARK(BM_CrasMixerOpsMuteBuffer)->Apply(mixer_ops_args);
 }  // namespace
@@ -0,0 +1,168 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+extern "C" {
+#include "cras/src/common/cras_sbc_codec.h"
+#include "cras/src/plc/cras_plc.h"
+}
+
+namespace {
+
+// 120 samples of S16_LE, one mSBC frame at 16kHz.
+const size_t kMsbcCodeSize = 240;
+const size_t kMsbcPktLen = 57;
+
+/* A record in the output of plc/parse_sco.py: a 3 bytes header with the
+ * packet status flag in the high nibble of the second byte, and 60 bytes
+ * of SCO data. The data is the 2 bytes H2 header, the mSBC frame starting
+ * with the sync word, and a padding byte. */
+const size_t kTraceHeaderLen = 3;
+const size_t kTraceDataLen = 60;
+const size_t kH2HeaderLen = 2;
+const uint8_t kMsbcSyncWord = 0xad;
+
+struct Packet {
+  bool lost;
+  std::vector<uint8_t> frame;
+};
+
+/* Reads a trace of SCO packets written by plc/parse_sco.py. Packets with an
+ * erroneous status flag or without the mSBC sync word are lost. Returns an
+ * empty vector if the trace can't be read. */
+static std::vector<Packet> read_sco_trace(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<Packet> packets;
+  uint8_t header[kTraceHeaderLen];
+  uint8_t data[kTraceDataLen];
+
+  while (file.read((char*)header, sizeof(header)) &&
+         file.read((char*)data, sizeof(data))) {
+    Packet packet;
+    const uint8_t* frame = data + kH2HeaderLen;
+    packet.lost = (header[1] >> 4) != 0 || frame[0] != kMsbcSyncWord;
+    packet.frame.assign(frame, frame + kMsbcPktLen);
+    packets.push_back(packet);
+  }
+  return packets;
+}
+
+/* Encodes |seconds| of a voiced, speech like signal and loses
+ * |loss_percent| of the packets at random. */
+static std::vector<Packet> gen_sco_trace(int seconds, int loss_percent) {
+  struct cras_audio_codec* codec = cras_msbc_codec_create();
+  std::mt19937 engine{0};
+  std::uniform_int_distribution<int> loss(0, 99);
+  std::normal_distribution<float> noise(0, 200);
+  std::vector<Packet> packets;
+  int16_t pcm[kMsbcCodeSize / 2];
+  float phase = 0;
+  size_t n = 0;
+
+  for (int f = 0; f < seconds * 16000 / 120; f++) {
+    for (auto& x : pcm) {
+      float t = n++ / 16000.0f;
+      float f0 = 120 + 30 * sinf(2 * M_PI * 0.7f * t);
+      float envelope = 0.6f + 0.4f * sinf(2 * M_PI * 3 * t);
+      float v = 0;
+      phase += 2 * M_PI * f0 / 16000;
+      for (int h = 1; h <= 10; h++) {
+        v += sinf(h * phase) / h;
+      }
+      x = envelope * 6000 * v + noise(engine);
+    }
+
+    Packet packet;
+    size_t encoded = 0;
+    packet.lost = loss(engine) < loss_percent;
+    packet.frame.resize(kMsbcPktLen);
+    codec->encode(codec, pcm, kMsbcCodeSize, packet.frame.data(), kMsbcPktLen,
+                  &encoded);
+    packets.push_back(packet);
+  }
+  cras_sbc_codec_destroy(codec);
+  return packets;
+}
+
+/* Decodes |packets| and conceals the lost ones as the SCO input does. Only
+ * the concealment is timed. */
+static void run_trace(benchmark::State& state,
+                      const std::vector<Packet>& packets) {
+  struct cras_audio_codec* codec = cras_msbc_codec_create();
+  struct cras_msbc_plc* plc = cras_msbc_plc_create();
+  uint8_t pcm[kMsbcCodeSize];
+  size_t decoded;
+  int64_t lost = 0;
+  double max_elapsed_seconds = 0.0;
+
+  for (auto _ : state) {
+    std::chrono::duration<double> elapsed_seconds(0);
+    for (const auto& packet : packets) {
+      if (!packet.lost) {
+        codec->decode(codec, packet.frame.data(), kMsbcPktLen, pcm,
+                      kMsbcCodeSize, &decoded);
+        cras_msbc_plc_handle_good_frames(plc, pcm, pcm);
+        continue;
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      cras_msbc_plc_handle_bad_frames(plc, codec, pcm);
+      auto end = std::chrono::high_resolution_clock::now();
+      benchmark::DoNotOptimize(pcm);
+
+      elapsed_seconds += end - start;
+      max_elapsed_seconds =
+          fmax(max_elapsed_seconds,
+               std::chrono::duration<double>(end - start).count());
+      lost++;
+    }
+    state.SetIterationTime(elapsed_seconds.count());
+  }
+
+  state.counters["time_per_lost_frame"] = benchmark::Counter(
+      lost, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["max_time_per_lost_frame"] = max_elapsed_seconds;
+  cras_msbc_plc_destroy(plc);
+  cras_sbc_codec_destroy(codec);
+}
+
+static void BM_Plc_Synthetic(benchmark::State& state) {
+  run_trace(state, gen_sco_trace(10, state.range(0)));
+}
+
+BENCHMARK(BM_Plc_Synthetic)
+    ->ArgName("loss_percent")
+    ->Arg(5)
+    ->Arg(10)
+    ->Arg(25)
+    ->UseManualTime();
+
+/* Replays the packets and packet losses of a captured call. Set
+ * CRAS_PLC_SCO_TRACE to a trace written by plc/parse_sco.py. */
+static void BM_Plc_ScoTrace(benchmark::State& state) {
+  const char* path = getenv("CRAS_PLC_SCO_TRACE");
+  if (!path) {
+    state.SkipWithError("CRAS_PLC_SCO_TRACE is not set");
+    return;
+  }
+  std::vector<Packet> packets = read_sco_trace(path);
+  if (packets.empty()) {
+    state.SkipWithError(("No SCO packets in " + std::string(path)).c_str());
+    return;
+  }
+  run_trace(state, packets);
+}
+
+BENCHMARK(BM_Plc_ScoTrace)->UseManualTime();
+
+}  // namespace
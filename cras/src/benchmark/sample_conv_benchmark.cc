@@ -0,0 +1,90 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cras/src/benchmark/benchmark_util.h"
+
+namespace {
+extern "C" {
+#include "cras/src/dsp/sample_conv.h"
+#include "cras_audio_format.h"
+}
+
+static const size_t kFrames = 1024;
+
+/*
+ * The benchmarks below take (channels or samples, format, use SIMD) and
+ * compare the portable C kernels with the variant picked for the running
+ * CPU.
+ */
+static const struct cras_sample_conv_ops* init_sample_conv_ops(
+    benchmark::State& state) {
+  if (state.range(2)) {
+    cras_sample_conv_init();
+  } else {
+    cras_sample_conv_init_with_flags(0);
+  }
+  return cras_sample_conv_get_ops();
+}
+
+static void interleave_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"channels", "format", "simd"});
+  b->ArgsProduct({{1, 2, 6, 8},
+                  {SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S24_LE,
+                   SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE},
+                  {0, 1}});
+}
+
+static void BM_SampleConvDeinterleave(benchmark::State& state) {
+  const struct cras_sample_conv_ops* ops = init_sample_conv_ops(state);
+  size_t channels = state.range(0);
+  snd_pcm_format_t format = static_cast<snd_pcm_format_t>(state.range(1));
+  std::mt19937 engine{std::random_device()()};
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<uint8_t> in(kFrames * channels *
+                          snd_pcm_format_physical_width(format) / 8);
+  std::vector<std::vector<float>> out(channels, std::vector<float>(kFrames));
+  std::vector<float*> planes;
+
+  for (auto& b : in) {
+    b = dist(engine);
+  }
+  for (auto& p : out) {
+    planes.push_back(p.data());
+  }
+  for (auto _ : state) {
+    ops->deinterleave(format, in.data(), planes.data(), channels, kFrames);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(kFrames));
+}
+
+BENCHMARK(BM_SampleConvDeinterleave)->Apply(interleave_args);
+
+static void BM_SampleConvInterleave(benchmark::State& state) {
+  const struct cras_sample_conv_ops* ops = init_sample_conv_ops(state);
+  size_t channels = state.range(0);
+  snd_pcm_format_t format = static_cast<snd_pcm_format_t>(state.range(1));
+  std::mt19937 engine{std::random_device()()};
+  std::vector<std::vector<float>> in;
+  std::vector<float*> planes;
+  std::vector<uint8_t> out(kFrames * channels *
+                           snd_pcm_format_physical_width(format) / 8);
+
+  for (size_t c = 0; c < channels; c++) {
+    in.push_back(gen_float_samples(kFrames, engine));
+    planes.push_back(in[c].data());
+  }
+  for (auto _ : state) {
+    ops->interleave(format, planes.data(), out.data(), channels, kFrames);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(kFrames));
+}
+
+BENCHMARK(BM_SampleConvInterleave)->Apply(interleave_args);
+
+}  // namespace
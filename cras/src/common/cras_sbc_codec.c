@@ -135,6 +135,15 @@ int cras_sbc_get_frame_length(struct cras_audio_codec* codec) {
   return data->frame_length;
 }
 
+int cras_sbc_set_bitpool(struct cras_audio_codec* codec, uint8_t bitpool) {
+  struct cras_sbc_data* data = (struct cras_sbc_data*)codec->priv_data;
+
+  // libsbc picks up a new bitpool at the next encoded frame.
+  data->sbc.bitpool = bitpool;
+  data->frame_length = sbc_get_frame_length(&data->sbc);
+  return data->frame_length;
+}
+
 struct cras_audio_codec* cras_msbc_codec_create() {
   struct cras_audio_codec* codec;
   struct cras_sbc_data* data;
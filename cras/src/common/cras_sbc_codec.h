@@ -44,4 +44,14 @@ int cras_sbc_get_codesize(struct cras_audio_codec* codec);
  */
 int cras_sbc_get_frame_length(struct cras_audio_codec* codec);
 
+/* Changes the bitpool of an sbc encoder, the blocks encoded after it use
+ * the new bitpool.
+ * Args:
+ *    codec: the codec to change.
+ *    bitpool: the new bitpool.
+ * Returns:
+ *    The new frame_length.
+ */
+int cras_sbc_set_bitpool(struct cras_audio_codec* codec, uint8_t bitpool);
+
 #endif  // COMMON_CRAS_SRC_COMMON_CRAS_SBC_CODEC_H_
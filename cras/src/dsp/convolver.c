@@ -0,0 +1,177 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/convolver.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "cras/src/dsp/convolver_ops.h"
+#include "cras/src/dsp/fft.h"
+#include "cras/src/server/cras_mix.h"
+
+/* Overlap-save with an FFT of two blocks. Each transform covers the previous
+ * and the current input block, and the second half of the result is the
+ * current block filtered by the whole response. */
+struct convolver {
+  int block;
+  int num_partitions;
+  // The number of bins in each spectrum, block + 1 rounded up.
+  int stride;
+  // The slot in x_re and x_im holding the spectrum of the last input block.
+  int newest;
+  // The number of frames of the current block received so far.
+  int fill;
+  struct fft* fft;
+  convolver_mac_func mac;
+  // The spectra of the partitions, scaled to normalize the inverse FFT.
+  float* h_re;
+  float* h_im;
+  // The spectra of the last num_partitions input blocks.
+  float* x_re;
+  float* x_im;
+  // The spectrum of the current output block.
+  float* y_re;
+  float* y_im;
+  // The previous and the current input block.
+  float* input;
+  // The inverse FFT of y, its second half is the output being played.
+  float* time;
+};
+
+static convolver_mac_func get_mac(unsigned int cpu_flags) {
+#if HAVE_AVX2
+  // Exclude APUs that crash when FMA is enabled, see cras_mix.c.
+  if ((cpu_flags & CPU_X86_AVX2) && (cpu_flags & CPU_X86_FMA) &&
+      !(cpu_flags & CPU_X86_FMA_CRASH)) {
+    return convolver_mac_avx2;
+  }
+#endif
+
+#if HAVE_NEON
+  if (cpu_flags & CPU_ARM_NEON) {
+    return convolver_mac_neon;
+  }
+#endif
+
+  // default C implementation
+  return convolver_mac;
+}
+
+struct convolver* convolver_new_with_flags(const float* ir,
+                                           int ir_len,
+                                           int block,
+                                           unsigned int cpu_flags) {
+  struct convolver* conv;
+  size_t spectra, size;
+  float* buf;
+  int p;
+
+  if (!ir || ir_len <= 0 || block < CONVOLVER_MIN_BLOCK ||
+      block > CONVOLVER_MAX_BLOCK || (block & (block - 1))) {
+    return NULL;
+  }
+
+  conv = calloc(1, sizeof(*conv));
+  if (!conv) {
+    return NULL;
+  }
+  conv->block = block;
+  conv->num_partitions = (ir_len + block - 1) / block;
+  conv->stride = (block + CONVOLVER_BIN_ALIGN) & ~(CONVOLVER_BIN_ALIGN - 1);
+  conv->newest = conv->num_partitions - 1;
+  conv->mac = get_mac(cpu_flags & cpu_get_flags());
+  conv->fft = fft_new(2 * block);
+  if (!conv->fft) {
+    free(conv);
+    return NULL;
+  }
+
+  // All the buffers share one allocation, aligned for the kernels.
+  spectra = (size_t)conv->num_partitions * conv->stride;
+  size = sizeof(float) * (4 * spectra + 2 * conv->stride + 4 * block);
+  if (posix_memalign((void**)&buf, 32, size)) {
+    fft_free(conv->fft);
+    free(conv);
+    return NULL;
+  }
+  memset(buf, 0, size);
+  conv->h_re = buf;
+  conv->h_im = conv->h_re + spectra;
+  conv->x_re = conv->h_im + spectra;
+  conv->x_im = conv->x_re + spectra;
+  conv->y_re = conv->x_im + spectra;
+  conv->y_im = conv->y_re + conv->stride;
+  conv->input = conv->y_im + conv->stride;
+  conv->time = conv->input + 2 * block;
+
+  // Partition p is ir[p * block] onwards, zero padded to two blocks.
+  for (p = 0; p < conv->num_partitions; p++) {
+    const float* h = ir + p * block;
+    int len = MIN(block, ir_len - p * block);
+    int i;
+
+    memset(conv->time, 0, sizeof(float) * 2 * block);
+    for (i = 0; i < len; i++) {
+      conv->time[i] = h[i] / (2 * block);
+    }
+    fft_forward(conv->fft, conv->time, conv->h_re + p * conv->stride,
+                conv->h_im + p * conv->stride);
+  }
+  memset(conv->time, 0, sizeof(float) * 2 * block);
+
+  return conv;
+}
+
+struct convolver* convolver_new(const float* ir, int ir_len, int block) {
+  return convolver_new_with_flags(ir, ir_len, block, cpu_get_flags());
+}
+
+void convolver_free(struct convolver* conv) {
+  fft_free(conv->fft);
+  free(conv->h_re);
+  free(conv);
+}
+
+int convolver_get_delay(const struct convolver* conv) {
+  return conv->block;
+}
+
+static void process_block(struct convolver* conv) {
+  const int stride = conv->stride;
+
+  if (++conv->newest == conv->num_partitions) {
+    conv->newest = 0;
+  }
+  fft_forward(conv->fft, conv->input, conv->x_re + conv->newest * stride,
+              conv->x_im + conv->newest * stride);
+  conv->mac(conv->x_re, conv->x_im, conv->h_re, conv->h_im,
+            conv->num_partitions, conv->newest, stride, conv->y_re,
+            conv->y_im);
+  fft_inverse(conv->fft, conv->y_re, conv->y_im, conv->time);
+
+  memcpy(conv->input, conv->input + conv->block, sizeof(float) * conv->block);
+}
+
+void convolver_process(struct convolver* conv, float* data, int count) {
+  const int block = conv->block;
+  const float* output = conv->time + block;
+
+  while (count > 0) {
+    int n = MIN(block - conv->fill, count);
+
+    memcpy(conv->input + block + conv->fill, data, sizeof(float) * n);
+    memcpy(data, output + conv->fill, sizeof(float) * n);
+    conv->fill += n;
+    data += n;
+    count -= n;
+
+    if (conv->fill == block) {
+      process_block(conv);
+      conv->fill = 0;
+    }
+  }
+}
@@ -0,0 +1,65 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_CONVOLVER_H_
+#define CRAS_SRC_DSP_CONVOLVER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "convolver" filters one channel with a finite impulse response using
+ * uniformly partitioned convolution in the frequency domain. The impulse
+ * response is cut into partitions of |block| frames. Every |block| input
+ * frames are transformed once and multiplied by the spectra of all
+ * partitions, so the cost per frame grows with the number of partitions
+ * instead of the length of the response. The output is delayed by one
+ * block, see convolver_get_delay(). */
+
+// The range of supported partition sizes, in frames.
+#define CONVOLVER_MIN_BLOCK 16
+#define CONVOLVER_MAX_BLOCK 8192
+
+struct convolver;
+
+/* Creates a convolver using the fastest kernel available.
+ * Args:
+ *    ir - The impulse response.
+ *    ir_len - The number of samples in ir.
+ *    block - The partition size, a power of two between CONVOLVER_MIN_BLOCK
+ *        and CONVOLVER_MAX_BLOCK.
+ * Returns:
+ *    The convolver, or NULL if the arguments are invalid or on allocation
+ *    failure.
+ */
+struct convolver* convolver_new(const float* ir, int ir_len, int block);
+
+/* Creates a convolver restricted to the CPU_* features in cpu_flags that the
+ * running CPU has. Lets tests and benchmarks compare the variants, pass 0
+ * for the portable C implementation. */
+struct convolver* convolver_new_with_flags(const float* ir,
+                                           int ir_len,
+                                           int block,
+                                           unsigned int cpu_flags);
+
+// Frees a convolver.
+void convolver_free(struct convolver* conv);
+
+// Returns the delay of the output of a convolver in frames, its block size.
+int convolver_get_delay(const struct convolver* conv);
+
+/* Filters a buffer of audio data in place.
+ * Args:
+ *    conv - The convolver we want to use.
+ *    data - The samples.
+ *    count - The number of samples in data, any number.
+ */
+void convolver_process(struct convolver* conv, float* data, int count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_CONVOLVER_H_
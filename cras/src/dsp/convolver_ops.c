@@ -0,0 +1,94 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/convolver_ops.h"
+
+#include <string.h>
+
+/* This file is compiled once per instruction set. CONVOLVER_BIN_ALIGN bins
+ * are held in CV_VECS GCC vectors of CV_LANES, which the compiler maps to
+ * AVX2 (with FMA contraction), SSE or NEON registers, or scalar code. */
+#ifdef OPS_AVX2
+#define OPS(a) a##_avx2
+#define CV_LANES 8
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#define CV_LANES 4
+#else
+#define OPS(a) a
+#define CV_LANES 4
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define CV_VECS (CONVOLVER_BIN_ALIGN / CV_LANES)
+
+typedef float cv_vec __attribute__((vector_size(CV_LANES * sizeof(float))));
+
+ALWAYS_INLINE cv_vec load(const float* p) {
+  cv_vec v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+ALWAYS_INLINE void store(float* p, cv_vec v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// Adds x * h to y for CONVOLVER_BIN_ALIGN complex bins.
+ALWAYS_INLINE void cmac(cv_vec* y_re,
+                        cv_vec* y_im,
+                        const float* x_re,
+                        const float* x_im,
+                        const float* h_re,
+                        const float* h_im) {
+  int j;
+
+#pragma GCC unroll 4
+  for (j = 0; j < CV_VECS; j++) {
+    cv_vec xr = load(x_re + j * CV_LANES);
+    cv_vec xi = load(x_im + j * CV_LANES);
+    cv_vec hr = load(h_re + j * CV_LANES);
+    cv_vec hi = load(h_im + j * CV_LANES);
+
+    y_re[j] += xr * hr - xi * hi;
+    y_im[j] += xr * hi + xi * hr;
+  }
+}
+
+void OPS(convolver_mac)(const float* x_re,
+                        const float* x_im,
+                        const float* h_re,
+                        const float* h_im,
+                        int num_partitions,
+                        int newest,
+                        int stride,
+                        float* y_re,
+                        float* y_im) {
+  int b, j, p, s;
+
+  /* The sums of a group of bins stay in registers while every partition is
+   * added to them. */
+  for (b = 0; b < stride; b += CONVOLVER_BIN_ALIGN) {
+    cv_vec acc_re[CV_VECS] = {};
+    cv_vec acc_im[CV_VECS] = {};
+
+    p = 0;
+    for (s = newest; s >= 0; s--, p++) {
+      cmac(acc_re, acc_im, x_re + s * stride + b, x_im + s * stride + b,
+           h_re + p * stride + b, h_im + p * stride + b);
+    }
+    for (s = num_partitions - 1; s > newest; s--, p++) {
+      cmac(acc_re, acc_im, x_re + s * stride + b, x_im + s * stride + b,
+           h_re + p * stride + b, h_im + p * stride + b);
+    }
+
+#pragma GCC unroll 4
+    for (j = 0; j < CV_VECS; j++) {
+      store(y_re + b + j * CV_LANES, acc_re[j]);
+      store(y_im + b + j * CV_LANES, acc_im[j]);
+    }
+  }
+}
@@ -0,0 +1,77 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_CONVOLVER_OPS_H_
+#define CRAS_SRC_DSP_CONVOLVER_OPS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The number of bins one kernel iteration processes. Spectra are padded to
+ * a multiple of this with zero bins. */
+#define CONVOLVER_BIN_ALIGN 16
+
+/* Multiplies the spectra of the recent input blocks by the spectra of the
+ * filter partitions and sums them, the frequency domain convolution of a
+ * uniformly partitioned filter. Spectra are stored as separate real and
+ * imaginary arrays of |stride| bins, one after another.
+ * Args:
+ *    x_re, x_im - The spectra of the last num_partitions input blocks, used
+ *        as a circular buffer.
+ *    h_re, h_im - The spectra of the filter partitions, in order.
+ *    num_partitions - The number of spectra in x and h.
+ *    newest - The index in x of the most recent input block, which is
+ *        multiplied by partition 0. The block before it goes with partition 1
+ *        and so on.
+ *    stride - The number of bins in each spectrum, a multiple of
+ *        CONVOLVER_BIN_ALIGN.
+ *    y_re, y_im - Receive the sum.
+ */
+typedef void (*convolver_mac_func)(const float* x_re,
+                                   const float* x_im,
+                                   const float* h_re,
+                                   const float* h_im,
+                                   int num_partitions,
+                                   int newest,
+                                   int stride,
+                                   float* y_re,
+                                   float* y_im);
+
+/* The same kernel built for different instruction sets. Every variant
+ * produces the same spectrum up to floating point contraction. */
+void convolver_mac(const float* x_re,
+                   const float* x_im,
+                   const float* h_re,
+                   const float* h_im,
+                   int num_partitions,
+                   int newest,
+                   int stride,
+                   float* y_re,
+                   float* y_im);
+void convolver_mac_avx2(const float* x_re,
+                        const float* x_im,
+                        const float* h_re,
+                        const float* h_im,
+                        int num_partitions,
+                        int newest,
+                        int stride,
+                        float* y_re,
+                        float* y_im);
+void convolver_mac_neon(const float* x_re,
+                        const float* x_im,
+                        const float* h_re,
+                        const float* h_im,
+                        int num_partitions,
+                        int newest,
+                        int stride,
+                        float* y_re,
+                        float* y_im);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_CONVOLVER_OPS_H_
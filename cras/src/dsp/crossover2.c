@@ -664,12 +664,48 @@ static void lr42_merge(struct lr42* lp,
 }
 #endif
 
+void crossover2_init_bands(struct crossover2* xo2,
+                           int num_bands,
+                           const float* freqs) {
+  int j, k;
+
+  memset(xo2, 0, sizeof(*xo2));
+  xo2->num_bands = num_bands;
+  for (k = 0; k < num_bands - 1; k++) {
+    lr42_set(&xo2->lp[k], BQ_LOWPASS, freqs[k]);
+    lr42_set(&xo2->hp[k], BQ_HIGHPASS, freqs[k]);
+    for (j = 0; j < k; j++) {
+      lr42_set(&xo2->ap_lp[k][j], BQ_LOWPASS, freqs[k]);
+      lr42_set(&xo2->ap_hp[k][j], BQ_HIGHPASS, freqs[k]);
+    }
+  }
+}
+
 void crossover2_init(struct crossover2* xo2, float freq1, float freq2) {
-  int i;
-  for (i = 0; i < 3; i++) {
-    float f = (i == 0) ? freq1 : freq2;
-    lr42_set(&xo2->lp[i], BQ_LOWPASS, f);
-    lr42_set(&xo2->hp[i], BQ_HIGHPASS, f);
+  const float freqs[] = {freq1, freq2};
+
+  crossover2_init_bands(xo2, 3, freqs);
+}
+
+void crossover2_process_bands(struct crossover2* xo2,
+                              int count,
+                              float* const* dataL,
+                              float* const* dataR) {
+  int j, k;
+
+  if (!count) {
+    return;
+  }
+
+  /* Band k holds everything above the previous splits. Split it, then
+   * align the phase of the bands below with the new split. */
+  for (k = 0; k < xo2->num_bands - 1; k++) {
+    lr42_split(&xo2->lp[k], &xo2->hp[k], count, dataL[k], dataR[k],
+               dataL[k + 1], dataR[k + 1]);
+    for (j = 0; j < k; j++) {
+      lr42_merge(&xo2->ap_lp[k][j], &xo2->ap_hp[k][j], count, dataL[j],
+                 dataR[j]);
+    }
   }
 }
 
@@ -681,11 +717,8 @@ void crossover2_process(struct crossover2* xo2,
                         float* data1R,
                         float* data2L,
                         float* data2R) {
-  if (!count) {
-    return;
-  }
+  float* const dataL[] = {data0L, data1L, data2L};
+  float* const dataR[] = {data0R, data1R, data2R};
 
-  lr42_split(&xo2->lp[0], &xo2->hp[0], count, data0L, data0R, data1L, data1R);
-  lr42_merge(&xo2->lp[1], &xo2->hp[1], count, data0L, data0R);
-  lr42_split(&xo2->lp[2], &xo2->hp[2], count, data1L, data1R, data2L, data2R);
+  crossover2_process_bands(xo2, count, dataL, dataR);
 }
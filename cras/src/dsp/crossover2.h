@@ -11,7 +11,8 @@ extern "C" {
 #endif
 
 /* "crossover2" is a two channel version of the "crossover" filter. It processes
- * two channels of data at once to increase performance. */
+ * two channels of data at once to increase performance. More channels are
+ * handled by one crossover2 per pair of channels. */
 
 /* An LR4 filter is two biquads with the same parameters connected in series:
  *
@@ -28,26 +29,37 @@ struct lr42 {
   float z1L, z1R, z2L, z2R;
 };
 
-/* Three bands crossover filter:
+// The maximum number of bands a crossover2 filter splits into.
+#define CROSSOVER2_MAX_BANDS 5
+
+/* Multiple bands crossover filter. Split k divides band k from band k + 1 at
+ * the k-th frequency. For three bands:
  *
- * INPUT --+-- lp0 --+-- lp1 --+---> LOW (0)
- *         |         |         |
- *         |         \-- hp1 --/
+ * INPUT --+-- lp[0] --+-- ap_lp[1][0] --+---> LOW (0)
+ *         |           |                 |
+ *         |           \-- ap_hp[1][0] --/
  *         |
- *         \-- hp0 --+-- lp2 ------> MID (1)
- *                   |
- *                   \-- hp2 ------> HIGH (2)
+ *         \-- hp[0] --+-- lp[1] ----------------> MID (1)
+ *                     |
+ *                     \-- hp[1] ----------------> HIGH (2)
  *
- *            [f0]       [f1]
+ *              [f0]            [f1]
  *
  * Each lp or hp is an LR4 filter, which consists of two second-order
- * lowpass or highpass butterworth filters.
+ * lowpass or highpass butterworth filters. Every band below a split is
+ * passed through the sum of that split's lp and hp, an allpass that keeps
+ * the phase of all bands aligned.
  */
 struct crossover2 {
-  struct lr42 lp[3], hp[3];
+  int num_bands;
+  // The lp and hp of each split.
+  struct lr42 lp[CROSSOVER2_MAX_BANDS - 1], hp[CROSSOVER2_MAX_BANDS - 1];
+  // The allpass of split k for band j is ap_lp[k][j] and ap_hp[k][j], j < k.
+  struct lr42 ap_lp[CROSSOVER2_MAX_BANDS - 1][CROSSOVER2_MAX_BANDS - 2];
+  struct lr42 ap_hp[CROSSOVER2_MAX_BANDS - 1][CROSSOVER2_MAX_BANDS - 2];
 };
 
-/* Initializes a crossover2 filter
+/* Initializes a three band crossover2 filter
  * Args:
  *    xo2 - The crossover2 filter we want to initialize.
  *    freq1 - The normalized frequency splits low and mid band.
@@ -55,6 +67,17 @@ struct crossover2 {
  */
 void crossover2_init(struct crossover2* xo2, float freq1, float freq2);
 
+/* Initializes a crossover2 filter with any number of bands.
+ * Args:
+ *    xo2 - The crossover2 filter we want to initialize.
+ *    num_bands - The number of bands, 1 to CROSSOVER2_MAX_BANDS.
+ *    freqs - The num_bands - 1 increasing normalized frequencies that split
+ *        the bands.
+ */
+void crossover2_init_bands(struct crossover2* xo2,
+                           int num_bands,
+                           const float* freqs);
+
 /* Splits input samples to three bands.
  * Args:
  *    xo2 - The crossover2 filter to use.
@@ -73,6 +96,19 @@ void crossover2_process(struct crossover2* xo2,
                         float* data2L,
                         float* data2R);
 
+/* Splits input samples to the bands of xo2.
+ * Args:
+ *    xo2 - The crossover2 filter to use.
+ *    count - The number of input samples.
+ *    dataL, dataR - One array per band. Element 0 holds the input samples
+ *        and receives the lowest band, element k receives band k. dataL and
+ *        dataR may point to the same arrays to filter a single channel.
+ */
+void crossover2_process_bands(struct crossover2* xo2,
+                              int count,
+                              float* const* dataL,
+                              float* const* dataR);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -11,9 +11,11 @@
 #include "cras/src/dsp/drc.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 
 #include "cras/src/dsp/drc_math.h"
+#include "cras/src/server/cras_mix.h"
 
 static void set_default_parameters(struct drc* drc);
 static void init_data_buffer(struct drc* drc);
@@ -22,15 +24,39 @@ static void init_crossover(struct drc* drc);
 static void init_kernel(struct drc* drc);
 static void free_data_buffer(struct drc* drc);
 static void free_emphasis_eq(struct drc* drc);
+static void free_crossover(struct drc* drc);
 static void free_kernel(struct drc* drc);
 
 struct drc* drc_new(float sample_rate) {
-  struct drc* drc = calloc(1, sizeof(*drc));
+  return drc_new_multichannel(sample_rate, 2, DRC_NUM_KERNELS);
+}
+
+struct drc* drc_new_multichannel(float sample_rate,
+                                 int num_channels,
+                                 int num_bands) {
+  return drc_new_with_flags(sample_rate, num_channels, num_bands,
+                            cpu_get_flags());
+}
+
+struct drc* drc_new_with_flags(float sample_rate,
+                               int num_channels,
+                               int num_bands,
+                               unsigned int cpu_flags) {
+  struct drc* drc;
+
+  if (num_channels <= 0 || num_bands <= 0 || num_bands > DRC_MAX_BANDS) {
+    return NULL;
+  }
+
+  drc = calloc(1, sizeof(*drc));
   if (!drc) {
     return NULL;
   }
 
   drc->sample_rate = sample_rate;
+  drc->num_channels = num_channels;
+  drc->num_bands = num_bands;
+  drc->cpu_flags = cpu_flags;
   set_default_parameters(drc);
   return drc;
 }
@@ -44,6 +70,7 @@ void drc_init(struct drc* drc) {
 
 void drc_free(struct drc* drc) {
   free_kernel(drc);
+  free_crossover(drc);
   free_emphasis_eq(drc);
   free_data_buffer(drc);
   free(drc);
@@ -51,28 +78,34 @@ void drc_free(struct drc* drc) {
 
 // Allocates temporary buffers used during drc_process().
 static void init_data_buffer(struct drc* drc) {
-  int i;
-  size_t size = sizeof(float) * DRC_PROCESS_MAX_FRAMES;
-
-  for (i = 0; i < DRC_NUM_CHANNELS; i++) {
-    drc->data1[i] = (float*)calloc(1, size);
-    drc->data2[i] = (float*)calloc(1, size);
+  int i, j;
+  int channels = drc->num_channels;
+  float** ptrs = (float**)calloc(drc->num_bands * channels, sizeof(float*));
+
+  drc->data_buffer = (float*)calloc(
+      (drc->num_bands - 1) * channels * DRC_PROCESS_MAX_FRAMES, sizeof(float));
+  for (i = 0; i < drc->num_bands; i++) {
+    drc->band_data[i] = &ptrs[i * channels];
+    if (i == 0) {
+      continue;
+    }
+    for (j = 0; j < channels; j++) {
+      drc->band_data[i][j] =
+          &drc->data_buffer[((i - 1) * channels + j) * DRC_PROCESS_MAX_FRAMES];
+    }
   }
 }
 
 // Frees temporary buffers
 static void free_data_buffer(struct drc* drc) {
-  int i;
-
-  for (i = 0; i < DRC_NUM_CHANNELS; i++) {
-    free(drc->data1[i]);
-    free(drc->data2[i]);
-  }
+  free(drc->band_data[0]);
+  free(drc->data_buffer);
 }
 
 void drc_set_param(struct drc* drc, int index, unsigned paramID, float value) {
   assert(paramID < PARAM_LAST);
-  if (paramID < PARAM_LAST) {
+  assert(index >= 0 && index < DRC_MAX_BANDS);
+  if (paramID < PARAM_LAST && index >= 0 && index < DRC_MAX_BANDS) {
     drc->parameters[index][paramID] = value;
   }
 }
@@ -84,10 +117,11 @@ static float drc_get_param(struct drc* drc, int index, unsigned paramID) {
 
 // Initializes parameters to default values.
 static void set_default_parameters(struct drc* drc) {
+  static const float lower_freq[DRC_MAX_BANDS] = {0, 200, 2000, 6000, 12000};
   float nyquist = drc->sample_rate / 2;
   int i;
 
-  for (i = 0; i < DRC_NUM_KERNELS; i++) {
+  for (i = 0; i < DRC_MAX_BANDS; i++) {
     float* param = drc->parameters[i];
     param[PARAM_THRESHOLD] = -24;                    // dB
     param[PARAM_KNEE] = 30;                          // dB
@@ -106,12 +140,9 @@ static void set_default_parameters(struct drc* drc) {
      * signal */
     param[PARAM_POST_GAIN] = 0;  // dB
     param[PARAM_ENABLED] = 0;
+    param[PARAM_CROSSOVER_LOWER_FREQ] = min(lower_freq[i] / nyquist, 1.0f);
   }
 
-  drc->parameters[0][PARAM_CROSSOVER_LOWER_FREQ] = 0;
-  drc->parameters[1][PARAM_CROSSOVER_LOWER_FREQ] = 200 / nyquist;
-  drc->parameters[2][PARAM_CROSSOVER_LOWER_FREQ] = 2000 / nyquist;
-
   // These parameters has only one copy
   drc->parameters[0][PARAM_FILTER_STAGE_GAIN] = 4.4f;  // dB
   drc->parameters[0][PARAM_FILTER_STAGE_RATIO] = 2;
@@ -177,15 +208,23 @@ static void init_emphasis_eq(struct drc* drc) {
   float stage_ratio = drc_get_param(drc, 0, PARAM_FILTER_STAGE_RATIO);
   float anchor_freq = drc_get_param(drc, 0, PARAM_FILTER_ANCHOR);
 
-  drc->emphasis_eq = eq2_new();
-  drc->deemphasis_eq = eq2_new();
+  // The emphasis filter already exists if it has input biquads.
+  if (!drc->emphasis_eq) {
+    drc->emphasis_eq = eqn_new_with_flags(drc->num_channels, drc->cpu_flags);
+  }
+  drc->deemphasis_eq = eqn_new_with_flags(drc->num_channels, drc->cpu_flags);
+  if (!drc->emphasis_eq || !drc->deemphasis_eq) {
+    return;
+  }
 
   for (i = 0; i < 2; i++) {
     emphasis_stage_pair_biquads(stage_gain, anchor_freq,
                                 anchor_freq / stage_ratio, &e, &d);
-    for (j = 0; j < 2; j++) {
-      eq2_append_biquad_direct(drc->emphasis_eq, j, &e);
-      eq2_append_biquad_direct(drc->deemphasis_eq, j, &d);
+    for (j = 0; j < drc->num_channels; j++) {
+      if (!drc->emphasis_disabled) {
+        eqn_append_biquad_direct(drc->emphasis_eq, j, &e);
+      }
+      eqn_append_biquad_direct(drc->deemphasis_eq, j, &d);
     }
     anchor_freq /= (stage_ratio * stage_ratio);
   }
@@ -193,50 +232,90 @@ static void init_emphasis_eq(struct drc* drc) {
 
 // Frees the emphasis and deemphasis filter
 static void free_emphasis_eq(struct drc* drc) {
-  eq2_free(drc->emphasis_eq);
-  eq2_free(drc->deemphasis_eq);
+  if (drc->emphasis_eq) {
+    eqn_free(drc->emphasis_eq);
+  }
+  if (drc->deemphasis_eq) {
+    eqn_free(drc->deemphasis_eq);
+  }
+}
+
+int drc_append_input_biquad(struct drc* drc,
+                            int channel,
+                            const struct biquad* biquad) {
+  if (!drc->emphasis_eq) {
+    drc->emphasis_eq = eqn_new_with_flags(drc->num_channels, drc->cpu_flags);
+    if (!drc->emphasis_eq) {
+      return -ENOMEM;
+    }
+  }
+  return eqn_append_biquad_direct(drc->emphasis_eq, channel, biquad);
 }
 
-// Initializes the crossover filter
+// Initializes the crossover filters
 static void init_crossover(struct drc* drc) {
-  float freq1 = drc->parameters[1][PARAM_CROSSOVER_LOWER_FREQ];
-  float freq2 = drc->parameters[2][PARAM_CROSSOVER_LOWER_FREQ];
+  float freqs[DRC_MAX_BANDS - 1];
+  int num_pairs = (drc->num_channels + 1) / 2;
+  int i;
 
-  crossover2_init(&drc->xo2, freq1, freq2);
+  for (i = 0; i < drc->num_bands - 1; i++) {
+    freqs[i] = drc->parameters[i + 1][PARAM_CROSSOVER_LOWER_FREQ];
+  }
+
+  drc->xo2 = (struct crossover2*)calloc(num_pairs, sizeof(*drc->xo2));
+  for (i = 0; i < num_pairs; i++) {
+    crossover2_init_bands(&drc->xo2[i], drc->num_bands, freqs);
+  }
+}
+
+// Frees the crossover filters
+static void free_crossover(struct drc* drc) {
+  free(drc->xo2);
+}
+
+// Sets the parameters of kernel |i| from drc->parameters.
+static void set_kernel_parameters(struct drc* drc, int i) {
+  float db_threshold = drc_get_param(drc, i, PARAM_THRESHOLD);
+  float db_knee = drc_get_param(drc, i, PARAM_KNEE);
+  float ratio = drc_get_param(drc, i, PARAM_RATIO);
+  float attack_time = drc_get_param(drc, i, PARAM_ATTACK);
+  float release_time = drc_get_param(drc, i, PARAM_RELEASE);
+  float pre_delay_time = drc_get_param(drc, i, PARAM_PRE_DELAY);
+  float releaseZone1 = drc_get_param(drc, i, PARAM_RELEASE_ZONE1);
+  float releaseZone2 = drc_get_param(drc, i, PARAM_RELEASE_ZONE2);
+  float releaseZone3 = drc_get_param(drc, i, PARAM_RELEASE_ZONE3);
+  float releaseZone4 = drc_get_param(drc, i, PARAM_RELEASE_ZONE4);
+  float db_post_gain = drc_get_param(drc, i, PARAM_POST_GAIN);
+  int enabled = drc_get_param(drc, i, PARAM_ENABLED);
+
+  dk_set_parameters(&drc->kernel[i], db_threshold, db_knee, ratio, attack_time,
+                    release_time, pre_delay_time, db_post_gain, releaseZone1,
+                    releaseZone2, releaseZone3, releaseZone4);
+
+  dk_set_enabled(&drc->kernel[i], enabled);
 }
 
 // Initializes the compressor kernels
 static void init_kernel(struct drc* drc) {
   int i;
 
-  for (i = 0; i < DRC_NUM_KERNELS; i++) {
-    dk_init(&drc->kernel[i], drc->sample_rate);
-
-    float db_threshold = drc_get_param(drc, i, PARAM_THRESHOLD);
-    float db_knee = drc_get_param(drc, i, PARAM_KNEE);
-    float ratio = drc_get_param(drc, i, PARAM_RATIO);
-    float attack_time = drc_get_param(drc, i, PARAM_ATTACK);
-    float release_time = drc_get_param(drc, i, PARAM_RELEASE);
-    float pre_delay_time = drc_get_param(drc, i, PARAM_PRE_DELAY);
-    float releaseZone1 = drc_get_param(drc, i, PARAM_RELEASE_ZONE1);
-    float releaseZone2 = drc_get_param(drc, i, PARAM_RELEASE_ZONE2);
-    float releaseZone3 = drc_get_param(drc, i, PARAM_RELEASE_ZONE3);
-    float releaseZone4 = drc_get_param(drc, i, PARAM_RELEASE_ZONE4);
-    float db_post_gain = drc_get_param(drc, i, PARAM_POST_GAIN);
-    int enabled = drc_get_param(drc, i, PARAM_ENABLED);
-
-    dk_set_parameters(&drc->kernel[i], db_threshold, db_knee, ratio,
-                      attack_time, release_time, pre_delay_time, db_post_gain,
-                      releaseZone1, releaseZone2, releaseZone3, releaseZone4);
-
-    dk_set_enabled(&drc->kernel[i], enabled);
+  for (i = 0; i < drc->num_bands; i++) {
+    dk_init(&drc->kernel[i], drc->sample_rate, drc->num_channels,
+            drc->cpu_flags);
+    set_kernel_parameters(drc, i);
+  }
+}
+
+void drc_update_kernel(struct drc* drc, int index) {
+  if (index >= 0 && index < drc->num_bands) {
+    set_kernel_parameters(drc, index);
   }
 }
 
 // Frees the compressor kernels
 static void free_kernel(struct drc* drc) {
   int i;
-  for (i = 0; i < DRC_NUM_KERNELS; i++) {
+  for (i = 0; i < drc->num_bands; i++) {
     dk_free(&drc->kernel[i]);
   }
 }
@@ -360,34 +439,62 @@ static void sum3(float* data, const float* data1, const float* data2, int n) {
 }
 #endif
 
+// Adds the upper bands of a channel to band 0.
+static void sum_bands(struct drc* drc, int channel, int frames) {
+  float* data = drc->band_data[0][channel];
+  int i, j;
+
+  for (i = 1; i + 1 < drc->num_bands; i += 2) {
+    sum3(data, drc->band_data[i][channel], drc->band_data[i + 1][channel],
+         frames);
+  }
+  if (i < drc->num_bands) {
+    const float* band = drc->band_data[i][channel];
+    for (j = 0; j < frames; j++) {
+      data[j] += band[j];
+    }
+  }
+}
+
 void drc_process(struct drc* drc, float** data, int frames) {
-  int i;
-  float** data1 = drc->data1;
-  float** data2 = drc->data2;
+  float* bandsL[DRC_MAX_BANDS];
+  float* bandsR[DRC_MAX_BANDS];
+  int i, j;
 
-  // Apply pre-emphasis filter if it is not disabled.
-  if (!drc->emphasis_disabled) {
-    eq2_process(drc->emphasis_eq, data[0], data[1], frames);
+  for (i = 0; i < drc->num_channels; i++) {
+    drc->band_data[0][i] = data[i];
   }
 
-  // Crossover
-  crossover2_process(&drc->xo2, frames, data[0], data[1], data1[0], data1[1],
-                     data2[0], data2[1]);
+  /* Apply the input filters and the pre-emphasis filter. It has no stages if
+   * there are no input filters and the emphasis is disabled. */
+  eqn_process(drc->emphasis_eq, data, frames);
+
+  /* Crossover, one pair of channels at a time. A last odd channel is
+   * filtered as both channels of its pair. */
+  for (i = 0; i < drc->num_channels; i += 2) {
+    int right = min(i + 1, drc->num_channels - 1);
+
+    for (j = 0; j < drc->num_bands; j++) {
+      bandsL[j] = drc->band_data[j][i];
+      bandsR[j] = drc->band_data[j][right];
+    }
+    crossover2_process_bands(&drc->xo2[i / 2], frames, bandsL, bandsR);
+  }
 
   /* Apply compression to each band of the signal. The processing is
    * performed in place.
    */
-  dk_process(&drc->kernel[0], data, frames);
-  dk_process(&drc->kernel[1], data1, frames);
-  dk_process(&drc->kernel[2], data2, frames);
+  for (i = 0; i < drc->num_bands; i++) {
+    dk_process(&drc->kernel[i], drc->band_data[i], frames);
+  }
 
-  // Sum the three bands of signal
-  for (i = 0; i < DRC_NUM_CHANNELS; i++) {
-    sum3(data[i], data1[i], data2[i], frames);
+  // Sum the bands of signal
+  for (i = 0; i < drc->num_channels; i++) {
+    sum_bands(drc, i, frames);
   }
 
   // Apply de-emphasis filter if emphasis is not disabled.
   if (!drc->emphasis_disabled) {
-    eq2_process(drc->deemphasis_eq, data[0], data[1], frames);
+    eqn_process(drc->deemphasis_eq, data, frames);
   }
 }
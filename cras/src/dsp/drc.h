@@ -17,16 +17,18 @@ extern "C" {
 
 #include "cras/src/dsp/crossover2.h"
 #include "cras/src/dsp/drc_kernel.h"
-#include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
 
 /* DRC implements a flexible audio dynamics compression effect such as is
  * commonly used in musical production and game audio. It lowers the volume of
  * the loudest parts of the signal and raises the volume of the softest parts,
  * making the sound richer, fuller, and more controlled.
  *
- * This is a three band stereo DRC. There are three compressor kernels, and each
- * can have its own parameters. If a kernel is disabled, it only delays the
- * signal and does not compress it.
+ * This is a multi band DRC for any number of channels, three band stereo by
+ * default. There is one compressor kernel per band, and each can have its own
+ * parameters. A kernel computes its gain from the loudest channel and applies
+ * it to all channels, so the channels stay balanced. If a kernel is disabled,
+ * it only delays the signal and does not compress it.
  *
  *                   INPUT
  *                     |
@@ -97,9 +99,12 @@ enum {
   PARAM_LAST
 };
 
-// The number of compressor kernels (also the number of bands).
+// The number of compressor kernels (also the number of bands) of drc_new().
 #define DRC_NUM_KERNELS 3
 
+// The maximum number of bands of a DRC.
+#define DRC_MAX_BANDS CROSSOVER2_MAX_BANDS
+
 // The maximum number of frames can be passed to drc_process() call.
 #define DRC_PROCESS_MAX_FRAMES 2048
 
@@ -110,27 +115,35 @@ struct drc {
   // sample rate in Hz
   float sample_rate;
 
-  // 1 to disable the emphasis and deemphasis, 0 to enable it.
+  // The number of channels and bands.
+  int num_channels;
+  int num_bands;
+
+  // The CPU_* flags the filters and kernels may use.
+  unsigned int cpu_flags;
+
+  /* 1 to disable the emphasis and deemphasis, 0 to enable it. Must be set
+   * before drc_init(). */
   int emphasis_disabled;
 
   // parameters holds the tweakable compressor parameters.
-  float parameters[DRC_NUM_KERNELS][PARAM_LAST];
+  float parameters[DRC_MAX_BANDS][PARAM_LAST];
 
-  // The emphasis filter and deemphasis filter
-  struct eq2* emphasis_eq;
-  struct eq2* deemphasis_eq;
+  /* The emphasis filter and deemphasis filter. The emphasis filter also runs
+   * the biquads of drc_append_input_biquad() before the emphasis. */
+  struct eqn* emphasis_eq;
+  struct eqn* deemphasis_eq;
 
-  // The crossover filter
-  struct crossover2 xo2;
+  // The crossover filters, one per pair of channels.
+  struct crossover2* xo2;
 
   // The compressor kernels
-  struct drc_kernel kernel[DRC_NUM_KERNELS];
+  struct drc_kernel kernel[DRC_MAX_BANDS];
 
-  /* Temporary buffer used during drc_process(). The mid and high band
-   * signal is stored in these buffers (the low band is stored in the
-   * original input buffer). */
-  float* data1[DRC_NUM_CHANNELS];
-  float* data2[DRC_NUM_CHANNELS];
+  /* The channels of each band during drc_process(). Band 0 is the original
+   * input buffer, the other bands are stored in data_buffer. */
+  float** band_data[DRC_MAX_BANDS];
+  float* data_buffer;
 };
 
 /* DRC needs the parameters to be set before initialization. So drc_new() should
@@ -150,22 +163,56 @@ struct drc {
  *  drc_free();
  */
 
-// Allocates a DRC.
+// Allocates a three band stereo DRC.
 struct drc* drc_new(float sample_rate);
 
+/* Allocates a DRC.
+ * Args:
+ *    sample_rate - The sample rate in Hz.
+ *    num_channels - The number of channels passed to drc_process().
+ *    num_bands - The number of bands, 1 to DRC_MAX_BANDS.
+ * Returns:
+ *    The DRC, or NULL if the layout is invalid or on allocation failure.
+ */
+struct drc* drc_new_multichannel(float sample_rate,
+                                 int num_channels,
+                                 int num_bands);
+
+/* Same as drc_new_multichannel() but restricted to the kernels allowed by
+ * cpu_flags, the CPU_* flags of cras_mix.h. */
+struct drc* drc_new_with_flags(float sample_rate,
+                               int num_channels,
+                               int num_bands,
+                               unsigned int cpu_flags);
+
 // Initializes a DRC.
 void drc_init(struct drc* drc);
 
 // Frees a DRC.
 void drc_free(struct drc* drc);
 
+/* Appends a biquad filter to one channel of the input of a DRC, before the
+ * emphasis. The input filters run in the same pass as the emphasis filter,
+ * which is cheaper than an EQ in front of the DRC. Must be called before
+ * drc_init().
+ * Args:
+ *    drc - The DRC we want to use.
+ *    channel - The channel to filter.
+ *    biquad - The parameters of the biquad, copied.
+ * Returns:
+ *    0 if success. Negative error code on failure.
+ */
+int drc_append_input_biquad(struct drc* drc,
+                            int channel,
+                            const struct biquad* biquad);
+
 /* Processes input data using a DRC.
  * Args:
  *    drc - The DRC we want to use.
- *    float **data - Pointers to input/output data. The input must be stereo
- *        and one channel is pointed by data[0], another pointed by data[1]. The
- *        output data is stored in the same place.
- *    frames - The number of frames to process.
+ *    float **data - Pointers to input/output data, one per channel of the
+ *        DRC. The output data is stored in the same place.
+ *    frames - The number of frames to process, at most
+ *        DRC_PROCESS_MAX_FRAMES.
  */
 void drc_process(struct drc* drc, float** data, int frames);
 
@@ -178,6 +225,16 @@ void drc_process(struct drc* drc, float** data, int frames);
  */
 void drc_set_param(struct drc* drc, int index, unsigned paramID, float value);
 
+/* Makes the compressor kernel of a band take the parameters set with
+ * drc_set_param() after drc_init(), keeping its state. Only the compressor
+ * parameters take effect this way: threshold, knee, ratio, attack, release,
+ * release zones and post gain.
+ * Args:
+ *    drc - The DRC we want to use.
+ *    index - The index of the kernel.
+ */
+void drc_update_kernel(struct drc* drc, int index);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
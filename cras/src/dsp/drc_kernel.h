@@ -15,11 +15,18 @@
 extern "C" {
 #endif
 
-#define DRC_NUM_CHANNELS 2
+struct drc_kernel_ops;
 
 struct drc_kernel {
   float sample_rate;
 
+  /* The number of channels. The compression gain is computed from the
+   * loudest channel and applied to all of them. */
+  int num_channels;
+
+  // The per division kernels picked for the running CPU.
+  const struct drc_kernel_ops* ops;
+
   /* The detector_average is the target gain obtained by looking at the
    * future samples in the lookahead buffer and applying the compression
    * curve on them. compressor_gain is the gain applied to the current
@@ -33,7 +40,7 @@ struct drc_kernel {
 
   // Lookahead section.
   unsigned last_pre_delay_frames;
-  float* pre_delay_buffers[DRC_NUM_CHANNELS];
+  float** pre_delay_buffers;
   int pre_delay_read_index;
   int pre_delay_write_index;
 
@@ -78,8 +85,18 @@ struct drc_kernel {
   float scaled_desired_gain;
 };
 
-// Initializes a drc kernel
-void dk_init(struct drc_kernel* dk, float sample_rate);
+/* Initializes a drc kernel
+ * Args:
+ *    dk - The DRC kernel.
+ *    sample_rate - The sample rate in Hz.
+ *    num_channels - The number of channels passed to dk_process().
+ *    cpu_flags - The CPU_* flags from cras_mix.h the kernel may use. Flags
+ *        the running CPU lacks are ignored.
+ */
+void dk_init(struct drc_kernel* dk,
+             float sample_rate,
+             int num_channels,
+             unsigned int cpu_flags);
 
 // Frees a drc kernel
 void dk_free(struct drc_kernel* dk);
@@ -101,7 +118,7 @@ void dk_set_parameters(struct drc_kernel* dk,
 // Enables or disables a drc kernel
 void dk_set_enabled(struct drc_kernel* dk, int enabled);
 
-/* Performs stereo-linked compression.
+/* Performs linked compression of all channels.
  * Args:
  *    dk - The DRC kernel.
  *    data - The pointers to the audio sample buffer. One pointer per channel.
@@ -0,0 +1,225 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/drc_kernel_ops.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cras/src/dsp/drc_math.h"
+
+/* This file is compiled once per instruction set. A division is processed as
+ * DK_VECS vectors of DK_LANES frames, which the compiler maps to AVX2 (with
+ * FMA contraction), SSE or NEON registers, or scalar code. */
+#ifdef OPS_AVX2
+#define OPS(a) a##_avx2
+#define DK_LANES 8
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#define DK_LANES 4
+#else
+#define OPS(a) a
+#define DK_LANES 4
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define DK_VECS (DRC_DIVISION_FRAMES / DK_LANES)
+
+typedef float dk_vec __attribute__((vector_size(DK_LANES * sizeof(float))));
+typedef int32_t dk_ivec
+    __attribute__((vector_size(DK_LANES * sizeof(int32_t))));
+
+ALWAYS_INLINE dk_vec load(const float* p) {
+  dk_vec v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+ALWAYS_INLINE void store(float* p, dk_vec v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+ALWAYS_INLINE dk_vec splat(float f) {
+  return (dk_vec){} + f;
+}
+
+// Takes a where mask is set and b elsewhere.
+ALWAYS_INLINE dk_vec select(dk_ivec mask, dk_vec a, dk_vec b) {
+  return (dk_vec)(((dk_ivec)a & mask) | ((dk_ivec)b & ~mask));
+}
+
+ALWAYS_INLINE dk_vec vabs(dk_vec v) {
+  return (dk_vec)((dk_ivec)v & 0x7fffffff);
+}
+
+ALWAYS_INLINE dk_vec vmax(dk_vec a, dk_vec b) {
+  return select(a > b, a, b);
+}
+
+// Vector versions of the drc_math.h approximations, lane by lane the same.
+ALWAYS_INLINE dk_vec decibels_to_linear_v(dk_vec decibels) {
+  const float A3 = 2.54408805631101131439208984375e-4f;
+  const float A2 = 6.628888659179210662841796875e-3f;
+  const float A1 = 0.11512924730777740478515625f;
+  const float A0 = 1.0f;
+  // Adding and removing 1.5 * 2^23 rounds to nearest like rintf().
+  const float round = 12582912.0f;
+  dk_vec fi, x, x2, table;
+  dk_ivec i;
+  int j;
+
+  decibels = select(decibels > 1048576.0f, splat(1048576.0f), decibels);
+  decibels = select(decibels < -1048576.0f, splat(-1048576.0f), decibels);
+  fi = (decibels + round) - round;
+  x = decibels - fi;
+  fi = select(fi > 100.0f, splat(100), fi);
+  // Also maps NaN to -100, as the scalar version does on x86.
+  fi = select(fi >= -100.0f, fi, splat(-100));
+  i = __builtin_convertvector(fi, dk_ivec);
+  for (j = 0; j < DK_LANES; j++) {
+    table[j] = db_to_linear[i[j] + 100];
+  }
+
+  x2 = x * x;
+  return ((A3 * x + A2) * x2 + (A1 * x + A0)) * table;
+}
+
+ALWAYS_INLINE dk_vec linear_to_decibels_v(dk_vec linear) {
+  const float A5 = 1.131880283355712890625f;
+  const float A4 = -4.258677959442138671875f;
+  const float A3 = 6.81631565093994140625f;
+  const float A2 = -6.1185703277587890625f;
+  const float A1 = 3.6505267620086669921875f;
+  const float A0 = -1.217894077301025390625f;
+  dk_ivec bits = (dk_ivec)linear;
+  dk_ivec exponent = (bits >> 23) & 0xff;
+  dk_vec x = (dk_vec)((bits & 0x807fffff) | (126 << 23));
+  dk_vec e = __builtin_convertvector(exponent - 126, dk_vec);
+  dk_ivec upper = x > 0.707106781186548f;
+  dk_vec x2, x4, y;
+
+  x = select(upper, x * 0.707106781186548f, x);
+  e = select(upper, e + 0.5f, e);
+
+  x2 = x * x;
+  x4 = x2 * x2;
+  y = ((A5 * x + A4) * x4 + (A3 * x + A2) * x2 + (A1 * x + A0)) * 20.0f +
+      e * 6.0205999132796239f;
+  y = select(exponent == 0xff, splat(NAN), y);
+  return select(linear <= 0.0f, splat(-1000), y);
+}
+
+ALWAYS_INLINE dk_vec warp_sinf_v(dk_vec x) {
+  const float A7 = -4.3330336920917034149169921875e-3f;
+  const float A5 = 7.9434238374233245849609375e-2f;
+  const float A3 = -0.645892798900604248046875f;
+  const float A1 = 1.5707910060882568359375f;
+  dk_vec x2 = x * x;
+  dk_vec x4 = x2 * x2;
+
+  return x * ((A7 * x2 + A5) * x4 + (A3 * x2 + A1));
+}
+
+/* The same curve as volume_gain() in drc_kernel.c. The exponent in the ratio
+ * portion is taken in dB, which saves the logf() per frame. */
+ALWAYS_INLINE dk_vec volume_gain_v(const struct drc_kernel* dk, dk_vec x) {
+  // 20 * log10(e), knee_expf(x) is decibels_to_linear(x * kExpDb).
+  const float kExpDb = 8.685889638065044f;
+  dk_vec knee, ratio;
+
+  knee = (dk->knee_alpha +
+          dk->knee_beta * decibels_to_linear_v(kExpDb * (-dk->K * x))) /
+         x;
+  ratio = dk->ratio_base *
+          decibels_to_linear_v(linear_to_decibels_v(x) * (dk->slope - 1));
+
+  return select(x < dk->linear_threshold, splat(1),
+                select(x < dk->knee_threshold, knee, ratio));
+}
+
+static void OPS(max_abs_division)(const struct drc_kernel* dk,
+                                  int div_start,
+                                  float* abs_input) {
+  int i, j;
+
+  for (j = 0; j < DK_VECS; j++) {
+    int offset = div_start + j * DK_LANES;
+    dk_vec m = vabs(load(&dk->pre_delay_buffers[0][offset]));
+
+    for (i = 1; i < dk->num_channels; i++) {
+      m = vmax(m, vabs(load(&dk->pre_delay_buffers[i][offset])));
+    }
+    store(&abs_input[j * DK_LANES], m);
+  }
+}
+
+static void OPS(division_gains)(const struct drc_kernel* dk,
+                                const float* abs_input,
+                                float* gain,
+                                float* release_rate) {
+  int j;
+
+  for (j = 0; j < DK_VECS; j++) {
+    dk_vec g = volume_gain_v(dk, load(&abs_input[j * DK_LANES]));
+    dk_vec rate = decibels_to_linear_v(linear_to_decibels_v(g) *
+                                       dk->sat_release_frames_inv_neg) -
+                  1;
+
+    rate = select(g > NEG_TWO_DB, splat(dk->sat_release_rate_at_neg_two_db),
+                  rate);
+    store(&gain[j * DK_LANES], g);
+    store(&release_rate[j * DK_LANES], rate);
+  }
+}
+
+static float OPS(compress_division)(const struct drc_kernel* dk,
+                                    int div_start) {
+  const float envelope_rate = dk->envelope_rate;
+  const int attack = envelope_rate < 1;
+  // Exponential approach to desired gain, from base in attack or 0 else.
+  const float base = attack ? dk->scaled_desired_gain : 0;
+  const float c = dk->compressor_gain - base;
+  const float r = attack ? 1 - envelope_rate : envelope_rate;
+  float r_lanes = 1;
+  dk_vec gain[DK_VECS];
+  dk_vec x;
+  int i, j;
+
+  // Lane j starts at c * r^(j + 1) and steps by r^DK_LANES per vector.
+  for (j = 0; j < DK_LANES; j++) {
+    r_lanes *= r;
+    x[j] = c * r_lanes;
+  }
+
+  for (j = 0; j < DK_VECS; j++) {
+    if (j) {
+      x *= r_lanes;
+    }
+    // Release exponentially increases the gain up to 1.0.
+    if (!attack) {
+      x = select(x > 1.0f, splat(1), x);
+    }
+    /* Warp pre-compression gain to smooth out sharp exponential
+     * transition points. */
+    gain[j] = dk->main_linear_gain * warp_sinf_v(x + base);
+  }
+
+  for (i = 0; i < dk->num_channels; i++) {
+    float* ptr = &dk->pre_delay_buffers[i][div_start];
+
+    for (j = 0; j < DK_VECS; j++) {
+      store(&ptr[j * DK_LANES], load(&ptr[j * DK_LANES]) * gain[j]);
+    }
+  }
+
+  return x[DK_LANES - 1] + base;
+}
+
+const struct drc_kernel_ops OPS(drc_kernel_ops) = {
+    .max_abs_division = OPS(max_abs_division),
+    .division_gains = OPS(division_gains),
+    .compress_division = OPS(compress_division),
+};
@@ -0,0 +1,48 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_DRC_KERNEL_OPS_H_
+#define CRAS_SRC_DSP_DRC_KERNEL_OPS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cras/src/dsp/drc_kernel.h"
+
+/* The number of frames the compressor gain is updated for at once. */
+#define DRC_DIVISION_FRAMES 32
+
+extern const struct drc_kernel_ops drc_kernel_ops;
+extern const struct drc_kernel_ops drc_kernel_ops_avx2;
+extern const struct drc_kernel_ops drc_kernel_ops_neon;
+
+/* The per division work of a drc kernel. Different architectures build the
+ * same source with their own vector instructions, every variant gives the
+ * same results up to floating point contraction. All functions work on the
+ * division that starts at |div_start| of each pre-delay buffer of |dk|. */
+struct drc_kernel_ops {
+  /* Stores the largest absolute value across all channels of each frame of
+   * the division to abs_input. */
+  void (*max_abs_division)(const struct drc_kernel* dk,
+                           int div_start,
+                           float* abs_input);
+  /* Evaluates the compression curve for each value in abs_input. Stores the
+   * resulting gain and the rate detector_average releases towards it. */
+  void (*division_gains)(const struct drc_kernel* dk,
+                         const float* abs_input,
+                         float* gain,
+                         float* release_rate);
+  /* Moves the compressor gain along the envelope of dk and applies it with
+   * the main gain to every channel. Returns the compressor gain at the end
+   * of the division. */
+  float (*compress_division)(const struct drc_kernel* dk, int div_start);
+};
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_DRC_KERNEL_OPS_H_
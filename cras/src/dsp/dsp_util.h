@@ -54,6 +54,21 @@ int dsp_util_interleave(float* const* input,
  */
 void dsp_enable_flush_denormal_to_zero();
 
+// The floating point mode of a thread saved by dsp_fp_mode_flush_denormal().
+struct dsp_fp_mode {
+  uint64_t saved;
+  int changed;
+};
+
+/* Flushes denormal numbers to zero on the calling thread until
+ * dsp_fp_mode_restore(), for dsp code running on a thread whose mode other
+ * code may have set. The mode before is saved in |mode|.
+ */
+void dsp_fp_mode_flush_denormal(struct dsp_fp_mode* mode);
+
+// Restores the floating point mode saved in |mode|.
+void dsp_fp_mode_restore(const struct dsp_fp_mode* mode);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -58,6 +58,24 @@ int eq2_append_biquad_direct(struct eq2* eq2,
   return 0;
 }
 
+int eq2_set_biquad(struct eq2* eq2,
+                   int channel,
+                   int index,
+                   const struct biquad* biquad) {
+  struct biquad* bq;
+
+  if (channel < 0 || channel > 1 || index < 0 || index >= eq2->n[channel]) {
+    return -EINVAL;
+  }
+  bq = &eq2->biquad[index][channel];
+  bq->b0 = biquad->b0;
+  bq->b1 = biquad->b1;
+  bq->b2 = biquad->b2;
+  bq->a1 = biquad->a1;
+  bq->a2 = biquad->a2;
+  return 0;
+}
+
 static inline void eq2_process_one(struct biquad (*bq)[2],
                                    float* data0,
                                    float* data1,
@@ -60,6 +60,21 @@ int eq2_append_biquad_direct(struct eq2* eq2,
                              int channel,
                              const struct biquad* biquad);
 
+/* Replaces the coefficients of an appended biquad filter, keeping its
+ * state, so the filter can change while audio runs through it.
+ * Args:
+ *    eq2 - The EQ2 we want to use.
+ *    channel - 0 or 1. The channel of the filter.
+ *    index - The filter, in the order they were appended to the channel.
+ *    biquad - The new coefficients, its state is ignored.
+ * Returns:
+ *    0 if success. -EINVAL if there is no such filter.
+ */
+int eq2_set_biquad(struct eq2* eq2,
+                   int channel,
+                   int index,
+                   const struct biquad* biquad);
+
 /* Process a buffer of audio data through the EQ2.
  * Args:
  *    eq2 - The EQ2 we want to use.
@@ -0,0 +1,194 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/eqn.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cras/src/dsp/eqn_ops.h"
+#include "cras/src/server/cras_mix.h"
+
+/* The stages are stored stage major, so stage s of lane group g is
+ * stages[s * num_groups + g]. */
+struct eqn {
+  int channels;
+  int num_groups;
+  // The number of stages of the longest channel.
+  int num_stages;
+  // The number of stages appended to each channel.
+  int* n;
+  struct eqn_stage* stages;
+  eqn_process_group_func process_group;
+};
+
+static eqn_process_group_func get_process_group(unsigned int cpu_flags) {
+#if HAVE_AVX2
+  if (cpu_flags & CPU_X86_AVX2) {
+    return eqn_process_group_avx2;
+  }
+#endif
+
+#if HAVE_NEON
+  if (cpu_flags & CPU_ARM_NEON) {
+    return eqn_process_group_neon;
+  }
+#endif
+
+  // default C implementation
+  return eqn_process_group;
+}
+
+struct eqn* eqn_new_with_flags(int channels, unsigned int cpu_flags) {
+  struct eqn* eqn;
+
+  if (channels <= 0) {
+    return NULL;
+  }
+
+  eqn = calloc(1, sizeof(*eqn));
+  if (!eqn) {
+    return NULL;
+  }
+  eqn->n = calloc(channels, sizeof(*eqn->n));
+  if (!eqn->n) {
+    free(eqn);
+    return NULL;
+  }
+  eqn->channels = channels;
+  eqn->num_groups = (channels + EQN_LANES - 1) / EQN_LANES;
+  eqn->process_group = get_process_group(cpu_flags & cpu_get_flags());
+  return eqn;
+}
+
+struct eqn* eqn_new(int channels) {
+  return eqn_new_with_flags(channels, cpu_get_flags());
+}
+
+void eqn_free(struct eqn* eqn) {
+  free(eqn->stages);
+  free(eqn->n);
+  free(eqn);
+}
+
+int eqn_get_num_channels(const struct eqn* eqn) {
+  return eqn->channels;
+}
+
+int eqn_get_num_biquads(const struct eqn* eqn, int channel) {
+  return eqn->n[channel];
+}
+
+// Adds one stage to every group, initialized to identity filters.
+static int add_stage(struct eqn* eqn) {
+  size_t old_size = sizeof(struct eqn_stage) * eqn->num_stages *
+                    eqn->num_groups;
+  size_t new_size = old_size + sizeof(struct eqn_stage) * eqn->num_groups;
+  struct eqn_stage* stages;
+  int g, l;
+
+  if (posix_memalign((void**)&stages, 32, new_size)) {
+    return -ENOMEM;
+  }
+  if (eqn->stages) {
+    memcpy(stages, eqn->stages, old_size);
+    free(eqn->stages);
+  }
+  memset((char*)stages + old_size, 0, new_size - old_size);
+  for (g = 0; g < eqn->num_groups; g++) {
+    struct eqn_stage* q = &stages[eqn->num_stages * eqn->num_groups + g];
+
+    for (l = 0; l < EQN_LANES; l++) {
+      q->b0[l] = 1;
+    }
+  }
+
+  eqn->stages = stages;
+  eqn->num_stages++;
+  return 0;
+}
+
+int eqn_append_biquad_direct(struct eqn* eqn,
+                             int channel,
+                             const struct biquad* biquad) {
+  struct eqn_stage* q;
+  int lane = channel % EQN_LANES;
+  int rc;
+
+  if (channel < 0 || channel >= eqn->channels) {
+    return -EINVAL;
+  }
+  if (eqn->n[channel] == eqn->num_stages) {
+    rc = add_stage(eqn);
+    if (rc) {
+      return rc;
+    }
+  }
+
+  q = &eqn->stages[eqn->n[channel]++ * eqn->num_groups + channel / EQN_LANES];
+  q->b0[lane] = biquad->b0;
+  q->b1[lane] = biquad->b1;
+  q->b2[lane] = biquad->b2;
+  q->a1[lane] = biquad->a1;
+  q->a2[lane] = biquad->a2;
+  q->x1[lane] = biquad->x1;
+  q->x2[lane] = biquad->x2;
+  q->y1[lane] = biquad->y1;
+  q->y2[lane] = biquad->y2;
+  return 0;
+}
+
+int eqn_set_biquad(struct eqn* eqn,
+                   int channel,
+                   int index,
+                   const struct biquad* biquad) {
+  struct eqn_stage* q;
+  int lane = channel % EQN_LANES;
+
+  if (channel < 0 || channel >= eqn->channels || index < 0 ||
+      index >= eqn->n[channel]) {
+    return -EINVAL;
+  }
+
+  q = &eqn->stages[index * eqn->num_groups + channel / EQN_LANES];
+  q->b0[lane] = biquad->b0;
+  q->b1[lane] = biquad->b1;
+  q->b2[lane] = biquad->b2;
+  q->a1[lane] = biquad->a1;
+  q->a2[lane] = biquad->a2;
+  return 0;
+}
+
+int eqn_append_biquad(struct eqn* eqn,
+                      int channel,
+                      enum biquad_type type,
+                      float freq,
+                      float Q,
+                      float gain) {
+  struct biquad bq;
+
+  biquad_set(&bq, type, freq, Q, gain);
+  return eqn_append_biquad_direct(eqn, channel, &bq);
+}
+
+void eqn_process(struct eqn* eqn, float* const* data, int count) {
+  int g;
+
+  if (!count || !eqn->num_stages) {
+    return;
+  }
+
+  for (g = 0; g < eqn->num_groups; g++) {
+    int first = g * EQN_LANES;
+    int channels = eqn->channels - first;
+
+    if (channels > EQN_LANES) {
+      channels = EQN_LANES;
+    }
+    eqn->process_group(&eqn->stages[g], eqn->num_stages, eqn->num_groups,
+                       data + first, channels, count);
+  }
+}
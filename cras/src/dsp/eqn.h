@@ -0,0 +1,101 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_EQN_H_
+#define CRAS_SRC_DSP_EQN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "eqN" is an N channel version of the "eq" filter. The channels are
+ * processed side by side in groups of EQN_LANES so one vector instruction
+ * runs the same biquad stage of every channel in a group. Each channel can
+ * have any number of stages, a channel with fewer stages than the others
+ * passes the missing ones through unchanged. */
+
+#include "cras/src/dsp/biquad.h"
+
+struct eqn;
+
+// Creates an EQN for |channels| channels, using the fastest kernel available.
+struct eqn* eqn_new(int channels);
+
+/* Creates an EQN restricted to the CPU_* features in cpu_flags that the
+ * running CPU has. Lets tests and benchmarks compare the variants, pass 0
+ * for the portable C implementation. */
+struct eqn* eqn_new_with_flags(int channels, unsigned int cpu_flags);
+
+// Frees an EQN.
+void eqn_free(struct eqn* eqn);
+
+// Returns the number of channels of an EQN.
+int eqn_get_num_channels(const struct eqn* eqn);
+
+// Returns the number of biquads appended to |channel| of an EQN.
+int eqn_get_num_biquads(const struct eqn* eqn, int channel);
+
+/* Appends a biquad filter to one channel of an EQN.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    channel - The channel we want to append the filter to.
+ *    type - The type of the biquad filter we want to append.
+ *    freq - The value should be in the range [0, 1]. It is relative to
+ *        half of the sampling rate.
+ *    Q, gain - The meaning depends on the type of the filter. See Web Audio
+ *        API for details.
+ * Returns:
+ *    0 if success. -EINVAL if channel is out of range, -ENOMEM if the
+ *    stage cannot be allocated.
+ */
+int eqn_append_biquad(struct eqn* eqn,
+                      int channel,
+                      enum biquad_type type,
+                      float freq,
+                      float Q,
+                      float gain);
+
+/* Appends a biquad filter to one channel of an EQN. This is similar to
+ * eqn_append_biquad(), but it specifies the biquad coefficients directly.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    channel - The channel we want to append the filter to.
+ *    biquad - The parameters for the biquad filter.
+ * Returns:
+ *    0 if success. -EINVAL if channel is out of range, -ENOMEM if the
+ *    stage cannot be allocated.
+ */
+int eqn_append_biquad_direct(struct eqn* eqn,
+                             int channel,
+                             const struct biquad* biquad);
+
+/* Replaces the coefficients of an appended biquad filter, keeping its
+ * state, so the filter can change while audio runs through it.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    channel - The channel of the filter.
+ *    index - The filter, in the order they were appended to the channel.
+ *    biquad - The new coefficients, its state is ignored.
+ * Returns:
+ *    0 if success. -EINVAL if there is no such filter.
+ */
+int eqn_set_biquad(struct eqn* eqn,
+                   int channel,
+                   int index,
+                   const struct biquad* biquad);
+
+/* Processes a buffer of audio data through the EQN in place.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    data - One array of samples per channel.
+ *    count - The number of samples in each of the arrays.
+ */
+void eqn_process(struct eqn* eqn, float* const* data, int count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_EQN_H_
@@ -0,0 +1,97 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/eqn_ops.h"
+
+#include <string.h>
+#include <sys/param.h>
+
+/* This file is compiled once per instruction set. The lanes of a stage are
+ * held in GCC vector types, which the compiler maps to one AVX2 register,
+ * two SSE or NEON registers, or scalar code. */
+#ifdef OPS_AVX2
+#define OPS(a) a##_avx2
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#else
+#define OPS(a) a
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+/* Frames transposed at a time. The block of all lanes stays in L1 while every
+ * stage runs over it. */
+#define EQN_BLOCK 64
+
+typedef float eqn_vec __attribute__((vector_size(EQN_LANES * sizeof(float))));
+
+ALWAYS_INLINE void run_stage(struct eqn_stage* q,
+                             float (*buf)[EQN_LANES],
+                             int frames) {
+  eqn_vec* v = (eqn_vec*)buf;
+  eqn_vec b0 = *(eqn_vec*)q->b0;
+  eqn_vec b1 = *(eqn_vec*)q->b1;
+  eqn_vec b2 = *(eqn_vec*)q->b2;
+  eqn_vec a1 = *(eqn_vec*)q->a1;
+  eqn_vec a2 = *(eqn_vec*)q->a2;
+  eqn_vec x1 = *(eqn_vec*)q->x1;
+  eqn_vec x2 = *(eqn_vec*)q->x2;
+  eqn_vec y1 = *(eqn_vec*)q->y1;
+  eqn_vec y2 = *(eqn_vec*)q->y2;
+  int j;
+
+  for (j = 0; j < frames; j++) {
+    eqn_vec x = v[j];
+    eqn_vec y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    v[j] = y;
+  }
+
+  *(eqn_vec*)q->x1 = x1;
+  *(eqn_vec*)q->x2 = x2;
+  *(eqn_vec*)q->y1 = y1;
+  *(eqn_vec*)q->y2 = y2;
+}
+
+void OPS(eqn_process_group)(struct eqn_stage* stages,
+                            int num_stages,
+                            int stride,
+                            float* const* data,
+                            int channels,
+                            int count) {
+  float buf[EQN_BLOCK][EQN_LANES] __attribute__((aligned(32)));
+  int start, frames, i, j, s;
+
+  // Lanes without a channel run on silence.
+  memset(buf, 0, sizeof(buf));
+
+  for (start = 0; start < count; start += frames) {
+    frames = MIN(EQN_BLOCK, count - start);
+
+    for (i = 0; i < channels; i++) {
+      const float* in = data[i] + start;
+
+      for (j = 0; j < frames; j++) {
+        buf[j][i] = in[j];
+      }
+    }
+
+    for (s = 0; s < num_stages; s++) {
+      run_stage(&stages[s * stride], buf, frames);
+    }
+
+    for (i = 0; i < channels; i++) {
+      float* out = data[i] + start;
+
+      for (j = 0; j < frames; j++) {
+        out[j] = buf[j][i];
+      }
+    }
+  }
+}
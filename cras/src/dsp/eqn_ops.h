@@ -0,0 +1,71 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_EQN_OPS_H_
+#define CRAS_SRC_DSP_EQN_OPS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The number of channels one kernel call processes side by side.
+#define EQN_LANES 8
+
+/* One biquad stage of EQN_LANES channels, laid out so that each field is a
+ * vector of the lanes. Unused lanes hold an identity filter. */
+struct eqn_stage {
+  float b0[EQN_LANES];
+  float b1[EQN_LANES];
+  float b2[EQN_LANES];
+  float a1[EQN_LANES];
+  float a2[EQN_LANES];
+  float x1[EQN_LANES];
+  float x2[EQN_LANES];
+  float y1[EQN_LANES];
+  float y2[EQN_LANES];
+} __attribute__((aligned(32)));
+
+/* Runs |num_stages| stages over up to EQN_LANES channels in place.
+ * Args:
+ *    stages - The stages of this group, |stride| entries apart.
+ *    num_stages - The number of stages to run.
+ *    stride - The distance between consecutive stages of the group.
+ *    data - One array of samples per channel.
+ *    channels - The number of arrays in data, at most EQN_LANES.
+ *    count - The number of samples in each array.
+ */
+typedef void (*eqn_process_group_func)(struct eqn_stage* stages,
+                                       int num_stages,
+                                       int stride,
+                                       float* const* data,
+                                       int channels,
+                                       int count);
+
+/* The same kernel built for different instruction sets. Every variant
+ * produces the same samples up to floating point contraction. */
+void eqn_process_group(struct eqn_stage* stages,
+                       int num_stages,
+                       int stride,
+                       float* const* data,
+                       int channels,
+                       int count);
+void eqn_process_group_avx2(struct eqn_stage* stages,
+                            int num_stages,
+                            int stride,
+                            float* const* data,
+                            int channels,
+                            int count);
+void eqn_process_group_neon(struct eqn_stage* stages,
+                            int num_stages,
+                            int stride,
+                            float* const* data,
+                            int channels,
+                            int count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_EQN_OPS_H_
@@ -0,0 +1,251 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Four lanes of a GCC vector type, SSE or NEON registers where available and
+ * scalar code otherwise. */
+typedef float fft_vec __attribute__((vector_size(4 * sizeof(float))));
+
+static inline fft_vec load(const float* p) {
+  fft_vec v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void store(float* p, fft_vec v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+struct fft {
+  int n;
+  // The size of the complex transform, n / 2.
+  int m;
+  // Bit reversal permutation of the m complex points.
+  int* bitrev;
+  /* Twiddles of the complex butterflies, cos and sin of 2 * pi * j / len for
+   * j < len / 2 of each stage len, one stage after another. */
+  float* w_cos;
+  float* w_sin;
+  // cos and sin of 2 * pi * k / n for k < m, to split the complex spectrum.
+  float* r_cos;
+  float* r_sin;
+  // The m complex points being transformed.
+  float* zr;
+  float* zi;
+};
+
+struct fft* fft_new(int n) {
+  struct fft* fft;
+  int bits = 0;
+  int i, len;
+  float* w;
+
+  if (n < 4 || (n & (n - 1))) {
+    return NULL;
+  }
+
+  fft = calloc(1, sizeof(*fft));
+  if (!fft) {
+    return NULL;
+  }
+  fft->n = n;
+  fft->m = n / 2;
+  fft->bitrev = calloc(fft->m, sizeof(*fft->bitrev));
+  // w_cos, w_sin, r_cos, r_sin, zr and zi share one allocation.
+  w = calloc(6 * fft->m, sizeof(*w));
+  if (!fft->bitrev || !w) {
+    free(fft->bitrev);
+    free(w);
+    free(fft);
+    return NULL;
+  }
+  fft->w_cos = w;
+  fft->w_sin = w + fft->m;
+  fft->r_cos = w + 2 * fft->m;
+  fft->r_sin = w + 3 * fft->m;
+  fft->zr = w + 4 * fft->m;
+  fft->zi = w + 5 * fft->m;
+
+  while ((1 << bits) < fft->m) {
+    bits++;
+  }
+  for (i = 0; i < fft->m; i++) {
+    int r = 0;
+    int b;
+
+    for (b = 0; b < bits; b++) {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    fft->bitrev[i] = r;
+  }
+
+  i = 0;
+  for (len = 2; len <= fft->m; len *= 2) {
+    int j;
+
+    for (j = 0; j < len / 2; j++, i++) {
+      fft->w_cos[i] = cos(2 * M_PI * j / len);
+      fft->w_sin[i] = sin(2 * M_PI * j / len);
+    }
+  }
+  for (i = 0; i < fft->m; i++) {
+    fft->r_cos[i] = cos(2 * M_PI * i / n);
+    fft->r_sin[i] = sin(2 * M_PI * i / n);
+  }
+
+  return fft;
+}
+
+void fft_free(struct fft* fft) {
+  free(fft->w_cos);
+  free(fft->bitrev);
+  free(fft);
+}
+
+int fft_get_size(const struct fft* fft) {
+  return fft->n;
+}
+
+/* Runs the butterflies of an m point complex FFT on zr and zi, which hold
+ * the input in bit reversed order. sign is -1 for the forward transform and
+ * 1 for the inverse. */
+static void butterflies(struct fft* fft, float sign) {
+  float* zr = fft->zr;
+  float* zi = fft->zi;
+  // Skips the twiddles of the first two stages, 1 and 2 of them.
+  const float* wc = fft->w_cos + 3;
+  const float* ws = fft->w_sin + 3;
+  int len, i, j;
+
+  /* The first two stages only multiply by 1 and sign * i, they are done
+   * together as radix-4 butterflies. */
+  if (fft->m == 2) {
+    float tr = zr[1], ti = zi[1];
+
+    zr[1] = zr[0] - tr;
+    zi[1] = zi[0] - ti;
+    zr[0] += tr;
+    zi[0] += ti;
+    return;
+  }
+  for (i = 0; i < fft->m; i += 4) {
+    float ar = zr[i] + zr[i + 1], ai = zi[i] + zi[i + 1];
+    float br = zr[i] - zr[i + 1], bi = zi[i] - zi[i + 1];
+    float cr = zr[i + 2] + zr[i + 3], ci = zi[i + 2] + zi[i + 3];
+    // (z[i + 2] - z[i + 3]) * sign * i
+    float dr = sign * (zi[i + 3] - zi[i + 2]);
+    float di = sign * (zr[i + 2] - zr[i + 3]);
+
+    zr[i] = ar + cr;
+    zi[i] = ai + ci;
+    zr[i + 1] = br + dr;
+    zi[i + 1] = bi + di;
+    zr[i + 2] = ar - cr;
+    zi[i + 2] = ai - ci;
+    zr[i + 3] = br - dr;
+    zi[i + 3] = bi - di;
+  }
+
+  // The remaining stages have at least 4 butterflies per group.
+  for (len = 8; len <= fft->m; len *= 2) {
+    int half = len / 2;
+
+    for (i = 0; i < fft->m; i += len) {
+      float* ar = zr + i;
+      float* ai = zi + i;
+      float* br = zr + i + half;
+      float* bi = zi + i + half;
+
+      for (j = 0; j < half; j += 4) {
+        fft_vec wr = load(wc + j);
+        fft_vec wi = sign * load(ws + j);
+        fft_vec xr = load(ar + j);
+        fft_vec xi = load(ai + j);
+        fft_vec yr = load(br + j);
+        fft_vec yi = load(bi + j);
+        fft_vec tr = yr * wr - yi * wi;
+        fft_vec ti = yr * wi + yi * wr;
+
+        store(br + j, xr - tr);
+        store(bi + j, xi - ti);
+        store(ar + j, xr + tr);
+        store(ai + j, xi + ti);
+      }
+    }
+    wc += half;
+    ws += half;
+  }
+}
+
+void fft_forward(struct fft* fft, const float* in, float* re, float* im) {
+  const int m = fft->m;
+  const float* zr = fft->zr;
+  const float* zi = fft->zi;
+  int k;
+
+  // Even samples go to the real part, odd samples to the imaginary part.
+  for (k = 0; k < m; k++) {
+    fft->zr[fft->bitrev[k]] = in[2 * k];
+    fft->zi[fft->bitrev[k]] = in[2 * k + 1];
+  }
+  butterflies(fft, -1);
+
+  re[0] = zr[0] + zi[0];
+  im[0] = 0;
+  re[m] = zr[0] - zi[0];
+  im[m] = 0;
+  for (k = 1; k < m; k++) {
+    /* E and O are the spectra of the even and odd samples:
+     *   E = (Z[k] + conj(Z[m - k])) / 2
+     *   O = (Z[k] - conj(Z[m - k])) / 2i
+     *   X[k] = E + exp(-2 pi i k / n) * O */
+    float er = (zr[k] + zr[m - k]) / 2;
+    float ei = (zi[k] - zi[m - k]) / 2;
+    float o_r = (zi[k] + zi[m - k]) / 2;
+    float o_i = (zr[m - k] - zr[k]) / 2;
+    float c = fft->r_cos[k];
+    float s = fft->r_sin[k];
+
+    re[k] = er + o_r * c + o_i * s;
+    im[k] = ei + o_i * c - o_r * s;
+  }
+}
+
+void fft_inverse(struct fft* fft,
+                 const float* re,
+                 const float* im,
+                 float* out) {
+  const int m = fft->m;
+  int k;
+
+  for (k = 0; k < m; k++) {
+    /* Rebuilds the spectra of the even and odd samples, twice over:
+     *   E = X[k] + conj(X[m - k])
+     *   O = (X[k] - conj(X[m - k])) * exp(2 pi i k / n)
+     *   Z[k] = E + i * O */
+    float er = re[k] + re[m - k];
+    float ei = im[k] - im[m - k];
+    float dr = re[k] - re[m - k];
+    float di = im[k] + im[m - k];
+    float c = fft->r_cos[k];
+    float s = fft->r_sin[k];
+    float o_r = dr * c - di * s;
+    float o_i = dr * s + di * c;
+
+    fft->zr[fft->bitrev[k]] = er - o_i;
+    fft->zi[fft->bitrev[k]] = ei + o_r;
+  }
+  butterflies(fft, 1);
+
+  for (k = 0; k < m; k++) {
+    out[2 * k] = fft->zr[k];
+    out[2 * k + 1] = fft->zi[k];
+  }
+}
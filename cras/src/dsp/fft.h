@@ -0,0 +1,55 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_FFT_H_
+#define CRAS_SRC_DSP_FFT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A radix-2 FFT of real signals. A transform of n real samples gives the
+ * n / 2 + 1 non-negative frequency bins, stored as separate arrays of the
+ * real and imaginary parts. Internally it is a complex FFT of n / 2 points
+ * on the even and odd samples. */
+
+struct fft;
+
+/* Creates an FFT of n real samples.
+ * Args:
+ *    n - The transform size, a power of two no less than 4.
+ * Returns:
+ *    The FFT, or NULL if n is not supported or on allocation failure.
+ */
+struct fft* fft_new(int n);
+
+// Frees an FFT.
+void fft_free(struct fft* fft);
+
+// Returns the transform size of an FFT.
+int fft_get_size(const struct fft* fft);
+
+/* Computes the spectrum of n real samples.
+ * Args:
+ *    fft - The FFT we want to use.
+ *    in - n samples.
+ *    re, im - Receive the n / 2 + 1 bins of the spectrum.
+ */
+void fft_forward(struct fft* fft, const float* in, float* re, float* im);
+
+/* Computes n real samples from the non-negative half of their spectrum. The
+ * result is not normalized, it is n times the inverse transform.
+ * Args:
+ *    fft - The FFT we want to use.
+ *    re, im - The n / 2 + 1 bins of the spectrum.
+ *    out - Receives n samples.
+ */
+void fft_inverse(struct fft* fft, const float* re, const float* im, float* out);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_FFT_H_
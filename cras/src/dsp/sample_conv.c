@@ -0,0 +1,41 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/sample_conv.h"
+
+#include "cras/src/dsp/sample_conv_ops.h"
+#include "cras/src/server/cras_mix.h"
+
+static const struct cras_sample_conv_ops* ops = &sample_conv_ops;
+
+static const struct cras_sample_conv_ops* get_sample_conv_ops(
+    unsigned int cpu_flags) {
+#if HAVE_AVX2
+  if (cpu_flags & CPU_X86_AVX2) {
+    return &sample_conv_ops_avx2;
+  }
+#endif
+
+#if HAVE_NEON
+  if (cpu_flags & CPU_ARM_NEON) {
+    return &sample_conv_ops_neon;
+  }
+#endif
+
+  // default C implementation
+  return &sample_conv_ops;
+}
+
+void cras_sample_conv_init() {
+  ops = get_sample_conv_ops(cpu_get_flags());
+}
+
+void cras_sample_conv_init_with_flags(unsigned int cpu_flags) {
+  ops = get_sample_conv_ops(cpu_flags & cpu_get_flags());
+}
+
+const struct cras_sample_conv_ops* cras_sample_conv_get_ops() {
+  return ops;
+}
@@ -0,0 +1,22 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_SAMPLE_CONV_H_
+#define CRAS_SRC_DSP_SAMPLE_CONV_H_
+
+#include "cras/src/dsp/sample_conv_ops.h"
+
+// Selects the sample conversion kernels for the running CPU.
+void cras_sample_conv_init();
+
+/* Selects the sample conversion kernels for cpu_flags, restricted to the
+ * features the running CPU has. Lets tests and benchmarks compare the
+ * variants, pass 0 for the portable C kernels. */
+void cras_sample_conv_init_with_flags(unsigned int cpu_flags);
+
+// Returns the selected kernels, the portable C ones until an init call.
+const struct cras_sample_conv_ops* cras_sample_conv_get_ops();
+
+#endif
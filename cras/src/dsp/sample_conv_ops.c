@@ -0,0 +1,433 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/dsp/sample_conv_ops.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
+/* This file is compiled once per instruction set and relies on the compiler
+ * to vectorize the loops. The (de)interleave kernels are instantiated with a
+ * constant format and channel count so every pair gets its own loop with
+ * constant strides. */
+#ifdef OPS_AVX2
+#define OPS(a) a##_avx2
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#else
+#define OPS(a) a
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// Clamps f to [lo, hi]. NaN becomes 0 instead of failing both compares.
+ALWAYS_INLINE float clamp_sample(float f, float lo, float hi) {
+  return f != f ? 0.f : MAX(MIN(f, hi), lo);
+}
+
+/*
+ * Interleaved format converters.
+ */
+
+static void OPS(u8_to_s16le)(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out) {
+  uint16_t* __restrict__ _out = (uint16_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (uint16_t)((int16_t)in[i] - 0x80) << 8;
+  }
+}
+
+static void OPS(s243le_to_s16le)(const uint8_t* in,
+                                 size_t in_samples,
+                                 uint8_t* out) {
+  uint16_t* __restrict__ _out = (uint16_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (uint16_t)in[3 * i + 1] | (uint16_t)in[3 * i + 2] << 8;
+  }
+}
+
+static void OPS(s24le_to_s16le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int32_t* __restrict__ _in = (const int32_t*)in;
+  uint16_t* __restrict__ _out = (uint16_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (int16_t)((_in[i] & 0x00ffffff) >> 8);
+  }
+}
+
+static void OPS(s32le_to_s16le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int32_t* __restrict__ _in = (const int32_t*)in;
+  uint16_t* __restrict__ _out = (uint16_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (int16_t)(_in[i] >> 16);
+  }
+}
+
+static void OPS(s16le_to_u8)(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out) {
+  const int16_t* __restrict__ _in = (const int16_t*)in;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    out[i] = (uint8_t)(_in[i] >> 8) + 128;
+  }
+}
+
+static void OPS(s16le_to_s243le)(const uint8_t* in,
+                                 size_t in_samples,
+                                 uint8_t* out) {
+  const uint16_t* __restrict__ _in = (const uint16_t*)in;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    out[3 * i] = 0;
+    out[3 * i + 1] = _in[i] & 0xff;
+    out[3 * i + 2] = _in[i] >> 8;
+  }
+}
+
+static void OPS(s16le_to_s24le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int16_t* __restrict__ _in = (const int16_t*)in;
+  uint32_t* __restrict__ _out = (uint32_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (uint32_t)(int32_t)_in[i] << 8;
+  }
+}
+
+static void OPS(s16le_to_s32le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int16_t* __restrict__ _in = (const int16_t*)in;
+  uint32_t* __restrict__ _out = (uint32_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (uint32_t)(int32_t)_in[i] << 16;
+  }
+}
+
+static void OPS(u8_to_f32le)(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out) {
+  float* __restrict__ _out = (float*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = ((int16_t)in[i] - 0x80) / 128.f;
+  }
+}
+
+static void OPS(s16le_to_f32le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int16_t* __restrict__ _in = (const int16_t*)in;
+  float* __restrict__ _out = (float*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = _in[i] / 32768.f;
+  }
+}
+
+static void OPS(s243le_to_f32le)(const uint8_t* in,
+                                 size_t in_samples,
+                                 uint8_t* out) {
+  float* __restrict__ _out = (float*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    int32_t sample =
+        (int32_t)((uint32_t)in[3 * i] << 8 | (uint32_t)in[3 * i + 1] << 16 |
+                  (uint32_t)in[3 * i + 2] << 24);
+    _out[i] = (sample >> 8) / 8388608.f;
+  }
+}
+
+static void OPS(s24le_to_f32le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int32_t* __restrict__ _in = (const int32_t*)in;
+  float* __restrict__ _out = (float*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = ((int32_t)((uint32_t)_in[i] << 8) >> 8) / 8388608.f;
+  }
+}
+
+static void OPS(s32le_to_f32le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const int32_t* __restrict__ _in = (const int32_t*)in;
+  float* __restrict__ _out = (float*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = _in[i] / 2147483648.f;
+  }
+}
+
+static void OPS(f32le_to_u8)(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out) {
+  const float* __restrict__ _in = (const float*)in;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    out[i] = (uint8_t)(clamp_sample(_in[i] * 128.f, -128.f, 127.f) + 128);
+  }
+}
+
+static void OPS(f32le_to_s16le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const float* __restrict__ _in = (const float*)in;
+  int16_t* __restrict__ _out = (int16_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (int16_t)clamp_sample(_in[i] * 32768.f, -32768.f, 32767.f);
+  }
+}
+
+static void OPS(f32le_to_s243le)(const uint8_t* in,
+                                 size_t in_samples,
+                                 uint8_t* out) {
+  const float* __restrict__ _in = (const float*)in;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    int32_t sample =
+        (int32_t)clamp_sample(_in[i] * 8388608.f, -8388608.f, 8388607.f);
+    out[3 * i] = sample & 0xff;
+    out[3 * i + 1] = (sample >> 8) & 0xff;
+    out[3 * i + 2] = (sample >> 16) & 0xff;
+  }
+}
+
+static void OPS(f32le_to_s24le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const float* __restrict__ _in = (const float*)in;
+  int32_t* __restrict__ _out = (int32_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (int32_t)clamp_sample(_in[i] * 8388608.f, -8388608.f, 8388607.f);
+  }
+}
+
+static void OPS(f32le_to_s32le)(const uint8_t* in,
+                                size_t in_samples,
+                                uint8_t* out) {
+  const float* __restrict__ _in = (const float*)in;
+  int32_t* __restrict__ _out = (int32_t*)out;
+  size_t i;
+
+  for (i = 0; i < in_samples; i++) {
+    /* INT32_MAX isn't representable as a float, so saturate on the
+     * input side before scaling. */
+    float f = clamp_sample(_in[i], -1.f, 1.f);
+
+    _out[i] = f >= 1.f ? INT32_MAX : (int32_t)(f * 2147483648.f);
+  }
+}
+
+/*
+ * Planar float (de)interleavers.
+ */
+
+// Reads sample i of an interleaved buffer as a float in [-1.0, 1.0).
+ALWAYS_INLINE float load_sample(snd_pcm_format_t format,
+                                const uint8_t* in,
+                                size_t i) {
+  switch (format) {
+    case SND_PCM_FORMAT_S16_LE:
+      return ((const int16_t*)in)[i] / 32768.0f;
+    case SND_PCM_FORMAT_S24_LE:
+      // The padding byte is shifted out.
+      return (int32_t)((uint32_t)((const int32_t*)in)[i] << 8) /
+             2147483648.0f;
+    case SND_PCM_FORMAT_S24_3LE:
+      return (int32_t)((uint32_t)in[3 * i] << 8 |
+                       (uint32_t)in[3 * i + 1] << 16 |
+                       (uint32_t)in[3 * i + 2] << 24) /
+             2147483648.0f;
+    default:
+      return ((const int32_t*)in)[i] / 2147483648.0f;
+  }
+}
+
+/* Scales f to 32 bits and rounds to nearest, ties away from zero. Saturates
+ * below 2^31, the next float up doesn't fit in an int32_t. NaN becomes 0. */
+ALWAYS_INLINE int32_t float_to_s32(float f) {
+  f *= 2147483648.0f;
+  f += (f >= 0) ? 0.5f : -0.5f;
+  return (int32_t)clamp_sample(f, -2147483648.0f, 2147483520.0f);
+}
+
+// Writes f as sample i of an interleaved buffer.
+ALWAYS_INLINE void store_sample(snd_pcm_format_t format,
+                                uint8_t* out,
+                                size_t i,
+                                float f) {
+  int32_t s;
+
+  switch (format) {
+    case SND_PCM_FORMAT_S16_LE:
+      f *= 32768.0f;
+      f += (f >= 0) ? 0.5f : -0.5f;
+      ((int16_t*)out)[i] = (int32_t)clamp_sample(f, -32768.0f, 32767.0f);
+      break;
+    case SND_PCM_FORMAT_S24_LE:
+      ((int32_t*)out)[i] = (float_to_s32(f) >> 8) & 0x00ffffff;
+      break;
+    case SND_PCM_FORMAT_S24_3LE:
+      s = float_to_s32(f) >> 8;
+      out[3 * i] = s & 0xff;
+      out[3 * i + 1] = (s >> 8) & 0xff;
+      out[3 * i + 2] = (s >> 16) & 0xff;
+      break;
+    default:
+      ((int32_t*)out)[i] = float_to_s32(f);
+      break;
+  }
+}
+
+ALWAYS_INLINE void deinterleave_n(snd_pcm_format_t format,
+                                  const uint8_t* __restrict__ in,
+                                  float* const* out,
+                                  size_t channels,
+                                  size_t frames) {
+  size_t c, i;
+
+  for (c = 0; c < channels; c++) {
+    float* __restrict__ plane = out[c];
+
+    for (i = 0; i < frames; i++) {
+      plane[i] = load_sample(format, in, i * channels + c);
+    }
+  }
+}
+
+ALWAYS_INLINE void interleave_n(snd_pcm_format_t format,
+                                float* const* in,
+                                uint8_t* __restrict__ out,
+                                size_t channels,
+                                size_t frames) {
+  size_t c, i;
+
+  for (c = 0; c < channels; c++) {
+    const float* __restrict__ plane = in[c];
+
+    for (i = 0; i < frames; i++) {
+      store_sample(format, out, i * channels + c, plane[i]);
+    }
+  }
+}
+
+/* Instantiates fn for a constant format and, for the common layouts, a
+ * constant channel count. */
+#define CALL_WITH_CHANNELS(fn, format, src, dst, channels, frames) \
+  switch (channels) {                                              \
+    case 1:                                                        \
+      fn(format, src, dst, 1, frames);                             \
+      break;                                                       \
+    case 2:                                                        \
+      fn(format, src, dst, 2, frames);                             \
+      break;                                                       \
+    case 4:                                                        \
+      fn(format, src, dst, 4, frames);                             \
+      break;                                                       \
+    case 6:                                                        \
+      fn(format, src, dst, 6, frames);                             \
+      break;                                                       \
+    case 8:                                                        \
+      fn(format, src, dst, 8, frames);                             \
+      break;                                                       \
+    default:                                                       \
+      fn(format, src, dst, channels, frames);                      \
+      break;                                                       \
+  }
+
+#define CALL_WITH_FORMAT(fn, format, src, dst, channels, frames)            \
+  switch (format) {                                                         \
+    case SND_PCM_FORMAT_S16_LE:                                             \
+      CALL_WITH_CHANNELS(fn, SND_PCM_FORMAT_S16_LE, src, dst, channels,     \
+                         frames);                                           \
+      return 0;                                                             \
+    case SND_PCM_FORMAT_S24_LE:                                             \
+      CALL_WITH_CHANNELS(fn, SND_PCM_FORMAT_S24_LE, src, dst, channels,     \
+                         frames);                                           \
+      return 0;                                                             \
+    case SND_PCM_FORMAT_S24_3LE:                                            \
+      CALL_WITH_CHANNELS(fn, SND_PCM_FORMAT_S24_3LE, src, dst, channels,    \
+                         frames);                                           \
+      return 0;                                                             \
+    case SND_PCM_FORMAT_S32_LE:                                             \
+      CALL_WITH_CHANNELS(fn, SND_PCM_FORMAT_S32_LE, src, dst, channels,     \
+                         frames);                                           \
+      return 0;                                                             \
+    default:                                                                \
+      return -EINVAL;                                                       \
+  }
+
+static int OPS(deinterleave)(snd_pcm_format_t format,
+                             const uint8_t* in,
+                             float* const* out,
+                             size_t channels,
+                             size_t frames) {
+  CALL_WITH_FORMAT(deinterleave_n, format, in, out, channels, frames);
+}
+
+static int OPS(interleave)(snd_pcm_format_t format,
+                           float* const* in,
+                           uint8_t* out,
+                           size_t channels,
+                           size_t frames) {
+  CALL_WITH_FORMAT(interleave_n, format, in, out, channels, frames);
+}
+
+const struct cras_sample_conv_ops OPS(sample_conv_ops) = {
+    .u8_to_s16le = OPS(u8_to_s16le),
+    .s243le_to_s16le = OPS(s243le_to_s16le),
+    .s24le_to_s16le = OPS(s24le_to_s16le),
+    .s32le_to_s16le = OPS(s32le_to_s16le),
+    .s16le_to_u8 = OPS(s16le_to_u8),
+    .s16le_to_s243le = OPS(s16le_to_s243le),
+    .s16le_to_s24le = OPS(s16le_to_s24le),
+    .s16le_to_s32le = OPS(s16le_to_s32le),
+    .u8_to_f32le = OPS(u8_to_f32le),
+    .s16le_to_f32le = OPS(s16le_to_f32le),
+    .s243le_to_f32le = OPS(s243le_to_f32le),
+    .s24le_to_f32le = OPS(s24le_to_f32le),
+    .s32le_to_f32le = OPS(s32le_to_f32le),
+    .f32le_to_u8 = OPS(f32le_to_u8),
+    .f32le_to_s16le = OPS(f32le_to_s16le),
+    .f32le_to_s243le = OPS(f32le_to_s243le),
+    .f32le_to_s24le = OPS(f32le_to_s24le),
+    .f32le_to_s32le = OPS(f32le_to_s32le),
+    .deinterleave = OPS(deinterleave),
+    .interleave = OPS(interleave),
+};
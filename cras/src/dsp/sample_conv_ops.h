@@ -0,0 +1,61 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_DSP_SAMPLE_CONV_OPS_H_
+#define CRAS_SRC_DSP_SAMPLE_CONV_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cras_audio_format.h"
+
+extern const struct cras_sample_conv_ops sample_conv_ops;
+extern const struct cras_sample_conv_ops sample_conv_ops_avx2;
+extern const struct cras_sample_conv_ops sample_conv_ops_neon;
+
+/* Sample format conversion kernels. Different architectures build the same
+ * kernels with their own vector instructions and wrap them into
+ * cras_sample_conv_ops. Every variant produces the same samples.
+ */
+struct cras_sample_conv_ops {
+  /* Interleaved format converters, in_samples counts samples of all
+   * channels. Same results as the convert_* functions of the same name in
+   * cras_fmt_conv_ops.h. */
+  void (*u8_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s243le_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s24le_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s32le_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s16le_to_u8)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s16le_to_s243le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s16le_to_s24le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s16le_to_s32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*u8_to_f32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s16le_to_f32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s243le_to_f32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s24le_to_f32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*s32le_to_f32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*f32le_to_u8)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*f32le_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*f32le_to_s243le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*f32le_to_s24le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  void (*f32le_to_s32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  /* Converts interleaved S16_LE, S24_LE, S24_3LE or S32_LE frames to one
+   * float buffer per channel in range [-1.0, 1.0). Returns -EINVAL for other
+   * formats. */
+  int (*deinterleave)(snd_pcm_format_t format,
+                      const uint8_t* in,
+                      float* const* out,
+                      size_t channels,
+                      size_t frames);
+  /* The inverse of deinterleave. Rounds to nearest with ties away from zero
+   * and saturates to the range of the format. */
+  int (*interleave)(snd_pcm_format_t format,
+                    float* const* in,
+                    uint8_t* out,
+                    size_t channels,
+                    size_t frames);
+};
+
+#endif
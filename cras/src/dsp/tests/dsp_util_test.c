@@ -12,6 +12,7 @@
 
 #include "cras/src/dsp/drc_math.h"
 #include "cras/src/dsp/dsp_util.h"
+#include "cras/src/dsp/sample_conv.h"
 
 // Constant for converting time to milliseconds.
 #define BILLION 1000000000LL
@@ -168,6 +169,7 @@ int main(int argc, char** argv) {
   int samples = 16;
 
   dsp_enable_flush_denormal_to_zero();
+  cras_sample_conv_init();
 
   // Print headings for TestRounding output.
   printf(
@@ -182,18 +184,9 @@ int main(int argc, char** argv) {
   TestRounding(2000000000.f / 32768.f, 32767, samples);
   TestRounding(-2000000000.f / 32768.f, -32768, samples);
 
-  // Infinity produces zero on arm64.
-#if defined(__aarch64__)
-#define EXPECTED_INF_RESULT 0
-#define EXPECTED_NEGINF_RESULT 0
-#elif defined(__i386__) || defined(__x86_64__)
-#define EXPECTED_INF_RESULT -32768
-#define EXPECTED_NEGINF_RESULT 0
-#else
+  // Out of range values, infinity included, saturate on all architectures.
 #define EXPECTED_INF_RESULT 32767
 #define EXPECTED_NEGINF_RESULT -32768
-#endif
-
   TestRounding(5000000000.f / 32768.f, EXPECTED_INF_RESULT, samples);
   TestRounding(-5000000000.f / 32768.f, EXPECTED_NEGINF_RESULT, samples);
 
@@ -220,14 +213,8 @@ int main(int argc, char** argv) {
   TestRounding(1.0f / 32768.0f - e, 1, samples);
   TestRounding(-1.0f / 32768.0f + e, -1, samples);
 
-  // Rounding on 'tie' is different for Intel.
-#if defined(__i386__) || defined(__x86_64__)
-  TestRounding(0.5f / 32768.0f, 0, samples);  // Expect round to even
-  TestRounding(-0.5f / 32768.0f, 0, samples);
-#else
   TestRounding(0.5f / 32768.0f, 1, samples);  // Expect round away
   TestRounding(-0.5f / 32768.0f, -1, samples);
-#endif
 
   TestRounding(0.5f / 32768.0f + e, 1, samples);
   TestRounding(-0.5f / 32768.0f - e, 1, samples);
@@ -252,12 +239,8 @@ int main(int argc, char** argv) {
   denorm.ieee.mantissa = 1;
   TestRounding(denorm.f, 0, samples);
 
-  // Test NaNs. Caveat Results vary by implementation.
-#if defined(__i386__) || defined(__x86_64__)
-#define EXPECTED_NAN_RESULT -32768
-#else
+  // Test NaNs. They are converted to silence.
 #define EXPECTED_NAN_RESULT 0
-#endif
   union ieee754_float nan;  // Quiet NaN
   nan.ieee.negative = 0;
   nan.ieee.exponent = 0xff;
@@ -19,6 +19,8 @@
  *  running - Once the connections are established, the client will listen for
  *    requests on aud_fd and fill the shm region with the requested number of
  *    samples. This happens in the aud_cb specified in the stream parameters.
+ *    Streams created with EVENTFD_WAKEUPS listen on an eventfd from the server
+ *    instead and find the requested number of samples in the shm header.
  */
 
 #ifndef _GNU_SOURCE
@@ -153,6 +155,10 @@ struct client_stream {
   cras_stream_id_t id;
   // After server connects audio messages come in here.
   int aud_fd;  // audio messages from server come in here.
+  // With EVENTFD_WAKEUPS, the server signals audio requests here instead.
+  int notify_fd;
+  // With EVENTFD_WAKEUPS, replies to the server are signaled here.
+  int reply_fd;
   // playback, capture, or loopback (see CRAS_STREAM_DIRECTION).
   enum CRAS_STREAM_DIRECTION direction;
   // Currently only used for CRAS_INPUT_STREAM_FLAG.
@@ -1149,6 +1155,57 @@ static int read_with_wake_fd(int wake_fd,
 
   return nread;
 }
+
+/* Waits for the next audio message from the server, or for a poke on the
+ * wake fd. Streams using EVENTFD_WAKEUPS have the message rebuilt from the
+ * stream direction and the frames left in shm. Returns the number of bytes
+ * read, 0 if only woken. */
+static int read_audio_message(struct client_stream* stream,
+                              struct audio_message* msg) {
+  uint64_t event;
+  int rc;
+
+  /* While we are warming up, aud_fd may not be valid and some
+   * shared memory resources may not yet be available. */
+  if (stream->thread.state == CRAS_THREAD_WARMUP) {
+    return read_with_wake_fd(stream->wake_fds[0], -1, (uint8_t*)msg,
+                             sizeof(*msg));
+  }
+  if (!(stream->flags & EVENTFD_WAKEUPS)) {
+    return read_with_wake_fd(stream->wake_fds[0], stream->aud_fd,
+                             (uint8_t*)msg, sizeof(*msg));
+  }
+
+  rc = read_with_wake_fd(stream->wake_fds[0], stream->notify_fd,
+                         (uint8_t*)&event, sizeof(event));
+  if (rc <= 0) {
+    return rc;
+  }
+  msg->id = (stream->direction == CRAS_STREAM_OUTPUT)
+                ? AUDIO_MESSAGE_REQUEST_DATA
+                : AUDIO_MESSAGE_DATA_READY;
+  msg->error = 0;
+  msg->frames = cras_shm_get_wakeup_frames(stream->shm);
+  return rc;
+}
+
+/* Sends a reply to the server, through the reply eventfd with the error left
+ * in shm for streams using EVENTFD_WAKEUPS. */
+static int write_audio_reply(struct client_stream* stream,
+                             const struct audio_message* msg) {
+  uint64_t event = 1;
+  int rc;
+
+  if (!(stream->flags & EVENTFD_WAKEUPS)) {
+    rc = write(stream->aud_fd, msg, sizeof(*msg));
+    return (rc == sizeof(*msg)) ? 0 : -EPIPE;
+  }
+
+  cras_shm_set_reply_error(stream->shm, msg->error);
+  rc = write(stream->reply_fd, &event, sizeof(event));
+  return (rc == sizeof(event)) ? 0 : -EPIPE;
+}
+
 /* Check the availability and configures a capture buffer.
  * Args:
  *     stream - The input stream to configure buffer for.
@@ -1191,7 +1248,6 @@ static int send_capture_reply(struct client_stream* stream,
                               unsigned int frames,
                               int err) {
   struct audio_message aud_msg;
-  int rc;
 
   if (!cras_stream_uses_input_hw(stream->direction)) {
     return 0;
@@ -1201,12 +1257,7 @@ static int send_capture_reply(struct client_stream* stream,
   aud_msg.frames = frames;
   aud_msg.error = err;
 
-  rc = write(stream->aud_fd, &aud_msg, sizeof(aud_msg));
-  if (rc != sizeof(aud_msg)) {
-    return -EPIPE;
-  }
-
-  return 0;
+  return write_audio_reply(stream, &aud_msg);
 }
 
 /* For capture streams this handles the message signalling that data is ready to
@@ -1284,7 +1335,6 @@ static int send_playback_reply(struct client_stream* stream,
                                unsigned int frames,
                                int error) {
   struct audio_message aud_msg;
-  int rc;
 
   if (!cras_stream_uses_output_hw(stream->direction)) {
     return 0;
@@ -1294,12 +1344,7 @@ static int send_playback_reply(struct client_stream* stream,
   aud_msg.frames = frames;
   aud_msg.error = error;
 
-  rc = write(stream->aud_fd, &aud_msg, sizeof(aud_msg));
-  if (rc != sizeof(aud_msg)) {
-    return -EPIPE;
-  }
-
-  return 0;
+  return write_audio_reply(stream, &aud_msg);
 }
 
 /* For playback streams when current buffer is empty, this handles the request
@@ -1327,8 +1372,16 @@ static int handle_playback_request(struct client_stream* stream,
 
   buf = cras_shm_get_write_buffer_base(shm);
 
-  // Limit the amount of frames to the configured amount.
-  num_frames = MIN(num_frames, config->cb_threshold);
+  /* Limit the amount of frames to the configured amount. A ring can take
+   * more from streams that are OK with bulk audio, up to where it wraps. */
+  if (cras_shm_is_ring(shm)) {
+    if (!(stream->flags & BULK_AUDIO_OK)) {
+      num_frames = MIN(num_frames, config->cb_threshold);
+    }
+    num_frames = MIN(num_frames, cras_shm_ring_frames_to_wrap(shm));
+  } else {
+    num_frames = MIN(num_frames, config->cb_threshold);
+  }
 
   cras_timespec_to_timespec(&ts, &shm->header->ts);
   cras_timespec_to_timespec(&dropped_samples_duration,
@@ -1389,7 +1442,6 @@ static void* audio_thread(void* arg) {
   struct client_stream* stream = (struct client_stream*)arg;
   int thread_terminated = 0;
   struct audio_message aud_msg;
-  int aud_fd;
   int num_read;
 
   if (arg == NULL) {
@@ -1404,11 +1456,7 @@ static void* audio_thread(void* arg) {
   pthread_mutex_unlock(&stream->client->stream_start_lock);
 
   while (thread_is_running(&stream->thread) && !thread_terminated) {
-    /* While we are warming up, aud_fd may not be valid and some
-     * shared memory resources may not yet be available. */
-    aud_fd = (stream->thread.state == CRAS_THREAD_WARMUP) ? -1 : stream->aud_fd;
-    num_read = read_with_wake_fd(stream->wake_fds[0], aud_fd,
-                                 (uint8_t*)&aud_msg, sizeof(aud_msg));
+    num_read = read_audio_message(stream, &aud_msg);
     if (num_read < 0) {
       return (void*)-EIO;
     }
@@ -1552,13 +1600,16 @@ static void free_shm(struct client_stream* stream) {
  * thread that will handle requests from the server. */
 static int stream_connected(struct client_stream* stream,
                             const struct cras_client_stream_connected* msg,
-                            const int stream_fds[2],
+                            const int stream_fds[4],
                             const unsigned int num_fds) {
   int rc, samples_prot;
   unsigned int i;
   struct cras_shm_info header_info, samples_info;
 
-  if (msg->err || num_fds != 2) {
+  /* The eventfds only come along when EVENTFD_WAKEUPS was asked for and
+   * the server supports it. */
+  if (msg->err ||
+      (num_fds != 2 && !(num_fds == 4 && stream->flags & EVENTFD_WAKEUPS))) {
     syslog(LOG_WARNING, "cras_client: Error setting up stream %d\n", msg->err);
     rc = msg->err;
     goto err_ret;
@@ -1592,6 +1643,13 @@ static int stream_connected(struct client_stream* stream,
   cras_shm_copy_shared_config(stream->shm);
   cras_shm_set_volume_scaler(stream->shm, stream->volume_scaler);
 
+  if (num_fds == 4) {
+    stream->notify_fd = stream_fds[2];
+    stream->reply_fd = stream_fds[3];
+  } else {
+    stream->flags &= ~EVENTFD_WAKEUPS;
+  }
+
   stream->thread.state = CRAS_THREAD_RUNNING;
   wake_aud_thread(stream);
 
@@ -1747,6 +1805,10 @@ static int client_thread_rm_stream(struct cras_client* client,
   if (stream->aud_fd >= 0) {
     close(stream->aud_fd);
   }
+  if (stream->notify_fd >= 0) {
+    close(stream->notify_fd);
+    close(stream->reply_fd);
+  }
 
   free(stream->config);
   free(stream);
@@ -1878,8 +1940,8 @@ static int handle_message_from_server(struct cras_client* client) {
   struct cras_client_message* msg;
   int rc = 0;
   int nread;
-  int server_fds[2];
-  unsigned int num_fds = 2;
+  int server_fds[4];
+  unsigned int num_fds = 4;
 
   msg = (struct cras_client_message*)buf;
   nread = cras_recv_with_fds(client->server_fd, buf, sizeof(buf), server_fds,
@@ -1907,7 +1969,7 @@ static int handle_message_from_server(struct cras_client* client) {
           (struct cras_client_stream_connected*)msg;
       struct client_stream* stream = stream_from_id(client, cmsg->stream_id);
       if (stream == NULL) {
-        if (num_fds != 2) {
+        if (num_fds != 2 && num_fds != 4) {
           syslog(LOG_WARNING,
                  "cras_client: Error receiving "
                  "stream 0x%x connected message",
@@ -1920,8 +1982,9 @@ static int handle_message_from_server(struct cras_client* client) {
          * callback. However, sometimes a stream is removed
          * before it is connected.
          */
-        close(server_fds[0]);
-        close(server_fds[1]);
+        for (unsigned int i = 0; i < num_fds; i++) {
+          close(server_fds[i]);
+        }
         break;
       }
       rc = stream_connected(stream, cmsg, server_fds, num_fds);
@@ -2660,6 +2723,8 @@ static inline int cras_client_send_add_stream_command_message(
   }
   memcpy(stream->config, config, sizeof(*config));
   stream->aud_fd = -1;
+  stream->notify_fd = -1;
+  stream->reply_fd = -1;
   stream->wake_fds[0] = -1;
   stream->wake_fds[1] = -1;
   stream->direction = config->direction;
@@ -2946,6 +3011,21 @@ const struct main_thread_debug_info* cras_client_get_main_thread_debug_info(
   return debug_info;
 }
 
+const struct cras_dsp_debug_info* cras_client_get_dsp_debug_info(
+    const struct cras_client* client) {
+  const struct cras_dsp_debug_info* debug_info;
+  int lock_rc;
+
+  lock_rc = server_state_rdlock(client);
+  if (lock_rc) {
+    return 0;
+  }
+
+  debug_info = &client->server_state->dsp_debug_info;
+  server_state_unlock(client, lock_rc);
+  return debug_info;
+}
+
 const struct cras_bt_debug_info* cras_client_get_bt_debug_info(
     const struct cras_client* client) {
   const struct cras_bt_debug_info* debug_info;
@@ -2961,6 +3041,21 @@ const struct cras_bt_debug_info* cras_client_get_bt_debug_info(
   return debug_info;
 }
 
+const struct cras_sco_io_stats* cras_client_get_sco_io_stats(
+    const struct cras_client* client) {
+  const struct cras_sco_io_stats* stats;
+  int lock_rc;
+
+  lock_rc = server_state_rdlock(client);
+  if (lock_rc) {
+    return 0;
+  }
+
+  stats = &client->server_state->sco_io_stats;
+  server_state_unlock(client, lock_rc);
+  return stats;
+}
+
 const struct cras_audio_thread_snapshot_buffer*
 cras_client_get_audio_thread_snapshot_buffer(const struct cras_client* client) {
   const struct cras_audio_thread_snapshot_buffer* snapshot_buffer;
@@ -3405,6 +3500,20 @@ int cras_client_dump_dsp_info(struct cras_client* client) {
   return write_message_to_server(client, &msg.header);
 }
 
+int cras_client_set_dsp_control(struct cras_client* client,
+                                const char* title,
+                                int port,
+                                float value) {
+  struct cras_set_dsp_control msg;
+
+  if (client == NULL || title == NULL) {
+    return -EINVAL;
+  }
+
+  cras_fill_set_dsp_control(&msg, title, port, value);
+  return write_message_to_server(client, &msg.header);
+}
+
 int cras_client_update_audio_debug_info(
     struct cras_client* client,
     void (*debug_info_cb)(struct cras_client*)) {
@@ -3516,6 +3625,22 @@ int cras_client_update_main_thread_debug_info(
   return write_message_to_server(client, &msg.header);
 }
 
+int cras_client_update_dsp_debug_info(
+    struct cras_client* client,
+    void (*debug_info_cb)(struct cras_client*)) {
+  struct cras_dump_dsp_profile msg;
+
+  if (client == NULL) {
+    return -EINVAL;
+  }
+  if (client->debug_info_callback != NULL) {
+    return -EINVAL;
+  }
+  client->debug_info_callback = debug_info_cb;
+  cras_fill_dump_dsp_profile(&msg);
+  return write_message_to_server(client, &msg.header);
+}
+
 int cras_client_update_bt_debug_info(
     struct cras_client* client,
     void (*debug_info_cb)(struct cras_client*)) {
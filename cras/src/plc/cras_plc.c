@@ -5,12 +5,16 @@
 
 #include "cras/src/plc/cras_plc.h"
 
-#include <float.h>
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define MSBC_SAMPLE_SIZE 2  // 2 bytes
 #define MSBC_PKT_LEN 57     // Packet length without the header
 #define MSBC_FS 120         // Frame Size
@@ -162,26 +166,82 @@ int cras_msbc_plc_handle_good_frames(struct cras_msbc_plc* state,
   return MSBC_CODE_SIZE;
 }
 
-float cross_correlation(int16_t* x, int16_t* y) {
-  float sum = 0, x2 = 0, y2 = 0;
+/* Returns the sum of x[i] * y[i] over PLC_TL samples. Every product and
+ * partial sum is exact, so the result doesn't depend on the order of the
+ * additions. */
+static int64_t dot_product(const int16_t* x, const int16_t* y) {
+#if defined(__ARM_NEON)
+  int64x2_t sum = vdupq_n_s64(0);
+
+  for (int i = 0; i < PLC_TL; i += 4) {
+    sum = vpadalq_s32(sum, vmull_s16(vld1_s16(&x[i]), vld1_s16(&y[i])));
+  }
+  return vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+#elif defined(__SSE2__)
+  /* pmaddwd adds pairs of products in 32 bits, which only overflows for two
+   * products of -32768 * -32768 to 2^31. No pair adds up to -2^31, so each
+   * pair minus one is widened and the ones are added back at the end. */
+  const __m128i one = _mm_set1_epi32(1);
+  __m128i sum = _mm_setzero_si128();
+  int64_t lanes[2];
+
+  for (int i = 0; i < PLC_TL; i += 8) {
+    __m128i p = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&x[i]),
+                               _mm_loadu_si128((const __m128i*)&y[i]));
+    p = _mm_sub_epi32(p, one);
+    __m128i sign = _mm_srai_epi32(p, 31);
+    sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(p, sign));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(p, sign));
+  }
+  _mm_storeu_si128((__m128i*)lanes, sum);
+  return lanes[0] + lanes[1] + PLC_TL / 2;
+#else
+  int64_t sum = 0;
 
   for (int i = 0; i < PLC_TL; i++) {
-    sum += ((float)x[i]) * y[i];
-    x2 += ((float)x[i]) * x[i];
-    y2 += ((float)y[i]) * y[i];
+    sum += (int32_t)x[i] * y[i];
   }
-  return sum / sqrtf(x2 * y2);
+  return sum;
+#endif
+}
+
+static int32_t square(int16_t x) {
+  return (int32_t)x * x;
 }
 
+/* Finds the lag in the history whose PLC_TL samples have the highest
+ * normalized cross correlation with the last PLC_TL samples:
+ *
+ *   sum(x * y) / sqrt(sum(x * x) * sum(y * y))
+ *
+ * The energy of the template sum(x * x) is the same for every lag, and the
+ * energy of the window sum(y * y) is kept as a running sum as it slides,
+ * so each lag costs a single dot product. Only positive correlations are
+ * considered, and the first of equal ones wins. */
 int pattern_match(int16_t* hist) {
+  const int16_t* tmpl = &hist[PLC_HL - PLC_TL];
+  int64_t sum, y2;
+  double score, max_score = 0;
   int best = 0;
-  float cn, max_cn = FLT_MIN;
 
+  if (dot_product(tmpl, tmpl) == 0) {
+    return 0;
+  }
+
+  y2 = dot_product(hist, hist);
   for (int i = 0; i < PLC_WL; i++) {
-    cn = cross_correlation(&hist[PLC_HL - PLC_TL], &hist[i]);
-    if (cn > max_cn) {
+    if (i > 0) {
+      y2 += square(hist[i + PLC_TL - 1]) - square(hist[i - 1]);
+    }
+    sum = dot_product(tmpl, &hist[i]);
+    if (sum <= 0) {
+      continue;
+    }
+    // The square of the correlation, times the energy of the template.
+    score = (double)sum * sum / y2;
+    if (score > max_score) {
       best = i;
-      max_cn = cn;
+      max_score = score;
     }
   }
   return best;
@@ -13,6 +13,8 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/param.h>
 #include <syslog.h>
 
@@ -46,6 +48,16 @@
  */
 #define MAX_CONTINUOUS_ZERO_SLEEP_METRIC_LIMIT 1000
 
+// Max number of ready fds handled from an epoll set per wake up.
+#define MAX_EPOLL_EVENTS 16
+
+// Number of commands that can be queued to an audio thread, a power of 2.
+#define CMD_RING_SIZE 64
+// Max size of a command message.
+#define MAX_MSG_SIZE 256
+// Max number of devices a stream is added to at once.
+#define MAX_STREAM_DEVS 10
+
 // Messages that can be sent from the main context to the audio thread.
 enum AUDIO_THREAD_COMMAND {
   AUDIO_THREAD_ADD_OPEN_DEV,
@@ -60,6 +72,9 @@ enum AUDIO_THREAD_COMMAND {
   AUDIO_THREAD_DEV_START_RAMP,
   AUDIO_THREAD_REMOVE_CALLBACK,
   AUDIO_THREAD_AEC_DUMP,
+  AUDIO_THREAD_FIND_STREAM,
+  AUDIO_THREAD_DETACH_OPEN_DEVS,
+  AUDIO_THREAD_ATTACH_OPEN_DEVS,
 };
 
 struct audio_thread_msg {
@@ -91,7 +106,7 @@ struct audio_thread_rm_callback_msg {
 struct audio_thread_add_rm_stream_msg {
   struct audio_thread_msg header;
   struct cras_rstream* stream;
-  struct cras_iodev** devs;
+  struct cras_iodev* devs[MAX_STREAM_DEVS];
   unsigned int num_devs;
 };
 
@@ -113,6 +128,54 @@ struct audio_thread_aec_dump_msg {
   int fd;
 };
 
+/* Moves open devices between threads. Detach takes dev, devices running
+ * stream and everything sharing a stream with them off the thread and
+ * appends them to the per direction lists in devs. Attach runs the devices
+ * in devs on the thread. */
+struct audio_thread_move_devs_msg {
+  struct audio_thread_msg header;
+  struct cras_iodev* dev;
+  struct cras_rstream* stream;
+  struct open_dev** devs;
+};
+
+/* A command slot. The message is copied in when queued. Handlers may write
+ * results back into it, synchronous callers read them out on completion.
+ */
+struct audio_thread_cmd {
+  union {
+    struct audio_thread_msg header;
+    uint8_t buf[MAX_MSG_SIZE];
+  } msg;
+  // Called in main thread on completion if not NULL.
+  audio_thread_done_cb cb;
+  void* cb_data;
+  // Result of the command.
+  int rc;
+};
+
+/* Single producer, single consumer ring of commands. Only the main thread
+ * queues commands and only the audio thread runs them, so the counters need
+ * no lock. Slots between head and tail are owned by the audio thread, slots
+ * between reaped and head wait for main thread to collect the results.
+ */
+struct audio_thread_cmd_ring {
+  // Count of commands queued, written by main thread.
+  uint64_t tail;
+  // Count of commands completed, written by audio thread.
+  uint64_t head;
+  // Count of completed commands collected by main thread.
+  uint64_t reaped;
+  struct audio_thread_cmd cmds[CMD_RING_SIZE];
+};
+
+// Main thread's record of the thread running an open device.
+struct audio_thread_dev_owner {
+  struct cras_iodev* dev;
+  struct audio_thread* thread;
+  struct audio_thread_dev_owner *prev, *next;
+};
+
 /* Audio thread logging. If atlog is successfully created from cras_shm_setup,
  * then the fds should have valid value. Or audio thread will fallback to use
  * calloc to create atlog and leave the fds as -1.
@@ -124,16 +187,54 @@ int atlog_ro_shm_fd;
 
 static struct iodev_callback_list* iodev_callbacks;
 
+/* Epoll set holding the fds of the callbacks triggered by TRIGGER_POLL. The
+ * primary audio thread polls it next to its message pipe, so callbacks can
+ * be added and removed without rebuilding a pollfd array on each wake up.
+ */
+static int callbacks_epoll_fd = -1;
+static pthread_once_t callbacks_epoll_once = PTHREAD_ONCE_INIT;
+
 struct iodev_callback_list {
   int fd;
   int events;
   enum AUDIO_THREAD_EVENTS_CB_TRIGGER trigger;
   thread_callback cb;
   void* cb_data;
-  struct pollfd* pollfd;
   struct iodev_callback_list *prev, *next;
 };
 
+static void create_callbacks_epoll() {
+  callbacks_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (callbacks_epoll_fd < 0) {
+    syslog(LOG_ERR, "Failed to create callbacks epoll: %d", errno);
+  }
+}
+
+static int get_callbacks_epoll_fd() {
+  pthread_once(&callbacks_epoll_once, create_callbacks_epoll);
+  return callbacks_epoll_fd;
+}
+
+// Starts or stops polling the fd of iodev_cb for its events.
+static void poll_callback(const struct iodev_callback_list* iodev_cb,
+                          bool enable) {
+  struct epoll_event ev = {};
+  int rc;
+
+  if (enable) {
+    // POLLIN, POLLOUT and friends have the same values as their EPOLL*.
+    ev.events = iodev_cb->events;
+    ev.data.fd = iodev_cb->fd;
+    rc = epoll_ctl(get_callbacks_epoll_fd(), EPOLL_CTL_ADD, iodev_cb->fd, &ev);
+  } else {
+    rc = epoll_ctl(get_callbacks_epoll_fd(), EPOLL_CTL_DEL, iodev_cb->fd, NULL);
+  }
+  if (rc < 0 && errno != EEXIST && errno != ENOENT && errno != EBADF) {
+    syslog(LOG_WARNING, "Failed to update poll of callback fd %d: %d",
+           iodev_cb->fd, errno);
+  }
+}
+
 void audio_thread_add_events_callback(int fd,
                                       thread_callback cb,
                                       void* data,
@@ -155,6 +256,7 @@ void audio_thread_add_events_callback(int fd,
   iodev_cb->events = events;
 
   DL_APPEND(iodev_callbacks, iodev_cb);
+  poll_callback(iodev_cb, true);
 }
 
 void audio_thread_rm_callback(int fd) {
@@ -162,6 +264,9 @@ void audio_thread_rm_callback(int fd) {
 
   DL_FOREACH (iodev_callbacks, iodev_cb) {
     if (iodev_cb->fd == fd) {
+      if (iodev_cb->trigger == TRIGGER_POLL) {
+        poll_callback(iodev_cb, false);
+      }
       DL_DELETE(iodev_callbacks, iodev_cb);
       free(iodev_cb);
       return;
@@ -176,88 +281,111 @@ void audio_thread_config_events_callback(
 
   DL_FOREACH (iodev_callbacks, iodev_cb) {
     if (iodev_cb->fd == fd) {
+      if ((iodev_cb->trigger == TRIGGER_POLL) != (trigger == TRIGGER_POLL)) {
+        poll_callback(iodev_cb, trigger == TRIGGER_POLL);
+      }
       iodev_cb->trigger = trigger;
       return;
     }
   }
 }
 
-/* Sends a response (error code) from the audio thread to the main thread.
- * Indicates that the last message sent to the audio thread has been handled
- * with an error code of rc.
- * Args:
- *    thread - thread responding to command.
- *    rc - Result code to send back to the main thread.
- * Returns:
- *    The number of bytes written to the main thread.
+/* Runs the TRIGGER_POLL callbacks whose fds are ready. Called only from the
+ * primary audio thread. Callbacks are looked up by fd since one callback may
+ * remove another.
  */
-static int audio_thread_send_response(struct audio_thread* thread, int rc) {
-  return write(thread->to_main_fds[1], &rc, sizeof(rc));
+static void run_poll_callbacks() {
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  struct iodev_callback_list* iodev_cb;
+  int i, n;
+
+  n = epoll_wait(get_callbacks_epoll_fd(), events, ARRAY_SIZE(events), 0);
+  for (i = 0; i < n; i++) {
+    DL_FOREACH (iodev_callbacks, iodev_cb) {
+      if (iodev_cb->fd != events[i].data.fd ||
+          iodev_cb->trigger != TRIGGER_POLL) {
+        continue;
+      }
+      if (events[i].events & iodev_cb->events) {
+        ATLOG(atlog, AUDIO_THREAD_IODEV_CB, events[i].events, iodev_cb->events,
+              0);
+        iodev_cb->cb(iodev_cb->cb_data, events[i].events);
+      }
+      break;
+    }
+  }
 }
 
-/* Reads from a file descriptor until all bytes are read.
- *
- * Args:
- *    fd - file descriptor to read
- *    buf - the buffer to be written.
- *    count - the number of bytes to read from fd
- * Returns:
- *    |count| on success, negative error code on failure.
- */
-static int read_until_finished(int fd, void* buf, size_t count) {
-  int nread, count_left = count;
+// Returns true if iodev runs rstream.
+static bool dev_has_stream(const struct cras_iodev* iodev,
+                           const struct cras_rstream* rstream) {
+  struct dev_stream* s;
 
-  while (count_left > 0) {
-    nread = read(fd, (uint8_t*)buf + count - count_left, count_left);
-    if (nread < 0) {
-      if (errno == EINTR) {
-        continue;
-      } else {
-        return nread;
+  DL_FOREACH (iodev->streams, s) {
+    if (s->stream == rstream) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Return non-zero if the stream is attached to any device.
+static int thread_find_stream(struct audio_thread* thread,
+                              struct cras_rstream* rstream) {
+  struct open_dev* open_dev;
+  struct dev_stream* s;
+
+  DL_FOREACH (thread->open_devs[rstream->direction], open_dev) {
+    DL_FOREACH (open_dev->dev->streams, s) {
+      if (s->stream == rstream) {
+        return 1;
       }
-    } else if (nread == 0) {
-      syslog(LOG_ERR, "Pipe has been closed.");
-      return -EPIPE;
     }
-    count_left -= nread;
   }
-  return count;
+  return 0;
 }
 
-/* Reads a command from the main thread.  Called from the playback/capture
- * thread.  This will read the next available command from the main thread and
- * put it in buf.
- * Args:
- *    thread - thread reading the command.
- *    buf - Message is stored here on return.
- *    max_len - maximum length of message to put into buf.
- * Returns:
- *    0 on success, negative error code on failure.
+/* Returns true if client replies of rstream should wake up the thread. These
+ * are the streams dev_stream_poll_stream_fd() may return the fd of.
  */
-static int audio_thread_read_command(struct audio_thread* thread,
-                                     uint8_t* buf,
-                                     size_t max_len) {
-  int to_read, nread, rc;
-  struct audio_thread_msg* msg = (struct audio_thread_msg*)buf;
+static bool stream_wakes_thread(const struct cras_rstream* rstream) {
+  return stream_uses_output(rstream) ||
+         (stream_uses_input(rstream) && (rstream->flags & USE_DEV_TIMING));
+}
 
-  // Get the length of the message first
-  nread =
-      read_until_finished(thread->to_thread_fds[0], buf, sizeof(msg->length));
-  if (nread < 0) {
-    return nread;
-  }
+/* Starts or stops polling the client fd of rstream. The fd is edge triggered
+ * as a reply only needs to wake the thread up: dev_io reads the replies of
+ * the streams waiting for one each time it runs, so a reply that comes when
+ * none is expected causes one spurious wake up instead of a busy loop.
+ */
+static void poll_stream(struct audio_thread* thread,
+                        const struct cras_rstream* rstream,
+                        bool enable) {
+  struct epoll_event ev = {};
+  int fd = cras_rstream_get_audio_fd(rstream);
+  int rc;
 
-  if (msg->length > max_len) {
-    return -ENOMEM;
+  if (!stream_wakes_thread(rstream)) {
+    return;
   }
 
-  to_read = msg->length - sizeof(msg->length);
-  rc = read_until_finished(thread->to_thread_fds[0],
-                           &buf[0] + sizeof(msg->length), to_read);
-  if (rc < 0) {
-    return rc;
+  if (enable) {
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    rc = epoll_ctl(thread->stream_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  } else {
+    rc = epoll_ctl(thread->stream_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
   }
-  return 0;
+  if (rc < 0 && errno != EEXIST && errno != ENOENT && errno != EBADF) {
+    syslog(LOG_WARNING, "Failed to update poll of stream %x: %d",
+           rstream->stream_id, errno);
+  }
+}
+
+// Polls rstream as long as any device of the thread runs it.
+static void update_stream_poll(struct audio_thread* thread,
+                               struct cras_rstream* rstream) {
+  poll_stream(thread, rstream, thread_find_stream(thread, rstream));
 }
 
 // Builds an initial buffer to avoid an underrun. Adds min_level of latency.
@@ -298,10 +426,25 @@ static int thread_rm_open_dev(struct audio_thread* thread,
                               enum CRAS_STREAM_DIRECTION dir,
                               unsigned int dev_idx) {
   struct open_dev* adev = dev_io_find_open_dev(thread->open_devs[dir], dev_idx);
+  struct open_dev* other;
+  struct dev_stream* s;
+
   if (!adev) {
     return -EINVAL;
   }
 
+  // Stop polling the streams which leave the thread with this device.
+  DL_FOREACH (adev->dev->streams, s) {
+    DL_FOREACH (thread->open_devs[dir], other) {
+      if (other != adev && dev_has_stream(other->dev, s->stream)) {
+        break;
+      }
+    }
+    if (!other) {
+      poll_stream(thread, s->stream, false);
+    }
+  }
+
   dev_io_rm_open_dev(&thread->open_devs[dir], adev);
   return 0;
 }
@@ -361,22 +504,6 @@ static int thread_dev_start_ramp(struct audio_thread* thread,
   }
 }
 
-// Return non-zero if the stream is attached to any device.
-static int thread_find_stream(struct audio_thread* thread,
-                              struct cras_rstream* rstream) {
-  struct open_dev* open_dev;
-  struct dev_stream* s;
-
-  DL_FOREACH (thread->open_devs[rstream->direction], open_dev) {
-    DL_FOREACH (open_dev->dev->streams, s) {
-      if (s->stream == rstream) {
-        return 1;
-      }
-    }
-  }
-  return 0;
-}
-
 // Handles the disconnect_stream message from the main thread.
 static int thread_disconnect_stream(struct audio_thread* thread,
                                     struct cras_rstream* stream,
@@ -384,10 +511,13 @@ static int thread_disconnect_stream(struct audio_thread* thread,
   int rc;
 
   if (!thread_find_stream(thread, stream)) {
+    // dev_io may have removed the stream on error.
+    poll_stream(thread, stream, false);
     return 0;
   }
 
   rc = dev_io_remove_stream(&thread->open_devs[stream->direction], stream, dev);
+  update_stream_poll(thread, stream);
 
   return rc;
 }
@@ -432,6 +562,7 @@ static int thread_drain_stream(struct audio_thread* thread,
   ms_left = thread_drain_stream_ms_remaining(thread, rstream);
   if (ms_left == 0) {
     dev_io_remove_stream(&thread->open_devs[rstream->direction], rstream, NULL);
+    poll_stream(thread, rstream, false);
   }
 
   return ms_left;
@@ -451,6 +582,7 @@ static int thread_add_stream(struct audio_thread* thread,
     return rc;
   }
 
+  update_stream_poll(thread, stream);
   return 0;
 }
 
@@ -481,6 +613,90 @@ static int thread_set_aec_dump(struct audio_thread* thread,
   return 0;
 }
 
+// Returns true if iodev runs a stream of any device in the devs lists.
+static bool shares_stream_with(const struct cras_iodev* iodev,
+                               struct open_dev** devs) {
+  struct open_dev* adev;
+  struct dev_stream* s;
+  int dir;
+
+  for (dir = 0; dir < CRAS_NUM_DIRECTIONS; dir++) {
+    DL_FOREACH (devs[dir], adev) {
+      DL_FOREACH (adev->dev->streams, s) {
+        if (dev_has_stream(iodev, s->stream)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/* Handles messages from main thread to take open devices off this thread
+ * without closing them. Moves iodev, the devices running rstream and then
+ * every device sharing a stream with a moved one to the devs lists, so the
+ * devices of a stream are never split between threads.
+ * Returns the number of devices moved.
+ */
+static int thread_detach_open_devs(struct audio_thread* thread,
+                                   struct cras_iodev* iodev,
+                                   struct cras_rstream* rstream,
+                                   struct open_dev** devs) {
+  struct open_dev* adev;
+  struct dev_stream* s;
+  bool moved;
+  int dir, num = 0;
+
+  do {
+    moved = false;
+    for (dir = 0; dir < CRAS_NUM_DIRECTIONS; dir++) {
+      DL_FOREACH (thread->open_devs[dir], adev) {
+        if (adev->dev != iodev &&
+            !(rstream && dev_has_stream(adev->dev, rstream)) &&
+            !shares_stream_with(adev->dev, devs)) {
+          continue;
+        }
+        ATLOG(atlog, AUDIO_THREAD_DEV_REMOVED, adev->dev->info.idx, 0, 0);
+        DL_DELETE(thread->open_devs[dir], adev);
+        DL_APPEND(devs[dir], adev);
+        moved = true;
+        num++;
+      }
+    }
+  } while (moved);
+
+  // None of the streams on the moved devices is left on this thread.
+  for (dir = 0; dir < CRAS_NUM_DIRECTIONS; dir++) {
+    DL_FOREACH (devs[dir], adev) {
+      DL_FOREACH (adev->dev->streams, s) {
+        poll_stream(thread, s->stream, false);
+      }
+    }
+  }
+
+  return num;
+}
+
+// Handles messages from main thread to run open devices detached elsewhere.
+static int thread_attach_open_devs(struct audio_thread* thread,
+                                   struct open_dev** devs) {
+  struct open_dev* adev;
+  struct dev_stream* s;
+  int dir;
+
+  for (dir = 0; dir < CRAS_NUM_DIRECTIONS; dir++) {
+    DL_FOREACH (devs[dir], adev) {
+      ATLOG(atlog, AUDIO_THREAD_DEV_ADDED, adev->dev->info.idx, 0, 0);
+      DL_FOREACH (adev->dev->streams, s) {
+        poll_stream(thread, s->stream, true);
+      }
+    }
+    DL_CONCAT(thread->open_devs[dir], devs[dir]);
+    devs[dir] = NULL;
+  }
+  return 0;
+}
+
 // Stop the playback thread
 static void terminate_pb_thread() {
   pthread_exit(0);
@@ -574,16 +790,9 @@ static void append_stream_dump_info(struct audio_debug_info* info,
  * Returns:
  *    Error code when reading or sending message fails.
  */
-static int handle_audio_thread_message(struct audio_thread* thread) {
-  uint8_t buf[256];
-  struct audio_thread_msg* msg = (struct audio_thread_msg*)buf;
+static int handle_audio_thread_message(struct audio_thread* thread,
+                                       struct audio_thread_msg* msg) {
   int ret = 0;
-  int err;
-
-  err = audio_thread_read_command(thread, buf, 256);
-  if (err < 0) {
-    return err;
-  }
 
   ATLOG(atlog, AUDIO_THREAD_PB_MSG, msg->id, 0, 0);
 
@@ -624,27 +833,29 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
       break;
     }
     case AUDIO_THREAD_STOP:
+      // The thread exits once the command is completed.
       ret = 0;
-      err = audio_thread_send_response(thread, ret);
-      if (err < 0) {
-        return err;
-      }
-      terminate_pb_thread();
       break;
     case AUDIO_THREAD_DUMP_THREAD_INFO: {
       struct dev_stream* curr;
       struct open_dev* adev;
       struct audio_thread_dump_debug_info_msg* dmsg;
       struct audio_debug_info* info;
-      unsigned int num_streams = 0;
-      unsigned int num_devs = 0;
+      unsigned int num_streams;
+      unsigned int num_devs;
 
       ret = 0;
       dmsg = (struct audio_thread_dump_debug_info_msg*)msg;
       info = dmsg->info;
+      // Append to what other audio threads have dumped.
+      num_streams = info->num_streams;
+      num_devs = info->num_devs;
 
       // Go through all open devices.
       DL_FOREACH (thread->open_devs[CRAS_STREAM_OUTPUT], adev) {
+        if (num_devs == MAX_DEBUG_DEVS) {
+          break;
+        }
         append_dev_dump_info(&info->devs[num_devs], adev);
         if (++num_devs == MAX_DEBUG_DEVS) {
           break;
@@ -675,7 +886,9 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
 
       info->num_streams = num_streams;
 
-      memcpy(&info->log, atlog, sizeof(info->log));
+      if (!thread->is_worker) {
+        memcpy(&info->log, atlog, sizeof(info->log));
+      }
       break;
     }
     case AUDIO_THREAD_DRAIN_STREAM: {
@@ -694,16 +907,16 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
     }
     case AUDIO_THREAD_CONFIG_GLOBAL_REMIX: {
       struct audio_thread_config_global_remix* rmsg;
-      void* rsp;
+      struct cras_fmt_conv* old;
 
       /* Respond the pointer to the old remix converter, so it can be
        * freed later in main thread. */
-      rsp = (void*)thread->remix_converter;
+      old = thread->remix_converter;
 
       rmsg = (struct audio_thread_config_global_remix*)msg;
       thread->remix_converter = rmsg->fmt_conv;
-
-      return write(thread->to_main_fds[1], &rsp, sizeof(rsp));
+      rmsg->fmt_conv = old;
+      break;
     }
     case AUDIO_THREAD_DEV_START_RAMP: {
       struct audio_thread_dev_start_ramp_msg* rmsg;
@@ -718,16 +931,67 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
       ret = thread_set_aec_dump(thread, rmsg->stream_id, rmsg->start, rmsg->fd);
       break;
     }
+    case AUDIO_THREAD_FIND_STREAM: {
+      struct audio_thread_add_rm_stream_msg* rmsg;
+
+      rmsg = (struct audio_thread_add_rm_stream_msg*)msg;
+      ret = thread_find_stream(thread, rmsg->stream);
+      break;
+    }
+    case AUDIO_THREAD_DETACH_OPEN_DEVS: {
+      struct audio_thread_move_devs_msg* rmsg;
+
+      rmsg = (struct audio_thread_move_devs_msg*)msg;
+      ret = thread_detach_open_devs(thread, rmsg->dev, rmsg->stream,
+                                    rmsg->devs);
+      break;
+    }
+    case AUDIO_THREAD_ATTACH_OPEN_DEVS: {
+      struct audio_thread_move_devs_msg* rmsg;
+
+      rmsg = (struct audio_thread_move_devs_msg*)msg;
+      ret = thread_attach_open_devs(thread, rmsg->devs);
+      break;
+    }
     default:
       ret = -EINVAL;
       break;
   }
 
-  err = audio_thread_send_response(thread, ret);
-  if (err < 0) {
-    return err;
+  return ret;
+}
+
+/* Runs the commands queued by main thread and signals their completion once
+ * for the whole batch. Exits the thread after a stop command.
+ */
+static int run_audio_thread_commands(struct audio_thread* thread) {
+  struct audio_thread_cmd_ring* ring = thread->cmds;
+  struct audio_thread_cmd* cmd;
+  uint64_t head, tail;
+  eventfd_t count;
+  bool stop = false;
+  int rc;
+
+  // Reset the doorbell before looking at the ring to not miss a command.
+  eventfd_read(thread->cmd_event_fd, &count);
+
+  head = ring->head;
+  tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if (head == tail) {
+    return 0;
   }
-  return 0;
+  for (; head != tail && !stop; head++) {
+    cmd = &ring->cmds[head % CMD_RING_SIZE];
+    cmd->rc = handle_audio_thread_message(thread, &cmd->msg.header);
+    stop = cmd->msg.header.id == AUDIO_THREAD_STOP;
+  }
+  __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+  rc = eventfd_write(thread->done_event_fd, 1);
+  if (stop) {
+    terminate_pb_thread();
+  }
+  return rc;
 }
 
 // Returns the number of active streams plus the number of active devices.
@@ -754,67 +1018,60 @@ static int fill_next_sleep_interval(struct audio_thread* thread,
   return ret;
 }
 
-static struct pollfd* add_pollfd(struct audio_thread* thread,
-                                 int fd,
-                                 int events) {
-  thread->pollfds[thread->num_pollfds].fd = fd;
-  thread->pollfds[thread->num_pollfds].events = events;
-  thread->num_pollfds++;
-  if (thread->num_pollfds >= thread->pollfds_size) {
-    thread->pollfds_size *= 2;
-    thread->pollfds = (struct pollfd*)realloc(
-        thread->pollfds, sizeof(*thread->pollfds) * thread->pollfds_size);
-    return NULL;
-  }
-
-  return &thread->pollfds[thread->num_pollfds - 1];
-}
-
-static int continuous_zero_sleep_count = 0;
-static unsigned busyloop_count = 0;
-
 /*
  * Logs the number of busyloop during one audio thread running state
  * (wait_ts != NULL).
  */
-static void log_busyloop(struct timespec* wait_ts) {
-  static struct timespec start_time;
-  static bool started = false;
+static void log_busyloop(struct audio_thread* thread,
+                         struct timespec* wait_ts) {
   struct timespec diff, now;
 
   // If wait_ts is NULL, there is no stream running.
-  if (wait_ts && !started) {
-    started = true;
-    busyloop_count = 0;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
-  } else if (!wait_ts && started) {
-    started = false;
+  if (wait_ts && !thread->busyloop_started) {
+    thread->busyloop_started = 1;
+    thread->busyloop_count = 0;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &thread->busyloop_start_time);
+  } else if (!wait_ts && thread->busyloop_started) {
+    thread->busyloop_started = 0;
     clock_gettime(CLOCK_MONOTONIC_RAW, &now);
-    subtract_timespecs(&now, &start_time, &diff);
-    cras_server_metrics_busyloop(&diff, busyloop_count);
+    subtract_timespecs(&now, &thread->busyloop_start_time, &diff);
+    cras_server_metrics_busyloop(&diff, thread->busyloop_count);
   }
 }
 
-static void check_busyloop(struct timespec* wait_ts) {
+static void check_busyloop(struct audio_thread* thread,
+                           struct timespec* wait_ts) {
   if (wait_ts->tv_sec == 0 && wait_ts->tv_nsec == 0) {
-    continuous_zero_sleep_count++;
-    if (continuous_zero_sleep_count == MAX_CONTINUOUS_ZERO_SLEEP_COUNT) {
-      busyloop_count++;
+    thread->continuous_zero_sleep_count++;
+    if (thread->continuous_zero_sleep_count ==
+        MAX_CONTINUOUS_ZERO_SLEEP_COUNT) {
+      thread->busyloop_count++;
       cras_audio_thread_event_busyloop();
     }
-    if (continuous_zero_sleep_count == MAX_CONTINUOUS_ZERO_SLEEP_METRIC_LIMIT) {
-      cras_server_metrics_busyloop_length(continuous_zero_sleep_count);
+    if (thread->continuous_zero_sleep_count ==
+        MAX_CONTINUOUS_ZERO_SLEEP_METRIC_LIMIT) {
+      cras_server_metrics_busyloop_length(
+          thread->continuous_zero_sleep_count);
     }
 
   } else {
-    if (continuous_zero_sleep_count >= MAX_CONTINUOUS_ZERO_SLEEP_COUNT &&
-        continuous_zero_sleep_count < MAX_CONTINUOUS_ZERO_SLEEP_METRIC_LIMIT) {
-      cras_server_metrics_busyloop_length(continuous_zero_sleep_count);
+    if (thread->continuous_zero_sleep_count >=
+            MAX_CONTINUOUS_ZERO_SLEEP_COUNT &&
+        thread->continuous_zero_sleep_count <
+            MAX_CONTINUOUS_ZERO_SLEEP_METRIC_LIMIT) {
+      cras_server_metrics_busyloop_length(
+          thread->continuous_zero_sleep_count);
     }
-    continuous_zero_sleep_count = 0;
+    thread->continuous_zero_sleep_count = 0;
   }
 }
 
+// Callbacks are only run by the primary audio thread.
+static inline struct iodev_callback_list* thread_callbacks(
+    const struct audio_thread* thread) {
+  return thread->is_worker ? NULL : iodev_callbacks;
+}
+
 /* For playback, fill the audio buffer when needed, for capture, pull out
  * samples when they are ready.
  * This thread will attempt to run at a high priority to allow for low latency
@@ -824,29 +1081,30 @@ static void check_busyloop(struct timespec* wait_ts) {
  */
 static void* audio_io_thread(void* arg) {
   struct audio_thread* thread = (struct audio_thread*)arg;
-  struct open_dev* adev;
-  struct dev_stream* curr;
+  struct epoll_event events[MAX_EPOLL_EVENTS];
   struct timespec ts;
-  int msg_fd;
+  /* The message pipe, then the epoll sets of stream fds and callback fds.
+   * Workers don't run callbacks and leave the last fd negative so that
+   * ppoll ignores it. */
+  struct pollfd pollfds[3] = {
+      {.fd = thread->cmd_event_fd, .events = POLLIN},
+      {.fd = thread->stream_epoll_fd, .events = POLLIN},
+      {.fd = thread->is_worker ? -1 : get_callbacks_epoll_fd(),
+       .events = POLLIN},
+  };
   int rc;
 
-  msg_fd = thread->to_thread_fds[0];
-
   // Attempt to get realtime scheduling
   if (cras_set_rt_scheduling(CRAS_SERVER_RT_THREAD_PRIORITY) == 0) {
     cras_set_thread_priority(CRAS_SERVER_RT_THREAD_PRIORITY);
   }
 
-  thread->pollfds[0].fd = msg_fd;
-  thread->pollfds[0].events = POLLIN;
-
   while (1) {
     struct timespec* wait_ts;
     struct iodev_callback_list* iodev_cb;
     int non_empty;
 
     wait_ts = NULL;
-    thread->num_pollfds = 1;
 
     // device opened
     dev_io_run(&thread->open_devs[CRAS_STREAM_OUTPUT],
@@ -859,61 +1117,23 @@ static void* audio_io_thread(void* arg) {
       wait_ts = &ts;
     }
 
-  restart_poll_loop:
-    thread->num_pollfds = 1;
-
-    DL_FOREACH (iodev_callbacks, iodev_cb) {
-      if (iodev_cb->trigger != TRIGGER_POLL) {
-        iodev_cb->pollfd = NULL;
-        continue;
-      }
-      iodev_cb->pollfd = add_pollfd(thread, iodev_cb->fd, iodev_cb->events);
-      if (!iodev_cb->pollfd) {
-        goto restart_poll_loop;
-      }
-    }
-
-    // TODO(dgreid) - once per rstream not per dev_stream
-    DL_FOREACH (thread->open_devs[CRAS_STREAM_OUTPUT], adev) {
-      DL_FOREACH (adev->dev->streams, curr) {
-        int fd = dev_stream_poll_stream_fd(curr);
-        if (fd < 0) {
-          continue;
-        }
-        if (!add_pollfd(thread, fd, POLLIN)) {
-          goto restart_poll_loop;
-        }
-      }
-    }
-    DL_FOREACH (thread->open_devs[CRAS_STREAM_INPUT], adev) {
-      DL_FOREACH (adev->dev->streams, curr) {
-        int fd = dev_stream_poll_stream_fd(curr);
-        if (fd < 0) {
-          continue;
-        }
-        if (!add_pollfd(thread, fd, POLLIN)) {
-          goto restart_poll_loop;
-        }
-      }
-    }
-
-    log_busyloop(wait_ts);
+    log_busyloop(thread, wait_ts);
 
     ATLOG(atlog, AUDIO_THREAD_SLEEP, wait_ts ? wait_ts->tv_sec : 0,
           wait_ts ? wait_ts->tv_nsec : 0, non_empty);
     if (wait_ts) {
-      check_busyloop(wait_ts);
+      check_busyloop(thread, wait_ts);
     }
 
     // Sync atlog with shared memory.
     __sync_synchronize();
     atlog->sync_write_pos = atlog->write_pos;
 
-    rc = ppoll(thread->pollfds, thread->num_pollfds, wait_ts, NULL);
+    rc = ppoll(pollfds, ARRAY_SIZE(pollfds), wait_ts, NULL);
     ATLOG(atlog, AUDIO_THREAD_WAKE, rc, 0, 0);
 
     // Handle callbacks registered by TRIGGER_WAKEUP
-    DL_FOREACH (iodev_callbacks, iodev_cb) {
+    DL_FOREACH (thread_callbacks(thread), iodev_cb) {
       if (iodev_cb->trigger == TRIGGER_WAKEUP) {
         ATLOG(atlog, AUDIO_THREAD_IODEV_CB, 0, 0, 0);
         iodev_cb->cb(iodev_cb->cb_data, 0);
@@ -925,53 +1145,170 @@ static void* audio_io_thread(void* arg) {
       continue;
     }
 
-    if (thread->pollfds[0].revents & POLLIN) {
-      rc = handle_audio_thread_message(thread);
+    if (pollfds[0].revents & POLLIN) {
+      rc = run_audio_thread_commands(thread);
       if (rc < 0) {
         syslog(LOG_ERR, "handle message %d", rc);
       }
     }
 
-    DL_FOREACH (iodev_callbacks, iodev_cb) {
-      if (iodev_cb->pollfd && iodev_cb->pollfd->revents & iodev_cb->events) {
-        ATLOG(atlog, AUDIO_THREAD_IODEV_CB, iodev_cb->pollfd->revents,
-              iodev_cb->events, 0);
-        iodev_cb->cb(iodev_cb->cb_data, iodev_cb->pollfd->revents);
-      }
+    /* Client replies only need to wake the thread up, they are read when
+     * dev_io_run services the streams. Consume the edges. */
+    if (pollfds[1].revents & POLLIN) {
+      epoll_wait(thread->stream_epoll_fd, events, ARRAY_SIZE(events), 0);
+    }
+
+    if (pollfds[2].revents & POLLIN) {
+      run_poll_callbacks();
     }
   }
 
   return NULL;
 }
 
+/* Runs the callbacks of the commands completed by thread and frees their
+ * slots. Called from main thread. A callback may queue more commands.
+ */
+static void reap_commands(struct audio_thread* thread) {
+  struct audio_thread_cmd_ring* ring = thread->cmds;
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  struct audio_thread_cmd* cmd;
+  audio_thread_done_cb cb;
+  void* cb_data;
+  int rc;
+
+  while (ring->reaped < head) {
+    cmd = &ring->cmds[ring->reaped % CMD_RING_SIZE];
+    cb = cmd->cb;
+    cb_data = cmd->cb_data;
+    rc = cmd->rc;
+    ring->reaped++;
+    if (cb) {
+      cb(cb_data, rc);
+    }
+  }
+}
+
+// Waits in main thread until thread completes the command numbered seq.
+static int wait_command(struct audio_thread* thread, uint64_t seq) {
+  struct pollfd pfd = {.fd = thread->done_event_fd, .events = POLLIN};
+  eventfd_t count;
+
+  while (__atomic_load_n(&thread->cmds->head, __ATOMIC_ACQUIRE) <= seq) {
+    if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+      return -errno;
+    }
+    eventfd_read(thread->done_event_fd, &count);
+  }
+  return 0;
+}
+
+/* Copies msg into the command ring of thread and wakes the thread up. Waits
+ * for the oldest command to complete if the ring is full.
+ * Args:
+ *    thread - thread to receive message.
+ *    msg - The message to send.
+ *    cb - Called with the result when reaped, can be NULL.
+ *    cb_data - Passed to cb.
+ *    seq - Filled with the number of the command if not NULL.
+ * Returns:
+ *    0 if the command is queued, negative error code otherwise.
+ */
+static int queue_message(struct audio_thread* thread,
+                         struct audio_thread_msg* msg,
+                         audio_thread_done_cb cb,
+                         void* cb_data,
+                         uint64_t* seq) {
+  struct audio_thread_cmd_ring* ring = thread->cmds;
+  struct audio_thread_cmd* cmd;
+  int rc;
+
+  if (msg->length > sizeof(cmd->msg)) {
+    return -EINVAL;
+  }
+
+  while (ring->tail - ring->reaped == CMD_RING_SIZE) {
+    rc = wait_command(thread, ring->reaped);
+    if (rc < 0) {
+      return rc;
+    }
+    reap_commands(thread);
+  }
+
+  cmd = &ring->cmds[ring->tail % CMD_RING_SIZE];
+  memcpy(&cmd->msg, msg, msg->length);
+  cmd->cb = cb;
+  cmd->cb_data = cb_data;
+  cmd->rc = 0;
+  if (seq) {
+    *seq = ring->tail;
+  }
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+
+  rc = eventfd_write(thread->cmd_event_fd, 1);
+  if (rc < 0) {
+    syslog(LOG_ERR, "Failed to post message to thread.");
+    return -errno;
+  }
+  return 0;
+}
+
 /* Write a message to the playback thread and wait for an ack, This keeps these
  * operations synchronous for the main server thread.  For instance when the
  * RM_STREAM message is sent, the stream can be deleted after the function
  * returns.  Making this synchronous also allows the thread to return an error
- * code that can be handled by the caller.
+ * code that can be handled by the caller. Commands queued before are completed
+ * and their callbacks run first.
  * Args:
  *    thread - thread to receive message.
- *    msg - The message to send.
+ *    msg - The message to send, updated with what the handler wrote back.
  * Returns:
  *    A return code from the message handler in the thread.
  */
 static int audio_thread_post_message(struct audio_thread* thread,
                                      struct audio_thread_msg* msg) {
-  int err, rsp;
+  struct audio_thread_cmd* cmd;
+  uint64_t seq;
+  int rc;
 
-  err = write(thread->to_thread_fds[1], msg, msg->length);
-  if (err < 0) {
-    syslog(LOG_ERR, "Failed to post message to thread.");
-    return err;
+  rc = queue_message(thread, msg, NULL, NULL, &seq);
+  if (rc < 0) {
+    return rc;
   }
+
   // Synchronous action, wait for response.
-  err = read_until_finished(thread->to_main_fds[0], &rsp, sizeof(rsp));
-  if (err < 0) {
+  rc = wait_command(thread, seq);
+  if (rc < 0) {
     syslog(LOG_ERR, "Failed to read reply from thread.");
-    return err;
+    return rc;
+  }
+
+  cmd = &thread->cmds->cmds[seq % CMD_RING_SIZE];
+  memcpy(msg, &cmd->msg, msg->length);
+  rc = cmd->rc;
+  reap_commands(thread);
+  return rc;
+}
+
+// Posts msg and waits for the result if wait is true, or only queues it.
+static int send_message(struct audio_thread* thread,
+                        struct audio_thread_msg* msg,
+                        bool wait,
+                        audio_thread_done_cb cb,
+                        void* cb_data) {
+  if (wait) {
+    return audio_thread_post_message(thread, msg);
   }
+  return queue_message(thread, msg, cb, cb_data, NULL);
+}
+
+// Runs completion callbacks in main thread when the thread signals.
+static void commands_done(void* data, int revents) {
+  struct audio_thread* thread = (struct audio_thread*)data;
+  eventfd_t count;
 
-  return rsp;
+  eventfd_read(thread->done_event_fd, &count);
+  reap_commands(thread);
 }
 
 static void init_open_device_msg(struct audio_thread_open_device_msg* msg,
@@ -1002,8 +1339,10 @@ static void init_add_rm_stream_msg(struct audio_thread_add_rm_stream_msg* msg,
   msg->header.id = id;
   msg->header.length = sizeof(*msg);
   msg->stream = stream;
-  msg->devs = devs;
-  msg->num_devs = num_devs;
+  msg->num_devs = MIN(num_devs, MAX_STREAM_DEVS);
+  if (devs) {
+    memcpy(msg->devs, devs, msg->num_devs * sizeof(*devs));
+  }
 }
 
 static void init_dump_debug_info_msg(
@@ -1034,55 +1373,360 @@ static void init_device_start_ramp_msg(
   msg->request = request;
 }
 
+/* Returns the thread to run iodev on when it opens. Devices of positive
+ * clock domains are spread over the worker threads, others run on the
+ * primary thread.
+ */
+static struct audio_thread* dev_home_thread(struct audio_thread* thread,
+                                            const struct cras_iodev* iodev) {
+  if (!thread->num_workers || iodev->clock_domain <= 0) {
+    return thread;
+  }
+  return thread->workers[(iodev->clock_domain - 1) % thread->num_workers];
+}
+
+static struct audio_thread_dev_owner* find_dev_owner(
+    struct audio_thread* thread,
+    enum CRAS_STREAM_DIRECTION dir,
+    unsigned int dev_idx) {
+  struct audio_thread_dev_owner* owner;
+
+  DL_FOREACH (thread->dev_owners, owner) {
+    if (owner->dev->direction == dir && owner->dev->info.idx == dev_idx) {
+      return owner;
+    }
+  }
+  return NULL;
+}
+
+// Returns the thread running an open device, the primary thread if unknown.
+static struct audio_thread* dev_thread(struct audio_thread* thread,
+                                       enum CRAS_STREAM_DIRECTION dir,
+                                       unsigned int dev_idx) {
+  struct audio_thread_dev_owner* owner = find_dev_owner(thread, dir, dev_idx);
+
+  return owner ? owner->thread : thread;
+}
+
+// Returns the primary thread for i = 0, then each worker thread.
+static struct audio_thread* nth_thread(struct audio_thread* thread,
+                                       unsigned int i) {
+  return i ? thread->workers[i - 1] : thread;
+}
+
+// Returns the thread running stream, NULL if no thread does.
+static struct audio_thread* find_stream_thread(struct audio_thread* thread,
+                                               struct cras_rstream* stream) {
+  struct audio_thread_add_rm_stream_msg msg;
+  unsigned int i;
+
+  for (i = 0; i <= thread->num_workers; i++) {
+    init_add_rm_stream_msg(&msg, AUDIO_THREAD_FIND_STREAM, stream, NULL, 0);
+    if (audio_thread_post_message(nth_thread(thread, i), &msg.header) > 0) {
+      return nth_thread(thread, i);
+    }
+  }
+  return NULL;
+}
+
+static int detach_open_devs(struct audio_thread* from,
+                            struct cras_iodev* dev,
+                            struct cras_rstream* stream,
+                            struct open_dev** devs) {
+  struct audio_thread_move_devs_msg msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.header.id = AUDIO_THREAD_DETACH_OPEN_DEVS;
+  msg.header.length = sizeof(msg);
+  msg.dev = dev;
+  msg.stream = stream;
+  msg.devs = devs;
+  return audio_thread_post_message(from, &msg.header);
+}
+
+static int attach_open_devs(struct audio_thread* thread,
+                            struct audio_thread* to,
+                            struct open_dev** devs) {
+  struct audio_thread_move_devs_msg msg;
+  struct audio_thread_dev_owner* owner;
+  struct open_dev* adev;
+  int dir;
+
+  for (dir = 0; dir < CRAS_NUM_DIRECTIONS; dir++) {
+    DL_FOREACH (devs[dir], adev) {
+      owner = find_dev_owner(thread, adev->dev->direction, adev->dev->info.idx);
+      if (owner) {
+        owner->thread = to;
+      }
+    }
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  msg.header.id = AUDIO_THREAD_ATTACH_OPEN_DEVS;
+  msg.header.length = sizeof(msg);
+  msg.devs = devs;
+  return audio_thread_post_message(to, &msg.header);
+}
+
+/* Picks the thread to run stream on devs. All devices of a stream run on the
+ * same thread, so if stream already runs elsewhere or devs run on different
+ * threads, the devices involved are moved to one thread first. That is the
+ * thread of devs if they agree, otherwise the primary thread which can run
+ * devices of any clock domain. Moved devices stay there until reopened.
+ */
+static struct audio_thread* place_stream(struct audio_thread* thread,
+                                         struct cras_rstream* stream,
+                                         struct cras_iodev** devs,
+                                         unsigned int num_devs) {
+  struct open_dev* moved[CRAS_NUM_DIRECTIONS] = {};
+  struct audio_thread *target, *current, *owner;
+  struct open_dev* adev;
+  unsigned int i;
+  int dir, rc, num_moved = 0;
+
+  if (!thread->num_workers) {
+    return thread;
+  }
+
+  target = thread;
+  for (i = 0; i < num_devs; i++) {
+    owner = dev_thread(thread, devs[i]->direction, devs[i]->info.idx);
+    if (i == 0) {
+      target = owner;
+    } else if (owner != target) {
+      target = thread;
+      break;
+    }
+  }
+
+  current = find_stream_thread(thread, stream);
+  if (current && current != target) {
+    rc = detach_open_devs(current, NULL, stream, moved);
+    num_moved += MAX(rc, 0);
+  }
+
+  // Devices of the primary clock domain never leave the primary thread.
+  for (dir = 0; dir < CRAS_NUM_DIRECTIONS; dir++) {
+    DL_FOREACH (moved[dir], adev) {
+      if (adev->dev->clock_domain == CRAS_IODEV_CLOCK_DOMAIN_PRIMARY) {
+        target = thread;
+      }
+    }
+  }
+
+  for (i = 0; i < num_devs; i++) {
+    owner = dev_thread(thread, devs[i]->direction, devs[i]->info.idx);
+    if (owner != target) {
+      rc = detach_open_devs(owner, devs[i], NULL, moved);
+      num_moved += MAX(rc, 0);
+    }
+  }
+
+  if (num_moved) {
+    attach_open_devs(thread, target, moved);
+  }
+  return target;
+}
+
+// Creates the command ring and poll fds of an audio thread.
+static struct audio_thread* create_thread() {
+  struct audio_thread* thread;
+
+  thread = (struct audio_thread*)calloc(1, sizeof(*thread));
+  if (!thread) {
+    return NULL;
+  }
+
+  thread->cmd_event_fd = -1;
+  thread->done_event_fd = -1;
+  thread->stream_epoll_fd = -1;
+
+  thread->cmds =
+      (struct audio_thread_cmd_ring*)calloc(1, sizeof(*thread->cmds));
+  if (!thread->cmds) {
+    goto error;
+  }
+
+  // Doorbells for commands to and completions from the audio thread.
+  thread->cmd_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  thread->done_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (thread->cmd_event_fd < 0 || thread->done_event_fd < 0) {
+    syslog(LOG_ERR, "Failed to create eventfd");
+    goto error;
+  }
+
+  thread->stream_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (thread->stream_epoll_fd < 0) {
+    syslog(LOG_ERR, "Failed to create epoll");
+    goto error;
+  }
+
+  return thread;
+
+error:
+  if (thread->cmd_event_fd >= 0) {
+    close(thread->cmd_event_fd);
+  }
+  if (thread->done_event_fd >= 0) {
+    close(thread->done_event_fd);
+  }
+  free(thread->cmds);
+  free(thread);
+  return NULL;
+}
+
+// Stops an audio thread and frees what create_thread allocated.
+static void destroy_thread(struct audio_thread* thread) {
+  if (thread->started) {
+    struct audio_thread_msg msg;
+
+    msg.id = AUDIO_THREAD_STOP;
+    msg.length = sizeof(msg);
+    audio_thread_post_message(thread, &msg);
+    pthread_join(thread->tid, NULL);
+    cras_system_rm_select_fd(thread->done_event_fd);
+  }
+
+  close(thread->stream_epoll_fd);
+  close(thread->cmd_event_fd);
+  close(thread->done_event_fd);
+  free(thread->cmds);
+
+  if (thread->remix_converter) {
+    cras_fmt_conv_destroy(&thread->remix_converter);
+  }
+
+  free(thread);
+}
+
 // Exported Interface
 
 int audio_thread_event_log_shm_fd() {
   return atlog_ro_shm_fd;
 }
 
+// Adds stream to devs on the thread picked for it, see send_message.
+static int add_stream(struct audio_thread* thread,
+                      struct cras_rstream* stream,
+                      struct cras_iodev** devs,
+                      unsigned int num_devs,
+                      bool wait,
+                      audio_thread_done_cb cb,
+                      void* cb_data) {
+  struct audio_thread_add_rm_stream_msg msg;
+  struct audio_thread* target;
+
+  assert(thread && stream);
+
+  if (!thread->started || num_devs > MAX_STREAM_DEVS) {
+    return -EINVAL;
+  }
+
+  target = place_stream(thread, stream, devs, num_devs);
+  init_add_rm_stream_msg(&msg, AUDIO_THREAD_ADD_STREAM, stream, devs, num_devs);
+  return send_message(target, &msg.header, wait, cb, cb_data);
+}
+
 int audio_thread_add_stream(struct audio_thread* thread,
                             struct cras_rstream* stream,
                             struct cras_iodev** devs,
                             unsigned int num_devs) {
+  return add_stream(thread, stream, devs, num_devs, true, NULL, NULL);
+}
+
+int audio_thread_add_stream_async(struct audio_thread* thread,
+                                  struct cras_rstream* stream,
+                                  struct cras_iodev** devs,
+                                  unsigned int num_devs,
+                                  audio_thread_done_cb cb,
+                                  void* cb_data) {
+  return add_stream(thread, stream, devs, num_devs, false, cb, cb_data);
+}
+
+// Disconnects stream from dev or all devices, see send_message.
+static int disconnect_stream(struct audio_thread* thread,
+                             struct cras_rstream* stream,
+                             struct cras_iodev* dev,
+                             bool wait,
+                             audio_thread_done_cb cb,
+                             void* cb_data) {
   struct audio_thread_add_rm_stream_msg msg;
+  struct audio_thread* target;
+  unsigned int i;
+  int err, rc = 0;
 
   assert(thread && stream);
 
-  if (!thread->started) {
-    return -EINVAL;
+  if (dev) {
+    target = dev_thread(thread, dev->direction, dev->info.idx);
+    init_add_rm_stream_msg(&msg, AUDIO_THREAD_DISCONNECT_STREAM, stream, &dev,
+                           1);
+    return send_message(target, &msg.header, wait, cb, cb_data);
   }
 
-  init_add_rm_stream_msg(&msg, AUDIO_THREAD_ADD_STREAM, stream, devs, num_devs);
-  return audio_thread_post_message(thread, &msg.header);
+  // Without a device, the stream may be on any thread.
+  for (i = 0; i <= thread->num_workers; i++) {
+    init_add_rm_stream_msg(&msg, AUDIO_THREAD_DISCONNECT_STREAM, stream, &dev,
+                           1);
+    err = send_message(nth_thread(thread, i), &msg.header, wait, cb, cb_data);
+    if (err < 0) {
+      rc = err;
+    }
+  }
+  return rc;
 }
 
 int audio_thread_disconnect_stream(struct audio_thread* thread,
                                    struct cras_rstream* stream,
                                    struct cras_iodev* dev) {
-  struct audio_thread_add_rm_stream_msg msg;
-
-  assert(thread && stream);
+  return disconnect_stream(thread, stream, dev, true, NULL, NULL);
+}
 
-  init_add_rm_stream_msg(&msg, AUDIO_THREAD_DISCONNECT_STREAM, stream, &dev, 0);
-  return audio_thread_post_message(thread, &msg.header);
+int audio_thread_disconnect_stream_async(struct audio_thread* thread,
+                                         struct cras_rstream* stream,
+                                         struct cras_iodev* dev,
+                                         audio_thread_done_cb cb,
+                                         void* cb_data) {
+  return disconnect_stream(thread, stream, dev, false, cb, cb_data);
 }
 
 int audio_thread_drain_stream(struct audio_thread* thread,
                               struct cras_rstream* stream) {
   struct audio_thread_add_rm_stream_msg msg;
+  unsigned int i;
+  int rc, ms_left = 0;
 
   assert(thread && stream);
 
-  init_add_rm_stream_msg(&msg, AUDIO_THREAD_DRAIN_STREAM, stream, NULL, 0);
-  return audio_thread_post_message(thread, &msg.header);
+  // Only the thread running the stream has frames left to drain.
+  for (i = 0; i <= thread->num_workers; i++) {
+    init_add_rm_stream_msg(&msg, AUDIO_THREAD_DRAIN_STREAM, stream, NULL, 0);
+    rc = audio_thread_post_message(nth_thread(thread, i), &msg.header);
+    if (rc < 0) {
+      return rc;
+    }
+    ms_left = MAX(ms_left, rc);
+  }
+  return ms_left;
 }
 
 int audio_thread_dump_thread_info(struct audio_thread* thread,
                                   struct audio_debug_info* info) {
   struct audio_thread_dump_debug_info_msg msg;
+  unsigned int i;
+  int rc;
 
-  init_dump_debug_info_msg(&msg, info);
-  return audio_thread_post_message(thread, &msg.header);
+  // Each audio thread appends its devices and streams.
+  info->num_devs = 0;
+  info->num_streams = 0;
+  for (i = 0; i <= thread->num_workers; i++) {
+    init_dump_debug_info_msg(&msg, info);
+    rc = audio_thread_post_message(nth_thread(thread, i), &msg.header);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  return 0;
 }
 
 int audio_thread_set_aec_dump(struct audio_thread* thread,
@@ -1090,14 +1734,22 @@ int audio_thread_set_aec_dump(struct audio_thread* thread,
                               unsigned int start,
                               int fd) {
   struct audio_thread_aec_dump_msg msg;
-
-  memset(&msg, 0, sizeof(msg));
-  msg.header.id = AUDIO_THREAD_AEC_DUMP;
-  msg.header.length = sizeof(msg);
-  msg.stream_id = stream_id;
-  msg.start = start;
-  msg.fd = fd;
-  return audio_thread_post_message(thread, &msg.header);
+  unsigned int i;
+  int err, rc = 0;
+
+  for (i = 0; i <= thread->num_workers; i++) {
+    memset(&msg, 0, sizeof(msg));
+    msg.header.id = AUDIO_THREAD_AEC_DUMP;
+    msg.header.length = sizeof(msg);
+    msg.stream_id = stream_id;
+    msg.start = start;
+    msg.fd = fd;
+    err = audio_thread_post_message(nth_thread(thread, i), &msg.header);
+    if (err < 0) {
+      rc = err;
+    }
+  }
+  return rc;
 }
 
 int audio_thread_rm_callback_sync(struct audio_thread* thread, int fd) {
@@ -1111,16 +1763,35 @@ int audio_thread_rm_callback_sync(struct audio_thread* thread, int fd) {
   return audio_thread_post_message(thread, &msg.header);
 }
 
+/* Replaces the remix converter of one audio thread with fmt_conv and frees
+ * the old one. */
+static int config_thread_remix(struct audio_thread* thread,
+                               struct cras_fmt_conv* fmt_conv) {
+  int err;
+  struct audio_thread_config_global_remix msg;
+
+  init_config_global_remix_msg(&msg);
+  msg.fmt_conv = fmt_conv;
+
+  err = audio_thread_post_message(thread, &msg.header);
+  if (err < 0) {
+    return err;
+  }
+
+  // The thread responds with its old converter.
+  if (msg.fmt_conv) {
+    cras_fmt_conv_destroy(&msg.fmt_conv);
+  }
+  return 0;
+}
+
 int audio_thread_config_global_remix(struct audio_thread* thread,
                                      unsigned int num_channels,
                                      const float* coefficient) {
   int err;
   int identity_remix = 1;
   unsigned int i, j;
-  struct audio_thread_config_global_remix msg;
-  void* rsp;
-
-  init_config_global_remix_msg(&msg);
+  struct cras_fmt_conv* fmt_conv = NULL;
 
   /* Check if the coefficients represent an identity matrix for remix
    * conversion, which means no remix at all. If so then leave the
@@ -1139,59 +1810,34 @@ int audio_thread_config_global_remix(struct audio_thread* thread,
     }
   }
 
-  if (!identity_remix) {
-    msg.fmt_conv = cras_channel_remix_conv_create(num_channels, coefficient);
-    if (NULL == msg.fmt_conv) {
-      return -ENOMEM;
+  // Converters keep conversion buffers, each thread needs its own.
+  for (i = 0; i <= thread->num_workers; i++) {
+    if (!identity_remix) {
+      fmt_conv = cras_channel_remix_conv_create(num_channels, coefficient);
+      if (NULL == fmt_conv) {
+        return -ENOMEM;
+      }
     }
-  }
 
-  err = write(thread->to_thread_fds[1], &msg, msg.header.length);
-  if (err < 0) {
-    syslog(LOG_ERR, "Failed to post message to thread.");
-    return err;
-  }
-  // Synchronous action, wait for response.
-  err = read_until_finished(thread->to_main_fds[0], &rsp, sizeof(rsp));
-  if (err < 0) {
-    syslog(LOG_ERR, "Failed to read reply from thread.");
-    return err;
-  }
-
-  if (rsp) {
-    cras_fmt_conv_destroy((struct cras_fmt_conv**)&rsp);
+    err = config_thread_remix(nth_thread(thread, i), fmt_conv);
+    if (err < 0) {
+      if (fmt_conv) {
+        cras_fmt_conv_destroy(&fmt_conv);
+      }
+      return err;
+    }
   }
   return 0;
 }
 
 struct audio_thread* audio_thread_create() {
-  int rc;
   struct audio_thread* thread;
 
-  thread = (struct audio_thread*)calloc(1, sizeof(*thread));
+  thread = create_thread();
   if (!thread) {
     return NULL;
   }
 
-  thread->to_thread_fds[0] = -1;
-  thread->to_thread_fds[1] = -1;
-  thread->to_main_fds[0] = -1;
-  thread->to_main_fds[1] = -1;
-
-  // Two way pipes for communication with the device's audio thread.
-  rc = pipe(thread->to_thread_fds);
-  if (rc < 0) {
-    syslog(LOG_ERR, "Failed to pipe");
-    free(thread);
-    return NULL;
-  }
-  rc = pipe(thread->to_main_fds);
-  if (rc < 0) {
-    syslog(LOG_ERR, "Failed to pipe");
-    free(thread);
-    return NULL;
-  }
-
   if (asprintf(&atlog_name, "/ATlog-%d", getpid()) < 0) {
     syslog(LOG_ERR, "Failed to generate ATlog name.");
     exit(-1);
@@ -1199,16 +1845,51 @@ struct audio_thread* audio_thread_create() {
 
   atlog = audio_thread_event_log_init(atlog_name);
 
-  thread->pollfds_size = 32;
-  thread->pollfds =
-      (struct pollfd*)malloc(sizeof(*thread->pollfds) * thread->pollfds_size);
-
   return thread;
 }
 
+int audio_thread_add_workers(struct audio_thread* thread,
+                             unsigned int num_workers) {
+  struct audio_thread* worker;
+  int rc;
+
+  if (!thread->started || thread->workers) {
+    return -EINVAL;
+  }
+  if (!num_workers) {
+    return 0;
+  }
+
+  thread->workers =
+      (struct audio_thread**)calloc(num_workers, sizeof(*thread->workers));
+  if (!thread->workers) {
+    return -ENOMEM;
+  }
+
+  while (thread->num_workers < num_workers) {
+    worker = create_thread();
+    if (!worker) {
+      return -ENOMEM;
+    }
+    worker->is_worker = 1;
+
+    rc = audio_thread_start(worker);
+    if (rc) {
+      destroy_thread(worker);
+      return -rc;
+    }
+    thread->workers[thread->num_workers++] = worker;
+  }
+
+  syslog(LOG_INFO, "Started %u audio worker threads", num_workers);
+  return 0;
+}
+
 int audio_thread_add_open_dev(struct audio_thread* thread,
                               struct cras_iodev* dev) {
   struct audio_thread_open_device_msg msg;
+  struct audio_thread_dev_owner* owner;
+  int rc;
 
   assert(thread && dev);
 
@@ -1217,21 +1898,52 @@ int audio_thread_add_open_dev(struct audio_thread* thread,
   }
 
   init_open_device_msg(&msg, AUDIO_THREAD_ADD_OPEN_DEV, dev);
-  return audio_thread_post_message(thread, &msg.header);
+  if (!thread->num_workers) {
+    return audio_thread_post_message(thread, &msg.header);
+  }
+
+  // Adding an already open device fails on the thread running it.
+  owner = find_dev_owner(thread, dev->direction, dev->info.idx);
+  if (owner) {
+    return audio_thread_post_message(owner->thread, &msg.header);
+  }
+
+  owner = (struct audio_thread_dev_owner*)calloc(1, sizeof(*owner));
+  if (!owner) {
+    return -ENOMEM;
+  }
+  owner->dev = dev;
+  owner->thread = dev_home_thread(thread, dev);
+
+  rc = audio_thread_post_message(owner->thread, &msg.header);
+  if (rc < 0) {
+    free(owner);
+    return rc;
+  }
+  DL_APPEND(thread->dev_owners, owner);
+  return rc;
 }
 
 int audio_thread_rm_open_dev(struct audio_thread* thread,
                              enum CRAS_STREAM_DIRECTION dir,
                              unsigned int dev_idx) {
   struct audio_thread_rm_device_msg msg;
+  struct audio_thread_dev_owner* owner;
+  int rc;
 
   assert(thread);
   if (!thread->started) {
     return -EINVAL;
   }
 
+  owner = find_dev_owner(thread, dir, dev_idx);
   init_rm_device_msg(&msg, dir, dev_idx);
-  return audio_thread_post_message(thread, &msg.header);
+  rc = audio_thread_post_message(owner ? owner->thread : thread, &msg.header);
+  if (owner) {
+    DL_DELETE(thread->dev_owners, owner);
+    free(owner);
+  }
+  return rc;
 }
 
 int audio_thread_is_dev_open(struct audio_thread* thread,
@@ -1243,7 +1955,8 @@ int audio_thread_is_dev_open(struct audio_thread* thread,
   }
 
   init_open_device_msg(&msg, AUDIO_THREAD_IS_DEV_OPEN, dev);
-  return audio_thread_post_message(thread, &msg.header);
+  return audio_thread_post_message(
+      dev_thread(thread, dev->direction, dev->info.idx), &msg.header);
 }
 
 int audio_thread_dev_start_ramp(struct audio_thread* thread,
@@ -1259,7 +1972,8 @@ int audio_thread_dev_start_ramp(struct audio_thread* thread,
 
   init_device_start_ramp_msg(&msg, AUDIO_THREAD_DEV_START_RAMP, dev_idx,
                              request);
-  return audio_thread_post_message(thread, &msg.header);
+  return audio_thread_post_message(
+      dev_thread(thread, CRAS_STREAM_OUTPUT, dev_idx), &msg.header);
 }
 
 int audio_thread_start(struct audio_thread* thread) {
@@ -1273,36 +1987,32 @@ int audio_thread_start(struct audio_thread* thread) {
 
   thread->started = 1;
 
+  // Completions of queued commands are collected in the main loop.
+  rc = cras_system_add_select_fd(thread->done_event_fd, commands_done, thread,
+                                 POLLIN);
+  if (rc < 0) {
+    syslog(LOG_WARNING, "Failed to poll audio thread completions: %d", rc);
+  }
+
   return 0;
 }
 
 void audio_thread_destroy(struct audio_thread* thread) {
-  if (thread->started) {
-    struct audio_thread_msg msg;
+  struct audio_thread_dev_owner* owner;
+  unsigned int i;
 
-    msg.id = AUDIO_THREAD_STOP;
-    msg.length = sizeof(msg);
-    audio_thread_post_message(thread, &msg);
-    pthread_join(thread->tid, NULL);
+  for (i = 0; i < thread->num_workers; i++) {
+    destroy_thread(thread->workers[i]);
   }
+  free(thread->workers);
 
-  free(thread->pollfds);
-
-  audio_thread_event_log_deinit(atlog, atlog_name);
-  free(atlog_name);
-
-  if (thread->to_thread_fds[0] != -1) {
-    close(thread->to_thread_fds[0]);
-    close(thread->to_thread_fds[1]);
-  }
-  if (thread->to_main_fds[0] != -1) {
-    close(thread->to_main_fds[0]);
-    close(thread->to_main_fds[1]);
+  DL_FOREACH (thread->dev_owners, owner) {
+    DL_DELETE(thread->dev_owners, owner);
+    free(owner);
   }
 
-  if (thread->remix_converter) {
-    cras_fmt_conv_destroy(&thread->remix_converter);
-  }
+  destroy_thread(thread);
 
-  free(thread);
+  audio_thread_event_log_deinit(atlog, atlog_name);
+  free(atlog_name);
 }
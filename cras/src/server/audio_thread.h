@@ -13,6 +13,8 @@
 #include "cras/src/server/dev_io.h"
 #include "cras_types.h"
 
+struct audio_thread_cmd_ring;
+struct audio_thread_dev_owner;
 struct buffer_share;
 struct cras_fmt_conv;
 struct cras_iodev;
@@ -23,10 +25,12 @@ struct dev_stream;
  * record audio.
  */
 struct audio_thread {
-  // Send a message from main to running thread.
-  int to_thread_fds[2];
-  // Send a synchronous response to main from running thread.
-  int to_main_fds[2];
+  // Commands queued by the main thread and their results.
+  struct audio_thread_cmd_ring* cmds;
+  // Signaled by the main thread when commands are queued.
+  int cmd_event_fd;
+  // Signaled by the running thread when commands are completed.
+  int done_event_fd;
   // Thread ID of the running playback/capture thread.
   pthread_t tid;
   // Non-zero if the thread has started successfully.
@@ -35,14 +39,29 @@ struct audio_thread {
   int suspended;
   // Lists of open input and output devices.
   struct open_dev* open_devs[CRAS_NUM_DIRECTIONS];
-  // What FDs wake up this thread.
-  struct pollfd* pollfds;
-  // Number of available poll fds.
-  size_t pollfds_size;
-  // Number of currently registered poll fds.
-  size_t num_pollfds;
+  // Epoll set of the client fds of streams attached to this thread's
+  // devices. Updated when streams or devices are added and removed.
+  int stream_epoll_fd;
   // Format converter used to remix output channels.
   struct cras_fmt_conv* remix_converter;
+  // Non-zero if this is a worker thread. Workers run devices but not the
+  // callbacks added by audio_thread_add_events_callback().
+  int is_worker;
+  // Worker threads started by audio_thread_add_workers(), only set on the
+  // primary thread.
+  struct audio_thread** workers;
+  // Number of worker threads.
+  unsigned int num_workers;
+  // Which thread runs each open device, only accessed from main thread.
+  struct audio_thread_dev_owner* dev_owners;
+  // Number of continuous wake ups with zero sleep time.
+  int continuous_zero_sleep_count;
+  // Number of busyloops in the current running state.
+  unsigned int busyloop_count;
+  // Non-zero if the thread has been running streams since
+  // busyloop_start_time.
+  int busyloop_started;
+  struct timespec busyloop_start_time;
 };
 
 /*
@@ -64,6 +83,14 @@ enum AUDIO_THREAD_EVENTS_CB_TRIGGER {
  */
 typedef int (*thread_callback)(void* data, int revent);
 
+/* Called in main thread with the result of a command which was queued
+ * without waiting for the audio thread to handle it.
+ * Args:
+ *    data - The data passed when queuing the command.
+ *    rc - The result of the command.
+ */
+typedef void (*audio_thread_done_cb)(void* data, int rc);
+
 /* Creates an audio thread.
  * Returns:
  *    A pointer to the newly created audio thread.  It must be freed by calling
@@ -71,6 +98,20 @@ typedef int (*thread_callback)(void* data, int revent);
  */
 struct audio_thread* audio_thread_create();
 
+/* Starts worker threads to run open devices besides the primary thread.
+ * Devices are spread over the workers by clock domain, each worker runs its
+ * own devices and polls its own fds. Devices sharing a stream always run on
+ * the same thread. Called from main thread after audio_thread_start() and
+ * before any device is opened.
+ * Args:
+ *    thread - The primary audio thread.
+ *    num_workers - The number of worker threads to start.
+ * Returns:
+ *    0 on success, negative error code on failure.
+ */
+int audio_thread_add_workers(struct audio_thread* thread,
+                             unsigned int num_workers);
+
 /* Adds an open device.
  * Args:
  *    thread - The thread to add open device to.
@@ -97,7 +138,8 @@ int audio_thread_is_dev_open(struct audio_thread* thread,
                              struct cras_iodev* dev);
 
 /* Adds a thread_callback to audio thread for requested events. By default
- * the callback trigger is set to TRIGGER_POLL.
+ * the callback trigger is set to TRIGGER_POLL. Callbacks are run by the
+ * primary audio thread only, devices using them stay on it.
  * Args:
  *    fd - The file descriptor to be polled for the callback.
  *      The callback will be called when any of requested events matched.
@@ -163,6 +205,23 @@ int audio_thread_add_stream(struct audio_thread* thread,
                             struct cras_iodev** devs,
                             unsigned int num_devs);
 
+/* Same as audio_thread_add_stream() but returns once the command is queued,
+ * so a batch of streams costs no round trip to the audio thread. Commands to
+ * one thread run in the order they are queued, and the synchronous calls
+ * wait for the commands queued before them.
+ * Args:
+ *    cb - Called in main thread with the result, can be NULL.
+ *    cb_data - Passed to cb.
+ * Returns:
+ *    0 if the command is queued, negative error code otherwise.
+ */
+int audio_thread_add_stream_async(struct audio_thread* thread,
+                                  struct cras_rstream* stream,
+                                  struct cras_iodev** devs,
+                                  unsigned int num_devs,
+                                  audio_thread_done_cb cb,
+                                  void* cb_data);
+
 /* Begin draining a stream and check the draining status.
  * Args:
  *    thread - a pointer to the audio thread.
@@ -187,6 +246,16 @@ int audio_thread_disconnect_stream(struct audio_thread* thread,
                                    struct cras_rstream* stream,
                                    struct cras_iodev* iodev);
 
+/* Queues disconnecting a stream like audio_thread_add_stream_async(). When
+ * iodev is NULL and the stream may run on any of several threads, cb is
+ * called once per thread.
+ */
+int audio_thread_disconnect_stream_async(struct audio_thread* thread,
+                                         struct cras_rstream* stream,
+                                         struct cras_iodev* iodev,
+                                         audio_thread_done_cb cb,
+                                         void* cb_data);
+
 // Dumps information about all active streams to syslog.
 int audio_thread_dump_thread_info(struct audio_thread* thread,
                                   struct audio_debug_info* info);
@@ -78,7 +78,10 @@ static inline void audio_thread_event_log_data(
     uint32_t data2,
     uint32_t data3) {
   struct timespec now;
-  uint64_t pos_mod_len = log->write_pos % AUDIO_THREAD_EVENT_LOG_SIZE;
+  // Audio worker threads share the log, reserve the entry atomically.
+  uint64_t pos_mod_len =
+      __atomic_fetch_add(&log->write_pos, 1, __ATOMIC_RELAXED) %
+      AUDIO_THREAD_EVENT_LOG_SIZE;
   clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 
   log->log[pos_mod_len].tag_sec = (event << 24) | (now.tv_sec & 0x00ffffff);
@@ -86,8 +89,6 @@ static inline void audio_thread_event_log_data(
   log->log[pos_mod_len].data1 = data1;
   log->log[pos_mod_len].data2 = data2;
   log->log[pos_mod_len].data3 = data3;
-
-  log->write_pos++;
 }
 
 #endif  // CRAS_SRC_SERVER_AUDIO_THREAD_LOG_H_
@@ -28,6 +28,12 @@ static const int32_t MAX_INTERNAL_MIC_GAIN_DEFAULT = 2000;
 static const int32_t MAX_INTERNAL_SPK_CHANNELS_DEFAULT = 2;
 // MAX_HEADPHONE_CHANNELS_DEFAULT applied to both headphone and lineout.
 static const int32_t MAX_HEADPHONE_CHANNELS_DEFAULT = 2;
+// All devices run on the single primary audio thread by default.
+static const int32_t AUDIO_THREAD_WORKERS_DEFAULT = 0;
+// Dsp pipelines run on the audio thread alone by default.
+static const int32_t DSP_HELPER_THREADS_DEFAULT = 0;
+// A2DP packets are encoded in the audio thread by default.
+static const int32_t BLUETOOTH_A2DP_ENCODER_THREAD_DEFAULT = 0;
 
 #define CONFIG_NAME "board.ini"
 #define DEFAULT_OUTPUT_BUF_SIZE_INI_KEY "output:default_output_buffer_size"
@@ -49,6 +55,9 @@ static const int32_t MAX_HEADPHONE_CHANNELS_DEFAULT = 2;
 #define MAX_INTERNAL_MIC_GAIN "input:max_internal_mic_gain"
 #define MAX_INTERNAL_SPK_CHANNELS_INI_KEY "output:max_internal_speaker_channels"
 #define MAX_HEADPHONE_CHANNELS_INI_KEY "output:max_headphone_channels"
+#define AUDIO_THREAD_WORKERS_INI_KEY "audio_thread:workers"
+#define DSP_HELPER_THREADS_INI_KEY "dsp:helper_threads"
+#define BLUETOOTH_A2DP_ENCODER_THREAD_INI_KEY "bluetooth:a2dp_encoder_thread"
 
 void cras_board_config_get(const char* config_path,
                            struct cras_board_config* board_config) {
@@ -77,6 +86,9 @@ void cras_board_config_get(const char* config_path,
   board_config->max_internal_speaker_channels =
       MAX_INTERNAL_SPK_CHANNELS_DEFAULT;
   board_config->max_headphone_channels = MAX_HEADPHONE_CHANNELS_DEFAULT;
+  board_config->audio_thread_workers = AUDIO_THREAD_WORKERS_DEFAULT;
+  board_config->dsp_helper_threads = DSP_HELPER_THREADS_DEFAULT;
+  board_config->bt_a2dp_encoder_thread = BLUETOOTH_A2DP_ENCODER_THREAD_DEFAULT;
   if (config_path == NULL) {
     return;
   }
@@ -185,6 +197,21 @@ void cras_board_config_get(const char* config_path,
   board_config->max_headphone_channels =
       iniparser_getint(ini, ini_key, MAX_HEADPHONE_CHANNELS_DEFAULT);
 
+  snprintf(ini_key, MAX_INI_KEY_LENGTH, AUDIO_THREAD_WORKERS_INI_KEY);
+  ini_key[MAX_INI_KEY_LENGTH] = 0;
+  board_config->audio_thread_workers =
+      iniparser_getint(ini, ini_key, AUDIO_THREAD_WORKERS_DEFAULT);
+
+  snprintf(ini_key, MAX_INI_KEY_LENGTH, DSP_HELPER_THREADS_INI_KEY);
+  ini_key[MAX_INI_KEY_LENGTH] = 0;
+  board_config->dsp_helper_threads =
+      iniparser_getint(ini, ini_key, DSP_HELPER_THREADS_DEFAULT);
+
+  snprintf(ini_key, MAX_INI_KEY_LENGTH, BLUETOOTH_A2DP_ENCODER_THREAD_INI_KEY);
+  ini_key[MAX_INI_KEY_LENGTH] = 0;
+  board_config->bt_a2dp_encoder_thread =
+      iniparser_getint(ini, ini_key, BLUETOOTH_A2DP_ENCODER_THREAD_DEFAULT);
+
   iniparser_freedict(ini);
   syslog(LOG_DEBUG, "Loaded ini file %s", ini_name);
 }
@@ -27,6 +27,9 @@ struct cras_board_config {
   int32_t max_internal_mic_gain;
   int32_t max_internal_speaker_channels;
   int32_t max_headphone_channels;
+  int32_t audio_thread_workers;
+  int32_t dsp_helper_threads;
+  int32_t bt_a2dp_encoder_thread;
 };
 
 /* Gets a configuration based on the config file specified.
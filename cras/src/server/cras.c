@@ -151,6 +151,7 @@ int main(int argc, char** argv) {
     cras_system_state_set_internal_ucm_suffix(internal_ucm_suffix);
   }
   cras_dsp_init(dsp_config);
+  cras_dsp_start_helper_threads(cras_system_get_dsp_helper_threads());
   cras_stream_apm_init(device_config_dir);
   cras_speak_on_mute_detector_init();
   cras_iodev_list_init();
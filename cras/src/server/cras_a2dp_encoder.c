@@ -0,0 +1,374 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // for ppoll
+#endif
+
+#include "cras/src/server/cras_a2dp_encoder.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/param.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "cras/src/server/cras_a2dp_info.h"
+#include "cras/src/server/cras_audio_thread_monitor.h"
+#include "cras_config.h"
+#include "cras_util.h"
+
+// Writes later than this are counted as late.
+static const struct timespec late_write_threshold = {
+    0, 20000000  // 20ms
+};
+
+// Writes later than this are reported as a severe throttle event.
+static const struct timespec throttle_event_threshold = {
+    2, 0  // 2s
+};
+
+// A packet due within this time is written right away.
+static const struct timespec flush_wake_fuzz_ts = {
+    0, 1000000  // 1ms
+};
+
+struct cras_a2dp_encoder {
+  struct cras_a2dp_encoder_config config;
+  /* The PCM ring. Its size is a multiple of the codesize, so the codec
+   * always finds whole blocks before the end of it. */
+  uint8_t* ring;
+  uint64_t ring_bytes;
+  /* The bytes ever written to the ring by the audio thread, and taken from
+   * it and written to the socket by the encoder thread. Each is only
+   * changed by one thread. */
+  uint64_t write_count;
+  uint64_t read_count;
+  uint64_t sent_count;
+  // The time to write the first packet, set before |started|.
+  struct timespec start_time;
+  int started;
+  int stop;
+  // Set while the encoder thread waits for more PCM.
+  int waiting;
+  // The error the encoder thread stopped on.
+  int error;
+  // Wakes up the encoder thread to start, stop or encode more PCM.
+  int event_fd;
+  pthread_t thread;
+  struct cras_a2dp_encoder_stats stats;
+};
+
+static uint64_t load_count(const uint64_t* count) {
+  return __atomic_load_n(count, __ATOMIC_ACQUIRE);
+}
+
+static int should_stop(const struct cras_a2dp_encoder* enc) {
+  return __atomic_load_n(&enc->stop, __ATOMIC_ACQUIRE);
+}
+
+/* Waits for |timeout|, or forever if it's NULL, until an event is signaled
+ * or, if |writable|, the socket becomes writable.
+ * Returns:
+ *    1 if the thread should stop, 0 otherwise.
+ */
+static int wait_event(struct cras_a2dp_encoder* enc,
+                      const struct timespec* timeout,
+                      int writable) {
+  struct pollfd pfds[2] = {
+      {.fd = enc->event_fd, .events = POLLIN},
+      {.fd = enc->config.fd, .events = POLLOUT},
+  };
+  eventfd_t count;
+
+  if (ppoll(pfds, writable ? 2 : 1, timeout, NULL) > 0 &&
+      (pfds[0].revents & POLLIN)) {
+    eventfd_read(enc->event_fd, &count);
+  }
+  return should_stop(enc);
+}
+
+/* Waits for |timeout| until the audio thread writes PCM to the ring, unless
+ * it already did since the ring had |write_count| bytes written. */
+static int wait_pcm(struct cras_a2dp_encoder* enc,
+                    uint64_t write_count,
+                    const struct timespec* timeout) {
+  int rc;
+
+  // Pairs with the audio thread storing write_count before it checks this.
+  __atomic_store_n(&enc->waiting, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&enc->write_count, __ATOMIC_SEQ_CST) != write_count) {
+    rc = should_stop(enc);
+  } else {
+    rc = wait_event(enc, timeout, 0);
+  }
+  __atomic_store_n(&enc->waiting, 0, __ATOMIC_RELAXED);
+  return rc;
+}
+
+/* Encodes PCM from the ring until a packet is full or the ring has less than
+ * one block left.
+ * Returns:
+ *    0 for success, otherwise negative error code.
+ */
+static int encode_packet(struct cras_a2dp_encoder* enc) {
+  const struct cras_a2dp_encoder_config* config = &enc->config;
+  uint64_t read = enc->read_count;
+  uint64_t queued, offset;
+  int processed;
+
+  while ((queued = load_count(&enc->write_count) - read)) {
+    offset = read % enc->ring_bytes;
+    processed = a2dp_encode(config->a2dp, enc->ring + offset,
+                            MIN(queued, enc->ring_bytes - offset),
+                            config->format_bytes, config->mtu);
+    if (processed == -ENOSPC || processed == 0) {
+      break;
+    }
+    if (processed < 0) {
+      return processed;
+    }
+    read += processed;
+    __atomic_store_n(&enc->read_count, read, __ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+// Updates the statistics for a packet written |late| after it was due.
+static void record_write(struct cras_a2dp_encoder* enc,
+                         const struct timespec* late) {
+  struct cras_a2dp_encoder_stats* stats = &enc->stats;
+  uint32_t queued = (load_count(&enc->write_count) - enc->sent_count) /
+                    enc->config.format_bytes;
+
+  __atomic_store_n(&stats->packets, stats->packets + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->max_queued_frames,
+                   MAX(stats->max_queued_frames, queued), __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->sum_queued_frames,
+                   stats->sum_queued_frames + queued, __ATOMIC_RELAXED);
+  if (timespec_after(late, &late_write_threshold)) {
+    __atomic_store_n(&stats->late_writes, stats->late_writes + 1,
+                     __ATOMIC_RELAXED);
+  }
+  if (timespec_after(late, &throttle_event_threshold)) {
+    cras_audio_thread_event_a2dp_throttle();
+  }
+}
+
+// Stops encoding on |err| and waits to be destroyed.
+static void fail(struct cras_a2dp_encoder* enc,
+                 int err,
+                 const struct timespec* now) {
+  __atomic_store_n(&enc->error, err, __ATOMIC_RELEASE);
+  enc->config.write_done(enc->config.arg, err, now);
+  while (!wait_event(enc, NULL, 0)) {
+  }
+}
+
+static void* encoder_thread(void* arg) {
+  struct cras_a2dp_encoder* enc = (struct cras_a2dp_encoder*)arg;
+  const struct cras_a2dp_encoder_config* config = &enc->config;
+  struct timespec next_flush, now, ts;
+  uint64_t write_count, queued;
+  // Set once a flush period without a full packet is counted.
+  int underrun = 0;
+  int written, err;
+
+  if (cras_set_rt_scheduling(CRAS_SERVER_RT_THREAD_PRIORITY) == 0) {
+    cras_set_thread_priority(CRAS_SERVER_RT_THREAD_PRIORITY);
+  }
+
+  while (!__atomic_load_n(&enc->started, __ATOMIC_ACQUIRE)) {
+    if (wait_event(enc, NULL, 0)) {
+      return NULL;
+    }
+  }
+  next_flush = enc->start_time;
+
+  while (!should_stop(enc)) {
+    // Sleep until the next packet is due.
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    ts = now;
+    add_timespecs(&ts, &flush_wake_fuzz_ts);
+    if (!timespec_after(&ts, &next_flush)) {
+      subtract_timespecs(&next_flush, &now, &ts);
+      wait_event(enc, &ts, 0);
+      continue;
+    }
+
+    write_count = load_count(&enc->write_count);
+    err = encode_packet(enc);
+    if (err < 0) {
+      fail(enc, err, &now);
+      break;
+    }
+
+    written = a2dp_write(config->a2dp, config->fd, config->mtu);
+    if (written == -EAGAIN) {
+      config->write_done(config->arg, written, &now);
+      wait_event(enc, &config->flush_period, 1);
+      continue;
+    } else if (written < 0) {
+      fail(enc, written, &now);
+      break;
+    } else if (written == 0) {
+      // Less than a packet of PCM in the ring, wait for the audio thread.
+      if (!underrun) {
+        underrun = 1;
+        __atomic_store_n(&enc->stats.underruns, enc->stats.underruns + 1,
+                         __ATOMIC_RELAXED);
+      }
+      wait_pcm(enc, write_count, &config->flush_period);
+      continue;
+    }
+
+    underrun = 0;
+    __atomic_store_n(&enc->sent_count,
+                     enc->sent_count + written * config->format_bytes,
+                     __ATOMIC_RELEASE);
+    ts.tv_sec = 0;
+    ts.tv_nsec = 0;
+    if (timespec_after(&now, &next_flush)) {
+      subtract_timespecs(&now, &next_flush, &ts);
+    }
+    add_timespecs(&next_flush, &config->flush_period);
+    record_write(enc, &ts);
+    config->write_done(config->arg, written, &now);
+
+    /* Only catch up on missed flush periods while the ring stays above
+     * min_buffer_level after another packet, otherwise write the next one
+     * once the audio thread has written more PCM. */
+    write_count = load_count(&enc->write_count);
+    queued = (write_count - enc->read_count) / config->format_bytes;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    add_timespecs(&now, &flush_wake_fuzz_ts);
+    if (timespec_after(&now, &next_flush) &&
+        queued <= config->min_buffer_level + config->write_block) {
+      wait_pcm(enc, write_count, &config->flush_period);
+    }
+  }
+  return NULL;
+}
+
+struct cras_a2dp_encoder* cras_a2dp_encoder_create(
+    const struct cras_a2dp_encoder_config* config) {
+  struct cras_a2dp_encoder* enc;
+  int codesize = a2dp_codesize(config->a2dp);
+  int rc;
+
+  if (codesize <= 0 || config->max_ring_bytes < (size_t)codesize) {
+    return NULL;
+  }
+
+  enc = (struct cras_a2dp_encoder*)calloc(1, sizeof(*enc));
+  if (!enc) {
+    return NULL;
+  }
+  enc->config = *config;
+  enc->ring_bytes = config->max_ring_bytes / codesize * codesize;
+  enc->ring = (uint8_t*)malloc(enc->ring_bytes);
+  if (!enc->ring) {
+    goto free_enc;
+  }
+  enc->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (enc->event_fd < 0) {
+    syslog(LOG_ERR, "Failed to create a2dp encoder event fd: %d", errno);
+    goto free_ring;
+  }
+
+  rc = pthread_create(&enc->thread, NULL, encoder_thread, enc);
+  if (rc) {
+    syslog(LOG_ERR, "Failed to start a2dp encoder thread: %d", rc);
+    goto close_event_fd;
+  }
+  return enc;
+
+close_event_fd:
+  close(enc->event_fd);
+free_ring:
+  free(enc->ring);
+free_enc:
+  free(enc);
+  return NULL;
+}
+
+void cras_a2dp_encoder_destroy(struct cras_a2dp_encoder* enc) {
+  __atomic_store_n(&enc->stop, 1, __ATOMIC_RELEASE);
+  eventfd_write(enc->event_fd, 1);
+  pthread_join(enc->thread, NULL);
+
+  close(enc->event_fd);
+  free(enc->ring);
+  free(enc);
+}
+
+void cras_a2dp_encoder_start(struct cras_a2dp_encoder* enc,
+                             const struct timespec* next_flush_time) {
+  enc->start_time = *next_flush_time;
+  __atomic_store_n(&enc->started, 1, __ATOMIC_RELEASE);
+  eventfd_write(enc->event_fd, 1);
+}
+
+unsigned int cras_a2dp_encoder_ring_frames(
+    const struct cras_a2dp_encoder* enc) {
+  return enc->ring_bytes / enc->config.format_bytes;
+}
+
+unsigned int cras_a2dp_encoder_queued_frames(
+    const struct cras_a2dp_encoder* enc) {
+  return (enc->write_count - load_count(&enc->sent_count)) /
+         enc->config.format_bytes;
+}
+
+// Returns the number of bytes that can be written at the write position.
+static uint64_t contiguous_writable(const struct cras_a2dp_encoder* enc) {
+  uint64_t queued = enc->write_count - load_count(&enc->read_count);
+
+  return MIN(enc->ring_bytes - queued,
+             enc->ring_bytes - enc->write_count % enc->ring_bytes);
+}
+
+uint8_t* cras_a2dp_encoder_get_buffer(struct cras_a2dp_encoder* enc,
+                                      unsigned int* frames) {
+  *frames = MIN(*frames, contiguous_writable(enc) / enc->config.format_bytes);
+  return enc->ring + enc->write_count % enc->ring_bytes;
+}
+
+int cras_a2dp_encoder_put_buffer(struct cras_a2dp_encoder* enc,
+                                 unsigned int frames) {
+  uint64_t bytes = (uint64_t)frames * enc->config.format_bytes;
+  int err = __atomic_load_n(&enc->error, __ATOMIC_ACQUIRE);
+
+  if (err) {
+    return err;
+  }
+  if (bytes > contiguous_writable(enc)) {
+    return -EINVAL;
+  }
+
+  __atomic_store_n(&enc->write_count, enc->write_count + bytes,
+                   __ATOMIC_SEQ_CST);
+  // Only wake up the encoder thread when it waits for this PCM.
+  if (__atomic_exchange_n(&enc->waiting, 0, __ATOMIC_SEQ_CST)) {
+    eventfd_write(enc->event_fd, 1);
+  }
+  return 0;
+}
+
+void cras_a2dp_encoder_get_stats(const struct cras_a2dp_encoder* enc,
+                                 struct cras_a2dp_encoder_stats* stats) {
+  const struct cras_a2dp_encoder_stats* s = &enc->stats;
+
+  stats->packets = __atomic_load_n(&s->packets, __ATOMIC_RELAXED);
+  stats->max_queued_frames =
+      __atomic_load_n(&s->max_queued_frames, __ATOMIC_RELAXED);
+  stats->sum_queued_frames =
+      __atomic_load_n(&s->sum_queued_frames, __ATOMIC_RELAXED);
+  stats->underruns = __atomic_load_n(&s->underruns, __ATOMIC_RELAXED);
+  stats->late_writes = __atomic_load_n(&s->late_writes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,120 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_SERVER_CRAS_A2DP_ENCODER_H_
+#define CRAS_SRC_SERVER_CRAS_A2DP_ENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct a2dp_info;
+
+/* A thread which encodes and writes the A2DP packets of an a2dp iodev, so
+ * that the SBC encoder doesn't run in the audio thread. The audio thread
+ * writes PCM to a lock free single producer, single consumer ring, and the
+ * encoder thread encodes it and writes one packet to the socket every flush
+ * period.
+ */
+struct cras_a2dp_encoder;
+
+struct cras_a2dp_encoder_config {
+  // The codec and encoded state, only used by the thread until it's stopped.
+  struct a2dp_info* a2dp;
+  // The A2DP socket and its write MTU.
+  int fd;
+  size_t mtu;
+  // Number of bytes per PCM frame.
+  size_t format_bytes;
+  // The maximum size of the PCM ring, rounded down to a multiple of the
+  // codesize.
+  size_t max_ring_bytes;
+  // Number of frames in one A2DP packet, and the time to play them.
+  unsigned int write_block;
+  struct timespec flush_period;
+  // More than one packet is only written in a flush period to catch up,
+  // while there are more than |min_buffer_level| frames left after it.
+  unsigned int min_buffer_level;
+  /* Called in the encoder thread when a packet is written or fails to be.
+   * Args:
+   *    arg - The arg of the config.
+   *    written - The number of frames written, or the negative error code.
+   *    now - The time of the write.
+   */
+  void (*write_done)(void* arg, int written, const struct timespec* now);
+  void* arg;
+};
+
+// The queue depth statistics of an encoder.
+struct cras_a2dp_encoder_stats {
+  // Number of packets written.
+  uint32_t packets;
+  // The most and the sum of the frames queued, sampled at each packet write.
+  uint32_t max_queued_frames;
+  uint64_t sum_queued_frames;
+  // Number of flush periods without a full packet of PCM in the ring.
+  uint32_t underruns;
+  // Number of packets written more than 20ms after they were due.
+  uint32_t late_writes;
+};
+
+/* Creates the encoder and its thread, which waits for
+ * cras_a2dp_encoder_start.
+ * Returns:
+ *    The encoder, or NULL if the ring or the thread can't be created.
+ */
+struct cras_a2dp_encoder* cras_a2dp_encoder_create(
+    const struct cras_a2dp_encoder_config* config);
+
+// Stops the thread and frees the encoder.
+void cras_a2dp_encoder_destroy(struct cras_a2dp_encoder* enc);
+
+/* Lets the thread write its first packet at |next_flush_time|, on
+ * CLOCK_MONOTONIC_RAW. Called from the audio thread. */
+void cras_a2dp_encoder_start(struct cras_a2dp_encoder* enc,
+                             const struct timespec* next_flush_time);
+
+// Returns the size of the PCM ring in frames.
+unsigned int cras_a2dp_encoder_ring_frames(
+    const struct cras_a2dp_encoder* enc);
+
+/* Returns the number of frames written to the ring but not yet to the socket,
+ * including the ones encoded in the pending packet. */
+unsigned int cras_a2dp_encoder_queued_frames(
+    const struct cras_a2dp_encoder* enc);
+
+/* Gets a contiguous part of the ring to write PCM to.
+ * Args:
+ *    enc - The encoder.
+ *    frames - The number of frames wanted, set to the number available.
+ * Returns:
+ *    The pointer to write the frames to.
+ */
+uint8_t* cras_a2dp_encoder_get_buffer(struct cras_a2dp_encoder* enc,
+                                      unsigned int* frames);
+
+/* Hands |frames| frames written to the buffer from
+ * cras_a2dp_encoder_get_buffer to the thread.
+ * Returns:
+ *    0 on success, -EINVAL if more frames are put than got, or the socket
+ *    error the thread stopped writing on.
+ */
+int cras_a2dp_encoder_put_buffer(struct cras_a2dp_encoder* enc,
+                                 unsigned int frames);
+
+/* Gets the queue depth statistics. While the thread runs, each one is read
+ * atomically but they may be from different packet writes. */
+void cras_a2dp_encoder_get_stats(const struct cras_a2dp_encoder* enc,
+                                 struct cras_a2dp_encoder_stats* stats);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_SERVER_CRAS_A2DP_ENCODER_H_
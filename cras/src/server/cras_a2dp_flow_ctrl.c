@@ -0,0 +1,113 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/cras_a2dp_flow_ctrl.h"
+
+#include <errno.h>
+#include <sys/param.h>
+
+#include "cras_util.h"
+
+static void start_window(struct a2dp_flow_ctrl* ctrl,
+                         const struct timespec* now) {
+  ctrl->window_start = *now;
+  ctrl->writes = 0;
+  ctrl->blocked_writes = 0;
+  ctrl->late_writes = 0;
+  ctrl->sock_percent_sum = 0;
+}
+
+static bool window_congested(const struct a2dp_flow_ctrl* ctrl) {
+  return ctrl->blocked_writes || ctrl->late_writes ||
+         ctrl->sock_percent_sum > A2DP_FLOW_CTRL_SOCK_PERCENT * ctrl->writes;
+}
+
+// Lowers the bitpool and buffers one more packet.
+static int back_off(struct a2dp_flow_ctrl* ctrl) {
+  int bitpool = MAX(ctrl->min_bitpool, ctrl->bitpool * 3 / 4);
+  unsigned int level = MIN(ctrl->level + 1, A2DP_FLOW_CTRL_MAX_LEVEL);
+
+  // The last raise was too much for the link, probe less often.
+  if (ctrl->probing) {
+    ctrl->probe_windows =
+        MIN(2 * ctrl->probe_windows, A2DP_FLOW_CTRL_MAX_PROBE_WINDOWS);
+    ctrl->probing = false;
+  }
+  ctrl->clean_windows = 0;
+
+  if (bitpool == ctrl->bitpool && level == ctrl->level) {
+    return 0;
+  }
+  ctrl->bitpool = bitpool;
+  ctrl->level = level;
+  ctrl->lowest_bitpool = MIN(ctrl->lowest_bitpool, bitpool);
+  ctrl->highest_level = MAX(ctrl->highest_level, level);
+  return 1;
+}
+
+// Raises the bitpool and buffers one packet less after enough clean windows.
+static int probe(struct a2dp_flow_ctrl* ctrl) {
+  if (++ctrl->clean_windows < ctrl->probe_windows) {
+    return 0;
+  }
+  ctrl->clean_windows = 0;
+
+  // Back to the best quality for a whole probe, the link has recovered.
+  if (ctrl->bitpool == ctrl->max_bitpool && ctrl->level == 1) {
+    ctrl->probe_windows = A2DP_FLOW_CTRL_MIN_PROBE_WINDOWS;
+    ctrl->probing = false;
+    return 0;
+  }
+  ctrl->bitpool =
+      MIN(ctrl->bitpool + A2DP_FLOW_CTRL_BITPOOL_STEP, ctrl->max_bitpool);
+  ctrl->level = MAX(ctrl->level - 1, 1);
+  ctrl->probing = true;
+  return 1;
+}
+
+void a2dp_flow_ctrl_init(struct a2dp_flow_ctrl* ctrl,
+                         int min_bitpool,
+                         int max_bitpool,
+                         const struct timespec* now) {
+  ctrl->min_bitpool = MAX(min_bitpool, max_bitpool / 2);
+  ctrl->max_bitpool = max_bitpool;
+  ctrl->bitpool = max_bitpool;
+  ctrl->level = 1;
+  ctrl->clean_windows = 0;
+  ctrl->probe_windows = A2DP_FLOW_CTRL_MIN_PROBE_WINDOWS;
+  ctrl->probing = false;
+  ctrl->lowest_bitpool = max_bitpool;
+  ctrl->highest_level = 1;
+  start_window(ctrl, now);
+}
+
+int a2dp_flow_ctrl_write(struct a2dp_flow_ctrl* ctrl,
+                         const struct timespec* now,
+                         int written,
+                         unsigned int late_ms,
+                         unsigned int sock_percent) {
+  struct timespec elapsed;
+  int changed;
+
+  if (written == -EAGAIN) {
+    ctrl->blocked_writes++;
+  } else if (written <= 0) {
+    return 0;
+  }
+  ctrl->writes++;
+  if (late_ms >= A2DP_FLOW_CTRL_LATE_MS) {
+    ctrl->late_writes++;
+  }
+  ctrl->sock_percent_sum += MIN(sock_percent, 100);
+
+  subtract_timespecs(now, &ctrl->window_start, &elapsed);
+  if (timespec_to_ms(&elapsed) < A2DP_FLOW_CTRL_WINDOW_MS) {
+    return 0;
+  }
+
+  changed = window_congested(ctrl) ? back_off(ctrl) : probe(ctrl);
+  start_window(ctrl, now);
+  return changed;
+}
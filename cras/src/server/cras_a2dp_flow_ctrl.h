@@ -0,0 +1,97 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_SERVER_CRAS_A2DP_FLOW_CTRL_H_
+#define CRAS_SRC_SERVER_CRAS_A2DP_FLOW_CTRL_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Adapts the SBC bitpool and the buffering target of an a2dp iodev to how
+ * well the link keeps up with the packet writes. The writes are summed up in
+ * windows of A2DP_FLOW_CTRL_WINDOW_MS. A window with any EAGAIN, any write
+ * late by A2DP_FLOW_CTRL_LATE_MS or more, or with the socket more than
+ * A2DP_FLOW_CTRL_SOCK_PERCENT full on average is congested: the bitpool is
+ * lowered by a quarter and one more packet is buffered. After
+ * |probe_windows| clean windows in a row the bitpool is raised by
+ * A2DP_FLOW_CTRL_BITPOOL_STEP and one packet less is buffered. If the link
+ * congests right after a raise, |probe_windows| doubles so that a link
+ * which can't hold the higher bitpool isn't probed every few seconds. It's
+ * reset once the highest bitpool holds up for a whole probe.
+ *
+ * It doesn't touch the codec or the socket, so that it can be replayed
+ * against recorded write traces.
+ */
+#define A2DP_FLOW_CTRL_WINDOW_MS 500
+#define A2DP_FLOW_CTRL_LATE_MS 20
+#define A2DP_FLOW_CTRL_SOCK_PERCENT 50
+#define A2DP_FLOW_CTRL_BITPOOL_STEP 4
+#define A2DP_FLOW_CTRL_MAX_LEVEL 4
+#define A2DP_FLOW_CTRL_MIN_PROBE_WINDOWS 4
+#define A2DP_FLOW_CTRL_MAX_PROBE_WINDOWS 64
+
+struct a2dp_flow_ctrl {
+  // The bitpool range allowed, and the bitpool to encode with.
+  int min_bitpool;
+  int max_bitpool;
+  int bitpool;
+  // The number of packets to keep buffered, from 1 to
+  // A2DP_FLOW_CTRL_MAX_LEVEL.
+  unsigned int level;
+  // The start of the current window and the writes summed up in it.
+  struct timespec window_start;
+  unsigned int writes;
+  unsigned int blocked_writes;
+  unsigned int late_writes;
+  unsigned int sock_percent_sum;
+  // Clean windows in a row, and how many it takes to raise the bitpool.
+  unsigned int clean_windows;
+  unsigned int probe_windows;
+  // Whether the last change raised the bitpool.
+  bool probing;
+  // The lowest bitpool and the highest level used, for logging.
+  int lowest_bitpool;
+  unsigned int highest_level;
+};
+
+/* Starts at the highest bitpool and one packet buffered.
+ * Args:
+ *    ctrl - The controller.
+ *    min_bitpool, max_bitpool - The bitpool range of the codec config. The
+ *        bitpool isn't lowered below half of |max_bitpool|.
+ *    now - The time of the start of the first window.
+ */
+void a2dp_flow_ctrl_init(struct a2dp_flow_ctrl* ctrl,
+                         int min_bitpool,
+                         int max_bitpool,
+                         const struct timespec* now);
+
+/* Adds a packet write to the current window, and adapts to the window once
+ * it's over.
+ * Args:
+ *    ctrl - The controller.
+ *    now - The time of the write.
+ *    written - The frames written, or -EAGAIN. Writes of nothing and other
+ *        errors are ignored.
+ *    late_ms - How late the write was from its schedule.
+ *    sock_percent - How full the socket send buffer was before the write.
+ * Returns:
+ *    1 if the bitpool or the level changed, otherwise 0.
+ */
+int a2dp_flow_ctrl_write(struct a2dp_flow_ctrl* ctrl,
+                         const struct timespec* now,
+                         int written,
+                         unsigned int late_ms,
+                         unsigned int sock_percent);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_SERVER_CRAS_A2DP_FLOW_CTRL_H_
@@ -7,6 +7,7 @@
 
 #include <netinet/in.h>
 #include <sbc/sbc.h>
+#include <sys/param.h>
 #include <syslog.h>
 
 #include "cras/src/common/cras_sbc_codec.h"
@@ -78,6 +79,9 @@ int init_a2dp(struct a2dp_info* a2dp, a2dp_sbc_t* sbc) {
   // SBC info
   a2dp->codesize = cras_sbc_get_codesize(a2dp->codec);
   a2dp->frame_length = cras_sbc_get_frame_length(a2dp->codec);
+  a2dp->min_bitpool = MIN(sbc->min_bitpool, bitpool);
+  a2dp->max_bitpool = bitpool;
+  a2dp->bitpool = bitpool;
 
   a2dp->a2dp_buf_used = sizeof(struct rtp_header) + sizeof(struct rtp_payload);
   a2dp->frame_count = 0;
@@ -95,6 +99,15 @@ int a2dp_codesize(struct a2dp_info* a2dp) {
   return a2dp->codesize;
 }
 
+void a2dp_set_bitpool(struct a2dp_info* a2dp, int bitpool) {
+  bitpool = MAX(a2dp->min_bitpool, MIN(bitpool, a2dp->max_bitpool));
+  if (bitpool == a2dp->bitpool) {
+    return;
+  }
+  a2dp->bitpool = bitpool;
+  a2dp->frame_length = cras_sbc_set_bitpool(a2dp->codec, bitpool);
+}
+
 int a2dp_block_size(struct a2dp_info* a2dp, int a2dp_bytes) {
   return a2dp_bytes / a2dp->frame_length * a2dp->codesize;
 }
@@ -23,6 +23,10 @@ struct a2dp_info {
   int codesize;
   // Size of an encoded SBC frame in bytes.
   int frame_length;
+  // The bitpool range of the configuration, and the bitpool in use.
+  int min_bitpool;
+  int max_bitpool;
+  int bitpool;
   // Queued SBC frame count currently in a2dp buffer.
   int frame_count;
   // Sequence number in rtp header.
@@ -50,6 +54,12 @@ void destroy_a2dp(struct a2dp_info* a2dp);
  */
 int a2dp_codesize(struct a2dp_info* a2dp);
 
+/*
+ * Changes the bitpool of the following encoded frames, clamped to the range
+ * of the configuration. Updates frame_length to match.
+ */
+void a2dp_set_bitpool(struct a2dp_info* a2dp, int bitpool);
+
 /*
  * Gets original size of a2dp encoded bytes.
  */
@@ -17,15 +17,19 @@
 #include "cras/src/common/byte_buffer.h"
 #include "cras/src/server/audio_thread.h"
 #include "cras/src/server/audio_thread_log.h"
+#include "cras/src/server/cras_a2dp_encoder.h"
 #include "cras/src/server/cras_a2dp_endpoint.h"
+#include "cras/src/server/cras_a2dp_flow_ctrl.h"
 #include "cras/src/server/cras_a2dp_info.h"
 #include "cras/src/server/cras_audio_area.h"
 #include "cras/src/server/cras_audio_thread_monitor.h"
 #include "cras/src/server/cras_bt_device.h"
+#include "cras/src/server/cras_bt_log.h"
 #include "cras/src/server/cras_bt_policy.h"
 #include "cras/src/server/cras_iodev.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_server_metrics.h"
+#include "cras/src/server/cras_system_state.h"
 #include "cras_util.h"
 #include "third_party/bluez/rtp.h"
 #include "third_party/strlcpy/strlcpy.h"
@@ -52,10 +56,17 @@ struct a2dp_io {
   struct a2dp_info a2dp;
   // The transport object for bluez media API.
   struct cras_bt_transport* transport;
-  // Socket depth in frames of the a2dp socket.
+  // Socket depth in bytes and in frames of the a2dp socket.
+  int sock_depth;
   unsigned sock_depth_frames;
   // Buffer to hold pcm samples before encode.
   struct byte_buffer* pcm_buf;
+  /* Adapts the bitpool and min_buffer_level to the packet writes, when they
+   * are done in the audio thread. */
+  struct a2dp_flow_ctrl flow_ctrl;
+  /* The thread to encode and flush pcm samples when it's enabled in
+   * board.ini, used instead of pcm_buf. */
+  struct cras_a2dp_encoder* encoder;
   // Flag to note if this a2dp_io is about to destroy.
   int destroyed;
   // The time when it is okay for next flush call.
@@ -82,6 +93,8 @@ struct a2dp_io {
 };
 
 static int encode_and_flush(const struct cras_iodev* iodev);
+static struct cras_a2dp_encoder* create_encoder(struct a2dp_io* a2dpio);
+static void destroy_encoder(struct a2dp_io* a2dpio);
 
 static int update_supported_formats(struct cras_iodev* iodev) {
   struct a2dp_io* a2dpio = (struct a2dp_io*)iodev;
@@ -124,6 +137,9 @@ static int update_supported_formats(struct cras_iodev* iodev) {
 
 static unsigned int bt_local_queued_frames(const struct cras_iodev* iodev) {
   struct a2dp_io* a2dpio = (struct a2dp_io*)iodev;
+  if (a2dpio->encoder) {
+    return cras_a2dp_encoder_queued_frames(a2dpio->encoder);
+  }
   return a2dp_queued_frames(&a2dpio->a2dp) +
          buf_queued(a2dpio->pcm_buf) / cras_get_format_bytes(iodev->format);
 }
@@ -266,12 +282,32 @@ static int a2dp_socket_write_cb(void* arg, int revent) {
   return encode_and_flush(iodev);
 }
 
+/* Sizes the packet writes to the frame length of the current bitpool.
+ * Per avdtp_write, subtract the room for packet header first. Calculate how
+ * many frames are encapsulated in one a2dp packet, and the corresponding
+ * time period between two packets.
+ */
+static void update_write_block(struct a2dp_io* a2dpio) {
+  struct cras_iodev* iodev = &a2dpio->base;
+  size_t format_bytes = cras_get_format_bytes(iodev->format);
+  int a2dp_payload_length;
+
+  a2dpio->sock_depth_frames =
+      a2dp_block_size(&a2dpio->a2dp, a2dpio->sock_depth) / format_bytes;
+  a2dp_payload_length = cras_bt_transport_write_mtu(a2dpio->transport) -
+                        sizeof(struct rtp_header) - sizeof(struct rtp_payload);
+  a2dpio->write_block =
+      a2dp_block_size(&a2dpio->a2dp, a2dp_payload_length) / format_bytes;
+  cras_frames_to_time(a2dpio->write_block, iodev->format->frame_rate,
+                      &a2dpio->flush_period);
+}
+
 static int configure_dev(struct cras_iodev* iodev) {
   struct a2dp_io* a2dpio = (struct a2dp_io*)iodev;
   int sock_depth;
   int err;
   socklen_t optlen;
-  int a2dp_payload_length;
+  struct timespec now;
 
   err = cras_bt_transport_acquire(a2dpio->transport);
   if (err < 0) {
@@ -286,11 +322,6 @@ static int configure_dev(struct cras_iodev* iodev) {
   iodev->format->format = SND_PCM_FORMAT_S16_LE;
   cras_iodev_init_audio_area(iodev, iodev->format->num_channels);
 
-  a2dpio->pcm_buf = byte_buffer_create(PCM_BUF_MAX_SIZE_BYTES);
-  if (!a2dpio->pcm_buf) {
-    return -ENOMEM;
-  }
-
   /* Set up the socket to hold two MTUs full of data before returning
    * EAGAIN.  This will allow the write to be throttled when a reasonable
    * amount of data is queued. */
@@ -300,22 +331,11 @@ static int configure_dev(struct cras_iodev* iodev) {
   optlen = sizeof(sock_depth);
   getsockopt(cras_bt_transport_fd(a2dpio->transport), SOL_SOCKET, SO_SNDBUF,
              &sock_depth, &optlen);
-  a2dpio->sock_depth_frames = a2dp_block_size(&a2dpio->a2dp, sock_depth) /
-                              cras_get_format_bytes(iodev->format);
-  /*
-   * Per avdtp_write, subtract the room for packet header first.
-   * Calculate how many frames are encapsulated in one a2dp packet, and
-   * the corresponding time period between two packets.
-   */
-  a2dp_payload_length = cras_bt_transport_write_mtu(a2dpio->transport) -
-                        sizeof(struct rtp_header) - sizeof(struct rtp_payload);
-  a2dpio->write_block = a2dp_block_size(&a2dpio->a2dp, a2dp_payload_length) /
-                        cras_get_format_bytes(iodev->format);
-  cras_frames_to_time(a2dpio->write_block, iodev->format->frame_rate,
-                      &a2dpio->flush_period);
+  a2dpio->sock_depth = sock_depth;
 
-  // PCM buffer size plus one encoded a2dp packet.
-  iodev->buffer_size = PCM_BUF_MAX_SIZE_FRAMES + a2dpio->write_block;
+  // Start at the best quality the headset allows.
+  a2dp_set_bitpool(&a2dpio->a2dp, a2dpio->a2dp.max_bitpool);
+  update_write_block(a2dpio);
 
   /*
    * Buffer level less than one write_block can't be send over a2dp
@@ -324,11 +344,36 @@ static int configure_dev(struct cras_iodev* iodev) {
    */
   iodev->min_buffer_level = a2dpio->write_block;
 
-  audio_thread_add_events_callback(cras_bt_transport_fd(a2dpio->transport),
-                                   a2dp_socket_write_cb, iodev,
-                                   POLLOUT | POLLERR | POLLHUP);
-  audio_thread_config_events_callback(cras_bt_transport_fd(a2dpio->transport),
-                                      TRIGGER_NONE);
+  if (cras_system_get_bt_a2dp_encoder_thread()) {
+    a2dpio->encoder = create_encoder(a2dpio);
+    if (!a2dpio->encoder) {
+      syslog(LOG_WARNING, "Encode A2DP in audio thread instead");
+    }
+  }
+
+  if (a2dpio->encoder) {
+    // PCM ring size plus one encoded a2dp packet.
+    iodev->buffer_size = cras_a2dp_encoder_ring_frames(a2dpio->encoder) +
+                         a2dpio->write_block;
+  } else {
+    a2dpio->pcm_buf = byte_buffer_create(PCM_BUF_MAX_SIZE_BYTES);
+    if (!a2dpio->pcm_buf) {
+      return -ENOMEM;
+    }
+
+    // PCM buffer size plus one encoded a2dp packet.
+    iodev->buffer_size = PCM_BUF_MAX_SIZE_FRAMES + a2dpio->write_block;
+
+    audio_thread_add_events_callback(cras_bt_transport_fd(a2dpio->transport),
+                                     a2dp_socket_write_cb, iodev,
+                                     POLLOUT | POLLERR | POLLHUP);
+    audio_thread_config_events_callback(
+        cras_bt_transport_fd(a2dpio->transport), TRIGGER_NONE);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+  a2dp_flow_ctrl_init(&a2dpio->flow_ctrl, a2dpio->a2dp.min_bitpool,
+                      a2dpio->a2dp.max_bitpool, &now);
 
   a2dpio->in_write_fail = 0;
   a2dpio->write_20ms_fail_time.tv_sec = 0;
@@ -360,6 +405,10 @@ static int start(struct cras_iodev* iodev) {
                         &extra_init_sleep);
     add_timespecs(&a2dpio->next_flush_time, &extra_init_sleep);
   }
+
+  if (a2dpio->encoder) {
+    cras_a2dp_encoder_start(a2dpio->encoder, &a2dpio->next_flush_time);
+  }
   return 0;
 }
 
@@ -405,10 +454,16 @@ static int close_dev(struct cras_iodev* iodev) {
     return 0;
   }
 
-  /* Remove audio thread callback and sync before releasing
-   * the transport. */
-  audio_thread_rm_callback_sync(cras_iodev_list_get_audio_thread(),
-                                cras_bt_transport_fd(a2dpio->transport));
+  /* Stop the encoder thread, or remove audio thread callback and sync
+   * before releasing the transport. */
+  if (a2dpio->encoder) {
+    destroy_encoder(a2dpio);
+  } else {
+    audio_thread_rm_callback_sync(cras_iodev_list_get_audio_thread(),
+                                  cras_bt_transport_fd(a2dpio->transport));
+    BTLOG(btlog, BT_A2DP_FLOW_CTRL, a2dpio->flow_ctrl.lowest_bitpool,
+          a2dpio->flow_ctrl.highest_level);
+  }
 
   err = cras_bt_transport_release(a2dpio->transport, !a2dpio->destroyed);
   if (err < 0) {
@@ -442,6 +497,12 @@ static unsigned int frames_to_play_in_sleep(struct cras_iodev* iodev,
     *hw_level -= a2dpio->write_block;
   }
 
+  /* The encoder thread paces the packet writes itself, wake up once per
+   * packet to keep its ring filled. */
+  if (a2dpio->encoder) {
+    return a2dpio->write_block;
+  }
+
   frames_until = cras_frames_until_time(&a2dpio->next_flush_time,
                                         iodev->format->frame_rate);
   if (frames_until > 0) {
@@ -481,6 +542,79 @@ static void track_write_status(struct a2dp_io* a2dpio,
   }
 }
 
+// Handles a packet write which failed with EAGAIN.
+static void write_would_block(struct a2dp_io* a2dpio,
+                              struct cras_bt_device* device,
+                              const struct timespec* now) {
+  /* If EAGAIN error lasts longer than 5 seconds, suspend the
+   * a2dp connection. */
+  cras_bt_policy_schedule_suspend(device, 5000, A2DP_LONG_TX_FAILURE);
+  a2dpio->exit_code = A2DP_EXIT_LONG_TX_FAILURE;
+
+  // Track one failure because of EAGAIN error.
+  track_write_status(a2dpio, false, now);
+}
+
+// Handles a packet write which failed with an error other than EAGAIN.
+static void write_failed(struct a2dp_io* a2dpio,
+                         struct cras_bt_device* device,
+                         int err) {
+  /* This socket error could be triggered more than once before
+   * a2dp iodev suspended. We want to track the first error so
+   * check before we overwrite it. */
+  if (!a2dpio->exit_code) {
+    /* ECONNRESET is a common error when the remote headset
+     * initiates disconnection so separate it from other
+     * rarely happened errors. */
+    if (err == -ECONNRESET) {
+      a2dpio->exit_code = A2DP_EXIT_CONN_RESET;
+    } else {
+      a2dpio->exit_code = A2DP_EXIT_TX_FATAL_ERROR;
+      syslog(LOG_WARNING, "A2DP socket write error %d", err);
+    }
+  }
+
+  /* Suspend a2dp immediately when receives error other than
+   * EAGAIN. */
+  cras_bt_policy_cancel_suspend(device);
+  cras_bt_policy_schedule_suspend(device, 0, A2DP_TX_FATAL_ERROR);
+}
+
+/* Returns how full the send buffer of the a2dp socket is, in percent. Unlike
+ * TCP, SIOCOUTQ on a bluetooth socket reports the space left in the send
+ * buffer rather than the bytes queued. */
+static unsigned int sock_queued_percent(const struct a2dp_io* a2dpio) {
+  int space;
+
+  if (a2dpio->sock_depth <= 0 ||
+      ioctl(cras_bt_transport_fd(a2dpio->transport), SIOCOUTQ, &space) < 0) {
+    return 0;
+  }
+  space = MIN(MAX(space, 0), a2dpio->sock_depth);
+  return 100 * (a2dpio->sock_depth - space) / a2dpio->sock_depth;
+}
+
+/* Lets the flow control adapt to a packet write, and applies the bitpool and
+ * buffering target it picks to the following packets. */
+static void adapt_to_write(struct a2dp_io* a2dpio,
+                           const struct timespec* now,
+                           int written,
+                           unsigned int late_ms,
+                           unsigned int sock_percent) {
+  struct a2dp_flow_ctrl* ctrl = &a2dpio->flow_ctrl;
+
+  if (!a2dp_flow_ctrl_write(ctrl, now, written, late_ms, sock_percent)) {
+    return;
+  }
+
+  a2dp_set_bitpool(&a2dpio->a2dp, ctrl->bitpool);
+  update_write_block(a2dpio);
+  a2dpio->base.buffer_size = PCM_BUF_MAX_SIZE_FRAMES + a2dpio->write_block;
+  a2dpio->base.min_buffer_level = ctrl->level * a2dpio->write_block;
+  ATLOG(atlog, AUDIO_THREAD_A2DP_FLOW_CTRL, ctrl->bitpool, ctrl->level,
+        a2dpio->write_block);
+}
+
 /* Encodes PCM data to a2dp frames and try to flush it to the socket.
  * Returns:
  *    0 when the flush succeeded, -1 when error occurred.
@@ -490,6 +624,7 @@ static int encode_and_flush(const struct cras_iodev* iodev) {
   size_t format_bytes;
   int written = 0;
   unsigned int queued_frames;
+  unsigned int late_ms, sock_percent;
   struct a2dp_io* a2dpio;
   struct cras_bt_device* device;
   struct timespec now, ts;
@@ -507,6 +642,11 @@ static int encode_and_flush(const struct cras_iodev* iodev) {
     return -EINVAL;
   }
 
+  // The encoder thread flushes the PCM on its own.
+  if (a2dpio->encoder) {
+    return 0;
+  }
+
   ATLOG(atlog, AUDIO_THREAD_A2DP_FLUSH, iodev->state,
         a2dpio->next_flush_time.tv_sec, a2dpio->next_flush_time.tv_nsec);
 
@@ -544,6 +684,7 @@ do_flush:
   /* If the A2DP write schedule miss exceeds a small threshold, log it for
    * debug purpose. */
   subtract_timespecs(&now, &a2dpio->next_flush_time, &ts);
+  late_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
   if (timespec_after(&ts, &throttle_log_threshold)) {
     ATLOG(atlog, AUDIO_THREAD_A2DP_THROTTLE_TIME, ts.tv_sec, ts.tv_nsec,
           bt_local_queued_frames(iodev));
@@ -555,41 +696,19 @@ do_flush:
     cras_audio_thread_event_a2dp_throttle();
   }
 
+  sock_percent = sock_queued_percent(a2dpio);
   written = a2dp_write(&a2dpio->a2dp, cras_bt_transport_fd(a2dpio->transport),
                        cras_bt_transport_write_mtu(a2dpio->transport));
   ATLOG(atlog, AUDIO_THREAD_A2DP_WRITE, written,
-        a2dp_queued_frames(&a2dpio->a2dp), 0);
+        a2dp_queued_frames(&a2dpio->a2dp), sock_percent);
+  adapt_to_write(a2dpio, &now, written, late_ms, sock_percent);
   if (written == -EAGAIN) {
-    /* If EAGAIN error lasts longer than 5 seconds, suspend the
-     * a2dp connection. */
-    cras_bt_policy_schedule_suspend(device, 5000, A2DP_LONG_TX_FAILURE);
-    a2dpio->exit_code = A2DP_EXIT_LONG_TX_FAILURE;
-
+    write_would_block(a2dpio, device, &now);
     audio_thread_config_events_callback(cras_bt_transport_fd(a2dpio->transport),
                                         TRIGGER_POLL);
-    // Track one failure because of EAGAIN error.
-    track_write_status(a2dpio, false, &now);
     return 0;
   } else if (written < 0) {
-    /* This socket error could be triggered more than once before
-     * a2dp iodev suspended. We want to track the first error so
-     * check before we overwrite it. */
-    if (!a2dpio->exit_code) {
-      /* ECONNRESET is a common error when the remote headset
-       * initiates disconnection so separate it from other
-       * rarely happened errors. */
-      if (written == -ECONNRESET) {
-        a2dpio->exit_code = A2DP_EXIT_CONN_RESET;
-      } else {
-        a2dpio->exit_code = A2DP_EXIT_TX_FATAL_ERROR;
-        syslog(LOG_WARNING, "A2DP socket write error %d", written);
-      }
-    }
-
-    /* Suspend a2dp immediately when receives error other than
-     * EAGAIN. */
-    cras_bt_policy_cancel_suspend(device);
-    cras_bt_policy_schedule_suspend(device, 0, A2DP_TX_FATAL_ERROR);
+    write_failed(a2dpio, device, written);
     /* Stop polling the socket in audio thread. Main thread will
      * close this iodev soon. */
     audio_thread_config_events_callback(cras_bt_transport_fd(a2dpio->transport),
@@ -630,6 +749,59 @@ do_flush:
   return 0;
 }
 
+/* Handles the result of a packet write in the encoder thread, like
+ * encode_and_flush does in the audio thread. */
+static void encoder_write_done(void* arg,
+                               int written,
+                               const struct timespec* now) {
+  struct a2dp_io* a2dpio = (struct a2dp_io*)arg;
+  struct cras_bt_device* device = cras_bt_transport_device(a2dpio->transport);
+
+  if (device == NULL) {
+    return;
+  }
+
+  if (written == -EAGAIN) {
+    write_would_block(a2dpio, device, now);
+  } else if (written < 0) {
+    write_failed(a2dpio, device, written);
+  } else {
+    track_write_status(a2dpio, true, now);
+    cras_bt_policy_cancel_suspend(device);
+  }
+}
+
+static struct cras_a2dp_encoder* create_encoder(struct a2dp_io* a2dpio) {
+  struct cras_a2dp_encoder_config config = {
+      .a2dp = &a2dpio->a2dp,
+      .fd = cras_bt_transport_fd(a2dpio->transport),
+      .mtu = cras_bt_transport_write_mtu(a2dpio->transport),
+      .format_bytes = cras_get_format_bytes(a2dpio->base.format),
+      .max_ring_bytes = PCM_BUF_MAX_SIZE_BYTES,
+      .write_block = a2dpio->write_block,
+      .flush_period = a2dpio->flush_period,
+      .min_buffer_level = a2dpio->base.min_buffer_level,
+      .write_done = encoder_write_done,
+      .arg = a2dpio,
+  };
+
+  return cras_a2dp_encoder_create(&config);
+}
+
+/* Stops the encoder thread and logs how deep its PCM ring was kept, from
+ * here in the main thread as the bt event log isn't thread safe. */
+static void destroy_encoder(struct a2dp_io* a2dpio) {
+  struct cras_a2dp_encoder_stats stats;
+
+  cras_a2dp_encoder_get_stats(a2dpio->encoder, &stats);
+  cras_a2dp_encoder_destroy(a2dpio->encoder);
+  a2dpio->encoder = NULL;
+
+  BTLOG(btlog, BT_A2DP_ENCODER_QUEUE, stats.max_queued_frames,
+        stats.packets ? stats.sum_queued_frames / stats.packets : 0);
+  BTLOG(btlog, BT_A2DP_ENCODER_UNDERRUN, stats.underruns, stats.late_writes);
+}
+
 static int delay_frames(const struct cras_iodev* iodev) {
   const struct a2dp_io* a2dpio = (struct a2dp_io*)iodev;
   struct timespec tstamp;
@@ -643,6 +815,7 @@ static int get_buffer(struct cras_iodev* iodev,
                       unsigned* frames) {
   size_t format_bytes;
   struct a2dp_io* a2dpio;
+  uint8_t* buf;
 
   a2dpio = (struct a2dp_io*)iodev;
 
@@ -652,10 +825,14 @@ static int get_buffer(struct cras_iodev* iodev,
     return 0;
   }
 
-  *frames = MIN(*frames, buf_writable(a2dpio->pcm_buf) / format_bytes);
+  if (a2dpio->encoder) {
+    buf = cras_a2dp_encoder_get_buffer(a2dpio->encoder, frames);
+  } else {
+    *frames = MIN(*frames, buf_writable(a2dpio->pcm_buf) / format_bytes);
+    buf = buf_write_pointer(a2dpio->pcm_buf);
+  }
   iodev->area->frames = *frames;
-  cras_audio_area_config_buf_pointers(iodev->area, iodev->format,
-                                      buf_write_pointer(a2dpio->pcm_buf));
+  cras_audio_area_config_buf_pointers(iodev->area, iodev->format, buf);
   *area = iodev->area;
   return 0;
 }
@@ -665,6 +842,10 @@ static int put_buffer(struct cras_iodev* iodev, unsigned nwritten) {
   size_t format_bytes;
   struct a2dp_io* a2dpio = (struct a2dp_io*)iodev;
 
+  if (a2dpio->encoder) {
+    return cras_a2dp_encoder_put_buffer(a2dpio->encoder, nwritten);
+  }
+
   format_bytes = cras_get_format_bytes(iodev->format);
   written_bytes = nwritten * format_bytes;
 
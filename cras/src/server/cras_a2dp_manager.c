@@ -50,6 +50,10 @@ struct cras_a2dp {
   struct cras_iodev* iodev;
   // The socket fd to send pcm audio to the a2dp device.
   int fd;
+  // If Floss is reading pcm audio from a shared memory ring instead of fd.
+  bool pcm_shm_started;
+  // Set once Floss refused the shared memory ring, to not ask again.
+  bool pcm_shm_unsupported;
   // Timer to schedule suspending iodev at failures.
   struct cras_timer* suspend_timer;
   // The object representing scheduled delay sync task.
@@ -465,12 +469,15 @@ static void collect_write_fail_stats(struct cras_a2dp* a2dp) {
 }
 
 int cras_floss_a2dp_stop(struct cras_a2dp* a2dp) {
-  if (a2dp->fd < 0) {
+  if (a2dp->fd < 0 && !a2dp->pcm_shm_started) {
     return 0;
   }
 
-  close(a2dp->fd);
-  a2dp->fd = -1;
+  if (a2dp->fd >= 0) {
+    close(a2dp->fd);
+    a2dp->fd = -1;
+  }
+  a2dp->pcm_shm_started = false;
 
   collect_write_fail_stats(a2dp);
 
@@ -565,6 +572,14 @@ static void audio_format_to_floss(const struct cras_audio_format* fmt,
   }
 }
 
+static void reset_write_status(struct cras_a2dp* a2dp) {
+  a2dp->in_write_fail = 0;
+  a2dp->write_20ms_fail_time.tv_sec = 0;
+  a2dp->write_20ms_fail_time.tv_nsec = 0;
+  a2dp->write_100ms_fail_time.tv_sec = 0;
+  a2dp->write_100ms_fail_time.tv_nsec = 0;
+}
+
 int cras_floss_a2dp_start(struct cras_a2dp* a2dp,
                           struct cras_audio_format* fmt) {
   int skt_fd;
@@ -617,11 +632,7 @@ int cras_floss_a2dp_start(struct cras_a2dp* a2dp,
   a2dp->fd = skt_fd;
   BTLOG(btlog, BT_A2DP_REQUEST_START, 1, 0);
 
-  a2dp->in_write_fail = 0;
-  a2dp->write_20ms_fail_time.tv_sec = 0;
-  a2dp->write_20ms_fail_time.tv_sec = 0;
-  a2dp->write_100ms_fail_time.tv_nsec = 0;
-  a2dp->write_100ms_fail_time.tv_nsec = 0;
+  reset_write_status(a2dp);
   return 0;
 error:
   BTLOG(btlog, BT_A2DP_REQUEST_START, 0, 0);
@@ -633,6 +644,49 @@ error:
   return rc;
 }
 
+int cras_floss_a2dp_start_shm(struct cras_a2dp* a2dp,
+                              struct cras_audio_format* fmt,
+                              int header_fd,
+                              int samples_fd) {
+  int rc;
+  int sample_rate, bits_per_sample, channel_mode;
+
+  if (a2dp->pcm_shm_unsupported) {
+    return -EOPNOTSUPP;
+  }
+
+  audio_format_to_floss(fmt, &sample_rate, &bits_per_sample, &channel_mode);
+  floss_media_a2dp_set_audio_config(a2dp->fm, sample_rate, bits_per_sample,
+                                    channel_mode);
+
+  /* Hand the ring to Floss before the audio session starts, so that it
+   * never opens the data socket for this session. */
+  rc = floss_media_a2dp_set_pcm_shm(a2dp->fm, header_fd, samples_fd);
+  if (rc < 0) {
+    syslog(LOG_INFO, "Floss doesn't take the PCM ring: %d, use the socket",
+           rc);
+    // Only an older Floss without the method refuses it for good.
+    if (rc == -EOPNOTSUPP) {
+      a2dp->pcm_shm_unsupported = true;
+    }
+    return -EOPNOTSUPP;
+  }
+
+  rc = floss_media_a2dp_start_audio_request(a2dp->fm, a2dp->addr);
+  if (rc < 0) {
+    syslog(LOG_WARNING, "A2DP start audio request failed");
+    BTLOG(btlog, BT_A2DP_REQUEST_START, 0, 0);
+    floss_media_a2dp_stop_audio_request(a2dp->fm);
+    return rc;
+  }
+
+  a2dp->pcm_shm_started = true;
+  BTLOG(btlog, BT_A2DP_REQUEST_START, 1, 0);
+
+  reset_write_status(a2dp);
+  return 0;
+}
+
 void cras_floss_a2dp_set_active(struct cras_a2dp* a2dp, unsigned enabled) {
   // Clear session.
   // TODO: Handle enable/disable logic in Floss
@@ -58,6 +58,23 @@ const char* cras_floss_a2dp_get_addr(struct cras_a2dp* a2dp);
 int cras_floss_a2dp_start(struct cras_a2dp* a2dp,
                           struct cras_audio_format* fmt);
 
+/* Starts a2dp streaming with Floss reading PCM from a cras_audio_shm ring
+ * rather than from the socket, so there's no fd to write to.
+ * Args:
+ *    a2dp - The a2dp instance to start streaming.
+ *    fmt - The PCM format to select for streaming.
+ *    header_fd, samples_fd - The fds of the header and samples areas of the
+ *        ring.
+ * Returns:
+ *    0 for success, otherwise error code. -EOPNOTSUPP if Floss didn't take
+ *    the ring, and cras_floss_a2dp_start should be used instead. Any other
+ *    error is from starting the session after Floss took the ring.
+ */
+int cras_floss_a2dp_start_shm(struct cras_a2dp* a2dp,
+                              struct cras_audio_format* fmt,
+                              int header_fd,
+                              int samples_fd);
+
 // Stops a2dp streaming.
 int cras_floss_a2dp_stop(struct cras_a2dp* a2dp);
 
@@ -80,6 +80,8 @@ struct alsa_io {
   char* dev_name;
   // value from snd_pcm_info_get_id
   char* dev_id;
+  // ALSA index of the card, X in "hw:X:Y".
+  uint32_t card_index;
   // ALSA index of device, Y in "hw:X:Y".
   uint32_t device_index;
   // The index we will give to the next ionode. Each ionode
@@ -529,11 +531,18 @@ static int configure_dev(struct cras_iodev* iodev) {
   // Initialize device settings.
   init_device_settings(aio);
 
+  /* PCMs of a card share its clock and run on the same audio thread.
+   * Hotword wake ups are handled by a callback of the primary audio
+   * thread, keep the device there. */
+  iodev->clock_domain = aio->card_index + 1;
+
   aio->poll_fd = -1;
   if (iodev->active_node->type == CRAS_NODE_TYPE_HOTWORD) {
     struct pollfd* ufds;
     int count, i;
 
+    iodev->clock_domain = CRAS_IODEV_CLOCK_DOMAIN_PRIMARY;
+
     count = snd_pcm_poll_descriptors_count(aio->handle);
     if (count <= 0) {
       syslog(LOG_WARNING, "Invalid poll descriptors count\n");
@@ -2273,6 +2282,7 @@ struct cras_iodev* alsa_iodev_create(size_t card_index,
   iodev = &aio->base;
   iodev->direction = direction;
 
+  aio->card_index = card_index;
   aio->device_index = device_index;
   aio->card_type = card_type;
   aio->is_first = is_first;
@@ -2334,6 +2344,8 @@ struct cras_iodev* alsa_iodev_create(size_t card_index,
   iodev->get_rtc_proc_enabled = get_rtc_proc_enabled;
   if (card_type == ALSA_CARD_TYPE_USB) {
     iodev->min_buffer_level = USB_EXTRA_BUFFER_FRAMES;
+    // USB DACs commonly run at 24 or 32 bits, don't truncate streams to S16.
+    iodev->high_res_conversion = 1;
   }
 
   iodev->ramp = cras_ramp_create();
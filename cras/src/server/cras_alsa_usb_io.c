@@ -1783,6 +1783,9 @@ struct cras_iodev* cras_alsa_usb_iodev_create(
   iodev = &aio->base;
   iodev->direction = direction;
 
+  // PCMs of a card share its clock and run on the same audio thread.
+  iodev->clock_domain = card_index + 1;
+
   aio->device_index = device_index;
   aio->card_type = card_type;
   aio->is_first = is_first;
@@ -1838,6 +1841,8 @@ struct cras_iodev* cras_alsa_usb_iodev_create(
   iodev->set_display_rotation_for_node =
       cras_iodev_dsp_set_display_rotation_for_node;
   iodev->min_buffer_level = USB_EXTRA_BUFFER_FRAMES;
+  // USB DACs commonly run at 24 or 32 bits, don't truncate streams to S16.
+  iodev->high_res_conversion = 1;
 
   iodev->ramp = cras_ramp_create();
   if (iodev->ramp == NULL) {
@@ -154,7 +154,8 @@ static struct echo_ref_request* find_echo_ref_request_for_dev(
 static void start_reverse_process_on_dev(struct cras_iodev* dev,
                                          struct cras_apm_reverse_module* rmod) {
   /* Below call is safe even if |dev| is running in audio thread, because
-   * accessing iodev's dsp pipeline is protected by mutex.
+   * the ext module is published to the dsp pipeline atomically and
+   * removing it waits for the audio thread to stop using it.
    */
   cras_iodev_set_ext_dsp_module(dev, &rmod->ext);
 }
@@ -398,6 +398,27 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
     case CRAS_SERVER_DUMP_DSP_INFO:
       cras_dsp_dump_info();
       break;
+    case CRAS_SERVER_DUMP_DSP_PROFILE: {
+      struct cras_client_audio_debug_info_ready msg;
+      struct cras_server_state* state;
+
+      state = cras_system_state_get_no_lock();
+      cras_dsp_fill_debug_info(&state->dsp_debug_info);
+
+      cras_fill_client_audio_debug_info_ready(&msg);
+      client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+      break;
+    }
+    case CRAS_SERVER_SET_DSP_CONTROL: {
+      struct cras_set_dsp_control* m = (struct cras_set_dsp_control*)msg;
+
+      if (!MSG_LEN_VALID(msg, struct cras_set_dsp_control)) {
+        return -EINVAL;
+      }
+      m->title[CRAS_DSP_DEBUG_NAME_SIZE - 1] = '\0';
+      cras_dsp_set_control_all(m->title, m->port, m->value);
+      break;
+    }
     case CRAS_SERVER_DUMP_AUDIO_THREAD:
       dump_audio_thread_info(client);
       break;
@@ -426,11 +447,14 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
              sizeof(struct cras_bt_event_log));
       memcpy(&state->bt_debug_info.wbs_logger, cras_hfp_ag_get_wbs_logger(),
              sizeof(struct packet_status_logger));
+      memcpy(&state->sco_io_stats, cras_hfp_ag_get_sco_io_stats(),
+             sizeof(struct cras_sco_io_stats));
 #else
       memset(&state->bt_debug_info.bt_log, 0,
              sizeof(struct cras_bt_debug_info));
       memset(&state->bt_debug_info.wbs_logger, 0,
              sizeof(struct packet_status_logger));
+      memset(&state->sco_io_stats, 0, sizeof(struct cras_sco_io_stats));
 #endif
       state->bt_debug_info.floss_enabled = cras_floss_get_enabled();
 
@@ -3,14 +3,19 @@
  * found in the LICENSE file.
  */
 
-#include <pthread.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
 #include <syslog.h>
 
 #include "cras/src/common/dumper.h"
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/server/cras_dsp_ini.h"
 #include "cras/src/server/cras_dsp_pipeline.h"
+#include "cras/src/server/cras_dsp_thread_pool.h"
 #include "cras/src/server/cras_expr.h"
+#include "cras/src/server/cras_main_message.h"
 #include "cras_iodev_info.h"
 #include "third_party/utlist/utlist.h"
 
@@ -22,13 +27,77 @@
  * (1) The client asks to (re-)load it with cras_load_pipeline().
  * (2) The client asks to reload the ini with cras_reload_ini().
  *
- * The pipeline is (re-)loaded asynchronously in an internal thread,
- * so the client needs to use cras_dsp_get_pipeline() and
- * cras_dsp_put_pipeline() to safely access the pipeline.
+ * The pipeline is built and instantiated on the main thread and then
+ * published to the audio thread in a dsp_snapshot with a single atomic
+ * store, so the audio thread never waits for a reload. Readers announce
+ * themselves in |readers| for the duration of cras_dsp_get_pipeline() to
+ * cras_dsp_put_pipeline() or cras_dsp_apply(). A replaced snapshot is put
+ * on the |retired| list and freed by the main thread once it observes no
+ * reader, since any reader arriving later can only load the newer one.
+ *
+ * When the new pipeline has the same channel counts as the old one, the
+ * old one stays in the snapshot as |fading| and the audio thread
+ * crossfades from it for CROSSFADE_MS. The audio thread then tells the
+ * main thread, which publishes the pipeline alone and retires the old one.
+ *
+ * A new value of a control port the running pipeline can follow is put on
+ * the |controls| queue of the context, and the audio thread sets it before
+ * the next block. Other control changes reload the pipeline. The values
+ * are also kept in |overrides| and set on each pipeline loaded later.
  */
-struct cras_dsp_context {
-  pthread_mutex_t mutex;
+#define CROSSFADE_MS 10
+#define CONTROL_QUEUE_SIZE 64
+
+struct dsp_control_update {
+  // The pipeline the control handle is for.
+  uint64_t pipeline_id;
+  int control;
+  float value;
+};
+
+struct dsp_control_override {
+  char* title;
+  int port;
+  float value;
+  struct dsp_control_override *prev, *next;
+};
+
+struct dsp_snapshot {
+  // The pipeline to run.
   struct pipeline* pipeline;
+  // The replaced pipeline, faded out over the first |fade_frames| frames.
+  struct pipeline* fading;
+  unsigned int fade_frames;
+  // Identifies the snapshot to the audio thread across reuse of memory.
+  uint64_t seq;
+  // Identifies |pipeline| to the audio thread in the same way.
+  uint64_t pipeline_id;
+  // Main thread only. Set if freeing this snapshot frees |pipeline|.
+  int owns_pipeline;
+  struct dsp_snapshot* next;
+};
+
+struct cras_dsp_context {
+  // The published snapshot, NULL if there is no pipeline.
+  struct dsp_snapshot* snapshot;
+  // The number of threads currently using the published snapshot.
+  int readers;
+  // Main thread only. Replaced snapshots waiting for readers to leave.
+  struct dsp_snapshot* retired;
+  uint64_t seq;
+  uint64_t pipeline_ids;
+
+  /* Control updates to the audio thread. The main thread only writes
+   * |controls_tail| and the audio thread only writes |controls_head|. */
+  struct dsp_control_update controls[CONTROL_QUEUE_SIZE];
+  unsigned int controls_head;
+  unsigned int controls_tail;
+  // Main thread only. Control values set on each pipeline loaded.
+  struct dsp_control_override* overrides;
+
+  // Audio thread only. The crossfade progress of snapshot |applied_seq|.
+  uint64_t applied_seq;
+  unsigned int fade_pos;
 
   struct cras_expr_env env;
   int sample_rate;
@@ -36,10 +105,25 @@ struct cras_dsp_context {
   struct cras_dsp_context *prev, *next;
 };
 
+// Sent to the main thread when a crossfade is done.
+struct dsp_fade_done_msg {
+  struct cras_main_message header;
+  struct cras_dsp_context* ctx;
+  uint64_t seq;
+};
+
+// A global ini replaced while pipelines created from it may still run.
+struct retired_ini {
+  struct ini* ini;
+  struct retired_ini *prev, *next;
+};
+
 static struct dumper* syslog_dumper;
 static const char* ini_filename;
 static struct ini* global_ini;
+static struct retired_ini* retired_inis;
 static struct cras_dsp_context* context_list;
+static struct cras_dsp_thread_pool* helper_pool;
 
 static void initialize_environment(struct cras_expr_env* env) {
   cras_expr_env_install_builtins(env);
@@ -54,6 +138,17 @@ static void initialize_environment(struct cras_expr_env* env) {
   cras_expr_env_set_variable_integer(env, "RR", CRAS_CH_RR);
 }
 
+static int is_retired_ini(const struct ini* ini) {
+  struct retired_ini* r;
+
+  DL_FOREACH (retired_inis, r) {
+    if (r->ini == ini) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static void destroy_pipeline(struct pipeline* pipeline) {
   struct ini* private_ini;
 
@@ -65,14 +160,164 @@ static void destroy_pipeline(struct pipeline* pipeline) {
    * this ini so its life cycle is aligned with the associated dsp
    * pipeline.
    */
-  if (private_ini && (private_ini != global_ini)) {
+  if (private_ini && (private_ini != global_ini) &&
+      !is_retired_ini(private_ini)) {
     cras_dsp_ini_free(private_ini);
   }
 }
 
+static void free_snapshot(struct dsp_snapshot* snap) {
+  if (snap->owns_pipeline) {
+    destroy_pipeline(snap->pipeline);
+  }
+  if (snap->fading) {
+    destroy_pipeline(snap->fading);
+  }
+  free(snap);
+}
+
+static int snapshot_uses_ini(const struct dsp_snapshot* snap,
+                             const struct ini* ini) {
+  return (snap->pipeline && cras_dsp_pipeline_get_ini(snap->pipeline) == ini) ||
+         (snap->fading && cras_dsp_pipeline_get_ini(snap->fading) == ini);
+}
+
+static int ini_in_use(const struct ini* ini) {
+  struct cras_dsp_context* ctx;
+  struct dsp_snapshot* snap;
+
+  DL_FOREACH (context_list, ctx) {
+    if (ctx->snapshot && snapshot_uses_ini(ctx->snapshot, ini)) {
+      return 1;
+    }
+    for (snap = ctx->retired; snap; snap = snap->next) {
+      if (snapshot_uses_ini(snap, ini)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void free_unused_inis() {
+  struct retired_ini* r;
+
+  DL_FOREACH (retired_inis, r) {
+    if (!ini_in_use(r->ini)) {
+      DL_DELETE(retired_inis, r);
+      cras_dsp_ini_free(r->ini);
+      free(r);
+    }
+  }
+}
+
+/* Frees the retired snapshots of |ctx| if no reader can hold them. A reader
+ * that enters after the load below reads the current snapshot. */
+static void reclaim_retired(struct cras_dsp_context* ctx) {
+  struct dsp_snapshot* snap;
+
+  if (!ctx->retired || __atomic_load_n(&ctx->readers, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+  while ((snap = ctx->retired)) {
+    ctx->retired = snap->next;
+    free_snapshot(snap);
+  }
+  free_unused_inis();
+}
+
+static int can_crossfade(struct pipeline* from, struct pipeline* to) {
+  return cras_dsp_pipeline_get_num_input_channels(from) ==
+             cras_dsp_pipeline_get_num_input_channels(to) &&
+         cras_dsp_pipeline_get_num_output_channels(from) ==
+             cras_dsp_pipeline_get_num_output_channels(to);
+}
+
+/* Makes |pipeline| the one used by readers of |ctx|. The current pipeline
+ * is faded out if |crossfade| is set and the two are compatible. */
+static void publish_pipeline(struct cras_dsp_context* ctx,
+                             struct pipeline* pipeline,
+                             int crossfade) {
+  struct dsp_snapshot* old = ctx->snapshot;
+  struct dsp_snapshot* snap = NULL;
+
+  if (pipeline) {
+    snap = calloc(1, sizeof(*snap));
+    if (!snap) {
+      // Keep the current snapshot, the pipeline is owned by it when shared.
+      syslog(LOG_ERR, "Failed to publish dsp pipeline: %d", -ENOMEM);
+      if (!old || old->pipeline != pipeline) {
+        destroy_pipeline(pipeline);
+      }
+      return;
+    }
+    snap->pipeline = pipeline;
+    snap->owns_pipeline = 1;
+    snap->seq = ++ctx->seq;
+    snap->pipeline_id = ++ctx->pipeline_ids;
+    if (old && old->pipeline == pipeline) {
+      snap->pipeline_id = old->pipeline_id;
+      old->owns_pipeline = 0;
+    } else if (crossfade && old && can_crossfade(old->pipeline, pipeline)) {
+      snap->fading = old->pipeline;
+      snap->fade_frames = ctx->sample_rate * CROSSFADE_MS / 1000;
+      old->owns_pipeline = 0;
+    }
+  }
+
+  __atomic_store_n(&ctx->snapshot, snap, __ATOMIC_SEQ_CST);
+
+  if (old) {
+    old->next = ctx->retired;
+    ctx->retired = old;
+  }
+  reclaim_retired(ctx);
+}
+
+static struct dsp_snapshot* reader_enter(struct cras_dsp_context* ctx) {
+  __atomic_add_fetch(&ctx->readers, 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&ctx->snapshot, __ATOMIC_SEQ_CST);
+}
+
+static void reader_exit(struct cras_dsp_context* ctx) {
+  __atomic_sub_fetch(&ctx->readers, 1, __ATOMIC_RELEASE);
+}
+
+// Called from audio thread.
+static void send_fade_done(struct cras_dsp_context* ctx, uint64_t seq) {
+  struct dsp_fade_done_msg msg = CRAS_MAIN_MESSAGE_INIT;
+
+  msg.header.type = CRAS_MAIN_DSP;
+  msg.header.length = sizeof(msg);
+  msg.ctx = ctx;
+  msg.seq = seq;
+  if (cras_main_message_send((struct cras_main_message*)&msg) < 0) {
+    syslog(LOG_ERR, "Failed to send dsp fade done message");
+  }
+}
+
+static void handle_fade_done(struct cras_main_message* msg, void* arg) {
+  struct dsp_fade_done_msg* fade_msg = (struct dsp_fade_done_msg*)msg;
+  struct cras_dsp_context* ctx;
+
+  DL_FOREACH (context_list, ctx) {
+    if (ctx != fade_msg->ctx) {
+      continue;
+    }
+    if (ctx->snapshot && ctx->snapshot->seq == fade_msg->seq &&
+        ctx->snapshot->fading) {
+      publish_pipeline(ctx, ctx->snapshot->pipeline, 0);
+    } else {
+      reclaim_retired(ctx);
+    }
+    return;
+  }
+}
+
 static struct pipeline* prepare_pipeline(struct cras_dsp_context* ctx,
                                          struct ini* target_ini) {
   struct pipeline* pipeline;
+  struct dsp_control_override* override;
   const char* purpose = ctx->purpose;
   int ret;
 
@@ -85,12 +330,21 @@ static struct pipeline* prepare_pipeline(struct cras_dsp_context* ctx,
     goto bail;
   }
 
+  if (helper_pool) {
+    cras_dsp_pipeline_set_thread_pool(pipeline, helper_pool);
+  }
   ret = cras_dsp_pipeline_load(pipeline);
   if (ret < 0) {
     syslog(LOG_ERR, "cannot load pipeline: %d", ret);
     goto bail;
   }
 
+  // Controls of plugins not in this pipeline are left for later ones.
+  DL_FOREACH (ctx->overrides, override) {
+    cras_dsp_pipeline_set_control_value(pipeline, override->title,
+                                        override->port, override->value);
+  }
+
   ret = cras_dsp_pipeline_instantiate(pipeline, ctx->sample_rate, &ctx->env);
   if (ret < 0) {
     syslog(LOG_ERR, "cannot instantiate pipeline: %d", ret);
@@ -114,24 +368,81 @@ bail:
 
 static void cmd_load_pipeline(struct cras_dsp_context* ctx,
                               struct ini* target_ini) {
-  struct pipeline *pipeline, *old_pipeline;
+  struct pipeline* pipeline;
 
   pipeline = target_ini ? prepare_pipeline(ctx, target_ini) : NULL;
+  publish_pipeline(ctx, pipeline, 1);
+}
 
-  // This locking is short to avoild blocking audio thread.
-  pthread_mutex_lock(&ctx->mutex);
-  old_pipeline = ctx->pipeline;
-  ctx->pipeline = pipeline;
-  pthread_mutex_unlock(&ctx->mutex);
+// Called from audio thread. Sets the queued control values on |snap|.
+static void apply_control_updates(struct cras_dsp_context* ctx,
+                                  struct dsp_snapshot* snap) {
+  unsigned int head = ctx->controls_head;
+  unsigned int tail = __atomic_load_n(&ctx->controls_tail, __ATOMIC_ACQUIRE);
+  struct dsp_control_update* update;
+
+  for (; head != tail; head++) {
+    update = &ctx->controls[head % CONTROL_QUEUE_SIZE];
+    // Updates for a replaced pipeline are already in its overrides.
+    if (update->pipeline_id == snap->pipeline_id) {
+      cras_dsp_pipeline_set_live_control(snap->pipeline, update->control,
+                                         update->value);
+    }
+  }
+  __atomic_store_n(&ctx->controls_head, head, __ATOMIC_RELEASE);
+}
 
-  if (old_pipeline) {
-    destroy_pipeline(old_pipeline);
+// Queues a control update to the audio thread, returns -EAGAIN if full.
+static int queue_control_update(struct cras_dsp_context* ctx,
+                                uint64_t pipeline_id,
+                                int control,
+                                float value) {
+  unsigned int head = __atomic_load_n(&ctx->controls_head, __ATOMIC_ACQUIRE);
+  unsigned int tail = ctx->controls_tail;
+  struct dsp_control_update* update;
+
+  if (tail - head >= CONTROL_QUEUE_SIZE) {
+    return -EAGAIN;
   }
+  update = &ctx->controls[tail % CONTROL_QUEUE_SIZE];
+  update->pipeline_id = pipeline_id;
+  update->control = control;
+  update->value = value;
+  __atomic_store_n(&ctx->controls_tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static int set_override(struct cras_dsp_context* ctx,
+                        const char* title,
+                        int port,
+                        float value) {
+  struct dsp_control_override* override;
+
+  DL_FOREACH (ctx->overrides, override) {
+    if (override->port == port && strcmp(override->title, title) == 0) {
+      override->value = value;
+      return 0;
+    }
+  }
+  override = calloc(1, sizeof(*override));
+  if (!override) {
+    return -ENOMEM;
+  }
+  override->title = strdup(title);
+  if (!override->title) {
+    free(override);
+    return -ENOMEM;
+  }
+  override->port = port;
+  override->value = value;
+  DL_APPEND(ctx->overrides, override);
+  return 0;
 }
 
 static void cmd_reload_ini() {
   struct ini* old_ini = global_ini;
   struct cras_dsp_context* ctx;
+  struct retired_ini* r;
 
   struct ini* new_ini = cras_dsp_ini_create(ini_filename);
   if (!new_ini) {
@@ -139,15 +450,19 @@ static void cmd_reload_ini() {
     return;
   }
 
-  DL_FOREACH (context_list, ctx) {
-    cmd_load_pipeline(ctx, new_ini);
+  /* Pipelines from the old ini may keep running while they fade out, so
+   * it is freed once none of them is left. */
+  if (old_ini) {
+    r = calloc(1, sizeof(*r));
+    r->ini = old_ini;
+    DL_APPEND(retired_inis, r);
   }
 
   global_ini = new_ini;
-
-  if (old_ini) {
-    cras_dsp_ini_free(old_ini);
+  DL_FOREACH (context_list, ctx) {
+    cmd_load_pipeline(ctx, new_ini);
   }
+  free_unused_inis();
 }
 
 // Exported functions
@@ -156,10 +471,20 @@ void cras_dsp_init(const char* filename) {
   dsp_enable_flush_denormal_to_zero();
   ini_filename = strdup(filename);
   syslog_dumper = syslog_dumper_create(LOG_WARNING);
+  cras_main_message_add_handler(CRAS_MAIN_DSP, handle_fade_done, NULL);
   cmd_reload_ini();
 }
 
+void cras_dsp_start_helper_threads(unsigned int num_threads) {
+  if (!helper_pool) {
+    helper_pool = cras_dsp_thread_pool_create(num_threads);
+  }
+}
+
 void cras_dsp_stop() {
+  struct retired_ini* r;
+
+  cras_main_message_rm_handler(CRAS_MAIN_DSP);
   syslog_dumper_free(syslog_dumper);
   if (ini_filename) {
     free((char*)ini_filename);
@@ -168,13 +493,21 @@ void cras_dsp_stop() {
     cras_dsp_ini_free(global_ini);
     global_ini = NULL;
   }
+  DL_FOREACH (retired_inis, r) {
+    DL_DELETE(retired_inis, r);
+    cras_dsp_ini_free(r->ini);
+    free(r);
+  }
+  if (helper_pool) {
+    cras_dsp_thread_pool_destroy(helper_pool);
+    helper_pool = NULL;
+  }
 }
 
 struct cras_dsp_context* cras_dsp_context_new(int sample_rate,
                                               const char* purpose) {
   struct cras_dsp_context* ctx = calloc(1, sizeof(*ctx));
 
-  pthread_mutex_init(&ctx->mutex, NULL);
   initialize_environment(&ctx->env);
   ctx->sample_rate = sample_rate;
   ctx->purpose = strdup(purpose);
@@ -184,12 +517,25 @@ struct cras_dsp_context* cras_dsp_context_new(int sample_rate,
 }
 
 void cras_dsp_context_free(struct cras_dsp_context* ctx) {
+  struct dsp_snapshot* snap;
+  struct dsp_control_override* override;
+
   DL_DELETE(context_list, ctx);
 
-  pthread_mutex_destroy(&ctx->mutex);
-  if (ctx->pipeline) {
-    destroy_pipeline(ctx->pipeline);
-    ctx->pipeline = NULL;
+  // The audio thread is done with the device and so with the context.
+  if (ctx->snapshot) {
+    free_snapshot(ctx->snapshot);
+    ctx->snapshot = NULL;
+  }
+  while ((snap = ctx->retired)) {
+    ctx->retired = snap->next;
+    free_snapshot(snap);
+  }
+  free_unused_inis();
+  DL_FOREACH (ctx->overrides, override) {
+    DL_DELETE(ctx->overrides, override);
+    free(override->title);
+    free(override);
   }
   cras_expr_env_free(&ctx->env);
   free((char*)ctx->purpose);
@@ -218,6 +564,56 @@ void cras_dsp_load_pipeline(struct cras_dsp_context* ctx) {
   cmd_load_pipeline(ctx, global_ini);
 }
 
+int cras_dsp_set_control(struct cras_dsp_context* ctx,
+                         const char* title,
+                         int port,
+                         float value) {
+  struct dsp_snapshot* snap = ctx->snapshot;
+  struct ini* ini;
+  int control;
+  int rc;
+
+  rc = set_override(ctx, title, port, value);
+  if (rc < 0) {
+    return rc;
+  }
+  if (!snap) {
+    return 0;
+  }
+
+  control = cras_dsp_pipeline_find_live_control(snap->pipeline, title, port);
+  if (control == -ENOENT) {
+    return control;
+  }
+  if (control >= 0 &&
+      queue_control_update(ctx, snap->pipeline_id, control, value) == 0) {
+    return 0;
+  }
+
+  /* Rebuild the pipeline with the new value. A private ini is gone with
+   * the pipeline once replaced, so only pipelines of the global one can be
+   * reloaded. */
+  ini = cras_dsp_pipeline_get_ini(snap->pipeline);
+  if (ini != global_ini) {
+    return -ENOTSUP;
+  }
+  cmd_load_pipeline(ctx, ini);
+  return 0;
+}
+
+void cras_dsp_set_control_all(const char* title, int port, float value) {
+  struct cras_dsp_context* ctx;
+  int rc;
+
+  DL_FOREACH (context_list, ctx) {
+    rc = cras_dsp_set_control(ctx, title, port, value);
+    if (rc < 0 && rc != -ENOENT) {
+      syslog(LOG_WARNING, "Failed to set dsp control %s:%d: %d", title, port,
+             rc);
+    }
+  }
+}
+
 void cras_dsp_load_mock_pipeline(struct cras_dsp_context* ctx,
                                  unsigned int num_channels) {
   struct ini* mock_ini;
@@ -230,16 +626,67 @@ void cras_dsp_load_mock_pipeline(struct cras_dsp_context* ctx,
 }
 
 struct pipeline* cras_dsp_get_pipeline(struct cras_dsp_context* ctx) {
-  pthread_mutex_lock(&ctx->mutex);
-  if (!ctx->pipeline) {
-    pthread_mutex_unlock(&ctx->mutex);
+  struct dsp_snapshot* snap = reader_enter(ctx);
+
+  if (!snap) {
+    reader_exit(ctx);
     return NULL;
   }
-  return ctx->pipeline;
+  return snap->pipeline;
 }
 
 void cras_dsp_put_pipeline(struct cras_dsp_context* ctx) {
-  pthread_mutex_unlock(&ctx->mutex);
+  reader_exit(ctx);
+}
+
+void cras_dsp_synchronize(struct cras_dsp_context* ctx) {
+  while (__atomic_load_n(&ctx->readers, __ATOMIC_SEQ_CST)) {
+    sched_yield();
+  }
+  reclaim_retired(ctx);
+}
+
+int cras_dsp_apply(struct cras_dsp_context* ctx,
+                   uint8_t* buf,
+                   snd_pcm_format_t format,
+                   unsigned int frames) {
+  struct dsp_snapshot* snap;
+  struct dsp_fp_mode fp_mode;
+  int rc = 0;
+
+  snap = reader_enter(ctx);
+  if (!snap) {
+    goto out;
+  }
+
+  /* Decaying filter tails turn into denormals as the audio goes quiet,
+   * which are many times slower to compute. The audio thread inherits the
+   * mode set by cras_dsp_init(), but code sharing the thread may change
+   * it. */
+  dsp_fp_mode_flush_denormal(&fp_mode);
+  apply_control_updates(ctx, snap);
+  if (snap->seq != ctx->applied_seq) {
+    ctx->applied_seq = snap->seq;
+    ctx->fade_pos = 0;
+  }
+  if (!snap->fading || ctx->fade_pos >= snap->fade_frames) {
+    rc = cras_dsp_pipeline_apply(snap->pipeline, buf, format, frames);
+    goto restore;
+  }
+
+  rc = cras_dsp_pipeline_apply_crossfade(snap->pipeline, snap->fading, buf,
+                                         format, frames, ctx->fade_pos,
+                                         snap->fade_frames);
+  ctx->fade_pos += frames;
+  if (ctx->fade_pos >= snap->fade_frames) {
+    send_fade_done(ctx, snap->seq);
+  }
+
+restore:
+  dsp_fp_mode_restore(&fp_mode);
+out:
+  reader_exit(ctx);
+  return rc;
 }
 
 void cras_dsp_reload_ini() {
@@ -255,17 +702,38 @@ void cras_dsp_dump_info() {
   }
   DL_FOREACH (context_list, ctx) {
     cras_expr_env_dump(syslog_dumper, &ctx->env);
-    pipeline = ctx->pipeline;
+    pipeline = ctx->snapshot ? ctx->snapshot->pipeline : NULL;
     if (pipeline) {
       cras_dsp_pipeline_dump(syslog_dumper, pipeline);
     }
   }
 }
 
+void cras_dsp_fill_debug_info(struct cras_dsp_debug_info* info) {
+  struct pipeline* pipeline;
+  struct cras_dsp_context* ctx;
+
+  info->num_pipelines = 0;
+  DL_FOREACH (context_list, ctx) {
+    if (info->num_pipelines >= CRAS_DSP_DEBUG_MAX_PIPELINES) {
+      break;
+    }
+    pipeline = ctx->snapshot ? ctx->snapshot->pipeline : NULL;
+    if (pipeline) {
+      cras_dsp_pipeline_fill_debug_info(
+          pipeline, &info->pipelines[info->num_pipelines++]);
+    }
+  }
+}
+
 unsigned int cras_dsp_num_output_channels(const struct cras_dsp_context* ctx) {
-  return cras_dsp_pipeline_get_num_output_channels(ctx->pipeline);
+  struct dsp_snapshot* snap = __atomic_load_n(&ctx->snapshot, __ATOMIC_ACQUIRE);
+
+  return cras_dsp_pipeline_get_num_output_channels(snap->pipeline);
 }
 
 unsigned int cras_dsp_num_input_channels(const struct cras_dsp_context* ctx) {
-  return cras_dsp_pipeline_get_num_input_channels(ctx->pipeline);
+  struct dsp_snapshot* snap = __atomic_load_n(&ctx->snapshot, __ATOMIC_ACQUIRE);
+
+  return cras_dsp_pipeline_get_num_input_channels(snap->pipeline);
 }
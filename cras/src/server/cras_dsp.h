@@ -10,7 +10,10 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #include "cras/src/server/cras_dsp_pipeline.h"
+#include "cras_audio_format.h"
 
 struct cras_dsp_context;
 
@@ -21,13 +24,19 @@ struct cras_dsp_context;
  */
 void cras_dsp_init(const char* filename);
 
+/* Starts |num_threads| helper threads shared by the pipelines loaded from
+ * now on, to run their independent branches in parallel. Does nothing if
+ * |num_threads| is 0. They are stopped by cras_dsp_stop().
+ */
+void cras_dsp_start_helper_threads(unsigned int num_threads);
+
 // Stops the dsp subsystem.
 void cras_dsp_stop();
 
 /* Creates a dsp context. The context holds a pipeline and its
  * parameters.  To use the pipeline in the context, first use
  * cras_dsp_load_pipeline() to load it and then use
- * cras_dsp_get_pipeline() to lock it for access.
+ * cras_dsp_get_pipeline() or cras_dsp_apply() to access it.
  * Args:
  *    sample_rate - The sampling rate of the pipeline.
  *    purpose - The purpose of the pipeline, "playback" or "capture".
@@ -57,18 +66,44 @@ void cras_dsp_set_variable_integer(struct cras_dsp_context* ctx,
 
 /* Loads the pipeline to the context. This should be called again when
  * new values of configuration variables may change the plugin
- * graph. The actual loading happens in another thread to avoid
- * blocking the audio thread. */
+ * graph. The new pipeline is built before it is published to the audio
+ * thread, which crossfades from the previous pipeline if both have the
+ * same channel counts. */
 void cras_dsp_load_pipeline(struct cras_dsp_context* ctx);
 
+/* Sets an input control port of a plugin in the pipelines of the context,
+ * now and after later loads. Ports the running pipeline can follow, such as
+ * the gains and frequencies of the builtin eqs or the thresholds of the
+ * drc, take the new value within a block without a rebuild. The module
+ * glides to it to avoid clicks. Other ports reload the pipeline.
+ * Args:
+ *    ctx - The dsp context.
+ *    title - The title of the plugin in the ini.
+ *    port - The index of the port in the plugin.
+ *    value - The new value.
+ * Returns:
+ *    0 if the value is set. -ENOENT if the current pipeline has no such
+ *    port, it is then only set on later pipelines that have it. -ENOTSUP if
+ *    the pipeline must be rebuilt but isn't loaded from the global ini.
+ */
+int cras_dsp_set_control(struct cras_dsp_context* ctx,
+                         const char* title,
+                         int port,
+                         float value);
+
+// Calls cras_dsp_set_control() on all dsp contexts.
+void cras_dsp_set_control_all(const char* title, int port, float value);
+
 /* Loads a mock pipeline of source directly connects to sink, of given
  * number of channels.
  */
 void cras_dsp_load_mock_pipeline(struct cras_dsp_context* ctx,
                                  unsigned int num_channels);
 
-/* Locks the pipeline in the context for access. Returns NULL if the
- * pipeline is still being loaded or cannot be loaded. */
+/* Pins the pipeline in the context for access without blocking. The
+ * pipeline stays valid but may be replaced by a reload until
+ * cras_dsp_put_pipeline(). Returns NULL if the pipeline is not loaded or
+ * cannot be loaded. */
 struct pipeline* cras_dsp_get_pipeline(struct cras_dsp_context* ctx);
 
 /* Releases the pipeline in the context. This must be called in pair
@@ -77,12 +112,36 @@ struct pipeline* cras_dsp_get_pipeline(struct cras_dsp_context* ctx);
  * cras_dsp_get_pipeline() was called. */
 void cras_dsp_put_pipeline(struct cras_dsp_context* ctx);
 
+/* Waits until no thread is using the pipeline in the context. Called from
+ * the main thread after changing pipeline state the audio thread may be
+ * reading, so that the old state is no longer in use on return. */
+void cras_dsp_synchronize(struct cras_dsp_context* ctx);
+
+/* Runs the pipeline in the context across the given interleaved buffer in
+ * place, crossfading from the previous pipeline after a reload. Does
+ * nothing if no pipeline is loaded.
+ * Args:
+ *    ctx - The dsp context.
+ *    buf - The samples to be processed, interleaved.
+ *    format - Sample format of the buffer.
+ *    frames - The number of frames in the buffer.
+ * Returns:
+ *    Negative code if error, otherwise 0.
+ */
+int cras_dsp_apply(struct cras_dsp_context* ctx,
+                   uint8_t* buf,
+                   snd_pcm_format_t format,
+                   unsigned int frames);
+
 // Re-reads the ini file and reloads all pipelines in the system.
 void cras_dsp_reload_ini();
 
 // Dump current dsp information to syslog.
 void cras_dsp_dump_info();
 
+// Copies the profile of the current pipelines to |info|.
+void cras_dsp_fill_debug_info(struct cras_dsp_debug_info* info);
+
 // Number of channels output.
 unsigned int cras_dsp_num_output_channels(const struct cras_dsp_context* ctx);
 
@@ -30,6 +30,9 @@
   which has the value "playback" or "capture". It defines which
   pipeline these plugins belong to.
 
+- Some built-in plugins read their data from a file given by the
+  attribute "file", like the impulse response of "convolver".
+
 - Each plugin can have an optional "disable expression", which defines
   under which conditions the plugin is disabled.
 
@@ -150,6 +153,7 @@ static int parse_plugin_section(struct ini* ini,
   p->library = getstring(ini, sec_name, "library");
   p->label = getstring(ini, sec_name, "label");
   p->purpose = getstring(ini, sec_name, "purpose");
+  p->file = getstring(ini, sec_name, "file");
   p->disable_expr =
       cras_expr_expression_parse(getstring(ini, sec_name, "disable"));
 
@@ -544,6 +548,9 @@ void cras_dsp_ini_dump(struct dumper* d, struct ini* ini) {
     dumpf(d, "library=%s\n", plugin->library);
     dumpf(d, "label=%s\n", plugin->label);
     dumpf(d, "purpose=%s\n", plugin->purpose);
+    if (plugin->file) {
+      dumpf(d, "file=%s\n", plugin->file);
+    }
     dumpf(d, "disable=%p\n", plugin->disable_expr);
     ARRAY_ELEMENT_FOREACH (&plugin->ports, j, port) {
       dumpf(d, "  [%s port %d] type=%s, flow_id=%d, value=%g\n",
@@ -47,6 +47,7 @@ struct plugin {
   const char* library;                       // file name like "plugin.so"
   const char* label;                         // label like "Eq"
   const char* purpose;                       // like "playback" or "capture"
+  const char* file;                          // data file like "speaker.ir"
   struct cras_expr_expression* disable_expr; /* the disable expression of
                                        this plugin */
   port_array ports;
@@ -3,14 +3,20 @@
  * found in the LICENSE file.
  */
 
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 
+#include "cras/src/dsp/convolver.h"
 #include "cras/src/dsp/dcblock.h"
 #include "cras/src/dsp/drc.h"
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/dsp/eq.h"
 #include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
 #include "cras/src/dsp/quad_rotation.h"
 #include "cras/src/server/cras_dsp_module.h"
 #include "cras_types.h"
@@ -50,6 +56,10 @@ static void empty_dump(struct dsp_module* module, struct dumper* d) {
   dumpf(d, "built-in module\n");
 }
 
+static int empty_is_identity(struct dsp_module* module) {
+  return 1;
+}
+
 static void empty_init_module(struct dsp_module* module) {
   module->instantiate = &empty_instantiate;
   module->connect_port = &empty_connect_port;
@@ -60,6 +70,7 @@ static void empty_init_module(struct dsp_module* module) {
   module->free_module = &empty_free_module;
   module->get_properties = &empty_get_properties;
   module->dump = &empty_dump;
+  module->is_identity = &empty_is_identity;
 }
 
 /*
@@ -536,12 +547,93 @@ static void eq_init_module(struct dsp_module* module) {
   module->dump = &empty_dump;
 }
 
+/* Computes the biquad of one channel of an eq2 or eqN stage from its four
+ * ports: type, freq, Q and gain. Returns 0 if the biquad passes the audio
+ * through unchanged, then it is left out of the filter. */
+static int eq_port_biquad(float* const* ports,
+                          float nyquist,
+                          struct biquad* bq) {
+  biquad_set(bq, (int)*ports[0], *ports[1] / nyquist, *ports[2], *ports[3]);
+  return bq->b0 != 1 || bq->b1 != 0 || bq->b2 != 0 || bq->a1 != 0 ||
+         bq->a2 != 0;
+}
+
+/* The time constant of the glide of a parameter to a new value of its live
+ * control port, in seconds. */
+#define CONTROL_GLIDE_TIME 0.02f
+
+/* Moves |value| toward |target| for a block of |frames|, and onto it once
+ * close. Returns 1 if |value| changed. */
+static int glide(float* value,
+                 float target,
+                 unsigned long frames,
+                 int sample_rate) {
+  float diff = target - *value;
+
+  if (diff == 0) {
+    return 0;
+  }
+  if (fabsf(diff) <= 1e-3f * fmaxf(1, fabsf(target))) {
+    *value = target;
+  } else {
+    *value += diff * (1 - expf(-(float)frames /
+                               (CONTROL_GLIDE_TIME * sample_rate)));
+  }
+  return 1;
+}
+
+/* A biquad of an eq2 or eqN stage that follows new values of its freq, Q
+ * and gain ports while it runs. */
+struct eq_live_biquad {
+  // The index of the biquad in its channel, -1 if it was left out.
+  int index;
+  // The parameters the biquad has now.
+  float freq, Q, gain;
+};
+
+// Records the parameters of a biquad appended at |index|, or -1 if not.
+static void eq_live_init(struct eq_live_biquad* live,
+                         float* const* ports,
+                         int index) {
+  live->index = index;
+  live->freq = *ports[1];
+  live->Q = *ports[2];
+  live->gain = *ports[3];
+}
+
+/* Moves a biquad toward the values of its four ports for a block of
+ * |frames|. Returns 1 and the new coefficients in |bq| if they changed. */
+static int eq_live_step(struct eq_live_biquad* live,
+                        float* const* ports,
+                        int sample_rate,
+                        unsigned long frames,
+                        struct biquad* bq) {
+  int changed = 0;
+
+  if (live->index < 0) {
+    return 0;
+  }
+  changed |= glide(&live->freq, *ports[1], frames, sample_rate);
+  changed |= glide(&live->Q, *ports[2], frames, sample_rate);
+  changed |= glide(&live->gain, *ports[3], frames, sample_rate);
+  if (changed) {
+    biquad_set(bq, (int)*ports[0], live->freq / (sample_rate / 2), live->Q,
+               live->gain);
+  }
+  return changed;
+}
+
 /*
  *  eq2 module functions
  */
 struct eq2_data {
   int sample_rate;
   struct eq2* eq2;  // Initialized in eq2_configure()
+  // The number of biquads appended to eq2, of all channels.
+  int num_biquads;
+  // The biquad of each stage and channel, and whether any still glides.
+  struct eq_live_biquad live[MAX_BIQUADS_PER_EQ2 * 2];
+  int gliding;
 
   // Two ports for input, two for output, and 8 parameters per eq pair
   float* ports[4 + MAX_BIQUADS_PER_EQ2 * 8];
@@ -587,23 +679,51 @@ static void eq2_configure(struct dsp_module* module) {
   }
 
   float nyquist = data->sample_rate / 2;
+  struct biquad bq;
+  int n[2] = {0, 0};
   int i, channel;
 
+  for (i = 0; i < MAX_BIQUADS_PER_EQ2 * 2; i++) {
+    data->live[i].index = -1;
+  }
   for (i = 4; i < 4 + MAX_BIQUADS_PER_EQ2 * 8; i += 8) {
     if (!data->ports[i]) {
       break;
     }
     for (channel = 0; channel < 2; channel++) {
-      int k = i + channel * 4;
-      int type = (int)*data->ports[k];
-      float freq = *data->ports[k + 1];
-      float Q = *data->ports[k + 2];
-      float gain = *data->ports[k + 3];
-      eq2_append_biquad(data->eq2, channel, type, freq / nyquist, Q, gain);
+      float* const* ports = &data->ports[i + channel * 4];
+      int index = -1;
+
+      if (eq_port_biquad(ports, nyquist, &bq) &&
+          eq2_append_biquad_direct(data->eq2, channel, &bq) == 0) {
+        data->num_biquads++;
+        index = n[channel]++;
+      }
+      eq_live_init(&data->live[(i - 4) / 4 + channel], ports, index);
     }
   }
 }
 
+/* The freq, Q and gain of the biquads in the filter are live. A biquad left
+ * out as it was identity needs the pipeline to be rebuilt. */
+static int eq2_is_live_control(struct dsp_module* module, unsigned long port) {
+  struct eq2_data* data = module->data;
+
+  return port >= 4 && port < 4 + MAX_BIQUADS_PER_EQ2 * 8 && port % 4 != 0 &&
+         data->live[(port - 4) / 4].index >= 0;
+}
+
+static void eq2_control_changed(struct dsp_module* module,
+                                unsigned long port) {
+  struct eq2_data* data = module->data;
+  data->gliding = 1;
+}
+
+static int eq2_is_identity(struct dsp_module* module) {
+  struct eq2_data* data = module->data;
+  return data->num_biquads == 0;
+}
+
 static void eq2_run(struct dsp_module* module, unsigned long sample_count) {
   struct eq2_data* data = module->data;
 
@@ -614,6 +734,20 @@ static void eq2_run(struct dsp_module* module, unsigned long sample_count) {
     memcpy(data->ports[3], data->ports[1], sizeof(float) * sample_count);
   }
 
+  if (data->gliding) {
+    struct biquad bq;
+    int i;
+
+    data->gliding = 0;
+    for (i = 0; i < MAX_BIQUADS_PER_EQ2 * 2; i++) {
+      if (eq_live_step(&data->live[i], &data->ports[4 + i * 4],
+                       data->sample_rate, sample_count, &bq)) {
+        eq2_set_biquad(data->eq2, i % 2, data->live[i].index, &bq);
+        data->gliding = 1;
+      }
+    }
+  }
+
   eq2_process(data->eq2, data->ports[2], data->ports[3], (int)sample_count);
 }
 
@@ -635,43 +769,227 @@ static void eq2_init_module(struct dsp_module* module) {
   module->free_module = &empty_free_module;
   module->get_properties = &empty_get_properties;
   module->dump = &empty_dump;
+  module->is_identity = &eq2_is_identity;
+  module->is_live_control = &eq2_is_live_control;
+  module->control_changed = &eq2_control_changed;
 }
 
 /*
- *  drc module functions
+ *  eqN module functions
  */
-struct drc_data {
+struct eqn_data {
   int sample_rate;
-  struct drc* drc;  // Initialized in drc_configure()
-
-  /* Two ports for input, two for output, one for disable_emphasis,
-   * and 8 parameters each band */
-  float* ports[4 + 1 + 8 * 3];
+  struct eqn* eqn;  // Initialized in eqn_instantiate()
+  int num_channels;
+  int num_ports;
+  // The number of biquads appended to eqn, of all channels.
+  int num_biquads;
+  /* The biquad of each stage and channel, stage major, and whether any
+   * still glides. Allocated in eqn_configure(). */
+  struct eq_live_biquad* live;
+  int gliding;
+
+  /* N ports for input, N for output, then 4 parameters for each channel of
+   * each stage. */
+  float* ports[];
 };
 
-static int drc_instantiate(struct dsp_module* module,
+static int eqn_instantiate(struct dsp_module* module,
                            unsigned long sample_rate,
                            struct cras_expr_env* env) {
-  struct drc_data* data;
+  struct eqn_data* data = module->data;
 
-  module->data = calloc(1, sizeof(*data));
-  if (!module->data) {
-    goto fail;
+  data->eqn = eqn_new(data->num_channels);
+  if (!data->eqn) {
+    syslog(LOG_ERR, "eqn_instantiate failed: %d", -ENOMEM);
+    return -ENOMEM;
   }
 
-  data = module->data;
   data->sample_rate = (int)sample_rate;
-  data->drc = drc_new(data->sample_rate);
+  return 0;
+}
+
+static void eqn_connect_port(struct dsp_module* module,
+                             unsigned long port,
+                             float* data_location) {
+  struct eqn_data* data = module->data;
+  data->ports[port] = data_location;
+}
+
+static void eqn_configure(struct dsp_module* module) {
+  struct eqn_data* data = module->data;
+  if (!data->eqn) {
+    syslog(LOG_ERR, "eqN is not instantiated");
+    return;
+  }
+
+  float nyquist = data->sample_rate / 2;
+  int n = data->num_channels;
+  int num_live = (data->num_ports - 2 * n) / 4;
+  struct biquad bq;
+  int i, channel;
+
+  free(data->live);
+  data->live = calloc(num_live, sizeof(*data->live));
+  for (i = 0; data->live && i < num_live; i++) {
+    data->live[i].index = -1;
+  }
+
+  data->num_biquads = 0;
+  for (i = 2 * n; i + 4 * n <= data->num_ports; i += 4 * n) {
+    for (channel = 0; channel < n; channel++) {
+      float* const* ports = &data->ports[i + channel * 4];
+
+      if (eq_port_biquad(ports, nyquist, &bq) &&
+          eqn_append_biquad_direct(data->eqn, channel, &bq) == 0) {
+        data->num_biquads++;
+        if (data->live) {
+          eq_live_init(&data->live[(i - 2 * n) / 4 + channel], ports,
+                       eqn_get_num_biquads(data->eqn, channel) - 1);
+        }
+      }
+    }
+  }
+}
+
+// Like eq2, the freq, Q and gain of the biquads in the filter are live.
+static int eqn_is_live_control(struct dsp_module* module, unsigned long port) {
+  struct eqn_data* data = module->data;
+  unsigned long base = 2 * data->num_channels;
+
+  return data->live && port >= base && port < (unsigned long)data->num_ports &&
+         (port - base) % 4 != 0 && data->live[(port - base) / 4].index >= 0;
+}
+
+static void eqn_control_changed(struct dsp_module* module,
+                                unsigned long port) {
+  struct eqn_data* data = module->data;
+  data->gliding = 1;
+}
+
+static int eqn_is_identity(struct dsp_module* module) {
+  struct eqn_data* data = module->data;
+  return data->num_biquads == 0;
+}
+
+static void eqn_run(struct dsp_module* module, unsigned long sample_count) {
+  struct eqn_data* data = module->data;
+  int n = data->num_channels;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (data->ports[i] != data->ports[n + i]) {
+      memcpy(data->ports[n + i], data->ports[i], sizeof(float) * sample_count);
+    }
+  }
+
+  if (data->gliding) {
+    struct biquad bq;
+
+    data->gliding = 0;
+    for (i = 0; i < (data->num_ports - 2 * n) / 4; i++) {
+      if (eq_live_step(&data->live[i], &data->ports[2 * n + i * 4],
+                       data->sample_rate, sample_count, &bq)) {
+        eqn_set_biquad(data->eqn, i % n, data->live[i].index, &bq);
+        data->gliding = 1;
+      }
+    }
+  }
+
+  eqn_process(data->eqn, &data->ports[n], (int)sample_count);
+}
+
+static void eqn_deinstantiate(struct dsp_module* module) {
+  struct eqn_data* data = module->data;
+  if (data->eqn) {
+    eqn_free(data->eqn);
+    data->eqn = NULL;
+  }
+  free(data->live);
+  data->live = NULL;
+}
+
+static void eqn_free_module(struct dsp_module* module) {
+  free(module->data);
+  free(module);
+}
+
+/* Unlike eq and eq2, the port layout of eqN depends on the number of
+ * channels in the ini, so the data is sized when the plugin is loaded. */
+static int eqn_init_module(struct dsp_module* module,
+                           const struct plugin* plugin) {
+  struct eqn_data* data;
+  const struct port* port;
+  int num_ports = ARRAY_COUNT(&plugin->ports);
+  int n = 0;
+  int i;
+
+  ARRAY_ELEMENT_FOREACH (&plugin->ports, i, port) {
+    if (port->type == PORT_AUDIO && port->direction == PORT_INPUT) {
+      n++;
+    }
+  }
+  if (n == 0 || num_ports < 2 * n || (num_ports - 2 * n) % (4 * n)) {
+    syslog(LOG_ERR, "eqN has %d ports for %d channels", num_ports, n);
+  }
+
+  data = calloc(1, sizeof(*data) + sizeof(float*) * num_ports);
+  if (!data) {
+    syslog(LOG_ERR, "eqn_init_module failed: %d", -ENOMEM);
+    return -ENOMEM;
+  }
+  data->num_channels = n;
+  data->num_ports = num_ports;
+  module->data = data;
+
+  module->instantiate = &eqn_instantiate;
+  module->connect_port = &eqn_connect_port;
+  module->configure = &eqn_configure;
+  module->get_delay = &empty_get_delay;
+  module->run = &eqn_run;
+  module->deinstantiate = &eqn_deinstantiate;
+  module->free_module = &eqn_free_module;
+  module->get_properties = &empty_get_properties;
+  module->dump = &empty_dump;
+  module->is_identity = &eqn_is_identity;
+  module->is_live_control = &eqn_is_live_control;
+  module->control_changed = &eqn_control_changed;
+  return 0;
+}
+
+/*
+ *  drc and drcN module functions
+ */
+struct drc_data {
+  int sample_rate;
+  struct drc* drc;  // Initialized in drc_instantiate()
+  int num_channels;
+  int num_bands;
+  /* The threshold, knee, ratio and post gain each kernel has now, and
+   * whether any still glides to new values of the ports. */
+  float live[DRC_MAX_BANDS][4];
+  int gliding;
+
+  /* N ports for input, N for output, one for disable_emphasis, and 8
+   * parameters each band. drc is the stereo layout with three bands. */
+  float* ports[];
+};
+
+static int drc_instantiate(struct dsp_module* module,
+                           unsigned long sample_rate,
+                           struct cras_expr_env* env) {
+  struct drc_data* data = module->data;
+
+  data->sample_rate = (int)sample_rate;
+  data->drc = drc_new_multichannel(data->sample_rate, data->num_channels,
+                                   data->num_bands);
   if (!data->drc) {
-    goto fail;
+    syslog(LOG_ERR, "drc_instantiate failed for %d channels %d bands",
+           data->num_channels, data->num_bands);
+    return -EINVAL;
   }
 
   return 0;
-fail:
-  free(module->data);
-  module->data = NULL;
-  syslog(LOG_ERR, "drc_instantiate failed: %d", -ENOMEM);
-  return -ENOMEM;
 }
 
 static void drc_connect_port(struct dsp_module* module,
@@ -681,20 +999,15 @@ static void drc_connect_port(struct dsp_module* module,
   data->ports[port] = data_location;
 }
 
-static void drc_configure(struct dsp_module* module) {
-  struct drc_data* data = module->data;
-  if (!data) {
-    syslog(LOG_ERR, "drc is not instantiated");
-    return;
-  }
-
+// Sets the parameters of a new DRC from the control ports.
+static void drc_set_params(struct drc_data* data, struct drc* drc) {
   int i;
+  int n = data->num_channels;
   float nyquist = data->sample_rate / 2;
-  struct drc* drc = data->drc;
 
-  drc->emphasis_disabled = (int)*data->ports[4];
-  for (i = 0; i < 3; i++) {
-    int k = 5 + i * 8;
+  drc->emphasis_disabled = (int)*data->ports[2 * n];
+  for (i = 0; i < data->num_bands; i++) {
+    int k = 2 * n + 1 + i * 8;
     float f = *data->ports[k];
     float enable = *data->ports[k + 1];
     float threshold = *data->ports[k + 2];
@@ -711,8 +1024,129 @@ static void drc_configure(struct dsp_module* module) {
     drc_set_param(drc, i, PARAM_ATTACK, attack);
     drc_set_param(drc, i, PARAM_RELEASE, release);
     drc_set_param(drc, i, PARAM_POST_GAIN, boost);
+    data->live[i][0] = threshold;
+    data->live[i][1] = knee;
+    data->live[i][2] = ratio;
+    data->live[i][3] = boost;
+  }
+  data->gliding = 0;
+}
+
+/* The compressor parameters of each band are live. The crossover, the
+ * enable and the emphasis shape the filters and need a rebuild. */
+static int drc_is_live_control(struct dsp_module* module, unsigned long port) {
+  struct drc_data* data = module->data;
+  unsigned long base = 2 * data->num_channels + 1;
+
+  return data->drc && port >= base &&
+         port < base + (unsigned long)data->num_bands * 8 &&
+         (port - base) % 8 >= 2;
+}
+
+static void drc_control_changed(struct dsp_module* module,
+                                unsigned long port) {
+  struct drc_data* data = module->data;
+  data->gliding = 1;
+}
+
+/* Moves the compressor parameters toward the values of the ports for a
+ * block of |frames|. Attack and release are time constants themselves and
+ * are taken as they are. */
+static void drc_glide(struct drc_data* data, unsigned long frames) {
+  static const unsigned params[4] = {PARAM_THRESHOLD, PARAM_KNEE, PARAM_RATIO,
+                                     PARAM_POST_GAIN};
+  static const int offsets[4] = {2, 3, 4, 7};
+  int i, j;
+
+  data->gliding = 0;
+  for (i = 0; i < data->num_bands; i++) {
+    int k = 2 * data->num_channels + 1 + i * 8;
+    int changed = 0;
+
+    for (j = 0; j < 4; j++) {
+      if (glide(&data->live[i][j], *data->ports[k + offsets[j]], frames,
+                data->sample_rate)) {
+        drc_set_param(data->drc, i, params[j], data->live[i][j]);
+        changed = 1;
+      }
+    }
+    if (changed || data->drc->parameters[i][PARAM_ATTACK] !=
+                       *data->ports[k + 5] ||
+        data->drc->parameters[i][PARAM_RELEASE] != *data->ports[k + 6]) {
+      drc_set_param(data->drc, i, PARAM_ATTACK, *data->ports[k + 5]);
+      drc_set_param(data->drc, i, PARAM_RELEASE, *data->ports[k + 6]);
+      drc_update_kernel(data->drc, i);
+      data->gliding |= changed;
+    }
+  }
+}
+
+static void drc_configure(struct dsp_module* module) {
+  struct drc_data* data = module->data;
+  if (!data->drc) {
+    syslog(LOG_ERR, "drc is not instantiated");
+    return;
+  }
+
+  drc_set_params(data, data->drc);
+  drc_init(data->drc);
+}
+
+/* Moves the biquads of an eq2 or eqN in front of the DRC to the input of the
+ * DRC, where they run together with the emphasis filter. The DRC is rebuilt
+ * because input biquads can only be added before drc_init(). */
+static int drc_fuse(struct dsp_module* module, struct dsp_module* prev) {
+  struct drc_data* data = module->data;
+  int n = data->num_channels;
+  float nyquist = data->sample_rate / 2;
+  float* const* ports;
+  int num_ports;
+  struct biquad bq;
+  struct drc* drc;
+  int i, channel;
+
+  if (!data->drc) {
+    return 0;
+  }
+  if (prev->run == &eq2_run && n == 2) {
+    struct eq2_data* eq2 = prev->data;
+
+    ports = eq2->ports;
+    for (num_ports = 4; num_ports < 4 + MAX_BIQUADS_PER_EQ2 * 8;
+         num_ports += 8) {
+      if (!ports[num_ports]) {
+        break;
+      }
+    }
+  } else if (prev->run == &eqn_run &&
+             ((struct eqn_data*)prev->data)->num_channels == n) {
+    struct eqn_data* eqn = prev->data;
+
+    ports = eqn->ports;
+    num_ports = eqn->num_ports;
+  } else {
+    return 0;
+  }
+
+  drc = drc_new_multichannel(data->sample_rate, n, data->num_bands);
+  if (!drc) {
+    return 0;
+  }
+  drc_set_params(data, drc);
+  for (i = 2 * n; i + 4 * n <= num_ports; i += 4 * n) {
+    for (channel = 0; channel < n; channel++) {
+      if (eq_port_biquad(&ports[i + channel * 4], nyquist, &bq) &&
+          drc_append_input_biquad(drc, channel, &bq)) {
+        drc_free(drc);
+        return 0;
+      }
+    }
   }
   drc_init(drc);
+
+  drc_free(data->drc);
+  data->drc = drc;
+  return 1;
 }
 
 static int drc_get_delay(struct dsp_module* module) {
@@ -722,35 +1156,292 @@ static int drc_get_delay(struct dsp_module* module) {
 
 static void drc_run(struct dsp_module* module, unsigned long sample_count) {
   struct drc_data* data = module->data;
+  int n = data->num_channels;
+  int i;
 
-  if (data->ports[0] != data->ports[2]) {
-    memcpy(data->ports[2], data->ports[0], sizeof(float) * sample_count);
-  }
-  if (data->ports[1] != data->ports[3]) {
-    memcpy(data->ports[3], data->ports[1], sizeof(float) * sample_count);
+  for (i = 0; i < n; i++) {
+    if (data->ports[i] != data->ports[n + i]) {
+      memcpy(data->ports[n + i], data->ports[i], sizeof(float) * sample_count);
+    }
   }
 
-  drc_process(data->drc, &data->ports[2], (int)sample_count);
+  if (data->gliding) {
+    drc_glide(data, sample_count);
+  }
+  drc_process(data->drc, &data->ports[n], (int)sample_count);
 }
 
 static void drc_deinstantiate(struct dsp_module* module) {
   struct drc_data* data = module->data;
   if (data->drc) {
     drc_free(data->drc);
+    data->drc = NULL;
   }
-  free(data);
 }
 
-static void drc_init_module(struct dsp_module* module) {
+static void drc_free_module(struct dsp_module* module) {
+  free(module->data);
+  free(module);
+}
+
+/* drcN links the compression of all channels in the ini and takes the number
+ * of bands from the number of ports left after the audio ports. */
+static int drc_init_module(struct dsp_module* module,
+                           const struct plugin* plugin) {
+  struct drc_data* data;
+  const struct port* port;
+  int num_ports = ARRAY_COUNT(&plugin->ports);
+  int n = 0;
+  int i;
+
+  if (strcmp(plugin->label, "drc") == 0) {
+    n = 2;
+  } else {
+    ARRAY_ELEMENT_FOREACH (&plugin->ports, i, port) {
+      if (port->type == PORT_AUDIO && port->direction == PORT_INPUT) {
+        n++;
+      }
+    }
+  }
+  if (n == 0 || num_ports < 2 * n + 1 || (num_ports - 2 * n - 1) % 8) {
+    syslog(LOG_ERR, "%s has %d ports for %d channels", plugin->label,
+           num_ports, n);
+  }
+
+  data = calloc(1, sizeof(*data) + sizeof(float*) * num_ports);
+  if (!data) {
+    syslog(LOG_ERR, "drc_init_module failed: %d", -ENOMEM);
+    return -ENOMEM;
+  }
+  data->num_channels = n;
+  data->num_bands = num_ports > 2 * n ? (num_ports - 2 * n - 1) / 8 : 0;
+  module->data = data;
+
   module->instantiate = &drc_instantiate;
   module->connect_port = &drc_connect_port;
   module->configure = &drc_configure;
   module->get_delay = &drc_get_delay;
   module->run = &drc_run;
   module->deinstantiate = &drc_deinstantiate;
-  module->free_module = &empty_free_module;
+  module->free_module = &drc_free_module;
+  module->get_properties = &empty_get_properties;
+  module->dump = &empty_dump;
+  module->fuse = &drc_fuse;
+  module->is_live_control = &drc_is_live_control;
+  module->control_changed = &drc_control_changed;
+  return 0;
+}
+
+/*
+ *  convolver module functions
+ */
+
+// The longest impulse response loaded, about 20 seconds at 48kHz.
+#define CONVOLVER_MAX_IR_FRAMES (1 << 20)
+
+struct conv_data {
+  int num_channels;
+  // The "file" of the plugin, raw float samples interleaved by channel.
+  char* filename;
+  // The impulse response of each channel, ir_len samples one after another.
+  float* ir;
+  int ir_len;
+  // One per channel, created in conv_configure().
+  struct convolver** conv;
+
+  /* N ports for input, N for output, and one for the partition size in
+   * frames. */
+  float* ports[];
+};
+
+static int conv_load_ir(struct conv_data* data) {
+  const int n = data->num_channels;
+  float* buf = NULL;
+  FILE* f;
+  long size;
+  int i, j, rc = 0;
+
+  f = fopen(data->filename, "rb");
+  if (!f) {
+    rc = -errno;
+    syslog(LOG_ERR, "convolver failed to open %s: %d", data->filename, rc);
+    return rc;
+  }
+  if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET)) {
+    rc = -errno;
+    goto out;
+  }
+  if (size == 0 || size % (sizeof(float) * n) ||
+      size / (sizeof(float) * n) > CONVOLVER_MAX_IR_FRAMES) {
+    syslog(LOG_ERR, "convolver %s has %ld bytes for %d channels",
+           data->filename, size, n);
+    rc = -EINVAL;
+    goto out;
+  }
+
+  buf = malloc(size);
+  data->ir = malloc(size);
+  if (!buf || !data->ir) {
+    rc = -ENOMEM;
+    goto out;
+  }
+  if (fread(buf, size, 1, f) != 1) {
+    rc = -EIO;
+    goto out;
+  }
+
+  data->ir_len = size / (sizeof(float) * n);
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < data->ir_len; j++) {
+      data->ir[i * data->ir_len + j] = buf[j * n + i];
+    }
+  }
+
+out:
+  if (rc) {
+    syslog(LOG_ERR, "convolver failed to load %s: %d", data->filename, rc);
+    free(data->ir);
+    data->ir = NULL;
+  }
+  free(buf);
+  fclose(f);
+  return rc;
+}
+
+static void conv_free_filters(struct conv_data* data) {
+  int i;
+
+  for (i = 0; i < data->num_channels; i++) {
+    if (data->conv[i]) {
+      convolver_free(data->conv[i]);
+      data->conv[i] = NULL;
+    }
+  }
+}
+
+static int conv_instantiate(struct dsp_module* module,
+                            unsigned long sample_rate,
+                            struct cras_expr_env* env) {
+  struct conv_data* data = module->data;
+
+  if (!data->filename || !data->num_channels) {
+    syslog(LOG_ERR, "convolver needs a file and audio ports");
+    return -EINVAL;
+  }
+  return conv_load_ir(data);
+}
+
+static void conv_connect_port(struct dsp_module* module,
+                              unsigned long port,
+                              float* data_location) {
+  struct conv_data* data = module->data;
+  data->ports[port] = data_location;
+}
+
+static void conv_configure(struct dsp_module* module) {
+  struct conv_data* data = module->data;
+  int block = (int)*data->ports[2 * data->num_channels];
+  int i;
+
+  conv_free_filters(data);
+  for (i = 0; i < data->num_channels; i++) {
+    data->conv[i] = convolver_new(&data->ir[i * data->ir_len], data->ir_len,
+                                  block);
+    if (!data->conv[i]) {
+      syslog(LOG_ERR, "convolver failed for partition size %d", block);
+      conv_free_filters(data);
+      return;
+    }
+  }
+}
+
+static int conv_get_delay(struct dsp_module* module) {
+  struct conv_data* data = module->data;
+  return data->conv[0] ? convolver_get_delay(data->conv[0]) : 0;
+}
+
+static void conv_run(struct dsp_module* module, unsigned long sample_count) {
+  struct conv_data* data = module->data;
+  int n = data->num_channels;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (data->ports[i] != data->ports[n + i]) {
+      memcpy(data->ports[n + i], data->ports[i], sizeof(float) * sample_count);
+    }
+    if (data->conv[i]) {
+      convolver_process(data->conv[i], data->ports[n + i], (int)sample_count);
+    }
+  }
+}
+
+static void conv_deinstantiate(struct dsp_module* module) {
+  struct conv_data* data = module->data;
+
+  conv_free_filters(data);
+  free(data->ir);
+  data->ir = NULL;
+}
+
+static void conv_free_module(struct dsp_module* module) {
+  struct conv_data* data = module->data;
+
+  free(data->conv);
+  free(data->filename);
+  free(data);
+  free(module);
+}
+
+/* The convolver filters each channel with its own impulse response, read
+ * from the "file" of the plugin when instantiated. */
+static int conv_init_module(struct dsp_module* module,
+                            const struct plugin* plugin) {
+  struct conv_data* data;
+  const struct port* port;
+  int num_ports = ARRAY_COUNT(&plugin->ports);
+  int n = 0;
+  int i;
+
+  ARRAY_ELEMENT_FOREACH (&plugin->ports, i, port) {
+    if (port->type == PORT_AUDIO && port->direction == PORT_INPUT) {
+      n++;
+    }
+  }
+  if (num_ports != 2 * n + 1) {
+    syslog(LOG_ERR, "convolver has %d ports for %d channels", num_ports, n);
+    n = 0;
+  }
+
+  data = calloc(1, sizeof(*data) + sizeof(float*) * num_ports);
+  if (!data) {
+    syslog(LOG_ERR, "conv_init_module failed: %d", -ENOMEM);
+    return -ENOMEM;
+  }
+  data->num_channels = n;
+  data->conv = calloc(n + 1, sizeof(*data->conv));
+  if (plugin->file) {
+    data->filename = strdup(plugin->file);
+  }
+  if (!data->conv || (plugin->file && !data->filename)) {
+    syslog(LOG_ERR, "conv_init_module failed: %d", -ENOMEM);
+    free(data->conv);
+    free(data->filename);
+    free(data);
+    return -ENOMEM;
+  }
+  module->data = data;
+
+  module->instantiate = &conv_instantiate;
+  module->connect_port = &conv_connect_port;
+  module->configure = &conv_configure;
+  module->get_delay = &conv_get_delay;
+  module->run = &conv_run;
+  module->deinstantiate = &conv_deinstantiate;
+  module->free_module = &conv_free_module;
   module->get_properties = &empty_get_properties;
   module->dump = &empty_dump;
+  return 0;
 }
 
 /*
@@ -790,11 +1481,13 @@ static void sink_connect_port(struct dsp_module* module,
 
 static void sink_run(struct dsp_module* module, unsigned long sample_count) {
   struct sink_data* data = module->data;
+  struct ext_dsp_module* ext_module =
+      __atomic_load_n(&data->ext_module, __ATOMIC_ACQUIRE);
 
-  if (!data->ext_module) {
+  if (!ext_module) {
     return;
   }
-  data->ext_module->run(data->ext_module, sample_count);
+  ext_module->run(ext_module, sample_count);
 }
 
 static void sink_init_module(struct dsp_module* module) {
@@ -813,15 +1506,15 @@ void cras_dsp_module_set_sink_ext_module(struct dsp_module* module,
                                          struct ext_dsp_module* ext_module) {
   struct sink_data* data = module->data;
   int i;
-  data->ext_module = ext_module;
 
-  if (data->ext_module == NULL) {
-    return;
-  }
-
-  for (i = 0; i < MAX_EXT_DSP_PORTS; i++) {
-    ext_module->ports[i] = data->ports[i];
+  /* The audio thread may be running the sink, so the ports are handed over
+   * before the module is published to it. */
+  if (ext_module) {
+    for (i = 0; i < MAX_EXT_DSP_PORTS; i++) {
+      ext_module->ports[i] = data->ports[i];
+    }
   }
+  __atomic_store_n(&data->ext_module, ext_module, __ATOMIC_RELEASE);
 }
 
 /*
@@ -829,6 +1522,8 @@ void cras_dsp_module_set_sink_ext_module(struct dsp_module* module,
  */
 struct dsp_module* cras_dsp_module_load_builtin(struct plugin* plugin) {
   struct dsp_module* module;
+  int rc = 0;
+
   if (strcmp(plugin->library, "builtin") != 0) {
     return NULL;
   }
@@ -845,8 +1540,13 @@ struct dsp_module* cras_dsp_module_load_builtin(struct plugin* plugin) {
     eq_init_module(module);
   } else if (strcmp(plugin->label, "eq2") == 0) {
     eq2_init_module(module);
-  } else if (strcmp(plugin->label, "drc") == 0) {
-    drc_init_module(module);
+  } else if (strcmp(plugin->label, "eqN") == 0) {
+    rc = eqn_init_module(module, plugin);
+  } else if (strcmp(plugin->label, "drc") == 0 ||
+             strcmp(plugin->label, "drcN") == 0) {
+    rc = drc_init_module(module, plugin);
+  } else if (strcmp(plugin->label, "convolver") == 0) {
+    rc = conv_init_module(module, plugin);
   } else if (strcmp(plugin->label, "swap_lr") == 0) {
     swap_lr_init_module(module);
   } else if (strcmp(plugin->label, "quad_rotation") == 0) {
@@ -857,5 +1557,10 @@ struct dsp_module* cras_dsp_module_load_builtin(struct plugin* plugin) {
     empty_init_module(module);
   }
 
+  if (rc) {
+    syslog(LOG_ERR, "failed to init builtin %s: %d", plugin->label, rc);
+    free(module);
+    return NULL;
+  }
   return module;
 }
@@ -110,6 +110,13 @@ static int get_properties(struct dsp_module* module) {
   return properties;
 }
 
+// LADSPA plugins read their control ports on each run().
+static int is_live_control(struct dsp_module* module, unsigned long port) {
+  return 1;
+}
+
+static void control_changed(struct dsp_module* module, unsigned long port) {}
+
 static void dump(struct dsp_module* module, struct dumper* d) {
   struct ladspa_data* data = module->data;
   const LADSPA_Descriptor* descriptor = data->descriptor;
@@ -198,6 +205,8 @@ struct dsp_module* cras_dsp_module_load_ladspa(struct plugin* plugin) {
   module->get_properties = &get_properties;
   module->free_module = &free_module;
   module->dump = &dump;
+  module->is_live_control = &is_live_control;
+  module->control_changed = &control_changed;
   return module;
 bail:
   if (data->dlopen_handle) {
@@ -82,6 +82,37 @@ struct dsp_module {
 
   // Dumps the information about current state of this module
   void (*dump)(struct dsp_module* mod, struct dumper* d);
+
+  /* Optional, may be NULL. Returns 1 if, with the control values given to
+   * configure(), run() does not change the audio data: each output is left
+   * as it is or gets a copy of the input with the same index. The pipeline
+   * doesn't run such a module when its outputs share the input buffers.
+   */
+  int (*is_identity)(struct dsp_module* mod);
+
+  /* Optional, may be NULL. Asks this module to also do the processing of
+   * |prev|, the module right before it. Each audio output of |prev| is
+   * connected to the audio input of this module with the same index and
+   * shares the buffer of the input of |prev| with the same index. Called
+   * after both modules are configured.
+   * Returns:
+   *    1 if this module now does the processing of both, then the pipeline
+   *    stops running |prev|. 0 otherwise.
+   */
+  int (*fuse)(struct dsp_module* mod, struct dsp_module* prev);
+
+  /* Optional, may be NULL. Returns 1 if the module can follow new values
+   * of the input control port |port| while it runs, see control_changed().
+   * Called after the module is configured.
+   */
+  int (*is_live_control)(struct dsp_module* mod, unsigned long port);
+
+  /* Set if is_live_control is set. Tells the module the value of the live
+   * input control port |port| changed. Called between calls to run(), on
+   * the thread that calls it. The module should move to the new value over
+   * the next blocks rather than at once, so the change makes no click.
+   */
+  void (*control_changed)(struct dsp_module* mod, unsigned long port);
 };
 
 /* An external module interface working with existing dsp pipeline.
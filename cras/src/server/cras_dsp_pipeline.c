@@ -6,11 +6,13 @@
 #include "cras/src/server/cras_dsp_pipeline.h"
 
 #include <inttypes.h>
+#include <string.h>
 #include <sys/param.h>
 #include <syslog.h>
 
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/server/cras_dsp_module.h"
+#include "cras/src/server/cras_dsp_thread_pool.h"
 #include "cras_util.h"
 
 /* We have a static representation of the dsp graph in a "struct ini",
@@ -93,6 +95,28 @@ struct instance {
   /* This is the total buffering delay from source to this instance. It is
    * in number of frames. */
   int total_delay;
+
+  /* Set by compile_plan() if the module is not run, either because it
+   * doesn't change the audio data or because the next instance does its
+   * processing. */
+  int skipped;
+  struct instance* fused_into;
+  // Whether this instance does the processing of the previous one.
+  int fused;
+
+  // The branch this instance is in, see find_branches(). -1 for the
+  // source and the sink.
+  int branch;
+
+  /* The profile of run(), see cras_dsp_pipeline_run(). The time is the
+   * thread CPU time in nanoseconds. */
+  int64_t blocks;
+  int64_t samples;
+  int64_t total_time;
+  int64_t max_time;
+  int64_t denormals;
+  int64_t nans;
+  uint32_t histogram[CRAS_DSP_HISTOGRAM_BUCKETS];
 };
 
 DECLARE_ARRAY_TYPE(struct instance, instance_array)
@@ -117,12 +141,31 @@ struct pipeline {
   // The audio data buffers
   float** buffers;
 
+  /* The instances to run for each block, in order. It is compiled from the
+   * instances once they are configured, see compile_plan(). */
+  struct instance** plan;
+  int plan_size;
+
+  /* The number of branches of the graph, see find_branches(). With a
+   * thread pool and more than one branch, the plan is the source, then the
+   * instances of each branch and then the sink. Branch b is plan entries
+   * stage_end[b] to stage_end[b + 1] - 1, and the branches run in parallel.
+   */
+  int num_branches;
+  int* stage_end;
+  struct cras_dsp_thread_pool* thread_pool;
+  // The number of samples the branches are run for.
+  int branch_sample_count;
+
   // The instance where the audio data flow in
   struct instance* source_instance;
 
   // The instance where the audio data flow out
   struct instance* sink_instance;
 
+  // The external module connected to the sink, if any.
+  struct ext_dsp_module* sink_ext_module;
+
   // The number of audio channels for this pipeline
   int input_channels;
   int output_channels;
@@ -485,85 +528,213 @@ static int load_module(struct plugin* plugin, struct instance* instance) {
   return 0;
 }
 
-static void use_buffers(char* busy, audio_port_array* audio_ports) {
-  int i, k = 0;
+/* Tracks which buffers are in use while assigning them. If |owner| is set,
+ * a buffer written or read by an instance of a branch is kept away from the
+ * other branches, as the branches may run at the same time. */
+struct buffer_state {
+  char* busy;
+  int* owner;
+};
+
+// Whether buffer |k| can be taken by an instance of |branch|.
+static int buffer_free(const struct buffer_state* bs, int k, int branch) {
+  return !bs->busy[k] &&
+         (!bs->owner || bs->owner[k] < 0 || bs->owner[k] == branch);
+}
+
+static void take_buffer(struct buffer_state* bs, int k, int branch) {
+  bs->busy[k] = 1;
+  if (bs->owner && branch >= 0) {
+    bs->owner[k] = branch;
+  }
+}
+
+// Assigns the lowest free buffer to each port, returns the highest in use.
+static int use_buffers(struct buffer_state* bs,
+                       audio_port_array* audio_ports,
+                       int branch) {
+  int i, k = 0, high = -1;
   struct audio_port* audio_port;
 
   ARRAY_ELEMENT_FOREACH (audio_ports, i, audio_port) {
-    while (busy[k]) {
+    while (!buffer_free(bs, k, branch)) {
       k++;
     }
     audio_port->buf_index = k;
-    busy[k] = 1;
+    take_buffer(bs, k, branch);
+    high = MAX(high, k);
   }
+  return high;
 }
 
-static void unuse_buffers(char* busy, audio_port_array* audio_ports) {
+static void unuse_buffers(struct buffer_state* bs,
+                          audio_port_array* audio_ports,
+                          int branch) {
   int i;
   struct audio_port* audio_port;
 
   ARRAY_ELEMENT_FOREACH (audio_ports, i, audio_port) {
-    busy[audio_port->buf_index] = 0;
+    bs->busy[audio_port->buf_index] = 0;
+    if (bs->owner && branch >= 0) {
+      bs->owner[audio_port->buf_index] = branch;
+    }
   }
 }
 
-// assign which buffer each audio port on each instance should use
-static int allocate_buffers(struct pipeline* pipeline) {
-  int i;
-  struct instance* instance;
-  int need_buf = 0, peak_buf = 0;
-  char* busy;
-
-  // first figure out how many buffers do we need
-  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
-    int in = ARRAY_COUNT(&instance->input_audio_ports);
-    int out = ARRAY_COUNT(&instance->output_audio_ports);
+/* Gives each output port the buffer of the input port with the same index,
+ * so that the module processes the data in place, and the lowest free
+ * buffer to the other outputs. Returns the highest buffer in use. The
+ * inputs must have been released.
+ *
+ * An in place buffer carries on the data of its input, so the buffers are
+ * still only taken at the lowest free index when new data starts, which
+ * keeps the number of buffers at the peak number of data in flight. */
+static int reuse_buffers(struct buffer_state* bs,
+                         audio_port_array* input_ports,
+                         audio_port_array* output_ports,
+                         int branch) {
+  int i, k, high = -1;
+  int in = ARRAY_COUNT(input_ports);
+  struct audio_port* audio_port;
 
-    if (instance->properties & MODULE_INPLACE_BROKEN) {
-      /* We cannot reuse input buffer as output
-       * buffer, so we need to use extra buffers */
-      need_buf += out;
-      peak_buf = MAX(peak_buf, need_buf);
-      need_buf -= in;
-    } else {
-      need_buf += out - in;
-      peak_buf = MAX(peak_buf, need_buf);
+  ARRAY_ELEMENT_FOREACH (output_ports, i, audio_port) {
+    k = i < in ? ARRAY_ELEMENT(input_ports, i)->buf_index : -1;
+    // Two inputs may read the same buffer, it can only be reused once.
+    if (k < 0 || !buffer_free(bs, k, branch)) {
+      for (k = 0; !buffer_free(bs, k, branch); k++) {
+      }
     }
+    audio_port->buf_index = k;
+    take_buffer(bs, k, branch);
+    high = MAX(high, k);
   }
-  /*
-   * cras_dsp_pipeline_create creates pipeline with source and sink and it
-   * makes sure all ports could be accessed from some sources, which means
-   * that there is at least one source with out > 0 and in == 0.
-   * This will give us peak_buf > 0 in the previous calculation.
-   */
-  if (peak_buf <= 0) {
-    syslog(LOG_ERR, "peak_buf = %d, which must be greater than 0.", peak_buf);
-    return -EINVAL;
+  return high;
+}
+
+static int runs_branches_in_parallel(const struct pipeline* pipeline) {
+  return pipeline->thread_pool && pipeline->num_branches > 1;
+}
+
+static int find_root(int* parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
   }
+  return i;
+}
 
-  // then allocate the buffers
-  pipeline->peak_buf = peak_buf;
-  pipeline->buffers = (float**)calloc(peak_buf, sizeof(float*));
+// Puts instance |i| in the branch of the instance of |plugin|.
+static void join_branch(struct pipeline* pipeline,
+                        int* parent,
+                        int i,
+                        struct plugin* plugin) {
+  struct instance* upstream =
+      find_instance_by_plugin(&pipeline->instances, plugin);
 
-  if (!pipeline->buffers) {
-    syslog(LOG_ERR, "failed to allocate buffers");
+  if (!upstream || upstream == pipeline->source_instance ||
+      upstream == pipeline->sink_instance) {
+    return;
+  }
+  parent[find_root(parent, i)] =
+      find_root(parent, ARRAY_INDEX(&pipeline->instances, upstream));
+}
+
+/* Groups the instances other than the source and the sink into branches:
+ * the sets of instances connected to each other by audio or control ports
+ * without going through the source or the sink. For example the woofer and
+ * the tweeter chains of a speaker. Branches only share what they read from
+ * the source and what the sink reads from them, so they can run in any
+ * order or at the same time. */
+static int find_branches(struct pipeline* pipeline) {
+  int i, j;
+  int n = ARRAY_COUNT(&pipeline->instances);
+  int *parent, *label;
+  struct instance* instance;
+  struct audio_port* audio_port;
+  struct control_port* control_port;
+
+  pipeline->num_branches = 0;
+  if (n <= 0) {
+    return 0;
+  }
+  parent = (int*)calloc(n, sizeof(*parent));
+  label = (int*)calloc(n, sizeof(*label));
+  if (!parent || !label) {
+    free(parent);
+    free(label);
     return -ENOMEM;
   }
+  for (i = 0; i < n; i++) {
+    parent[i] = i;
+    label[i] = -1;
+  }
 
-  for (i = 0; i < peak_buf; i++) {
-    size_t size = DSP_BUFFER_SIZE * sizeof(float);
-    float* buf = calloc(1, size);
-    if (!buf) {
-      syslog(LOG_ERR, "failed to allocate buf");
-      return -ENOMEM;
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    if (instance == pipeline->source_instance ||
+        instance == pipeline->sink_instance) {
+      continue;
+    }
+    ARRAY_ELEMENT_FOREACH (&instance->input_audio_ports, j, audio_port) {
+      join_branch(pipeline, parent, i, audio_port->peer->plugin);
+    }
+    ARRAY_ELEMENT_FOREACH (&instance->input_control_ports, j, control_port) {
+      if (control_port->peer) {
+        join_branch(pipeline, parent, i, control_port->peer->plugin);
+      }
     }
-    pipeline->buffers[i] = buf;
   }
 
-  // Now assign buffer index for each instance's input/output ports
-  busy = calloc(peak_buf, sizeof(*busy));
   ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
-    int j;
+    int root;
+
+    if (instance == pipeline->source_instance ||
+        instance == pipeline->sink_instance) {
+      instance->branch = -1;
+      continue;
+    }
+    root = find_root(parent, i);
+    if (label[root] < 0) {
+      label[root] = pipeline->num_branches++;
+    }
+    instance->branch = label[root];
+  }
+
+  free(parent);
+  free(label);
+  return 0;
+}
+
+// assign which buffer each audio port on each instance should use
+static int allocate_buffers(struct pipeline* pipeline) {
+  int i;
+  struct instance* instance;
+  int max_buf = 0, peak_buf = 0;
+  struct buffer_state bs = {};
+
+  /* Each output port takes at most one new buffer, so this many are
+   * enough for the simulation below. */
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    max_buf += ARRAY_COUNT(&instance->output_audio_ports);
+  }
+  bs.busy = calloc(max_buf + 1, sizeof(*bs.busy));
+  if (runs_branches_in_parallel(pipeline)) {
+    bs.owner = calloc(max_buf + 1, sizeof(*bs.owner));
+    for (i = 0; bs.owner && i <= max_buf; i++) {
+      bs.owner[i] = -1;
+    }
+  }
+  if (!bs.busy || (runs_branches_in_parallel(pipeline) && !bs.owner)) {
+    free(bs.busy);
+    free(bs.owner);
+    return -ENOMEM;
+  }
+
+  /* Assign buffer index for each instance's input/output ports, in the
+   * order the instances run. The buffers are always taken from the lowest
+   * index, so the highest index used plus one is the peak number of
+   * buffers in use at the same time. */
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    int j, high;
     struct audio_port* audio_port;
 
     // Collect input buffers from upstream
@@ -593,19 +764,53 @@ static int allocate_buffers(struct pipeline* pipeline) {
      * same buffer used for input.
      *
      * This means if we don't have the flag, we can free
-     * the input buffers then allocate the output buffers,
-     * but if we have the flag, we have to allocate the
-     * output buffers before freeing the input buffers.
+     * the input buffers then let each output use the buffer
+     * of the input with the same index, but if we have the
+     * flag, we have to allocate the output buffers before
+     * freeing the input buffers.
      */
     if (instance->properties & MODULE_INPLACE_BROKEN) {
-      use_buffers(busy, &instance->output_audio_ports);
-      unuse_buffers(busy, &instance->input_audio_ports);
+      high = use_buffers(&bs, &instance->output_audio_ports, instance->branch);
+      unuse_buffers(&bs, &instance->input_audio_ports, instance->branch);
     } else {
-      unuse_buffers(busy, &instance->input_audio_ports);
-      use_buffers(busy, &instance->output_audio_ports);
+      unuse_buffers(&bs, &instance->input_audio_ports, instance->branch);
+      high = reuse_buffers(&bs, &instance->input_audio_ports,
+                           &instance->output_audio_ports, instance->branch);
+    }
+    peak_buf = MAX(peak_buf, high + 1);
+  }
+  free(bs.busy);
+  free(bs.owner);
+
+  /*
+   * cras_dsp_pipeline_create creates pipeline with source and sink and it
+   * makes sure all ports could be accessed from some sources, which means
+   * that there is at least one source with out > 0 and in == 0.
+   * This will give us peak_buf > 0 in the previous calculation.
+   */
+  if (peak_buf <= 0) {
+    syslog(LOG_ERR, "peak_buf = %d, which must be greater than 0.", peak_buf);
+    return -EINVAL;
+  }
+
+  // then allocate the buffers
+  pipeline->peak_buf = peak_buf;
+  pipeline->buffers = (float**)calloc(peak_buf, sizeof(float*));
+
+  if (!pipeline->buffers) {
+    syslog(LOG_ERR, "failed to allocate buffers");
+    return -ENOMEM;
+  }
+
+  for (i = 0; i < peak_buf; i++) {
+    size_t size = DSP_BUFFER_SIZE * sizeof(float);
+    float* buf = calloc(1, size);
+    if (!buf) {
+      syslog(LOG_ERR, "failed to allocate buf");
+      return -ENOMEM;
     }
+    pipeline->buffers[i] = buf;
   }
-  free(busy);
 
   return 0;
 }
@@ -622,6 +827,10 @@ int cras_dsp_pipeline_load(struct pipeline* pipeline) {
     }
   }
 
+  ret = find_branches(pipeline);
+  if (ret < 0) {
+    return ret;
+  }
   return allocate_buffers(pipeline);
 }
 
@@ -649,6 +858,155 @@ static void calculate_audio_delay(struct pipeline* pipeline) {
   }
 }
 
+// Whether the outputs of an instance share the buffers of its inputs.
+static int runs_in_place(struct instance* instance) {
+  int i;
+  int in = ARRAY_COUNT(&instance->input_audio_ports);
+  struct audio_port* audio_port;
+
+  ARRAY_ELEMENT_FOREACH (&instance->output_audio_ports, i, audio_port) {
+    if (i < in &&
+        ARRAY_ELEMENT(&instance->input_audio_ports, i)->buf_index !=
+            audio_port->buf_index) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Finds the instance right before |instance| whose processing it can take
+ * over: it is run, runs in place, has all of its audio outputs connected in
+ * order to the audio inputs of |instance| and no output control ports
+ * connected to other instances. */
+static struct instance* find_fusable_upstream(struct pipeline* pipeline,
+                                              struct instance* instance) {
+  int i;
+  int n = ARRAY_COUNT(&instance->input_audio_ports);
+  struct instance* upstream;
+  struct audio_port* audio_port;
+  struct control_port* control_port;
+
+  if (n == 0) {
+    return NULL;
+  }
+  upstream = find_instance_by_plugin(
+      &pipeline->instances,
+      ARRAY_ELEMENT(&instance->input_audio_ports, 0)->peer->plugin);
+  if (!upstream || upstream == pipeline->source_instance ||
+      upstream->skipped || upstream->fused_into || upstream->fused ||
+      ARRAY_COUNT(&upstream->input_audio_ports) != n ||
+      ARRAY_COUNT(&upstream->output_audio_ports) != n ||
+      !runs_in_place(upstream)) {
+    return NULL;
+  }
+  ARRAY_ELEMENT_FOREACH (&upstream->output_audio_ports, i, audio_port) {
+    if (audio_port->peer != ARRAY_ELEMENT(&instance->input_audio_ports, i)) {
+      return NULL;
+    }
+  }
+  ARRAY_ELEMENT_FOREACH (&upstream->output_control_ports, i, control_port) {
+    if (control_port->peer) {
+      return NULL;
+    }
+  }
+  return upstream;
+}
+
+/* Orders the plan as the source, the instances of each branch and then the
+ * sink, keeping the order within each, and finds where each branch starts.
+ */
+static int group_plan_by_branch(struct pipeline* pipeline) {
+  int b, i, n = 0;
+  struct instance** plan;
+
+  free(pipeline->stage_end);
+  pipeline->stage_end =
+      (int*)calloc(pipeline->num_branches + 1, sizeof(*pipeline->stage_end));
+  plan = (struct instance**)calloc(pipeline->plan_size, sizeof(*plan));
+  if (!pipeline->stage_end || !plan) {
+    free(plan);
+    return -ENOMEM;
+  }
+
+  // Stage 0 is the source, then one stage per branch and the sink.
+  for (b = -1; b <= pipeline->num_branches; b++) {
+    for (i = 0; i < pipeline->plan_size; i++) {
+      struct instance* instance = pipeline->plan[i];
+      int stage = instance->branch;
+
+      if (instance == pipeline->sink_instance) {
+        stage = pipeline->num_branches;
+      }
+      if (stage == b) {
+        plan[n++] = instance;
+      }
+    }
+    if (b < pipeline->num_branches) {
+      pipeline->stage_end[b + 1] = n;
+    }
+  }
+
+  free(pipeline->plan);
+  pipeline->plan = plan;
+  return 0;
+}
+
+/* Compiles the instances into the flat list of modules run for each block.
+ * Modules which don't change the audio data in place are left out, and a
+ * module may take over the processing of the one in front of it, like a drc
+ * running the biquads of an eq2 with its emphasis filter. The source and
+ * sink are kept unless their modules say otherwise, the sink feeds the
+ * external module. */
+static int compile_plan(struct pipeline* pipeline) {
+  int i;
+  struct instance* instance;
+
+  free(pipeline->plan);
+  pipeline->plan_size = 0;
+  pipeline->plan = calloc(ARRAY_COUNT(&pipeline->instances),
+                          sizeof(*pipeline->plan));
+  if (!pipeline->plan) {
+    return -ENOMEM;
+  }
+
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    struct dsp_module* module = instance->module;
+
+    instance->skipped = instance != pipeline->sink_instance &&
+                        module->is_identity && module->is_identity(module) &&
+                        runs_in_place(instance);
+    instance->fused_into = NULL;
+    instance->fused = 0;
+  }
+
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    struct dsp_module* module = instance->module;
+    struct instance* upstream;
+
+    if (instance->skipped || !module->fuse) {
+      continue;
+    }
+    upstream = find_fusable_upstream(pipeline, instance);
+    if (upstream && module->fuse(module, upstream->module)) {
+      syslog(LOG_DEBUG, "fuse %s into %s", upstream->plugin->title,
+             instance->plugin->title);
+      upstream->fused_into = instance;
+      instance->fused = 1;
+    }
+  }
+
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    if (!instance->skipped && !instance->fused_into) {
+      pipeline->plan[pipeline->plan_size++] = instance;
+    }
+  }
+
+  if (runs_branches_in_parallel(pipeline)) {
+    return group_plan_by_branch(pipeline);
+  }
+  return 0;
+}
+
 int cras_dsp_pipeline_instantiate(struct pipeline* pipeline,
                                   int sample_rate,
                                   struct cras_expr_env* env) {
@@ -725,7 +1083,7 @@ int cras_dsp_pipeline_instantiate(struct pipeline* pipeline,
   }
 
   calculate_audio_delay(pipeline);
-  return 0;
+  return compile_plan(pipeline);
 }
 
 void cras_dsp_pipeline_deinstantiate(struct pipeline* pipeline) {
@@ -739,6 +1097,11 @@ void cras_dsp_pipeline_deinstantiate(struct pipeline* pipeline) {
       instance->instantiated = 0;
     }
   }
+  free(pipeline->plan);
+  pipeline->plan = NULL;
+  pipeline->plan_size = 0;
+  free(pipeline->stage_end);
+  pipeline->stage_end = NULL;
   pipeline->sample_rate = 0;
 }
 
@@ -758,6 +1121,15 @@ int cras_dsp_pipeline_get_num_output_channels(struct pipeline* pipeline) {
   return pipeline->output_channels;
 }
 
+void cras_dsp_pipeline_set_thread_pool(struct pipeline* pipeline,
+                                       struct cras_dsp_thread_pool* pool) {
+  pipeline->thread_pool = pool;
+}
+
+int cras_dsp_pipeline_get_num_branches(struct pipeline* pipeline) {
+  return pipeline->num_branches;
+}
+
 int cras_dsp_pipeline_get_peak_audio_buffers(struct pipeline* pipeline) {
   return pipeline->peak_buf;
 }
@@ -791,22 +1163,191 @@ void cras_dsp_pipeline_set_sink_ext_module(struct pipeline* pipeline,
                                            struct ext_dsp_module* ext_module) {
   cras_dsp_module_set_sink_ext_module(pipeline->sink_instance->module,
                                       ext_module);
+  __atomic_store_n(&pipeline->sink_ext_module, ext_module, __ATOMIC_RELEASE);
+}
+
+/* Finds the input control port |port| of the instance of the plugin titled
+ * |title|, and the instance in |*out|. */
+static struct control_port* find_input_control_port(struct pipeline* pipeline,
+                                                    const char* title,
+                                                    int port,
+                                                    int* out) {
+  int i, j;
+  struct instance* instance;
+  struct control_port* control_port;
+
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    if (strcmp(instance->plugin->title, title) != 0) {
+      continue;
+    }
+    ARRAY_ELEMENT_FOREACH (&instance->input_control_ports, j, control_port) {
+      if (control_port->original_index == port) {
+        *out = i;
+        return control_port;
+      }
+    }
+  }
+  return NULL;
+}
+
+int cras_dsp_pipeline_set_control_value(struct pipeline* pipeline,
+                                        const char* title,
+                                        int port,
+                                        float value) {
+  int i;
+  struct control_port* control_port =
+      find_input_control_port(pipeline, title, port, &i);
+
+  if (!control_port) {
+    return -ENOENT;
+  }
+  if (control_port->peer) {
+    return -EINVAL;
+  }
+  control_port->value = value;
+  return 0;
+}
+
+/* A live control handle is the index of the instance and the index of the
+ * port in its input control ports. */
+#define LIVE_CONTROL_SHIFT 16
+
+int cras_dsp_pipeline_find_live_control(struct pipeline* pipeline,
+                                        const char* title,
+                                        int port) {
+  int i;
+  struct instance* instance;
+  struct dsp_module* module;
+  struct control_port* control_port =
+      find_input_control_port(pipeline, title, port, &i);
+
+  if (!control_port) {
+    return -ENOENT;
+  }
+  instance = ARRAY_ELEMENT(&pipeline->instances, i);
+  module = instance->module;
+  if (control_port->peer || !instance->instantiated || instance->skipped ||
+      instance->fused_into || !module->is_live_control ||
+      !module->is_live_control(module, port)) {
+    return -ENOTSUP;
+  }
+  return (i << LIVE_CONTROL_SHIFT) |
+         ARRAY_INDEX(&instance->input_control_ports, control_port);
+}
+
+void cras_dsp_pipeline_set_live_control(struct pipeline* pipeline,
+                                        int control,
+                                        float value) {
+  struct instance* instance =
+      ARRAY_ELEMENT(&pipeline->instances, control >> LIVE_CONTROL_SHIFT);
+  struct control_port* control_port =
+      ARRAY_ELEMENT(&instance->input_control_ports,
+                    control & ((1 << LIVE_CONTROL_SHIFT) - 1));
+  struct dsp_module* module = instance->module;
+
+  control_port->value = value;
+  module->control_changed(module, control_port->original_index);
 }
 
 struct ini* cras_dsp_pipeline_get_ini(struct pipeline* pipeline) {
   return pipeline->ini;
 }
 
-void cras_dsp_pipeline_run(struct pipeline* pipeline, int sample_count) {
+static int64_t thread_time_ns() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int histogram_bucket(int64_t t) {
+  int bucket;
+
+  if (t < (1 << CRAS_DSP_HISTOGRAM_MIN_SHIFT)) {
+    return 0;
+  }
+  // t is in [2^(n - 1), 2^n) for n bits.
+  bucket = 64 - __builtin_clzll(t) - CRAS_DSP_HISTOGRAM_MIN_SHIFT;
+  return MIN(bucket, CRAS_DSP_HISTOGRAM_BUCKETS - 1);
+}
+
+/* Counts the denormal and NaN samples the instance wrote. Looks at the bits
+ * so it is not affected by the flush-to-zero mode and is vectorized. */
+static void count_abnormal_samples(struct pipeline* pipeline,
+                                   struct instance* instance,
+                                   int sample_count) {
+  int i, j;
+  uint32_t denormals = 0, nans = 0;
+  struct audio_port* audio_port;
+
+  ARRAY_ELEMENT_FOREACH (&instance->output_audio_ports, i, audio_port) {
+    const float* buf = pipeline->buffers[audio_port->buf_index];
+
+    for (j = 0; j < sample_count; j++) {
+      uint32_t bits;
+
+      memcpy(&bits, &buf[j], sizeof(bits));
+      bits &= 0x7fffffff;
+      denormals += bits - 1 < 0x007fffff;
+      nans += bits > 0x7f800000;
+    }
+  }
+  instance->denormals += denormals;
+  instance->nans += nans;
+}
+
+// Runs plan entries |begin| to |end| - 1.
+static void run_instances(struct pipeline* pipeline,
+                          int begin,
+                          int end,
+                          int sample_count) {
   int i;
-  struct instance* instance;
 
-  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+  for (i = begin; i < end; i++) {
+    struct instance* instance = pipeline->plan[i];
     struct dsp_module* module = instance->module;
+    int64_t begin, t;
+
+    begin = thread_time_ns();
     module->run(module, sample_count);
+    t = thread_time_ns() - begin;
+
+    instance->blocks++;
+    instance->samples += sample_count;
+    instance->total_time += t;
+    instance->max_time = MAX(instance->max_time, t);
+    instance->histogram[histogram_bucket(t)]++;
+    count_abnormal_samples(pipeline, instance, sample_count);
   }
 }
 
+static void run_branch(void* arg, unsigned int index) {
+  struct pipeline* pipeline = (struct pipeline*)arg;
+
+  run_instances(pipeline, pipeline->stage_end[index],
+                pipeline->stage_end[index + 1], pipeline->branch_sample_count);
+}
+
+void cras_dsp_pipeline_run(struct pipeline* pipeline, int sample_count) {
+  int b, n = pipeline->num_branches;
+
+  if (!runs_branches_in_parallel(pipeline) || !pipeline->stage_end) {
+    run_instances(pipeline, 0, pipeline->plan_size, sample_count);
+    return;
+  }
+
+  run_instances(pipeline, 0, pipeline->stage_end[0], sample_count);
+  pipeline->branch_sample_count = sample_count;
+  if (cras_dsp_thread_pool_run(pipeline->thread_pool, n, run_branch,
+                               pipeline) < 0) {
+    for (b = 0; b < n; b++) {
+      run_branch(pipeline, b);
+    }
+  }
+  run_instances(pipeline, pipeline->stage_end[n], pipeline->plan_size,
+                sample_count);
+}
+
 void cras_dsp_pipeline_add_statistic(struct pipeline* pipeline,
                                      const struct timespec* time_delta,
                                      int samples) {
@@ -889,6 +1430,93 @@ int cras_dsp_pipeline_apply(struct pipeline* pipeline,
   return 0;
 }
 
+int cras_dsp_pipeline_apply_crossfade(struct pipeline* pipeline,
+                                      struct pipeline* fading,
+                                      uint8_t* buf,
+                                      snd_pcm_format_t format,
+                                      unsigned int frames,
+                                      unsigned int fade_pos,
+                                      unsigned int fade_frames) {
+  size_t remaining;
+  size_t chunk;
+  size_t i, j;
+  struct timespec begin, end, delta;
+  int rc;
+
+  if (!pipeline || frames == 0) {
+    return 0;
+  }
+
+  /* The external module must see the stream exactly once, so there is
+   * nothing to fade against when either sink is connected to one. */
+  if (!fading || fade_pos >= fade_frames ||
+      fading->input_channels != pipeline->input_channels ||
+      fading->output_channels != pipeline->output_channels ||
+      __atomic_load_n(&pipeline->sink_ext_module, __ATOMIC_ACQUIRE) ||
+      __atomic_load_n(&fading->sink_ext_module, __ATOMIC_ACQUIRE)) {
+    return cras_dsp_pipeline_apply(pipeline, buf, format, frames);
+  }
+
+  unsigned int input_channels = pipeline->input_channels;
+  unsigned int output_channels = pipeline->output_channels;
+  float* source[input_channels];
+  float* fading_source[input_channels];
+  float* sink[output_channels];
+  float* fading_sink[output_channels];
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+
+  for (i = 0; i < input_channels; i++) {
+    source[i] = cras_dsp_pipeline_get_source_buffer(pipeline, i);
+    fading_source[i] = cras_dsp_pipeline_get_source_buffer(fading, i);
+  }
+  for (i = 0; i < output_channels; i++) {
+    sink[i] = cras_dsp_pipeline_get_sink_buffer(pipeline, i);
+    fading_sink[i] = cras_dsp_pipeline_get_sink_buffer(fading, i);
+  }
+
+  remaining = frames;
+
+  while (remaining > 0) {
+    chunk = MIN(remaining, (size_t)DSP_BUFFER_SIZE);
+
+    rc = dsp_util_deinterleave(buf, source, input_channels, format, chunk);
+    if (rc) {
+      return rc;
+    }
+    for (i = 0; i < input_channels; i++) {
+      memcpy(fading_source[i], source[i], chunk * sizeof(float));
+    }
+
+    cras_dsp_pipeline_run(fading, chunk);
+    cras_dsp_pipeline_run(pipeline, chunk);
+
+    // Linear ramp from the old output to the new one.
+    for (i = 0; i < output_channels; i++) {
+      for (j = 0; j < chunk && fade_pos + j < fade_frames; j++) {
+        float gain = (float)(fade_pos + j) / fade_frames;
+        float old = fading_sink[i][j];
+
+        sink[i][j] = old + gain * (sink[i][j] - old);
+      }
+    }
+    fade_pos += chunk;
+
+    rc = dsp_util_interleave(sink, buf, output_channels, format, chunk);
+    if (rc) {
+      return rc;
+    }
+
+    buf += chunk * output_channels * PCM_FORMAT_WIDTH(format) / 8;
+    remaining -= chunk;
+  }
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+  subtract_timespecs(&end, &begin, &delta);
+  cras_dsp_pipeline_add_statistic(pipeline, &delta, frames);
+  return 0;
+}
+
 void cras_dsp_pipeline_free(struct pipeline* pipeline) {
   int i;
   struct instance* instance;
@@ -913,6 +1541,8 @@ void cras_dsp_pipeline_free(struct pipeline* pipeline) {
 
   pipeline->ini = NULL;
   ARRAY_FREE(&pipeline->instances);
+  free(pipeline->plan);
+  free(pipeline->stage_end);
 
   for (i = 0; i < pipeline->peak_buf; i++) {
     free(pipeline->buffers[i]);
@@ -921,6 +1551,50 @@ void cras_dsp_pipeline_free(struct pipeline* pipeline) {
   free(pipeline);
 }
 
+static void copy_name(char* dst, const char* src) {
+  if (src) {
+    strncpy(dst, src, CRAS_DSP_DEBUG_NAME_SIZE - 1);
+  }
+  dst[CRAS_DSP_DEBUG_NAME_SIZE - 1] = '\0';
+}
+
+void cras_dsp_pipeline_fill_debug_info(struct pipeline* pipeline,
+                                       struct dsp_pipeline_debug_info* info) {
+  int i;
+  struct instance* instance;
+
+  memset(info, 0, sizeof(*info));
+  copy_name(info->purpose, pipeline->purpose);
+  info->sample_rate = pipeline->sample_rate;
+  info->input_channels = pipeline->input_channels;
+  info->output_channels = pipeline->output_channels;
+  info->blocks = pipeline->total_blocks;
+  info->samples = pipeline->total_samples;
+  info->total_ns = pipeline->total_time;
+  info->max_ns = pipeline->max_time;
+  info->min_ns = pipeline->min_time;
+
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    struct dsp_module_debug_info* mod;
+
+    if (i >= CRAS_DSP_DEBUG_MAX_MODULES) {
+      break;
+    }
+    mod = &info->modules[i];
+    copy_name(mod->title, instance->plugin->title);
+    copy_name(mod->label, instance->plugin->label);
+    mod->run = !instance->skipped && !instance->fused_into;
+    mod->blocks = instance->blocks;
+    mod->samples = instance->samples;
+    mod->total_ns = instance->total_time;
+    mod->max_ns = instance->max_time;
+    mod->denormals = instance->denormals;
+    mod->nans = instance->nans;
+    memcpy(mod->histogram, instance->histogram, sizeof(mod->histogram));
+    info->num_modules++;
+  }
+}
+
 static void dump_audio_ports(struct dumper* d,
                              const char* name,
                              audio_port_array* audio_ports) {
@@ -958,6 +1632,39 @@ static void dump_control_ports(struct dumper* d,
   }
 }
 
+static void dump_instance_profile(struct dumper* d,
+                                  struct pipeline* pipeline,
+                                  struct instance* instance) {
+  int i;
+
+  if (instance->blocks == 0) {
+    return;
+  }
+  dumpf(d, "   blocks=%" PRId64 ", samples=%" PRId64 "\n", instance->blocks,
+        instance->samples);
+  dumpf(d, "   time: avg=%" PRId64 "ns, max=%" PRId64 "ns\n",
+        instance->total_time / instance->blocks, instance->max_time);
+  if (instance->samples) {
+    dumpf(d, "   cpu load: %g%%\n",
+          instance->total_time * 1e-9 / instance->samples *
+              pipeline->sample_rate * 100);
+  }
+  dumpf(d, "   denormals=%" PRId64 ", nans=%" PRId64 "\n", instance->denormals,
+        instance->nans);
+  dumpf(d, "   time histogram:");
+  for (i = 0; i < CRAS_DSP_HISTOGRAM_BUCKETS - 1; i++) {
+    if (instance->histogram[i]) {
+      dumpf(d, " <2^%dns:%u", CRAS_DSP_HISTOGRAM_MIN_SHIFT + i,
+            instance->histogram[i]);
+    }
+  }
+  if (instance->histogram[i]) {
+    dumpf(d, " >=2^%dns:%u", CRAS_DSP_HISTOGRAM_MIN_SHIFT + i - 1,
+          instance->histogram[i]);
+  }
+  dumpf(d, "\n");
+}
+
 void cras_dsp_pipeline_dump(struct dumper* d, struct pipeline* pipeline) {
   int i;
   struct instance* instance;
@@ -988,8 +1695,15 @@ void cras_dsp_pipeline_dump(struct dumper* d, struct pipeline* pipeline) {
   dumpf(d, " instances (%d):\n", ARRAY_COUNT(&pipeline->instances));
   ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
     struct dsp_module* module = instance->module;
-    dumpf(d, "  [%d]%s mod=%p, total delay=%d\n", i, instance->plugin->title,
-          module, instance->total_delay);
+    dumpf(d, "  [%d]%s mod=%p, total delay=%d, branch=%d\n", i,
+          instance->plugin->title, module, instance->total_delay,
+          instance->branch);
+    if (instance->skipped) {
+      dumpf(d, "   skipped, no change to the audio data\n");
+    } else if (instance->fused_into) {
+      dumpf(d, "   fused into %s\n", instance->fused_into->plugin->title);
+    }
+    dump_instance_profile(d, pipeline, instance);
     if (module) {
       module->dump(module, d);
     }
@@ -1000,6 +1714,9 @@ void cras_dsp_pipeline_dump(struct dumper* d, struct pipeline* pipeline) {
     dump_control_ports(d, "output_control_ports",
                        &instance->output_control_ports);
   }
+  dumpf(d, " modules run: %d\n", pipeline->plan_size);
+  dumpf(d, " branches: %d%s\n", pipeline->num_branches,
+        runs_branches_in_parallel(pipeline) ? ", run in parallel" : "");
   dumpf(d, " peak_buf = %d\n", pipeline->peak_buf);
   dumpf(d, "---- pipeline dump end ----\n");
 }
@@ -16,6 +16,7 @@ extern "C" {
 #include "cras/src/server/cras_dsp_ini.h"
 #include "cras/src/server/cras_dsp_module.h"
 #include "cras_audio_format.h"
+#include "cras_types.h"
 
 /* These are the functions to create and use dsp pipelines. A dsp
  * pipeline is a collection of dsp plugins that process audio
@@ -32,6 +33,7 @@ extern "C" {
  */
 #define DSP_BUFFER_SIZE 2048
 
+struct cras_dsp_thread_pool;
 struct pipeline;
 
 /* Creates a pipeline from the given ini file.
@@ -57,6 +59,14 @@ void cras_dsp_pipeline_free(struct pipeline* pipeline);
  */
 int cras_dsp_pipeline_load(struct pipeline* pipeline);
 
+/* Lets the pipeline run its independent branches, such as the chains of
+ * the woofer and the tweeter, on the helper threads of |pool|. Buffers are
+ * then not shared across branches. Must be called before
+ * cras_dsp_pipeline_load(). The pool must outlive the pipeline.
+ */
+void cras_dsp_pipeline_set_thread_pool(struct pipeline* pipeline,
+                                       struct cras_dsp_thread_pool* pool);
+
 /* Instantiates the pipeline given the sampling rate.
  * Args:
  *    sample_rate - The audio sampling rate.
@@ -114,10 +124,54 @@ float* cras_dsp_pipeline_get_sink_buffer(struct pipeline* pipeline, int index);
 void cras_dsp_pipeline_set_sink_ext_module(struct pipeline* pipeline,
                                            struct ext_dsp_module* ext_module);
 
+/* Sets the value of an input control port before the pipeline is
+ * instantiated, in place of the value from the ini.
+ * Args:
+ *    title - The title of the plugin in the ini.
+ *    port - The index of the port in the plugin.
+ *    value - The new value.
+ * Returns:
+ *    0 if successful. -ENOENT if there is no such input control port, or
+ *    -EINVAL if it is connected to the output of another plugin.
+ */
+int cras_dsp_pipeline_set_control_value(struct pipeline* pipeline,
+                                        const char* title,
+                                        int port,
+                                        float value);
+
+/* Finds an input control port of the instantiated pipeline that can take
+ * new values while the pipeline runs, see
+ * cras_dsp_pipeline_set_live_control().
+ * Args:
+ *    title - The title of the plugin in the ini.
+ *    port - The index of the port in the plugin.
+ * Returns:
+ *    A handle of the port, not negative. -ENOENT if there is no such input
+ *    control port, or -ENOTSUP if the pipeline must be rebuilt to take a
+ *    new value: the port is connected to another plugin, the module isn't
+ *    run or doesn't follow the port while it runs.
+ */
+int cras_dsp_pipeline_find_live_control(struct pipeline* pipeline,
+                                        const char* title,
+                                        int port);
+
+/* Sets a new value of a port found by cras_dsp_pipeline_find_live_control().
+ * Must be called from the thread running the pipeline, between calls to
+ * cras_dsp_pipeline_run(). The module glides to the value over the next
+ * blocks.
+ */
+void cras_dsp_pipeline_set_live_control(struct pipeline* pipeline,
+                                        int control,
+                                        float value);
+
 /* Returns the number of internal audio buffers allocated by the
  * pipeline. This is used by the unit test only */
 int cras_dsp_pipeline_get_peak_audio_buffers(struct pipeline* pipeline);
 
+/* Returns the number of independent branches between the source and the
+ * sink. This is used by the unit test only */
+int cras_dsp_pipeline_get_num_branches(struct pipeline* pipeline);
+
 /* Returns the sampling rate passed by cras_dsp_pipeline_instantiate(),
  * or 0 if is has not been called */
 int cras_dsp_pipeline_get_sample_rate(struct pipeline* pipeline);
@@ -126,7 +180,9 @@ int cras_dsp_pipeline_get_sample_rate(struct pipeline* pipeline);
 struct ini* cras_dsp_pipeline_get_ini(struct pipeline* pipeline);
 
 /* Processes a block of audio samples. sample_count should be no more
- * than DSP_BUFFER_SIZE */
+ * than DSP_BUFFER_SIZE. Only runs the modules kept by the plan compiled in
+ * cras_dsp_pipeline_instantiate(), and profiles each of them: the time of
+ * run() and the denormal and NaN samples it writes. */
 void cras_dsp_pipeline_run(struct pipeline* pipeline, int sample_count);
 
 /* Add a statistic of running time for the pipeline.
@@ -154,6 +210,34 @@ int cras_dsp_pipeline_apply(struct pipeline* pipeline,
                             snd_pcm_format_t format,
                             unsigned int frames);
 
+/* Like cras_dsp_pipeline_apply(), but also runs |fading| on the same input
+ * and ramps linearly from its output to the output of |pipeline|. Falls
+ * back to cras_dsp_pipeline_apply() if the channel counts differ or either
+ * sink is connected to an external module.
+ * Args:
+ *    pipeline - The pipeline being faded in.
+ *    fading - The pipeline being faded out, may be NULL.
+ *    buf - The samples to be processed, interleaved.
+ *    format - Sample format of the buffer.
+ *    frames - The number of frames in the buffer.
+ *    fade_pos - The number of frames already crossfaded.
+ *    fade_frames - The length of the whole crossfade in frames.
+ * Returns:
+ *    Negative code if error, otherwise 0.
+ */
+int cras_dsp_pipeline_apply_crossfade(struct pipeline* pipeline,
+                                      struct pipeline* fading,
+                                      uint8_t* buf,
+                                      snd_pcm_format_t format,
+                                      unsigned int frames,
+                                      unsigned int fade_pos,
+                                      unsigned int fade_frames);
+
+/* Copies the profile of the pipeline and of its first
+ * CRAS_DSP_DEBUG_MAX_MODULES modules to |info|. */
+void cras_dsp_pipeline_fill_debug_info(struct pipeline* pipeline,
+                                       struct dsp_pipeline_debug_info* info);
+
 // Dumps the current state of the pipeline. For debugging only
 void cras_dsp_pipeline_dump(struct dumper* d, struct pipeline* pipeline);
 
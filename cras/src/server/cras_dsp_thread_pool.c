@@ -0,0 +1,192 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/cras_dsp_thread_pool.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "cras/src/dsp/dsp_util.h"
+#include "cras_config.h"
+#include "cras_util.h"
+
+struct cras_dsp_thread_pool {
+  pthread_t* threads;
+  unsigned int num_threads;
+  // Set while a thread runs jobs on the pool.
+  int busy;
+  // Bumped for each set of jobs, the helpers sleep on it in between.
+  uint32_t generation;
+  /* The number of helpers done with the current generation. A new set of
+   * jobs is only forked when all of them are, so no helper can still be
+   * looking at the previous one. */
+  uint32_t idle;
+  int stop;
+
+  // The current set of jobs.
+  void (*job)(void* arg, unsigned int index);
+  void* arg;
+  unsigned int num_jobs;
+  // The next job to take.
+  unsigned int next_job;
+  // The number of jobs done, the forking thread sleeps on it.
+  uint32_t jobs_done;
+};
+
+static void futex_wait(uint32_t* addr, uint32_t val) {
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t* addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Takes and runs jobs of the current generation until none is left.
+static void run_jobs(struct cras_dsp_thread_pool* pool) {
+  unsigned int i;
+
+  while ((i = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_ACQ_REL)) <
+         pool->num_jobs) {
+    pool->job(pool->arg, i);
+    if (__atomic_add_fetch(&pool->jobs_done, 1, __ATOMIC_RELEASE) ==
+        pool->num_jobs) {
+      futex_wake(&pool->jobs_done);
+    }
+  }
+}
+
+static void* helper_thread(void* arg) {
+  struct cras_dsp_thread_pool* pool = (struct cras_dsp_thread_pool*)arg;
+  uint32_t seen = 0;
+  uint32_t gen;
+
+  if (cras_set_rt_scheduling(CRAS_SERVER_RT_THREAD_PRIORITY) == 0) {
+    cras_set_thread_priority(CRAS_SERVER_RT_THREAD_PRIORITY);
+  }
+  // The mode is per thread, set it like the audio thread has it.
+  dsp_enable_flush_denormal_to_zero();
+
+  while (1) {
+    while ((gen = __atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE)) ==
+           seen) {
+      futex_wait(&pool->generation, seen);
+    }
+    seen = gen;
+    if (__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    run_jobs(pool);
+    if (__atomic_add_fetch(&pool->idle, 1, __ATOMIC_ACQ_REL) ==
+        pool->num_threads) {
+      futex_wake(&pool->idle);
+    }
+  }
+  return NULL;
+}
+
+struct cras_dsp_thread_pool* cras_dsp_thread_pool_create(
+    unsigned int num_threads) {
+  struct cras_dsp_thread_pool* pool;
+  unsigned int i;
+  int rc;
+
+  if (num_threads == 0) {
+    return NULL;
+  }
+  pool = (struct cras_dsp_thread_pool*)calloc(1, sizeof(*pool));
+  if (!pool) {
+    return NULL;
+  }
+  pool->threads = (pthread_t*)calloc(num_threads, sizeof(*pool->threads));
+  if (!pool->threads) {
+    free(pool);
+    return NULL;
+  }
+
+  for (i = 0; i < num_threads; i++) {
+    rc = pthread_create(&pool->threads[i], NULL, helper_thread, pool);
+    if (rc) {
+      syslog(LOG_ERR, "Failed to start dsp helper thread: %d", rc);
+      break;
+    }
+  }
+  if (i == 0) {
+    free(pool->threads);
+    free(pool);
+    return NULL;
+  }
+  /* Only read by the helpers once the first jobs are forked, which is
+   * after they are all counted. */
+  pool->num_threads = i;
+  pool->idle = i;
+  syslog(LOG_INFO, "Started %u dsp helper threads", i);
+  return pool;
+}
+
+void cras_dsp_thread_pool_destroy(struct cras_dsp_thread_pool* pool) {
+  unsigned int i;
+  uint32_t idle;
+
+  while ((idle = __atomic_load_n(&pool->idle, __ATOMIC_ACQUIRE)) !=
+         pool->num_threads) {
+    futex_wait(&pool->idle, idle);
+  }
+  __atomic_store_n(&pool->stop, 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+  futex_wake(&pool->generation);
+
+  for (i = 0; i < pool->num_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  free(pool->threads);
+  free(pool);
+}
+
+unsigned int cras_dsp_thread_pool_num_threads(
+    const struct cras_dsp_thread_pool* pool) {
+  return pool->num_threads;
+}
+
+int cras_dsp_thread_pool_run(struct cras_dsp_thread_pool* pool,
+                             unsigned int num_jobs,
+                             void (*job)(void* arg, unsigned int index),
+                             void* arg) {
+  uint32_t done;
+
+  if (__atomic_exchange_n(&pool->busy, 1, __ATOMIC_ACQUIRE)) {
+    return -EBUSY;
+  }
+  /* A helper that has not got to the previous jobs yet is likely not
+   * scheduled, don't wait for it. */
+  if (__atomic_load_n(&pool->idle, __ATOMIC_ACQUIRE) != pool->num_threads) {
+    __atomic_store_n(&pool->busy, 0, __ATOMIC_RELEASE);
+    return -EBUSY;
+  }
+
+  pool->job = job;
+  pool->arg = arg;
+  pool->num_jobs = num_jobs;
+  pool->next_job = 0;
+  pool->jobs_done = 0;
+  pool->idle = 0;
+  __atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+  futex_wake(&pool->generation);
+
+  run_jobs(pool);
+  while ((done = __atomic_load_n(&pool->jobs_done, __ATOMIC_ACQUIRE)) <
+         num_jobs) {
+    futex_wait(&pool->jobs_done, done);
+  }
+
+  __atomic_store_n(&pool->busy, 0, __ATOMIC_RELEASE);
+  return 0;
+}
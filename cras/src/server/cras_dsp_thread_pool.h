@@ -0,0 +1,52 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_SERVER_CRAS_DSP_THREAD_POOL_H_
+#define CRAS_SRC_SERVER_CRAS_DSP_THREAD_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A small pool of real time helper threads for the dsp pipelines. The audio
+ * thread forks a set of independent jobs to the helpers, runs some of them
+ * itself and joins them before it goes on, once per block of samples. The
+ * helpers sleep on a futex between blocks, so forking and joining take no
+ * lock the audio thread could wait on.
+ */
+struct cras_dsp_thread_pool;
+
+/* Creates a pool of |num_threads| helper threads, which run at the priority
+ * of the audio thread with denormals flushed to zero.
+ * Returns:
+ *    The pool, or NULL if |num_threads| is 0 or no thread could be started.
+ */
+struct cras_dsp_thread_pool* cras_dsp_thread_pool_create(
+    unsigned int num_threads);
+
+// Stops the helper threads and frees the pool.
+void cras_dsp_thread_pool_destroy(struct cras_dsp_thread_pool* pool);
+
+// Returns the number of helper threads in the pool.
+unsigned int cras_dsp_thread_pool_num_threads(
+    const struct cras_dsp_thread_pool* pool);
+
+/* Runs job(arg, i) for each i in [0, num_jobs) on the helpers and the
+ * calling thread, and returns once all of them are done. The jobs must not
+ * depend on each other.
+ * Returns:
+ *    0 if the jobs are run. -EBUSY if another thread is using the pool, the
+ *    caller should then run the jobs itself.
+ */
+int cras_dsp_thread_pool_run(struct cras_dsp_thread_pool* pool,
+                             unsigned int num_jobs,
+                             void (*job)(void* arg, unsigned int index),
+                             void* arg);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_SERVER_CRAS_DSP_THREAD_POOL_H_
@@ -185,6 +185,11 @@ struct cras_iodev* empty_iodev_create(enum CRAS_STREAM_DIRECTION direction,
   }
   iodev = &empty_iodev->base;
   iodev->direction = direction;
+  /* Fallback devices only stand in for real ones and can run on whichever
+   * audio thread their streams are. */
+  if (node_type != CRAS_NODE_TYPE_HOTWORD) {
+    iodev->clock_domain = CRAS_IODEV_CLOCK_DOMAIN_ANY;
+  }
 
   iodev->supported_rates = empty_supported_rates;
   iodev->supported_channel_counts = empty_supported_channel_counts;
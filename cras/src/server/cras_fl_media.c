@@ -518,6 +518,69 @@ int floss_media_a2dp_stop_audio_request(struct fl_media* fm) {
   return 0;
 }
 
+int floss_media_a2dp_set_pcm_shm(struct fl_media* fm,
+                                 int header_fd,
+                                 int samples_fd) {
+  DBusMessage *set_pcm_shm, *reply;
+  DBusError dbus_error;
+  dbus_bool_t response = FALSE;
+  int rc = 0;
+
+  syslog(LOG_DEBUG, "%s", __func__);
+
+  if (!fm) {
+    syslog(LOG_WARNING, "%s: Floss media not started", __func__);
+    return -EINVAL;
+  }
+
+  rc = create_dbus_method_call(&set_pcm_shm,
+                               /* dest= */ BT_SERVICE_NAME,
+                               /* path= */ fm->obj_path,
+                               /* iface= */ BT_MEDIA_INTERFACE,
+                               /* method_name= */ "SetPcmSharedMemory",
+                               /* num_args= */ 2,
+                               /* arg1= */ DBUS_TYPE_UNIX_FD, &header_fd,
+                               /* arg2= */ DBUS_TYPE_UNIX_FD, &samples_fd);
+
+  if (rc < 0) {
+    return rc;
+  }
+
+  dbus_error_init(&dbus_error);
+
+  /* Not using call_method_and_parse_reply, an older Floss without the
+   * method has to be told apart from a call that failed. */
+  reply = dbus_connection_send_with_reply_and_block(
+      fm->conn, set_pcm_shm, DBUS_TIMEOUT_USE_DEFAULT, &dbus_error);
+  dbus_message_unref(set_pcm_shm);
+  if (!reply) {
+    syslog(LOG_ERR, "Failed to send SetPcmSharedMemory: %s",
+           dbus_error.message);
+    rc = dbus_error_has_name(&dbus_error, DBUS_ERROR_UNKNOWN_METHOD)
+             ? -EOPNOTSUPP
+             : -EIO;
+    dbus_error_free(&dbus_error);
+    return rc;
+  }
+
+  if (!dbus_message_get_args(reply, &dbus_error, DBUS_TYPE_BOOLEAN, &response,
+                             DBUS_TYPE_INVALID)) {
+    syslog(LOG_ERR, "Bad SetPcmSharedMemory reply: %s", dbus_error.message);
+    dbus_error_free(&dbus_error);
+    dbus_message_unref(reply);
+    return -EIO;
+  }
+
+  dbus_message_unref(reply);
+
+  if (response == FALSE) {
+    syslog(LOG_WARNING, "Failed to make request to SetPcmSharedMemory.");
+    return -EBUSY;
+  }
+
+  return 0;
+}
+
 int floss_media_a2dp_suspend(struct fl_media* fm) {
   if (fm != active_fm) {
     syslog(LOG_WARNING, "Invalid fl_media instance to suspend a2dp");
@@ -107,6 +107,19 @@ int floss_media_a2dp_start_audio_request(struct fl_media* fm, const char* addr);
 // Calls StopAudioRequest method to Floss media interface.
 int floss_media_a2dp_stop_audio_request(struct fl_media* fm);
 
+/* Calls SetPcmSharedMemory method to Floss media interface, to have the
+ * next audio session read PCM from a cras_audio_shm ring instead of the
+ * data socket. Floss maps the header and samples areas from the given fds
+ * and advances ring_read_frames as it consumes audio, until
+ * StopAudioRequest.
+ * Returns:
+ *    0 if Floss takes the ring, -EOPNOTSUPP if Floss doesn't have the
+ *    method, otherwise a negative error code.
+ */
+int floss_media_a2dp_set_pcm_shm(struct fl_media* fm,
+                                 int header_fd,
+                                 int samples_fd);
+
 // Unlink a2dp with bt_io_manager and destroy related resources.
 int floss_media_a2dp_suspend(struct fl_media* fm);
 
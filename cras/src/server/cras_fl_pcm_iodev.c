@@ -4,14 +4,17 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/un.h>
 #include <syslog.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "cras/src/common/byte_buffer.h"
 #include "cras/src/common/cras_string.h"
@@ -23,6 +26,7 @@
 #include "cras/src/server/cras_hfp_manager.h"
 #include "cras/src/server/cras_iodev.h"
 #include "cras/src/server/cras_iodev_list.h"
+#include "cras_shm.h"
 #include "cras_types.h"
 #include "cras_util.h"
 #include "third_party/superfasthash/sfh.h"
@@ -71,6 +75,11 @@ struct fl_pcm_io {
   struct cras_iodev base;
   // Buffer to hold pcm samples before encode.
   struct byte_buffer* pcm_buf;
+  // The ring Floss reads A2DP pcm samples from in place of pcm_buf and the
+  // socket, if Floss takes it. NULL when streaming through the socket.
+  struct cras_audio_shm* shm;
+  // The ring_read_frames of shm as of the last flush.
+  uint64_t shm_read_frames;
   // The time when it is okay for next flush call.
   struct timespec next_flush_time;
   // The time period between two a2dp packet writes.
@@ -119,6 +128,9 @@ static int hfp_update_supported_formats(struct cras_iodev* iodev) {
 
 static unsigned int bt_local_queued_frames(const struct cras_iodev* iodev) {
   struct fl_pcm_io* pcmio = (struct fl_pcm_io*)iodev;
+  if (pcmio->shm) {
+    return cras_shm_ring_queued(pcmio->shm);
+  }
   if (iodev->format) {
     return buf_queued(pcmio->pcm_buf) / cras_get_format_bytes(iodev->format);
   }
@@ -273,29 +285,91 @@ static int a2dp_socket_write_cb(void* arg, int revent) {
   return flush(iodev);
 }
 
+/* Creates the ring for Floss to read pcm samples from, of buffer_size
+ * frames rounded up to a power of 2.
+ */
+static int a2dp_pcm_shm_create(struct fl_pcm_io* a2dpio) {
+  struct cras_iodev* iodev = &a2dpio->base;
+  char header_name[NAME_MAX];
+  char samples_name[NAME_MAX];
+  struct cras_shm_info header_info, samples_info;
+  uint32_t frame_bytes = cras_get_format_bytes(iodev->format);
+  uint32_t ring_frames = 1;
+  int rc;
+
+  while (ring_frames < iodev->buffer_size) {
+    ring_frames <<= 1;
+  }
+
+  snprintf(header_name, sizeof(header_name), "/cras-%d-fl-a2dp-%08x-header",
+           getpid(), iodev->info.stable_id);
+  rc = cras_shm_info_init(header_name, cras_shm_header_size(), &header_info);
+  if (rc) {
+    return rc;
+  }
+
+  snprintf(samples_name, sizeof(samples_name), "/cras-%d-fl-a2dp-%08x-samples",
+           getpid(), iodev->info.stable_id);
+  rc = cras_shm_info_init(samples_name, ring_frames * frame_bytes,
+                          &samples_info);
+  if (rc) {
+    cras_shm_info_cleanup(&header_info);
+    return rc;
+  }
+
+  rc = cras_audio_shm_create(&header_info, &samples_info, PROT_WRITE,
+                             &a2dpio->shm);
+  if (rc) {
+    return rc;
+  }
+
+  cras_shm_set_frame_bytes(a2dpio->shm, frame_bytes);
+  cras_shm_set_used_size(a2dpio->shm, iodev->buffer_size * frame_bytes);
+  cras_shm_set_ring_frames(a2dpio->shm, ring_frames);
+  a2dpio->shm_read_frames = 0;
+  return 0;
+}
+
+/* Starts streaming with Floss reading from the ring, or through the socket
+ * if Floss doesn't take it. Once Floss took the ring a failed start isn't
+ * retried through the socket, which would request the session again.
+ */
+static int a2dp_start(struct fl_pcm_io* a2dpio, struct cras_audio_format* fmt) {
+  int rc;
+
+  if (a2dp_pcm_shm_create(a2dpio) == 0) {
+    rc = cras_floss_a2dp_start_shm(a2dpio->a2dp, fmt,
+                                   a2dpio->shm->header_info.fd,
+                                   a2dpio->shm->samples_info.fd);
+    if (rc == 0) {
+      return 0;
+    }
+    cras_audio_shm_destroy(a2dpio->shm);
+    a2dpio->shm = NULL;
+    if (rc != -EOPNOTSUPP) {
+      return rc;
+    }
+  }
+
+  return cras_floss_a2dp_start(a2dpio->a2dp, fmt);
+}
+
 static int a2dp_configure_dev(struct cras_iodev* iodev) {
   struct fl_pcm_io* a2dpio = (struct fl_pcm_io*)iodev;
+  struct cras_audio_format floss_fmt;
   int rc, fd, init_level;
   size_t format_bytes;
   uint8_t* buf;
   unsigned int to_send;
 
-  rc = cras_floss_a2dp_start(a2dpio->a2dp, iodev->format);
-  if (rc < 0) {
-    syslog(LOG_WARNING, "A2dp start failed");
-    return rc;
-  }
-
   // Assert format is set before opening device.
   if (iodev->format == NULL) {
     return -EINVAL;
   }
+  // Floss is given the format before it's set to what is sent.
+  floss_fmt = *iodev->format;
   iodev->format->format = SND_PCM_FORMAT_S16_LE;
   format_bytes = cras_get_format_bytes(iodev->format);
-  cras_iodev_init_audio_area(iodev, iodev->format->num_channels);
-
-  a2dpio->total_written_bytes = 0;
-  a2dpio->bt_stack_delay = 0;
 
   /* Configure write_block to frames equivalent to PCM_BLOCK_MS.
    * And make buffer_size integer multiple of write_block so we
@@ -304,6 +378,32 @@ static int a2dp_configure_dev(struct cras_iodev* iodev) {
   iodev->buffer_size =
       PCM_BUF_MAX_SIZE_FRAMES / a2dpio->write_block * a2dpio->write_block;
 
+  rc = a2dp_start(a2dpio, &floss_fmt);
+  if (rc < 0) {
+    syslog(LOG_WARNING, "A2dp start failed");
+    return rc;
+  }
+
+  cras_iodev_init_audio_area(iodev, iodev->format->num_channels);
+
+  a2dpio->total_written_bytes = 0;
+  a2dpio->bt_stack_delay = 0;
+
+  /* Buffer level less than one preferable write_block to be sent in one
+   * socket write. Configure min_buffer_level to this value so when stream
+   * underruns, audio thread can take action to fill some zeros. */
+  iodev->min_buffer_level = a2dpio->write_block;
+
+  /* Floss reads straight from the ring at its own pace, so there's neither
+   * a local copy nor socket writes to schedule. Queue the one block of
+   * silence the socket path sends below. */
+  if (a2dpio->shm) {
+    cras_iodev_fill_odev_zeros(iodev, a2dpio->write_block, false);
+    cras_floss_a2dp_delay_sync(a2dpio->a2dp, INIT_DELAY_SYNC_MSEC,
+                               DELAY_SYNC_PERIOD_MSEC);
+    return 0;
+  }
+
   a2dpio->pcm_buf = byte_buffer_create(iodev->buffer_size * format_bytes);
   if (!a2dpio->pcm_buf) {
     return -ENOMEM;
@@ -314,11 +414,6 @@ static int a2dp_configure_dev(struct cras_iodev* iodev) {
   cras_frames_to_time(a2dpio->write_block, iodev->format->frame_rate,
                       &a2dpio->flush_period);
 
-  /* Buffer level less than one preferable write_block to be sent in one
-   * socket write. Configure min_buffer_level to this value so when stream
-   * underruns, audio thread can take action to fill some zeros. */
-  iodev->min_buffer_level = a2dpio->write_block;
-
   fd = cras_floss_a2dp_get_fd(a2dpio->a2dp);
   audio_thread_add_events_callback(fd, a2dp_socket_write_cb, iodev,
                                    POLLOUT | POLLERR | POLLHUP);
@@ -528,6 +623,9 @@ static int a2dp_close_dev(struct cras_iodev* iodev) {
 
   cras_floss_a2dp_cancel_suspend(a2dpio->a2dp);
   byte_buffer_destroy(&a2dpio->pcm_buf);
+  // Floss has stopped reading the ring by now.
+  cras_audio_shm_destroy(a2dpio->shm);
+  a2dpio->shm = NULL;
   cras_iodev_free_format(iodev);
   cras_iodev_free_audio_area(iodev);
   return 0;
@@ -556,6 +654,17 @@ static unsigned int a2dp_frames_to_play_in_sleep(struct cras_iodev* iodev,
 
   *hw_level = frames_queued(iodev, hw_tstamp);
 
+  /* Floss drains the ring on its own schedule. Pick up how far it got, and
+   * wake up again when one write_block is left on top of min_buffer_level.
+   */
+  if (a2dpio->shm) {
+    flush(iodev);
+    if (*hw_level > iodev->min_buffer_level + a2dpio->write_block) {
+      return *hw_level - iodev->min_buffer_level - a2dpio->write_block;
+    }
+    return a2dpio->write_block;
+  }
+
   frames_until = cras_frames_until_time(&a2dpio->next_flush_time,
                                         iodev->format->frame_rate);
   if (frames_until > 0) {
@@ -568,6 +677,41 @@ static unsigned int a2dp_frames_to_play_in_sleep(struct cras_iodev* iodev,
   return a2dpio->write_block;
 }
 
+/* Accounts the frames Floss has read from the ring since the last flush,
+ * in place of the socket writes.
+ */
+static int shm_flush(struct fl_pcm_io* a2dpio) {
+  struct cras_iodev* iodev = &a2dpio->base;
+  uint64_t read_frames =
+      cras_shm_ring_load(&a2dpio->shm->header->ring_read_frames);
+  size_t format_bytes = cras_get_format_bytes(iodev->format);
+  unsigned int consumed = 0;
+
+  if (read_frames > a2dpio->shm_read_frames) {
+    consumed = MIN(read_frames - a2dpio->shm_read_frames,
+                   a2dpio->shm->ring_frames);
+    a2dpio->shm_read_frames = read_frames;
+  }
+
+  ATLOG(atlog, AUDIO_THREAD_A2DP_WRITE, consumed,
+        bt_local_queued_frames(iodev) * format_bytes, 0);
+
+  if (consumed) {
+    clock_gettime(CLOCK_MONOTONIC_RAW, &a2dpio->last_write_ts);
+    a2dpio->total_written_bytes += consumed * format_bytes;
+    cras_floss_a2dp_update_write_status(a2dpio->a2dp, true);
+    cras_floss_a2dp_cancel_suspend(a2dpio->a2dp);
+  } else if (cras_shm_get_num_writeable(a2dpio->shm) == 0) {
+    /* Floss stopped reading and the ring is full. As when the socket
+     * write blocks, suspend the a2dp connection if it lasts 5 seconds. */
+    cras_floss_a2dp_update_write_status(a2dpio->a2dp, false);
+    cras_floss_a2dp_schedule_suspend(a2dpio->a2dp, 5000,
+                                     A2DP_EXIT_LONG_TX_FAILURE);
+    cras_audio_thread_event_a2dp_overrun();
+  }
+  return 0;
+}
+
 /* Flush PCM data to the socket.
  * Returns:
  *    0 when the flush succeeded, -1 when error occurred.
@@ -593,6 +737,10 @@ static int flush(const struct cras_iodev* iodev) {
     return 0;
   }
 
+  if (a2dpio->shm) {
+    return shm_flush(a2dpio);
+  }
+
   fd = cras_floss_a2dp_get_fd(a2dpio->a2dp);
 do_flush:
   // If flush gets called before targeted next flush time, do nothing.
@@ -712,7 +860,13 @@ static int get_buffer(struct cras_iodev* iodev,
 
   pcmio = (struct fl_pcm_io*)iodev;
 
-  if (iodev->direction == CRAS_STREAM_OUTPUT && iodev->format) {
+  if (iodev->direction == CRAS_STREAM_OUTPUT && iodev->format && pcmio->shm) {
+    // Hand out the ring up to where it wraps, for the stream to mix into.
+    dst = cras_shm_get_write_buffer_base(pcmio->shm);
+    buf_avail = MIN(cras_shm_get_num_writeable(pcmio->shm),
+                    cras_shm_ring_frames_to_wrap(pcmio->shm)) *
+                cras_get_format_bytes(iodev->format);
+  } else if (iodev->direction == CRAS_STREAM_OUTPUT && iodev->format) {
     dst = buf_write_pointer_size(pcmio->pcm_buf, &buf_avail);
   } else if (iodev->direction == CRAS_STREAM_INPUT && iodev->format) {
     dst = buf_read_pointer_size(pcmio->pcm_buf, &buf_avail);
@@ -736,6 +890,15 @@ static int a2dp_put_buffer(struct cras_iodev* iodev, unsigned nwritten) {
   size_t format_bytes;
   struct fl_pcm_io* a2dpio = (struct fl_pcm_io*)iodev;
 
+  if (a2dpio->shm) {
+    if (nwritten > cras_shm_get_num_writeable(a2dpio->shm)) {
+      return -EINVAL;
+    }
+    // Publishes the frames to Floss, no copy or send needed.
+    cras_shm_buffer_written_start(a2dpio->shm, nwritten);
+    return flush(iodev);
+  }
+
   format_bytes = cras_get_format_bytes(iodev->format);
   written_bytes = nwritten * format_bytes;
 
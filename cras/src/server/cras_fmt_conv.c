@@ -13,6 +13,8 @@
 #include <sys/param.h>
 #include <syslog.h>
 
+#include "cras/src/dsp/sample_conv.h"
+#include "cras/src/server/cras_fmt_conv_ch.h"
 #include "cras/src/server/cras_fmt_conv_ops.h"
 #include "cras/src/server/linear_resampler.h"
 #include "cras_audio_format.h"
@@ -65,6 +67,9 @@ struct cras_fmt_conv {
   struct linear_resampler* resampler;
   struct cras_audio_format in_fmt;
   struct cras_audio_format out_fmt;
+  // Sample format between the in and out format converters, S16_LE or
+  // FLOAT_LE. Channel conversion and both resamplers run in this format.
+  snd_pcm_format_t work_format;
   uint8_t* tmp_bufs[MAX_NUM_CONVERTERS - 1];
   size_t tmp_buf_frames;
   size_t pre_linear_resample;
@@ -217,6 +222,9 @@ static size_t mono_to_stereo(struct cras_fmt_conv* conv,
                              const uint8_t* in,
                              size_t in_frames,
                              uint8_t* out) {
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_mono_to_stereo(in, in_frames, out);
+  }
   return s16_mono_to_stereo(in, in_frames, out);
 }
 
@@ -224,6 +232,14 @@ static size_t stereo_to_mono(struct cras_fmt_conv* conv,
                              const uint8_t* in,
                              size_t in_frames,
                              uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
+
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_stereo_to_mono(in, in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_stereo_to_mono(in, in_frames, out);
+  }
   return s16_stereo_to_mono(in, in_frames, out);
 }
 
@@ -237,6 +253,9 @@ static size_t mono_to_51(struct cras_fmt_conv* conv,
   right = conv->out_fmt.channel_layout[CRAS_CH_FR];
   center = conv->out_fmt.channel_layout[CRAS_CH_FC];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_mono_to_51(left, right, center, in, in_frames, out);
+  }
   return s16_mono_to_51(left, right, center, in, in_frames, out);
 }
 
@@ -244,12 +263,19 @@ static size_t stereo_to_51(struct cras_fmt_conv* conv,
                            const uint8_t* in,
                            size_t in_frames,
                            uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
   size_t left, right, center;
 
   left = conv->out_fmt.channel_layout[CRAS_CH_FL];
   right = conv->out_fmt.channel_layout[CRAS_CH_FR];
   center = conv->out_fmt.channel_layout[CRAS_CH_FC];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_stereo_to_51(left, right, center, in, in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_stereo_to_51(left, right, center, in, in_frames, out);
+  }
   return s16_stereo_to_51(left, right, center, in, in_frames, out);
 }
 
@@ -264,6 +290,9 @@ static size_t quad_to_51(struct cras_fmt_conv* conv,
   rl = conv->out_fmt.channel_layout[CRAS_CH_RL];
   rr = conv->out_fmt.channel_layout[CRAS_CH_RR];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_quad_to_51(fl, fr, rl, rr, in, in_frames, out);
+  }
   return s16_quad_to_51(fl, fr, rl, rr, in, in_frames, out);
 }
 
@@ -277,6 +306,9 @@ static size_t mono_to_71(struct cras_fmt_conv* conv,
   right = conv->out_fmt.channel_layout[CRAS_CH_FR];
   center = conv->out_fmt.channel_layout[CRAS_CH_FC];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_mono_to_71(left, right, center, in, in_frames, out);
+  }
   return s16_mono_to_71(left, right, center, in, in_frames, out);
 }
 
@@ -284,12 +316,19 @@ static size_t stereo_to_71(struct cras_fmt_conv* conv,
                            const uint8_t* in,
                            size_t in_frames,
                            uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
   size_t left, right, center;
 
   left = conv->out_fmt.channel_layout[CRAS_CH_FL];
   right = conv->out_fmt.channel_layout[CRAS_CH_FR];
   center = conv->out_fmt.channel_layout[CRAS_CH_FC];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_stereo_to_71(left, right, center, in, in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_stereo_to_71(left, right, center, in, in_frames, out);
+  }
   return s16_stereo_to_71(left, right, center, in, in_frames, out);
 }
 
@@ -304,6 +343,9 @@ static size_t quad_to_71(struct cras_fmt_conv* conv,
   rl = conv->out_fmt.channel_layout[CRAS_CH_RL];
   rr = conv->out_fmt.channel_layout[CRAS_CH_RR];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_quad_to_71(fl, fr, rl, rr, in, in_frames, out);
+  }
   return s16_quad_to_71(fl, fr, rl, rr, in, in_frames, out);
 }
 
@@ -311,6 +353,9 @@ static size_t _51_to_71(struct cras_fmt_conv* conv,
                         const uint8_t* in,
                         size_t in_frames,
                         uint8_t* out) {
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_51_to_71(&conv->in_fmt, &conv->out_fmt, in, in_frames, out);
+  }
   return s16_51_to_71(&conv->in_fmt, &conv->out_fmt, in, in_frames, out);
 }
 
@@ -318,6 +363,14 @@ static size_t _51_to_stereo(struct cras_fmt_conv* conv,
                             const uint8_t* in,
                             size_t in_frames,
                             uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
+
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_51_to_stereo(in, in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_51_to_stereo(in, in_frames, out);
+  }
   return s16_51_to_stereo(in, in_frames, out);
 }
 
@@ -325,6 +378,14 @@ static size_t _51_to_quad(struct cras_fmt_conv* conv,
                           const uint8_t* in,
                           size_t in_frames,
                           uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
+
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_51_to_quad(in, in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_51_to_quad(in, in_frames, out);
+  }
   return s16_51_to_quad(in, in_frames, out);
 }
 
@@ -337,6 +398,9 @@ static size_t stereo_to_quad(struct cras_fmt_conv* conv,
   front_left = conv->out_fmt.channel_layout[CRAS_CH_FL];
   front_right = conv->out_fmt.channel_layout[CRAS_CH_FR];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_stereo_to_quad(front_left, front_right, in, in_frames, out);
+  }
   return s16_stereo_to_quad(front_left, front_right, in, in_frames, out);
 }
 
@@ -344,6 +408,7 @@ static size_t quad_to_stereo(struct cras_fmt_conv* conv,
                              const uint8_t* in,
                              size_t in_frames,
                              uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
   size_t front_left, front_right, rear_left, rear_right;
 
   front_left = conv->in_fmt.channel_layout[CRAS_CH_FL];
@@ -351,6 +416,14 @@ static size_t quad_to_stereo(struct cras_fmt_conv* conv,
   rear_left = conv->in_fmt.channel_layout[CRAS_CH_RL];
   rear_right = conv->in_fmt.channel_layout[CRAS_CH_RR];
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_quad_to_stereo(front_left, front_right, rear_left, rear_right,
+                              in, in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_quad_to_stereo(front_left, front_right, rear_left,
+                                      rear_right, in, in_frames, out);
+  }
   return s16_quad_to_stereo(front_left, front_right, rear_left, rear_right, in,
                             in_frames, out);
 }
@@ -364,6 +437,10 @@ static size_t default_all_to_all(struct cras_fmt_conv* conv,
   num_in_ch = conv->in_fmt.num_channels;
   num_out_ch = conv->out_fmt.num_channels;
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_default_all_to_all(&conv->out_fmt, num_in_ch, num_out_ch, in,
+                                  in_frames, out);
+  }
   return s16_default_all_to_all(&conv->out_fmt, num_in_ch, num_out_ch, in,
                                 in_frames, out);
 }
@@ -378,6 +455,10 @@ static size_t default_some_to_some(struct cras_fmt_conv* conv,
   num_in_ch = conv->in_fmt.num_channels;
   num_out_ch = conv->out_fmt.num_channels;
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_some_to_some(&conv->out_fmt, num_in_ch, num_out_ch, in,
+                            in_frames, out);
+  }
   return s16_some_to_some(&conv->out_fmt, num_in_ch, num_out_ch, in, in_frames,
                           out);
 }
@@ -386,6 +467,7 @@ static size_t convert_channels(struct cras_fmt_conv* conv,
                                const uint8_t* in,
                                size_t in_frames,
                                uint8_t* out) {
+  const struct cras_fmt_conv_ch_ops* ch_ops = cras_fmt_conv_ch_get_ops();
   float** ch_conv_mtx;
   size_t num_in_ch, num_out_ch;
 
@@ -393,6 +475,14 @@ static size_t convert_channels(struct cras_fmt_conv* conv,
   num_in_ch = conv->in_fmt.num_channels;
   num_out_ch = conv->out_fmt.num_channels;
 
+  if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+    return f32_convert_channels(ch_conv_mtx, num_in_ch, num_out_ch, in,
+                                in_frames, out);
+  }
+  if (ch_ops) {
+    return ch_ops->s16_convert_channels(ch_conv_mtx, num_in_ch, num_out_ch, in,
+                                        in_frames, out);
+  }
   return s16_convert_channels(ch_conv_mtx, num_in_ch, num_out_ch, in, in_frames,
                               out);
 }
@@ -433,15 +523,87 @@ static float** cras_internal_spk_channel_conv_matrix_create(
   return mtx;
 }
 
-/*
- * Exported interface
- */
+static sample_format_converter_t get_in_format_converter(snd_pcm_format_t from,
+                                                         snd_pcm_format_t to) {
+  const struct cras_sample_conv_ops* ops = cras_sample_conv_get_ops();
 
-struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
-                                           const struct cras_audio_format* out,
-                                           size_t max_frames,
-                                           size_t pre_linear_resample,
-                                           enum CRAS_NODE_TYPE node_type) {
+  if (to == SND_PCM_FORMAT_FLOAT_LE) {
+    switch (from) {
+      case SND_PCM_FORMAT_U8:
+        return ops->u8_to_f32le;
+      case SND_PCM_FORMAT_S16_LE:
+        return ops->s16le_to_f32le;
+      case SND_PCM_FORMAT_S24_LE:
+        return ops->s24le_to_f32le;
+      case SND_PCM_FORMAT_S32_LE:
+        return ops->s32le_to_f32le;
+      case SND_PCM_FORMAT_S24_3LE:
+        return ops->s243le_to_f32le;
+      default:
+        break;
+    }
+  } else {
+    switch (from) {
+      case SND_PCM_FORMAT_U8:
+        return ops->u8_to_s16le;
+      case SND_PCM_FORMAT_S24_LE:
+        return ops->s24le_to_s16le;
+      case SND_PCM_FORMAT_S32_LE:
+        return ops->s32le_to_s16le;
+      case SND_PCM_FORMAT_S24_3LE:
+        return ops->s243le_to_s16le;
+      default:
+        break;
+    }
+  }
+  syslog(LOG_ERR, "Should never reachable");
+  return NULL;
+}
+
+static sample_format_converter_t get_out_format_converter(snd_pcm_format_t from,
+                                                          snd_pcm_format_t to) {
+  const struct cras_sample_conv_ops* ops = cras_sample_conv_get_ops();
+
+  if (from == SND_PCM_FORMAT_FLOAT_LE) {
+    switch (to) {
+      case SND_PCM_FORMAT_U8:
+        return ops->f32le_to_u8;
+      case SND_PCM_FORMAT_S16_LE:
+        return ops->f32le_to_s16le;
+      case SND_PCM_FORMAT_S24_LE:
+        return ops->f32le_to_s24le;
+      case SND_PCM_FORMAT_S32_LE:
+        return ops->f32le_to_s32le;
+      case SND_PCM_FORMAT_S24_3LE:
+        return ops->f32le_to_s243le;
+      default:
+        break;
+    }
+  } else {
+    switch (to) {
+      case SND_PCM_FORMAT_U8:
+        return ops->s16le_to_u8;
+      case SND_PCM_FORMAT_S24_LE:
+        return ops->s16le_to_s24le;
+      case SND_PCM_FORMAT_S32_LE:
+        return ops->s16le_to_s32le;
+      case SND_PCM_FORMAT_S24_3LE:
+        return ops->s16le_to_s243le;
+      default:
+        break;
+    }
+  }
+  syslog(LOG_ERR, "Should never reachable");
+  return NULL;
+}
+
+static struct cras_fmt_conv* fmt_conv_create(
+    const struct cras_audio_format* in,
+    const struct cras_audio_format* out,
+    size_t max_frames,
+    size_t pre_linear_resample,
+    enum CRAS_NODE_TYPE node_type,
+    snd_pcm_format_t work_format) {
   struct cras_fmt_conv* conv;
   int rc;
   unsigned i;
@@ -452,6 +614,7 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
   }
   conv->in_fmt = *in;
   conv->out_fmt = *out;
+  conv->work_format = work_format;
   conv->tmp_buf_frames = max_frames;
   conv->pre_linear_resample = pre_linear_resample;
 
@@ -467,50 +630,19 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
     return NULL;
   }
 
-  // Set up sample format conversion.
-  /* TODO(dgreid) - modify channel and sample rate conversion so
-   * converting to s16 isnt necessary. */
-  if (in->format != SND_PCM_FORMAT_S16_LE) {
+  /* Set up sample format conversion. Channel conversion and sample rate
+   * conversion work on work_format samples. */
+  if (in->format != work_format) {
     conv->num_converters++;
     syslog(LOG_DEBUG, "Convert from format %d to %d.", in->format, out->format);
-    switch (in->format) {
-      case SND_PCM_FORMAT_U8:
-        conv->in_format_converter = convert_u8_to_s16le;
-        break;
-      case SND_PCM_FORMAT_S24_LE:
-        conv->in_format_converter = convert_s24le_to_s16le;
-        break;
-      case SND_PCM_FORMAT_S32_LE:
-        conv->in_format_converter = convert_s32le_to_s16le;
-        break;
-      case SND_PCM_FORMAT_S24_3LE:
-        conv->in_format_converter = convert_s243le_to_s16le;
-        break;
-      default:
-        syslog(LOG_ERR, "Should never reachable");
-        break;
-    }
+    conv->in_format_converter =
+        get_in_format_converter(in->format, work_format);
   }
-  if (out->format != SND_PCM_FORMAT_S16_LE) {
+  if (out->format != work_format) {
     conv->num_converters++;
     syslog(LOG_DEBUG, "Convert from format %d to %d.", in->format, out->format);
-    switch (out->format) {
-      case SND_PCM_FORMAT_U8:
-        conv->out_format_converter = convert_s16le_to_u8;
-        break;
-      case SND_PCM_FORMAT_S24_LE:
-        conv->out_format_converter = convert_s16le_to_s24le;
-        break;
-      case SND_PCM_FORMAT_S32_LE:
-        conv->out_format_converter = convert_s16le_to_s32le;
-        break;
-      case SND_PCM_FORMAT_S24_3LE:
-        conv->out_format_converter = convert_s16le_to_s243le;
-        break;
-      default:
-        syslog(LOG_ERR, "Should never reachable");
-        break;
-    }
+    conv->out_format_converter =
+        get_out_format_converter(work_format, out->format);
   }
 
   // Set up channel number conversion.
@@ -635,9 +767,9 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
    * rate for inaccurate device consumption rate.
    */
   conv->num_converters++;
-  conv->resampler =
-      linear_resampler_create(out->num_channels, cras_get_format_bytes(out),
-                              out->frame_rate, out->frame_rate);
+  conv->resampler = linear_resampler_create_with_format(
+      pre_linear_resample ? in->num_channels : out->num_channels, work_format,
+      out->frame_rate, out->frame_rate);
   if (conv->resampler == NULL) {
     syslog(LOG_ERR, "Fail to create linear resampler");
     cras_fmt_conv_destroy(&conv);
@@ -662,6 +794,29 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
   return conv;
 }
 
+/*
+ * Exported interface
+ */
+
+struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
+                                           const struct cras_audio_format* out,
+                                           size_t max_frames,
+                                           size_t pre_linear_resample,
+                                           enum CRAS_NODE_TYPE node_type) {
+  return fmt_conv_create(in, out, max_frames, pre_linear_resample, node_type,
+                         SND_PCM_FORMAT_S16_LE);
+}
+
+struct cras_fmt_conv* cras_fmt_conv_create_float(
+    const struct cras_audio_format* in,
+    const struct cras_audio_format* out,
+    size_t max_frames,
+    size_t pre_linear_resample,
+    enum CRAS_NODE_TYPE node_type) {
+  return fmt_conv_create(in, out, max_frames, pre_linear_resample, node_type,
+                         SND_PCM_FORMAT_FLOAT_LE);
+}
+
 void cras_fmt_conv_destroy(struct cras_fmt_conv** convp) {
   unsigned i;
   struct cras_fmt_conv* conv = *convp;
@@ -744,6 +899,15 @@ void cras_channel_remix_convert(struct cras_fmt_conv* conv,
   }
 }
 
+float** cras_channel_remix_matrix(const struct cras_fmt_conv* conv,
+                                  const struct cras_audio_format* fmt) {
+  if (fmt->format != SND_PCM_FORMAT_S16_LE ||
+      fmt->num_channels != conv->in_fmt.num_channels) {
+    return NULL;
+  }
+  return conv->ch_conv_mtx;
+}
+
 const struct cras_audio_format* cras_fmt_conv_in_format(
     const struct cras_fmt_conv* conv) {
   return &conv->in_fmt;
@@ -841,6 +1005,16 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
   buffers[0] = (uint8_t*)in_buf;
   buffers[used_converters] = out_buf;
 
+  /* If the input format isn't the working format convert to it. This runs
+   * ahead of the pre linear resampler so that it only needs to handle the
+   * working format. */
+  if (conv->in_format_converter != NULL) {
+    conv->in_format_converter(buffers[buf_idx],
+                              fr_in * conv->in_fmt.num_channels,
+                              (uint8_t*)buffers[buf_idx + 1]);
+    buf_idx++;
+  }
+
   if (pre_linear_resample) {
     linear_resample_fr = fr_in;
     unsigned resample_limit = out_frames;
@@ -870,14 +1044,6 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
     buf_idx++;
   }
 
-  // If the input format isn't S16_LE convert to it.
-  if (conv->in_fmt.format != SND_PCM_FORMAT_S16_LE) {
-    conv->in_format_converter(buffers[buf_idx],
-                              fr_in * conv->in_fmt.num_channels,
-                              (uint8_t*)buffers[buf_idx + 1]);
-    buf_idx++;
-  }
-
   // Then channel conversion.
   if (conv->channel_converter != NULL) {
     conv->channel_converter(conv, buffers[buf_idx], fr_in,
@@ -901,9 +1067,15 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
     }
     // limit frames to the output size.
     fr_out = MIN(fr_out, out_limit);
-    speex_resampler_process_interleaved_int(
-        conv->speex_state, (int16_t*)buffers[buf_idx], &fr_in,
-        (int16_t*)buffers[buf_idx + 1], &fr_out);
+    if (conv->work_format == SND_PCM_FORMAT_FLOAT_LE) {
+      speex_resampler_process_interleaved_float(
+          conv->speex_state, (float*)buffers[buf_idx], &fr_in,
+          (float*)buffers[buf_idx + 1], &fr_out);
+    } else {
+      speex_resampler_process_interleaved_int(
+          conv->speex_state, (int16_t*)buffers[buf_idx], &fr_in,
+          (int16_t*)buffers[buf_idx + 1], &fr_out);
+    }
     buf_idx++;
   }
 
@@ -916,8 +1088,8 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
     buf_idx++;
   }
 
-  // If the output format isn't S16_LE convert to it.
-  if (conv->out_fmt.format != SND_PCM_FORMAT_S16_LE) {
+  // If the output format isn't the working format convert to it.
+  if (conv->out_format_converter != NULL) {
     conv->out_format_converter(buffers[buf_idx],
                                fr_out * conv->out_fmt.num_channels,
                                (uint8_t*)buffers[buf_idx + 1]);
@@ -957,7 +1129,8 @@ int config_format_converter(struct cras_fmt_conv** conv,
                             const struct cras_audio_format* from,
                             const struct cras_audio_format* to,
                             enum CRAS_NODE_TYPE node_type,
-                            unsigned int frames) {
+                            unsigned int frames,
+                            int high_res) {
   struct cras_audio_format target;
 
   /* For input, preserve the channel count and layout of
@@ -975,8 +1148,14 @@ int config_format_converter(struct cras_fmt_conv** conv,
          "frames = %u",
          from->format, from->frame_rate, from->num_channels, target.format,
          target.frame_rate, target.num_channels, frames);
-  *conv = cras_fmt_conv_create(from, &target, frames,
-                               (dir == CRAS_STREAM_INPUT), node_type);
+  if (high_res && (from->format != SND_PCM_FORMAT_S16_LE ||
+                   target.format != SND_PCM_FORMAT_S16_LE)) {
+    *conv = cras_fmt_conv_create_float(from, &target, frames,
+                                       (dir == CRAS_STREAM_INPUT), node_type);
+  } else {
+    *conv = cras_fmt_conv_create(from, &target, frames,
+                                 (dir == CRAS_STREAM_INPUT), node_type);
+  }
   if (!*conv) {
     syslog(LOG_ERR, "Failed to create format converter");
     return -ENOMEM;
@@ -26,6 +26,18 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
                                            enum CRAS_NODE_TYPE node_type);
 void cras_fmt_conv_destroy(struct cras_fmt_conv** conv);
 
+/* Creates a format converter that keeps samples in float between the input
+ * and output format conversions, instead of S16. Channel conversion and
+ * resampling then run at full precision for formats wider than 16 bits.
+ * Args are the same as cras_fmt_conv_create().
+ */
+struct cras_fmt_conv* cras_fmt_conv_create_float(
+    const struct cras_audio_format* in,
+    const struct cras_audio_format* out,
+    size_t max_frames,
+    size_t pre_linear_resample,
+    enum CRAS_NODE_TYPE node_type);
+
 /* Creates the format converter for channel remixing. The conversion takes
  * a N by N float matrix, to multiply each N-channels sample.
  * Args:
@@ -48,6 +60,15 @@ void cras_channel_remix_convert(struct cras_fmt_conv* conv,
                                 uint8_t* in_buf,
                                 size_t nframes);
 
+/* Returns the remix matrix cras_channel_remix_convert() would apply to a
+ * buffer of the given format, or NULL if it would leave the buffer as is.
+ * Args:
+ *    conv - The remix converter.
+ *    fmt - The format of the buffer to convert.
+ */
+float** cras_channel_remix_matrix(const struct cras_fmt_conv* conv,
+                                  const struct cras_audio_format* fmt);
+
 // Get the input format of the converter.
 const struct cras_audio_format* cras_fmt_conv_in_format(
     const struct cras_fmt_conv* conv);
@@ -101,12 +122,15 @@ int cras_fmt_conversion_needed(const struct cras_fmt_conv* conv);
  *    to - Format to convert to.
  *    node_type - The CRAS_NODE_TYPE of the active node.
  *    frames - size of buffer.
+ *    high_res - Non-zero to convert through float instead of S16 when
+ *        either format is wider than 16 bits.
  */
 int config_format_converter(struct cras_fmt_conv** conv,
                             enum CRAS_STREAM_DIRECTION dir,
                             const struct cras_audio_format* from,
                             const struct cras_audio_format* to,
                             enum CRAS_NODE_TYPE node_type,
-                            unsigned int frames);
+                            unsigned int frames,
+                            int high_res);
 
 #endif  // CRAS_SRC_SERVER_CRAS_FMT_CONV_H_
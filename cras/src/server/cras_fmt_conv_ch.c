@@ -0,0 +1,47 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/cras_fmt_conv_ch.h"
+
+#include <stddef.h>
+
+#include "cras/src/server/cras_fmt_conv_ch_ops.h"
+#include "cras/src/server/cras_mix.h"
+
+static const struct cras_fmt_conv_ch_ops* ops = NULL;
+
+static const struct cras_fmt_conv_ch_ops* get_ch_ops(unsigned int cpu_flags) {
+#if HAVE_AVX2
+  if (cpu_flags & CPU_X86_AVX2) {
+    return &fmt_conv_ch_ops_avx2;
+  }
+#endif
+#if HAVE_SSE42
+  if (cpu_flags & CPU_X86_SSE4_2) {
+    return &fmt_conv_ch_ops_sse42;
+  }
+#endif
+
+#if HAVE_NEON
+  if (cpu_flags & CPU_ARM_NEON) {
+    return &fmt_conv_ch_ops_neon;
+  }
+#endif
+
+  // default C implementation
+  return NULL;
+}
+
+void cras_fmt_conv_ch_init() {
+  ops = get_ch_ops(cpu_get_flags());
+}
+
+void cras_fmt_conv_ch_init_with_flags(unsigned int cpu_flags) {
+  ops = get_ch_ops(cpu_flags & cpu_get_flags());
+}
+
+const struct cras_fmt_conv_ch_ops* cras_fmt_conv_ch_get_ops() {
+  return ops;
+}
@@ -0,0 +1,23 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_SERVER_CRAS_FMT_CONV_CH_H_
+#define CRAS_SRC_SERVER_CRAS_FMT_CONV_CH_H_
+
+#include "cras/src/server/cras_fmt_conv_ch_ops.h"
+
+// Selects the SIMD channel converters for the running CPU.
+void cras_fmt_conv_ch_init();
+
+/* Selects the channel converters for cpu_flags, restricted to the features
+ * the running CPU has. Lets tests and benchmarks compare the variants, pass
+ * 0 for the portable C converters. */
+void cras_fmt_conv_ch_init_with_flags(unsigned int cpu_flags);
+
+/* Returns the selected SIMD channel converters, or NULL when the portable
+ * C converters in cras_fmt_conv_ops.h should be used. */
+const struct cras_fmt_conv_ch_ops* cras_fmt_conv_ch_get_ops();
+
+#endif
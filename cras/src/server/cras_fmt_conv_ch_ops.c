@@ -0,0 +1,306 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/cras_fmt_conv_ch_ops.h"
+
+#include <stdint.h>
+#include <sys/param.h>
+
+#include "cras_audio_format.h"
+
+/* This file is compiled once per instruction set and relies on the compiler
+ * to vectorize the loops: constant frame strides for the common channel
+ * layouts, no aliasing between in and out, and float math done on planes. */
+#ifdef OPS_SSE42
+#define OPS(a) a##_sse42
+#elif defined(OPS_AVX2)
+#define OPS(a) a##_avx2
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#else
+#error "Build with one of OPS_SSE42, OPS_AVX2 or OPS_NEON defined."
+#endif
+
+/* Frames staged as float planes at a time by the mixing converters. The
+ * strided loads from the interleaved input stay scalar, the arithmetic on
+ * the planes is what gets vectorized. */
+#define BLOCK_FRAMES 64
+/* Samples staged by s16_convert_channels, whose blocks are
+ * CH_CONV_BLOCK_SAMPLES / num_in_ch frames. */
+#define CH_CONV_BLOCK_SAMPLES (CRAS_CH_MAX * BLOCK_FRAMES)
+
+static inline int16_t add_and_clip(int32_t a, int32_t b) {
+  return MIN(MAX(a + b, INT16_MIN), INT16_MAX);
+}
+
+static inline int16_t clip_to_s16(float v) {
+  return (int16_t)MIN(MAX(v, -32768.0f), 32767.0f);
+}
+
+// Copies channel ch of n interleaved frames into a float plane.
+static inline void load_plane(const int16_t* __restrict__ in,
+                              size_t num_ch,
+                              size_t ch,
+                              size_t n,
+                              float* __restrict__ plane) {
+  size_t fr;
+
+  for (fr = 0; fr < n; fr++) {
+    plane[fr] = in[fr * num_ch + ch];
+  }
+}
+
+static size_t OPS(s16_stereo_to_mono)(const uint8_t* _in,
+                                      size_t in_frames,
+                                      uint8_t* _out) {
+  const int16_t* __restrict__ in = (const int16_t*)_in;
+  int16_t* __restrict__ out = (int16_t*)_out;
+  size_t i;
+
+  for (i = 0; i < in_frames; i++) {
+    out[i] = add_and_clip(in[2 * i], in[2 * i + 1]);
+  }
+  return in_frames;
+}
+
+/* Fills frames the way s16_stereo_to_51/71 do for a layout that doesn't
+ * put left/right on the first two channels. Writes each output frame whole
+ * instead of clearing the buffer in a separate pass. */
+static void stereo_to_n(size_t out_ch,
+                        size_t left,
+                        size_t right,
+                        size_t center,
+                        const int16_t* __restrict__ in,
+                        size_t in_frames,
+                        int16_t* __restrict__ out) {
+  size_t i, ch;
+
+  for (i = 0; i < in_frames; i++) {
+    for (ch = 0; ch < out_ch; ch++) {
+      out[out_ch * i + ch] = 0;
+    }
+    if (left != -1 && right != -1) {
+      out[out_ch * i + left] = in[2 * i];
+      out[out_ch * i + right] = in[2 * i + 1];
+    } else if (center != -1) {
+      out[out_ch * i + center] = add_and_clip(in[2 * i], in[2 * i + 1]);
+    } else {
+      out[out_ch * i] = in[2 * i];
+      out[out_ch * i + 1] = in[2 * i + 1];
+    }
+  }
+}
+
+static size_t OPS(s16_stereo_to_51)(size_t left,
+                                    size_t right,
+                                    size_t center,
+                                    const uint8_t* _in,
+                                    size_t in_frames,
+                                    uint8_t* _out) {
+  const int16_t* __restrict__ in = (const int16_t*)_in;
+  int16_t* __restrict__ out = (int16_t*)_out;
+  size_t i;
+
+  if (left != 0 || right != 1) {
+    stereo_to_n(6, left, right, center, in, in_frames, out);
+    return in_frames;
+  }
+
+  for (i = 0; i < in_frames; i++) {
+    out[6 * i] = in[2 * i];
+    out[6 * i + 1] = in[2 * i + 1];
+    out[6 * i + 2] = 0;
+    out[6 * i + 3] = 0;
+    out[6 * i + 4] = 0;
+    out[6 * i + 5] = 0;
+  }
+  return in_frames;
+}
+
+static size_t OPS(s16_stereo_to_71)(size_t left,
+                                    size_t right,
+                                    size_t center,
+                                    const uint8_t* _in,
+                                    size_t in_frames,
+                                    uint8_t* _out) {
+  const int16_t* __restrict__ in = (const int16_t*)_in;
+  int16_t* __restrict__ out = (int16_t*)_out;
+  size_t i;
+
+  if (left != 0 || right != 1) {
+    stereo_to_n(8, left, right, center, in, in_frames, out);
+    return in_frames;
+  }
+
+  for (i = 0; i < in_frames; i++) {
+    out[8 * i] = in[2 * i];
+    out[8 * i + 1] = in[2 * i + 1];
+    out[8 * i + 2] = 0;
+    out[8 * i + 3] = 0;
+    out[8 * i + 4] = 0;
+    out[8 * i + 5] = 0;
+    out[8 * i + 6] = 0;
+    out[8 * i + 7] = 0;
+  }
+  return in_frames;
+}
+
+static size_t OPS(s16_51_to_stereo)(const uint8_t* _in,
+                                    size_t in_frames,
+                                    uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  int16_t* __restrict__ out = (int16_t*)_out;
+  // Same factors as s16_51_to_stereo, folded into single precision.
+  const float normalized_factor = 0.585f;
+  const float center_factor = 0.707f * 0.585f;
+  float l[BLOCK_FRAMES], r[BLOCK_FRAMES], c[BLOCK_FRAMES];
+  size_t done, n, i;
+
+  for (done = 0; done < in_frames; done += n) {
+    n = MIN(in_frames - done, BLOCK_FRAMES);
+    load_plane(in, 6, 0, n, l);
+    load_plane(in, 6, 1, n, r);
+    load_plane(in, 6, 2, n, c);
+    for (i = 0; i < n; i++) {
+      float half_center = (int32_t)(c[i] * center_factor);
+
+      out[2 * i] = (int32_t)(l[i] * normalized_factor + half_center);
+      out[2 * i + 1] = (int32_t)(r[i] * normalized_factor + half_center);
+    }
+    in += 6 * n;
+    out += 2 * n;
+  }
+  return in_frames;
+}
+
+static size_t OPS(s16_51_to_quad)(const uint8_t* _in,
+                                  size_t in_frames,
+                                  uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  int16_t* __restrict__ out = (int16_t*)_out;
+  // Same factors as s16_51_to_quad, folded into single precision.
+  const float normalized_factor = 0.453f;
+  const float center_factor = 0.707f * 0.453f;
+  const float lfe_factor = 0.5f * 0.453f;
+  float planes[6][BLOCK_FRAMES];
+  size_t done, n, i, ch;
+
+  for (done = 0; done < in_frames; done += n) {
+    n = MIN(in_frames - done, BLOCK_FRAMES);
+    for (ch = 0; ch < 6; ch++) {
+      load_plane(in, 6, ch, n, planes[ch]);
+    }
+    for (i = 0; i < n; i++) {
+      float half_center = (int32_t)(planes[2][i] * center_factor);
+      float lfe = (int32_t)(planes[3][i] * lfe_factor);
+
+      out[4 * i] = (int32_t)(normalized_factor * planes[0][i] + half_center +
+                             lfe);
+      out[4 * i + 1] = (int32_t)(normalized_factor * planes[1][i] +
+                                 half_center + lfe);
+      out[4 * i + 2] = (int32_t)(normalized_factor * planes[4][i] + lfe);
+      out[4 * i + 3] = (int32_t)(normalized_factor * planes[5][i] + lfe);
+    }
+    in += 6 * n;
+    out += 4 * n;
+  }
+  return in_frames;
+}
+
+static size_t OPS(s16_quad_to_stereo)(size_t front_left,
+                                      size_t front_right,
+                                      size_t rear_left,
+                                      size_t rear_right,
+                                      const uint8_t* _in,
+                                      size_t in_frames,
+                                      uint8_t* _out) {
+  const int16_t* __restrict__ in = (const int16_t*)_in;
+  int16_t* __restrict__ out = (int16_t*)_out;
+  size_t i;
+
+  if (front_left == -1 || front_right == -1 || rear_left == -1 ||
+      rear_right == -1 ||
+      (front_left == 0 && front_right == 1 && rear_left == 2 &&
+       rear_right == 3)) {
+    for (i = 0; i < in_frames; i++) {
+      out[2 * i] = add_and_clip(in[4 * i], in[4 * i + 2] / 4);
+      out[2 * i + 1] = add_and_clip(in[4 * i + 1], in[4 * i + 3] / 4);
+    }
+    return in_frames;
+  }
+
+  for (i = 0; i < in_frames; i++) {
+    out[2 * i] =
+        add_and_clip(in[4 * i + front_left], in[4 * i + rear_left] / 4);
+    out[2 * i + 1] =
+        add_and_clip(in[4 * i + front_right], in[4 * i + rear_right] / 4);
+  }
+  return in_frames;
+}
+
+/* Small matrix multiply, out = ch_conv_mtx * in, a block of frames at a
+ * time. The block is deinterleaved to float planes so every coefficient
+ * becomes one vector multiply-add over the block, and zero coefficients,
+ * which make up most of a typical up/down-mix matrix, are skipped. Sums are
+ * accumulated in float and truncated once, where s16_convert_channels
+ * truncates after every term, so a sample can differ from it by up to one
+ * per input channel. */
+static size_t OPS(s16_convert_channels)(float** ch_conv_mtx,
+                                        size_t num_in_ch,
+                                        size_t num_out_ch,
+                                        const uint8_t* _in,
+                                        size_t in_frames,
+                                        uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  int16_t* out = (int16_t*)_out;
+  float planes[CH_CONV_BLOCK_SAMPLES];
+  float acc[CH_CONV_BLOCK_SAMPLES];
+  size_t block = CH_CONV_BLOCK_SAMPLES / MAX(num_in_ch, 1);
+  size_t done, n, fr, i, o;
+
+  for (done = 0; done < in_frames; done += n) {
+    n = MIN(in_frames - done, block);
+
+    for (i = 0; i < num_in_ch; i++) {
+      load_plane(in, num_in_ch, i, n, planes + i * n);
+    }
+
+    for (o = 0; o < num_out_ch; o++) {
+      const float* coef = ch_conv_mtx[o];
+
+      for (fr = 0; fr < n; fr++) {
+        acc[fr] = 0.0f;
+      }
+      for (i = 0; i < num_in_ch; i++) {
+        const float c = coef[i];
+        const float* __restrict__ plane = planes + i * n;
+
+        if (c == 0.0f) {
+          continue;
+        }
+        for (fr = 0; fr < n; fr++) {
+          acc[fr] += c * plane[fr];
+        }
+      }
+      for (fr = 0; fr < n; fr++) {
+        out[fr * num_out_ch + o] = clip_to_s16(acc[fr]);
+      }
+    }
+
+    in += n * num_in_ch;
+    out += n * num_out_ch;
+  }
+  return in_frames;
+}
+
+const struct cras_fmt_conv_ch_ops OPS(fmt_conv_ch_ops) = {
+    .s16_stereo_to_mono = OPS(s16_stereo_to_mono),
+    .s16_stereo_to_51 = OPS(s16_stereo_to_51),
+    .s16_stereo_to_71 = OPS(s16_stereo_to_71),
+    .s16_51_to_stereo = OPS(s16_51_to_stereo),
+    .s16_51_to_quad = OPS(s16_51_to_quad),
+    .s16_quad_to_stereo = OPS(s16_quad_to_stereo),
+    .s16_convert_channels = OPS(s16_convert_channels),
+};
@@ -0,0 +1,63 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_SERVER_CRAS_FMT_CONV_CH_OPS_H_
+#define CRAS_SRC_SERVER_CRAS_FMT_CONV_CH_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern const struct cras_fmt_conv_ch_ops fmt_conv_ch_ops_sse42;
+extern const struct cras_fmt_conv_ch_ops fmt_conv_ch_ops_avx2;
+extern const struct cras_fmt_conv_ch_ops fmt_conv_ch_ops_neon;
+
+/* SIMD builds of the S16 channel converters in cras_fmt_conv_ops.h. Each
+ * op takes the same arguments and produces the same frames as the function
+ * it is named after. The ops that mix channels with float coefficients may
+ * round the last bit differently.
+ */
+struct cras_fmt_conv_ch_ops {
+  // See s16_stereo_to_mono.
+  size_t (*s16_stereo_to_mono)(const uint8_t* in,
+                               size_t in_frames,
+                               uint8_t* out);
+  // See s16_stereo_to_51.
+  size_t (*s16_stereo_to_51)(size_t left,
+                             size_t right,
+                             size_t center,
+                             const uint8_t* in,
+                             size_t in_frames,
+                             uint8_t* out);
+  // See s16_stereo_to_71.
+  size_t (*s16_stereo_to_71)(size_t left,
+                             size_t right,
+                             size_t center,
+                             const uint8_t* in,
+                             size_t in_frames,
+                             uint8_t* out);
+  // See s16_51_to_stereo.
+  size_t (*s16_51_to_stereo)(const uint8_t* in,
+                             size_t in_frames,
+                             uint8_t* out);
+  // See s16_51_to_quad.
+  size_t (*s16_51_to_quad)(const uint8_t* in, size_t in_frames, uint8_t* out);
+  // See s16_quad_to_stereo.
+  size_t (*s16_quad_to_stereo)(size_t front_left,
+                               size_t front_right,
+                               size_t rear_left,
+                               size_t rear_right,
+                               const uint8_t* in,
+                               size_t in_frames,
+                               uint8_t* out);
+  // See s16_convert_channels.
+  size_t (*s16_convert_channels)(float** ch_conv_mtx,
+                                 size_t num_in_ch,
+                                 size_t num_out_ch,
+                                 const uint8_t* in,
+                                 size_t in_frames,
+                                 uint8_t* out);
+};
+
+#endif
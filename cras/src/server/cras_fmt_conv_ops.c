@@ -144,6 +144,114 @@ void convert_f32le_to_s16le(const float* in, size_t in_samples, int16_t* out) {
   }
 }
 
+/*
+ * Float format converter. Samples are normalized to [-1.0, 1.0) and
+ * clipped back to the integer range on the way out.
+ */
+void convert_u8_to_f32le(const uint8_t* in, size_t in_samples, uint8_t* out) {
+  size_t i;
+  float* _out = (float*)out;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = ((int16_t)in[i] - 0x80) / 128.f;
+  }
+}
+
+void convert_s243le_to_f32le(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out) {
+  size_t i;
+  float* _out = (float*)out;
+  int32_t sample;
+
+  for (i = 0; i < in_samples; i++, in += 3) {
+    sample = (int32_t)((uint32_t)in[0] << 8 | (uint32_t)in[1] << 16 |
+                       (uint32_t)in[2] << 24);
+    _out[i] = (sample >> 8) / 8388608.f;
+  }
+}
+
+void convert_s24le_to_f32le(const uint8_t* in,
+                            size_t in_samples,
+                            uint8_t* out) {
+  size_t i;
+  const int32_t* _in = (const int32_t*)in;
+  float* _out = (float*)out;
+
+  for (i = 0; i < in_samples; i++) {
+    // Sign extend from the low 24 bits, ignoring the padding byte.
+    _out[i] = ((int32_t)((uint32_t)_in[i] << 8) >> 8) / 8388608.f;
+  }
+}
+
+void convert_s32le_to_f32le(const uint8_t* in,
+                            size_t in_samples,
+                            uint8_t* out) {
+  size_t i;
+  const int32_t* _in = (const int32_t*)in;
+  float* _out = (float*)out;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = _in[i] / 2147483648.f;
+  }
+}
+
+void convert_f32le_to_u8(const uint8_t* in, size_t in_samples, uint8_t* out) {
+  size_t i;
+  const float* _in = (const float*)in;
+
+  for (i = 0; i < in_samples; i++) {
+    out[i] = (uint8_t)(MAX(MIN(_in[i] * 128.f, 127.f), -128.f) + 128);
+  }
+}
+
+void convert_f32le_to_s243le(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out) {
+  size_t i;
+  const float* _in = (const float*)in;
+  int32_t sample;
+
+  for (i = 0; i < in_samples; i++, out += 3) {
+    sample = (int32_t)MAX(MIN(_in[i] * 8388608.f, 8388607.f), -8388608.f);
+    out[0] = sample & 0xff;
+    out[1] = (sample >> 8) & 0xff;
+    out[2] = (sample >> 16) & 0xff;
+  }
+}
+
+void convert_f32le_to_s24le(const uint8_t* in,
+                            size_t in_samples,
+                            uint8_t* out) {
+  size_t i;
+  const float* _in = (const float*)in;
+  int32_t* _out = (int32_t*)out;
+
+  for (i = 0; i < in_samples; i++) {
+    _out[i] = (int32_t)MAX(MIN(_in[i] * 8388608.f, 8388607.f), -8388608.f);
+  }
+}
+
+void convert_f32le_to_s32le(const uint8_t* in,
+                            size_t in_samples,
+                            uint8_t* out) {
+  size_t i;
+  const float* _in = (const float*)in;
+  int32_t* _out = (int32_t*)out;
+
+  for (i = 0; i < in_samples; i++) {
+    /* INT32_MAX isn't representable as a float, so saturate on the
+     * input side before scaling. */
+    if (_in[i] >= 1.f) {
+      _out[i] = INT32_MAX;
+    } else if (_in[i] <= -1.f) {
+      _out[i] = INT32_MIN;
+    } else {
+      _out[i] = (int32_t)(_in[i] * 2147483648.f);
+    }
+  }
+}
+
 /*
  * Channel converter: mono to stereo.
  */
@@ -735,3 +843,395 @@ size_t s16_convert_channels(float** ch_conv_mtx,
 
   return in_frames;
 }
+
+/*
+ * Float channel converters. These mirror the S16 converters above but work
+ * on normalized float samples. Nothing is clipped here, the headroom is kept
+ * until the final output format conversion.
+ */
+size_t f32_mono_to_stereo(const uint8_t* _in, size_t in_frames, uint8_t* _out) {
+  size_t i;
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+
+  for (i = 0; i < in_frames; i++) {
+    out[2 * i] = in[i];
+    out[2 * i + 1] = in[i];
+  }
+  return in_frames;
+}
+
+size_t f32_stereo_to_mono(const uint8_t* _in, size_t in_frames, uint8_t* _out) {
+  size_t i;
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+
+  for (i = 0; i < in_frames; i++) {
+    out[i] = in[2 * i] + in[2 * i + 1];
+  }
+  return in_frames;
+}
+
+/*
+ * Fits mono to the front center, or splits it to front left/right when
+ * front center is missing from the output layout. Shared by the 5.1 and 7.1
+ * converters.
+ */
+static size_t f32_mono_to_surround(size_t num_out_ch,
+                                   size_t left,
+                                   size_t right,
+                                   size_t center,
+                                   const float* in,
+                                   size_t in_frames,
+                                   float* out) {
+  size_t i;
+
+  memset(out, 0, sizeof(*out) * num_out_ch * in_frames);
+
+  if (center != -1) {
+    for (i = 0; i < in_frames; i++) {
+      out[num_out_ch * i + center] = in[i];
+    }
+  } else if (left != -1 && right != -1) {
+    for (i = 0; i < in_frames; i++) {
+      out[num_out_ch * i + right] = in[i] * 0.5f;
+      out[num_out_ch * i + left] = in[i] * 0.5f;
+    }
+  } else {
+    for (i = 0; i < in_frames; i++) {
+      out[num_out_ch * i] = in[i];
+    }
+  }
+
+  return in_frames;
+}
+
+/*
+ * Fits stereo to front left/right, or mixes it to front center when either
+ * front left/right is missing from the output layout.
+ */
+static size_t f32_stereo_to_surround(size_t num_out_ch,
+                                     size_t left,
+                                     size_t right,
+                                     size_t center,
+                                     const float* in,
+                                     size_t in_frames,
+                                     float* out) {
+  size_t i;
+
+  memset(out, 0, sizeof(*out) * num_out_ch * in_frames);
+
+  if (left != -1 && right != -1) {
+    for (i = 0; i < in_frames; i++) {
+      out[num_out_ch * i + left] = in[2 * i];
+      out[num_out_ch * i + right] = in[2 * i + 1];
+    }
+  } else if (center != -1) {
+    for (i = 0; i < in_frames; i++) {
+      out[num_out_ch * i + center] = in[2 * i] + in[2 * i + 1];
+    }
+  } else {
+    for (i = 0; i < in_frames; i++) {
+      out[num_out_ch * i] = in[2 * i];
+      out[num_out_ch * i + 1] = in[2 * i + 1];
+    }
+  }
+
+  return in_frames;
+}
+
+/*
+ * Fits quad to the front and rear left/right, or to the default channel
+ * indexes 0, 1, 4, 5 when any of them is missing from the output layout.
+ */
+static size_t f32_quad_to_surround(size_t num_out_ch,
+                                   size_t front_left,
+                                   size_t front_right,
+                                   size_t rear_left,
+                                   size_t rear_right,
+                                   const float* in,
+                                   size_t in_frames,
+                                   float* out) {
+  size_t i;
+
+  memset(out, 0, sizeof(*out) * num_out_ch * in_frames);
+
+  if (front_left == -1 || front_right == -1 || rear_left == -1 ||
+      rear_right == -1) {
+    front_left = 0;
+    front_right = 1;
+    rear_left = 4;
+    rear_right = 5;
+  }
+
+  for (i = 0; i < in_frames; i++) {
+    out[num_out_ch * i + front_left] = in[4 * i];
+    out[num_out_ch * i + front_right] = in[4 * i + 1];
+    out[num_out_ch * i + rear_left] = in[4 * i + 2];
+    out[num_out_ch * i + rear_right] = in[4 * i + 3];
+  }
+
+  return in_frames;
+}
+
+size_t f32_mono_to_51(size_t left,
+                      size_t right,
+                      size_t center,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out) {
+  return f32_mono_to_surround(6, left, right, center, (const float*)in,
+                              in_frames, (float*)out);
+}
+
+size_t f32_stereo_to_51(size_t left,
+                        size_t right,
+                        size_t center,
+                        const uint8_t* in,
+                        size_t in_frames,
+                        uint8_t* out) {
+  return f32_stereo_to_surround(6, left, right, center, (const float*)in,
+                                in_frames, (float*)out);
+}
+
+size_t f32_quad_to_51(size_t front_left,
+                      size_t front_right,
+                      size_t rear_left,
+                      size_t rear_right,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out) {
+  return f32_quad_to_surround(6, front_left, front_right, rear_left,
+                              rear_right, (const float*)in, in_frames,
+                              (float*)out);
+}
+
+size_t f32_mono_to_71(size_t left,
+                      size_t right,
+                      size_t center,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out) {
+  return f32_mono_to_surround(8, left, right, center, (const float*)in,
+                              in_frames, (float*)out);
+}
+
+size_t f32_stereo_to_71(size_t left,
+                        size_t right,
+                        size_t center,
+                        const uint8_t* in,
+                        size_t in_frames,
+                        uint8_t* out) {
+  return f32_stereo_to_surround(8, left, right, center, (const float*)in,
+                                in_frames, (float*)out);
+}
+
+size_t f32_quad_to_71(size_t front_left,
+                      size_t front_right,
+                      size_t rear_left,
+                      size_t rear_right,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out) {
+  return f32_quad_to_surround(8, front_left, front_right, rear_left,
+                              rear_right, (const float*)in, in_frames,
+                              (float*)out);
+}
+
+size_t f32_51_to_71(const struct cras_audio_format* in_fmt,
+                    const struct cras_audio_format* out_fmt,
+                    const uint8_t* _in,
+                    size_t in_frames,
+                    uint8_t* _out) {
+  static const int map_channels[] = {CRAS_CH_FL, CRAS_CH_FR, CRAS_CH_FC,
+                                     CRAS_CH_LFE, CRAS_CH_RL, CRAS_CH_RR,
+                                     CRAS_CH_SL,  CRAS_CH_SR};
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  const int8_t* in_layout = in_fmt->channel_layout;
+  const int8_t* out_layout = out_fmt->channel_layout;
+  size_t i, ch;
+
+  memset(out, 0, sizeof(*out) * 8 * in_frames);
+
+  // Same layout requirements as s16_51_to_71().
+  if (in_layout[CRAS_CH_FL] != -1 && in_layout[CRAS_CH_FR] != -1 &&
+      in_layout[CRAS_CH_FC] != -1 && in_layout[CRAS_CH_LFE] != -1 &&
+      out_layout[CRAS_CH_FL] != -1 && out_layout[CRAS_CH_FR] != -1 &&
+      out_layout[CRAS_CH_FC] != -1 && out_layout[CRAS_CH_LFE] != -1 &&
+      ((in_layout[CRAS_CH_RL] != -1 && out_layout[CRAS_CH_RL] != -1) ||
+       (in_layout[CRAS_CH_SL] != -1 && out_layout[CRAS_CH_SL] != -1)) &&
+      ((in_layout[CRAS_CH_RR] != -1 && out_layout[CRAS_CH_RR] != -1) ||
+       (in_layout[CRAS_CH_SR] != -1 && out_layout[CRAS_CH_SR] != -1))) {
+    for (ch = 0; ch < sizeof(map_channels) / sizeof(map_channels[0]); ch++) {
+      int8_t from = in_layout[map_channels[ch]];
+      int8_t to = out_layout[map_channels[ch]];
+
+      if (from == -1 || to == -1) {
+        continue;
+      }
+      for (i = 0; i < in_frames; i++) {
+        out[8 * i + to] = in[6 * i + from];
+      }
+    }
+  } else {
+    for (i = 0; i < in_frames; i++) {
+      memcpy(&out[8 * i], &in[6 * i], 6 * sizeof(*out));
+    }
+  }
+
+  return in_frames;
+}
+
+size_t f32_51_to_stereo(const uint8_t* _in, size_t in_frames, uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  // Same normalization as s16_51_to_stereo().
+  const float normalized_factor = 0.585f;
+  float half_center;
+  size_t i;
+
+  for (i = 0; i < in_frames; i++) {
+    half_center = in[6 * i + 2] * 0.707f * normalized_factor;
+    out[2 * i] = in[6 * i] * normalized_factor + half_center;
+    out[2 * i + 1] = in[6 * i + 1] * normalized_factor + half_center;
+  }
+  return in_frames;
+}
+
+size_t f32_51_to_quad(const uint8_t* _in, size_t in_frames, uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  // Same normalization as s16_51_to_quad().
+  const float normalized_factor = 0.453f;
+  float half_center, lfe;
+  size_t i;
+
+  for (i = 0; i < in_frames; i++) {
+    half_center = in[6 * i + 2] * 0.707f * normalized_factor;
+    lfe = in[6 * i + 3] * 0.5f * normalized_factor;
+    out[4 * i] = normalized_factor * in[6 * i] + half_center + lfe;
+    out[4 * i + 1] = normalized_factor * in[6 * i + 1] + half_center + lfe;
+    out[4 * i + 2] = normalized_factor * in[6 * i + 4] + lfe;
+    out[4 * i + 3] = normalized_factor * in[6 * i + 5] + lfe;
+  }
+  return in_frames;
+}
+
+size_t f32_stereo_to_quad(size_t front_left,
+                          size_t front_right,
+                          const uint8_t* _in,
+                          size_t in_frames,
+                          uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  size_t i;
+
+  memset(out, 0, sizeof(*out) * 4 * in_frames);
+
+  if (front_left == -1 || front_right == -1) {
+    front_left = 0;
+    front_right = 1;
+  }
+  for (i = 0; i < in_frames; i++) {
+    out[4 * i + front_left] = in[2 * i];
+    out[4 * i + front_right] = in[2 * i + 1];
+  }
+
+  return in_frames;
+}
+
+size_t f32_quad_to_stereo(size_t front_left,
+                          size_t front_right,
+                          size_t rear_left,
+                          size_t rear_right,
+                          const uint8_t* _in,
+                          size_t in_frames,
+                          uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  size_t i;
+
+  if (front_left == -1 || front_right == -1 || rear_left == -1 ||
+      rear_right == -1) {
+    front_left = 0;
+    front_right = 1;
+    rear_left = 2;
+    rear_right = 3;
+  }
+
+  for (i = 0; i < in_frames; i++) {
+    out[2 * i] = in[4 * i + front_left] + in[4 * i + rear_left] * 0.25f;
+    out[2 * i + 1] = in[4 * i + front_right] + in[4 * i + rear_right] * 0.25f;
+  }
+  return in_frames;
+}
+
+size_t f32_default_all_to_all(struct cras_audio_format* out_fmt,
+                              size_t num_in_ch,
+                              size_t num_out_ch,
+                              const uint8_t* _in,
+                              size_t in_frames,
+                              uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  size_t i, in_ch, out_ch;
+  float sum;
+
+  for (i = 0; i < in_frames; i++) {
+    sum = 0;
+    for (in_ch = 0; in_ch < num_in_ch; in_ch++) {
+      sum += in[in_ch + i * num_in_ch];
+    }
+    sum /= num_in_ch;
+    for (out_ch = 0; out_ch < num_out_ch; out_ch++) {
+      out[out_ch + i * num_out_ch] = sum;
+    }
+  }
+  return in_frames;
+}
+
+size_t f32_some_to_some(const struct cras_audio_format* out_fmt,
+                        const size_t num_in_ch,
+                        const size_t num_out_ch,
+                        const uint8_t* _in,
+                        const size_t frame_count,
+                        uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  const size_t num_copy_ch = MIN(num_in_ch, num_out_ch);
+  size_t i;
+
+  memset(out, 0, frame_count * num_out_ch * sizeof(*out));
+  for (i = 0; i < frame_count; i++, out += num_out_ch, in += num_in_ch) {
+    memcpy(out, in, num_copy_ch * sizeof(*out));
+  }
+
+  return frame_count;
+}
+
+size_t f32_convert_channels(float** ch_conv_mtx,
+                            size_t num_in_ch,
+                            size_t num_out_ch,
+                            const uint8_t* _in,
+                            size_t in_frames,
+                            uint8_t* _out) {
+  const float* in = (const float*)_in;
+  float* out = (float*)_out;
+  size_t fr, i, j;
+  float sum;
+
+  for (fr = 0; fr < in_frames; fr++) {
+    for (i = 0; i < num_out_ch; i++) {
+      sum = 0;
+      for (j = 0; j < num_in_ch; j++) {
+        sum += ch_conv_mtx[i][j] * in[j];
+      }
+      out[i] = sum;
+    }
+    in += num_in_ch;
+    out += num_out_ch;
+  }
+
+  return in_frames;
+}
@@ -28,6 +28,22 @@ void convert_s16le_to_s32le(const uint8_t* in, size_t in_samples, uint8_t* out);
 void convert_s16le_to_f32le(const int16_t* in, size_t in_samples, float* out);
 void convert_f32le_to_s16le(const float* in, size_t in_samples, int16_t* out);
 
+/*
+ * Float format converter, samples are normalized to [-1.0, 1.0).
+ */
+void convert_u8_to_f32le(const uint8_t* in, size_t in_samples, uint8_t* out);
+void convert_s243le_to_f32le(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out);
+void convert_s24le_to_f32le(const uint8_t* in, size_t in_samples, uint8_t* out);
+void convert_s32le_to_f32le(const uint8_t* in, size_t in_samples, uint8_t* out);
+void convert_f32le_to_u8(const uint8_t* in, size_t in_samples, uint8_t* out);
+void convert_f32le_to_s243le(const uint8_t* in,
+                             size_t in_samples,
+                             uint8_t* out);
+void convert_f32le_to_s24le(const uint8_t* in, size_t in_samples, uint8_t* out);
+void convert_f32le_to_s32le(const uint8_t* in, size_t in_samples, uint8_t* out);
+
 /*
  * Channel converter: mono to stereo.
  */
@@ -177,4 +193,86 @@ size_t s16_convert_channels(float** ch_conv_mtx,
                             size_t in_frames,
                             uint8_t* out);
 
+/*
+ * Float channel converters. Same mappings as the S16 versions above, but
+ * without intermediate clipping.
+ */
+size_t f32_mono_to_stereo(const uint8_t* in, size_t in_frames, uint8_t* out);
+size_t f32_stereo_to_mono(const uint8_t* in, size_t in_frames, uint8_t* out);
+size_t f32_mono_to_51(size_t left,
+                      size_t right,
+                      size_t center,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out);
+size_t f32_stereo_to_51(size_t left,
+                        size_t right,
+                        size_t center,
+                        const uint8_t* in,
+                        size_t in_frames,
+                        uint8_t* out);
+size_t f32_quad_to_51(size_t front_left,
+                      size_t front_right,
+                      size_t rear_left,
+                      size_t rear_right,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out);
+size_t f32_mono_to_71(size_t left,
+                      size_t right,
+                      size_t center,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out);
+size_t f32_stereo_to_71(size_t left,
+                        size_t right,
+                        size_t center,
+                        const uint8_t* in,
+                        size_t in_frames,
+                        uint8_t* out);
+size_t f32_quad_to_71(size_t front_left,
+                      size_t front_right,
+                      size_t rear_left,
+                      size_t rear_right,
+                      const uint8_t* in,
+                      size_t in_frames,
+                      uint8_t* out);
+size_t f32_51_to_71(const struct cras_audio_format* in_fmt,
+                    const struct cras_audio_format* out_fmt,
+                    const uint8_t* in,
+                    size_t in_frames,
+                    uint8_t* out);
+size_t f32_51_to_stereo(const uint8_t* in, size_t in_frames, uint8_t* out);
+size_t f32_51_to_quad(const uint8_t* in, size_t in_frames, uint8_t* out);
+size_t f32_stereo_to_quad(size_t front_left,
+                          size_t front_right,
+                          const uint8_t* in,
+                          size_t in_frames,
+                          uint8_t* out);
+size_t f32_quad_to_stereo(size_t front_left,
+                          size_t front_right,
+                          size_t rear_left,
+                          size_t rear_right,
+                          const uint8_t* in,
+                          size_t in_frames,
+                          uint8_t* out);
+size_t f32_default_all_to_all(struct cras_audio_format* out_fmt,
+                              size_t num_in_ch,
+                              size_t num_out_ch,
+                              const uint8_t* in,
+                              size_t in_frames,
+                              uint8_t* out);
+size_t f32_some_to_some(const struct cras_audio_format* out_fmt,
+                        const size_t num_in_ch,
+                        const size_t num_out_ch,
+                        const uint8_t* in,
+                        const size_t frame_count,
+                        uint8_t* out);
+size_t f32_convert_channels(float** ch_conv_mtx,
+                            size_t num_in_ch,
+                            size_t num_out_ch,
+                            const uint8_t* in,
+                            size_t in_frames,
+                            uint8_t* out);
+
 #endif  // CRAS_SRC_SERVER_CRAS_FMT_CONV_OPS_H_
@@ -0,0 +1,96 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/cras_fused_output.h"
+
+#include <stddef.h>
+
+#include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras/src/server/ewma_power.h"
+#include "cras_types.h"
+
+// Same thresholds as the scale ops in cras_mix_ops.c.
+#define MAX_VOLUME_TO_SCALE 0.9999999
+#define MIN_VOLUME_TO_SCALE 0.0000001
+
+static inline int ewma_active(const struct cras_fused_output* stages) {
+  return stages->ewma && stages->ewma->enabled &&
+         stages->ewma->fmt == SND_PCM_FORMAT_S16_LE;
+}
+
+unsigned int cras_fused_output_num_stages(
+    const struct cras_fused_output* stages) {
+  return !!stages->is_non_empty + ewma_active(stages) + !!stages->scale +
+         !!stages->remix_mtx;
+}
+
+void cras_fused_output_apply_s16(const struct cras_fused_output* stages,
+                                 int16_t* buf,
+                                 unsigned int num_channels,
+                                 unsigned int nframes) {
+  struct ewma_power* ewma = ewma_active(stages) ? stages->ewma : NULL;
+  float** mtx = stages->remix_mtx;
+  float scaler = stages->scaler;
+  const float increment = stages->increment;
+  const float target = stages->target;
+  int16_t tmp[CRAS_CH_MAX];
+  int non_empty = 0;
+  int silent;
+  unsigned int fr, ch, next_ewma_fr = 0;
+
+  if (mtx && num_channels > CRAS_CH_MAX) {
+    mtx = NULL;
+  }
+  // A ramp down that starts from silence is silence.
+  silent = scaler < MIN_VOLUME_TO_SCALE && increment < 0;
+
+  for (fr = 0; fr < nframes; fr++, buf += num_channels) {
+    if (stages->is_non_empty && !non_empty) {
+      for (ch = 0; ch < num_channels; ch++) {
+        non_empty |= buf[ch];
+      }
+    }
+
+    /* Follows ewma_power_calculate(), which cras_iodev passes the frame
+     * count as the sample count, so only the first nframes samples are
+     * sampled. Keep it that way so the power reading doesn't change. */
+    if (ewma && fr == next_ewma_fr && fr * num_channels < nframes) {
+      ewma_power_add_frame(ewma, buf, num_channels);
+      next_ewma_fr += ewma->step_fr ? ewma->step_fr : nframes;
+    }
+
+    if (stages->scale) {
+      float applied_scaler = scaler;
+
+      if ((applied_scaler > target && increment > 0) ||
+          (applied_scaler < target && increment < 0)) {
+        applied_scaler = target;
+      }
+      if (silent || applied_scaler < MIN_VOLUME_TO_SCALE) {
+        for (ch = 0; ch < num_channels; ch++) {
+          buf[ch] = 0;
+        }
+      } else if (applied_scaler <= MAX_VOLUME_TO_SCALE) {
+        for (ch = 0; ch < num_channels; ch++) {
+          buf[ch] *= applied_scaler;
+        }
+      }
+      scaler += increment;
+    }
+
+    if (mtx) {
+      for (ch = 0; ch < num_channels; ch++) {
+        tmp[ch] = s16_multiply_buf_with_coef(mtx[ch], buf, num_channels);
+      }
+      for (ch = 0; ch < num_channels; ch++) {
+        buf[ch] = tmp[ch];
+      }
+    }
+  }
+
+  if (stages->is_non_empty) {
+    *stages->is_non_empty = !!non_empty;
+  }
+}
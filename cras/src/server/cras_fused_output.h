@@ -0,0 +1,51 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Runs the cheap output post-processing stages in a single pass over an
+ * interleaved S16_LE period, instead of walking the buffer once per stage.
+ */
+#ifndef CRAS_SRC_SERVER_CRAS_FUSED_OUTPUT_H_
+#define CRAS_SRC_SERVER_CRAS_FUSED_OUTPUT_H_
+
+#include <stdint.h>
+
+struct ewma_power;
+
+/* The stages to run, in order. A stage is skipped when it is not set. */
+struct cras_fused_output {
+  // If not NULL, set to 1 if any input sample is non-zero, 0 otherwise.
+  int* is_non_empty;
+  // If not NULL and enabled, fed with the input samples.
+  struct ewma_power* ewma;
+  // Non-zero to scale samples. The scaler steps by increment every frame
+  // and is clipped at target, same as cras_scale_buffer_increment().
+  // Use an increment of zero for a constant software volume or mute.
+  int scale;
+  float scaler;
+  float increment;
+  float target;
+  // If not NULL, the channel remix matrix applied to the scaled frames.
+  float** remix_mtx;
+};
+
+/* Returns the number of stages in stages that would touch the buffer. */
+unsigned int cras_fused_output_num_stages(
+    const struct cras_fused_output* stages);
+
+/* Applies all set stages to buf. Results match running the stages one
+ * after another with the individual helpers.
+ * Args:
+ *    stages - The stages to run.
+ *    buf - Interleaved S16_LE samples, processed in place.
+ *    num_channels - Number of channels in buf.
+ *    nframes - Number of frames in buf.
+ */
+void cras_fused_output_apply_s16(const struct cras_fused_output* stages,
+                                 int16_t* buf,
+                                 unsigned int num_channels,
+                                 unsigned int nframes);
+
+#endif  // CRAS_SRC_SERVER_CRAS_FUSED_OUTPUT_H_
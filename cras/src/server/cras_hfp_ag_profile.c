@@ -60,6 +60,7 @@ struct audio_gateway {
 
 static struct audio_gateway* connected_ags;
 static struct packet_status_logger wbs_logger;
+static struct cras_sco_io_stats sco_io_stats;
 
 static bool is_sco_pcm_supported() {
   return (cras_iodev_list_get_sco_pcm_iodev(CRAS_STREAM_INPUT) ||
@@ -333,6 +334,7 @@ int cras_hfp_ag_start(struct cras_bt_device* device) {
                                      ag->sco, NULL);
   } else {
     cras_sco_set_wbs_logger(ag->sco, &wbs_logger);
+    cras_sco_set_io_stats(ag->sco, &sco_io_stats);
     ag->idev = hfp_iodev_create(CRAS_STREAM_INPUT, ag->device, ag->slc_handle,
                                 ag->sco);
     ag->odev = hfp_iodev_create(CRAS_STREAM_OUTPUT, ag->device, ag->slc_handle,
@@ -375,3 +377,7 @@ struct hfp_slc_handle* cras_hfp_ag_get_slc(struct cras_bt_device* device) {
 struct packet_status_logger* cras_hfp_ag_get_wbs_logger() {
   return &wbs_logger;
 }
+
+struct cras_sco_io_stats* cras_hfp_ag_get_sco_io_stats() {
+  return &sco_io_stats;
+}
@@ -56,4 +56,7 @@ struct hfp_slc_handle* cras_hfp_ag_get_slc(struct cras_bt_device* device);
 // Gets the logger for WBS packet status.
 struct packet_status_logger* cras_hfp_ag_get_wbs_logger();
 
+// Gets the stats of the SCO socket I/O.
+struct cras_sco_io_stats* cras_hfp_ag_get_sco_io_stats();
+
 #endif  // CRAS_SRC_SERVER_CRAS_HFP_AG_PROFILE_H_
@@ -23,6 +23,7 @@
 #include "cras/src/server/cras_dsp.h"
 #include "cras/src/server/cras_dsp_pipeline.h"
 #include "cras/src/server/cras_fmt_conv.h"
+#include "cras/src/server/cras_fused_output.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_main_thread_log.h"
 #include "cras/src/server/cras_mix.h"
@@ -385,23 +386,13 @@ static snd_pcm_format_t get_best_pcm_format(struct cras_iodev* iodev,
 // Applies the DSP to the samples for the iodev if applicable.
 static int apply_dsp(struct cras_iodev* iodev, uint8_t* buf, size_t frames) {
   struct cras_dsp_context* ctx;
-  struct pipeline* pipeline;
-  int rc;
 
   ctx = iodev->dsp_context;
   if (!ctx) {
     return 0;
   }
 
-  pipeline = cras_dsp_get_pipeline(ctx);
-  if (!pipeline) {
-    return 0;
-  }
-
-  rc = cras_dsp_pipeline_apply(pipeline, buf, iodev->format->format, frames);
-
-  cras_dsp_put_pipeline(ctx);
-  return rc;
+  return cras_dsp_apply(ctx, buf, iodev->format->format, frames);
 }
 
 static void cras_iodev_free_dsp(struct cras_iodev* iodev) {
@@ -548,8 +539,8 @@ static void add_ext_dsp_module_to_pipeline(struct cras_iodev* iodev) {
                                 iodev->format->num_channels);
     pipeline = cras_dsp_get_pipeline(iodev->dsp_context);
   }
-  /* dsp_context mutex locked. Now it's safe to modify dsp
-   * pipeline resources. */
+  /* The pipeline is pinned and the ext module is published to the audio
+   * thread only after its ports are set up. */
 
   if (iodev->ext_dsp_module) {
     iodev->ext_dsp_module->configure(iodev->ext_dsp_module, iodev->buffer_size,
@@ -559,7 +550,6 @@ static void add_ext_dsp_module_to_pipeline(struct cras_iodev* iodev) {
 
   cras_dsp_pipeline_set_sink_ext_module(pipeline, iodev->ext_dsp_module);
 
-  // Unlock dsp_context mutex.
   cras_dsp_put_pipeline(iodev->dsp_context);
 }
 
@@ -577,12 +567,12 @@ static void release_ext_dsp_module_from_pipeline(struct cras_iodev* iodev) {
   if (pipeline == NULL) {
     return;
   }
-  // dsp_context mutex locked.
-
   cras_dsp_pipeline_set_sink_ext_module(pipeline, NULL);
 
-  // Unlock dsp_context mutex.
   cras_dsp_put_pipeline(iodev->dsp_context);
+
+  // Make sure the audio thread is no longer running the ext module.
+  cras_dsp_synchronize(iodev->dsp_context);
 }
 
 void cras_iodev_set_ext_dsp_module(struct cras_iodev* iodev,
@@ -1167,25 +1157,69 @@ int cras_iodev_put_input_buffer(struct cras_iodev* iodev) {
   return min_frames;
 }
 
-int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
-                                 uint8_t* frames,
-                                 unsigned int nframes,
-                                 int* is_non_empty,
-                                 struct cras_fmt_conv* remix_converter) {
-  const struct cras_audio_format* fmt = iodev->format;
-  struct cras_ramp_action ramp_action = {
-      .type = CRAS_RAMP_ACTION_NONE,
-      .scaler = 0.0f,
-      .increment = 0.0f,
-      .target = 1.0f,
-  };
-  float software_volume_scaler = 1.0;
-  int software_volume_needed = cras_iodev_software_volume_needed(iodev);
-  int rc;
+/* Returns true if any loopback reads the buffer after DSP. */
+static bool has_post_dsp_loopback(const struct cras_iodev* odev) {
   struct cras_loopback* loopback;
 
+  DL_FOREACH (odev->loopbacks, loopback) {
+    if ((loopback->type == LOOPBACK_POST_DSP) ||
+        (loopback->type == LOOPBACK_POST_DSP_DELAYED)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Sets up the scale stage for ramp, mute and software volume. */
+static void set_output_scale(struct cras_iodev* odev,
+                             const struct cras_ramp_action* ramp_action,
+                             struct cras_fused_output* stages) {
+  int software_volume_needed = cras_iodev_software_volume_needed(odev);
+  float software_volume_scaler = 1.0;
+
+  // Compute scaler for software volume if needed.
+  if (software_volume_needed) {
+    software_volume_scaler = cras_iodev_get_software_volume_scaler(odev);
+  }
+
+  if (ramp_action->type == CRAS_RAMP_ACTION_PARTIAL) {
+    // Scale with increment for ramp and possibly software volume.
+    stages->scale = 1;
+    stages->scaler = ramp_action->scaler * software_volume_scaler;
+    stages->increment = ramp_action->increment * software_volume_scaler;
+    stages->target = ramp_action->target * software_volume_scaler;
+  } else if (output_should_mute(odev)) {
+    /* Mute samples if adjusted volume is 0 or system is muted, plus
+     * that this device is not ramping. */
+    stages->scale = 1;
+  } else if (software_volume_needed) {
+    // Just scale for software volume.
+    stages->scale = 1;
+    stages->scaler = software_volume_scaler;
+    stages->target = software_volume_scaler;
+  }
+}
+
+/* Runs stages over frames. When more than one stage is active on an S16
+ * buffer they share a single pass, otherwise each stage uses its own
+ * helper. */
+static void run_output_stages(struct cras_iodev* odev,
+                              const struct cras_fused_output* stages,
+                              bool ramping,
+                              struct cras_fmt_conv* remix_converter,
+                              uint8_t* frames,
+                              unsigned int nframes) {
+  const struct cras_audio_format* fmt = odev->format;
+
+  if (fmt->format == SND_PCM_FORMAT_S16_LE &&
+      cras_fused_output_num_stages(stages) > 1) {
+    cras_fused_output_apply_s16(stages, (int16_t*)frames, fmt->num_channels,
+                                nframes);
+    return;
+  }
+
   // Calculate whether the final output was non-empty, if requested.
-  if (is_non_empty) {
+  if (stages->is_non_empty) {
     const size_t bytes = nframes * cras_get_format_bytes(fmt);
 
     /*
@@ -1194,27 +1228,57 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
      *  - frames[0] is 0.
      *  - frames[i] == frames[i+1] for i in [0, 1, ..., bytes - 2].
      */
-    *is_non_empty =
+    *stages->is_non_empty =
         bytes ? (*frames || memcmp(frames, frames + 1, bytes - 1)) : 0;
   }
 
-  DL_FOREACH (iodev->loopbacks, loopback) {
-    if (loopback->type == LOOPBACK_POST_MIX_PRE_DSP) {
-      loopback->hook_data(frames, nframes, iodev->format, loopback->cb_data);
-    }
+  if (stages->ewma) {
+    ewma_power_calculate(stages->ewma, (int16_t*)frames, fmt->num_channels,
+                         nframes);
   }
 
-  ewma_power_calculate(&iodev->ewma, (int16_t*)frames,
-                       iodev->format->num_channels, nframes);
+  if (stages->scale) {
+    if (ramping) {
+      cras_scale_buffer_increment(fmt->format, frames, nframes,
+                                  stages->scaler, stages->increment,
+                                  stages->target, fmt->num_channels);
+    } else if (stages->scaler == 0.0f) {
+      const unsigned int frame_bytes = cras_get_format_bytes(fmt);
+      cras_mix_mute_buffer(frames, frame_bytes, nframes);
+    } else {
+      unsigned int nsamples = nframes * fmt->num_channels;
+      cras_scale_buffer(fmt->format, frames, nsamples, stages->scaler);
+    }
+  }
 
-  rc = apply_dsp(iodev, frames, nframes);
-  if (rc) {
-    return rc;
+  if (stages->remix_mtx) {
+    cras_channel_remix_convert(remix_converter, fmt, frames, nframes);
   }
+}
 
+int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
+                                 uint8_t* frames,
+                                 unsigned int nframes,
+                                 int* is_non_empty,
+                                 struct cras_fmt_conv* remix_converter) {
+  struct cras_ramp_action ramp_action = {
+      .type = CRAS_RAMP_ACTION_NONE,
+      .scaler = 0.0f,
+      .increment = 0.0f,
+      .target = 1.0f,
+  };
+  struct cras_fused_output pre_dsp = {
+      .is_non_empty = is_non_empty,
+      .ewma = &iodev->ewma,
+  };
+  struct cras_fused_output post_dsp = {};
+  bool ramping;
+  int rc;
+  struct cras_loopback* loopback;
+
+  // Loopbacks only read the buffer, so they can run before the stages.
   DL_FOREACH (iodev->loopbacks, loopback) {
-    if ((loopback->type == LOOPBACK_POST_DSP) ||
-        (loopback->type == LOOPBACK_POST_DSP_DELAYED)) {
+    if (loopback->type == LOOPBACK_POST_MIX_PRE_DSP) {
       loopback->hook_data(frames, nframes, iodev->format, loopback->cb_data);
     }
   }
@@ -1222,45 +1286,45 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
   if (iodev->ramp) {
     ramp_action = cras_ramp_get_current_action(iodev->ramp);
   }
+  ramping = ramp_action.type == CRAS_RAMP_ACTION_PARTIAL;
+  set_output_scale(iodev, &ramp_action, &post_dsp);
+  if (remix_converter) {
+    post_dsp.remix_mtx =
+        cras_channel_remix_matrix(remix_converter, iodev->format);
+  }
+
+  /* Without DSP or a loopback in between, the stages before and after DSP
+   * are all done in one pass over the period. */
+  if (!iodev->dsp_context && !has_post_dsp_loopback(iodev)) {
+    pre_dsp.scale = post_dsp.scale;
+    pre_dsp.scaler = post_dsp.scaler;
+    pre_dsp.increment = post_dsp.increment;
+    pre_dsp.target = post_dsp.target;
+    pre_dsp.remix_mtx = post_dsp.remix_mtx;
+    run_output_stages(iodev, &pre_dsp, ramping, remix_converter, frames,
+                      nframes);
+  } else {
+    run_output_stages(iodev, &pre_dsp, ramping, remix_converter, frames,
+                      nframes);
 
-  /* Mute samples if adjusted volume is 0 or system is muted, plus
-   * that this device is not ramping. */
-  if (output_should_mute(iodev) &&
-      ramp_action.type != CRAS_RAMP_ACTION_PARTIAL) {
-    const unsigned int frame_bytes = cras_get_format_bytes(fmt);
-    cras_mix_mute_buffer(frames, frame_bytes, nframes);
-  }
-
-  // Compute scaler for software volume if needed.
-  if (software_volume_needed) {
-    software_volume_scaler = cras_iodev_get_software_volume_scaler(iodev);
-  }
-
-  if (ramp_action.type == CRAS_RAMP_ACTION_PARTIAL) {
-    /* Scale with increment for ramp and possibly
-     * software volume using cras_scale_buffer_increment.*/
-    float starting_scaler = ramp_action.scaler;
-    float increment = ramp_action.increment;
-    float target = ramp_action.target;
+    rc = apply_dsp(iodev, frames, nframes);
+    if (rc) {
+      return rc;
+    }
 
-    if (software_volume_needed) {
-      starting_scaler *= software_volume_scaler;
-      increment *= software_volume_scaler;
-      target *= software_volume_scaler;
+    DL_FOREACH (iodev->loopbacks, loopback) {
+      if ((loopback->type == LOOPBACK_POST_DSP) ||
+          (loopback->type == LOOPBACK_POST_DSP_DELAYED)) {
+        loopback->hook_data(frames, nframes, iodev->format, loopback->cb_data);
+      }
     }
 
-    cras_scale_buffer_increment(fmt->format, frames, nframes, starting_scaler,
-                                increment, target, fmt->num_channels);
-    cras_ramp_update_ramped_frames(iodev->ramp, nframes);
-  } else if (!output_should_mute(iodev) && software_volume_needed) {
-    /* Just scale for software volume using
-     * cras_scale_buffer. */
-    unsigned int nsamples = nframes * fmt->num_channels;
-    cras_scale_buffer(fmt->format, frames, nsamples, software_volume_scaler);
+    run_output_stages(iodev, &post_dsp, ramping, remix_converter, frames,
+                      nframes);
   }
 
-  if (remix_converter) {
-    cras_channel_remix_convert(remix_converter, iodev->format, frames, nframes);
+  if (ramping) {
+    cras_ramp_update_ramped_frames(iodev->ramp, nframes);
   }
   if (iodev->rate_est) {
     rate_estimator_add_frames(iodev->rate_est, nframes);
@@ -89,6 +89,15 @@ enum CRAS_IODEV_STATE {
   CRAS_IODEV_STATE_NO_STREAM_RUN = 3,
 };
 
+/* Clock domains of an iodev, used to pick the audio thread servicing it.
+ * Devices in the primary domain always run on the primary audio thread,
+ * devices of any domain can be moved to whichever thread runs their streams.
+ * Positive values group devices sharing a clock, e.g. the PCMs of one card,
+ * which are kept on the same audio worker thread.
+ */
+#define CRAS_IODEV_CLOCK_DOMAIN_ANY (-1)
+#define CRAS_IODEV_CLOCK_DOMAIN_PRIMARY 0
+
 /* Holds an output/input node for this device.  An ionode is a control that
  * can be switched on and off such as headphones or speakers.
  */
@@ -283,8 +292,14 @@ struct cras_iodev {
   struct cras_iodev* echo_reference_dev;
   // True if this iodev is enabled, false otherwise.
   int is_enabled;
+  // The clock domain of this iodev, see CRAS_IODEV_CLOCK_DOMAIN_*.
+  int clock_domain;
   // True if volume control is not supported by hardware.
   int software_volume_needed;
+  // True if stream format conversion for this device should keep samples in
+  // float instead of S16, so no precision is lost on devices or streams
+  // wider than 16 bits.
+  int high_res_conversion;
   // Scaler value to apply to captured data. This can
   // be different when active node changes. Configured when there's no
   // hardware gain control.
@@ -742,7 +742,9 @@ static void suspend_devs() {
         }
       }
     } else {
-      audio_thread_disconnect_stream(audio_thread, rstream, NULL);
+      /* Closing the devices below waits for the queued disconnects. */
+      audio_thread_disconnect_stream_async(audio_thread, rstream, NULL, NULL,
+                                           NULL);
     }
   }
   stream_list_suspended = 1;
@@ -872,22 +874,37 @@ static void possibly_enable_fallback(enum CRAS_STREAM_DIRECTION dir,
 }
 
 /*
- * Adds stream to one or more open iodevs. If the stream has processing effect
- * turned on, create new APM instance and add to the list. This makes sure the
- * time consuming APM creation happens in main thread.
+ * If the stream has processing effect turned on, create new APM instance
+ * for each iodev and add to the list. This makes sure the time consuming APM
+ * creation happens in main thread.
  */
-static int add_stream_to_open_devs(struct cras_rstream* stream,
-                                   struct cras_iodev** iodevs,
-                                   unsigned int num_iodevs) {
+static void add_stream_apms(struct cras_rstream* stream,
+                            struct cras_iodev** iodevs,
+                            unsigned int num_iodevs) {
   int i;
   if (stream->stream_apm) {
     for (i = 0; i < num_iodevs; i++) {
       cras_stream_apm_add(stream->stream_apm, iodevs[i], iodevs[i]->format);
     }
   }
+}
+
+// Adds stream to one or more open iodevs.
+static int add_stream_to_open_devs(struct cras_rstream* stream,
+                                   struct cras_iodev** iodevs,
+                                   unsigned int num_iodevs) {
+  add_stream_apms(stream, iodevs, num_iodevs);
   return audio_thread_add_stream(audio_thread, stream, iodevs, num_iodevs);
 }
 
+// Logs streams which failed to attach while queued to the audio thread.
+static void attach_stream_done(void* data, int rc) {
+  if (rc < 0) {
+    syslog(LOG_WARNING, "Failed to attach stream %x, rc = %d",
+           (cras_stream_id_t)(uintptr_t)data, rc);
+  }
+}
+
 static int init_and_attach_streams(struct cras_iodev* dev) {
   int rc;
   enum CRAS_STREAM_DIRECTION dir = dev->direction;
@@ -943,7 +960,12 @@ static int init_and_attach_streams(struct cras_iodev* dev) {
       syslog(LOG_WARNING, "Enable %s failed, rc = %d", dev->info.name, rc);
       return rc;
     }
-    add_stream_to_open_devs(stream, &dev, 1);
+    /* Queue the streams to the audio thread without waiting for each,
+     * so attaching many streams to a newly opened device is cheap. */
+    add_stream_apms(stream, &dev, 1);
+    audio_thread_add_stream_async(audio_thread, stream, &dev, 1,
+                                  attach_stream_done,
+                                  (void*)(uintptr_t)stream->stream_id);
   }
   return 0;
 }
@@ -1362,7 +1384,8 @@ static int disable_device(struct enabled_dev* edev, bool force) {
       if (stream->is_pinned) {
         continue;
       }
-      audio_thread_disconnect_stream(audio_thread, stream, dev);
+      audio_thread_disconnect_stream_async(audio_thread, stream, dev, NULL,
+                                           NULL);
     }
     return 0;
   }
@@ -1425,6 +1448,10 @@ void cras_iodev_list_init() {
     exit(-ENOMEM);
   }
   audio_thread_start(audio_thread);
+  if (audio_thread_add_workers(audio_thread,
+                               cras_system_get_audio_thread_workers())) {
+    syslog(LOG_ERR, "Failed to start audio worker threads");
+  }
 
   cras_iodev_list_update_device_list();
 }
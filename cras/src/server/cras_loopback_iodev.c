@@ -3,11 +3,10 @@
  * found in the LICENSE file.
  */
 
-#include <pthread.h>
+#include <sched.h>
 #include <sys/param.h>
 #include <syslog.h>
 
-#include "cras/src/common/byte_buffer.h"
 #include "cras/src/server/audio_thread_log.h"
 #include "cras/src/server/cras_audio_area.h"
 #include "cras/src/server/cras_iodev.h"
@@ -20,6 +19,8 @@
 #include "third_party/utlist/utlist.h"
 
 #define LOOPBACK_BUFFER_SIZE 8192
+// Size of the sample ring, a power of two so the positions can wrap.
+#define LOOPBACK_RING_BYTES (LOOPBACK_BUFFER_SIZE * 4)
 
 static const char* loopdev_names[LOOPBACK_NUM_TYPES] = {
     "Post Mix Pre DSP Loopback",
@@ -47,18 +48,70 @@ struct loopback_iodev {
   bool started;
   // The timestamp of the last call to configure_dev.
   struct timespec dev_start_time;
-  // Pointer to sample buffer.
-  struct byte_buffer* sample_buffer;
+  /* Sample ring, written by the sender which may run on another audio
+   * thread. |write_pos| and |read_pos| are free running byte counts, each
+   * advanced by one side only, so neither side takes a lock. */
+  uint8_t* samples;
+  unsigned int write_pos;
+  unsigned int read_pos;
+  // Claimed by the side appending to |samples|, see ring_write().
+  int writing;
   // Index of the output device to read loopback audio.
   unsigned int sender_idx;
 };
 
 static int sample_hook_start(bool start, void* cb_data) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)cb_data;
-  loopdev->started = start;
+  __atomic_store_n(&loopdev->started, start, __ATOMIC_RELEASE);
   return 0;
 }
 
+static unsigned int ring_queued(struct loopback_iodev* loopdev) {
+  return __atomic_load_n(&loopdev->write_pos, __ATOMIC_ACQUIRE) -
+         loopdev->read_pos;
+}
+
+/*
+ * Appends up to |nframes| frames of |data|, or of silence when |data| is
+ * NULL, to the free part of the ring. Besides the sender, frames_queued()
+ * fills silence while the sender is stopped and a replaced sender may
+ * still be in its hook. Whoever finds |writing| claimed skips the append
+ * instead of waiting.
+ *
+ * Returns:
+ *   Number of frames appended.
+ */
+static unsigned int ring_write(struct loopback_iodev* loopdev,
+                               const uint8_t* data,
+                               unsigned int nframes,
+                               unsigned int frame_bytes) {
+  unsigned int wpos, free_bytes, bytes, offset, n;
+
+  if (__atomic_exchange_n(&loopdev->writing, 1, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+
+  wpos = __atomic_load_n(&loopdev->write_pos, __ATOMIC_RELAXED);
+  free_bytes = LOOPBACK_RING_BYTES -
+               (wpos - __atomic_load_n(&loopdev->read_pos, __ATOMIC_ACQUIRE));
+  nframes = MIN(free_bytes / frame_bytes, nframes);
+  for (bytes = nframes * frame_bytes; bytes; bytes -= n) {
+    offset = wpos % LOOPBACK_RING_BYTES;
+    n = MIN(bytes, LOOPBACK_RING_BYTES - offset);
+    if (data) {
+      memcpy(loopdev->samples + offset, data, n);
+      data += n;
+    } else {
+      memset(loopdev->samples + offset, 0, n);
+    }
+    wpos += n;
+  }
+
+  __atomic_store_n(&loopdev->write_pos, wpos, __ATOMIC_RELEASE);
+  __atomic_store_n(&loopdev->writing, 0, __ATOMIC_RELEASE);
+  return nframes;
+}
+
 /*
  * Called in the put buffer function of the sender that hooked to.
  *
@@ -70,27 +123,12 @@ static int sample_hook(const uint8_t* frames,
                        const struct cras_audio_format* fmt,
                        void* cb_data) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)cb_data;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
-  unsigned int frame_bytes = cras_get_format_bytes(fmt);
-  unsigned int frames_to_copy, bytes_to_copy, frames_copied = 0;
-  int i;
-
-  for (i = 0; i < 2; i++) {
-    frames_to_copy = MIN(buf_writable(sbuf) / frame_bytes, nframes);
-    if (!frames_to_copy) {
-      break;
-    }
+  unsigned int frames_copied;
 
-    bytes_to_copy = frames_to_copy * frame_bytes;
-    memcpy(buf_write_pointer(sbuf), frames, bytes_to_copy);
-    buf_increment_write(sbuf, bytes_to_copy);
-    frames += bytes_to_copy;
-    nframes -= frames_to_copy;
-    frames_copied += frames_to_copy;
-  }
+  frames_copied =
+      ring_write(loopdev, frames, nframes, cras_get_format_bytes(fmt));
 
-  ATLOG(atlog, AUDIO_THREAD_LOOPBACK_SAMPLE_HOOK, nframes + frames_copied,
-        frames_copied, 0);
+  ATLOG(atlog, AUDIO_THREAD_LOOPBACK_SAMPLE_HOOK, nframes, frames_copied, 0);
 
   return frames_copied;
 }
@@ -138,7 +176,6 @@ static void device_disabled_hook(struct cras_iodev* iodev, void* cb_data) {
 static int frames_queued(const struct cras_iodev* iodev,
                          struct timespec* hw_tstamp) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)iodev;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
   unsigned int frame_bytes = cras_get_format_bytes(iodev->format);
 
   /* Do nothing in the transient period after iodev is open but
@@ -150,23 +187,19 @@ static int frames_queued(const struct cras_iodev* iodev,
     return 0;
   }
 
-  if (!loopdev->started) {
-    unsigned int frames_since_start, frames_to_fill, bytes_to_fill;
+  if (!__atomic_load_n(&loopdev->started, __ATOMIC_ACQUIRE)) {
+    unsigned int frames_since_start, frames_to_fill;
 
     frames_since_start = cras_frames_since_time(&loopdev->dev_start_time,
                                                 iodev->format->frame_rate);
     frames_to_fill = frames_since_start > loopdev->read_frames
                          ? frames_since_start - loopdev->read_frames
                          : 0;
-    frames_to_fill = MIN(buf_writable(sbuf) / frame_bytes, frames_to_fill);
-    if (frames_to_fill > 0) {
-      bytes_to_fill = frames_to_fill * frame_bytes;
-      memset(buf_write_pointer(sbuf), 0, bytes_to_fill);
-      buf_increment_write(sbuf, bytes_to_fill);
-    }
+    ring_write(loopdev, NULL, frames_to_fill, frame_bytes);
   }
+
   clock_gettime(CLOCK_MONOTONIC_RAW, hw_tstamp);
-  return buf_queued(sbuf) / frame_bytes;
+  return ring_queued(loopdev) / frame_bytes;
 }
 
 static int delay_frames(const struct cras_iodev* iodev) {
@@ -177,11 +210,9 @@ static int delay_frames(const struct cras_iodev* iodev) {
 
 static int close_record_dev(struct cras_iodev* iodev) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)iodev;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
 
   cras_iodev_free_format(iodev);
   cras_iodev_free_audio_area(iodev);
-  buf_reset(sbuf);
 
   cras_iodev_list_unregister_loopback(
       loopdev->loopback_type, loopdev->sender_idx, loopdev->base.info.idx);
@@ -194,12 +225,27 @@ static int close_record_dev(struct cras_iodev* iodev) {
 static int configure_record_dev(struct cras_iodev* iodev) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)iodev;
   struct cras_iodev* edev;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
+  unsigned int prefill = 0;
 
   cras_iodev_init_audio_area(iodev, iodev->format->num_channels);
   clock_gettime(CLOCK_MONOTONIC_RAW, &loopdev->dev_start_time);
   loopdev->read_frames = 0;
-  loopdev->started = 0;
+  __atomic_store_n(&loopdev->started, 0, __ATOMIC_RELEASE);
+
+  /* The sender of the last run may still be in its hook. Wait for it on
+   * this main thread so the audio threads never have to. */
+  while (__atomic_exchange_n(&loopdev->writing, 1, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+  /* Fills the ring by zeros to simulate the delay caused by real
+   * hardware. */
+  if (loopdev->loopback_type == LOOPBACK_POST_DSP_DELAYED) {
+    memset(loopdev->samples, 0, LOOPBACK_RING_BYTES);
+    prefill = LOOPBACK_RING_BYTES;
+  }
+  __atomic_store_n(&loopdev->read_pos, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&loopdev->write_pos, prefill, __ATOMIC_RELEASE);
+  __atomic_store_n(&loopdev->writing, 0, __ATOMIC_RELEASE);
 
   edev = cras_iodev_list_get_first_enabled_iodev(CRAS_STREAM_OUTPUT);
   if (edev) {
@@ -211,13 +257,6 @@ static int configure_record_dev(struct cras_iodev* iodev) {
   cras_iodev_list_set_device_enabled_callback(
       device_enabled_hook, device_disabled_hook, NULL, (void*)iodev);
 
-  /* Fills the sample_buffer by zeros to simulate the delay caused
-   * by real hardware. */
-  if (loopdev->loopback_type == LOOPBACK_POST_DSP_DELAYED) {
-    memset(buf_write_pointer(sbuf), 0, buf_writable(sbuf));
-    buf_increment_write(sbuf, buf_writable(sbuf));
-  }
-
   return 0;
 }
 
@@ -225,16 +264,21 @@ static int get_record_buffer(struct cras_iodev* iodev,
                              struct cras_audio_area** area,
                              unsigned* frames) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)iodev;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
   unsigned int frame_bytes = cras_get_format_bytes(iodev->format);
-  unsigned int avail_frames = buf_readable(sbuf) / frame_bytes;
+  unsigned int offset = loopdev->read_pos % LOOPBACK_RING_BYTES;
+  unsigned int queued = ring_queued(loopdev);
+  unsigned int avail_frames;
+
+  /* The sender only writes to the free part of the ring, the frames
+   * returned here stay valid until put_record_buffer(). */
+  avail_frames = MIN(queued, LOOPBACK_RING_BYTES - offset) / frame_bytes;
 
   ATLOG(atlog, AUDIO_THREAD_LOOPBACK_GET, *frames, avail_frames, 0);
 
   *frames = MIN(avail_frames, *frames);
   iodev->area->frames = *frames;
   cras_audio_area_config_buf_pointers(iodev->area, iodev->format,
-                                      buf_read_pointer(sbuf));
+                                      loopdev->samples + offset);
   *area = iodev->area;
 
   return 0;
@@ -242,10 +286,12 @@ static int get_record_buffer(struct cras_iodev* iodev,
 
 static int put_record_buffer(struct cras_iodev* iodev, unsigned nframes) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)iodev;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
   unsigned int frame_bytes = cras_get_format_bytes(iodev->format);
+  unsigned int queued = ring_queued(loopdev);
+  unsigned int bytes = MIN(nframes * frame_bytes, queued);
 
-  buf_increment_read(sbuf, (size_t)nframes * (size_t)frame_bytes);
+  __atomic_store_n(&loopdev->read_pos, loopdev->read_pos + bytes,
+                   __ATOMIC_RELEASE);
   loopdev->read_frames += nframes;
   ATLOG(atlog, AUDIO_THREAD_LOOPBACK_PUT, nframes, 0, 0);
   return 0;
@@ -287,8 +333,8 @@ static struct cras_iodev* create_loopback_iodev(enum CRAS_LOOPBACK_TYPE type) {
     return NULL;
   }
 
-  loopback_iodev->sample_buffer = byte_buffer_create(LOOPBACK_BUFFER_SIZE * 4);
-  if (loopback_iodev->sample_buffer == NULL) {
+  loopback_iodev->samples = calloc(1, LOOPBACK_RING_BYTES);
+  if (loopback_iodev->samples == NULL) {
     free(loopback_iodev);
     return NULL;
   }
@@ -375,11 +421,10 @@ struct cras_iodev* loopback_iodev_create(enum CRAS_LOOPBACK_TYPE type) {
 
 void loopback_iodev_destroy(struct cras_iodev* iodev) {
   struct loopback_iodev* loopdev = (struct loopback_iodev*)iodev;
-  struct byte_buffer* sbuf = loopdev->sample_buffer;
 
   cras_iodev_list_rm_input(iodev);
   free(iodev->nodes);
 
-  byte_buffer_destroy(&sbuf);
+  free(loopdev->samples);
   free(loopdev);
 }
@@ -17,6 +17,7 @@ enum CRAS_MAIN_MESSAGE_TYPE {
   CRAS_MAIN_AUDIO_THREAD_EVENT,
   CRAS_MAIN_BT,
   CRAS_MAIN_BT_POLICY,
+  CRAS_MAIN_DSP,
   CRAS_MAIN_METRICS,
   CRAS_MAIN_MONITOR_DEVICE,
   CRAS_MAIN_HOTWORD_TRIGGERED,
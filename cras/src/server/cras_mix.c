@@ -6,6 +6,9 @@
 #include "cras/src/server/cras_mix.h"
 
 #include <stdint.h>
+#if defined(__aarch64__) || defined(__arm__)
+#include <sys/auxv.h>
+#endif
 
 #include "cras/src/server/cras_mix_ops.h"
 #include "cras/src/server/cras_system_state.h"
@@ -35,6 +38,17 @@ static const struct cras_mix_ops* get_mixer_ops(unsigned int cpu_flags) {
   }
 #endif
 
+#if HAVE_SVE
+  if (cpu_flags & CPU_ARM_SVE) {
+    return &mixer_ops_sve;
+  }
+#endif
+#if HAVE_NEON
+  if (cpu_flags & CPU_ARM_NEON) {
+    return &mixer_ops_neon;
+  }
+#endif
+
   // default C implementation
   return &mixer_ops;
 }
@@ -131,9 +145,37 @@ static unsigned int cpu_x86_flags(void) {
 }
 #endif
 
+#if defined(__aarch64__)
+// Bits of AT_HWCAP, from the kernel's arch/arm64/include/uapi/asm/hwcap.h.
+#define ARM_HWCAP_ASIMD (1 << 1)
+#define ARM_HWCAP_SVE (1 << 22)
+
+static unsigned int cpu_arm_flags(void) {
+  unsigned long hwcap = getauxval(AT_HWCAP);
+  unsigned int cpu_flags = 0;
+
+  if (hwcap & ARM_HWCAP_ASIMD) {
+    cpu_flags |= CPU_ARM_NEON;
+  }
+  if (hwcap & ARM_HWCAP_SVE) {
+    cpu_flags |= CPU_ARM_SVE;
+  }
+  return cpu_flags;
+}
+#elif defined(__arm__)
+// Bit of AT_HWCAP, from the kernel's arch/arm/include/uapi/asm/hwcap.h.
+#define ARM_HWCAP_NEON (1 << 12)
+
+static unsigned int cpu_arm_flags(void) {
+  return (getauxval(AT_HWCAP) & ARM_HWCAP_NEON) ? CPU_ARM_NEON : 0;
+}
+#endif
+
 int cpu_get_flags() {
 #if defined(__amd64__)
   return cpu_x86_flags();
+#elif defined(__aarch64__) || defined(__arm__)
+  return cpu_arm_flags();
 #endif
   return 0;
 }
@@ -142,6 +184,14 @@ void cras_mix_init() {
   ops = get_mixer_ops(cpu_get_flags());
 }
 
+void cras_mix_init_with_flags(unsigned int cpu_flags) {
+  unsigned int supported = cpu_get_flags();
+
+  // Keep the quirk bits of the running CPU whatever the caller asks for.
+  ops = get_mixer_ops((cpu_flags & supported) |
+                      (supported & CPU_X86_FMA_CRASH));
+}
+
 /*
  * Exported Interface
  */
@@ -16,9 +16,19 @@ struct cras_audio_shm;
 #define CPU_X86_AVX2 4
 #define CPU_X86_FMA 8
 #define CPU_X86_FMA_CRASH 16
+#define CPU_ARM_NEON 32
+#define CPU_ARM_SVE 64
+
+// Returns the CPU_* flags of the running CPU.
+int cpu_get_flags();
 
 void cras_mix_init();
 
+/* Selects the mixer ops for cpu_flags, restricted to the features the
+ * running CPU has. Lets tests and benchmarks compare the variants, pass 0
+ * for the portable C implementation. */
+void cras_mix_init_with_flags(unsigned int cpu_flags);
+
 /* Scale the given buffer with the provided scaler and increment.
  * Args:
  *    fmt - The format (SND_PCM_FORMAT_*)
@@ -21,6 +21,10 @@
 #define OPS(a) a##_avx2
 #elif defined(OPS_FMA)
 #define OPS(a) a##_fma
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#elif defined(OPS_SVE)
+#define OPS(a) a##_sve
 #else
 #define OPS(a) a
 #endif
@@ -15,6 +15,8 @@ extern const struct cras_mix_ops mixer_ops_sse42;
 extern const struct cras_mix_ops mixer_ops_avx;
 extern const struct cras_mix_ops mixer_ops_avx2;
 extern const struct cras_mix_ops mixer_ops_fma;
+extern const struct cras_mix_ops mixer_ops_neon;
+extern const struct cras_mix_ops mixer_ops_sve;
 
 /* Struct containing ops to implement mix/scale on a buffer of samples.
  * Different architecture can provide different implementations and wraps
@@ -145,7 +145,8 @@ int rclient_handle_client_stream_connect(struct cras_rclient* client,
   struct cras_rstream_config stream_config;
   int rc, header_fd, samples_fd;
   size_t samples_size;
-  int stream_fds[2];
+  int stream_fds[4];
+  unsigned int num_stream_fds = 2;
 
   rc = rclient_validate_stream_connect_params(client, msg, aud_fd,
                                               client_shm_fd);
@@ -226,8 +227,15 @@ int rclient_handle_client_stream_connect(struct cras_rclient* client,
   /* If we're using client-provided shm, samples_fd here refers to the
    * same shm area as client_shm_fd */
   stream_fds[1] = samples_fd;
+  /* Streams asking for EVENTFD_WAKEUPS also get the eventfds, unless the
+   * stream fell back to the audio socket. */
+  if (cras_rstream_get_wakeup_fds(stream, &stream_fds[2], &stream_fds[3]) ==
+      0) {
+    num_stream_fds = 4;
+  }
 
-  rc = client->ops->send_message_to_client(client, reply, stream_fds, 2);
+  rc = client->ops->send_message_to_client(client, reply, stream_fds,
+                                           num_stream_fds);
   if (rc < 0) {
     syslog(LOG_WARNING, "Failed to send connected messaged\n");
     stream_list_rm(cras_iodev_list_get_stream_list(), stream->stream_id);
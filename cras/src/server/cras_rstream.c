@@ -7,6 +7,7 @@
 
 #include <fcntl.h>
 #include <stdint.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <syslog.h>
@@ -25,6 +26,24 @@ static bool cras_rstream_config_is_client_shm_stream(
   return config && config->client_shm_fd >= 0 && config->client_shm_size > 0;
 }
 
+/* Gets the size in frames of the samples ring for a stream asking for
+ * SHM_RING_BUFFER, or 0 if the stream keeps the double buffer. Client-provided
+ * shm comes with double buffer offsets, so it can't be a ring. */
+static uint32_t shm_ring_frames(const struct cras_rstream* stream,
+                                const struct cras_rstream_config* config) {
+  uint32_t ring_frames = 1;
+
+  if (!(stream->flags & SHM_RING_BUFFER) ||
+      stream->direction != CRAS_STREAM_OUTPUT ||
+      cras_rstream_config_is_client_shm_stream(config)) {
+    return 0;
+  }
+  while (ring_frames < stream->buffer_frames) {
+    ring_frames <<= 1;
+  }
+  return ring_frames;
+}
+
 /* Setup the shared memory area used for audio samples. config->client_shm_fd
  * must be closed after calling this function.
  */
@@ -35,6 +54,7 @@ static inline int setup_shm_area(struct cras_rstream* stream,
   char samples_name[NAME_MAX];
   struct cras_shm_info header_info, samples_info;
   uint32_t frame_bytes, used_size;
+  uint32_t ring_frames = shm_ring_frames(stream, config);
   int rc;
   bool client_shm_stream = cras_rstream_config_is_client_shm_stream(config);
 
@@ -62,7 +82,9 @@ static inline int setup_shm_area(struct cras_rstream* stream,
     snprintf(samples_name, sizeof(samples_name), "/cras-%d-stream-%08x-samples",
              getpid(), stream->stream_id);
     rc = cras_shm_info_init(samples_name,
-                            cras_shm_calculate_samples_size(used_size),
+                            ring_frames
+                                ? ring_frames * frame_bytes
+                                : cras_shm_calculate_samples_size(used_size),
                             &samples_info);
   }
   if (rc) {
@@ -85,6 +107,7 @@ static inline int setup_shm_area(struct cras_rstream* stream,
 
   cras_shm_set_frame_bytes(stream->shm, frame_bytes);
   cras_shm_set_used_size(stream->shm, used_size);
+  cras_shm_set_ring_frames(stream->shm, ring_frames);
   if (client_shm_stream) {
     for (int i = 0; i < 2; i++) {
       cras_shm_set_buffer_offset(stream->shm, i, config->buffer_offsets[i]);
@@ -219,6 +242,29 @@ static int get_audio_request_reply(const struct cras_rstream* stream,
   return rc;
 }
 
+/*
+ * Reads one reply signaled through the reply eventfd of a stream using
+ * EVENTFD_WAKEUPS. The error of the reply is taken from shm.
+ * Returns:
+ *   Number of bytes read from the eventfd, 0 if there is no reply.
+ *   A negative error code if read fails or the client reported an error.
+ */
+static int read_and_handle_client_event(struct cras_rstream* stream) {
+  uint64_t event;
+  int rc;
+
+  rc = read(stream->reply_fd, &event, sizeof(event));
+  if (rc < 0) {
+    return errno == EAGAIN ? 0 : -errno;
+  }
+
+  clear_pending_reply(stream);
+  if (cras_shm_get_reply_error(stream->shm) < 0) {
+    return cras_shm_get_reply_error(stream->shm);
+  }
+  return rc;
+}
+
 /*
  * Reads and handles one audio message from client.
  * Returns:
@@ -230,6 +276,10 @@ static int read_and_handle_client_message(struct cras_rstream* stream) {
   struct audio_message msg;
   int rc;
 
+  if (stream->flags & EVENTFD_WAKEUPS) {
+    return read_and_handle_client_event(stream);
+  }
+
   rc = get_audio_request_reply(stream, &msg);
   if (rc <= 0) {
     clear_pending_reply(stream);
@@ -272,6 +322,39 @@ static void disallow_non_supported_dsp_effects(uint32_t* effects) {
   }
 }
 
+/*
+ * Creates the eventfds of a stream asking for EVENTFD_WAKEUPS. Falls back to
+ * the audio socket by clearing the flag if they can't be created.
+ */
+static void setup_wakeup_fds(struct cras_rstream* stream) {
+  stream->notify_fd = -1;
+  stream->reply_fd = -1;
+
+  if (!(stream->flags & EVENTFD_WAKEUPS)) {
+    return;
+  }
+  if (stream_is_server_only(stream)) {
+    stream->flags &= ~EVENTFD_WAKEUPS;
+    return;
+  }
+
+  stream->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  stream->reply_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (stream->notify_fd < 0 || stream->reply_fd < 0) {
+    syslog(LOG_WARNING, "stream %x failed to create eventfds: %d",
+           stream->stream_id, errno);
+    if (stream->notify_fd >= 0) {
+      close(stream->notify_fd);
+    }
+    if (stream->reply_fd >= 0) {
+      close(stream->reply_fd);
+    }
+    stream->notify_fd = -1;
+    stream->reply_fd = -1;
+    stream->flags &= ~EVENTFD_WAKEUPS;
+  }
+}
+
 // Exported functions
 
 int cras_rstream_create(struct cras_rstream_config* config,
@@ -323,6 +406,7 @@ int cras_rstream_create(struct cras_rstream_config* config,
 
   stream->fd = config->audio_fd;
   config->audio_fd = -1;
+  setup_wakeup_fds(stream);
   stream->buf_state = buffer_share_create(stream->buffer_frames);
   disallow_non_supported_dsp_effects(&config->effects);
   stream->stream_apm = (stream->direction == CRAS_STREAM_INPUT)
@@ -347,6 +431,10 @@ void cras_rstream_destroy(struct cras_rstream* stream) {
   cras_server_metrics_stream_destroy(stream);
   cras_system_state_stream_removed(stream->direction, stream->client_type);
   close(stream->fd);
+  if (stream->flags & EVENTFD_WAKEUPS) {
+    close(stream->notify_fd);
+    close(stream->reply_fd);
+  }
   cras_audio_shm_destroy(stream->shm);
   cras_audio_area_destroy(stream->audio_area);
   buffer_share_destroy(stream->buf_state);
@@ -396,9 +484,34 @@ static void init_audio_message(struct audio_message* msg,
   msg->frames = frames;
 }
 
+/*
+ * Wakes the client of a stream with "frames" to request or read, through the
+ * notify eventfd with EVENTFD_WAKEUPS or an audio_message otherwise.
+ * Returns:
+ *   Number of bytes written, or a negative error code.
+ */
+static int notify_client(struct cras_rstream* stream,
+                         enum CRAS_AUDIO_MESSAGE_ID id,
+                         uint32_t frames) {
+  struct audio_message msg;
+  uint64_t event = 1;
+  int rc;
+
+  if (stream->flags & EVENTFD_WAKEUPS) {
+    cras_shm_set_wakeup_frames(stream->shm, frames);
+    rc = write(stream->notify_fd, &event, sizeof(event));
+  } else {
+    init_audio_message(&msg, id, frames);
+    rc = write(stream->fd, &msg, sizeof(msg));
+  }
+  if (rc < 0) {
+    return -errno;
+  }
+  return rc;
+}
+
 int cras_rstream_request_audio(struct cras_rstream* stream,
                                const struct timespec* now) {
-  struct audio_message msg;
   int rc;
 
   // Only request samples from output streams.
@@ -408,10 +521,14 @@ int cras_rstream_request_audio(struct cras_rstream* stream,
 
   stream->last_fetch_ts = *now;
 
-  init_audio_message(&msg, AUDIO_MESSAGE_REQUEST_DATA, stream->cb_threshold);
-  rc = write(stream->fd, &msg, sizeof(msg));
+  /* A ring can take more than one callback worth of frames. Clients not
+   * asking for BULK_AUDIO_OK still write at most cb_threshold. */
+  rc = notify_client(stream, AUDIO_MESSAGE_REQUEST_DATA,
+                     cras_shm_is_ring(stream->shm)
+                         ? cras_shm_get_num_writeable(stream->shm)
+                         : stream->cb_threshold);
   if (rc < 0) {
-    return -errno;
+    return rc;
   }
 
   set_pending_reply(stream);
@@ -420,7 +537,6 @@ int cras_rstream_request_audio(struct cras_rstream* stream,
 }
 
 int cras_rstream_audio_ready(struct cras_rstream* stream, size_t count) {
-  struct audio_message msg;
   int rc;
 
   cras_shm_buffer_write_complete(stream->shm);
@@ -431,10 +547,9 @@ int cras_rstream_audio_ready(struct cras_rstream* stream, size_t count) {
     return 0;
   }
 
-  init_audio_message(&msg, AUDIO_MESSAGE_DATA_READY, count);
-  rc = write(stream->fd, &msg, sizeof(msg));
+  rc = notify_client(stream, AUDIO_MESSAGE_DATA_READY, count);
   if (rc < 0) {
-    return -errno;
+    return rc;
   }
 
   set_pending_reply(stream);
@@ -501,8 +616,8 @@ void cras_rstream_update_output_read_pointer(struct cras_rstream* rstream) {
   int i, offset;
 
   /* Retrieve the read pointer |src| start from which to calculate
-   * the EWMA power. |rstream->shm| has double buffer, so we need
-   * to read twice. */
+   * the EWMA power. |rstream->shm| has double buffer, or a ring that
+   * may wrap, so we need to read twice. */
   offset = 0;
   for (i = 0; (i < 2) && (offset < nwritten); i++) {
     src = cras_shm_get_readable_frames(rstream->shm, offset, &nfr);
@@ -562,7 +677,7 @@ int cras_rstream_flush_old_audio_messages(struct cras_rstream* stream) {
     return 0;
   }
 
-  pollfd.fd = stream->fd;
+  pollfd.fd = cras_rstream_get_audio_fd(stream);
   pollfd.events = POLLIN;
 
   do {
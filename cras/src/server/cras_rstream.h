@@ -45,6 +45,10 @@ struct cras_rstream {
   uint32_t flags;
   // Socket for requesting and sending audio buffer events.
   int fd;
+  // With EVENTFD_WAKEUPS, eventfd signaled to wake the client.
+  int notify_fd;
+  // With EVENTFD_WAKEUPS, eventfd the client signals to reply.
+  int reply_fd;
   // Buffer size in frames.
   size_t buffer_frames;
   // Callback client when this much is left.
@@ -170,9 +174,25 @@ static inline int cras_rstream_get_format(const struct cras_rstream* stream,
 
 // Gets the fd to be used to poll this client for audio.
 static inline int cras_rstream_get_audio_fd(const struct cras_rstream* stream) {
+  if (stream->flags & EVENTFD_WAKEUPS) {
+    return stream->reply_fd;
+  }
   return stream->fd;
 }
 
+/* Gets the eventfds of a stream using EVENTFD_WAKEUPS. Returns -EINVAL if the
+ * stream signals through the audio socket instead. */
+static inline int cras_rstream_get_wakeup_fds(const struct cras_rstream* stream,
+                                              int* notify_fd,
+                                              int* reply_fd) {
+  if (!(stream->flags & EVENTFD_WAKEUPS)) {
+    return -EINVAL;
+  }
+  *notify_fd = stream->notify_fd;
+  *reply_fd = stream->reply_fd;
+  return 0;
+}
+
 // Gets the is_draning flag.
 static inline int cras_rstream_get_is_draining(
     const struct cras_rstream* stream) {
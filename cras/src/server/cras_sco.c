@@ -3,6 +3,10 @@
  * found in the LICENSE file.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // for recvmmsg and sendmmsg
+#endif
+
 #include "cras/src/server/cras_sco.h"
 
 #include <stdint.h>
@@ -22,6 +26,7 @@
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_server_metrics.h"
 #include "cras/src/server/cras_sr.h"
+#include "cras_util.h"
 #include "packet_status_logger.h"
 #include "third_party/utlist/utlist.h"
 
@@ -65,6 +70,31 @@ static const size_t wbs_hci_sco_buffer_size[] = {60, 120, 240, 360, 0};
  * sequence number 0000, 0011, 1100, 1111. */
 static const uint8_t h2_header_frames_count[] = {0x08, 0x38, 0xc8, 0xf8};
 
+// Control message space for the packet status and receive timestamp.
+#define SCO_CMSG_SPACE \
+  (CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timespec)))
+
+/* A batch of SCO packets read from the socket with one recvmmsg call, or
+ * to write to it with one sendmmsg call. The buffers are allocated when
+ * cras_sco starts and reused for each batch.
+ */
+struct sco_batch {
+  struct mmsghdr msgs[CRAS_SCO_MAX_BATCH];
+  struct iovec iovs[CRAS_SCO_MAX_BATCH];
+  // Control messages of the packets read.
+  char cmsgs[CRAS_SCO_MAX_BATCH][SCO_CMSG_SPACE]
+      __attribute__((aligned(__alignof__(struct cmsghdr))));
+  // HCI packet status flag of each packet read.
+  uint8_t pkt_status[CRAS_SCO_MAX_BATCH];
+  // Packet data, each packet takes |stride| bytes.
+  uint8_t* data;
+  size_t stride;
+  // Number of packets in the batch.
+  unsigned int count;
+  // Index of the next packet to take from the packets read.
+  unsigned int next;
+};
+
 /* Structure to hold variables for a HFP connection. Since HFP supports
  * bi-direction audio, two iodevs should share one cras_sco if they
  * represent two directions of the same HFP headset
@@ -135,6 +165,12 @@ struct cras_sco {
   bool is_cras_sr_bt_enabled;
   // The associated bt device.
   struct cras_bt_device* device;
+  // The batch of packets read from SCO socket.
+  struct sco_batch rx;
+  // The batch of packets to write to SCO socket.
+  struct sco_batch tx;
+  // The stats of SCO socket I/O, could be NULL.
+  struct cras_sco_io_stats* io_stats;
 };
 
 static size_t wbs_get_supported_packet_size(size_t packet_size,
@@ -294,6 +330,199 @@ void cras_sco_force_output_level(struct cras_sco* sco, unsigned int level) {
   }
 }
 
+static int sco_batch_alloc(struct sco_batch* batch, size_t stride) {
+  batch->data = (uint8_t*)calloc(CRAS_SCO_MAX_BATCH, stride);
+  batch->stride = stride;
+  batch->count = 0;
+  batch->next = 0;
+  return batch->data ? 0 : -ENOMEM;
+}
+
+static void sco_batch_free(struct sco_batch* batch) {
+  free(batch->data);
+  batch->data = NULL;
+  batch->count = 0;
+  batch->next = 0;
+}
+
+static void update_read_stats(struct cras_sco_io_stats* stats,
+                              const struct sco_batch* rx,
+                              const struct timespec* rx_ts) {
+  struct timespec now, delay;
+  uint64_t delay_us;
+  unsigned int i;
+
+  stats->packets_read += rx->count;
+  stats->read_batches[rx->count - 1]++;
+  for (i = 0; i < rx->count; i++) {
+    stats->packets_erroneous += (rx->pkt_status[i] > 0);
+  }
+
+  if (!timespec_is_nonzero(rx_ts)) {
+    return;
+  }
+  clock_gettime(CLOCK_REALTIME, &now);
+  subtract_timespecs(&now, rx_ts, &delay);
+  delay_us = delay.tv_sec * 1000000ULL + delay.tv_nsec / 1000;
+  stats->max_read_delay_us = MAX(stats->max_read_delay_us, delay_us);
+  stats->sum_read_delay_us += delay_us;
+  stats->num_read_delays++;
+}
+
+/* Reads the SCO packets queued on the socket, up to CRAS_SCO_MAX_BATCH, with
+ * one recvmmsg call. The packet status flag and the receive timestamp of
+ * each packet are parsed from the control messages at once.
+ * Returns:
+ *    The number of packets read, or a negative error code.
+ */
+static int sco_recv_batch(struct cras_sco* sco) {
+  struct sco_batch* rx = &sco->rx;
+  struct timespec rx_ts = {0, 0};
+  struct msghdr* hdr;
+  struct cmsghdr* cmsg;
+  unsigned int i;
+  int rc;
+
+  for (i = 0; i < CRAS_SCO_MAX_BATCH; i++) {
+    rx->iovs[i].iov_base = rx->data + i * rx->stride;
+    rx->iovs[i].iov_len = sco->packet_size;
+    hdr = &rx->msgs[i].msg_hdr;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->msg_iov = &rx->iovs[i];
+    hdr->msg_iovlen = 1;
+    hdr->msg_control = rx->cmsgs[i];
+    hdr->msg_controllen = sizeof(rx->cmsgs[i]);
+  }
+  rx->count = 0;
+  rx->next = 0;
+
+  do {
+    rc = recvmmsg(sco->fd, rx->msgs, CRAS_SCO_MAX_BATCH, MSG_DONTWAIT, NULL);
+  } while (rc < 0 && errno == EINTR);
+  if (sco->io_stats) {
+    sco->io_stats->recv_calls++;
+  }
+  if (rc < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    }
+    syslog(LOG_WARNING, "HCI SCO packet read err %s", cras_strerror(errno));
+    return -errno;
+  }
+
+  for (i = 0; i < (unsigned int)rc; i++) {
+    hdr = &rx->msgs[i].msg_hdr;
+    rx->pkt_status[i] = 0;
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+      if (cmsg->cmsg_level == SOL_BLUETOOTH &&
+          cmsg->cmsg_type == BT_SCM_PKT_STATUS) {
+        rx->pkt_status[i] = *CMSG_DATA(cmsg);
+      } else if (i == 0 && cmsg->cmsg_level == SOL_SOCKET &&
+                 cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+        memcpy(&rx_ts, CMSG_DATA(cmsg), sizeof(rx_ts));
+      }
+    }
+  }
+  rx->count = rc;
+  if (rc && sco->io_stats) {
+    update_read_stats(sco->io_stats, rx, &rx_ts);
+  }
+  return rc;
+}
+
+/* Takes the next packet read from the SCO socket, reads a new batch when
+ * all packets of the last one are taken.
+ * Args:
+ *    sco - The cras_sco instance.
+ *    packet - To be filled with the pointer to the packet data.
+ *    pkt_status - To be filled with the HCI packet status flag.
+ * Returns:
+ *    The length of the packet, -EAGAIN if no packet is queued on the socket,
+ *    or other negative error code.
+ */
+static int sco_next_packet(struct cras_sco* sco,
+                           uint8_t** packet,
+                           uint8_t* pkt_status) {
+  struct sco_batch* rx = &sco->rx;
+  int rc;
+
+  if (rx->next == rx->count) {
+    rc = sco_recv_batch(sco);
+    if (rc <= 0) {
+      return rc ? rc : -EAGAIN;
+    }
+  }
+  *packet = (uint8_t*)rx->iovs[rx->next].iov_base;
+  *pkt_status = rx->pkt_status[rx->next];
+  return rx->msgs[rx->next++].msg_len;
+}
+
+/* Writes the packets queued by sco_queue_packet() to the SCO socket with one
+ * sendmmsg call.
+ * Returns:
+ *    The number of packets written, or a negative error code.
+ */
+static int sco_send_batch(struct cras_sco* sco) {
+  struct sco_batch* tx = &sco->tx;
+  unsigned int sent = 0;
+  unsigned int i;
+  int rc;
+
+  while (sent < tx->count) {
+    rc = sendmmsg(sco->fd, tx->msgs + sent, tx->count - sent, 0);
+    if (sco->io_stats) {
+      sco->io_stats->send_calls++;
+    }
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      tx->count = 0;
+      return -errno;
+    }
+    for (i = sent; i < sent + rc; i++) {
+      if (tx->msgs[i].msg_len != tx->iovs[i].iov_len) {
+        syslog(LOG_WARNING, "Partially write %u bytes for SCO packet size %zu",
+               tx->msgs[i].msg_len, tx->iovs[i].iov_len);
+        tx->count = 0;
+        return -EIO;
+      }
+    }
+    sent += rc;
+  }
+  tx->count = 0;
+  if (sco->io_stats) {
+    sco->io_stats->packets_written += sent;
+  }
+  return sent;
+}
+
+// Copies a packet to write to the SCO socket with the next batch.
+static int sco_queue_packet(struct cras_sco* sco,
+                            const uint8_t* packet,
+                            size_t len) {
+  struct sco_batch* tx = &sco->tx;
+  struct msghdr* hdr;
+  int rc;
+
+  if (tx->count == CRAS_SCO_MAX_BATCH) {
+    rc = sco_send_batch(sco);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  tx->iovs[tx->count].iov_base = tx->data + tx->count * tx->stride;
+  tx->iovs[tx->count].iov_len = len;
+  memcpy(tx->iovs[tx->count].iov_base, packet, len);
+  hdr = &tx->msgs[tx->count].msg_hdr;
+  memset(hdr, 0, sizeof(*hdr));
+  hdr->msg_iov = &tx->iovs[tx->count];
+  hdr->msg_iovlen = 1;
+  tx->count++;
+  return 0;
+}
+
 int sco_write_msbc(struct cras_sco* sco) {
   size_t encoded;
   int err;
@@ -303,7 +532,7 @@ int sco_write_msbc(struct cras_sco* sco) {
   uint8_t* wp;
 
   if (sco->write_rp + sco->packet_size <= sco->write_wp) {
-    goto msbc_send_again;
+    goto msbc_queue_packet;
   }
 
   // Make sure there are MSBC_CODE_SIZE bytes to encode.
@@ -346,25 +575,18 @@ int sco_write_msbc(struct cras_sco* sco) {
     return 0;
   }
 
-msbc_send_again:
-  err = send(sco->fd, sco->write_buf + sco->write_rp, sco->packet_size, 0);
+msbc_queue_packet:
+  err = sco_queue_packet(sco, sco->write_buf + sco->write_rp, sco->packet_size);
   if (err < 0) {
-    if (errno == EINTR) {
-      goto msbc_send_again;
-    }
     return err;
   }
-  if (err != (int)sco->packet_size) {
-    syslog(LOG_WARNING, "Partially write %d bytes for mSBC", err);
-    return -EIO;
-  }
   sco->write_rp += sco->packet_size;
   if (sco->write_rp == sco->write_wp) {
     sco->write_rp = 0;
     sco->write_wp = 0;
   }
 
-  return err;
+  return sco->packet_size;
 }
 
 int sco_write(struct cras_sco* sco) {
@@ -379,25 +601,14 @@ int sco_write(struct cras_sco* sco) {
   }
   to_send = sco->packet_size;
 
-send_sample:
-  err = send(sco->fd, samples, to_send, 0);
+  err = sco_queue_packet(sco, samples, to_send);
   if (err < 0) {
-    if (errno == EINTR) {
-      goto send_sample;
-    }
-
     return err;
   }
 
-  if (err != (int)sco->packet_size) {
-    syslog(LOG_WARNING, "Partially write %d bytes for SCO packet size %u", err,
-           sco->packet_size);
-    return -EIO;
-  }
-
   buf_increment_read(sco->playback_buf, to_send);
 
-  return err;
+  return to_send;
 }
 
 static int h2_header_get_seq(const uint8_t* p) {
@@ -507,33 +718,18 @@ int sco_read_msbc(struct cras_sco* sco) {
   uint8_t* capture_buf;
   const uint8_t* frame_head = NULL;
   unsigned int seq;
-
-  struct msghdr msg = {0};
-  struct iovec iov;
-  struct cmsghdr* cmsg;
-  const unsigned int control_size = CMSG_SPACE(sizeof(int));
-  char control[control_size];
+  uint8_t* packet;
   uint8_t pkt_status;
 
   if (sco->read_rp + MSBC_PKT_SIZE <= sco->read_wp) {
     goto extract;
   }
 
-  memset(control, 0, sizeof(control));
-recv_msbc_bytes:
-  msg.msg_iov = &iov;
-  msg.msg_iovlen = 1;
-  iov.iov_base = sco->read_buf + sco->read_wp;
-  iov.iov_len = sco->packet_size;
-  msg.msg_control = control;
-  msg.msg_controllen = control_size;
-
-  err = recvmsg(sco->fd, &msg, 0);
+  err = sco_next_packet(sco, &packet, &pkt_status);
+  if (err == -EAGAIN) {
+    return 0;
+  }
   if (err < 0) {
-    syslog(LOG_WARNING, "HCI SCO packet read err %s", cras_strerror(errno));
-    if (errno == EINTR) {
-      goto recv_msbc_bytes;
-    }
     return err;
   }
   /*
@@ -561,24 +757,15 @@ recv_msbc_bytes:
   /* Offset in input data breaks mSBC frame parsing. Discard this packet
    * until read alignment succeed. */
   if (sco->read_align_cb) {
-    if (!sco->read_align_cb(sco->read_buf)) {
+    if (!sco->read_align_cb(packet)) {
       return 0;
     } else {
       sco->read_align_cb = NULL;
     }
   }
+  memcpy(sco->read_buf + sco->read_wp, packet, err);
   sco->read_wp += err;
 
-  pkt_status = 0;
-  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
-       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-    if (cmsg->cmsg_level == SOL_BLUETOOTH &&
-        cmsg->cmsg_type == BT_SCM_PKT_STATUS) {
-      size_t len = cmsg->cmsg_len - sizeof(*cmsg);
-      memcpy(&pkt_status, CMSG_DATA(cmsg), len);
-    }
-  }
-
   /*
    * HCI SCO packet status flag:
    * 0x00 - correctly received data.
@@ -672,22 +859,14 @@ int sco_read(struct cras_sco* sco) {
   int err = 0;
   unsigned to_read;
   uint8_t* capture_buf;
+  uint8_t* packet;
+  uint8_t pkt_status;
 
-  capture_buf = buf_write_pointer_size(sco->capture_buf, &to_read);
-
-  if (to_read < sco->packet_size) {
+  err = sco_next_packet(sco, &packet, &pkt_status);
+  if (err == -EAGAIN) {
     return 0;
   }
-  to_read = sco->packet_size;
-
-recv_sample:
-  err = recv(sco->fd, capture_buf, to_read, 0);
   if (err < 0) {
-    syslog(LOG_WARNING, "Read error %s", cras_strerror(errno));
-    if (errno == EINTR) {
-      goto recv_sample;
-    }
-
     return err;
   }
 
@@ -708,6 +887,12 @@ recv_sample:
     }
   }
 
+  // Drop the packet if the capture buffer is full.
+  capture_buf = buf_write_pointer_size(sco->capture_buf, &to_read);
+  if (to_read < (unsigned int)err) {
+    return 0;
+  }
+  memcpy(capture_buf, packet, err);
   buf_increment_write(sco->capture_buf, err);
 
   return err;
@@ -719,50 +904,80 @@ static void swap_capture_buf_and_sr_buf(struct cras_sco* sco) {
   sco->capture_buf = tmp;
 }
 
+/* Reads one packet, or one mSBC frame already read, to the capture buffer.
+ * Returns:
+ *    The number of PCM bytes read, or a negative error code.
+ */
+static int sco_read_packet(struct cras_sco* sco) {
+  int err;
+
+  if (sco->is_cras_sr_bt_enabled) {
+    swap_capture_buf_and_sr_buf(sco);
+    err = sco->read_cb(sco);
+    swap_capture_buf_and_sr_buf(sco);
+  } else {
+    err = sco->read_cb(sco);
+  }
+  if (err < 0) {
+    return err;
+  }
+  if (sco->is_cras_sr_bt_enabled) {
+    int num_consumed = cras_sr_process(sco->sr, sco->sr_buf, sco->capture_buf);
+    if (num_consumed < err) {
+      syslog(LOG_DEBUG,
+             "Number of consumed samples is less than provided. (%d < %d).",
+             num_consumed, err);
+    }
+  }
+  // Ignore the bytes just read if input dev not in present
+  if (!sco->input_format_bytes) {
+    buf_increment_read(sco->capture_buf, err);
+  }
+  return err;
+}
+
 /* Callback function to handle sample read and write.
  * Note that we poll the SCO socket for read sample, since it reflects
  * there is actual some sample to read while the socket always reports
  * writable even when device buffer is full.
  * The strategy is to synchronize read & write operations:
- * 1. Read one chunk of MTU bytes of data.
+ * 1. Read all the packets queued on the socket in one batch, so a late
+ *    wake up catches up at once instead of waking up again per packet.
  * 2. When input device not attached, ignore the data just read.
- * 3. When output device attached, write one chunk of MTU bytes of data.
+ * 3. When output device attached, write as many packets as read in one
+ *    batch, or one packet if none was read.
  */
 static int cras_sco_callback(void* arg, int revents) {
   struct cras_sco* sco = (struct cras_sco*)arg;
+  unsigned int num_packets = 0;
+  unsigned int pcm_read = 0;
+  unsigned int i;
   int err = 0;
 
   if (!sco->started) {
     return 0;
   }
+  if (sco->io_stats) {
+    sco->io_stats->wakeups++;
+  }
 
   // Allow last read before handling error or hang-up events.
   if (revents & POLLIN) {
-    if (sco->is_cras_sr_bt_enabled) {
-      swap_capture_buf_and_sr_buf(sco);
-      err = sco->read_cb(sco);
-      swap_capture_buf_and_sr_buf(sco);
-    } else {
-      err = sco->read_cb(sco);
-    }
+    err = sco_recv_batch(sco);
     if (err < 0) {
       syslog(LOG_WARNING, "Read error");
       goto read_write_error;
     }
-    if (sco->is_cras_sr_bt_enabled) {
-      int num_consumed =
-          cras_sr_process(sco->sr, sco->sr_buf, sco->capture_buf);
-      if (num_consumed < err) {
-        syslog(LOG_DEBUG,
-               "Number of consumed samples is less than provided. (%d < %d).",
-               num_consumed, err);
+    num_packets = err;
+    while (sco->rx.next < sco->rx.count) {
+      err = sco_read_packet(sco);
+      if (err < 0) {
+        syslog(LOG_WARNING, "Read error");
+        goto read_write_error;
       }
+      pcm_read += err;
     }
   }
-  // Ignore the bytes just read if input dev not in present
-  if (!sco->input_format_bytes) {
-    buf_increment_read(sco->capture_buf, err);
-  }
 
   if (revents & (POLLERR | POLLHUP)) {
     syslog(LOG_WARNING, "Error polling SCO socket, revent %d", revents);
@@ -775,16 +990,27 @@ static int cras_sco_callback(void* arg, int revents) {
     goto read_write_error;
   }
 
+  num_packets = MAX(num_packets, 1);
+
   /* Without output stream's presence, we shall still send zero packets
    * to HF. This is required for some HF devices to start sending non-zero
    * data to AG.
    */
   if (!sco->output_format_bytes) {
     buf_increment_write(sco->playback_buf,
-                        sco->msbc_write ? err : sco->packet_size);
+                        sco->msbc_write ? pcm_read
+                                        : num_packets * sco->packet_size);
   }
 
-  err = sco->write_cb(sco);
+  for (i = 0; i < num_packets; i++) {
+    err = sco->write_cb(sco);
+    if (err < 0) {
+      break;
+    }
+  }
+  if (err >= 0) {
+    err = sco_send_batch(sco);
+  }
   if (err < 0) {
     syslog(LOG_WARNING, "Write error");
     goto read_write_error;
@@ -877,6 +1103,11 @@ void cras_sco_set_wbs_logger(struct cras_sco* sco,
   sco->wbs_logger = wbs_logger;
 }
 
+void cras_sco_set_io_stats(struct cras_sco* sco,
+                           struct cras_sco_io_stats* io_stats) {
+  sco->io_stats = io_stats;
+}
+
 int cras_sco_set_fd(struct cras_sco* sco, int fd) {
   /* Valid only when existing fd isn't set and the new fd is
    * non-negative to prevent leak. */
@@ -907,6 +1138,7 @@ int cras_sco_running(struct cras_sco* sco) {
 
 int cras_sco_start(unsigned int mtu, int codec, struct cras_sco* sco) {
   int ret;
+  int enable = 1;
 
   if (sco->fd < 0) {
     syslog(LOG_WARNING, "Start SCO without valid fd(%d) set", sco->fd);
@@ -948,6 +1180,22 @@ int cras_sco_start(unsigned int mtu, int codec, struct cras_sco* sco) {
     sco->read_cb = sco_read;
   }
 
+  // The packet size could only be adjusted to a smaller one when reading.
+  if (sco_batch_alloc(&sco->rx, sco->packet_size) ||
+      sco_batch_alloc(&sco->tx, sco->packet_size)) {
+    ret = -ENOMEM;
+    goto mem_err;
+  }
+  if (sco->io_stats) {
+    memset(sco->io_stats, 0, sizeof(*sco->io_stats));
+  }
+  // Timestamp the packets read to track how late they are handled.
+  if (setsockopt(sco->fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable,
+                 sizeof(enable))) {
+    syslog(LOG_DEBUG, "Failed to enable SCO timestamps: %s",
+           cras_strerror(errno));
+  }
+
   audio_thread_add_events_callback(sco->fd, cras_sco_callback, sco,
                                    POLLIN | POLLERR | POLLHUP);
 
@@ -968,6 +1216,8 @@ int cras_sco_start(unsigned int mtu, int codec, struct cras_sco* sco) {
 mem_err:
   free(sco->write_buf);
   free(sco->read_buf);
+  sco_batch_free(&sco->rx);
+  sco_batch_free(&sco->tx);
   return ret;
 }
 
@@ -1002,6 +1252,8 @@ int cras_sco_stop(struct cras_sco* sco) {
     free(sco->read_buf);
     sco->read_buf = NULL;
   }
+  sco_batch_free(&sco->rx);
+  sco_batch_free(&sco->tx);
 
   if (sco->msbc_read) {
     cras_sbc_codec_destroy(sco->msbc_read);
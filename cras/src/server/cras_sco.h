@@ -58,6 +58,10 @@ void cras_sco_destroy(struct cras_sco* sco);
 void cras_sco_set_wbs_logger(struct cras_sco* sco,
                              struct packet_status_logger* wbs_logger);
 
+// Sets the stats of the SCO socket I/O to cras_sco instance.
+void cras_sco_set_io_stats(struct cras_sco* sco,
+                           struct cras_sco_io_stats* io_stats);
+
 // Sets the file descriptor to cras_sco.
 int cras_sco_set_fd(struct cras_sco* sco, int fd);
 
@@ -31,10 +31,12 @@
 #endif
 #include "cras/src/common/cras_metrics.h"
 #include "cras/src/common/cras_string.h"
+#include "cras/src/dsp/sample_conv.h"
 #include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_alsa_helpers.h"
 #include "cras/src/server/cras_audio_thread_monitor.h"
 #include "cras/src/server/cras_device_monitor.h"
+#include "cras/src/server/cras_fmt_conv_ch.h"
 #include "cras/src/server/cras_hotword_handler.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_main_message.h"
@@ -48,6 +50,7 @@
 #include "cras/src/server/cras_system_state.h"
 #include "cras/src/server/cras_tm.h"
 #include "cras/src/server/cras_udev.h"
+#include "cras/src/server/linear_resampler.h"
 #include "cras/src/server/rust/include/cras_rust_logging.h"
 #include "cras_config.h"
 #include "cras_messages.h"
@@ -408,6 +411,9 @@ int cras_server_init() {
 
   // init mixer with CPU capabilities
   cras_mix_init();
+  cras_fmt_conv_ch_init();
+  cras_sample_conv_init();
+  linear_resampler_init();
 
   /* Allow clients to register callbacks for file descriptors.
    * add_select_fd and rm_select_fd will add and remove file descriptors
@@ -6,6 +6,8 @@
 #include "cras/src/server/cras_stream_apm.h"
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include <syslog.h>
 #include <webrtc-apm/webrtc_apm.h>
@@ -131,6 +133,35 @@ struct active_apm {
   struct active_apm *prev, *next;
 }* active_apms;
 
+/*
+ * APMs start and stop on the audio thread running the input device while
+ * the reverse stream is processed on the thread running the output device.
+ * Only the paths that start, stop or reconfigure APMs touch |active_apms|,
+ * under |active_apms_lock|. The per block readers never take it and read
+ * |active_snapshot| instead, an immutable copy published with one atomic
+ * store after every change. Readers announce themselves in
+ * |snapshot_readers| while they use it, and a replaced copy waits on
+ * |retired_snapshots| until no reader is left.
+ *
+ * The lock is taken by audio threads so it inherits priority. It is held
+ * for one pass over the active APMs and the DSP effect toggles of their
+ * input devices, and never while processing audio.
+ */
+struct active_apm_snapshot {
+  size_t num_apms;
+  // Link in |retired_snapshots|.
+  struct active_apm_snapshot* next;
+  // Copies of the |active_apms| entries, their list links are unused.
+  struct active_apm apms[];
+};
+
+static pthread_mutex_t active_apms_lock;
+static pthread_once_t active_apms_lock_once = PTHREAD_ONCE_INIT;
+static struct active_apm_snapshot* active_snapshot;
+static int snapshot_readers;
+// Replaced snapshots, accessed under |active_apms_lock|.
+static struct active_apm_snapshot* retired_snapshots;
+
 // Commands sent to be handled in main thread.
 enum CRAS_STREAM_APM_MSG_TYPE {
   APM_DISALLOW_AEC_ON_DSP,
@@ -520,10 +551,93 @@ static struct active_apm* get_active_apm(struct cras_stream_apm* stream,
   return NULL;
 }
 
+/* Frees the retired snapshots if no reader can hold them. A reader that
+ * enters after the load below reads the current snapshot. Called with
+ * |active_apms_lock| held. */
+static void reclaim_snapshots() {
+  struct active_apm_snapshot* snap;
+
+  if (!retired_snapshots ||
+      __atomic_load_n(&snapshot_readers, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+  while ((snap = retired_snapshots)) {
+    retired_snapshots = snap->next;
+    free(snap);
+  }
+}
+
+/* Publishes a copy of |active_apms| to the readers. Called with
+ * |active_apms_lock| held. */
+static void publish_active_apms() {
+  struct active_apm_snapshot* old = active_snapshot;
+  struct active_apm_snapshot* snap = NULL;
+  struct active_apm* active;
+  size_t num_apms = 0;
+
+  DL_FOREACH (active_apms, active) {
+    num_apms++;
+  }
+  if (num_apms) {
+    snap = (struct active_apm_snapshot*)calloc(
+        1, sizeof(*snap) + num_apms * sizeof(snap->apms[0]));
+    // Readers see no APM rather than some that may be destroyed.
+    if (snap == NULL) {
+      syslog(LOG_ERR, "No memory to publish active apms.");
+    }
+  }
+  if (snap) {
+    DL_FOREACH (active_apms, active) {
+      snap->apms[snap->num_apms].apm = active->apm;
+      snap->apms[snap->num_apms].stream = active->stream;
+      snap->num_apms++;
+    }
+  }
+
+  __atomic_store_n(&active_snapshot, snap, __ATOMIC_SEQ_CST);
+
+  if (old) {
+    old->next = retired_snapshots;
+    retired_snapshots = old;
+  }
+  reclaim_snapshots();
+}
+
+static struct active_apm_snapshot* snapshot_enter() {
+  __atomic_add_fetch(&snapshot_readers, 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&active_snapshot, __ATOMIC_SEQ_CST);
+}
+
+static void snapshot_exit() {
+  __atomic_sub_fetch(&snapshot_readers, 1, __ATOMIC_RELEASE);
+}
+
+/* Waits until no reader can still use an APM that is no longer active, so
+ * it can be destroyed. Readers hold a snapshot for one block at most. */
+static void synchronize_snapshots() {
+  while (__atomic_load_n(&snapshot_readers, __ATOMIC_SEQ_CST)) {
+    sched_yield();
+  }
+  pthread_mutex_lock(&active_apms_lock);
+  reclaim_snapshots();
+  pthread_mutex_unlock(&active_apms_lock);
+}
+
 struct cras_apm* cras_stream_apm_get_active(struct cras_stream_apm* stream,
                                             const struct cras_iodev* idev) {
-  struct active_apm* active = get_active_apm(stream, idev);
-  return active ? active->apm : NULL;
+  struct active_apm_snapshot* snap = snapshot_enter();
+  struct cras_apm* apm = NULL;
+  size_t i;
+
+  for (i = 0; snap && i < snap->num_apms; i++) {
+    if ((snap->apms[i].apm->idev == idev) &&
+        (snap->apms[i].stream == stream)) {
+      apm = snap->apms[i].apm;
+      break;
+    }
+  }
+  snapshot_exit();
+  return apm;
 }
 
 uint64_t cras_stream_apm_get_effects(struct cras_stream_apm* stream) {
@@ -538,6 +652,7 @@ void cras_stream_apm_remove(struct cras_stream_apm* stream,
                             const struct cras_iodev* idev) {
   struct cras_apm* apm;
 
+  synchronize_snapshots();
   DL_FOREACH (stream->apms, apm) {
     if (apm->idev == idev) {
       DL_DELETE(stream->apms, apm);
@@ -727,18 +842,13 @@ struct cras_apm* cras_stream_apm_add(struct cras_stream_apm* stream,
   return apm;
 }
 
-void cras_stream_apm_start(struct cras_stream_apm* stream,
-                           const struct cras_iodev* idev) {
+static void start_active_apm(struct cras_stream_apm* stream,
+                             const struct cras_iodev* idev) {
   struct active_apm* active;
   struct cras_apm* apm;
 
-  if (stream == NULL) {
-    return;
-  }
-
   // Check if this apm has already been started.
-  apm = cras_stream_apm_get_active(stream, idev);
-  if (apm) {
+  if (get_active_apm(stream, idev)) {
     return;
   }
 
@@ -755,24 +865,33 @@ void cras_stream_apm_start(struct cras_stream_apm* stream,
   active->apm = apm;
   active->stream = stream;
   DL_APPEND(active_apms, active);
+  publish_active_apms();
 
   cras_apm_reverse_state_update();
   update_supported_dsp_effects_activation();
   reconfigure_apm_vad();
 }
 
-void cras_stream_apm_stop(struct cras_stream_apm* stream,
-                          struct cras_iodev* idev) {
-  struct active_apm* active;
-
+void cras_stream_apm_start(struct cras_stream_apm* stream,
+                           const struct cras_iodev* idev) {
   if (stream == NULL) {
     return;
   }
 
+  pthread_mutex_lock(&active_apms_lock);
+  start_active_apm(stream, idev);
+  pthread_mutex_unlock(&active_apms_lock);
+}
+
+static void stop_active_apm(struct cras_stream_apm* stream,
+                            struct cras_iodev* idev) {
+  struct active_apm* active;
+
   active = get_active_apm(stream, idev);
   if (active) {
     DL_DELETE(active_apms, active);
     free(active);
+    publish_active_apms();
   }
 
   cras_apm_reverse_state_update();
@@ -806,11 +925,23 @@ void cras_stream_apm_stop(struct cras_stream_apm* stream,
   }
 }
 
+void cras_stream_apm_stop(struct cras_stream_apm* stream,
+                          struct cras_iodev* idev) {
+  if (stream == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&active_apms_lock);
+  stop_active_apm(stream, idev);
+  pthread_mutex_unlock(&active_apms_lock);
+}
+
 int cras_stream_apm_destroy(struct cras_stream_apm* stream) {
   struct cras_apm* apm;
 
   // Unlink any linked echo ref.
   cras_apm_reverse_link_echo_ref(stream, NULL);
+  synchronize_snapshots();
 
   DL_FOREACH (stream->apms, apm) {
     DL_DELETE(stream->apms, apm);
@@ -825,15 +956,19 @@ int cras_stream_apm_destroy(struct cras_stream_apm* stream) {
 static int process_reverse(struct float_buffer* fbuf,
                            unsigned int frame_rate,
                            const struct cras_iodev* echo_ref) {
+  struct active_apm_snapshot* snap;
   struct active_apm* active;
   int ret;
   float* const* rp;
   unsigned int unused;
+  size_t i;
 
   // Caller side ensures fbuf is full and hasn't been read at all.
   rp = float_buffer_read_pointer(fbuf, 0, &unused);
 
-  DL_FOREACH (active_apms, active) {
+  snap = snapshot_enter();
+  for (i = 0; snap && i < snap->num_apms; i++) {
+    active = &snap->apms[i];
     if (!(active->stream->effects & APM_ECHO_CANCELLATION)) {
       continue;
     }
@@ -878,9 +1013,11 @@ static int process_reverse(struct float_buffer* fbuf,
         active->apm->apm_ptr, num_unique_channels, frame_rate, rp);
     if (ret) {
       syslog(LOG_ERR, "APM process reverse err");
+      snapshot_exit();
       return ret;
     }
   }
+  snapshot_exit();
   return 0;
 }
 
@@ -888,7 +1025,7 @@ static int process_reverse(struct float_buffer* fbuf,
  * When APM reverse module has state changes, this callback function is called
  * to ask stream APMs if there's need to process data on the reverse side.
  * This is expected to be called from cras_apm_reverse_state_update() in
- * audio thread so it's safe to access |active_apms|.
+ * audio thread, it reads the published snapshot of |active_apms|.
  * Args:
  *     default_reverse - True means |echo_ref| is the default reverse module
  *         provided by the system default audio output device.
@@ -899,23 +1036,30 @@ static int process_reverse(struct float_buffer* fbuf,
  */
 static int process_reverse_needed(bool default_reverse,
                                   const struct cras_iodev* echo_ref) {
+  struct active_apm_snapshot* snap = snapshot_enter();
   struct active_apm* active;
+  int needed = 0;
+  size_t i;
 
-  DL_FOREACH (active_apms, active) {
+  for (i = 0; snap && i < snap->num_apms; i++) {
+    active = &snap->apms[i];
     // No processing need when APM doesn't ask for AEC.
     if (!(active->stream->effects & APM_ECHO_CANCELLATION)) {
       continue;
     }
     // APM with NULL echo_ref means it tracks default.
     if (default_reverse && (active->stream->echo_ref == NULL)) {
-      return 1;
+      needed = 1;
+      break;
     }
     // APM asked to track given echo_ref specifically.
     if (echo_ref && (active->stream->echo_ref == echo_ref)) {
-      return 1;
+      needed = 1;
+      break;
     }
   }
-  return 0;
+  snapshot_exit();
+  return needed;
 }
 
 static void get_aec_ini(const char* config_dir) {
@@ -1006,11 +1150,15 @@ static int apm_thread_callback(void* arg, int revents) {
     switch (msg.cmd) {
       case APM_REVERSE_DEV_CHANGED:
       case APM_SET_AEC_REF:
+        pthread_mutex_lock(&active_apms_lock);
         cras_apm_reverse_state_update();
         update_supported_dsp_effects_activation();
+        pthread_mutex_unlock(&active_apms_lock);
         break;
       case APM_VAD_TARGET_CHANGED:
+        pthread_mutex_lock(&active_apms_lock);
         update_vad_target(msg.data1);
+        pthread_mutex_unlock(&active_apms_lock);
         break;
       default:
         break;
@@ -1029,8 +1177,12 @@ static void possibly_track_voice_activity(struct cras_apm* apm) {
     return;
   }
 
+  struct active_apm_snapshot* snap = snapshot_enter();
   struct active_apm* active;
-  DL_FOREACH (active_apms, active) {
+  size_t i;
+
+  for (i = 0; snap && i < snap->num_apms; i++) {
+    active = &snap->apms[i];
     // Match only the first apm. We don't care mutiple inputs.
     if (active->stream->apms != apm) {
       continue;
@@ -1046,14 +1198,25 @@ static void possibly_track_voice_activity(struct cras_apm* apm) {
       syslog(LOG_ERR, "failed to send speak on mute message: %s",
              cras_strerror(-rc));
     }
-    return;
+    break;
   }
+  snapshot_exit();
+}
+
+static void init_active_apms_lock() {
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+  pthread_mutex_init(&active_apms_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
 }
 
 int cras_stream_apm_init(const char* device_config_dir) {
   static const char* cras_apm_metrics_prefix = "Cras.";
   int rc;
 
+  pthread_once(&active_apms_lock_once, init_active_apms_lock);
   aec_config_dir = device_config_dir;
   get_aec_ini(aec_config_dir);
   get_apm_ini(aec_config_dir);
@@ -1232,8 +1395,7 @@ struct cras_audio_format* cras_stream_apm_get_format(struct cras_apm* apm) {
 
 bool cras_stream_apm_get_use_tuned_settings(struct cras_stream_apm* stream,
                                             const struct cras_iodev* idev) {
-  struct active_apm* active = get_active_apm(stream, idev);
-  if (active == NULL) {
+  if (cras_stream_apm_get_active(stream, idev) == NULL) {
     return false;
   }
 
@@ -73,6 +73,12 @@ struct feature_state {
  *    feature_state - The feature state. See struct feature_state.
  *    speak_on_mute_detection_enabled - Whether speak on mute detection is
  * enabled.
+ *    audio_thread_workers - Number of audio worker threads besides the
+ *      primary audio thread.
+ *    dsp_helper_threads - Number of threads helping the audio threads run
+ *      the independent branches of dsp pipelines.
+ *    bt_a2dp_encoder_thread - Whether A2DP packets are encoded in a thread of
+ *      their own instead of the audio thread.
  */
 static struct {
   struct cras_server_state* exp_state;
@@ -105,6 +111,9 @@ static struct {
   struct cras_feature_tier feature_tier;
   struct feature_state feature_state;
   bool speak_on_mute_detection_enabled;
+  int audio_thread_workers;
+  int dsp_helper_threads;
+  bool bt_a2dp_encoder_thread;
 } state;
 
 // The string format is CARD1,CARD2,CARD3. Divide it into a list.
@@ -201,6 +210,9 @@ void cras_system_state_init(const char* device_config_dir,
   exp_state->max_internal_speaker_channels =
       board_config.max_internal_speaker_channels;
   exp_state->max_headphone_channels = board_config.max_headphone_channels;
+  state.audio_thread_workers = MAX(board_config.audio_thread_workers, 0);
+  state.dsp_helper_threads = MAX(board_config.dsp_helper_threads, 0);
+  state.bt_a2dp_encoder_thread = !!board_config.bt_a2dp_encoder_thread;
   exp_state->num_non_chrome_output_streams = 0;
 
   if ((rc = pthread_mutex_init(&state.update_lock, 0) != 0)) {
@@ -537,6 +549,18 @@ int cras_system_get_max_headphone_channels() {
   return state.exp_state->max_headphone_channels;
 }
 
+int cras_system_get_audio_thread_workers() {
+  return state.audio_thread_workers;
+}
+
+int cras_system_get_dsp_helper_threads() {
+  return state.dsp_helper_threads;
+}
+
+bool cras_system_get_bt_a2dp_encoder_thread() {
+  return state.bt_a2dp_encoder_thread;
+}
+
 int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
   struct card_list* card;
   struct cras_alsa_card* alsa_card;
@@ -205,6 +205,15 @@ int cras_system_get_max_internal_speaker_channels();
 // Returns the maximum headphone channels.
 int cras_system_get_max_headphone_channels();
 
+// Returns the number of audio worker threads to run besides the primary one.
+int cras_system_get_audio_thread_workers();
+
+// Returns the number of threads helping to run the dsp pipelines.
+int cras_system_get_dsp_helper_threads();
+
+// Returns whether A2DP packets are encoded in a thread of their own.
+bool cras_system_get_bt_a2dp_encoder_thread();
+
 /* Adds a card at the given index to the system.  When a new card is found
  * (through a udev event notification) this will add the card to the system,
  * causing its devices to become available for playback/capture.
@@ -46,11 +46,15 @@ static const int MIN_EMPTY_PERIOD_SEC = 30;
  */
 static const int DROP_FRAMES_THRESHOLD_MS = 50;
 
-// The number of devices playing/capturing non-empty stream(s).
-static int non_empty_device_count = 0;
+// The number of devices playing/capturing non-empty stream(s), counted by
+// each audio thread for the devices it runs.
+static __thread int non_empty_device_count = 0;
+
+// The number of audio threads with non-empty devices.
+static int non_empty_thread_count = 0;
 
 // The timestamp of last EIO error time.
-static struct timespec last_io_err_time = {0, 0};
+static __thread struct timespec last_io_err_time = {0, 0};
 
 // The gap time to avoid repeated error close request to main thread.
 static const int ERROR_CLOSE_GAP_TIME_SECS = 10;
@@ -138,10 +142,18 @@ static inline int count_non_empty_dev(struct open_dev* adevs) {
 int dev_io_check_non_empty_state_transition(struct open_dev* adevs) {
   int new_non_empty_dev_count = count_non_empty_dev(adevs);
 
-  // If we have transitioned to or from a state with 0 non-empty devices,
-  // notify the main thread to update system state.
-  if ((non_empty_device_count == 0) != (new_non_empty_dev_count == 0)) {
-    cras_non_empty_audio_send_msg(new_non_empty_dev_count > 0 ? 1 : 0);
+  // If we have transitioned to or from a state with 0 non-empty devices
+  // across all audio threads, notify the main thread to update system state.
+  if (non_empty_device_count == 0 && new_non_empty_dev_count > 0) {
+    if (__atomic_fetch_add(&non_empty_thread_count, 1, __ATOMIC_ACQ_REL) ==
+        0) {
+      cras_non_empty_audio_send_msg(1);
+    }
+  } else if (non_empty_device_count > 0 && new_non_empty_dev_count == 0) {
+    if (__atomic_sub_fetch(&non_empty_thread_count, 1, __ATOMIC_ACQ_REL) ==
+        0) {
+      cras_non_empty_audio_send_msg(0);
+    }
   }
 
   non_empty_device_count = new_non_empty_dev_count;
@@ -85,7 +85,8 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
 
   if (stream->direction == CRAS_STREAM_OUTPUT) {
     rc = config_format_converter(&out->conv, stream->direction, stream_fmt,
-                                 dev_fmt, iodev->active_node->type, max_frames);
+                                 dev_fmt, iodev->active_node->type, max_frames,
+                                 iodev->high_res_conversion);
   } else {
     /*
      * For input, take into account the stream specific processing
@@ -96,9 +97,9 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
      */
     cras_stream_apm_start(stream->stream_apm, iodev);
     ofmt = cras_rstream_post_processing_format(stream, iodev) ?: dev_fmt,
-    rc =
-        config_format_converter(&out->conv, stream->direction, ofmt, stream_fmt,
-                                iodev->active_node->type, max_frames);
+    rc = config_format_converter(&out->conv, stream->direction, ofmt,
+                                 stream_fmt, iodev->active_node->type,
+                                 max_frames, iodev->high_res_conversion);
   }
   if (rc) {
     free(out);
@@ -628,7 +629,7 @@ int dev_stream_poll_stream_fd(const struct dev_stream* dev_stream) {
    * let client response wake audio thread up. */
   if (stream_uses_input(stream) && (stream->flags & USE_DEV_TIMING) &&
       cras_rstream_is_pending_reply(stream)) {
-    return stream->fd;
+    return cras_rstream_get_audio_fd(stream);
   }
 
   if (!stream_uses_output(stream) || !cras_rstream_is_pending_reply(stream) ||
@@ -636,7 +637,7 @@ int dev_stream_poll_stream_fd(const struct dev_stream* dev_stream) {
     return -EINVAL;
   }
 
-  return stream->fd;
+  return cras_rstream_get_audio_fd(stream);
 }
 
 /*
@@ -32,28 +32,35 @@ void ewma_power_init(struct ewma_power* ewma,
   ewma->step_fr = rate / EWMA_SAMPLE_RATE;
 }
 
+void ewma_power_add_frame(struct ewma_power* ewma,
+                          const int16_t* frame,
+                          unsigned int channels) {
+  unsigned int ch;
+  float power = 0.0f, f;
+
+  for (ch = 0; ch < channels; ch++) {
+    f = frame[ch] / 32768.0f;
+    power += f * f / channels;
+  }
+  if (!ewma->power_set) {
+    ewma->power = power;
+    ewma->power_set = 1;
+  } else {
+    ewma->power = smooth_factor * power + (1 - smooth_factor) * ewma->power;
+  }
+}
+
 void ewma_power_calculate(struct ewma_power* ewma,
                           const int16_t* buf,
                           unsigned int channels,
                           unsigned int size) {
-  int i, ch;
-  float power, f;
+  int i;
 
   if (!ewma->enabled || (ewma->fmt != SND_PCM_FORMAT_S16_LE)) {
     return;
   }
   for (i = 0; i < size; i += ewma->step_fr * channels) {
-    power = 0.0f;
-    for (ch = 0; ch < channels; ch++) {
-      f = buf[i + ch] / 32768.0f;
-      power += f * f / channels;
-    }
-    if (!ewma->power_set) {
-      ewma->power = power;
-      ewma->power_set = 1;
-    } else {
-      ewma->power = smooth_factor * power + (1 - smooth_factor) * ewma->power;
-    }
+    ewma_power_add_frame(ewma, buf + i, channels);
   }
 }
 
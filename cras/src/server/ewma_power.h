@@ -46,6 +46,18 @@ void ewma_power_init(struct ewma_power* ewma,
                      snd_pcm_format_t fmt,
                      unsigned int rate);
 
+/*
+ * Folds the power of one S16 frame into the ewma_power object. Callers
+ * are responsible for picking one frame every step_fr frames.
+ * Args:
+ *    ewma - The ewma_power object to update.
+ *    frame - Pointer to the samples of the frame.
+ *    channels - Number of channels of the audio data.
+ */
+void ewma_power_add_frame(struct ewma_power* ewma,
+                          const int16_t* frame,
+                          unsigned int channels);
+
 /*
  * Feeds an audio buffer to ewma_power object to calculate the
  * latest power value.
@@ -5,13 +5,21 @@
 
 #include "cras/src/server/linear_resampler.h"
 
-#include "cras/src/server/cras_audio_area.h"
+#include <string.h>
+#include <sys/param.h>
+
+#include "cras/src/server/cras_mix.h"
+#include "cras/src/server/linear_resampler_ops.h"
 #include "cras_util.h"
 
+static const struct linear_resampler_ops* ops = &linear_resampler_ops;
+
 // A linear resampler.
 struct linear_resampler {
   // The number of channles in once frames.
   unsigned int num_channels;
+  // The sample format, S16_LE, S32_LE or FLOAT_LE.
+  snd_pcm_format_t format;
   // The size of one frame in bytes.
   unsigned int format_bytes;
   // The accumulated offset for resampled src data.
@@ -24,8 +32,39 @@ struct linear_resampler {
   unsigned int from_times_100;
   // The rate factor used for linear resample.
   float f;
+  // Source frames advanced per output frame, in 32.32 fixed point.
+  uint64_t step;
 };
 
+// Fractional bits of the fixed point source position.
+#define PHASE_BITS LINEAR_RESAMPLER_PHASE_BITS
+
+static const struct linear_resampler_ops* get_linear_resampler_ops(
+    unsigned int cpu_flags) {
+#if HAVE_AVX2
+  if (cpu_flags & CPU_X86_AVX2) {
+    return &linear_resampler_ops_avx2;
+  }
+#endif
+
+#if HAVE_NEON
+  if (cpu_flags & CPU_ARM_NEON) {
+    return &linear_resampler_ops_neon;
+  }
+#endif
+
+  // default C implementation
+  return &linear_resampler_ops;
+}
+
+void linear_resampler_init() {
+  ops = get_linear_resampler_ops(cpu_get_flags());
+}
+
+void linear_resampler_init_with_flags(unsigned int cpu_flags) {
+  ops = get_linear_resampler_ops(cpu_flags & cpu_get_flags());
+}
+
 struct linear_resampler* linear_resampler_create(unsigned int num_channels,
                                                  unsigned int format_bytes,
                                                  float src_rate,
@@ -37,6 +76,7 @@ struct linear_resampler* linear_resampler_create(unsigned int num_channels,
     return NULL;
   }
   lr->num_channels = num_channels;
+  lr->format = SND_PCM_FORMAT_S16_LE;
   lr->format_bytes = format_bytes;
 
   linear_resampler_set_rates(lr, src_rate, dst_rate);
@@ -44,6 +84,36 @@ struct linear_resampler* linear_resampler_create(unsigned int num_channels,
   return lr;
 }
 
+struct linear_resampler* linear_resampler_create_with_format(
+    unsigned int num_channels,
+    snd_pcm_format_t format,
+    float src_rate,
+    float dst_rate) {
+  struct linear_resampler* lr;
+  unsigned int sample_bytes;
+
+  switch (format) {
+    case SND_PCM_FORMAT_S16_LE:
+      sample_bytes = sizeof(int16_t);
+      break;
+    case SND_PCM_FORMAT_S32_LE:
+      sample_bytes = sizeof(int32_t);
+      break;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      sample_bytes = sizeof(float);
+      break;
+    default:
+      return NULL;
+  }
+
+  lr = linear_resampler_create(num_channels, num_channels * sample_bytes,
+                               src_rate, dst_rate);
+  if (lr) {
+    lr->format = format;
+  }
+  return lr;
+}
+
 void linear_resampler_destroy(struct linear_resampler* lr) {
   if (lr) {
     free(lr);
@@ -58,6 +128,14 @@ void linear_resampler_set_rates(struct linear_resampler* lr,
   lr->from_times_100 = from * 100;
   lr->src_offset = 0;
   lr->dst_offset = 0;
+  lr->step = 0;
+  if (lr->to_times_100) {
+    lr->step = (uint64_t)(lr->from_times_100 / lr->to_times_100)
+                   << PHASE_BITS |
+               ((uint64_t)(lr->from_times_100 % lr->to_times_100)
+                << PHASE_BITS) /
+                   lr->to_times_100;
+  }
 }
 
 /* Assuming the linear resampler transforms X frames of input buffer into
@@ -107,59 +185,156 @@ int linear_resampler_needed(struct linear_resampler* lr) {
   return lr->from_times_100 != lr->to_times_100;
 }
 
+/* Source position of output frame dst_idx, relative to the start of the
+ * current source buffer. This float computation defines how many frames
+ * are consumed and produced, so it is kept as is for the frame accounting
+ * while the samples are interpolated with the fixed point phase below. */
+static float src_pos_at(const struct linear_resampler* lr,
+                        unsigned int dst_idx) {
+  float src_pos = (float)(lr->dst_offset + dst_idx) / lr->f;
+
+  if (src_pos > lr->src_offset) {
+    return src_pos - lr->src_offset;
+  }
+  return 0;
+}
+
+/* Returns the first output index in [0, dst_frames] whose source position
+ * is past the last source frame, or dst_frames if there is none. The
+ * position never decreases with the index so a binary search does. */
+static unsigned int find_end_idx(const struct linear_resampler* lr,
+                                 unsigned int src_frames,
+                                 unsigned int dst_frames) {
+  unsigned int lo = 0, hi = dst_frames;
+
+  while (lo < hi) {
+    unsigned int mid = lo + (hi - lo) / 2;
+
+    if (src_pos_at(lr, mid) > src_frames - 1) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+/* Fixed point source position of output frame 0, relative to the start of
+ * the current source buffer. Negative when the first output frames are
+ * still before it, those are clamped to the first source frame. */
+static int64_t start_phase(const struct linear_resampler* lr) {
+  uint64_t num = (uint64_t)lr->dst_offset * lr->from_times_100;
+  uint64_t pos;
+
+  if (!lr->to_times_100) {
+    return 0;
+  }
+  pos = (num / lr->to_times_100) << PHASE_BITS |
+        ((num % lr->to_times_100) << PHASE_BITS) / lr->to_times_100;
+  return (int64_t)pos - ((int64_t)lr->src_offset << PHASE_BITS);
+}
+
+// Copies frame idx of src to count consecutive frames of dst.
+static void repeat_frame(const uint8_t* src,
+                         unsigned int idx,
+                         uint8_t* dst,
+                         unsigned int count,
+                         unsigned int frame_bytes) {
+  unsigned int i;
+
+  for (i = 0; i < count; i++) {
+    memcpy(dst + i * frame_bytes, src + idx * frame_bytes, frame_bytes);
+  }
+}
+
+/* Writes frames output frames interpolated from src_frames source frames.
+ * Output frames at or before the first source frame, and at or past the
+ * last one, repeat it. They are at the two ends since the phase only
+ * grows, so they are split off here and the kernel interpolates the frames
+ * in between without checking every position. */
+static void resample_frames(struct linear_resampler* lr,
+                            const uint8_t* src,
+                            unsigned int src_frames,
+                            uint8_t* dst,
+                            unsigned int frames) {
+  const unsigned int last_idx = src_frames - 1;
+  const int64_t last_phase = (int64_t)last_idx << PHASE_BITS;
+  const unsigned int frame_bytes = lr->format_bytes;
+  int64_t phase = start_phase(lr);
+  unsigned int head, end;
+  uint8_t* out;
+
+  // Output frames [0, head) are at or before the first source frame.
+  if (phase > 0) {
+    head = 0;
+  } else if (lr->step) {
+    head = MIN(frames, (uint64_t)-phase / lr->step + 1);
+  } else {
+    head = frames;
+  }
+  phase += head * lr->step;
+
+  // Output frames [end, frames) are at or past the last source frame.
+  end = head;
+  if (head < frames && phase < last_phase) {
+    end = frames;
+    if (lr->step) {
+      end = head + MIN(frames - head,
+                       ((uint64_t)(last_phase - phase) + lr->step - 1) /
+                           lr->step);
+    }
+  }
+
+  repeat_frame(src, 0, dst, head, frame_bytes);
+  out = dst + head * frame_bytes;
+  switch (lr->format) {
+    case SND_PCM_FORMAT_S16_LE:
+      ops->s16((const int16_t*)src, (int16_t*)out, lr->num_channels,
+               end - head, phase, lr->step);
+      break;
+    case SND_PCM_FORMAT_S32_LE:
+      ops->s32((const int32_t*)src, (int32_t*)out, lr->num_channels,
+               end - head, phase, lr->step);
+      break;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      ops->f32((const float*)src, (float*)out, lr->num_channels, end - head,
+               phase, lr->step);
+      break;
+    default:
+      break;
+  }
+  repeat_frame(src, last_idx, dst + end * frame_bytes, frames - end,
+               frame_bytes);
+}
+
 unsigned int linear_resampler_resample(struct linear_resampler* lr,
                                        uint8_t* src,
                                        unsigned int* src_frames,
                                        uint8_t* dst,
                                        unsigned dst_frames) {
-  int ch;
-  unsigned int src_idx = 0;
-  unsigned int dst_idx = 0;
+  unsigned int src_idx;
+  unsigned int dst_idx;
   float src_pos;
-  int16_t *in, *out;
 
   /* Check for corner cases so that we can assume both src_idx and
-   * dst_idx are valid with value 0 in the loop below. */
+   * dst_idx are valid with value 0 below. */
   if (dst_frames == 0 || *src_frames == 0) {
     *src_frames = 0;
     return 0;
   }
 
-  for (dst_idx = 0; dst_idx <= dst_frames; dst_idx++) {
-    src_pos = (float)(lr->dst_offset + dst_idx) / lr->f;
-    if (src_pos > lr->src_offset) {
-      src_pos -= lr->src_offset;
-    } else {
-      src_pos = 0;
-    }
+  /* dst_idx ends up one past the last output frame written, src_idx at
+   * the last source frame used. */
+  dst_idx = find_end_idx(lr, *src_frames, dst_frames);
+  src_pos = src_pos_at(lr, dst_idx);
+  if (src_pos > *src_frames - 1) {
+    src_idx = *src_frames - 1;
+  } else {
     src_idx = (unsigned int)src_pos;
-
-    if (src_pos > *src_frames - 1 || dst_idx >= dst_frames) {
-      if (src_pos > *src_frames - 1) {
-        src_idx = *src_frames - 1;
-      }
-      /* When this loop stops, dst_idx is always at the last
-       * used index incremented by 1. */
-      break;
-    }
-
-    in = (int16_t*)(src + src_idx * lr->format_bytes);
-    out = (int16_t*)(dst + dst_idx * lr->format_bytes);
-
-    /* Don't do linear interpolcation if src_pos falls on the
-     * last index. */
-    if (src_idx == *src_frames - 1) {
-      for (ch = 0; ch < lr->num_channels; ch++) {
-        out[ch] = in[ch];
-      }
-    } else {
-      for (ch = 0; ch < lr->num_channels; ch++) {
-        out[ch] =
-            in[ch] + (src_pos - src_idx) * (in[lr->num_channels + ch] - in[ch]);
-      }
-    }
   }
 
+  resample_frames(lr, src, *src_frames, dst, dst_idx);
+
   *src_frames = src_idx + 1;
 
   lr->src_offset += *src_frames;
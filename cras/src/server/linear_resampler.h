@@ -8,8 +8,18 @@
 
 #include <stdint.h>
 
+#include "cras_audio_format.h"
+
 struct linear_resampler;
 
+// Selects the interpolation kernels for the running CPU.
+void linear_resampler_init();
+
+/* Selects the interpolation kernels for cpu_flags, restricted to the
+ * features the running CPU has. Lets tests and benchmarks compare the
+ * variants, pass 0 for the portable C kernels. */
+void linear_resampler_init_with_flags(unsigned int cpu_flags);
+
 /* Creates a linear resampler.
  * Args:
  *    num_channels - The number of channels in each frames.
@@ -22,6 +32,20 @@ struct linear_resampler* linear_resampler_create(unsigned int num_channels,
                                                  float src_rate,
                                                  float dst_rate);
 
+/* Creates a linear resampler working on samples of the given format.
+ * Args:
+ *    num_channels - The number of channels in each frames.
+ *    format - The sample format, SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S32_LE
+ *        or SND_PCM_FORMAT_FLOAT_LE.
+ *    src_rate - The source rate to resample from.
+ *    dst_rate - The destination rate to resample to.
+ */
+struct linear_resampler* linear_resampler_create_with_format(
+    unsigned int num_channels,
+    snd_pcm_format_t format,
+    float src_rate,
+    float dst_rate);
+
 /* Sets the rates for the linear resampler.
  * Args:
  *    from - The rate to resample from.
@@ -0,0 +1,162 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/server/linear_resampler_ops.h"
+
+#include <stdint.h>
+#include <sys/param.h>
+
+/* This file is compiled once per instruction set and relies on the compiler
+ * to vectorize the loops. The kernels are instantiated for the common
+ * channel counts so those get loops with constant strides. */
+#ifdef OPS_AVX2
+#define OPS(a) a##_avx2
+#elif defined(OPS_NEON)
+#define OPS(a) a##_neon
+#else
+#define OPS(a) a
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define PHASE_ONE ((uint64_t)1 << LINEAR_RESAMPLER_PHASE_BITS)
+
+// Output frames whose source positions are computed at once.
+#define BLOCK_FRAMES 64
+// The most channels the kernels copy neighbours for, see below.
+#define SPLIT_MAX_CHANNELS 8
+
+/* Splits the source positions of n output frames into the sample offset of
+ * the frame before them and the fraction towards the next one. There is no
+ * branch nor data dependency between the frames so the loop vectorizes. */
+ALWAYS_INLINE void positions(uint64_t phase,
+                             uint64_t step,
+                             size_t channels,
+                             size_t n,
+                             uint32_t* __restrict__ offset,
+                             float* __restrict__ frac) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    uint64_t pos = phase + i * step;
+
+    offset[i] = (uint32_t)(pos >> LINEAR_RESAMPLER_PHASE_BITS) * channels;
+    frac[i] = (float)(uint32_t)pos * (1.0f / PHASE_ONE);
+  }
+}
+
+/* S16 and float round the same way the per-frame float code did: the value
+ * is computed in float and truncated toward zero. A zero fraction yields the
+ * first sample exactly, so it needs no special case. */
+ALWAYS_INLINE int16_t interp_s16(int16_t a, int16_t b, float frac) {
+  return a + frac * (b - a);
+}
+
+ALWAYS_INLINE int32_t interp_s32(int32_t a, int32_t b, float frac) {
+  /* The difference needs 33 bits and float only has 24, use double. It holds
+   * the difference exactly, and unlike int64_t converts in vector registers. */
+  return a + (double)frac * ((double)b - a);
+}
+
+ALWAYS_INLINE float interp_f32(float a, float b, float frac) {
+  return a + frac * (b - a);
+}
+
+/* Defines the kernel of one sample type. The source positions of a block of
+ * output frames are computed first, then the frames are interpolated from
+ * them without branches.
+ * For the common channel counts, the two neighbours of every output sample
+ * are first copied to contiguous arrays and then interpolated in a single
+ * vectorized pass, the samples of one frame are too few to fill vectors.
+ * Other channel counts interpolate frame by frame, with the loop over the
+ * channels vectorized. */
+#define DEFINE_RESAMPLE_KERNEL(name, type, interp)                            \
+  ALWAYS_INLINE void name##_split(                                            \
+      const type* __restrict__ in, type* __restrict__ out, size_t channels,   \
+      size_t frames, uint64_t phase, uint64_t step) {                         \
+    uint32_t offset[BLOCK_FRAMES];                                            \
+    float frac[BLOCK_FRAMES];                                                 \
+    type a[BLOCK_FRAMES * SPLIT_MAX_CHANNELS];                                \
+    type b[BLOCK_FRAMES * SPLIT_MAX_CHANNELS];                                \
+    float f[BLOCK_FRAMES * SPLIT_MAX_CHANNELS];                               \
+                                                                              \
+    while (frames) {                                                          \
+      size_t n = MIN(frames, BLOCK_FRAMES);                                   \
+      size_t i, ch;                                                           \
+                                                                              \
+      positions(phase, step, channels, n, offset, frac);                      \
+      for (i = 0; i < n; i++) {                                               \
+        const type* s = in + offset[i];                                       \
+        for (ch = 0; ch < channels; ch++) {                                   \
+          a[i * channels + ch] = s[ch];                                       \
+          b[i * channels + ch] = s[channels + ch];                            \
+          f[i * channels + ch] = frac[i];                                     \
+        }                                                                     \
+      }                                                                       \
+      for (i = 0; i < n * channels; i++) {                                    \
+        out[i] = interp(a[i], b[i], f[i]);                                    \
+      }                                                                       \
+      phase += n * step;                                                      \
+      out += n * channels;                                                    \
+      frames -= n;                                                            \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  ALWAYS_INLINE void name##_channels(                                         \
+      const type* __restrict__ in, type* __restrict__ out, size_t channels,   \
+      size_t frames, uint64_t phase, uint64_t step) {                         \
+    uint32_t offset[BLOCK_FRAMES];                                            \
+    float frac[BLOCK_FRAMES];                                                 \
+                                                                              \
+    while (frames) {                                                          \
+      size_t n = MIN(frames, BLOCK_FRAMES);                                   \
+      size_t i, ch;                                                           \
+                                                                              \
+      positions(phase, step, channels, n, offset, frac);                      \
+      for (i = 0; i < n; i++) {                                               \
+        const type* s = in + offset[i];                                       \
+        for (ch = 0; ch < channels; ch++) {                                   \
+          out[i * channels + ch] = interp(s[ch], s[channels + ch], frac[i]);  \
+        }                                                                     \
+      }                                                                       \
+      phase += n * step;                                                      \
+      out += n * channels;                                                    \
+      frames -= n;                                                            \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  static void OPS(name)(const type* in, type* out, size_t channels,           \
+                        size_t frames, uint64_t phase, uint64_t step) {       \
+    switch (channels) {                                                       \
+      case 1:                                                                 \
+        name##_split(in, out, 1, frames, phase, step);                        \
+        break;                                                                \
+      case 2:                                                                 \
+        name##_split(in, out, 2, frames, phase, step);                        \
+        break;                                                                \
+      case 4:                                                                 \
+        name##_split(in, out, 4, frames, phase, step);                        \
+        break;                                                                \
+      case 6:                                                                 \
+        name##_split(in, out, 6, frames, phase, step);                        \
+        break;                                                                \
+      case 8:                                                                 \
+        name##_split(in, out, 8, frames, phase, step);                        \
+        break;                                                                \
+      default:                                                                \
+        name##_channels(in, out, channels, frames, phase, step);              \
+        break;                                                                \
+    }                                                                         \
+  }
+
+DEFINE_RESAMPLE_KERNEL(resample_s16, int16_t, interp_s16)
+DEFINE_RESAMPLE_KERNEL(resample_s32, int32_t, interp_s32)
+DEFINE_RESAMPLE_KERNEL(resample_f32, float, interp_f32)
+
+const struct linear_resampler_ops OPS(linear_resampler_ops) = {
+    .s16 = OPS(resample_s16),
+    .s32 = OPS(resample_s32),
+    .f32 = OPS(resample_f32),
+};
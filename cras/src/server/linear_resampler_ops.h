@@ -0,0 +1,50 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_SERVER_LINEAR_RESAMPLER_OPS_H_
+#define CRAS_SRC_SERVER_LINEAR_RESAMPLER_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern const struct linear_resampler_ops linear_resampler_ops;
+extern const struct linear_resampler_ops linear_resampler_ops_avx2;
+extern const struct linear_resampler_ops linear_resampler_ops_neon;
+
+// Fractional bits of the fixed point source positions.
+#define LINEAR_RESAMPLER_PHASE_BITS 32
+
+/* Linear interpolation kernels. Different architectures build the same
+ * kernels with their own vector instructions and wrap them into
+ * linear_resampler_ops. Every variant produces the same samples.
+ *
+ * Each kernel writes frames interleaved output frames of channels samples.
+ * Output frame i is interpolated at source position phase + i * step, in
+ * 32.32 fixed point frames from in. The caller clamps the positions, every
+ * one of them must be before the last source frame so both neighbours can
+ * be read.
+ */
+struct linear_resampler_ops {
+  void (*s16)(const int16_t* in,
+              int16_t* out,
+              size_t channels,
+              size_t frames,
+              uint64_t phase,
+              uint64_t step);
+  void (*s32)(const int32_t* in,
+              int32_t* out,
+              size_t channels,
+              size_t frames,
+              uint64_t phase,
+              uint64_t step);
+  void (*f32)(const float* in,
+              float* out,
+              size_t channels,
+              size_t frames,
+              uint64_t phase,
+              uint64_t step);
+};
+
+#endif
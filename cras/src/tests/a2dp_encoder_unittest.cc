@@ -0,0 +1,285 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+extern "C" {
+#include "cras/src/common/cras_audio_codec.h"
+#include "cras/src/server/cras_a2dp_encoder.h"
+#include "cras/src/server/cras_a2dp_info.h"
+#include "cras/src/tests/sbc_codec_stub.h"
+#include "third_party/bluez/rtp.h"
+}
+
+namespace {
+
+// Stereo S16_LE, 128 frames in each block, encoded to 64 bytes.
+const size_t kFormatBytes = 4;
+const int kCodeSize = 512;
+const int kFrameLength = 64;
+const size_t kHeaderLength = sizeof(struct rtp_header) + sizeof(rtp_payload);
+// Four encoded blocks in each packet.
+const size_t kMtu = kHeaderLength + 4 * kFrameLength;
+const unsigned int kWriteBlock = 4 * kCodeSize / kFormatBytes;
+const unsigned int kRingFrames = 2 * kWriteBlock;
+
+/* Encodes each block to its first kFrameLength bytes, which start with the
+ * index of its first frame. */
+static int fake_encode(struct cras_audio_codec* codec,
+                       const void* input,
+                       size_t input_len,
+                       void* output,
+                       size_t output_len,
+                       size_t* count) {
+  size_t processed = 0;
+
+  *count = 0;
+  while (input_len - processed >= kCodeSize &&
+         output_len - *count >= kFrameLength) {
+    memcpy((uint8_t*)output + *count, (const uint8_t*)input + processed,
+           kFrameLength);
+    processed += kCodeSize;
+    *count += kFrameLength;
+  }
+  return processed;
+}
+
+struct WriteResults {
+  std::atomic<int> packets;
+  std::atomic<int> frames;
+  std::atomic<int> error;
+};
+
+static void write_done(void* arg, int written, const struct timespec* now) {
+  WriteResults* results = static_cast<WriteResults*>(arg);
+  if (written < 0) {
+    results->error = written;
+  } else {
+    results->packets++;
+    results->frames += written;
+  }
+}
+
+class A2dpEncoder : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    a2dp_sbc_t sbc = {};
+
+    signal(SIGPIPE, SIG_IGN);
+    sbc_codec_stub_reset();
+    ASSERT_EQ(0, init_a2dp(&a2dp_, &sbc));
+    a2dp_.codec->encode = fake_encode;
+    a2dp_.codesize = kCodeSize;
+    a2dp_.frame_length = kFrameLength;
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds_));
+
+    config_.a2dp = &a2dp_;
+    config_.fd = fds_[0];
+    config_.mtu = kMtu;
+    config_.format_bytes = kFormatBytes;
+    // Rounded down to two packets.
+    config_.max_ring_bytes = kRingFrames * kFormatBytes + kCodeSize - 1;
+    config_.write_block = kWriteBlock;
+    config_.flush_period = {0, 5000000};
+    config_.min_buffer_level = kWriteBlock;
+    config_.write_done = write_done;
+    config_.arg = &results_;
+    results_.packets = 0;
+    results_.frames = 0;
+    results_.error = 0;
+    next_frame_ = 0;
+  }
+
+  virtual void TearDown() {
+    close(fds_[0]);
+    if (fds_[1] >= 0) {
+      close(fds_[1]);
+    }
+    destroy_a2dp(&a2dp_);
+  }
+
+  // Writes increasing frame indexes to the ring, as much as it takes.
+  unsigned int WritePcm(struct cras_a2dp_encoder* enc, unsigned int frames) {
+    uint32_t* buf = (uint32_t*)cras_a2dp_encoder_get_buffer(enc, &frames);
+    for (unsigned int i = 0; i < frames; i++) {
+      buf[i] = next_frame_++;
+    }
+    EXPECT_EQ(0, cras_a2dp_encoder_put_buffer(enc, frames));
+    return frames;
+  }
+
+  // Starts the encoder thread to write the first packet now.
+  void Start(struct cras_a2dp_encoder* enc) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    cras_a2dp_encoder_start(enc, &now);
+  }
+
+  struct a2dp_info a2dp_;
+  int fds_[2];
+  struct cras_a2dp_encoder_config config_;
+  WriteResults results_;
+  uint32_t next_frame_;
+};
+
+TEST_F(A2dpEncoder, RingIsWholeBlocks) {
+  struct cras_a2dp_encoder* enc = cras_a2dp_encoder_create(&config_);
+  ASSERT_NE(nullptr, enc);
+  EXPECT_EQ(kRingFrames, cras_a2dp_encoder_ring_frames(enc));
+  cras_a2dp_encoder_destroy(enc);
+
+  config_.max_ring_bytes = kCodeSize - 1;
+  EXPECT_EQ(nullptr, cras_a2dp_encoder_create(&config_));
+}
+
+TEST_F(A2dpEncoder, GetPutBufferBeforeStart) {
+  struct cras_a2dp_encoder* enc = cras_a2dp_encoder_create(&config_);
+  ASSERT_NE(nullptr, enc);
+
+  EXPECT_EQ(300u, WritePcm(enc, 300));
+  EXPECT_EQ(300u, cras_a2dp_encoder_queued_frames(enc));
+  // Only the rest of the ring is available until the thread reads from it.
+  EXPECT_EQ(kRingFrames - 300, WritePcm(enc, kRingFrames));
+  EXPECT_EQ(kRingFrames, cras_a2dp_encoder_queued_frames(enc));
+
+  unsigned int frames = 100;
+  cras_a2dp_encoder_get_buffer(enc, &frames);
+  EXPECT_EQ(0u, frames);
+  EXPECT_EQ(-EINVAL, cras_a2dp_encoder_put_buffer(enc, 1));
+
+  cras_a2dp_encoder_destroy(enc);
+  EXPECT_EQ(0, results_.packets);
+}
+
+TEST_F(A2dpEncoder, WritesPacketsInOrder) {
+  struct cras_a2dp_encoder* enc = cras_a2dp_encoder_create(&config_);
+  ASSERT_NE(nullptr, enc);
+
+  WritePcm(enc, kRingFrames);
+  Start(enc);
+
+  uint8_t packet[kMtu + 1];
+  uint32_t expected_frame = 0;
+  for (uint16_t seq = 0; seq < 8; seq++) {
+    struct pollfd pfd = {fds_[1], POLLIN, 0};
+    while (poll(&pfd, 1, 1) == 0) {
+      WritePcm(enc, kRingFrames);
+    }
+    ASSERT_EQ((ssize_t)kMtu, recv(fds_[1], packet, sizeof(packet), 0));
+
+    struct rtp_header* header = (struct rtp_header*)packet;
+    struct rtp_payload* payload =
+        (struct rtp_payload*)(packet + sizeof(*header));
+    EXPECT_EQ(seq, ntohs(header->sequence_number));
+    EXPECT_EQ(4, payload->frame_count);
+    for (int i = 0; i < 4; i++) {
+      uint32_t first_frame;
+      memcpy(&first_frame, packet + kHeaderLength + i * kFrameLength,
+             sizeof(first_frame));
+      EXPECT_EQ(expected_frame, first_frame);
+      expected_frame += kCodeSize / kFormatBytes;
+    }
+  }
+  cras_a2dp_encoder_destroy(enc);
+
+  EXPECT_LE(8, results_.packets);
+  EXPECT_EQ(results_.packets * (int)kWriteBlock, results_.frames);
+  EXPECT_EQ(0, results_.error);
+}
+
+TEST_F(A2dpEncoder, PacedByFlushPeriod) {
+  struct cras_a2dp_encoder* enc = cras_a2dp_encoder_create(&config_);
+  struct timespec begin, end;
+  uint8_t packet[kMtu + 1];
+  ASSERT_NE(nullptr, enc);
+
+  WritePcm(enc, kRingFrames);
+  Start(enc);
+  for (int i = 0; i < 6; i++) {
+    struct pollfd pfd = {fds_[1], POLLIN, 0};
+    while (poll(&pfd, 1, 1) == 0) {
+      WritePcm(enc, kRingFrames);
+    }
+    ASSERT_EQ((ssize_t)kMtu, recv(fds_[1], packet, sizeof(packet), 0));
+    if (i == 0) {
+      clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+  cras_a2dp_encoder_destroy(enc);
+
+  // Five more packets take five flush periods, less the 1ms wake up fuzz.
+  int64_t elapsed_us = (end.tv_sec - begin.tv_sec) * 1000000 +
+                       (end.tv_nsec - begin.tv_nsec) / 1000;
+  EXPECT_GE(elapsed_us, 5 * 4000);
+}
+
+TEST_F(A2dpEncoder, CountsUnderrunsAndLateWrites) {
+  struct cras_a2dp_encoder* enc = cras_a2dp_encoder_create(&config_);
+  struct cras_a2dp_encoder_stats stats;
+  uint8_t packet[kMtu + 1];
+  ASSERT_NE(nullptr, enc);
+
+  // The thread has nothing to write for some flush periods.
+  Start(enc);
+  usleep(50000);
+  WritePcm(enc, kWriteBlock);
+  ASSERT_EQ((ssize_t)kMtu, recv(fds_[1], packet, sizeof(packet), 0));
+  // The stats are updated before write_done is called.
+  while (results_.packets < 1) {
+    usleep(1000);
+  }
+  cras_a2dp_encoder_get_stats(enc, &stats);
+  cras_a2dp_encoder_destroy(enc);
+
+  EXPECT_EQ(1u, stats.packets);
+  EXPECT_EQ(1u, stats.underruns);
+  // Written about 50ms after it was due.
+  EXPECT_EQ(1u, stats.late_writes);
+  // The packet was the whole ring when written.
+  EXPECT_EQ(0u, stats.max_queued_frames);
+}
+
+TEST_F(A2dpEncoder, StopsOnSocketError) {
+  struct cras_a2dp_encoder* enc = cras_a2dp_encoder_create(&config_);
+  ASSERT_NE(nullptr, enc);
+
+  close(fds_[1]);
+  fds_[1] = -1;
+  WritePcm(enc, kWriteBlock);
+  Start(enc);
+
+  int err = 0;
+  for (int i = 0; i < 1000 && !err; i++) {
+    unsigned int frames = 1;
+    cras_a2dp_encoder_get_buffer(enc, &frames);
+    err = cras_a2dp_encoder_put_buffer(enc, 0);
+    if (!err) {
+      usleep(1000);
+    }
+  }
+  EXPECT_EQ(-EPIPE, err);
+  EXPECT_EQ(-EPIPE, results_.error);
+  EXPECT_EQ(0, results_.packets);
+  cras_a2dp_encoder_destroy(enc);
+}
+
+}  // namespace
+
+extern "C" {
+int cras_audio_thread_event_a2dp_throttle() {
+  return 0;
+}
+}  // extern "C"
@@ -0,0 +1,174 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+extern "C" {
+#include "cras/src/server/cras_a2dp_flow_ctrl.h"
+}
+
+namespace {
+
+// SBC at 44.1kHz, a 53 bitpool packet of 896 frames about every 20ms.
+const int kMinBitpool = 2;
+const int kMaxBitpool = 53;
+const int kWriteBlock = 896;
+const int kPeriodMs = 20;
+
+static struct timespec ms_to_ts(int ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+  return ts;
+}
+
+/* Generates a trace of a write every |kPeriodMs| from |begin_ms| to
+ * |end_ms|, in the format replayed by Replay. */
+static std::string Writes(int begin_ms,
+                          int end_ms,
+                          int written,
+                          int late_ms,
+                          int sock_percent) {
+  std::ostringstream trace;
+  for (int ms = begin_ms; ms < end_ms; ms += kPeriodMs) {
+    trace << ms << " " << written << " " << late_ms << " " << sock_percent
+          << "\n";
+  }
+  return trace.str();
+}
+
+class A2dpFlowCtrl : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    struct timespec start = ms_to_ts(0);
+    a2dp_flow_ctrl_init(&ctrl_, kMinBitpool, kMaxBitpool, &start);
+    changes_ = 0;
+  }
+
+  /* Replays a trace of packet writes, one in each line as
+   * "<ms> <written> <late_ms> <sock_percent>". The values can be taken from
+   * the A2DP_WRITE and A2DP_THROTTLE_TIME events of an audio thread dump,
+   * with EAGAIN written as -11. */
+  void Replay(const std::string& trace) {
+    std::istringstream lines(trace);
+    int ms, written;
+    unsigned int late_ms, sock_percent;
+
+    while (lines >> ms >> written >> late_ms >> sock_percent) {
+      struct timespec now = ms_to_ts(ms);
+      changes_ +=
+          a2dp_flow_ctrl_write(&ctrl_, &now, written, late_ms, sock_percent);
+    }
+  }
+
+  struct a2dp_flow_ctrl ctrl_;
+  int changes_;
+};
+
+TEST_F(A2dpFlowCtrl, CleanLinkKeepsMaxBitpool) {
+  Replay(Writes(0, 30000, kWriteBlock, 2, 30));
+
+  EXPECT_EQ(0, changes_);
+  EXPECT_EQ(kMaxBitpool, ctrl_.bitpool);
+  EXPECT_EQ(1u, ctrl_.level);
+  EXPECT_EQ(kMaxBitpool, ctrl_.lowest_bitpool);
+}
+
+TEST_F(A2dpFlowCtrl, IgnoresEmptyWritesAndOtherErrors) {
+  Replay(Writes(0, 5000, 0, 0, 0));
+  Replay(Writes(5000, 10000, -EPIPE, 50, 100));
+
+  EXPECT_EQ(0, changes_);
+  EXPECT_EQ(0u, ctrl_.writes);
+}
+
+TEST_F(A2dpFlowCtrl, BacksOffOncePerCongestedWindow) {
+  // One EAGAIN, one late write and a full socket in three windows.
+  Replay(
+      "0 896 0 0\n"
+      "20 -11 0 100\n"
+      "500 896 0 0\n"
+      "520 896 25 0\n"
+      "1000 896 0 0\n"
+      "1020 896 0 100\n"
+      "1040 896 0 100\n"
+      "1500 896 0 100\n");
+
+  EXPECT_EQ(3, changes_);
+  // 53 * 3 / 4 = 39, 39 * 3 / 4 = 29, then the floor of 53 / 2.
+  EXPECT_EQ(26, ctrl_.bitpool);
+  EXPECT_EQ(4u, ctrl_.level);
+  EXPECT_EQ(26, ctrl_.lowest_bitpool);
+  EXPECT_EQ(4u, ctrl_.highest_level);
+
+  // Still congested at the lowest bitpool and highest level.
+  Replay("1520 -11 0 100\n2000 -11 0 100\n");
+  EXPECT_EQ(3, changes_);
+  EXPECT_EQ(26, ctrl_.bitpool);
+}
+
+TEST_F(A2dpFlowCtrl, HalfFullSocketIsNotCongested) {
+  Replay(Writes(0, 10000, kWriteBlock, 0, 50));
+  EXPECT_EQ(kMaxBitpool, ctrl_.bitpool);
+
+  Replay(Writes(10000, 10600, kWriteBlock, 0, 60));
+  EXPECT_GT(kMaxBitpool, ctrl_.bitpool);
+}
+
+TEST_F(A2dpFlowCtrl, RecoversAfterCongestionBurst) {
+  Replay(Writes(0, 2000, kWriteBlock, 0, 20));
+  // A second of the socket filling up and writes throttled.
+  Replay(Writes(2000, 3000, -EAGAIN, 40, 100));
+  EXPECT_EQ(29, ctrl_.bitpool);
+  EXPECT_EQ(3u, ctrl_.level);
+
+  // The first clean write closes the last window of the burst.
+  Replay(Writes(3000, 5000, kWriteBlock, 0, 20));
+  EXPECT_EQ(26, ctrl_.bitpool);
+  EXPECT_EQ(4u, ctrl_.level);
+
+  // Four clean windows before each raise, in steps of 4.
+  Replay(Writes(5000, 7000, kWriteBlock, 0, 20));
+  EXPECT_EQ(30, ctrl_.bitpool);
+  EXPECT_EQ(3u, ctrl_.level);
+
+  Replay(Writes(7000, 30000, kWriteBlock, 0, 20));
+  EXPECT_EQ(kMaxBitpool, ctrl_.bitpool);
+  EXPECT_EQ(1u, ctrl_.level);
+  EXPECT_EQ(A2DP_FLOW_CTRL_MIN_PROBE_WINDOWS, ctrl_.probe_windows);
+  EXPECT_EQ(26, ctrl_.lowest_bitpool);
+  EXPECT_EQ(4u, ctrl_.highest_level);
+}
+
+/* A link which only holds up to bitpool 45. Each raise above that congests
+ * it again, so the controller probes it less and less often. */
+TEST_F(A2dpFlowCtrl, ProbesFlappingLinkLessOften) {
+  int congested_windows = 0;
+  bool congested = false;
+
+  for (int ms = 0; ms < 300000; ms += kPeriodMs) {
+    std::ostringstream write;
+    if (ctrl_.bitpool > 45) {
+      write << ms << " -11 30 100\n";
+      if (!congested) {
+        congested_windows++;
+      }
+      congested = true;
+    } else {
+      write << ms << " " << kWriteBlock << " 0 20\n";
+      congested = false;
+    }
+    Replay(write.str());
+  }
+
+  EXPECT_EQ(A2DP_FLOW_CTRL_MAX_PROBE_WINDOWS, ctrl_.probe_windows);
+  /* Without the back off the link would be congested once every few
+   * seconds, about 50 times in five minutes. */
+  EXPECT_GT(20, congested_windows);
+  EXPECT_GE(45, ctrl_.bitpool);
+}
+
+}  // namespace
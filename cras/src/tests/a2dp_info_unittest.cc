@@ -30,6 +30,7 @@ void ResetStubData() {
   sbc.allocation_method = SBC_ALLOCATION_LOUDNESS;
   sbc.subbands = SBC_SUBBANDS_8;
   sbc.block_length = SBC_BLOCK_LENGTH_16;
+  sbc.min_bitpool = 2;
   sbc.max_bitpool = 50;
 
   a2dp.a2dp_buf_used = 0;
@@ -98,6 +99,27 @@ TEST(A2dpInfoInit, ResetA2dp) {
   destroy_a2dp(&a2dp);
 }
 
+TEST(A2dpInfoInit, SetBitpool) {
+  ResetStubData();
+  init_a2dp(&a2dp, &sbc);
+  ASSERT_EQ(2, a2dp.min_bitpool);
+  ASSERT_EQ(50, a2dp.max_bitpool);
+  ASSERT_EQ(50, a2dp.bitpool);
+
+  a2dp_set_bitpool(&a2dp, 35);
+  ASSERT_EQ(35, get_sbc_set_bitpool_val());
+  ASSERT_EQ(35, a2dp.bitpool);
+
+  // Clamped to the range of the configuration.
+  a2dp_set_bitpool(&a2dp, 60);
+  ASSERT_EQ(50, get_sbc_set_bitpool_val());
+  a2dp_set_bitpool(&a2dp, 1);
+  ASSERT_EQ(2, get_sbc_set_bitpool_val());
+  ASSERT_EQ(2, a2dp.bitpool);
+
+  destroy_a2dp(&a2dp);
+}
+
 TEST(A2dpEncode, WriteA2dp) {
   unsigned int processed;
 
@@ -54,6 +54,21 @@ static unsigned int cras_iodev_fill_odev_zeros_frames;
 static int audio_thread_config_events_callback_called;
 static enum AUDIO_THREAD_EVENTS_CB_TRIGGER
     audio_thread_config_events_callback_trigger;
+static bool cras_system_get_bt_a2dp_encoder_thread_ret;
+static struct cras_a2dp_encoder* cras_a2dp_encoder_create_ret;
+static struct cras_a2dp_encoder_config a2dp_encoder_config;
+static int cras_a2dp_encoder_destroy_called;
+static int cras_a2dp_encoder_start_called;
+static unsigned int cras_a2dp_encoder_queued_frames_ret;
+static unsigned int cras_a2dp_encoder_put_buffer_frames;
+static uint8_t fake_encoder_ring[4096];
+static int a2dp_set_bitpool_val;
+static int a2dp_set_bitpool_frame_length;
+static int a2dp_flow_ctrl_write_called;
+static int a2dp_flow_ctrl_write_written;
+static int a2dp_flow_ctrl_write_ret;
+static int a2dp_flow_ctrl_bitpool;
+static unsigned int a2dp_flow_ctrl_level;
 
 void ResetStubData() {
   cras_bt_device_append_iodev_called = 0;
@@ -75,6 +90,17 @@ void ResetStubData() {
   // Fake the MTU value. min_buffer_level will be derived from this value.
   cras_bt_transport_write_mtu_ret = 950;
   cras_iodev_fill_odev_zeros_called = 0;
+  cras_system_get_bt_a2dp_encoder_thread_ret = false;
+  cras_a2dp_encoder_create_ret = NULL;
+  cras_a2dp_encoder_destroy_called = 0;
+  cras_a2dp_encoder_start_called = 0;
+  cras_a2dp_encoder_queued_frames_ret = 0;
+  cras_a2dp_encoder_put_buffer_frames = 0;
+  a2dp_set_bitpool_val = 0;
+  a2dp_set_bitpool_frame_length = FAKE_A2DP_FRAME_LENGTH;
+  a2dp_flow_ctrl_write_called = 0;
+  a2dp_flow_ctrl_write_written = 0;
+  a2dp_flow_ctrl_write_ret = 0;
 
   fake_transport = reinterpret_cast<struct cras_bt_transport*>(0x123);
 
@@ -104,12 +130,14 @@ class A2dpIodev : public testing::Test {
     time_now.tv_sec = 0;
     time_now.tv_nsec = 0;
     atlog = (audio_thread_event_log*)calloc(1, sizeof(audio_thread_event_log));
+    btlog = cras_bt_event_log_init();
   }
 
   virtual void TearDown() {
     free(mock_audio_area);
     mock_audio_area = NULL;
     free(atlog);
+    cras_bt_event_log_deinit(btlog);
   }
 };
 
@@ -712,6 +740,108 @@ TEST_F(A2dpIodev, EnterNoStreamStateAtHighBufferLevelDoesntFillMore) {
   iodev->close_dev(iodev);
   a2dp_iodev_destroy(iodev);
 }
+
+TEST_F(A2dpIodev, EncodeInEncoderThread) {
+  struct cras_iodev* iodev;
+  struct cras_audio_area* area;
+  struct a2dp_io* a2dpio;
+  struct timespec tstamp;
+  unsigned int frames, hw_level;
+
+  cras_system_get_bt_a2dp_encoder_thread_ret = true;
+  cras_a2dp_encoder_create_ret =
+      reinterpret_cast<struct cras_a2dp_encoder*>(0x789);
+  iodev = a2dp_iodev_create(fake_transport);
+  a2dpio = (struct a2dp_io*)iodev;
+
+  iodev_set_format(iodev, &format);
+  iodev->configure_dev(iodev);
+  // The encoder thread writes to the socket instead of the audio thread.
+  EXPECT_EQ(write_callback, (void*)NULL);
+  EXPECT_EQ(&a2dpio->a2dp, a2dp_encoder_config.a2dp);
+  EXPECT_EQ(950, a2dp_encoder_config.mtu);
+  EXPECT_EQ(4, a2dp_encoder_config.format_bytes);
+  EXPECT_EQ(896, a2dp_encoder_config.write_block);
+  EXPECT_EQ(896, a2dp_encoder_config.min_buffer_level);
+  // Fake ring of 1024 frames plus one packet.
+  EXPECT_EQ(1024 + 896, iodev->buffer_size);
+
+  iodev->start(iodev);
+  iodev->state = CRAS_IODEV_STATE_NORMAL_RUN;
+  EXPECT_EQ(1, cras_a2dp_encoder_start_called);
+
+  frames = 1500;
+  iodev->get_buffer(iodev, &area, &frames);
+  EXPECT_EQ(1024, frames);
+  EXPECT_EQ(fake_encoder_ring, area->channels[0].buf);
+  EXPECT_EQ(0, iodev->put_buffer(iodev, 1000));
+  EXPECT_EQ(1000, cras_a2dp_encoder_put_buffer_frames);
+  EXPECT_EQ(0, a2dp_encode_called);
+  EXPECT_EQ(0, a2dp_write_index);
+
+  cras_a2dp_encoder_queued_frames_ret = 1200;
+  EXPECT_EQ(1200, iodev->frames_queued(iodev, &tstamp));
+  EXPECT_EQ(896, iodev->frames_to_play_in_sleep(iodev, &hw_level, &tstamp));
+  EXPECT_EQ(1200 - 896, hw_level);
+
+  // Write results from the encoder thread are tracked.
+  a2dp_encoder_config.write_done(a2dp_encoder_config.arg, -EAGAIN, &time_now);
+  EXPECT_EQ(A2DP_EXIT_LONG_TX_FAILURE, a2dpio->exit_code);
+  EXPECT_TRUE(a2dpio->in_write_fail);
+  a2dp_encoder_config.write_done(a2dp_encoder_config.arg, 896, &time_now);
+  EXPECT_FALSE(a2dpio->in_write_fail);
+
+  // The flow control only runs when writing in the audio thread.
+  EXPECT_EQ(0, a2dp_flow_ctrl_write_called);
+
+  iodev->close_dev(iodev);
+  EXPECT_EQ(1, cras_a2dp_encoder_destroy_called);
+  EXPECT_EQ(1, a2dp_reset_called);
+  EXPECT_EQ(NULL, a2dpio->encoder);
+  a2dp_iodev_destroy(iodev);
+}
+
+TEST_F(A2dpIodev, FlowCtrlAdaptsBitpoolAndBufferLevel) {
+  struct cras_iodev* iodev;
+  struct cras_audio_area* area;
+  struct a2dp_io* a2dpio;
+  unsigned int frames;
+
+  iodev = a2dp_iodev_create(fake_transport);
+  a2dpio = (struct a2dp_io*)iodev;
+
+  iodev_set_format(iodev, &format);
+  iodev->configure_dev(iodev);
+  EXPECT_EQ(53, a2dp_set_bitpool_val);
+  EXPECT_EQ(896, a2dpio->write_block);
+  EXPECT_EQ(896, iodev->min_buffer_level);
+
+  iodev->start(iodev);
+  iodev->state = CRAS_IODEV_STATE_NORMAL_RUN;
+
+  // The link congests, lower the bitpool so frames are encoded to 96 bytes.
+  a2dp_flow_ctrl_write_ret = 1;
+  a2dp_flow_ctrl_bitpool = 40;
+  a2dp_flow_ctrl_level = 2;
+  a2dp_set_bitpool_frame_length = 96;
+  a2dp_write_return_val[0] = 0;
+  frames = 1000;
+  iodev->get_buffer(iodev, &area, &frames);
+  iodev->put_buffer(iodev, 1000);
+  EXPECT_EQ(1, a2dp_write_index);
+  EXPECT_EQ(1, a2dp_flow_ctrl_write_called);
+  EXPECT_EQ(896, a2dp_flow_ctrl_write_written);
+
+  /* Following packets are sized to the new frame length.
+   * (950 - 13) / 96 * 512 / 4 = 1152 */
+  EXPECT_EQ(40, a2dp_set_bitpool_val);
+  EXPECT_EQ(1152, a2dpio->write_block);
+  EXPECT_EQ(2 * 1152, iodev->min_buffer_level);
+  EXPECT_EQ(PCM_BUF_MAX_SIZE_FRAMES + 1152, iodev->buffer_size);
+
+  iodev->close_dev(iodev);
+  a2dp_iodev_destroy(iodev);
+}
 }  // namespace
 
 extern "C" {
@@ -830,9 +960,18 @@ int init_a2dp(struct a2dp_info* a2dp, a2dp_sbc_t* sbc) {
   memset(a2dp, 0, sizeof(*a2dp));
   a2dp->frame_length = FAKE_A2DP_FRAME_LENGTH;
   a2dp->codesize = FAKE_A2DP_CODE_SIZE;
+  a2dp->min_bitpool = 2;
+  a2dp->max_bitpool = 53;
+  a2dp->bitpool = 53;
   return init_a2dp_return_val;
 }
 
+void a2dp_set_bitpool(struct a2dp_info* a2dp, int bitpool) {
+  a2dp_set_bitpool_val = bitpool;
+  a2dp->bitpool = bitpool;
+  a2dp->frame_length = a2dp_set_bitpool_frame_length;
+}
+
 void destroy_a2dp(struct a2dp_info* a2dp) {
   destroy_a2dp_called++;
 }
@@ -951,6 +1090,81 @@ void audio_thread_config_events_callback(
 }
 }
 
+// From cras_system_state
+bool cras_system_get_bt_a2dp_encoder_thread() {
+  return cras_system_get_bt_a2dp_encoder_thread_ret;
+}
+
+// From cras_a2dp_encoder
+struct cras_a2dp_encoder* cras_a2dp_encoder_create(
+    const struct cras_a2dp_encoder_config* config) {
+  a2dp_encoder_config = *config;
+  return cras_a2dp_encoder_create_ret;
+}
+
+void cras_a2dp_encoder_destroy(struct cras_a2dp_encoder* enc) {
+  cras_a2dp_encoder_destroy_called++;
+}
+
+void cras_a2dp_encoder_start(struct cras_a2dp_encoder* enc,
+                             const struct timespec* next_flush_time) {
+  cras_a2dp_encoder_start_called++;
+}
+
+unsigned int cras_a2dp_encoder_ring_frames(
+    const struct cras_a2dp_encoder* enc) {
+  return sizeof(fake_encoder_ring) / 4;
+}
+
+unsigned int cras_a2dp_encoder_queued_frames(
+    const struct cras_a2dp_encoder* enc) {
+  return cras_a2dp_encoder_queued_frames_ret;
+}
+
+uint8_t* cras_a2dp_encoder_get_buffer(struct cras_a2dp_encoder* enc,
+                                      unsigned int* frames) {
+  *frames = MIN(*frames, sizeof(fake_encoder_ring) / 4);
+  return fake_encoder_ring;
+}
+
+int cras_a2dp_encoder_put_buffer(struct cras_a2dp_encoder* enc,
+                                 unsigned int frames) {
+  cras_a2dp_encoder_put_buffer_frames += frames;
+  return 0;
+}
+
+void cras_a2dp_encoder_get_stats(const struct cras_a2dp_encoder* enc,
+                                 struct cras_a2dp_encoder_stats* stats) {
+  memset(stats, 0, sizeof(*stats));
+}
+
+// From cras_a2dp_flow_ctrl
+void a2dp_flow_ctrl_init(struct a2dp_flow_ctrl* ctrl,
+                         int min_bitpool,
+                         int max_bitpool,
+                         const struct timespec* now) {
+  memset(ctrl, 0, sizeof(*ctrl));
+  ctrl->bitpool = max_bitpool;
+  ctrl->level = 1;
+}
+
+int a2dp_flow_ctrl_write(struct a2dp_flow_ctrl* ctrl,
+                         const struct timespec* now,
+                         int written,
+                         unsigned int late_ms,
+                         unsigned int sock_percent) {
+  a2dp_flow_ctrl_write_called++;
+  a2dp_flow_ctrl_write_written = written;
+  if (a2dp_flow_ctrl_write_ret) {
+    ctrl->bitpool = a2dp_flow_ctrl_bitpool;
+    ctrl->level = a2dp_flow_ctrl_level;
+  }
+  return a2dp_flow_ctrl_write_ret;
+}
+
+// From cras_bt_log
+struct cras_bt_event_log* btlog;
+
 int cras_audio_thread_event_a2dp_overrun() {
   return 0;
 }
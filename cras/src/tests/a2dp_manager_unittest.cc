@@ -34,7 +34,12 @@ static int floss_media_a2dp_set_audio_config_rate;
 static int floss_media_a2dp_set_audio_config_bps;
 static int floss_media_a2dp_set_audio_config_channels;
 static int floss_media_a2dp_start_audio_request_called;
+static int floss_media_a2dp_start_audio_request_ret;
 static int floss_media_a2dp_stop_audio_request_called;
+static int floss_media_a2dp_set_pcm_shm_called;
+static int floss_media_a2dp_set_pcm_shm_header_fd;
+static int floss_media_a2dp_set_pcm_shm_samples_fd;
+static int floss_media_a2dp_set_pcm_shm_ret;
 static int floss_media_a2dp_set_volume_called;
 static int floss_media_a2dp_set_volume_arg;
 static int floss_media_a2dp_get_presentation_position_called;
@@ -49,7 +54,12 @@ void ResetStubData() {
   floss_media_a2dp_set_audio_config_bps = 0;
   floss_media_a2dp_set_audio_config_channels = 0;
   floss_media_a2dp_start_audio_request_called = 0;
+  floss_media_a2dp_start_audio_request_ret = 0;
   floss_media_a2dp_stop_audio_request_called = 0;
+  floss_media_a2dp_set_pcm_shm_called = 0;
+  floss_media_a2dp_set_pcm_shm_header_fd = -1;
+  floss_media_a2dp_set_pcm_shm_samples_fd = -1;
+  floss_media_a2dp_set_pcm_shm_ret = 0;
   floss_media_a2dp_set_volume_called = 0;
   floss_media_a2dp_set_volume_arg = 0;
   floss_media_a2dp_get_presentation_position_called = 0;
@@ -141,6 +151,97 @@ TEST_F(A2dpManagerTestSuite, StartStop) {
   cras_floss_a2dp_destroy(a2dp);
 }
 
+TEST_F(A2dpManagerTestSuite, StartStopShm) {
+  a2dp_pcm_iodev_create_ret =
+      (struct cras_iodev*)calloc(1, sizeof(struct cras_iodev));
+  struct cras_audio_format fmt;
+  struct cras_a2dp* a2dp =
+      cras_floss_a2dp_create(NULL, "addr", "name", &a2dp_codecs);
+
+  ASSERT_NE(a2dp, (struct cras_a2dp*)NULL);
+
+  fmt.frame_rate = 48000;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  fmt.num_channels = 2;
+  EXPECT_EQ(0, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  EXPECT_EQ(1, floss_media_a2dp_set_pcm_shm_called);
+  EXPECT_EQ(11, floss_media_a2dp_set_pcm_shm_header_fd);
+  EXPECT_EQ(12, floss_media_a2dp_set_pcm_shm_samples_fd);
+  EXPECT_EQ(1, floss_media_a2dp_set_audio_config_called);
+  EXPECT_EQ(FL_RATE_48000, floss_media_a2dp_set_audio_config_rate);
+  EXPECT_EQ(FL_SAMPLE_16, floss_media_a2dp_set_audio_config_bps);
+  EXPECT_EQ(1, floss_media_a2dp_start_audio_request_called);
+  // No socket is connected.
+  EXPECT_EQ(-1, cras_floss_a2dp_get_fd(a2dp));
+
+  cras_floss_a2dp_stop(a2dp);
+  EXPECT_EQ(1, floss_media_a2dp_stop_audio_request_called);
+  cras_floss_a2dp_stop(a2dp);
+  EXPECT_EQ(1, floss_media_a2dp_stop_audio_request_called);
+  cras_floss_a2dp_destroy(a2dp);
+}
+
+TEST_F(A2dpManagerTestSuite, StartShmNotSupported) {
+  a2dp_pcm_iodev_create_ret =
+      (struct cras_iodev*)calloc(1, sizeof(struct cras_iodev));
+  struct cras_audio_format fmt;
+  struct cras_a2dp* a2dp =
+      cras_floss_a2dp_create(NULL, "addr", "name", &a2dp_codecs);
+
+  ASSERT_NE(a2dp, (struct cras_a2dp*)NULL);
+
+  fmt.frame_rate = 48000;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  fmt.num_channels = 2;
+  // A failed call only falls back to the socket for this session.
+  floss_media_a2dp_set_pcm_shm_ret = -EIO;
+  EXPECT_EQ(-EOPNOTSUPP, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  floss_media_a2dp_set_pcm_shm_ret = -EBUSY;
+  EXPECT_EQ(-EOPNOTSUPP, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  EXPECT_EQ(2, floss_media_a2dp_set_pcm_shm_called);
+  EXPECT_EQ(0, floss_media_a2dp_start_audio_request_called);
+
+  // Floss without the method isn't asked again, and the socket still works.
+  floss_media_a2dp_set_pcm_shm_ret = -EOPNOTSUPP;
+  EXPECT_EQ(-EOPNOTSUPP, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  EXPECT_EQ(-EOPNOTSUPP, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  EXPECT_EQ(3, floss_media_a2dp_set_pcm_shm_called);
+  EXPECT_EQ(0, cras_floss_a2dp_start(a2dp, &fmt));
+  EXPECT_EQ(fake_skt, cras_floss_a2dp_get_fd(a2dp));
+  EXPECT_EQ(1, floss_media_a2dp_start_audio_request_called);
+
+  cras_floss_a2dp_stop(a2dp);
+  EXPECT_EQ(1, floss_media_a2dp_stop_audio_request_called);
+  cras_floss_a2dp_destroy(a2dp);
+}
+
+TEST_F(A2dpManagerTestSuite, StartShmRequestFails) {
+  a2dp_pcm_iodev_create_ret =
+      (struct cras_iodev*)calloc(1, sizeof(struct cras_iodev));
+  struct cras_audio_format fmt;
+  struct cras_a2dp* a2dp =
+      cras_floss_a2dp_create(NULL, "addr", "name", &a2dp_codecs);
+
+  ASSERT_NE(a2dp, (struct cras_a2dp*)NULL);
+
+  fmt.frame_rate = 48000;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  fmt.num_channels = 2;
+  // Floss took the ring, so the error isn't one to retry with the socket.
+  floss_media_a2dp_start_audio_request_ret = -EIO;
+  EXPECT_EQ(-EIO, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  EXPECT_EQ(1, floss_media_a2dp_start_audio_request_called);
+  EXPECT_EQ(1, floss_media_a2dp_stop_audio_request_called);
+
+  // The ring is offered again for the next session.
+  floss_media_a2dp_start_audio_request_ret = 0;
+  EXPECT_EQ(0, cras_floss_a2dp_start_shm(a2dp, &fmt, 11, 12));
+  EXPECT_EQ(2, floss_media_a2dp_set_pcm_shm_called);
+
+  cras_floss_a2dp_stop(a2dp);
+  cras_floss_a2dp_destroy(a2dp);
+}
+
 TEST_F(A2dpManagerTestSuite, DelaySync) {
   struct cras_audio_format fmt;
   struct cras_a2dp* a2dp;
@@ -449,7 +550,7 @@ int floss_media_a2dp_set_audio_config(struct fl_media* fm,
 int floss_media_a2dp_start_audio_request(struct fl_media* fm,
                                          const char* addr) {
   floss_media_a2dp_start_audio_request_called++;
-  return 0;
+  return floss_media_a2dp_start_audio_request_ret;
 }
 
 int floss_media_a2dp_stop_audio_request(struct fl_media* fm) {
@@ -457,6 +558,15 @@ int floss_media_a2dp_stop_audio_request(struct fl_media* fm) {
   return 0;
 }
 
+int floss_media_a2dp_set_pcm_shm(struct fl_media* fm,
+                                 int header_fd,
+                                 int samples_fd) {
+  floss_media_a2dp_set_pcm_shm_called++;
+  floss_media_a2dp_set_pcm_shm_header_fd = header_fd;
+  floss_media_a2dp_set_pcm_shm_samples_fd = samples_fd;
+  return floss_media_a2dp_set_pcm_shm_ret;
+}
+
 int floss_media_a2dp_set_volume(struct fl_media* fm, unsigned int volume) {
   floss_media_a2dp_set_volume_called++;
   floss_media_a2dp_set_volume_arg = volume;
@@ -11,6 +11,7 @@ extern "C" {
 
 #include <gtest/gtest.h>
 #include <map>
+#include <vector>
 
 #define MAX_CALLS 10
 #define BUFFER_SIZE 8192
@@ -656,6 +657,101 @@ TEST_F(StreamDeviceSuite, AddRemoveMultipleStreamsOnMultipleDevices) {
   TearDownRstream(&rstream3);
 }
 
+TEST_F(StreamDeviceSuite, PollStreamFdWhileAttached) {
+  struct cras_iodev iodev, iodev2;
+  struct cras_iodev* iodevs[] = {&iodev, &iodev2};
+  struct cras_rstream rstream;
+  struct epoll_event ev;
+  int fds[2];
+
+  ASSERT_EQ(0, pipe(fds));
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  SetupDevice(&iodev2, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream, CRAS_STREAM_OUTPUT);
+  rstream.fd = fds[0];
+
+  thread_add_open_dev(thread_, &iodev);
+  thread_add_open_dev(thread_, &iodev2);
+  thread_add_stream(thread_, &rstream, iodevs, 2);
+
+  // A client reply wakes the thread up once.
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  ASSERT_EQ(1, epoll_wait(thread_->stream_epoll_fd, &ev, 1, 0));
+  EXPECT_EQ(fds[0], ev.data.fd);
+  EXPECT_EQ(0, epoll_wait(thread_->stream_epoll_fd, &ev, 1, 0));
+
+  // Still polled while the second device runs the stream.
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev.info.idx);
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  EXPECT_EQ(1, epoll_wait(thread_->stream_epoll_fd, &ev, 1, 0));
+
+  thread_disconnect_stream(thread_, &rstream, NULL);
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  EXPECT_EQ(0, epoll_wait(thread_->stream_epoll_fd, &ev, 1, 0));
+
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev2.info.idx);
+  close(fds[0]);
+  close(fds[1]);
+  TearDownRstream(&rstream);
+}
+
+TEST_F(StreamDeviceSuite, MoveOpenDevsSharingStreams) {
+  struct cras_iodev odev, odev2, odev3;
+  struct cras_iodev* shared_devs[] = {&odev, &odev2};
+  struct cras_iodev* piodev2 = &odev2;
+  struct cras_iodev* piodev3 = &odev3;
+  struct cras_rstream rstream, rstream2, rstream3;
+  struct open_dev* moved[CRAS_NUM_DIRECTIONS] = {};
+  struct audio_thread* worker = create_thread();
+
+  SetupDevice(&odev, CRAS_STREAM_OUTPUT);
+  SetupDevice(&odev2, CRAS_STREAM_OUTPUT);
+  SetupDevice(&odev3, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream2, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream3, CRAS_STREAM_OUTPUT);
+
+  thread_add_open_dev(thread_, &odev);
+  thread_add_open_dev(thread_, &odev2);
+  thread_add_open_dev(thread_, &odev3);
+  thread_add_stream(thread_, &rstream, shared_devs, 2);
+  thread_add_stream(thread_, &rstream2, &piodev2, 1);
+  thread_add_stream(thread_, &rstream3, &piodev3, 1);
+
+  // odev2 shares rstream with odev, so both leave together.
+  EXPECT_EQ(2, thread_detach_open_devs(thread_, &odev, NULL, moved));
+  ASSERT_NE((void*)NULL, moved[CRAS_STREAM_OUTPUT]);
+  EXPECT_EQ(&odev, moved[CRAS_STREAM_OUTPUT]->dev);
+  EXPECT_EQ(&odev2, moved[CRAS_STREAM_OUTPUT]->next->dev);
+  EXPECT_EQ(&odev3, thread_->open_devs[CRAS_STREAM_OUTPUT]->dev);
+  EXPECT_EQ(NULL, thread_->open_devs[CRAS_STREAM_OUTPUT]->next);
+
+  // Attached devices keep their streams.
+  EXPECT_EQ(0, thread_attach_open_devs(worker, moved));
+  EXPECT_EQ(NULL, moved[CRAS_STREAM_OUTPUT]);
+  EXPECT_EQ(1, thread_is_dev_open(worker, &odev));
+  EXPECT_EQ(1, thread_is_dev_open(worker, &odev2));
+  EXPECT_EQ(0, thread_is_dev_open(thread_, &odev));
+  EXPECT_EQ(1, thread_find_stream(worker, &rstream));
+  EXPECT_EQ(1, thread_find_stream(worker, &rstream2));
+  EXPECT_EQ(0, thread_find_stream(worker, &rstream3));
+
+  // Detaching by stream takes the devices running it.
+  EXPECT_EQ(1, thread_detach_open_devs(thread_, NULL, &rstream3, moved));
+  EXPECT_EQ(&odev3, moved[CRAS_STREAM_OUTPUT]->dev);
+  EXPECT_EQ(NULL, thread_->open_devs[CRAS_STREAM_OUTPUT]);
+  EXPECT_EQ(0, thread_detach_open_devs(thread_, &odev, NULL, moved));
+  thread_attach_open_devs(thread_, moved);
+
+  thread_rm_open_dev(worker, CRAS_STREAM_OUTPUT, odev.info.idx);
+  thread_rm_open_dev(worker, CRAS_STREAM_OUTPUT, odev2.info.idx);
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, odev3.info.idx);
+  destroy_thread(worker);
+  TearDownRstream(&rstream);
+  TearDownRstream(&rstream2);
+  TearDownRstream(&rstream3);
+}
+
 TEST_F(StreamDeviceSuite, FetchStreams) {
   struct cras_iodev iodev, *piodev = &iodev;
   struct open_dev* adev;
@@ -1008,28 +1104,129 @@ TEST(AudioThreadStreams, DrainStream) {
 }
 
 TEST(BusyloopDetectSuite, CheckerTest) {
-  continuous_zero_sleep_count = 0;
+  struct audio_thread thread = {};
   cras_audio_thread_event_busyloop_called = 0;
   timespec wait_ts;
   wait_ts.tv_sec = 0;
   wait_ts.tv_nsec = 0;
 
-  check_busyloop(&wait_ts);
-  EXPECT_EQ(continuous_zero_sleep_count, 1);
+  check_busyloop(&thread, &wait_ts);
+  EXPECT_EQ(thread.continuous_zero_sleep_count, 1);
   EXPECT_EQ(cras_audio_thread_event_busyloop_called, 0);
-  check_busyloop(&wait_ts);
-  EXPECT_EQ(continuous_zero_sleep_count, 2);
+  check_busyloop(&thread, &wait_ts);
+  EXPECT_EQ(thread.continuous_zero_sleep_count, 2);
   EXPECT_EQ(cras_audio_thread_event_busyloop_called, 1);
-  check_busyloop(&wait_ts);
-  EXPECT_EQ(continuous_zero_sleep_count, 3);
+  check_busyloop(&thread, &wait_ts);
+  EXPECT_EQ(thread.continuous_zero_sleep_count, 3);
   EXPECT_EQ(cras_audio_thread_event_busyloop_called, 1);
 
   wait_ts.tv_sec = 1;
-  check_busyloop(&wait_ts);
-  EXPECT_EQ(continuous_zero_sleep_count, 0);
+  check_busyloop(&thread, &wait_ts);
+  EXPECT_EQ(thread.continuous_zero_sleep_count, 0);
   EXPECT_EQ(cras_audio_thread_event_busyloop_called, 1);
 }
 
+static std::vector<int> command_done_rcs;
+
+static void command_done(void* data, int rc) {
+  command_done_rcs.push_back(rc);
+}
+
+TEST_F(StreamDeviceSuite, QueuedCommandsCompleteInOrder) {
+  struct cras_iodev iodev;
+  struct audio_thread_open_device_msg msg;
+  struct audio_thread_config_global_remix remix_msg;
+
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  command_done_rcs.clear();
+
+  init_open_device_msg(&msg, AUDIO_THREAD_IS_DEV_OPEN, &iodev);
+  ASSERT_EQ(0, queue_message(thread_, &msg.header, command_done, NULL, NULL));
+  init_open_device_msg(&msg, AUDIO_THREAD_ADD_OPEN_DEV, &iodev);
+  ASSERT_EQ(0, queue_message(thread_, &msg.header, command_done, NULL, NULL));
+  init_open_device_msg(&msg, AUDIO_THREAD_IS_DEV_OPEN, &iodev);
+  ASSERT_EQ(0, queue_message(thread_, &msg.header, command_done, NULL, NULL));
+  // Handlers can write results back to the queued message.
+  init_config_global_remix_msg(&remix_msg);
+  remix_msg.fmt_conv = (struct cras_fmt_conv*)0x1;
+  ASSERT_EQ(0, queue_message(thread_, &remix_msg.header, NULL, NULL, NULL));
+
+  // Nothing completes before the audio thread runs the commands.
+  commands_done(thread_, POLLIN);
+  EXPECT_EQ(0, command_done_rcs.size());
+
+  EXPECT_EQ(0, run_audio_thread_commands(thread_));
+  EXPECT_EQ((void*)NULL,
+            ((struct audio_thread_config_global_remix*)&thread_->cmds->cmds[3]
+                 .msg)
+                ->fmt_conv);
+  thread_->remix_converter = NULL;
+  commands_done(thread_, POLLIN);
+  ASSERT_EQ(3, command_done_rcs.size());
+  EXPECT_EQ(0, command_done_rcs[0]);
+  EXPECT_EQ(0, command_done_rcs[1]);
+  EXPECT_EQ(1, command_done_rcs[2]);
+  EXPECT_EQ(4, thread_->cmds->reaped);
+
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev.info.idx);
+}
+
+TEST_F(StreamDeviceSuite, SyncCommandReapsQueuedCommands) {
+  struct cras_iodev iodev;
+  struct cras_rstream rstream;
+
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream, CRAS_STREAM_OUTPUT);
+  command_done_rcs.clear();
+  ASSERT_EQ(0, audio_thread_start(thread_));
+
+  EXPECT_EQ(0, audio_thread_disconnect_stream_async(thread_, &rstream, NULL,
+                                                    command_done, NULL));
+  EXPECT_EQ(0, audio_thread_is_dev_open(thread_, &iodev));
+  ASSERT_EQ(1, command_done_rcs.size());
+  EXPECT_EQ(0, command_done_rcs[0]);
+
+  TearDownRstream(&rstream);
+}
+
+static int poll_cb_called;
+static int poll_cb_revents;
+
+static int poll_cb(void* data, int revents) {
+  poll_cb_called++;
+  poll_cb_revents = revents;
+  return 0;
+}
+
+TEST_F(StreamDeviceSuite, RunOnlyTriggerPollCallbacks) {
+  int fds[2];
+
+  ASSERT_EQ(0, pipe(fds));
+  poll_cb_called = 0;
+  audio_thread_add_events_callback(fds[0], poll_cb, NULL, POLLIN);
+  run_poll_callbacks();
+  EXPECT_EQ(0, poll_cb_called);
+
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  run_poll_callbacks();
+  EXPECT_EQ(1, poll_cb_called);
+  EXPECT_EQ(POLLIN, poll_cb_revents);
+
+  audio_thread_config_events_callback(fds[0], TRIGGER_NONE);
+  run_poll_callbacks();
+  EXPECT_EQ(1, poll_cb_called);
+
+  audio_thread_config_events_callback(fds[0], TRIGGER_POLL);
+  run_poll_callbacks();
+  EXPECT_EQ(2, poll_cb_called);
+
+  audio_thread_rm_callback(fds[0]);
+  run_poll_callbacks();
+  EXPECT_EQ(2, poll_cb_called);
+  close(fds[0]);
+  close(fds[1]);
+}
+
 extern "C" {
 
 int cras_iodev_add_stream(struct cras_iodev* iodev, struct dev_stream* stream) {
@@ -1059,6 +1256,10 @@ double cras_iodev_get_est_rate_ratio(const struct cras_iodev* iodev) {
   return 1.0;
 }
 
+double cras_iodev_get_rate_est_underrun_ratio(const struct cras_iodev* iodev) {
+  return 1.0;
+}
+
 unsigned int cras_iodev_max_stream_offset(const struct cras_iodev* iodev) {
   return 0;
 }
@@ -1202,8 +1403,19 @@ int cras_set_thread_priority(int priority) {
   return 0;
 }
 
+int cras_system_add_select_fd(int fd,
+                              void (*callback)(void* data, int revents),
+                              void* callback_data,
+                              int events) {
+  return 0;
+}
+
 void cras_system_rm_select_fd(int fd) {}
 
+int cras_system_get_capture_mute() {
+  return 0;
+}
+
 unsigned int dev_stream_capture(struct dev_stream* dev_stream,
                                 const struct cras_audio_area* area,
                                 unsigned int area_offset,
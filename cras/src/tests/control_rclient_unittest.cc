@@ -58,6 +58,7 @@ static size_t cras_observer_ops_are_empty_called;
 static struct cras_observer_ops cras_observer_ops_are_empty_empty_ops;
 static size_t cras_observer_remove_called;
 static struct packet_status_logger wbs_logger;
+static struct cras_sco_io_stats sco_io_stats;
 
 void ResetStubData() {
   cras_rstream_create_return = 0;
@@ -824,6 +825,10 @@ void cras_dsp_reload_ini() {}
 
 void cras_dsp_dump_info() {}
 
+void cras_dsp_fill_debug_info(struct cras_dsp_debug_info* info) {}
+
+void cras_dsp_set_control_all(const char* title, int port, float value) {}
+
 int cras_iodev_list_set_aec_ref(unsigned int stream_id, unsigned int dev_idx) {
   return 0;
 }
@@ -935,6 +940,10 @@ struct packet_status_logger* cras_hfp_ag_get_wbs_logger() {
   return &wbs_logger;
 }
 
+struct cras_sco_io_stats* cras_hfp_ag_get_sco_io_stats() {
+  return &sco_io_stats;
+}
+
 void detect_rtc_stream_pair(struct stream_list* list,
                             struct cras_rstream* stream) {
   return;
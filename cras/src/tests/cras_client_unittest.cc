@@ -206,6 +206,99 @@ TEST_F(CrasClientTestSuite, OutputStreamConnected) {
   StreamConnected(CRAS_STREAM_OUTPUT);
 }
 
+TEST_F(CrasClientTestSuite, OutputStreamConnectedWithEventfds) {
+  struct cras_client_stream_connected msg;
+  int stream_fds[4] = {0, 1, 2, 3};
+  struct cras_audio_format server_format;
+  struct cras_audio_shm_header* header;
+
+  stream_.direction = CRAS_STREAM_OUTPUT;
+  stream_.flags = EVENTFD_WAKEUPS;
+  set_audio_format(&stream_.config->format, SND_PCM_FORMAT_S16_LE, 48000, 2);
+  set_audio_format(&server_format, SND_PCM_FORMAT_S16_LE, 48000, 2);
+
+  header = (struct cras_audio_shm_header*)calloc(1, sizeof(*header));
+  header->config.frame_bytes = 4;
+  header->config.used_size = shm_writable_frames_ * 4;
+  mmap_return_value = header;
+
+  cras_fill_client_stream_connected(&msg, 0, stream_.id, &server_format, 600,
+                                    0);
+  stream_connected(&stream_, &msg, stream_fds, 4);
+
+  EXPECT_EQ(CRAS_THREAD_RUNNING, stream_.thread.state);
+  EXPECT_EQ(2, stream_.notify_fd);
+  EXPECT_EQ(3, stream_.reply_fd);
+  EXPECT_TRUE(stream_.flags & EVENTFD_WAKEUPS);
+}
+
+TEST_F(CrasClientTestSuite, PlaybackRequestThroughEventfds) {
+  struct audio_message aud_msg;
+  uint64_t event = 1;
+  int rc;
+
+  stream_.direction = CRAS_STREAM_OUTPUT;
+  stream_.flags = EVENTFD_WAKEUPS;
+  stream_.shm = InitShm();
+  stream_.thread.state = CRAS_THREAD_RUNNING;
+  ASSERT_EQ(0, pipe(stream_.wake_fds));
+  stream_.notify_fd = eventfd(0, 0);
+  stream_.reply_fd = eventfd(0, EFD_NONBLOCK);
+  ASSERT_GE(stream_.notify_fd, 0);
+  ASSERT_GE(stream_.reply_fd, 0);
+
+  // The server leaves the frames in shm and signals the notify eventfd.
+  cras_shm_set_wakeup_frames(stream_.shm, 480);
+  ASSERT_EQ(sizeof(event), write(stream_.notify_fd, &event, sizeof(event)));
+
+  rc = read_audio_message(&stream_, &aud_msg);
+  EXPECT_EQ(sizeof(event), rc);
+  EXPECT_EQ(AUDIO_MESSAGE_REQUEST_DATA, aud_msg.id);
+  EXPECT_EQ(480, aud_msg.frames);
+
+  // The reply error goes to shm, the wakeup to the reply eventfd.
+  EXPECT_EQ(0, send_playback_reply(&stream_, 480, -EIO));
+  EXPECT_EQ(-EIO, cras_shm_get_reply_error(stream_.shm));
+  event = 0;
+  EXPECT_EQ(sizeof(event), read(stream_.reply_fd, &event, sizeof(event)));
+  EXPECT_EQ(1, event);
+}
+
+TEST_F(CrasClientTestSuite, PlaybackRequestToRing) {
+  struct cras_audio_shm* shm;
+
+  stream_.direction = CRAS_STREAM_OUTPUT;
+  stream_.aud_fd = -1;
+  stream_.config->cb_threshold = 20;
+  stream_.config->aud_cb = capture_samples_ready;
+  shm = InitShm();
+  stream_.shm = shm;
+  // A ring of 128 frames, 100 deep, with 8 frames left before it wraps.
+  cras_shm_set_ring_frames(shm, 128);
+  shm->header->ring_read_frames = 100;
+  shm->header->ring_write_frames = 120;
+
+  // Writes stop at the wrap.
+  stream_.flags = BULK_AUDIO_OK;
+  handle_playback_request(&stream_, 50);
+  EXPECT_EQ(shm->samples + 120 * 4, samples_ready_samples_value);
+  EXPECT_EQ(8, samples_ready_frames_value);
+  EXPECT_EQ(128, shm->header->ring_write_frames);
+
+  // Bulk streams may take more than cb_threshold.
+  handle_playback_request(&stream_, 50);
+  EXPECT_EQ(shm->samples, samples_ready_samples_value);
+  EXPECT_EQ(50, samples_ready_frames_value);
+  EXPECT_EQ(178, shm->header->ring_write_frames);
+
+  // Others get at most cb_threshold.
+  stream_.flags = 0;
+  handle_playback_request(&stream_, 10);
+  handle_playback_request(&stream_, 50);
+  EXPECT_EQ(20, samples_ready_frames_value);
+  EXPECT_EQ(208, shm->header->ring_write_frames);
+}
+
 void CrasClientTestSuite::StreamConnectedFail(CRAS_STREAM_DIRECTION direction) {
   struct cras_client_stream_connected msg;
   int shm_fds[2] = {0, 1};
@@ -2,10 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
 #include <gtest/gtest.h>
+#include <math.h>
 
 #include "cras/src/server/cras_dsp_module.h"
 #include "cras/src/server/cras_dsp_pipeline.h"
+#include "cras/src/server/cras_dsp_thread_pool.h"
 #include "cras_config.h"
 
 #define MAX_MODULES 10
@@ -63,6 +66,12 @@ struct data {
   int deinstantiate_called;
   int free_module_called;
   int get_properties_called;
+  int is_identity_called;
+  int control_changed_called;
+  unsigned long changed_port;
+
+  // The module whose processing this one took over in fuse().
+  struct dsp_module* fused;
 };
 
 static int instantiate(struct dsp_module* module,
@@ -116,12 +125,14 @@ static void run(struct dsp_module* module, unsigned long sample_count) {
     data->data_location[to][0] = data->data_location[from][0];
   }
 
-  // multiply the audio port data by 2
+  /* multiply the audio port data by 2, and by 2 again for a fused module
+   * as it would have done */
+  int gain = data->fused ? 4 : 2;
   for (int i = 0; i < std::min(data->nr_in_audio, data->nr_out_audio); i++) {
     int from = data->in_audio[i];
     int to = data->out_audio[i];
     for (unsigned int j = 0; j < sample_count; j++) {
-      data->data_location[to][j] = data->data_location[from][j] * 2;
+      data->data_location[to][j] = data->data_location[from][j] * gain;
     }
   }
 }
@@ -149,6 +160,28 @@ static int get_properties(struct dsp_module* module) {
 }
 static void dump(struct dsp_module* module, struct dumper* d) {}
 
+static int is_identity(struct dsp_module* module) {
+  struct data* data = (struct data*)module->data;
+  data->is_identity_called++;
+  return 1;
+}
+
+static int fuse(struct dsp_module* module, struct dsp_module* prev) {
+  struct data* data = (struct data*)module->data;
+  data->fused = prev;
+  return 1;
+}
+
+static int is_live_control(struct dsp_module* module, unsigned long port) {
+  return 1;
+}
+
+static void control_changed(struct dsp_module* module, unsigned long port) {
+  struct data* data = (struct data*)module->data;
+  data->control_changed_called++;
+  data->changed_port = port;
+}
+
 static struct dsp_module* create_mock_module(struct plugin* plugin) {
   struct data* data;
   struct dsp_module* module;
@@ -191,6 +224,14 @@ static struct dsp_module* create_mock_module(struct plugin* plugin) {
   module->free_module = &free_module;
   module->get_properties = &get_properties;
   module->dump = &dump;
+  if (strcmp(plugin->label, "identity") == 0) {
+    module->is_identity = &is_identity;
+  } else if (strcmp(plugin->label, "fuse") == 0) {
+    module->fuse = &fuse;
+  } else if (strcmp(plugin->label, "live") == 0) {
+    module->is_live_control = &is_live_control;
+    module->control_changed = &control_changed;
+  }
   return module;
 }
 
@@ -530,4 +571,388 @@ TEST_F(DspPipelineTestSuite, Complex) {
   really_free_module(m5);
 }
 
+TEST_F(DspPipelineTestSuite, Plan) {
+  /*
+   *   0 ==(a0, a1)== 1 ==(b0, b1)== 2 ==(c0, c1)== 3 ==(d0, d1)== 4
+   *
+   * 1 doesn't change the audio data and 3 takes over the processing of 2.
+   */
+  const char* content =
+      "[M0]\n"
+      "library=builtin\n"
+      "label=source\n"
+      "purpose=playback\n"
+      "output_0={a0}\n"
+      "output_1={a1}\n"
+      "[M1]\n"
+      "library=builtin\n"
+      "label=identity\n"
+      "input_0={a0}\n"
+      "input_1={a1}\n"
+      "output_2={b0}\n"
+      "output_3={b1}\n"
+      "[M2]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={b0}\n"
+      "input_1={b1}\n"
+      "output_2={c0}\n"
+      "output_3={c1}\n"
+      "[M3]\n"
+      "library=builtin\n"
+      "label=fuse\n"
+      "input_0={c0}\n"
+      "input_1={c1}\n"
+      "output_2={d0}\n"
+      "output_3={d1}\n"
+      "[M4]\n"
+      "library=builtin\n"
+      "label=sink\n"
+      "purpose=playback\n"
+      "input_0={d0}\n"
+      "input_1={d1}\n";
+  fprintf(fp, "%s", content);
+  CloseFile();
+
+  struct cras_expr_env env = CRAS_EXPR_ENV_INIT;
+  cras_expr_env_install_builtins(&env);
+  cras_expr_env_set_variable_boolean(&env, "swap_lr_disabled", 1);
+
+  struct ini* ini = cras_dsp_ini_create(filename);
+  ASSERT_TRUE(ini);
+  struct pipeline* p = cras_dsp_pipeline_create(ini, &env, "playback");
+  ASSERT_TRUE(p);
+  ASSERT_EQ(0, cras_dsp_pipeline_load(p));
+  ASSERT_EQ(5, num_modules);
+  ASSERT_EQ(0, cras_dsp_pipeline_instantiate(p, 48000, &env));
+
+  struct dsp_module* m[5];
+  struct data* d[5];
+  for (int i = 0; i < 5; i++) {
+    char title[3] = {'m', (char)('0' + i), 0};
+    m[i] = find_module(title);
+    ASSERT_TRUE(m[i]);
+    d[i] = (struct data*)m[i]->data;
+  }
+
+  // Every module runs in place, so the two channels need two buffers.
+  for (int i = 1; i <= 3; i++) {
+    ASSERT_EQ(d[i]->data_location[0], d[i]->data_location[2]);
+    ASSERT_EQ(d[i]->data_location[1], d[i]->data_location[3]);
+  }
+  ASSERT_EQ(d[0]->data_location[0], d[4]->data_location[0]);
+  ASSERT_EQ(d[0]->data_location[1], d[4]->data_location[1]);
+  ASSERT_EQ(2, cras_dsp_pipeline_get_peak_audio_buffers(p));
+
+  ASSERT_EQ(1, d[1]->is_identity_called);
+  ASSERT_EQ(m[2], d[3]->fused);
+
+  int16_t* samples = new int16_t[DSP_BUFFER_SIZE];
+  fill_test_data(samples, DSP_BUFFER_SIZE);
+  cras_dsp_pipeline_apply(p, (uint8_t*)samples, SND_PCM_FORMAT_S16_LE, 100);
+  // m3 does the processing of m2 and itself.
+  verify_processed_data(samples, 100, 2);
+  delete[] samples;
+
+  ASSERT_EQ(1, d[0]->run_called);
+  ASSERT_EQ(0, d[1]->run_called);
+  ASSERT_EQ(0, d[2]->run_called);
+  ASSERT_EQ(1, d[3]->run_called);
+  ASSERT_EQ(1, d[4]->run_called);
+
+  cras_dsp_pipeline_free(p);
+  cras_dsp_ini_free(ini);
+  cras_expr_env_free(&env);
+
+  for (int i = 0; i < 5; i++) {
+    really_free_module(m[i]);
+  }
+}
+
+TEST_F(DspPipelineTestSuite, Profile) {
+  const char* content =
+      "[M0]\n"
+      "library=builtin\n"
+      "label=source\n"
+      "purpose=capture\n"
+      "output_0={a}\n"
+      "[M1]\n"
+      "library=builtin\n"
+      "label=identity\n"
+      "input_0={a}\n"
+      "output_1={b}\n"
+      "[M2]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={b}\n"
+      "output_1={c}\n"
+      "[M3]\n"
+      "library=builtin\n"
+      "label=sink\n"
+      "purpose=capture\n"
+      "input_0={c}\n";
+  fprintf(fp, "%s", content);
+  CloseFile();
+
+  struct cras_expr_env env = CRAS_EXPR_ENV_INIT;
+  struct ini* ini = cras_dsp_ini_create(filename);
+  ASSERT_TRUE(ini);
+  struct pipeline* p = cras_dsp_pipeline_create(ini, &env, "capture");
+  ASSERT_TRUE(p);
+  ASSERT_EQ(0, cras_dsp_pipeline_load(p));
+  ASSERT_EQ(4, num_modules);
+  ASSERT_EQ(0, cras_dsp_pipeline_instantiate(p, 48000, &env));
+
+  struct dsp_module* m[4];
+  for (int i = 0; i < 4; i++) {
+    char title[3] = {'m', (char)('0' + i), 0};
+    m[i] = find_module(title);
+    ASSERT_TRUE(m[i]);
+  }
+
+  float* source = cras_dsp_pipeline_get_source_buffer(p, 0);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 100; j++) {
+      source[j] = 1.0f;
+    }
+    source[10] = NAN;
+    source[20] = 1e-40f;
+    cras_dsp_pipeline_run(p, 100);
+  }
+
+  struct dsp_pipeline_debug_info* info =
+      (struct dsp_pipeline_debug_info*)calloc(1, sizeof(*info));
+  cras_dsp_pipeline_fill_debug_info(p, info);
+  EXPECT_STREQ("capture", info->purpose);
+  EXPECT_EQ(48000, info->sample_rate);
+  ASSERT_EQ(4, info->num_modules);
+
+  const char* titles[] = {"m0", "m1", "m2", "m3"};
+  for (int i = 0; i < 4; i++) {
+    struct dsp_module_debug_info* mod = &info->modules[i];
+    EXPECT_STREQ(titles[i], mod->title);
+    if (i == 1) {
+      // Not run, as it doesn't change the audio data.
+      EXPECT_EQ(0, mod->run);
+      EXPECT_EQ(0, mod->blocks);
+      continue;
+    }
+    EXPECT_EQ(1, mod->run);
+    EXPECT_EQ(3, mod->blocks);
+    EXPECT_EQ(300, mod->samples);
+    uint64_t blocks = 0;
+    for (int k = 0; k < CRAS_DSP_HISTOGRAM_BUCKETS; k++) {
+      blocks += mod->histogram[k];
+    }
+    EXPECT_EQ(3, blocks);
+    EXPECT_GE(mod->total_ns, mod->max_ns);
+    // The sink has no output to look at.
+    EXPECT_EQ(i == 3 ? 0 : 3, mod->nans);
+    EXPECT_EQ(i == 3 ? 0 : 3, mod->denormals);
+  }
+  EXPECT_STREQ("source", info->modules[0].label);
+  free(info);
+
+  cras_dsp_pipeline_free(p);
+  cras_dsp_ini_free(ini);
+  cras_expr_env_free(&env);
+
+  for (int i = 0; i < 4; i++) {
+    really_free_module(m[i]);
+  }
+}
+
+TEST_F(DspPipelineTestSuite, LiveControl) {
+  const char* content =
+      "[M0]\n"
+      "library=builtin\n"
+      "label=source\n"
+      "purpose=capture\n"
+      "output_0={a}\n"
+      "[M1]\n"
+      "library=builtin\n"
+      "label=live\n"
+      "input_0={a}\n"
+      "output_1={b}\n"
+      "input_2=1.5\n"
+      "[M2]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={b}\n"
+      "output_1={c}\n"
+      "input_2=2.5\n"
+      "[M3]\n"
+      "library=builtin\n"
+      "label=sink\n"
+      "purpose=capture\n"
+      "input_0={c}\n";
+  fprintf(fp, "%s", content);
+  CloseFile();
+
+  struct cras_expr_env env = CRAS_EXPR_ENV_INIT;
+  struct ini* ini = cras_dsp_ini_create(filename);
+  ASSERT_TRUE(ini);
+  struct pipeline* p = cras_dsp_pipeline_create(ini, &env, "capture");
+  ASSERT_TRUE(p);
+  ASSERT_EQ(0, cras_dsp_pipeline_load(p));
+  ASSERT_EQ(4, num_modules);
+
+  // Values set before instantiation replace the ones from the ini.
+  EXPECT_EQ(0, cras_dsp_pipeline_set_control_value(p, "m2", 2, 3.5));
+  EXPECT_EQ(-ENOENT, cras_dsp_pipeline_set_control_value(p, "m2", 1, 0));
+  EXPECT_EQ(-ENOENT, cras_dsp_pipeline_set_control_value(p, "m9", 2, 0));
+  ASSERT_EQ(0, cras_dsp_pipeline_instantiate(p, 48000, &env));
+
+  struct dsp_module* m1 = find_module("m1");
+  struct dsp_module* m2 = find_module("m2");
+  ASSERT_TRUE(m1);
+  ASSERT_TRUE(m2);
+  struct data* d1 = (struct data*)m1->data;
+  struct data* d2 = (struct data*)m2->data;
+
+  cras_dsp_pipeline_run(p, 100);
+  EXPECT_EQ(1.5, d1->input[2]);
+  EXPECT_EQ(3.5, d2->input[2]);
+
+  EXPECT_EQ(-ENOENT, cras_dsp_pipeline_find_live_control(p, "m1", 1));
+  EXPECT_EQ(-ENOENT, cras_dsp_pipeline_find_live_control(p, "m1", 3));
+  // m2 doesn't follow its controls while it runs.
+  EXPECT_EQ(-ENOTSUP, cras_dsp_pipeline_find_live_control(p, "m2", 2));
+
+  int control = cras_dsp_pipeline_find_live_control(p, "m1", 2);
+  ASSERT_GE(control, 0);
+  cras_dsp_pipeline_set_live_control(p, control, 0.5);
+  EXPECT_EQ(1, d1->control_changed_called);
+  EXPECT_EQ(2, d1->changed_port);
+  cras_dsp_pipeline_run(p, 100);
+  EXPECT_EQ(0.5, d1->input[2]);
+  EXPECT_EQ(3.5, d2->input[2]);
+
+  cras_dsp_pipeline_free(p);
+  cras_dsp_ini_free(ini);
+  cras_expr_env_free(&env);
+
+  for (int i = 0; i < num_modules; i++) {
+    really_free_module(modules[i]);
+  }
+}
+
+TEST_F(DspPipelineTestSuite, ParallelBranches) {
+  /*
+   *      ==(a0, a1)== 1 ==(b0, b1)== 2 ==(c0, c1)==
+   *   0 <                                          > 5
+   *      ==(a2, a3)== 3 ==(d0, d1)== 4 ==(e0, e1)==
+   *
+   * 1, 2 and 3, 4 are two branches, run on a pool of two helpers.
+   */
+  const char* content =
+      "[M0]\n"
+      "library=builtin\n"
+      "label=source\n"
+      "purpose=capture\n"
+      "output_0={a0}\n"
+      "output_1={a1}\n"
+      "output_2={a2}\n"
+      "output_3={a3}\n"
+      "[M1]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={a0}\n"
+      "input_1={a1}\n"
+      "output_2={b0}\n"
+      "output_3={b1}\n"
+      "[M2]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={b0}\n"
+      "input_1={b1}\n"
+      "output_2={c0}\n"
+      "output_3={c1}\n"
+      "[M3]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={a2}\n"
+      "input_1={a3}\n"
+      "output_2={d0}\n"
+      "output_3={d1}\n"
+      "[M4]\n"
+      "library=builtin\n"
+      "label=foo\n"
+      "input_0={d0}\n"
+      "input_1={d1}\n"
+      "output_2={e0}\n"
+      "output_3={e1}\n"
+      "[M5]\n"
+      "library=builtin\n"
+      "label=sink\n"
+      "purpose=capture\n"
+      "input_0={c0}\n"
+      "input_1={c1}\n"
+      "input_2={e0}\n"
+      "input_3={e1}\n";
+  fprintf(fp, "%s", content);
+  CloseFile();
+
+  struct cras_expr_env env = CRAS_EXPR_ENV_INIT;
+  struct ini* ini = cras_dsp_ini_create(filename);
+  ASSERT_TRUE(ini);
+  struct cras_dsp_thread_pool* pool = cras_dsp_thread_pool_create(2);
+  ASSERT_TRUE(pool);
+  struct pipeline* p = cras_dsp_pipeline_create(ini, &env, "capture");
+  ASSERT_TRUE(p);
+  cras_dsp_pipeline_set_thread_pool(p, pool);
+  ASSERT_EQ(0, cras_dsp_pipeline_load(p));
+  ASSERT_EQ(6, num_modules);
+  ASSERT_EQ(0, cras_dsp_pipeline_instantiate(p, 48000, &env));
+  ASSERT_EQ(2, cras_dsp_pipeline_get_num_branches(p));
+
+  struct dsp_module* m[6];
+  struct data* d[6];
+  for (int i = 0; i < 6; i++) {
+    char title[3] = {'m', (char)('0' + i), 0};
+    m[i] = find_module(title);
+    ASSERT_TRUE(m[i]);
+    d[i] = (struct data*)m[i]->data;
+  }
+
+  // No buffer is written by both branches.
+  for (int i = 1; i <= 2; i++) {
+    for (int j = 3; j <= 4; j++) {
+      for (int a = 0; a < 4; a++) {
+        for (int b = 0; b < 4; b++) {
+          ASSERT_NE(d[i]->data_location[a], d[j]->data_location[b]);
+        }
+      }
+    }
+  }
+
+  for (int n = 0; n < 10; n++) {
+    for (int c = 0; c < 4; c++) {
+      float* source = cras_dsp_pipeline_get_source_buffer(p, c);
+      for (int j = 0; j < 100; j++) {
+        source[j] = c * 100 + j;
+      }
+    }
+    cras_dsp_pipeline_run(p, 100);
+    for (int c = 0; c < 4; c++) {
+      float* sink = cras_dsp_pipeline_get_sink_buffer(p, c);
+      for (int j = 0; j < 100; j++) {
+        ASSERT_EQ((c * 100 + j) * 4, sink[j]);
+      }
+    }
+  }
+  for (int i = 0; i < 6; i++) {
+    ASSERT_EQ(10, d[i]->run_called);
+  }
+
+  cras_dsp_pipeline_free(p);
+  cras_dsp_thread_pool_destroy(pool);
+  cras_dsp_ini_free(ini);
+  cras_expr_env_free(&env);
+
+  for (int i = 0; i < 6; i++) {
+    really_free_module(m[i]);
+  }
+}
+
 }  //  namespace
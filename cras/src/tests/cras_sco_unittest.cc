@@ -238,6 +238,7 @@ TEST(CrasSco, HfpReadWriteFD) {
 
   rc = sco_write(sco);
   ASSERT_EQ(48, rc);
+  ASSERT_EQ(1, sco_send_batch(sco));
 
   rc = recv(sock[0], sample, 48, 0);
   ASSERT_EQ(48, rc);
@@ -279,11 +280,10 @@ TEST(CrasSco, StartCrasScoAndRead) {
   sco = cras_sco_create(fake_device);
   ASSERT_NE(sco, (void*)NULL);
 
-  // Start and send two chunk of fake data
+  // Start and send a chunk of fake data
   cras_sco_set_fd(sco, sock[1]);
   cras_sco_start(48, HFP_CODEC_ID_CVSD, sco);
   send(sock[0], sample, 48, 0);
-  send(sock[0], sample, 48, 0);
 
   // Trigger thread callback
   thread_cb((struct cras_sco*)cb_data, POLLIN);
@@ -295,7 +295,9 @@ TEST(CrasSco, StartCrasScoAndRead) {
   rc = cras_sco_buf_queued(sco, dev.direction);
   ASSERT_EQ(0, rc);
 
-  // Trigger thread callback after idev added.
+  /* Each thread callback reads all the data queued, send another chunk and
+   * trigger thread callback after idev added. */
+  send(sock[0], sample, 48, 0);
   ts.tv_sec = 0;
   ts.tv_nsec = 5000000;
   thread_cb((struct cras_sco*)cb_data, POLLIN);
@@ -521,11 +523,10 @@ TEST_F(CrasScoWithSrBtTestSuite, StartCrasScoAndRead) {
   ASSERT_NE(sco, (void*)NULL);
   ASSERT_EQ(cras_sco_enable_cras_sr_bt(sco, SR_BT_NBS), 0);
 
-  // Start and send two chunk of fake data
+  // Start and send a chunk of fake data
   cras_sco_set_fd(sco, sock[1]);
   cras_sco_start(48, HFP_CODEC_ID_CVSD, sco);
   send(sock[0], sample, 48, 0);
-  send(sock[0], sample, 48, 0);
 
   // Trigger thread callback
   thread_cb((struct cras_sco*)cb_data, POLLIN);
@@ -537,7 +538,9 @@ TEST_F(CrasScoWithSrBtTestSuite, StartCrasScoAndRead) {
   rc = cras_sco_buf_queued(sco, dev.direction);
   ASSERT_EQ(0, rc);
 
-  // Trigger thread callback after idev added.
+  /* Each thread callback reads all the data queued, send another chunk and
+   * trigger thread callback after idev added. */
+  send(sock[0], sample, 48, 0);
   ts.tv_sec = 0;
   ts.tv_nsec = 5000000;
   thread_cb((struct cras_sco*)cb_data, POLLIN);
@@ -666,7 +669,8 @@ TEST(CrasSco, StartCrasScoAndWriteMsbc) {
   ResetStubData();
 
   set_sbc_codec_encoded_out(57);
-  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sock));
+  // Keep the packet boundaries like a SCO socket, the extra bytes are dropped.
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sock));
 
   sco = cras_sco_create(fake_device);
   ASSERT_NE(sco, (void*)NULL);
@@ -699,6 +703,54 @@ TEST(CrasSco, StartCrasScoAndWriteMsbc) {
   cras_sco_destroy(sco);
 }
 
+TEST(CrasSco, ReadWriteQueuedPacketsInBatch) {
+  int rc;
+  int sock[2];
+  uint8_t sample[480];
+  struct cras_sco_io_stats stats;
+
+  ResetStubData();
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sock));
+
+  sco = cras_sco_create(fake_device);
+  ASSERT_NE(sco, (void*)NULL);
+  cras_sco_set_io_stats(sco, &stats);
+
+  cras_sco_set_fd(sco, sock[1]);
+  cras_sco_start(48, HFP_CODEC_ID_CVSD, sco);
+  dev.direction = CRAS_STREAM_INPUT;
+  ASSERT_EQ(0, cras_sco_add_iodev(sco, dev.direction, dev.format));
+
+  // Three packets are queued by the time of the wake up.
+  for (int i = 0; i < 3; i++) {
+    send(sock[0], sample, 48, 0);
+  }
+  thread_cb((struct cras_sco*)cb_data, POLLIN);
+
+  // All of them are read, and as many zero packets are written.
+  EXPECT_EQ(3 * 48 / 2, cras_sco_buf_queued(sco, dev.direction));
+  for (int i = 0; i < 3; i++) {
+    rc = recv(sock[0], sample, sizeof(sample), MSG_DONTWAIT);
+    EXPECT_EQ(48, rc);
+  }
+  EXPECT_EQ(-1, recv(sock[0], sample, sizeof(sample), MSG_DONTWAIT));
+
+  EXPECT_EQ(1, stats.wakeups);
+  EXPECT_EQ(1, stats.recv_calls);
+  EXPECT_EQ(1, stats.send_calls);
+  EXPECT_EQ(3, stats.packets_read);
+  EXPECT_EQ(3, stats.packets_written);
+  EXPECT_EQ(0, stats.packets_erroneous);
+  EXPECT_EQ(1, stats.read_batches[2]);
+  // The packets are timestamped when queued.
+  EXPECT_EQ(1, stats.num_read_delays);
+
+  cras_sco_stop(sco);
+  cras_sco_destroy(sco);
+  close(sock[0]);
+}
+
 TEST(CrasSco, WBSLoggerPacketStatusDumpBinary) {
   struct packet_status_logger logger;
   char log_regex[64];
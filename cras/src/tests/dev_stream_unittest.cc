@@ -1210,7 +1210,8 @@ int config_format_converter(struct cras_fmt_conv** conv,
                             const struct cras_audio_format* from,
                             const struct cras_audio_format* to,
                             enum CRAS_NODE_TYPE node_type,
-                            unsigned int frames) {
+                            unsigned int frames,
+                            int high_res) {
   config_format_converter_called++;
   config_format_converter_from_fmt = from;
   config_format_converter_frames = frames;
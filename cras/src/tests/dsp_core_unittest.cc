@@ -2,17 +2,27 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
 #include <gtest/gtest.h>
 #include <math.h>
 
+#include <vector>
+
+#include "cras/src/dsp/convolver.h"
 #include "cras/src/dsp/crossover.h"
 #include "cras/src/dsp/crossover2.h"
 #include "cras/src/dsp/drc.h"
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/dsp/eq.h"
 #include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
+#include "cras/src/dsp/fft.h"
 #include "cras/src/dsp/quad_rotation.h"
 
+extern "C" {
+#include "cras/src/server/cras_mix.h"
+}
+
 namespace {
 
 // Adds amplitude * sin(pi*freq*i + offset) to the data array.
@@ -165,6 +175,26 @@ TEST(InterleaveTest, All) {
   }
 }
 
+// Returns true if denormal numbers are flushed to zero on this thread.
+static bool flushes_denormals() {
+  volatile float denormal = 1e-40f;
+  volatile float result = denormal * 0.5f;
+  return result == 0;
+}
+
+TEST(DspUtilTest, FpModeFlushesDenormals) {
+  struct dsp_fp_mode mode;
+  bool flushed = flushes_denormals();
+
+  dsp_fp_mode_flush_denormal(&mode);
+#if defined(__i386__) || defined(__x86_64__) || defined(__aarch64__) || \
+    defined(__arm__)
+  EXPECT_TRUE(flushes_denormals());
+#endif
+  dsp_fp_mode_restore(&mode);
+  EXPECT_EQ(flushed, flushes_denormals());
+}
+
 TEST(EqTest, All) {
   struct eq* eq;
   size_t len = 44100;
@@ -299,6 +329,151 @@ TEST(Eq2Test, All) {
   eq2_free(eq2);
 }
 
+TEST(EqnTest, Filters) {
+  struct eqn* eqn;
+  size_t len = 44100;
+  float NQ = len / 2;
+  float f_low = 10 / NQ;
+  float f_mid = 100 / NQ;
+  float f_high = 1000 / NQ;
+  std::vector<std::vector<float>> data(3, std::vector<float>(len));
+  float* ptrs[3];
+
+  dsp_enable_flush_denormal_to_zero();
+
+  // a mixture of 10Hz an 1000Hz sine on every channel
+  for (int c = 0; c < 3; c++) {
+    add_sine(data[c].data(), len, f_low, 0, 1);
+    add_sine(data[c].data(), len, f_high, 0, 1);
+    ptrs[c] = data[c].data();
+  }
+
+  // low pass, high pass and two low shelves
+  eqn = eqn_new(3);
+  EXPECT_EQ(3, eqn_get_num_channels(eqn));
+  EXPECT_EQ(0, eqn_append_biquad(eqn, 0, BQ_LOWPASS, f_mid, 0, 0));
+  EXPECT_EQ(0, eqn_append_biquad(eqn, 1, BQ_HIGHPASS, f_mid, 0, 0));
+  EXPECT_EQ(0, eqn_append_biquad(eqn, 2, BQ_LOWSHELF, f_mid, 0, -6));
+  EXPECT_EQ(0, eqn_append_biquad(eqn, 2, BQ_LOWSHELF, f_mid, 0, -6));
+  EXPECT_EQ(-EINVAL, eqn_append_biquad(eqn, 3, BQ_LOWPASS, f_mid, 0, 0));
+  eqn_process(eqn, ptrs, len);
+  EXPECT_NEAR(1, magnitude_at(ptrs[0], len, f_low), 0.01);
+  EXPECT_NEAR(0, magnitude_at(ptrs[0], len, f_high), 0.01);
+  EXPECT_NEAR(0, magnitude_at(ptrs[1], len, f_low), 0.01);
+  EXPECT_NEAR(1, magnitude_at(ptrs[1], len, f_high), 0.01);
+  EXPECT_NEAR(0.25, magnitude_at(ptrs[2], len, f_low), 0.01);
+  EXPECT_NEAR(1, magnitude_at(ptrs[2], len, f_high), 0.01);
+
+  // Test for empty input
+  eqn_process(eqn, NULL, 0);
+  eqn_free(eqn);
+
+  EXPECT_EQ(NULL, eqn_new(0));
+}
+
+/* Compares every kernel variant the CPU supports against the direct form of
+ * the cascade, with more channels than a vector has lanes and more stages
+ * than eq2 allows. */
+TEST(EqnTest, MatchesReference) {
+  const unsigned int kFlags[] = {0, CPU_X86_AVX2, CPU_ARM_NEON};
+  const int kChannels = 11;
+  const int kFrames = 1000;
+  const float NQ = 48000 / 2;
+
+  for (unsigned int flags : kFlags) {
+    if (flags && !(cpu_get_flags() & flags)) {
+      continue;
+    }
+    struct eqn* eqn = eqn_new_with_flags(kChannels, flags);
+    std::vector<std::vector<struct biquad>> bqs(kChannels);
+    std::vector<std::vector<float>> data(kChannels);
+    std::vector<std::vector<float>> expected(kChannels);
+    float* ptrs[kChannels];
+
+    for (int c = 0; c < kChannels; c++) {
+      for (int s = 0; s < 12 + c % 4; s++) {
+        struct biquad bq;
+
+        biquad_set(&bq, BQ_PEAKING, (200 + 300 * s + 50 * c) / NQ, 2,
+                   (s % 2) ? -3 : 3);
+        bqs[c].push_back(bq);
+        ASSERT_EQ(0, eqn_append_biquad_direct(eqn, c, &bq));
+      }
+      data[c].resize(kFrames);
+      add_sine(data[c].data(), kFrames, (100 + 90 * c) / NQ, c, 0.5);
+      add_sine(data[c].data(), kFrames, (5000 + 70 * c) / NQ, 0, 0.25);
+      expected[c] = data[c];
+      ptrs[c] = data[c].data();
+
+      for (auto& q : bqs[c]) {
+        for (float& x : expected[c]) {
+          float y = q.b0 * x + q.b1 * q.x1 + q.b2 * q.x2 - q.a1 * q.y1 -
+                    q.a2 * q.y2;
+          q.x2 = q.x1;
+          q.x1 = x;
+          q.y2 = q.y1;
+          q.y1 = y;
+          x = y;
+        }
+      }
+    }
+
+    // Split the run so the filter state carries over between calls.
+    eqn_process(eqn, ptrs, 300);
+    for (int c = 0; c < kChannels; c++) {
+      ptrs[c] += 300;
+    }
+    eqn_process(eqn, ptrs, kFrames - 300);
+
+    for (int c = 0; c < kChannels; c++) {
+      for (int i = 0; i < kFrames; i++) {
+        ASSERT_NEAR(expected[c][i], data[c][i], 1e-5)
+            << "flags " << flags << " channel " << c << " frame " << i;
+      }
+    }
+    eqn_free(eqn);
+  }
+}
+
+// Replacing a stage keeps the other channels and stages as they are.
+TEST(EqnTest, SetBiquad) {
+  const int kChannels = 5;
+  size_t len = 44100;
+  float NQ = len / 2;
+  float f_low = 10 / NQ;
+  float f_mid = 100 / NQ;
+  float f_high = 1000 / NQ;
+  std::vector<std::vector<float>> data(kChannels, std::vector<float>(len));
+  float* ptrs[kChannels];
+  struct biquad bq;
+
+  dsp_enable_flush_denormal_to_zero();
+
+  struct eqn* eqn = eqn_new(kChannels);
+  for (int c = 0; c < kChannels; c++) {
+    add_sine(data[c].data(), len, f_low, 0, 1);
+    add_sine(data[c].data(), len, f_high, 0, 1);
+    ptrs[c] = data[c].data();
+    EXPECT_EQ(0, eqn_append_biquad(eqn, c, BQ_LOWPASS, f_mid, 0, 0));
+  }
+  EXPECT_EQ(0, eqn_append_biquad(eqn, 4, BQ_LOWSHELF, f_mid, 0, -6));
+  EXPECT_EQ(1, eqn_get_num_biquads(eqn, 0));
+  EXPECT_EQ(2, eqn_get_num_biquads(eqn, 4));
+
+  biquad_set(&bq, BQ_HIGHPASS, f_mid, 0, 0);
+  EXPECT_EQ(0, eqn_set_biquad(eqn, 4, 0, &bq));
+  EXPECT_EQ(-EINVAL, eqn_set_biquad(eqn, 0, 1, &bq));
+  EXPECT_EQ(-EINVAL, eqn_set_biquad(eqn, kChannels, 0, &bq));
+  eqn_process(eqn, ptrs, len);
+  for (int c = 0; c < kChannels - 1; c++) {
+    EXPECT_NEAR(1, magnitude_at(ptrs[c], len, f_low), 0.01);
+    EXPECT_NEAR(0, magnitude_at(ptrs[c], len, f_high), 0.01);
+  }
+  EXPECT_NEAR(0, magnitude_at(ptrs[4], len, f_low), 0.01);
+  EXPECT_NEAR(1, magnitude_at(ptrs[4], len, f_high), 0.01);
+  eqn_free(eqn);
+}
+
 TEST(CrossoverTest, All) {
   struct crossover xo;
   size_t len = 44100;
@@ -416,6 +591,49 @@ TEST(Crossover2Test, All) {
   free(data2R);
 }
 
+TEST(Crossover2Test, Bands) {
+  const size_t len = 44100;
+  const float NQ = len / 2;
+  const float splits[] = {125 / NQ, 1000 / NQ, 8000 / NQ};
+  // One sine in the middle of each band.
+  const float sines[] = {31 / NQ, 354 / NQ, 2828 / NQ, 20000 / NQ};
+  const int kBands = 4;
+  struct crossover2 xo2;
+  std::vector<std::vector<float>> bands(kBands, std::vector<float>(len));
+  std::vector<float> sum(len);
+  float* data[kBands];
+
+  dsp_enable_flush_denormal_to_zero();
+  crossover2_init_bands(&xo2, kBands, splits);
+  for (int b = 0; b < kBands; b++) {
+    add_sine(bands[0].data(), len, sines[b], 0, 1);
+    data[b] = bands[b].data();
+  }
+
+  // A single channel passed as both halves of the pair.
+  crossover2_process_bands(&xo2, len / 2, data, data);
+  for (int b = 0; b < kBands; b++) {
+    data[b] += len / 2;
+  }
+  crossover2_process_bands(&xo2, len / 2, data, data);
+
+  for (int b = 0; b < kBands; b++) {
+    for (int s = 0; s < kBands; s++) {
+      EXPECT_NEAR(b == s ? 1 : 0, magnitude_at(bands[b].data(), len, sines[s]),
+                  0.05)
+          << "band " << b << " sine " << s;
+    }
+    for (size_t i = 0; i < len; i++) {
+      sum[i] += bands[b][i];
+    }
+  }
+
+  // The bands add up to an allpass of the input.
+  for (int s = 0; s < kBands; s++) {
+    EXPECT_NEAR(1, magnitude_at(sum.data(), len, sines[s]), 0.01);
+  }
+}
+
 TEST(DrcTest, All) {
   size_t len = 44100;
   float NQ = len / 2;
@@ -495,4 +713,297 @@ TEST(DrcTest, All) {
   free(data_right);
 }
 
+static void set_drc_test_params(struct drc* drc) {
+  const float NQ = 44100 / 2;
+
+  for (int i = 0; i < drc->num_bands; i++) {
+    drc_set_param(drc, i, PARAM_CROSSOVER_LOWER_FREQ,
+                  i ? 200 * powf(8, i - 1) / NQ : 0);
+    drc_set_param(drc, i, PARAM_ENABLED, 1);
+    drc_set_param(drc, i, PARAM_THRESHOLD, -30 + 2 * i);
+    drc_set_param(drc, i, PARAM_KNEE, 3 * i);
+    drc_set_param(drc, i, PARAM_RATIO, 3 + i);
+    drc_set_param(drc, i, PARAM_ATTACK, 0.02);
+    drc_set_param(drc, i, PARAM_RELEASE, 0.2);
+    drc_set_param(drc, i, PARAM_POST_GAIN, i);
+  }
+  drc_init(drc);
+}
+
+static void run_drc(struct drc* drc,
+                    std::vector<std::vector<float>>& data,
+                    size_t len) {
+  std::vector<float*> ptrs;
+
+  for (auto& d : data) {
+    ptrs.push_back(d.data());
+  }
+  for (size_t start = 0; start < len; start += DRC_PROCESS_MAX_FRAMES) {
+    int chunk = std::min(len - start, (size_t)DRC_PROCESS_MAX_FRAMES);
+    drc_process(drc, ptrs.data(), chunk);
+    for (auto& p : ptrs) {
+      p += chunk;
+    }
+  }
+}
+
+TEST(DrcTest, InvalidLayout) {
+  EXPECT_EQ(nullptr, drc_new_multichannel(48000, 0, 3));
+  EXPECT_EQ(nullptr, drc_new_multichannel(48000, 2, 0));
+  EXPECT_EQ(nullptr, drc_new_multichannel(48000, 2, DRC_MAX_BANDS + 1));
+}
+
+TEST(DrcTest, MultichannelMatchesStereo) {
+  const size_t len = 44100;
+  const float NQ = len / 2;
+  std::vector<float> input(len);
+  std::vector<std::vector<float>> stereo(2);
+  std::vector<std::vector<float>> multi(3);
+
+  dsp_enable_flush_denormal_to_zero();
+  add_sine(input.data(), len, 62.5 / NQ, 0, 1);
+  add_sine(input.data(), len, 1000 / NQ, 0, 0.5);
+  add_sine(input.data(), len, 16000 / NQ, 0, 0.25);
+  for (auto& d : stereo) {
+    d = input;
+  }
+  for (auto& d : multi) {
+    d = input;
+  }
+
+  struct drc* drc2 = drc_new(44100);
+  struct drc* drc3 = drc_new_multichannel(44100, 3, DRC_NUM_KERNELS);
+  ASSERT_NE(nullptr, drc3);
+  set_drc_test_params(drc2);
+  set_drc_test_params(drc3);
+  run_drc(drc2, stereo, len);
+  run_drc(drc3, multi, len);
+
+  // The odd channel is filtered alone but compressed like the others.
+  for (int c = 0; c < 3; c++) {
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_FLOAT_EQ(stereo[0][i], multi[c][i])
+          << "channel " << c << " frame " << i;
+    }
+  }
+  drc_free(drc2);
+  drc_free(drc3);
+}
+
+TEST(DrcTest, LinkedGain) {
+  const size_t len = 44100;
+  const float f = 1000.0f / (len / 2);
+  const float kAmplitude[] = {1, 0.1, 0.01, 0.001};
+  const int kChannels = 4;
+  std::vector<std::vector<float>> data(kChannels, std::vector<float>(len));
+  struct drc* drc = drc_new_multichannel(44100, kChannels, 1);
+
+  ASSERT_NE(nullptr, drc);
+  dsp_enable_flush_denormal_to_zero();
+  drc->emphasis_disabled = 1;
+  drc_set_param(drc, 0, PARAM_ENABLED, 1);
+  drc_set_param(drc, 0, PARAM_THRESHOLD, -30);
+  drc_set_param(drc, 0, PARAM_KNEE, 0);
+  drc_set_param(drc, 0, PARAM_RATIO, 3);
+  drc_init(drc);
+
+  for (int c = 0; c < kChannels; c++) {
+    add_sine(data[c].data(), len, f, 0, kAmplitude[c]);
+  }
+  run_drc(drc, data, len);
+
+  // The loud channel sets the gain of the quiet ones.
+  float gain = magnitude_at(data[0].data(), len, f) / kAmplitude[0];
+  EXPECT_LT(gain, 0.5);
+  for (int c = 1; c < kChannels; c++) {
+    EXPECT_NEAR(gain, magnitude_at(data[c].data(), len, f) / kAmplitude[c],
+                gain * 1e-3)
+        << "channel " << c;
+  }
+  drc_free(drc);
+}
+
+TEST(DrcTest, KernelVariantsMatch) {
+  const unsigned int kFlags[] = {CPU_X86_AVX2 | CPU_X86_FMA, CPU_ARM_NEON};
+  const size_t len = 20000;
+  const int kChannels = 6;
+  std::vector<std::vector<float>> input(kChannels, std::vector<float>(len));
+
+  dsp_enable_flush_denormal_to_zero();
+  for (int c = 0; c < kChannels; c++) {
+    add_sine(input[c].data(), len, 0.003 * (c + 1), c, 0.9 - 0.1 * c);
+    add_sine(input[c].data(), len, 0.2 + 0.05 * c, 0, 0.1 * c);
+    // A burst so that the kernels attack and release.
+    for (size_t i = len / 4; i < len / 2; i++) {
+      input[c][i] *= 0.05;
+    }
+  }
+
+  struct drc* ref_drc = drc_new_with_flags(44100, kChannels, DRC_MAX_BANDS, 0);
+  std::vector<std::vector<float>> expected = input;
+  set_drc_test_params(ref_drc);
+  run_drc(ref_drc, expected, len);
+  drc_free(ref_drc);
+
+  for (unsigned int flags : kFlags) {
+    if ((cpu_get_flags() & flags) != flags) {
+      continue;
+    }
+    struct drc* drc =
+        drc_new_with_flags(44100, kChannels, DRC_MAX_BANDS, flags);
+    std::vector<std::vector<float>> data = input;
+    set_drc_test_params(drc);
+    run_drc(drc, data, len);
+
+    for (int c = 0; c < kChannels; c++) {
+      for (size_t i = 0; i < len; i++) {
+        ASSERT_NEAR(expected[c][i], data[c][i], 1e-4)
+            << "flags " << flags << " channel " << c << " frame " << i;
+      }
+    }
+    drc_free(drc);
+  }
+}
+
+TEST(DrcTest, InputBiquadsMatchEqInFront) {
+  const size_t len = 20000;
+  const int kChannels = 2;
+  std::vector<std::vector<float>> input(kChannels, std::vector<float>(len));
+  struct biquad bq[2][kChannels];
+
+  dsp_enable_flush_denormal_to_zero();
+  for (int c = 0; c < kChannels; c++) {
+    add_sine(input[c].data(), len, 0.004 * (c + 1), c, 0.9);
+    add_sine(input[c].data(), len, 0.3, 0, 0.1);
+    biquad_set(&bq[0][c], BQ_LOWSHELF, 0.01 * (c + 1), 0, 6);
+    biquad_set(&bq[1][c], BQ_PEAKING, 0.2, 2, -3 - c);
+  }
+
+  // An eqN followed by a DRC.
+  struct eqn* eqn = eqn_new(kChannels);
+  struct drc* ref_drc = drc_new(44100);
+  std::vector<std::vector<float>> expected = input;
+  std::vector<float*> ptrs;
+  for (int c = 0; c < kChannels; c++) {
+    ASSERT_EQ(0, eqn_append_biquad_direct(eqn, c, &bq[0][c]));
+    ASSERT_EQ(0, eqn_append_biquad_direct(eqn, c, &bq[1][c]));
+    ptrs.push_back(expected[c].data());
+  }
+  eqn_process(eqn, ptrs.data(), len);
+  set_drc_test_params(ref_drc);
+  run_drc(ref_drc, expected, len);
+  eqn_free(eqn);
+  drc_free(ref_drc);
+
+  // The same biquads as the input of the DRC.
+  struct drc* drc = drc_new(44100);
+  std::vector<std::vector<float>> data = input;
+  EXPECT_EQ(-EINVAL, drc_append_input_biquad(drc, kChannels, &bq[0][0]));
+  for (int c = 0; c < kChannels; c++) {
+    ASSERT_EQ(0, drc_append_input_biquad(drc, c, &bq[0][c]));
+    ASSERT_EQ(0, drc_append_input_biquad(drc, c, &bq[1][c]));
+  }
+  set_drc_test_params(drc);
+  run_drc(drc, data, len);
+  drc_free(drc);
+
+  for (int c = 0; c < kChannels; c++) {
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_NEAR(expected[c][i], data[c][i], 1e-5)
+          << "channel " << c << " frame " << i;
+    }
+  }
+}
+
+TEST(FftTest, MatchesDft) {
+  const int n = 64;
+  struct fft* fft = fft_new(n);
+  float in[n], re[n / 2 + 1], im[n / 2 + 1], out[n];
+
+  ASSERT_EQ(NULL, fft_new(48));
+  ASSERT_EQ(NULL, fft_new(2));
+  ASSERT_TRUE(fft);
+  EXPECT_EQ(n, fft_get_size(fft));
+
+  for (int i = 0; i < n; i++) {
+    in[i] = sinf(i * 0.37f) + 0.5f * cosf(i * 1.91f) + (i % 5) * 0.1f;
+  }
+  fft_forward(fft, in, re, im);
+  for (int k = 0; k <= n / 2; k++) {
+    double dre = 0, dim = 0;
+    for (int i = 0; i < n; i++) {
+      dre += in[i] * cos(2 * M_PI * i * k / n);
+      dim -= in[i] * sin(2 * M_PI * i * k / n);
+    }
+    EXPECT_NEAR(dre, re[k], 1e-4) << "bin " << k;
+    EXPECT_NEAR(dim, im[k], 1e-4) << "bin " << k;
+  }
+
+  // The inverse is not normalized.
+  fft_inverse(fft, re, im, out);
+  for (int i = 0; i < n; i++) {
+    EXPECT_NEAR(in[i], out[i] / n, 1e-5) << "sample " << i;
+  }
+  fft_free(fft);
+}
+
+TEST(ConvolverTest, InvalidArgs) {
+  float ir[4] = {1};
+
+  EXPECT_EQ(NULL, convolver_new(ir, 0, 64));
+  EXPECT_EQ(NULL, convolver_new(ir, 4, 48));
+  EXPECT_EQ(NULL, convolver_new(ir, 4, CONVOLVER_MIN_BLOCK / 2));
+  EXPECT_EQ(NULL, convolver_new(ir, 4, CONVOLVER_MAX_BLOCK * 2));
+}
+
+/* Compares every kernel variant the CPU supports against direct convolution,
+ * delayed by one block. The response is not a multiple of the block and the
+ * input arrives in chunks of varying size. */
+TEST(ConvolverTest, MatchesDirect) {
+  const unsigned int kFlags[] = {0, CPU_X86_AVX2 | CPU_X86_FMA, CPU_ARM_NEON};
+  const int kBlock = 64;
+  const int kIrLen = 1000;
+  const int kFrames = 3000;
+  const int kChunks[] = {1, 63, 64, 200, 17};
+  std::vector<float> ir(kIrLen), input(kFrames), expected(kFrames);
+
+  for (int i = 0; i < kIrLen; i++) {
+    ir[i] = expf(-i / 200.0f) * sinf(i * 0.21f);
+  }
+  ir[0] = 1;
+  for (int i = 0; i < kFrames; i++) {
+    input[i] = 0.5f * sinf(i * 0.013f) + 0.25f * sinf(i * 0.7f + 1);
+  }
+  for (int i = kBlock; i < kFrames; i++) {
+    double y = 0;
+    for (int k = 0; k < kIrLen && k <= i - kBlock; k++) {
+      y += ir[k] * input[i - kBlock - k];
+    }
+    expected[i] = y;
+  }
+
+  for (unsigned int flags : kFlags) {
+    if ((cpu_get_flags() & flags) != flags) {
+      continue;
+    }
+    struct convolver* conv =
+        convolver_new_with_flags(ir.data(), kIrLen, kBlock, flags);
+    std::vector<float> data = input;
+
+    ASSERT_TRUE(conv);
+    EXPECT_EQ(kBlock, convolver_get_delay(conv));
+    for (int i = 0, c = 0; i < kFrames; c++) {
+      int n = std::min(kChunks[c % 5], kFrames - i);
+      convolver_process(conv, &data[i], n);
+      i += n;
+    }
+
+    for (int i = 0; i < kFrames; i++) {
+      ASSERT_NEAR(expected[i], data[i], 1e-4)
+          << "flags " << flags << " frame " << i;
+    }
+    convolver_free(conv);
+  }
+}
+
 }  //  namespace
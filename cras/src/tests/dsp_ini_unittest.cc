@@ -92,6 +92,23 @@ TEST_F(DspIniTestSuite, BuiltinPlugin) {
   cras_dsp_ini_free(ini);
 }
 
+TEST_F(DspIniTestSuite, PluginFile) {
+  fprintf(fp, "[foo]\n");
+  fprintf(fp, "library=builtin\n");
+  fprintf(fp, "label=convolver\n");
+  fprintf(fp, "file=/etc/cras/speaker.ir\n");
+  fprintf(fp, "[bar]\n");
+  fprintf(fp, "library=builtin\n");
+  fprintf(fp, "label=eq2\n");
+  CloseFile();
+
+  struct ini* ini = cras_dsp_ini_create(filename);
+  EXPECT_EQ(2, ARRAY_COUNT(&ini->plugins));
+  EXPECT_STREQ(ARRAY_ELEMENT(&ini->plugins, 0)->file, "/etc/cras/speaker.ir");
+  EXPECT_EQ(NULL, ARRAY_ELEMENT(&ini->plugins, 1)->file);
+  cras_dsp_ini_free(ini);
+}
+
 TEST_F(DspIniTestSuite, Ports) {
   fprintf(fp, "[foo]\n");
   fprintf(fp, "library=bar\n");
@@ -0,0 +1,104 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <sched.h>
+
+#include <atomic>
+#include <vector>
+
+#include "cras/src/server/cras_dsp_thread_pool.h"
+
+namespace {
+
+struct Jobs {
+  std::vector<std::atomic<int>> runs;
+
+  explicit Jobs(int n) : runs(n) {}
+};
+
+static void count_job(void* arg, unsigned int index) {
+  Jobs* jobs = static_cast<Jobs*>(arg);
+  jobs->runs[index]++;
+}
+
+TEST(DspThreadPool, CreateWithoutThreads) {
+  EXPECT_EQ(nullptr, cras_dsp_thread_pool_create(0));
+}
+
+TEST(DspThreadPool, RunsEachJobOnce) {
+  struct cras_dsp_thread_pool* pool = cras_dsp_thread_pool_create(3);
+  ASSERT_NE(nullptr, pool);
+  EXPECT_EQ(3u, cras_dsp_thread_pool_num_threads(pool));
+
+  for (unsigned int n = 0; n < 9; n++) {
+    Jobs jobs(n);
+    // Forking again right away falls back to the caller, which then runs
+    // the jobs itself like the pipeline does.
+    if (cras_dsp_thread_pool_run(pool, n, count_job, &jobs) < 0) {
+      for (unsigned int i = 0; i < n; i++) {
+        count_job(&jobs, i);
+      }
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      EXPECT_EQ(1, jobs.runs[i]) << "job " << i << " of " << n;
+    }
+  }
+  cras_dsp_thread_pool_destroy(pool);
+}
+
+struct Barrier {
+  std::atomic<int> arrived;
+  int expected;
+};
+
+// Only finishes once |expected| jobs are running at the same time.
+static void wait_for_all_job(void* arg, unsigned int index) {
+  Barrier* barrier = static_cast<Barrier*>(arg);
+  barrier->arrived++;
+  while (barrier->arrived < barrier->expected) {
+    sched_yield();
+  }
+}
+
+TEST(DspThreadPool, RunsJobsInParallel) {
+  struct cras_dsp_thread_pool* pool = cras_dsp_thread_pool_create(2);
+  ASSERT_NE(nullptr, pool);
+
+  Barrier barrier = {{0}, 3};
+  while (cras_dsp_thread_pool_run(pool, 3, wait_for_all_job, &barrier) ==
+         -EBUSY) {
+    sched_yield();
+  }
+  EXPECT_EQ(3, barrier.arrived);
+  cras_dsp_thread_pool_destroy(pool);
+}
+
+struct Nested {
+  struct cras_dsp_thread_pool* pool;
+  std::atomic<int> busy;
+};
+
+static void nested_job(void* arg, unsigned int index) {
+  Nested* nested = static_cast<Nested*>(arg);
+  Jobs jobs(1);
+  if (cras_dsp_thread_pool_run(nested->pool, 1, count_job, &jobs) == -EBUSY) {
+    nested->busy++;
+  }
+}
+
+TEST(DspThreadPool, BusyWhileInUse) {
+  struct cras_dsp_thread_pool* pool = cras_dsp_thread_pool_create(1);
+  ASSERT_NE(nullptr, pool);
+
+  Nested nested = {pool, {0}};
+  while (cras_dsp_thread_pool_run(pool, 2, nested_job, &nested) == -EBUSY) {
+    sched_yield();
+  }
+  EXPECT_EQ(2, nested.busy);
+  cras_dsp_thread_pool_destroy(pool);
+}
+
+}  //  namespace
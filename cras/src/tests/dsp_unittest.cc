@@ -2,24 +2,53 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
 #include <gtest/gtest.h>
 
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
 #include "cras/src/server/cras_dsp.h"
 #include "cras/src/server/cras_dsp_module.h"
+#include "cras/src/server/cras_main_message.h"
 
 #define FILENAME_TEMPLATE "DspTest.XXXXXX"
 
 namespace {
 
+static cras_message_callback main_message_callback;
+static std::vector<std::vector<uint8_t>> main_messages;
+
 extern "C" {
 struct dsp_module* cras_dsp_module_load_ladspa(struct plugin* plugin) {
   return NULL;
 }
+
+int cras_main_message_add_handler(enum CRAS_MAIN_MESSAGE_TYPE type,
+                                  cras_message_callback callback,
+                                  void* callback_data) {
+  main_message_callback = callback;
+  return 0;
+}
+
+void cras_main_message_rm_handler(enum CRAS_MAIN_MESSAGE_TYPE type) {
+  main_message_callback = NULL;
+}
+
+int cras_main_message_send(struct cras_main_message* msg) {
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(msg);
+
+  main_messages.emplace_back(bytes, bytes + msg->length);
+  return 0;
+}
 }
 
 class DspTestSuite : public testing::Test {
  protected:
   virtual void SetUp() {
+    main_messages.clear();
     strcpy(filename, FILENAME_TEMPLATE);
     int fd = mkstemp(filename);
     fp = fdopen(fd, "w");
@@ -96,6 +125,162 @@ TEST_F(DspTestSuite, Simple) {
   cras_dsp_stop();
 }
 
+static const char* kPassthroughIni =
+    "[M1]\n"
+    "library=builtin\n"
+    "label=source\n"
+    "purpose=playback\n"
+    "output_0={audio}\n"
+    "[M2]\n"
+    "library=builtin\n"
+    "label=sink\n"
+    "purpose=playback\n"
+    "input_0={audio}\n"
+    "\n";
+
+TEST_F(DspTestSuite, ReloadKeepsPinnedPipeline) {
+  fprintf(fp, "%s", kPassthroughIni);
+  CloseFile();
+
+  cras_dsp_init(filename);
+  struct cras_dsp_context* ctx = cras_dsp_context_new(48000, "playback");
+  cras_dsp_load_pipeline(ctx);
+
+  struct pipeline* old_pipeline = cras_dsp_get_pipeline(ctx);
+  ASSERT_TRUE(old_pipeline);
+
+  // A reload while the pipeline is pinned must not wait for the reader.
+  cras_dsp_reload_ini();
+  struct pipeline* new_pipeline = cras_dsp_get_pipeline(ctx);
+  ASSERT_TRUE(new_pipeline);
+  EXPECT_NE(old_pipeline, new_pipeline);
+
+  // The pinned pipeline stays usable until released.
+  EXPECT_EQ(1, cras_dsp_pipeline_get_num_output_channels(old_pipeline));
+  cras_dsp_put_pipeline(ctx);
+  cras_dsp_put_pipeline(ctx);
+  cras_dsp_synchronize(ctx);
+
+  cras_dsp_context_free(ctx);
+  cras_dsp_stop();
+}
+
+TEST_F(DspTestSuite, ReloadCrossfadesPipelines) {
+  const unsigned int kFrames = 128;
+  const unsigned int kFadeFrames = 480;
+  int16_t buf[kFrames];
+  int16_t expected[kFrames];
+
+  fprintf(fp, "%s", kPassthroughIni);
+  CloseFile();
+
+  cras_dsp_init(filename);
+  ASSERT_TRUE(main_message_callback);
+  struct cras_dsp_context* ctx = cras_dsp_context_new(48000, "playback");
+  cras_dsp_load_pipeline(ctx);
+
+  for (unsigned int i = 0; i < kFrames; i++) {
+    expected[i] = i * 64 - 4096;
+  }
+  memcpy(buf, expected, sizeof(buf));
+  ASSERT_EQ(0, cras_dsp_apply(ctx, (uint8_t*)buf, SND_PCM_FORMAT_S16_LE,
+                              kFrames));
+  EXPECT_EQ(0, memcmp(buf, expected, sizeof(buf)));
+
+  cras_dsp_load_pipeline(ctx);
+
+  // Both pipelines pass audio through, so the ramp between them is exact.
+  for (unsigned int done = 0; done < kFadeFrames; done += kFrames) {
+    EXPECT_EQ(0u, main_messages.size());
+    memcpy(buf, expected, sizeof(buf));
+    ASSERT_EQ(0, cras_dsp_apply(ctx, (uint8_t*)buf, SND_PCM_FORMAT_S16_LE,
+                                kFrames));
+    EXPECT_EQ(0, memcmp(buf, expected, sizeof(buf)));
+  }
+  ASSERT_EQ(1u, main_messages.size());
+
+  // The main thread drops the faded out pipeline.
+  main_message_callback(
+      reinterpret_cast<struct cras_main_message*>(main_messages[0].data()),
+      NULL);
+  main_messages.clear();
+  memcpy(buf, expected, sizeof(buf));
+  ASSERT_EQ(0, cras_dsp_apply(ctx, (uint8_t*)buf, SND_PCM_FORMAT_S16_LE,
+                              kFrames));
+  EXPECT_EQ(0, memcmp(buf, expected, sizeof(buf)));
+  EXPECT_EQ(0u, main_messages.size());
+
+  cras_dsp_context_free(ctx);
+  cras_dsp_stop();
+}
+
+// The control port of the last "live" module and the values it was told of.
+static float* live_control;
+static std::vector<float> live_changes;
+
+static const char* kLiveControlIni =
+    "[M1]\n"
+    "library=builtin\n"
+    "label=source\n"
+    "purpose=capture\n"
+    "output_0={in}\n"
+    "[M2]\n"
+    "library=builtin\n"
+    "label=live\n"
+    "input_0={in}\n"
+    "output_1={out}\n"
+    "input_2=1\n"
+    "[M3]\n"
+    "library=builtin\n"
+    "label=sink\n"
+    "purpose=capture\n"
+    "input_0={out}\n"
+    "\n";
+
+TEST_F(DspTestSuite, SetControl) {
+  const unsigned int kFrames = 128;
+  int16_t buf[kFrames] = {};
+
+  fprintf(fp, "%s", kLiveControlIni);
+  CloseFile();
+  live_changes.clear();
+
+  cras_dsp_init(filename);
+  struct cras_dsp_context* ctx = cras_dsp_context_new(48000, "capture");
+  cras_dsp_load_pipeline(ctx);
+  struct pipeline* pipeline = cras_dsp_get_pipeline(ctx);
+  ASSERT_TRUE(pipeline);
+  cras_dsp_put_pipeline(ctx);
+  ASSERT_TRUE(live_control);
+  EXPECT_EQ(1, *live_control);
+
+  EXPECT_EQ(-ENOENT, cras_dsp_set_control(ctx, "m9", 2, 0));
+  EXPECT_EQ(-ENOENT, cras_dsp_set_control(ctx, "m2", 1, 0));
+
+  // The audio thread takes the new value before the next block.
+  EXPECT_EQ(0, cras_dsp_set_control(ctx, "m2", 2, 0.25));
+  EXPECT_EQ(0, cras_dsp_set_control(ctx, "m2", 2, 0.5));
+  EXPECT_EQ(0u, live_changes.size());
+  ASSERT_EQ(0, cras_dsp_apply(ctx, (uint8_t*)buf, SND_PCM_FORMAT_S16_LE,
+                              kFrames));
+  EXPECT_EQ(std::vector<float>({0.25, 0.5}), live_changes);
+  EXPECT_EQ(0.5, *live_control);
+  EXPECT_EQ(pipeline, cras_dsp_get_pipeline(ctx));
+  cras_dsp_put_pipeline(ctx);
+
+  // Updates for a replaced pipeline are dropped, the new one has the value.
+  EXPECT_EQ(0, cras_dsp_set_control(ctx, "m2", 2, 0.75));
+  cras_dsp_load_pipeline(ctx);
+  EXPECT_EQ(0.75, *live_control);
+  ASSERT_EQ(0, cras_dsp_apply(ctx, (uint8_t*)buf, SND_PCM_FORMAT_S16_LE,
+                              kFrames));
+  EXPECT_EQ(2u, live_changes.size());
+
+  cras_dsp_context_free(ctx);
+  cras_dsp_stop();
+  live_control = NULL;
+}
+
 static int empty_instantiate(struct dsp_module* module,
                              unsigned long sample_rate,
                              struct cras_expr_env* env) {
@@ -106,6 +291,24 @@ static void empty_connect_port(struct dsp_module* module,
                                unsigned long port,
                                float* data_location) {}
 
+static void live_connect_port(struct dsp_module* module,
+                              unsigned long port,
+                              float* data_location) {
+  if (port == 2) {
+    live_control = data_location;
+  }
+}
+
+static int live_is_live_control(struct dsp_module* module,
+                                unsigned long port) {
+  return 1;
+}
+
+static void live_control_changed(struct dsp_module* module,
+                                 unsigned long port) {
+  live_changes.push_back(*live_control);
+}
+
 static void empty_configure(struct dsp_module* module) {}
 
 static int empty_get_delay(struct dsp_module* module) {
@@ -147,6 +350,11 @@ struct dsp_module* cras_dsp_module_load_builtin(struct plugin* plugin) {
   struct dsp_module* module;
   module = (struct dsp_module*)calloc(1, sizeof(struct dsp_module));
   empty_init_module(module);
+  if (strcmp(plugin->label, "live") == 0) {
+    module->connect_port = &live_connect_port;
+    module->is_live_control = &live_is_live_control;
+    module->control_changed = &live_control_changed;
+  }
   return module;
 }
 void cras_dsp_module_set_sink_ext_module(struct dsp_module* module,
@@ -18,6 +18,8 @@ extern "C" {
 #include "third_party/utlist/utlist.h"
 }
 
+#include "cras/src/tests/fl_pcm_shm_server.h"
+
 #define FAKE_SOCKET_FD 99;
 
 static cras_audio_format format;
@@ -36,6 +38,9 @@ static unsigned cras_iodev_init_audio_area_called;
 static unsigned cras_iodev_free_audio_area_called;
 static unsigned cras_floss_a2dp_start_called;
 static unsigned cras_floss_a2dp_stop_called;
+static unsigned cras_floss_a2dp_start_shm_called;
+static int cras_floss_a2dp_start_shm_ret;
+static FlPcmShmServer* fl_pcm_shm_server;
 static int cras_floss_a2dp_get_fd_ret;
 static unsigned cras_floss_hfp_start_called;
 static unsigned cras_floss_hfp_stop_called;
@@ -67,6 +72,9 @@ void ResetStubData() {
   cras_iodev_free_audio_area_called = 0;
   cras_floss_a2dp_start_called = 0;
   cras_floss_a2dp_stop_called = 0;
+  cras_floss_a2dp_start_shm_called = 0;
+  cras_floss_a2dp_start_shm_ret = -EOPNOTSUPP;
+  fl_pcm_shm_server = NULL;
   cras_floss_a2dp_get_fd_ret = FAKE_SOCKET_FD;
   cras_floss_hfp_start_called = 0;
   cras_floss_hfp_stop_called = 0;
@@ -158,6 +166,9 @@ TEST_F(PcmIodev, OpenCloseA2dpPcmIodev) {
   iodev->configure_dev(iodev);
   iodev->state = CRAS_IODEV_STATE_NORMAL_RUN;
 
+  // Floss doesn't take the ring, stream through the socket.
+  EXPECT_EQ(1, cras_floss_a2dp_start_shm_called);
+  EXPECT_EQ(NULL, ((struct fl_pcm_io*)iodev)->shm);
   EXPECT_EQ(1, cras_floss_a2dp_start_called);
   EXPECT_EQ(1, cras_iodev_init_audio_area_called);
   EXPECT_NE(write_callback, (void*)NULL);
@@ -173,6 +184,178 @@ TEST_F(PcmIodev, OpenCloseA2dpPcmIodev) {
   a2dp_pcm_iodev_destroy(iodev);
 }
 
+TEST_F(PcmIodev, A2dpShmStartFailsWithoutSocketFallback) {
+  struct cras_iodev* iodev;
+
+  // Floss took the ring but the session didn't start.
+  cras_floss_a2dp_start_shm_ret = -EIO;
+
+  iodev = a2dp_pcm_iodev_create(NULL, 0, 0, 0);
+  iodev_set_format(iodev, &format);
+  EXPECT_EQ(-EIO, iodev->configure_dev(iodev));
+  EXPECT_EQ(1, cras_floss_a2dp_start_shm_called);
+  EXPECT_EQ(0, cras_floss_a2dp_start_called);
+  EXPECT_EQ(NULL, ((struct fl_pcm_io*)iodev)->shm);
+
+  a2dp_pcm_iodev_destroy(iodev);
+}
+
+TEST_F(PcmIodev, A2dpShmRingNoCopyNoSend) {
+  FlPcmShmServer server;
+  struct cras_iodev* iodev;
+  struct fl_pcm_io* a2dpio;
+  struct timespec tstamp;
+  unsigned int frames, level;
+  int16_t* samples;
+
+  fl_pcm_shm_server = &server;
+  cras_floss_a2dp_start_shm_ret = 0;
+  // There's no socket to write to.
+  cras_floss_a2dp_get_fd_ret = -1;
+
+  iodev = a2dp_pcm_iodev_create(NULL, 0, 0, 0);
+  a2dpio = (struct fl_pcm_io*)iodev;
+  iodev_set_format(iodev, &format);
+  ASSERT_EQ(0, iodev->configure_dev(iodev));
+  iodev->state = CRAS_IODEV_STATE_NORMAL_RUN;
+
+  ASSERT_TRUE(server.mapped());
+  EXPECT_EQ(1, cras_floss_a2dp_start_shm_called);
+  EXPECT_EQ(0, cras_floss_a2dp_start_called);
+  EXPECT_EQ(NULL, a2dpio->pcm_buf);
+  EXPECT_EQ(NULL, write_callback);
+  EXPECT_EQ(0, audio_thread_config_events_callback_called);
+  EXPECT_EQ(480, iodev->min_buffer_level);
+
+  // The stream mixes right into the ring.
+  frames = iodev_get_buffer(iodev, 480);
+  ASSERT_EQ(480, frames);
+  samples = (int16_t*)mock_audio_area->channels[0].buf;
+  EXPECT_EQ(a2dpio->shm->samples, (uint8_t*)samples);
+  for (unsigned int i = 0; i < 2 * frames; i++) {
+    samples[i] = i;
+  }
+  EXPECT_EQ(0, iodev->put_buffer(iodev, frames));
+  EXPECT_EQ(480, frames_queued(iodev, &tstamp));
+
+  // What Floss reads is what was mixed, without a send() in between.
+  EXPECT_EQ(200, server.Read(200));
+  EXPECT_EQ(280, frames_queued(iodev, &tstamp));
+  // Less than a write_block over min_buffer_level, wake up in a block.
+  EXPECT_EQ(480, a2dp_frames_to_play_in_sleep(iodev, &level, &tstamp));
+  EXPECT_EQ(280, level);
+  EXPECT_EQ(200 * 4, a2dpio->total_written_bytes);
+  EXPECT_EQ(280, server.Read(480));
+  a2dp_frames_to_play_in_sleep(iodev, &level, &tstamp);
+  ASSERT_EQ(480 * 4, server.pcm().size());
+  for (unsigned int i = 0; i < 2 * frames; i++) {
+    EXPECT_EQ(i, ((const int16_t*)server.pcm().data())[i]);
+  }
+
+  // Floss is done with the ring before it's destroyed.
+  iodev->close_dev(iodev);
+  EXPECT_EQ(1, cras_floss_a2dp_stop_called);
+  EXPECT_EQ(NULL, a2dpio->shm);
+  EXPECT_EQ(480 * 4, a2dpio->total_written_bytes);
+  server.Unmap();
+  a2dp_pcm_iodev_destroy(iodev);
+}
+
+TEST_F(PcmIodev, A2dpShmRingFullSchedulesSuspend) {
+  FlPcmShmServer server;
+  struct cras_iodev* iodev;
+  unsigned int frames, level;
+  struct timespec tstamp;
+
+  fl_pcm_shm_server = &server;
+  cras_floss_a2dp_start_shm_ret = 0;
+
+  iodev = a2dp_pcm_iodev_create(NULL, 0, 0, 0);
+  iodev_set_format(iodev, &format);
+  ASSERT_EQ(0, iodev->configure_dev(iodev));
+  iodev->state = CRAS_IODEV_STATE_NORMAL_RUN;
+
+  // Takes up to buffer_size frames.
+  do {
+    frames = iodev_get_buffer(iodev, iodev->buffer_size);
+    EXPECT_EQ(0, iodev->put_buffer(iodev, frames));
+  } while (frames);
+  EXPECT_EQ(iodev->buffer_size, frames_queued(iodev, &tstamp));
+  EXPECT_EQ(-EINVAL, iodev->put_buffer(iodev, 1));
+
+  // Floss isn't reading.
+  cras_floss_a2dp_schedule_suspend_called = 0;
+  a2dp_frames_to_play_in_sleep(iodev, &level, &tstamp);
+  EXPECT_EQ(1, cras_floss_a2dp_schedule_suspend_called);
+
+  cras_floss_a2dp_cancel_suspend_called = 0;
+  EXPECT_EQ(480, server.Read(480));
+  a2dp_frames_to_play_in_sleep(iodev, &level, &tstamp);
+  EXPECT_EQ(1, cras_floss_a2dp_cancel_suspend_called);
+
+  // The room Floss made is handed out in two pieces around the wrap.
+  frames = ((struct fl_pcm_io*)iodev)->shm->ring_frames - iodev->buffer_size;
+  EXPECT_EQ(frames, iodev_get_buffer(iodev, iodev->buffer_size));
+  EXPECT_EQ(0, iodev->put_buffer(iodev, frames));
+  EXPECT_EQ(480 - frames, iodev_get_buffer(iodev, iodev->buffer_size));
+
+  iodev->close_dev(iodev);
+  server.Unmap();
+  a2dp_pcm_iodev_destroy(iodev);
+}
+
+// The mixer and Floss run on their own threads, with the ring wrapping.
+TEST_F(PcmIodev, A2dpShmRingConcurrentReader) {
+  FlPcmShmServer server;
+  struct cras_iodev* iodev;
+  struct timespec tstamp;
+  unsigned int frames;
+  int16_t* samples;
+  int16_t next = 0;
+  const int16_t total_frames = 24000;
+  // Waits for the reader are 1ms each, give up after a second of them.
+  const int max_waits = 1000;
+  int waits = 0;
+
+  fl_pcm_shm_server = &server;
+  cras_floss_a2dp_start_shm_ret = 0;
+
+  iodev = a2dp_pcm_iodev_create(NULL, 0, 0, 0);
+  iodev_set_format(iodev, &format);
+  ASSERT_EQ(0, iodev->configure_dev(iodev));
+  iodev->state = CRAS_IODEV_STATE_NORMAL_RUN;
+
+  server.Start(4800, 1);
+  while (next < total_frames) {
+    frames = iodev_get_buffer(iodev, total_frames - next);
+    if (!frames) {
+      ASSERT_LT(++waits, max_waits) << "Ring still full at frame " << next;
+      usleep(1000);
+      continue;
+    }
+    samples = (int16_t*)mock_audio_area->channels[0].buf;
+    for (unsigned int i = 0; i < frames; i++) {
+      samples[2 * i] = samples[2 * i + 1] = next++;
+    }
+    EXPECT_EQ(0, iodev->put_buffer(iodev, frames));
+  }
+  for (waits = 0; frames_queued(iodev, &tstamp); waits++) {
+    ASSERT_LT(waits, max_waits) << "Ring not drained";
+    usleep(1000);
+  }
+  server.Stop();
+
+  ASSERT_EQ(total_frames * 4, server.pcm().size());
+  for (int16_t i = 0; i < total_frames; i++) {
+    ASSERT_EQ(i, ((const int16_t*)server.pcm().data())[2 * i]);
+    ASSERT_EQ(i, ((const int16_t*)server.pcm().data())[2 * i + 1]);
+  }
+
+  iodev->close_dev(iodev);
+  server.Unmap();
+  a2dp_pcm_iodev_destroy(iodev);
+}
+
 TEST_F(PcmIodev, CreateDestroyHfpPcmIodev) {
   struct cras_iodev *idev, *odev;
 
@@ -556,6 +739,17 @@ int cras_floss_a2dp_start(struct cras_a2dp* a2dp,
   return 0;
 }
 
+int cras_floss_a2dp_start_shm(struct cras_a2dp* a2dp,
+                              struct cras_audio_format* fmt,
+                              int header_fd,
+                              int samples_fd) {
+  cras_floss_a2dp_start_shm_called++;
+  if (cras_floss_a2dp_start_shm_ret == 0 && fl_pcm_shm_server) {
+    return fl_pcm_shm_server->Map(header_fd, samples_fd);
+  }
+  return cras_floss_a2dp_start_shm_ret;
+}
+
 int cras_floss_a2dp_stop(struct cras_a2dp* a2dp) {
   cras_floss_a2dp_stop_called++;
   return 0;
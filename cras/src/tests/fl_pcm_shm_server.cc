@@ -0,0 +1,97 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "cras/src/tests/fl_pcm_shm_server.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+
+FlPcmShmServer::FlPcmShmServer()
+    : shm_(nullptr), frames_read_(0), running_(false) {}
+
+FlPcmShmServer::~FlPcmShmServer() {
+  Unmap();
+}
+
+int FlPcmShmServer::Map(int header_fd, int samples_fd) {
+  struct cras_shm_info header_info, samples_info;
+  struct stat header_stat, samples_stat;
+  int rc;
+
+  if (fstat(header_fd, &header_stat) || fstat(samples_fd, &samples_stat)) {
+    return -errno;
+  }
+
+  rc = cras_shm_info_init_with_fd(header_fd, header_stat.st_size,
+                                  &header_info);
+  if (rc) {
+    return rc;
+  }
+  rc = cras_shm_info_init_with_fd(samples_fd, samples_stat.st_size,
+                                  &samples_info);
+  if (rc) {
+    cras_shm_info_cleanup(&header_info);
+    return rc;
+  }
+
+  // Floss only reads the samples, and writes ring_read_frames in the header.
+  rc = cras_audio_shm_create(&header_info, &samples_info, PROT_READ, &shm_);
+  if (rc) {
+    return rc;
+  }
+  cras_shm_copy_shared_config(shm_);
+  if (!cras_shm_is_ring(shm_)) {
+    Unmap();
+    return -EINVAL;
+  }
+  return 0;
+}
+
+void FlPcmShmServer::Unmap() {
+  Stop();
+  cras_audio_shm_destroy(shm_);
+  shm_ = nullptr;
+}
+
+size_t FlPcmShmServer::Read(size_t max_frames) {
+  size_t frame_bytes = cras_shm_frame_bytes(shm_);
+  size_t read = 0;
+  size_t frames;
+  uint8_t* buf;
+
+  while (read < max_frames) {
+    buf = cras_shm_get_readable_frames(shm_, 0, &frames);
+    if (!frames) {
+      break;
+    }
+    frames = std::min(frames, max_frames - read);
+    pcm_.insert(pcm_.end(), buf, buf + frames * frame_bytes);
+    cras_shm_buffer_read(shm_, frames);
+    read += frames;
+  }
+  frames_read_ += read;
+  return read;
+}
+
+void FlPcmShmServer::Start(size_t block_frames, unsigned int period_ms) {
+  running_ = true;
+  reader_ = std::thread([this, block_frames, period_ms]() {
+    while (running_) {
+      Read(block_frames);
+      std::this_thread::sleep_for(std::chrono::milliseconds(period_ms));
+    }
+  });
+}
+
+void FlPcmShmServer::Stop() {
+  running_ = false;
+  if (reader_.joinable()) {
+    reader_.join();
+  }
+}
@@ -0,0 +1,56 @@
+/* Copyright 2024 The ChromiumOS Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef CRAS_SRC_TESTS_FL_PCM_SHM_SERVER_H_
+#define CRAS_SRC_TESTS_FL_PCM_SHM_SERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cras_shm.h"
+}
+
+/* A local stand-in for the Floss media service on the receiving end of
+ * SetPcmSharedMemory. It maps the A2DP pcm ring from the header and samples
+ * fds, the way Floss does, and consumes it either on request or from a
+ * thread polling it like Floss does every 10ms. What it reads is kept for
+ * the test to check.
+ */
+class FlPcmShmServer {
+ public:
+  FlPcmShmServer();
+  ~FlPcmShmServer();
+
+  // Maps the ring. Returns 0 on success or a negative error code.
+  int Map(int header_fd, int samples_fd);
+  // Stops the reader thread if any, and unmaps the ring.
+  void Unmap();
+  bool mapped() const { return shm_ != nullptr; }
+
+  // Reads up to |max_frames| frames from the ring. Returns the frames read.
+  size_t Read(size_t max_frames);
+
+  // Reads |block_frames| frames every |period_ms| on a thread until Stop.
+  void Start(size_t block_frames, unsigned int period_ms);
+  void Stop();
+
+  // The bytes read from the ring so far.
+  const std::vector<uint8_t>& pcm() const { return pcm_; }
+  uint64_t frames_read() const { return frames_read_; }
+
+ private:
+  struct cras_audio_shm* shm_;
+  std::vector<uint8_t> pcm_;
+  uint64_t frames_read_;
+  std::thread reader_;
+  std::atomic<bool> running_;
+};
+
+#endif  // CRAS_SRC_TESTS_FL_PCM_SHM_SERVER_H_
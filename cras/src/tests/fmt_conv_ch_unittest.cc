@@ -0,0 +1,174 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "cras/src/server/cras_fmt_conv_ch.h"
+#include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras/src/server/cras_mix.h"
+#include "cras_types.h"
+}
+
+namespace {
+
+static const size_t kFrames = 1031;
+
+/* Runs the channel converters of the variant picked for GetParam() and
+ * checks them against the portable C converters. Variants the running CPU
+ * lacks are skipped. */
+class FmtConvChVariantTest : public testing::TestWithParam<unsigned int> {
+ protected:
+  virtual void SetUp() {
+    cras_fmt_conv_ch_init_with_flags(GetParam());
+    ops_ = cras_fmt_conv_ch_get_ops();
+    if (!ops_) {
+      GTEST_SKIP() << "Variant not supported by this CPU";
+    }
+  }
+
+  virtual void TearDown() { cras_fmt_conv_ch_init_with_flags(0); }
+
+  std::vector<int16_t> RandomFrames(size_t channels) {
+    std::vector<int16_t> buf(kFrames * channels);
+    std::uniform_int_distribution<int> dist(INT16_MIN, INT16_MAX);
+
+    for (auto& s : buf) {
+      s = dist(engine_);
+    }
+    // Full scale samples to exercise clipping.
+    buf[0] = INT16_MAX;
+    buf[channels] = INT16_MIN;
+    return buf;
+  }
+
+  static void ExpectNear(const std::vector<int16_t>& expected,
+                         const std::vector<int16_t>& actual,
+                         int tolerance) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_LE(abs(expected[i] - actual[i]), tolerance) << "sample " << i;
+    }
+  }
+
+  const struct cras_fmt_conv_ch_ops* ops_;
+  std::mt19937 engine_{1234};
+};
+
+TEST_P(FmtConvChVariantTest, StereoToMono) {
+  std::vector<int16_t> in = RandomFrames(2);
+  std::vector<int16_t> expected(kFrames), actual(kFrames);
+
+  EXPECT_EQ(kFrames, s16_stereo_to_mono((uint8_t*)in.data(), kFrames,
+                                        (uint8_t*)expected.data()));
+  EXPECT_EQ(kFrames, ops_->s16_stereo_to_mono((uint8_t*)in.data(), kFrames,
+                                              (uint8_t*)actual.data()));
+  ExpectNear(expected, actual, 0);
+}
+
+TEST_P(FmtConvChVariantTest, StereoTo51And71) {
+  // {left, right, center} as found in the output channel layout.
+  static const size_t kLayouts[][3] = {
+      {0, 1, 4}, {4, 5, 2}, {(size_t)-1, 1, 2}, {(size_t)-1, 1, (size_t)-1}};
+  std::vector<int16_t> in = RandomFrames(2);
+
+  for (auto& l : kLayouts) {
+    std::vector<int16_t> expected(kFrames * 6, 1), actual(kFrames * 6, 1);
+
+    s16_stereo_to_51(l[0], l[1], l[2], (uint8_t*)in.data(), kFrames,
+                     (uint8_t*)expected.data());
+    EXPECT_EQ(kFrames,
+              ops_->s16_stereo_to_51(l[0], l[1], l[2], (uint8_t*)in.data(),
+                                     kFrames, (uint8_t*)actual.data()));
+    ExpectNear(expected, actual, 0);
+
+    expected.assign(kFrames * 8, 1);
+    actual.assign(kFrames * 8, 1);
+    s16_stereo_to_71(l[0], l[1], l[2], (uint8_t*)in.data(), kFrames,
+                     (uint8_t*)expected.data());
+    EXPECT_EQ(kFrames,
+              ops_->s16_stereo_to_71(l[0], l[1], l[2], (uint8_t*)in.data(),
+                                     kFrames, (uint8_t*)actual.data()));
+    ExpectNear(expected, actual, 0);
+  }
+}
+
+TEST_P(FmtConvChVariantTest, _51ToStereoAndQuad) {
+  std::vector<int16_t> in = RandomFrames(6);
+  std::vector<int16_t> expected(kFrames * 2), actual(kFrames * 2);
+
+  s16_51_to_stereo((uint8_t*)in.data(), kFrames, (uint8_t*)expected.data());
+  EXPECT_EQ(kFrames, ops_->s16_51_to_stereo((uint8_t*)in.data(), kFrames,
+                                            (uint8_t*)actual.data()));
+  ExpectNear(expected, actual, 1);
+
+  expected.assign(kFrames * 4, 0);
+  actual.assign(kFrames * 4, 0);
+  s16_51_to_quad((uint8_t*)in.data(), kFrames, (uint8_t*)expected.data());
+  EXPECT_EQ(kFrames, ops_->s16_51_to_quad((uint8_t*)in.data(), kFrames,
+                                          (uint8_t*)actual.data()));
+  // Truncating the center and LFE terms separately can add up.
+  ExpectNear(expected, actual, 2);
+}
+
+TEST_P(FmtConvChVariantTest, QuadToStereo) {
+  // {front left, front right, rear left, rear right} of the input layout.
+  static const size_t kLayouts[][4] = {
+      {0, 1, 2, 3}, {2, 3, 0, 1}, {0, 1, (size_t)-1, 3}};
+  std::vector<int16_t> in = RandomFrames(4);
+
+  for (auto& l : kLayouts) {
+    std::vector<int16_t> expected(kFrames * 2), actual(kFrames * 2);
+
+    s16_quad_to_stereo(l[0], l[1], l[2], l[3], (uint8_t*)in.data(), kFrames,
+                       (uint8_t*)expected.data());
+    EXPECT_EQ(kFrames, ops_->s16_quad_to_stereo(l[0], l[1], l[2], l[3],
+                                                (uint8_t*)in.data(), kFrames,
+                                                (uint8_t*)actual.data()));
+    ExpectNear(expected, actual, 0);
+  }
+}
+
+TEST_P(FmtConvChVariantTest, ConvertChannels) {
+  static const size_t kChannels[][2] = {{2, 6}, {6, 2}, {8, 2},
+                                        {8, 6}, {1, 8}, {CRAS_CH_MAX + 1, 3}};
+  std::uniform_real_distribution<float> coef(-1.0, 1.0);
+
+  for (auto& ch : kChannels) {
+    size_t in_ch = ch[0], out_ch = ch[1];
+    std::vector<int16_t> in = RandomFrames(in_ch);
+    std::vector<int16_t> expected(kFrames * out_ch), actual(kFrames * out_ch);
+    std::vector<std::vector<float>> mtx(out_ch, std::vector<float>(in_ch));
+    std::vector<float*> rows;
+
+    for (size_t o = 0; o < out_ch; o++) {
+      for (size_t i = 0; i < in_ch; i++) {
+        // Leave the matrix sparse like the real up/down-mix matrices.
+        mtx[o][i] = (o + i) % 3 ? 0 : coef(engine_);
+      }
+      rows.push_back(mtx[o].data());
+    }
+
+    s16_convert_channels(rows.data(), in_ch, out_ch, (uint8_t*)in.data(),
+                         kFrames, (uint8_t*)expected.data());
+    EXPECT_EQ(kFrames, ops_->s16_convert_channels(
+                           rows.data(), in_ch, out_ch, (uint8_t*)in.data(),
+                           kFrames, (uint8_t*)actual.data()));
+    // The reference truncates after every term, the variant only once.
+    ExpectNear(expected, actual, in_ch);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(FmtConvCh,
+                         FmtConvChVariantTest,
+                         testing::Values(CPU_X86_SSE4_2,
+                                         CPU_X86_AVX2,
+                                         CPU_ARM_NEON));
+
+}  //  namespace
@@ -255,6 +255,188 @@ TEST(FormatConverterOpsTest, ConvertS16LEToF32LE) {
   }
 }
 
+// Test S32_LE to F32_LE and back keeps 24 significant bits.
+TEST(FormatConverterOpsTest, ConvertS32LEToF32LERoundTrip) {
+  const size_t frames = 4096;
+  const size_t ch = 2;
+
+  S32LEPtr src = CreateS32LE(frames * ch);
+  FloatPtr tmp = CreateFloat(frames * ch);
+  S32LEPtr dst = CreateS32LE(frames * ch);
+
+  for (size_t i = 0; i < frames * ch; ++i) {
+    src[i] = (int32_t)((uint32_t)src[i] & 0xffffff00);
+  }
+  convert_s32le_to_f32le((uint8_t*)src.get(), frames * ch,
+                         (uint8_t*)tmp.get());
+  convert_f32le_to_s32le((uint8_t*)tmp.get(), frames * ch,
+                         (uint8_t*)dst.get());
+
+  for (size_t i = 0; i < frames * ch; ++i) {
+    EXPECT_EQ(src[i], dst[i]);
+  }
+}
+
+// Test S24_LE and S24_3LE to F32_LE and back are lossless.
+TEST(FormatConverterOpsTest, ConvertS24LEToF32LERoundTrip) {
+  const size_t frames = 4096;
+  const size_t ch = 2;
+
+  S24LEPtr src = CreateS24LE(frames * ch);
+  FloatPtr tmp = CreateFloat(frames * ch);
+  S243LEPtr s243 = CreateS243LE(frames * ch);
+  S24LEPtr dst = CreateS24LE(frames * ch);
+
+  convert_s24le_to_f32le((uint8_t*)src.get(), frames * ch,
+                         (uint8_t*)tmp.get());
+  convert_f32le_to_s243le((uint8_t*)tmp.get(), frames * ch, s243.get());
+  convert_s243le_to_f32le(s243.get(), frames * ch, (uint8_t*)tmp.get());
+  convert_f32le_to_s24le((uint8_t*)tmp.get(), frames * ch,
+                         (uint8_t*)dst.get());
+
+  for (size_t i = 0; i < frames * ch; ++i) {
+    EXPECT_EQ(src[i] & 0x00ffffff, dst[i] & 0x00ffffff);
+    EXPECT_EQ(src[i] & 0x00ffffff, ToS243LE(&s243[i * 3]));
+  }
+}
+
+// Test F32_LE to integer formats clip out of range samples.
+TEST(FormatConverterOpsTest, ConvertF32LEClip) {
+  constexpr size_t frames = 5;
+  float src[frames] = {-2.f, -1.f, 0.f, 0.5f, 2.f};
+  int32_t s32[frames];
+  int32_t s24[frames];
+  uint8_t u8[frames];
+  int32_t s32_expected[frames] = {INT32_MIN, INT32_MIN, 0, 1 << 30, INT32_MAX};
+  int32_t s24_expected[frames] = {-0x800000, -0x800000, 0, 0x400000, 0x7fffff};
+  uint8_t u8_expected[frames] = {0, 0, 128, 192, 255};
+
+  convert_f32le_to_s32le((uint8_t*)src, frames, (uint8_t*)s32);
+  convert_f32le_to_s24le((uint8_t*)src, frames, (uint8_t*)s24);
+  convert_f32le_to_u8((uint8_t*)src, frames, u8);
+
+  for (size_t i = 0; i < frames; ++i) {
+    EXPECT_EQ(s32_expected[i], s32[i]);
+    EXPECT_EQ(s24_expected[i], s24[i]);
+    EXPECT_EQ(u8_expected[i], u8[i]);
+  }
+}
+
+// Test U8 to F32_LE conversion.
+TEST(FormatConverterOpsTest, ConvertU8ToF32LE) {
+  constexpr size_t frames = 3;
+  uint8_t src[frames] = {0, 128, 192};
+  float dst[frames];
+  float expected[frames] = {-1.f, 0.f, 0.5f};
+
+  convert_u8_to_f32le(src, frames, (uint8_t*)dst);
+
+  for (size_t i = 0; i < frames; ++i) {
+    EXPECT_EQ(expected[i], dst[i]);
+  }
+}
+
+// Test Stereo to Mono conversion doesn't clip in float.
+TEST(FormatConverterOpsTest, StereoToMonoF32LE) {
+  const size_t frames = 4096;
+  const size_t in_ch = 2;
+  const size_t out_ch = 1;
+
+  FloatPtr src = CreateFloat(frames * in_ch);
+  FloatPtr dst = CreateFloat(frames * out_ch);
+  src[0] = 0.75f;
+  src[1] = 0.75f;
+
+  size_t ret = f32_stereo_to_mono((uint8_t*)src.get(), frames,
+                                  (uint8_t*)dst.get());
+  EXPECT_EQ(ret, frames);
+
+  EXPECT_EQ(1.5f, dst[0]);
+  for (size_t i = 0; i < frames; ++i) {
+    EXPECT_EQ(src[i * 2] + src[i * 2 + 1], dst[i]);
+  }
+}
+
+// Test 5.1 to Stereo conversion.  F32_LE.
+TEST(FormatConverterOpsTest, _51ToStereoF32LE) {
+  const size_t frames = 4096;
+  const size_t in_ch = 6;
+  const size_t out_ch = 2;
+  const size_t left = 0;
+  const size_t right = 1;
+  const size_t center = 2;
+
+  FloatPtr src = CreateFloat(frames * in_ch);
+  FloatPtr dst = CreateFloat(frames * out_ch);
+
+  size_t ret =
+      f32_51_to_stereo((uint8_t*)src.get(), frames, (uint8_t*)dst.get());
+  EXPECT_EQ(ret, frames);
+
+  for (size_t i = 0; i < frames; ++i) {
+    float half_center = src[i * 6 + center] * 0.707f * 0.585f;
+    EXPECT_FLOAT_EQ(src[i * 6 + left] * 0.585f + half_center,
+                    dst[i * 2 + left]);
+    EXPECT_FLOAT_EQ(src[i * 6 + right] * 0.585f + half_center,
+                    dst[i * 2 + right]);
+  }
+}
+
+// Test Quad to 7.1 conversion with the default layout.  F32_LE.
+TEST(FormatConverterOpsTest, QuadTo8chF32LEDefault) {
+  const size_t frames = 4096;
+  const size_t in_ch = 4;
+  const size_t out_ch = 8;
+
+  FloatPtr src = CreateFloat(frames * in_ch);
+  FloatPtr dst = CreateFloat(frames * out_ch);
+
+  size_t ret = f32_quad_to_71(-1, -1, -1, -1, (uint8_t*)src.get(), frames,
+                              (uint8_t*)dst.get());
+  EXPECT_EQ(ret, frames);
+
+  for (size_t i = 0; i < frames; ++i) {
+    EXPECT_EQ(src[i * 4], dst[i * 8]);
+    EXPECT_EQ(src[i * 4 + 1], dst[i * 8 + 1]);
+    EXPECT_EQ(0, dst[i * 8 + 2]);
+    EXPECT_EQ(0, dst[i * 8 + 3]);
+    EXPECT_EQ(src[i * 4 + 2], dst[i * 8 + 4]);
+    EXPECT_EQ(src[i * 4 + 3], dst[i * 8 + 5]);
+    EXPECT_EQ(0, dst[i * 8 + 6]);
+    EXPECT_EQ(0, dst[i * 8 + 7]);
+  }
+}
+
+// Test channel conversion matrix.  F32_LE.
+TEST(FormatConverterOpsTest, ConvertChannelsF32LE) {
+  const size_t frames = 4096;
+  const size_t in_ch = 2;
+  const size_t out_ch = 3;
+
+  FloatPtr src = CreateFloat(frames * in_ch);
+  FloatPtr dst = CreateFloat(frames * out_ch);
+  FloatPtr ch_conv_mtx = CreateFloat(out_ch * in_ch);
+  std::unique_ptr<float*[]> mtx(new float*[out_ch]);
+  for (size_t i = 0; i < out_ch; ++i) {
+    mtx[i] = &ch_conv_mtx[i * in_ch];
+  }
+
+  size_t ret =
+      f32_convert_channels(mtx.get(), in_ch, out_ch, (uint8_t*)src.get(),
+                           frames, (uint8_t*)dst.get());
+  EXPECT_EQ(ret, frames);
+
+  for (size_t fr = 0; fr < frames; ++fr) {
+    for (size_t i = 0; i < out_ch; ++i) {
+      float exp = 0;
+      for (size_t k = 0; k < in_ch; ++k) {
+        exp += mtx[i][k] * src[fr * in_ch + k];
+      }
+      EXPECT_FLOAT_EQ(exp, dst[fr * out_ch + i]);
+    }
+  }
+}
+
 // Test Mono to Stereo conversion.  S16_LE.
 TEST(FormatConverterOpsTest, MonoToStereoS16LE) {
   const size_t frames = 4096;
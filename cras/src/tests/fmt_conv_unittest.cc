@@ -1893,7 +1893,7 @@ TEST(FormatConverterTest, ConfigConverter) {
   }
 
   config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
-                          CRAS_NODE_TYPE_HEADPHONE, 4096);
+                          CRAS_NODE_TYPE_HEADPHONE, 4096, 0);
   ASSERT_NE(c, (void*)NULL);
 
   cras_fmt_conv_destroy(&c);
@@ -1920,7 +1920,7 @@ TEST(FormatConverterTest, ConfigConverterNoNeed) {
   }
 
   config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
-                          CRAS_NODE_TYPE_HEADPHONE, 4096);
+                          CRAS_NODE_TYPE_HEADPHONE, 4096, 0);
   EXPECT_NE(c, (void*)NULL);
   EXPECT_EQ(0, cras_fmt_conversion_needed(c));
   cras_fmt_conv_destroy(&c);
@@ -1949,12 +1949,137 @@ TEST(FormatConverterTest, ConfigConverterNoNeedForInput) {
   }
 
   config_format_converter(&c, CRAS_STREAM_INPUT, &in_fmt, &out_fmt,
-                          CRAS_NODE_TYPE_HEADPHONE, 4096);
+                          CRAS_NODE_TYPE_HEADPHONE, 4096, 0);
   EXPECT_NE(c, (void*)NULL);
   EXPECT_EQ(0, cras_fmt_conversion_needed(c));
   cras_fmt_conv_destroy(&c);
 }
 
+// Test float intermediate keeps the low bits of 32 bit samples.
+TEST(FormatConverterTest, ConvertS32LEToS32LEStereoTo51Float) {
+  struct cras_fmt_conv* c;
+  struct cras_audio_format in_fmt;
+  struct cras_audio_format out_fmt;
+
+  size_t out_frames;
+  int32_t* in_buff;
+  int32_t* out_buff;
+  const size_t buf_size = 4096;
+  unsigned int in_buf_size = 4096;
+  int i;
+
+  ResetStub();
+  in_fmt.format = SND_PCM_FORMAT_S32_LE;
+  out_fmt.format = SND_PCM_FORMAT_S32_LE;
+  in_fmt.num_channels = 2;
+  out_fmt.num_channels = 6;
+  in_fmt.frame_rate = 48000;
+  out_fmt.frame_rate = 48000;
+  for (i = 0; i < CRAS_CH_MAX; i++) {
+    in_fmt.channel_layout[i] = stereo_channel_layout[i];
+    out_fmt.channel_layout[i] = surround_channel_center_layout[i];
+  }
+
+  c = cras_fmt_conv_create_float(&in_fmt, &out_fmt, buf_size, 0,
+                                 CRAS_NODE_TYPE_LINEOUT);
+  ASSERT_NE(c, (void*)NULL);
+
+  out_frames = cras_fmt_conv_in_frames_to_out(c, buf_size);
+  EXPECT_EQ(buf_size, out_frames);
+
+  in_buff = (int32_t*)malloc(buf_size * cras_get_format_bytes(&in_fmt));
+  out_buff = (int32_t*)malloc(buf_size * cras_get_format_bytes(&out_fmt));
+  for (i = 0; i < buf_size * 2; i++) {
+    // 24 significant bits survive the float round trip exactly.
+    in_buff[i] = (int32_t)((uint32_t)(rand() & 0xffffff) << 8);
+  }
+  out_frames = cras_fmt_conv_convert_frames(
+      c, (uint8_t*)in_buff, (uint8_t*)out_buff, &in_buf_size, buf_size);
+  EXPECT_EQ(buf_size, out_frames);
+  for (i = 0; i < buf_size; i++) {
+    EXPECT_EQ(in_buff[2 * i], out_buff[6 * i]);
+    EXPECT_EQ(in_buff[2 * i + 1], out_buff[6 * i + 1]);
+    EXPECT_EQ(0, out_buff[6 * i + 2]);
+    EXPECT_EQ(0, out_buff[6 * i + 3]);
+    EXPECT_EQ(0, out_buff[6 * i + 4]);
+    EXPECT_EQ(0, out_buff[6 * i + 5]);
+  }
+
+  cras_fmt_conv_destroy(&c);
+  free(in_buff);
+  free(out_buff);
+}
+
+// Test float intermediate clips only at the final format conversion.
+TEST(FormatConverterTest, ConvertS24LEToS16LEStereoToMonoFloat) {
+  struct cras_fmt_conv* c;
+  struct cras_audio_format in_fmt;
+  struct cras_audio_format out_fmt;
+
+  size_t out_frames;
+  int32_t in_buff[8] = {0x400000, 0x400000,  -0x400000, -0x500000,
+                        0x100000, -0x100000, 0x000100,  0x000000};
+  int16_t out_buff[4];
+  int16_t expected[4] = {INT16_MAX, INT16_MIN, 0, 1};
+  unsigned int in_buf_size = 4;
+  int i;
+
+  ResetStub();
+  in_fmt.format = SND_PCM_FORMAT_S24_LE;
+  out_fmt.format = SND_PCM_FORMAT_S16_LE;
+  in_fmt.num_channels = 2;
+  out_fmt.num_channels = 1;
+  in_fmt.frame_rate = 48000;
+  out_fmt.frame_rate = 48000;
+
+  c = cras_fmt_conv_create_float(&in_fmt, &out_fmt, 4, 0,
+                                 CRAS_NODE_TYPE_LINEOUT);
+  ASSERT_NE(c, (void*)NULL);
+
+  out_frames = cras_fmt_conv_convert_frames(
+      c, (uint8_t*)in_buff, (uint8_t*)out_buff, &in_buf_size, 4);
+  EXPECT_EQ(4, out_frames);
+  for (i = 0; i < 4; i++) {
+    EXPECT_EQ(expected[i], out_buff[i]);
+  }
+
+  cras_fmt_conv_destroy(&c);
+}
+
+// Test config_format_converter only uses float for wide formats.
+TEST(FormatConverterTest, ConfigConverterHighRes) {
+  struct cras_fmt_conv* c = NULL;
+  struct cras_audio_format in_fmt;
+  struct cras_audio_format out_fmt;
+
+  ResetStub();
+  in_fmt.format = SND_PCM_FORMAT_S16_LE;
+  out_fmt.format = SND_PCM_FORMAT_S16_LE;
+  in_fmt.num_channels = 2;
+  out_fmt.num_channels = 2;
+  in_fmt.frame_rate = 48000;
+  out_fmt.frame_rate = 48000;
+  for (int i = 0; i < CRAS_CH_MAX; i++) {
+    in_fmt.channel_layout[i] = stereo_channel_layout[i];
+    out_fmt.channel_layout[i] = stereo_channel_layout[i];
+  }
+
+  config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 4096, 1);
+  ASSERT_NE(c, (void*)NULL);
+  EXPECT_EQ(0, cras_fmt_conversion_needed(c));
+  EXPECT_EQ(sizeof(int16_t), linear_resampler_format_bytes);
+  cras_fmt_conv_destroy(&c);
+
+  out_fmt.format = SND_PCM_FORMAT_S32_LE;
+  config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 4096, 1);
+  ASSERT_NE(c, (void*)NULL);
+  EXPECT_EQ(1, cras_fmt_conversion_needed(c));
+  EXPECT_EQ(sizeof(float), linear_resampler_format_bytes);
+  cras_fmt_conv_destroy(&c);
+}
+
 TEST(ChannelRemixTest, ChannelRemixAppliedOrNot) {
   float coeff[4] = {0.5, 0.5, 0.26, 0.73};
   struct cras_fmt_conv* conv;
@@ -2023,11 +2148,13 @@ float** cras_channel_conv_matrix_create(const struct cras_audio_format* in,
                                         const struct cras_audio_format* out) {
   return cras_channel_conv_matrix_alloc(in->num_channels, out->num_channels);
 }
-struct linear_resampler* linear_resampler_create(unsigned int num_channels,
-                                                 unsigned int format_bytes,
-                                                 float src_rate,
-                                                 float dst_rate) {
-  linear_resampler_format_bytes = format_bytes;
+struct linear_resampler* linear_resampler_create_with_format(
+    unsigned int num_channels,
+    snd_pcm_format_t format,
+    float src_rate,
+    float dst_rate) {
+  linear_resampler_format_bytes =
+      format == SND_PCM_FORMAT_FLOAT_LE ? sizeof(float) : sizeof(int16_t);
   linear_resampler_num_channels = num_channels;
   linear_resampler_src_rate = src_rate;
   linear_resampler_dst_rate = dst_rate;
@@ -0,0 +1,190 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+#include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras/src/server/cras_fused_output.h"
+#include "cras/src/server/cras_mix.h"
+#include "cras/src/server/ewma_power.h"
+}
+
+namespace {
+
+static const unsigned int kNumChannels = 4;
+static const unsigned int kNumFrames = 480;
+
+class FusedOutputTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    cras_mix_init();
+    input_.resize(kNumFrames * kNumChannels);
+    for (size_t i = 0; i < input_.size(); i++) {
+      input_[i] = (int16_t)((i * 7919) % 65536 - 32768);
+    }
+    for (unsigned int i = 0; i < kNumChannels; i++) {
+      mtx_rows_[i] = mtx_[i];
+      for (unsigned int j = 0; j < kNumChannels; j++) {
+        mtx_[i][j] = (i == j) ? 0.75f : 0.1f;
+      }
+    }
+    ewma_power_init(&fused_ewma_, SND_PCM_FORMAT_S16_LE, 48000);
+    ewma_power_init(&staged_ewma_, SND_PCM_FORMAT_S16_LE, 48000);
+  }
+
+  // Runs the stages one at a time with the existing helpers.
+  void RunStaged(const struct cras_fused_output* stages,
+                 bool ramping,
+                 int16_t* buf,
+                 int* is_non_empty) {
+    const size_t bytes = kNumFrames * kNumChannels * 2;
+    uint8_t* frames = (uint8_t*)buf;
+    std::vector<int16_t> tmp(kNumFrames * kNumChannels);
+
+    *is_non_empty = *frames || memcmp(frames, frames + 1, bytes - 1);
+    ewma_power_calculate(&staged_ewma_, buf, kNumChannels, kNumFrames);
+    if (ramping) {
+      cras_scale_buffer_increment(SND_PCM_FORMAT_S16_LE, frames, kNumFrames,
+                                  stages->scaler, stages->increment,
+                                  stages->target, kNumChannels);
+    } else {
+      cras_scale_buffer(SND_PCM_FORMAT_S16_LE, frames,
+                        kNumFrames * kNumChannels, stages->scaler);
+    }
+    if (stages->remix_mtx) {
+      s16_convert_channels(stages->remix_mtx, kNumChannels, kNumChannels,
+                           frames, kNumFrames, (uint8_t*)tmp.data());
+      memcpy(buf, tmp.data(), bytes);
+    }
+  }
+
+  void ExpectSameAsStaged(struct cras_fused_output* stages, bool ramping) {
+    std::vector<int16_t> fused = input_;
+    std::vector<int16_t> staged = input_;
+    int fused_non_empty = -1;
+    int staged_non_empty = -1;
+
+    stages->is_non_empty = &fused_non_empty;
+    stages->ewma = &fused_ewma_;
+    EXPECT_EQ(stages->remix_mtx ? 4u : 3u,
+              cras_fused_output_num_stages(stages));
+    cras_fused_output_apply_s16(stages, fused.data(), kNumChannels,
+                                kNumFrames);
+    RunStaged(stages, ramping, staged.data(), &staged_non_empty);
+
+    EXPECT_EQ(staged_non_empty, fused_non_empty);
+    EXPECT_FLOAT_EQ(staged_ewma_.power, fused_ewma_.power);
+    for (size_t i = 0; i < fused.size(); i++) {
+      ASSERT_EQ(staged[i], fused[i]) << "sample " << i;
+    }
+  }
+
+  std::vector<int16_t> input_;
+  float mtx_[kNumChannels][kNumChannels];
+  float* mtx_rows_[kNumChannels];
+  struct ewma_power fused_ewma_;
+  struct ewma_power staged_ewma_;
+};
+
+TEST_F(FusedOutputTest, NoStages) {
+  struct cras_fused_output stages = {};
+  std::vector<int16_t> buf = input_;
+
+  EXPECT_EQ(0u, cras_fused_output_num_stages(&stages));
+  cras_fused_output_apply_s16(&stages, buf.data(), kNumChannels, kNumFrames);
+  EXPECT_EQ(input_, buf);
+}
+
+TEST_F(FusedOutputTest, DisabledEwmaIsNotAStage) {
+  struct cras_fused_output stages = {};
+
+  ewma_power_disable(&fused_ewma_);
+  stages.ewma = &fused_ewma_;
+  EXPECT_EQ(0u, cras_fused_output_num_stages(&stages));
+}
+
+TEST_F(FusedOutputTest, SoftwareVolume) {
+  struct cras_fused_output stages = {};
+
+  stages.scale = 1;
+  stages.scaler = 0.435f;
+  stages.target = 0.435f;
+  ExpectSameAsStaged(&stages, false);
+}
+
+TEST_F(FusedOutputTest, SoftwareVolumeAndRemix) {
+  struct cras_fused_output stages = {};
+
+  stages.scale = 1;
+  stages.scaler = 0.6f;
+  stages.target = 0.6f;
+  stages.remix_mtx = mtx_rows_;
+  ExpectSameAsStaged(&stages, false);
+}
+
+TEST_F(FusedOutputTest, Mute) {
+  struct cras_fused_output stages = {};
+  std::vector<int16_t> zeros(input_.size(), 0);
+
+  stages.scale = 1;
+  stages.remix_mtx = mtx_rows_;
+  ExpectSameAsStaged(&stages, false);
+
+  std::vector<int16_t> buf = input_;
+  cras_fused_output_apply_s16(&stages, buf.data(), kNumChannels, kNumFrames);
+  EXPECT_EQ(zeros, buf);
+}
+
+TEST_F(FusedOutputTest, RampUp) {
+  struct cras_fused_output stages = {};
+
+  stages.scale = 1;
+  stages.scaler = 0.1f;
+  stages.increment = 0.003f;
+  stages.target = 0.8f;
+  stages.remix_mtx = mtx_rows_;
+  ExpectSameAsStaged(&stages, true);
+}
+
+TEST_F(FusedOutputTest, RampDown) {
+  struct cras_fused_output stages = {};
+
+  stages.scale = 1;
+  stages.scaler = 0.9f;
+  stages.increment = -0.004f;
+  stages.target = 0.0f;
+  ExpectSameAsStaged(&stages, true);
+}
+
+TEST_F(FusedOutputTest, RampDownFromSilence) {
+  struct cras_fused_output stages = {};
+
+  stages.scale = 1;
+  stages.scaler = 0.0f;
+  stages.increment = -0.001f;
+  stages.target = 0.5f;
+  ExpectSameAsStaged(&stages, true);
+}
+
+TEST_F(FusedOutputTest, SilentInput) {
+  struct cras_fused_output stages = {};
+  int is_non_empty = -1;
+
+  std::fill(input_.begin(), input_.end(), 0);
+  stages.scale = 1;
+  stages.scaler = 0.5f;
+  stages.target = 0.5f;
+  ExpectSameAsStaged(&stages, false);
+
+  stages.is_non_empty = &is_non_empty;
+  cras_fused_output_apply_s16(&stages, input_.data(), kNumChannels,
+                              kNumFrames);
+  EXPECT_EQ(0, is_non_empty);
+}
+
+}  // namespace
@@ -285,6 +285,9 @@ void cras_bt_device_notify_profile_dropped(
 void cras_sco_set_wbs_logger(struct cras_sco* sco,
                              struct packet_status_logger* wbs_logger) {}
 
+void cras_sco_set_io_stats(struct cras_sco* sco,
+                           struct cras_sco_io_stats* io_stats) {}
+
 void cras_observer_notify_bt_battery_changed(const char* address,
                                              uint32_t level) {
   return;
@@ -111,6 +111,8 @@ static struct cras_iodev fake_sco_in_dev, fake_sco_out_dev;
 static struct cras_ionode fake_sco_in_node, fake_sco_out_node;
 static int server_state_hotword_pause_at_suspend;
 static int cras_system_get_max_internal_mic_gain_return;
+static int cras_system_get_audio_thread_workers_return;
+static unsigned int audio_thread_add_workers_num;
 static int cras_stream_apm_set_aec_ref_called;
 static int cras_stream_apm_remove_called;
 static int cras_stream_apm_add_called;
@@ -267,6 +269,8 @@ class IodevTests : public TestBase {
     mock_hotword_iodev.update_active_node = update_active_node;
     server_state_hotword_pause_at_suspend = 0;
     cras_system_get_max_internal_mic_gain_return = DEFAULT_MAX_INPUT_NODE_GAIN;
+    cras_system_get_audio_thread_workers_return = 0;
+    audio_thread_add_workers_num = 0;
     cras_floop_pair_create_return = NULL;
   }
   void SetUp() override {
@@ -344,6 +348,13 @@ TEST_F(IoDevTestSuite, InitSetup) {
   }
 }
 
+TEST_F(IoDevTestSuite, InitStartsAudioWorkers) {
+  cras_system_get_audio_thread_workers_return = 2;
+  cras_iodev_list_init();
+  EXPECT_EQ(2, audio_thread_add_workers_num);
+  cras_iodev_list_deinit();
+}
+
 /* Check that the suspend alert from cras_system will trigger suspend
  * and resume call of all iodevs. */
 TEST_F(IoDevTestSuite, SetSuspendResume) {
@@ -3306,6 +3317,12 @@ int audio_thread_start(struct audio_thread* thread) {
   return 0;
 }
 
+int audio_thread_add_workers(struct audio_thread* thread,
+                             unsigned int num_workers) {
+  audio_thread_add_workers_num = num_workers;
+  return 0;
+}
+
 void audio_thread_destroy(struct audio_thread* thread) {}
 
 int audio_thread_set_active_dev(struct audio_thread* thread,
@@ -3379,6 +3396,23 @@ int audio_thread_disconnect_stream(struct audio_thread* thread,
   return 0;
 }
 
+int audio_thread_add_stream_async(struct audio_thread* thread,
+                                  struct cras_rstream* stream,
+                                  struct cras_iodev** devs,
+                                  unsigned int num_devs,
+                                  audio_thread_done_cb cb,
+                                  void* cb_data) {
+  return audio_thread_add_stream(thread, stream, devs, num_devs);
+}
+
+int audio_thread_disconnect_stream_async(struct audio_thread* thread,
+                                         struct cras_rstream* stream,
+                                         struct cras_iodev* iodev,
+                                         audio_thread_done_cb cb,
+                                         void* cb_data) {
+  return audio_thread_disconnect_stream(thread, stream, iodev);
+}
+
 int audio_thread_drain_stream(struct audio_thread* thread,
                               struct cras_rstream* stream) {
   audio_thread_drain_stream_called++;
@@ -3659,6 +3693,10 @@ int cras_system_get_max_internal_mic_gain() {
   return cras_system_get_max_internal_mic_gain_return;
 }
 
+int cras_system_get_audio_thread_workers() {
+  return cras_system_get_audio_thread_workers_return;
+}
+
 void cras_hats_trigger_general_survey(enum CRAS_STREAM_TYPE stream_type,
                                       enum CRAS_CLIENT_TYPE client_type,
                                       const char* node_type_pair) {}
@@ -1003,6 +1003,39 @@ TEST(IoDevPutOutputBuffer, NoSoftVolWithRamp) {
   EXPECT_EQ(n_frames, rate_estimator_add_frames_num_frames);
 }
 
+TEST(IoDevPutOutputBuffer, SoftVolFusedWithNonEmptyCheck) {
+  struct cras_audio_format fmt;
+  struct cras_iodev iodev;
+  int16_t frames[8] = {0, 0, 1000, -1000, 2000, -2000, 0, 0};
+  int is_non_empty = 0;
+  int rc;
+
+  ResetStubData();
+  memset(&iodev, 0, sizeof(iodev));
+  iodev.software_volume_needed = 1;
+
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  fmt.frame_rate = 48000;
+  fmt.num_channels = 2;
+  iodev.format = &fmt;
+  iodev.put_buffer = put_buffer;
+
+  cras_system_get_volume_return = 13;
+  softvol_scalers[13] = 0.5;
+
+  rc = cras_iodev_put_output_buffer(&iodev, (uint8_t*)frames, 4,
+                                    &is_non_empty, nullptr);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, is_non_empty);
+  // Zero detection and volume share one pass, no separate scale call.
+  EXPECT_EQ(0, cras_scale_buffer_called);
+  EXPECT_EQ(500, frames[2]);
+  EXPECT_EQ(-500, frames[3]);
+  EXPECT_EQ(1000, frames[4]);
+  EXPECT_EQ(-1000, frames[5]);
+  EXPECT_EQ(4, put_buffer_nframes);
+}
+
 TEST(IoDevPutOutputBuffer, Scale32Bit) {
   struct cras_audio_format fmt;
   struct cras_iodev iodev;
@@ -2645,6 +2678,11 @@ void cras_channel_remix_convert(struct cras_fmt_conv* conv,
                                 uint8_t* in_buf,
                                 size_t frames) {}
 
+float** cras_channel_remix_matrix(const struct cras_fmt_conv* conv,
+                                  const struct cras_audio_format* fmt) {
+  return NULL;
+}
+
 size_t cras_fmt_conv_in_frames_to_out(struct cras_fmt_conv* conv,
                                       size_t in_frames) {
   return in_frames;
@@ -2731,6 +2769,23 @@ void cras_dsp_put_pipeline(struct cras_dsp_context* ctx) {
   cras_dsp_put_pipeline_called++;
 }
 
+void cras_dsp_synchronize(struct cras_dsp_context* ctx) {}
+
+int cras_dsp_apply(struct cras_dsp_context* ctx,
+                   uint8_t* buf,
+                   snd_pcm_format_t format,
+                   unsigned int frames) {
+  struct pipeline* pipeline = cras_dsp_get_pipeline(ctx);
+  int rc;
+
+  if (!pipeline) {
+    return 0;
+  }
+  rc = cras_dsp_pipeline_apply(pipeline, buf, format, frames);
+  cras_dsp_put_pipeline(ctx);
+  return rc;
+}
+
 float* cras_dsp_pipeline_get_source_buffer(struct pipeline* pipeline,
                                            int index) {
   cras_dsp_pipeline_get_source_buffer_called++;
@@ -3025,6 +3080,17 @@ void ewma_power_calculate_area(struct ewma_power* ewma,
                                struct cras_audio_area* area,
                                unsigned int size){};
 
+void ewma_power_add_frame(struct ewma_power* ewma,
+                          const int16_t* frame,
+                          unsigned int channels) {}
+
+// From fmt_conv_ops
+int16_t s16_multiply_buf_with_coef(float* coef,
+                                   const int16_t* buf,
+                                   size_t size) {
+  return 0;
+}
+
 int clock_gettime(clockid_t clk_id, struct timespec* tp) {
   *tp = time_now;
   return 0;
@@ -7,7 +7,11 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <random>
+#include <vector>
+
 extern "C" {
+#include "cras/src/server/cras_mix.h"
 #include "cras/src/server/linear_resampler.h"
 }
 
@@ -188,29 +192,216 @@ TEST(LinearResampler, ResampleIntegerNoDstBuffer) {
   linear_resampler_destroy(lr);
 }
 
-extern "C" {
+TEST(LinearResampler, ResampleFloatMatchesS16) {
+  int i, rc_s16, rc_f32;
+  unsigned int count_s16, count_f32;
+  struct linear_resampler* lr_s16;
+  struct linear_resampler* lr_f32;
+  static float in_f32[200];
+  static float out_f32[200];
+
+  memset(in_buf, 0, BUF_SIZE);
+  memset(out_buf, 0, BUF_SIZE);
+  for (i = 0; i < 100; i++) {
+    *((int16_t*)(in_buf + i * 4)) = i * 10;
+    *((int16_t*)(in_buf + i * 4 + 2)) = i * 20;
+    in_f32[i * 2] = i * 10;
+    in_f32[i * 2 + 1] = i * 20;
+  }
+
+  // Rate 10 -> 11
+  lr_s16 = linear_resampler_create(2, 4, 10, 11);
+  lr_f32 = linear_resampler_create_with_format(2, SND_PCM_FORMAT_FLOAT_LE, 10,
+                                               11);
+  ASSERT_NE((void*)NULL, lr_f32);
+
+  count_s16 = count_f32 = 50;
+  rc_s16 = linear_resampler_resample(lr_s16, in_buf, &count_s16, out_buf, 50);
+  rc_f32 = linear_resampler_resample(lr_f32, (uint8_t*)in_f32, &count_f32,
+                                     (uint8_t*)out_f32, 50);
+  EXPECT_EQ(rc_s16, rc_f32);
+  EXPECT_EQ(count_s16, count_f32);
+
+  // S16 truncates toward zero, float keeps the fraction.
+  for (i = 0; i < rc_f32 * 2; i++) {
+    EXPECT_EQ(*(int16_t*)(out_buf + 2 * i), (int16_t)out_f32[i]);
+  }
+  linear_resampler_destroy(lr_s16);
+  linear_resampler_destroy(lr_f32);
+}
+
+TEST(LinearResampler, ResampleS32) {
+  int i, rc_s16, rc_s32;
+  unsigned int count_s16, count_s32;
+  struct linear_resampler* lr_s16;
+  struct linear_resampler* lr_s32;
+  static int32_t in_s32[100];
+  static int32_t out_s32[200];
+
+  memset(in_buf, 0, BUF_SIZE);
+  for (i = 0; i < 100; i++) {
+    *((int16_t*)(in_buf + i * 2)) = i * 100;
+    in_s32[i] = INT_MIN + i * 20000000;
+  }
 
-void cras_mix_add_scale_stride(int fmt,
-                               uint8_t* dst,
-                               uint8_t* src,
-                               unsigned int count,
-                               unsigned int dst_stride,
-                               unsigned int src_stride,
-                               float scaler) {
-  unsigned int i;
-
-  for (i = 0; i < count; i++) {
-    int32_t sum;
-    sum = *(int16_t*)dst + *(int16_t*)src * scaler;
-    if (sum > INT16_MAX) {
-      sum = INT16_MAX;
-    } else if (sum < INT16_MIN) {
-      sum = INT16_MIN;
+  // Rate 10 -> 11
+  lr_s16 = linear_resampler_create(1, 2, 10, 11);
+  lr_s32 =
+      linear_resampler_create_with_format(1, SND_PCM_FORMAT_S32_LE, 10, 11);
+  ASSERT_NE((void*)NULL, lr_s32);
+
+  count_s16 = count_s32 = 90;
+  rc_s16 = linear_resampler_resample(lr_s16, in_buf, &count_s16, out_buf, 95);
+  rc_s32 = linear_resampler_resample(lr_s32, (uint8_t*)in_s32, &count_s32,
+                                     (uint8_t*)out_s32, 95);
+  // Frame accounting doesn't depend on the sample format.
+  EXPECT_EQ(rc_s16, rc_s32);
+  EXPECT_EQ(count_s16, count_s32);
+
+  // Output keeps increasing without wrapping around.
+  EXPECT_EQ(INT_MIN, out_s32[0]);
+  for (i = 1; i < rc_s32; i++) {
+    EXPECT_LT(out_s32[i - 1], out_s32[i]);
+  }
+
+  linear_resampler_destroy(lr_s16);
+  linear_resampler_destroy(lr_s32);
+}
+
+TEST(LinearResampler, ChannelKernelsAgree) {
+  const unsigned int kMaxChannels = 5;
+  static float in_f32[100 * kMaxChannels];
+  static float out_f32[120 * kMaxChannels];
+  static float expected[120];
+  unsigned int ch, i, count;
+  int rc, expected_rc = 0;
+
+  // Mono, stereo and N channel kernels interpolate channel 0 the same.
+  for (ch = 1; ch <= kMaxChannels; ch++) {
+    struct linear_resampler* lr = linear_resampler_create_with_format(
+        ch, SND_PCM_FORMAT_FLOAT_LE, 44100, 48000);
+
+    for (i = 0; i < 100 * ch; i++) {
+      in_f32[i] = (i % ch) ? -1.0f : (float)(i / ch) * 0.01f;
+    }
+    count = 100;
+    rc = linear_resampler_resample(lr, (uint8_t*)in_f32, &count,
+                                   (uint8_t*)out_f32, 120);
+    if (ch == 1) {
+      expected_rc = rc;
+      memcpy(expected, out_f32, sizeof(expected));
     }
-    *(int16_t*)dst = sum;
-    dst += dst_stride;
-    src += src_stride;
+    ASSERT_EQ(expected_rc, rc);
+    for (i = 0; i < (unsigned int)rc; i++) {
+      EXPECT_EQ(expected[i], out_f32[i * ch]) << ch << " channels";
+      if (ch > 1) {
+        EXPECT_EQ(-1.0f, out_f32[i * ch + 1]) << ch << " channels";
+      }
+    }
+    linear_resampler_destroy(lr);
+  }
+}
+
+/* Resamples random samples with the kernels picked for GetParam() and checks
+ * they match the portable C kernels bit for bit. Variants the running CPU
+ * lacks are skipped. */
+class LinearResamplerVariantTest : public testing::TestWithParam<unsigned int> {
+ protected:
+  virtual void SetUp() {
+    if (GetParam() && !(cpu_get_flags() & GetParam())) {
+      GTEST_SKIP() << "Variant not supported by this CPU";
+    }
+  }
+
+  virtual void TearDown() { linear_resampler_init_with_flags(0); }
+
+  // Resamples in in blocks of block frames, returns all output frames.
+  template <typename T>
+  std::vector<T> Resample(unsigned int cpu_flags,
+                          snd_pcm_format_t format,
+                          unsigned int channels,
+                          float from,
+                          float to,
+                          const std::vector<T>& in,
+                          unsigned int block) {
+    struct linear_resampler* lr =
+        linear_resampler_create_with_format(channels, format, from, to);
+    std::vector<T> out(in.size() * 4);
+    unsigned int in_frames = in.size() / channels;
+    unsigned int read = 0, written = 0;
+
+    linear_resampler_init_with_flags(cpu_flags);
+    while (read < in_frames) {
+      unsigned int count = std::min(block, in_frames - read);
+
+      written += linear_resampler_resample(
+          lr, (uint8_t*)&in[read * channels], &count,
+          (uint8_t*)&out[written * channels], block * 4);
+      read += count;
+    }
+    out.resize(written * channels);
+    linear_resampler_destroy(lr);
+    return out;
+  }
+
+  template <typename T>
+  void CheckMatchesC(snd_pcm_format_t format, std::vector<T> in) {
+    static const unsigned int kChannels[] = {1, 2, 3, 6, 8};
+    static const float kRates[][2] = {
+        {44100, 48000}, {48000, 44100}, {48000, 48001}, {16000, 48000}};
+
+    for (unsigned int channels : kChannels) {
+      for (auto& rates : kRates) {
+        std::vector<T> samples(in.begin(),
+                               in.begin() + in.size() / channels * channels);
+        std::vector<T> expected =
+            Resample(0, format, channels, rates[0], rates[1], samples, 257);
+        std::vector<T> out = Resample(GetParam(), format, channels, rates[0],
+                                      rates[1], samples, 257);
+
+        ASSERT_EQ(expected.size(), out.size());
+        for (size_t i = 0; i < out.size(); i++) {
+          ASSERT_EQ(expected[i], out[i])
+              << channels << " channels, " << rates[0] << " to " << rates[1]
+              << ", sample " << i;
+        }
+      }
+    }
+  }
+
+  std::mt19937 engine_;
+};
+
+TEST_P(LinearResamplerVariantTest, S16) {
+  std::uniform_int_distribution<int16_t> dist(INT16_MIN, INT16_MAX);
+  std::vector<int16_t> in(6 * 1000);
+
+  for (auto& s : in) {
+    s = dist(engine_);
+  }
+  CheckMatchesC(SND_PCM_FORMAT_S16_LE, in);
+}
+
+TEST_P(LinearResamplerVariantTest, S32) {
+  std::uniform_int_distribution<int32_t> dist(INT32_MIN, INT32_MAX);
+  std::vector<int32_t> in(6 * 1000);
+
+  for (auto& s : in) {
+    s = dist(engine_);
+  }
+  CheckMatchesC(SND_PCM_FORMAT_S32_LE, in);
+}
+
+TEST_P(LinearResamplerVariantTest, Float) {
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> in(6 * 1000);
+
+  for (auto& s : in) {
+    s = dist(engine_);
   }
+  CheckMatchesC(SND_PCM_FORMAT_FLOAT_LE, in);
 }
 
-}  //  extern "C"
+INSTANTIATE_TEST_SUITE_P(LinearResampler,
+                         LinearResamplerVariantTest,
+                         testing::Values(0, CPU_X86_AVX2, CPU_ARM_NEON));
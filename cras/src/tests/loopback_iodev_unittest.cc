@@ -225,6 +225,46 @@ TEST_F(LoopBackTestSuite, SimpleLoopback) {
   EXPECT_EQ(0, loop_in_->close_dev(loop_in_));
 }
 
+TEST_F(LoopBackTestSuite, LoopbackWrapsAround) {
+  cras_audio_area* area;
+  unsigned int nread;
+  struct cras_iodev iodev;
+  struct dev_stream stream;
+
+  iodev.streams = &stream;
+  enabled_dev = &iodev;
+
+  loop_in_->configure_dev(loop_in_);
+  ASSERT_NE(reinterpret_cast<void*>(NULL), loop_hook);
+
+  // Move the read position close to the end of the ring.
+  EXPECT_EQ(6000, loop_hook(buf_, 6000, &fmt_, loop_in_));
+  nread = 6000;
+  loop_in_->get_buffer(loop_in_, &area, &nread);
+  EXPECT_EQ(6000, nread);
+  loop_in_->put_buffer(loop_in_, nread);
+
+  // Only the free part of the ring is written.
+  EXPECT_EQ(8192, loop_hook(buf_, kBufferFrames, &fmt_, loop_in_));
+  EXPECT_EQ(0, loop_hook(buf_, 1, &fmt_, loop_in_));
+
+  // Frames are read up to the end of the ring, then from its start.
+  nread = kBufferFrames;
+  loop_in_->get_buffer(loop_in_, &area, &nread);
+  EXPECT_EQ(2192, nread);
+  EXPECT_EQ(0, memcmp(area->channels[0].buf, buf_, nread * kFrameBytes));
+  loop_in_->put_buffer(loop_in_, nread);
+
+  nread = kBufferFrames;
+  loop_in_->get_buffer(loop_in_, &area, &nread);
+  EXPECT_EQ(6000, nread);
+  EXPECT_EQ(0, memcmp(area->channels[0].buf, buf_ + 2192 * kFrameBytes,
+                      nread * kFrameBytes));
+  loop_in_->put_buffer(loop_in_, nread);
+
+  EXPECT_EQ(0, loop_in_->close_dev(loop_in_));
+}
+
 // TODO(chinyue): Test closing last iodev while streaming loopback data.
 
 // Stubs
@@ -4,6 +4,10 @@
 
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
 
 extern "C" {
 #include "cras/src/server/cras_mix.h"
@@ -1302,6 +1306,144 @@ TEST_F(MixTestSuiteS24_3LE, StrideCopy) {
   TestScaleStride(0.1);
 }
 
+// Runs every op of the mixer variant picked for GetParam() and checks it
+// against the portable C implementation. Variants the running CPU lacks
+// fall back to the C implementation and trivially pass.
+class MixOpsVariantTest : public testing::TestWithParam<unsigned int> {
+ protected:
+  virtual void TearDown() { cras_mix_init(); }
+
+  static int32_t Sample(snd_pcm_format_t fmt, const uint8_t* buf, size_t i) {
+    int32_t v = 0;
+
+    switch (fmt) {
+      case SND_PCM_FORMAT_S16_LE:
+        return ((const int16_t*)buf)[i];
+      case SND_PCM_FORMAT_S24_LE:
+        return ((const int32_t*)buf)[i] << 8 >> 8;
+      case SND_PCM_FORMAT_S32_LE:
+        return ((const int32_t*)buf)[i];
+      case SND_PCM_FORMAT_S24_3LE:
+        memcpy((uint8_t*)&v + 1, buf + 3 * i, 3);
+        return v >> 8;
+      default:
+        return 0;
+    }
+  }
+
+  std::vector<uint8_t> RandomBuffer(snd_pcm_format_t fmt) {
+    size_t width = snd_pcm_format_physical_width(fmt) / 8;
+    std::vector<uint8_t> buf(kNumSamples * width);
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    for (auto& b : buf) {
+      b = dist(engine_);
+    }
+    if (fmt == SND_PCM_FORMAT_S24_LE) {
+      // Keep the padding byte a sign extension of the sample.
+      for (size_t i = 0; i < kNumSamples; i++) {
+        ((int32_t*)buf.data())[i] = Sample(fmt, buf.data(), i);
+      }
+    }
+    return buf;
+  }
+
+  // Runs op on copies of dst and src, once with the C implementation and
+  // once with the variant under test, and compares the results.
+  template <typename Op>
+  void Compare(snd_pcm_format_t fmt, Op op) {
+    std::vector<uint8_t> src = RandomBuffer(fmt);
+    std::vector<uint8_t> dst = RandomBuffer(fmt);
+    std::vector<uint8_t> expected = dst;
+    std::vector<uint8_t> actual = dst;
+
+    cras_mix_init_with_flags(0);
+    op(fmt, expected.data(), src.data());
+    cras_mix_init_with_flags(GetParam());
+    op(fmt, actual.data(), src.data());
+
+    // Allow the vectorized float math to round differently. S32 samples
+    // are wider than the float mantissa, so allow a couple of float ulps
+    // at full scale there.
+    int64_t tolerance = fmt == SND_PCM_FORMAT_S32_LE ? 512 : 1;
+
+    for (size_t i = 0; i < kNumSamples; i++) {
+      int64_t e = Sample(fmt, expected.data(), i);
+      int64_t a = Sample(fmt, actual.data(), i);
+      ASSERT_LE(llabs(e - a), tolerance) << "format " << fmt << " sample " << i;
+    }
+  }
+
+  std::mt19937 engine_{1234};
+};
+
+static const snd_pcm_format_t kVariantFormats[] = {
+    SND_PCM_FORMAT_S16_LE,
+    SND_PCM_FORMAT_S24_LE,
+    SND_PCM_FORMAT_S32_LE,
+    SND_PCM_FORMAT_S24_3LE,
+};
+
+TEST_P(MixOpsVariantTest, ScaleBuffer) {
+  for (auto fmt : kVariantFormats) {
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      cras_scale_buffer(fmt, dst, kNumSamples, 0.37);
+    });
+  }
+}
+
+TEST_P(MixOpsVariantTest, ScaleBufferIncrement) {
+  for (auto fmt : kVariantFormats) {
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      cras_scale_buffer_increment(fmt, dst, kBufferFrames, 0.1, 0.0001, 0.9,
+                                  kNumChannels);
+    });
+  }
+}
+
+TEST_P(MixOpsVariantTest, MixAdd) {
+  for (auto fmt : kVariantFormats) {
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      cras_mix_add(fmt, dst, src, kNumSamples, 0, 0, 0.7);
+    });
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      cras_mix_add(fmt, dst, src, kNumSamples, 1, 0, 0.7);
+    });
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      cras_mix_add(fmt, dst, src, kNumSamples, 1, 0, 1.0);
+    });
+  }
+}
+
+TEST_P(MixOpsVariantTest, MixAddScaleStride) {
+  for (auto fmt : kVariantFormats) {
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      unsigned int width = snd_pcm_format_physical_width(fmt) / 8;
+      cras_mix_add_scale_stride(fmt, dst, src, kBufferFrames,
+                                width * kNumChannels, width * kNumChannels,
+                                0.6);
+    });
+  }
+}
+
+TEST_P(MixOpsVariantTest, MuteBuffer) {
+  for (auto fmt : kVariantFormats) {
+    Compare(fmt, [](snd_pcm_format_t fmt, uint8_t* dst, uint8_t* src) {
+      unsigned int width = snd_pcm_format_physical_width(fmt) / 8;
+      cras_mix_mute_buffer(dst, width * kNumChannels, kBufferFrames);
+    });
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(MixOps,
+                         MixOpsVariantTest,
+                         testing::Values(CPU_X86_SSE4_2,
+                                         CPU_X86_AVX,
+                                         CPU_X86_AVX2,
+                                         CPU_X86_FMA,
+                                         CPU_ARM_NEON,
+                                         CPU_ARM_NEON | CPU_ARM_SVE));
+
 // Stubs
 extern "C" {}  // extern "C"
 
@@ -0,0 +1,72 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include <random>
+#include <vector>
+
+extern "C" {
+// Private to cras_plc.c.
+int pattern_match(int16_t* hist);
+}
+
+namespace {
+
+// PLC_WL + MSBC_FS - 1 samples of history, the last PLC_TL of them are the
+// template.
+const int kHistLen = 256 + 120 - 1;
+const int kTemplateLen = 64;
+const int kTemplateStart = kHistLen - kTemplateLen;
+
+static std::vector<int16_t> random_history(int seed) {
+  std::mt19937 engine(seed);
+  std::uniform_int_distribution<int> dist(-20000, 20000);
+  std::vector<int16_t> hist(kHistLen);
+
+  for (auto& x : hist) {
+    x = dist(engine);
+  }
+  return hist;
+}
+
+TEST(PlcTest, FindsRepeatedTemplate) {
+  for (int lag : {0, 37, 100, 255}) {
+    std::vector<int16_t> hist = random_history(lag);
+    for (int i = 0; i < kTemplateLen; i++) {
+      hist[lag + i] = hist[kTemplateStart + i];
+    }
+    EXPECT_EQ(lag, pattern_match(hist.data()));
+  }
+}
+
+TEST(PlcTest, IgnoresInvertedTemplate) {
+  std::vector<int16_t> hist = random_history(1);
+  for (int i = 0; i < kTemplateLen; i++) {
+    hist[20 + i] = -hist[kTemplateStart + i];
+    hist[150 + i] = hist[kTemplateStart + i] / 2;
+  }
+  EXPECT_EQ(150, pattern_match(hist.data()));
+}
+
+TEST(PlcTest, SilentTemplate) {
+  std::vector<int16_t> hist = random_history(2);
+  for (int i = kTemplateStart; i < kHistLen; i++) {
+    hist[i] = 0;
+  }
+  EXPECT_EQ(0, pattern_match(hist.data()));
+}
+
+// Products of full scale negative samples are the largest there are.
+TEST(PlcTest, ClippedSamples) {
+  std::vector<int16_t> hist = random_history(3);
+  for (int i = 0; i < kTemplateLen; i++) {
+    hist[30 + i] = INT16_MIN;
+    hist[kTemplateStart + i] = INT16_MIN;
+  }
+  EXPECT_EQ(30, pattern_match(hist.data()));
+}
+
+}  // namespace
@@ -4,6 +4,7 @@
 
 #include <fcntl.h>
 #include <gtest/gtest.h>
+#include <poll.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
@@ -383,6 +384,108 @@ TEST_F(RstreamTestSuite, InputStreamFlushMessages) {
   cras_rstream_destroy(s);
 }
 
+TEST_F(RstreamTestSuite, OutputStreamEventfdWakeups) {
+  struct cras_rstream* s;
+  struct pollfd pollfd;
+  int notify_fd, reply_fd;
+  uint64_t event;
+  struct timespec ts;
+  int rc;
+
+  config_.flags = EVENTFD_WAKEUPS;
+  rc = cras_rstream_create(&config_, &s);
+  ASSERT_EQ(0, rc);
+  ASSERT_EQ(0, cras_rstream_get_wakeup_fds(s, &notify_fd, &reply_fd));
+  EXPECT_EQ(reply_fd, cras_rstream_get_audio_fd(s));
+
+  // Request data, the frames go to shm and nothing to the audio socket.
+  rc = cras_rstream_request_audio(s, &ts);
+  EXPECT_GT(rc, 0);
+  EXPECT_EQ(1, cras_rstream_is_pending_reply(s));
+  EXPECT_EQ(config_.cb_threshold, cras_shm_get_wakeup_frames(s->shm));
+  EXPECT_EQ(sizeof(event), read(notify_fd, &event, sizeof(event)));
+  EXPECT_EQ(1, event);
+  pollfd.fd = client_fd_;
+  pollfd.events = POLLIN;
+  EXPECT_EQ(0, poll(&pollfd, 1, 0));
+
+  // Client signals the reply eventfd that data is ready.
+  event = 1;
+  EXPECT_EQ(sizeof(event), write(reply_fd, &event, sizeof(event)));
+  cras_rstream_flush_old_audio_messages(s);
+  EXPECT_EQ(0, cras_rstream_is_pending_reply(s));
+
+  cras_rstream_destroy(s);
+}
+
+TEST_F(RstreamTestSuite, InputStreamEventfdReplyError) {
+  struct cras_rstream* s;
+  int notify_fd, reply_fd;
+  uint64_t event = 1;
+  int rc;
+
+  config_.direction = CRAS_STREAM_INPUT;
+  config_.flags = EVENTFD_WAKEUPS;
+  rc = cras_rstream_create(&config_, &s);
+  ASSERT_EQ(0, rc);
+  ASSERT_EQ(0, cras_rstream_get_wakeup_fds(s, &notify_fd, &reply_fd));
+
+  rc = cras_rstream_audio_ready(s, 10);
+  EXPECT_GT(rc, 0);
+  EXPECT_EQ(10, cras_shm_get_wakeup_frames(s->shm));
+  EXPECT_EQ(1, cras_rstream_is_pending_reply(s));
+
+  // An error reply still completes the pending callback.
+  cras_shm_set_reply_error(s->shm, -EPIPE);
+  EXPECT_EQ(sizeof(event), write(reply_fd, &event, sizeof(event)));
+  cras_rstream_flush_old_audio_messages(s);
+  EXPECT_EQ(0, cras_rstream_is_pending_reply(s));
+
+  cras_rstream_destroy(s);
+}
+
+TEST_F(RstreamTestSuite, OutputStreamShmRing) {
+  struct cras_rstream* s;
+  struct audio_message msg;
+  struct timespec ts;
+  int rc;
+
+  config_.flags = SHM_RING_BUFFER;
+  rc = cras_rstream_create(&config_, &s);
+  ASSERT_EQ(0, rc);
+
+  // 4096 buffer frames fit exactly in a ring of 4096.
+  EXPECT_EQ(4096, s->shm->header->ring_frames);
+  EXPECT_TRUE(cras_shm_is_ring(s->shm));
+  EXPECT_EQ(4096 * 4, cras_rstream_get_samples_shm_size(s));
+
+  // The request asks for the room left in the ring, not cb_threshold.
+  s->shm->header->ring_write_frames = 1000;
+  rc = cras_rstream_request_audio(s, &ts);
+  EXPECT_GT(rc, 0);
+  EXPECT_EQ(sizeof(msg), read(client_fd_, &msg, sizeof(msg)));
+  EXPECT_EQ(AUDIO_MESSAGE_REQUEST_DATA, msg.id);
+  EXPECT_EQ(3096, msg.frames);
+
+  cras_rstream_destroy(s);
+}
+
+TEST_F(RstreamTestSuite, InputStreamKeepsDoubleBuffer) {
+  struct cras_rstream* s;
+  int rc;
+
+  config_.direction = CRAS_STREAM_INPUT;
+  config_.flags = SHM_RING_BUFFER;
+  rc = cras_rstream_create(&config_, &s);
+  ASSERT_EQ(0, rc);
+
+  EXPECT_EQ(0, s->shm->header->ring_frames);
+  EXPECT_FALSE(cras_shm_is_ring(s->shm));
+  EXPECT_EQ(2 * 4096 * 4, cras_rstream_get_samples_shm_size(s));
+
+  cras_rstream_destroy(s);
+}
+
 TEST_F(RstreamTestSuite, UpdateOutputReadPtr) {
   struct cras_rstream* s;
   uint8_t* buf;
@@ -0,0 +1,297 @@
+// Copyright 2024 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "cras/src/dsp/sample_conv.h"
+#include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras/src/server/cras_mix.h"
+#include "cras_types.h"
+}
+
+namespace {
+
+static const size_t kFrames = 1031;
+static const snd_pcm_format_t kFormats[] = {
+    SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S24_LE, SND_PCM_FORMAT_S24_3LE,
+    SND_PCM_FORMAT_S32_LE};
+static const size_t kChannels[] = {1, 2, 3, 4, 6, 8};
+
+// Largest float below 2^31, what a float sample of 1.0 saturates to.
+static const float kMaxS32 = 2147483520.0f;
+
+static float ReferenceLoad(snd_pcm_format_t format,
+                           const uint8_t* in,
+                           size_t i) {
+  int32_t sample = 0;
+
+  switch (format) {
+    case SND_PCM_FORMAT_S16_LE:
+      return ((const int16_t*)in)[i] / 32768.0f;
+    case SND_PCM_FORMAT_S24_LE:
+      return (int32_t)((uint32_t)((const int32_t*)in)[i] << 8) /
+             2147483648.0f;
+    case SND_PCM_FORMAT_S24_3LE:
+      memcpy((uint8_t*)&sample + 1, in + 3 * i, 3);
+      return sample / 2147483648.0f;
+    default:
+      return ((const int32_t*)in)[i] / 2147483648.0f;
+  }
+}
+
+static void ReferenceStore(snd_pcm_format_t format,
+                           uint8_t* out,
+                           size_t i,
+                           float f) {
+  int32_t tmp;
+
+  if (format == SND_PCM_FORMAT_S16_LE) {
+    f *= 32768.0f;
+    f += (f >= 0) ? 0.5f : -0.5f;
+    ((int16_t*)out)[i] = std::max(-32768.0f, std::min(32767.0f, f));
+    return;
+  }
+
+  f *= 2147483648.0f;
+  f += (f >= 0) ? 0.5f : -0.5f;
+  tmp = std::max(-2147483648.0f, std::min(kMaxS32, f));
+  switch (format) {
+    case SND_PCM_FORMAT_S24_LE:
+      ((int32_t*)out)[i] = (tmp >> 8) & 0x00ffffff;
+      break;
+    case SND_PCM_FORMAT_S24_3LE:
+      tmp >>= 8;
+      memcpy(out + 3 * i, &tmp, 3);
+      break;
+    default:
+      ((int32_t*)out)[i] = tmp;
+      break;
+  }
+}
+
+/* Runs the kernels of the variant picked for GetParam() against the
+ * convert_* functions and scalar (de)interleave loops. Variants the running
+ * CPU lacks are skipped, flags 0 checks the portable C kernels. */
+class SampleConvVariantTest : public testing::TestWithParam<unsigned int> {
+ protected:
+  virtual void SetUp() {
+    if (GetParam() && !(cpu_get_flags() & GetParam())) {
+      GTEST_SKIP() << "Variant not supported by this CPU";
+    }
+    cras_sample_conv_init_with_flags(GetParam());
+    ops_ = cras_sample_conv_get_ops();
+  }
+
+  virtual void TearDown() { cras_sample_conv_init_with_flags(0); }
+
+  std::vector<uint8_t> RandomBytes(size_t size) {
+    std::vector<uint8_t> buf(size);
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    for (auto& b : buf) {
+      b = dist(engine_);
+    }
+    return buf;
+  }
+
+  // Samples slightly out of range with both full scale ends included.
+  std::vector<float> RandomFloats(size_t samples) {
+    std::vector<float> buf(samples);
+    std::uniform_real_distribution<float> dist(-1.1, 1.1);
+
+    for (auto& f : buf) {
+      f = dist(engine_);
+    }
+    buf[0] = 1.0f;
+    buf[1] = -1.0f;
+    buf[2] = 0.5f / 32768.0f;
+    buf[3] = -0.5f / 32768.0f;
+    return buf;
+  }
+
+  const struct cras_sample_conv_ops* ops_;
+  std::mt19937 engine_{1234};
+};
+
+TEST_P(SampleConvVariantTest, IntegerConverters) {
+  typedef void (*conv_func)(const uint8_t*, size_t, uint8_t*);
+  // {reference, variant, input bytes per sample, output bytes per sample}
+  const struct {
+    conv_func expected;
+    conv_func actual;
+    size_t in_bytes, out_bytes;
+  } kConverters[] = {
+      {convert_u8_to_s16le, ops_->u8_to_s16le, 1, 2},
+      {convert_s243le_to_s16le, ops_->s243le_to_s16le, 3, 2},
+      {convert_s24le_to_s16le, ops_->s24le_to_s16le, 4, 2},
+      {convert_s32le_to_s16le, ops_->s32le_to_s16le, 4, 2},
+      {convert_s16le_to_u8, ops_->s16le_to_u8, 2, 1},
+      {convert_s16le_to_s243le, ops_->s16le_to_s243le, 2, 3},
+      {convert_s16le_to_s24le, ops_->s16le_to_s24le, 2, 4},
+      {convert_s16le_to_s32le, ops_->s16le_to_s32le, 2, 4},
+      {convert_u8_to_f32le, ops_->u8_to_f32le, 1, 4},
+      {(conv_func)convert_s16le_to_f32le, ops_->s16le_to_f32le, 2, 4},
+      {convert_s243le_to_f32le, ops_->s243le_to_f32le, 3, 4},
+      {convert_s24le_to_f32le, ops_->s24le_to_f32le, 4, 4},
+      {convert_s32le_to_f32le, ops_->s32le_to_f32le, 4, 4},
+  };
+
+  for (auto& c : kConverters) {
+    std::vector<uint8_t> in = RandomBytes(kFrames * c.in_bytes);
+    std::vector<uint8_t> expected(kFrames * c.out_bytes, 0xfb);
+    std::vector<uint8_t> actual(kFrames * c.out_bytes, 0xfb);
+
+    c.expected(in.data(), kFrames, expected.data());
+    c.actual(in.data(), kFrames, actual.data());
+    EXPECT_EQ(expected, actual) << "in bytes " << c.in_bytes << " out bytes "
+                                << c.out_bytes;
+  }
+}
+
+TEST_P(SampleConvVariantTest, FloatConverters) {
+  typedef void (*conv_func)(const uint8_t*, size_t, uint8_t*);
+  const struct {
+    conv_func expected;
+    conv_func actual;
+    size_t out_bytes;
+  } kConverters[] = {
+      {convert_f32le_to_u8, ops_->f32le_to_u8, 1},
+      {(conv_func)convert_f32le_to_s16le, ops_->f32le_to_s16le, 2},
+      {convert_f32le_to_s243le, ops_->f32le_to_s243le, 3},
+      {convert_f32le_to_s24le, ops_->f32le_to_s24le, 4},
+      {convert_f32le_to_s32le, ops_->f32le_to_s32le, 4},
+  };
+  std::vector<float> in = RandomFloats(kFrames);
+
+  for (auto& c : kConverters) {
+    std::vector<uint8_t> expected(kFrames * c.out_bytes, 0xfb);
+    std::vector<uint8_t> actual(kFrames * c.out_bytes, 0xfb);
+
+    c.expected((uint8_t*)in.data(), kFrames, expected.data());
+    c.actual((uint8_t*)in.data(), kFrames, actual.data());
+    EXPECT_EQ(expected, actual) << "out bytes " << c.out_bytes;
+  }
+}
+
+TEST_P(SampleConvVariantTest, Deinterleave) {
+  for (auto format : kFormats) {
+    for (auto channels : kChannels) {
+      size_t samples = kFrames * channels;
+      std::vector<uint8_t> in =
+          RandomBytes(samples * snd_pcm_format_physical_width(format) / 8);
+      std::vector<std::vector<float>> out(channels,
+                                          std::vector<float>(kFrames + 1));
+      std::vector<float*> planes;
+
+      for (auto& p : out) {
+        p[kFrames] = 42.0f;
+        planes.push_back(p.data());
+      }
+      ASSERT_EQ(0, ops_->deinterleave(format, in.data(), planes.data(),
+                                      channels, kFrames));
+      for (size_t c = 0; c < channels; c++) {
+        for (size_t i = 0; i < kFrames; i++) {
+          ASSERT_EQ(ReferenceLoad(format, in.data(), i * channels + c),
+                    out[c][i])
+              << "format " << format << " channels " << channels;
+        }
+        EXPECT_EQ(42.0f, out[c][kFrames]);
+      }
+    }
+  }
+}
+
+TEST_P(SampleConvVariantTest, Interleave) {
+  for (auto format : kFormats) {
+    for (auto channels : kChannels) {
+      size_t bytes =
+          kFrames * channels * snd_pcm_format_physical_width(format) / 8;
+      std::vector<std::vector<float>> in;
+      std::vector<float*> planes;
+      std::vector<uint8_t> expected(bytes + 1, 0xfb);
+      std::vector<uint8_t> actual(bytes + 1, 0xfb);
+
+      for (size_t c = 0; c < channels; c++) {
+        in.push_back(RandomFloats(kFrames));
+        planes.push_back(in[c].data());
+        for (size_t i = 0; i < kFrames; i++) {
+          ReferenceStore(format, expected.data(), i * channels + c, in[c][i]);
+        }
+      }
+      ASSERT_EQ(0, ops_->interleave(format, planes.data(), actual.data(),
+                                    channels, kFrames));
+      EXPECT_EQ(expected, actual)
+          << "format " << format << " channels " << channels;
+    }
+  }
+}
+
+TEST_P(SampleConvVariantTest, InterleaveSaturates) {
+  float max[] = {1.0f, 1.5f, 1e10f};
+  float min[] = {-1.0f, -1.5f, -1e10f};
+  float* planes[] = {max, min};
+  int16_t s16[6];
+  int32_t s32[6];
+
+  ASSERT_EQ(0, ops_->interleave(SND_PCM_FORMAT_S16_LE, planes, (uint8_t*)s16,
+                                2, 3));
+  ASSERT_EQ(0, ops_->interleave(SND_PCM_FORMAT_S32_LE, planes, (uint8_t*)s32,
+                                2, 3));
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(INT16_MAX, s16[2 * i]);
+    EXPECT_EQ(INT16_MIN, s16[2 * i + 1]);
+    EXPECT_EQ((int32_t)kMaxS32, s32[2 * i]);
+    EXPECT_EQ(INT32_MIN, s32[2 * i + 1]);
+  }
+}
+
+TEST_P(SampleConvVariantTest, NanIsSilence) {
+  float nan[] = {NAN, -NAN, NAN, -NAN};
+  float* planes[] = {nan};
+  int16_t s16[4];
+  int32_t s32[4];
+  uint8_t u8[4];
+
+  ops_->f32le_to_s16le((uint8_t*)nan, 4, (uint8_t*)s16);
+  ops_->f32le_to_s32le((uint8_t*)nan, 4, (uint8_t*)s32);
+  ops_->f32le_to_u8((uint8_t*)nan, 4, u8);
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(0, s16[i]);
+    EXPECT_EQ(0, s32[i]);
+    EXPECT_EQ(0x80, u8[i]);
+  }
+
+  ASSERT_EQ(0, ops_->interleave(SND_PCM_FORMAT_S16_LE, planes, (uint8_t*)s16,
+                                1, 4));
+  ASSERT_EQ(0, ops_->interleave(SND_PCM_FORMAT_S32_LE, planes, (uint8_t*)s32,
+                                1, 4));
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(0, s16[i]);
+    EXPECT_EQ(0, s32[i]);
+  }
+}
+
+TEST_P(SampleConvVariantTest, InvalidFormat) {
+  float plane[4] = {};
+  float* planes[] = {plane};
+  uint8_t buf[16] = {};
+
+  EXPECT_EQ(-EINVAL, ops_->deinterleave(SND_PCM_FORMAT_U8, buf, planes, 1, 4));
+  EXPECT_EQ(-EINVAL,
+            ops_->interleave(SND_PCM_FORMAT_FLOAT_LE, planes, buf, 1, 4));
+}
+
+INSTANTIATE_TEST_SUITE_P(SampleConv,
+                         SampleConvVariantTest,
+                         testing::Values(0, CPU_X86_AVX2, CPU_ARM_NEON));
+
+}  //  namespace
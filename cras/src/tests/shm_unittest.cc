@@ -565,4 +565,93 @@ TEST_F(ShmTestSuite, GetCheckedWriteOffset) {
   }
 }
 
+// Sets up the 2048 bytes of samples as a ring of 512 frames, 500 deep.
+class ShmRingTestSuite : public ShmTestSuite {
+ protected:
+  virtual void SetUp() {
+    ShmTestSuite::SetUp();
+    cras_shm_set_used_size(&shm_, 500 * 4);
+    cras_shm_set_ring_frames(&shm_, 512);
+  }
+};
+
+TEST_F(ShmRingTestSuite, QueueMoreThanTwoCallbacks) {
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(shm_.samples + i * 100 * 4,
+              cras_shm_get_write_buffer_base(&shm_));
+    cras_shm_buffer_written_start(&shm_, 100);
+  }
+
+  EXPECT_EQ(400, cras_shm_get_frames(&shm_));
+  EXPECT_EQ(100, cras_shm_get_num_writeable(&shm_));
+  EXPECT_TRUE(cras_shm_is_buffer_available(&shm_));
+  buf_ = cras_shm_get_readable_frames(&shm_, 150, &frames_);
+  EXPECT_EQ(shm_.samples + 150 * 4, buf_);
+  EXPECT_EQ(250, frames_);
+
+  cras_shm_buffer_written_start(&shm_, 100);
+  EXPECT_EQ(0, cras_shm_get_num_writeable(&shm_));
+  EXPECT_FALSE(cras_shm_is_buffer_available(&shm_));
+}
+
+TEST_F(ShmRingTestSuite, ReadAcrossWrap) {
+  shm_.header->ring_read_frames = 1000;
+  shm_.header->ring_write_frames = 1000;
+  EXPECT_EQ(24, cras_shm_ring_frames_to_wrap(&shm_));
+  cras_shm_buffer_written_start(&shm_, 100);
+
+  // 1000 % 512 is 488, 24 frames before the end of the ring.
+  buf_ = cras_shm_get_readable_frames(&shm_, 0, &frames_);
+  EXPECT_EQ(shm_.samples + 488 * 4, buf_);
+  EXPECT_EQ(24, frames_);
+  buf_ = cras_shm_get_readable_frames(&shm_, 24, &frames_);
+  EXPECT_EQ(shm_.samples, buf_);
+  EXPECT_EQ(76, frames_);
+  buf_ = cras_shm_get_readable_frames(&shm_, 100, &frames_);
+  EXPECT_EQ(NULL, buf_);
+  EXPECT_EQ(0, frames_);
+
+  cras_shm_buffer_read(&shm_, 100);
+  EXPECT_EQ(1100, shm_.header->ring_read_frames);
+  EXPECT_EQ(0, cras_shm_get_frames(&shm_));
+}
+
+TEST_F(ShmRingTestSuite, InvalidCounters) {
+  // A writer running ahead of the reader can't make more than the ring
+  // readable, and reads can't pass the writer.
+  shm_.header->ring_write_frames = 100000;
+  EXPECT_EQ(512, cras_shm_get_frames(&shm_));
+  buf_ = cras_shm_get_readable_frames(&shm_, 0, &frames_);
+  EXPECT_EQ(512, frames_);
+
+  shm_.header->ring_write_frames = 10;
+  cras_shm_buffer_read(&shm_, 100);
+  EXPECT_EQ(10, shm_.header->ring_read_frames);
+
+  // Writer behind the reader reads as empty.
+  shm_.header->ring_write_frames = 5;
+  EXPECT_EQ(0, cras_shm_get_frames(&shm_));
+}
+
+TEST_F(ShmTestSuite, CopySharedRingConfig) {
+  shm_.header->ring_frames = 512;
+  cras_shm_copy_shared_config(&shm_);
+  EXPECT_EQ(512, shm_.ring_frames);
+
+  // Not a power of 2.
+  shm_.header->ring_frames = 500;
+  cras_shm_copy_shared_config(&shm_);
+  EXPECT_EQ(0, shm_.ring_frames);
+
+  // Larger than the samples area.
+  shm_.header->ring_frames = 1024;
+  cras_shm_copy_shared_config(&shm_);
+  EXPECT_EQ(0, shm_.ring_frames);
+
+  // Header from a server without ring support.
+  shm_.header->ring_frames = 0;
+  cras_shm_copy_shared_config(&shm_);
+  EXPECT_FALSE(cras_shm_is_ring(&shm_));
+}
+
 }  //  namespace
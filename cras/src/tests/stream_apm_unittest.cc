@@ -38,6 +38,7 @@ static dictionary* webrtc_apm_create_apm_ini_val = NULL;
 static bool cras_apm_reverse_is_aec_use_case_ret;
 static int cras_apm_reverse_state_update_called;
 static int cras_apm_reverse_link_echo_ref_called;
+static process_reverse_t process_cb_value;
 static process_reverse_needed_t process_needed_cb_value;
 static thread_callback thread_cb;
 static void* cb_data;
@@ -470,6 +471,43 @@ TEST(ApmList, NeedsReverseProcessing) {
   cras_stream_apm_deinit();
 }
 
+TEST(ApmList, ProcessReverseFollowsStartStop) {
+  struct cras_audio_format fmt;
+  struct float_buffer* fbuf;
+
+  fmt.num_channels = 2;
+  fmt.frame_rate = 48000;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+
+  cras_stream_apm_init("");
+  fbuf = float_buffer_create(480, 2);
+  float_buffer_written(fbuf, 480);
+  webrtc_apm_process_reverse_stream_f_called = 0;
+
+  stream = cras_stream_apm_create(APM_ECHO_CANCELLATION);
+  EXPECT_NE((void*)NULL, stream);
+  cras_stream_apm_add(stream, idev, &fmt);
+
+  // Only started APMs process the reverse stream.
+  EXPECT_EQ(0, process_cb_value(fbuf, 48000, NULL));
+  EXPECT_EQ(0, webrtc_apm_process_reverse_stream_f_called);
+
+  cras_stream_apm_start(stream, idev);
+  EXPECT_NE((void*)NULL, cras_stream_apm_get_active(stream, idev));
+  EXPECT_EQ(0, process_cb_value(fbuf, 48000, NULL));
+  EXPECT_EQ(1, webrtc_apm_process_reverse_stream_f_called);
+
+  cras_stream_apm_stop(stream, idev);
+  EXPECT_EQ((void*)NULL, cras_stream_apm_get_active(stream, idev));
+  EXPECT_EQ(0, process_cb_value(fbuf, 48000, NULL));
+  EXPECT_EQ(1, webrtc_apm_process_reverse_stream_f_called);
+
+  cras_stream_apm_remove(stream, idev);
+  cras_stream_apm_destroy(stream);
+  float_buffer_destroy(&fbuf);
+  cras_stream_apm_deinit();
+}
+
 TEST(StreamApm, DSPEffectsNotSupportedShouldNotCallIodevOps) {
   struct cras_audio_format fmt;
   struct cras_apm* apm1;
@@ -828,6 +866,7 @@ int webrtc_apm_get_voice_detected(webrtc_apm ptr) {
 int cras_apm_reverse_init(process_reverse_t process_cb,
                           process_reverse_needed_t process_needed_cb,
                           output_devices_changed_t output_devices_changed_cb) {
+  process_cb_value = process_cb;
   process_needed_cb_value = process_needed_cb;
   output_devices_changed_callback = output_devices_changed_cb;
   return 0;
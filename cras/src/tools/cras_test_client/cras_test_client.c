@@ -951,7 +951,8 @@ static void show_alog_tag(const struct audio_thread_event_log* log,
              data1 * 1000 + data2 / 1000000, data3);
       break;
     case AUDIO_THREAD_A2DP_WRITE:
-      printf("%-30s written:%u queued:%u\n", "A2DP_WRITE", data1, data2);
+      printf("%-30s written:%d queued:%u sock:%u%%\n", "A2DP_WRITE",
+             (int)data1, data2, data3);
       break;
     case AUDIO_THREAD_DEV_STREAM_MIX:
       printf("%-30s written:%u read:%u\n", "DEV_STREAM_MIX", data1, data2);
@@ -1050,6 +1051,10 @@ static void show_alog_tag(const struct audio_thread_event_log* log,
     case AUDIO_THREAD_DEV_OVERRUN:
       printf("%-30s dev:%u hw_level:%u\n", "DEV_OVERRUN", data1, data2);
       break;
+    case AUDIO_THREAD_A2DP_FLOW_CTRL:
+      printf("%-30s bitpool:%u level:%u packets write_block:%u\n",
+             "A2DP_FLOW_CTRL", data1, data2, data3);
+      break;
     default:
       printf("%-30s tag:%u\n", "UNKNOWN", tag);
       break;
@@ -1454,6 +1459,18 @@ static void show_btlog_tag(const struct cras_bt_event_log* log,
     case BT_TRANSPORT_RELEASE:
       printf("%-30s\n", "TRANSPORT_RELEASE");
       break;
+    case BT_A2DP_ENCODER_QUEUE:
+      printf("%-30s max %u avg %u frames\n", "A2DP_ENCODER_QUEUE", data1,
+             data2);
+      break;
+    case BT_A2DP_ENCODER_UNDERRUN:
+      printf("%-30s underruns %u late writes %u\n", "A2DP_ENCODER_UNDERRUN",
+             data1, data2);
+      break;
+    case BT_A2DP_FLOW_CTRL:
+      printf("%-30s lowest bitpool %u highest level %u packets\n",
+             "A2DP_FLOW_CTRL", data1, data2);
+      break;
     default:
       printf("%-30s\n", "UNKNOWN");
       break;
@@ -1483,6 +1500,7 @@ static void cras_bt_debug_info(struct cras_client* client) {
   int i, j;
   struct timespec ts;
   struct packet_status_logger wbs_logger;
+  const struct cras_sco_io_stats* sco_io_stats;
 
   info = cras_client_get_bt_debug_info(client);
   fill_time_offset(&sec_offset, &nsec_offset);
@@ -1514,6 +1532,25 @@ static void cras_bt_debug_info(struct cras_client* client) {
   printf("In binary format:\n");
   packet_status_logger_dump_binary(&wbs_logger);
 
+  printf("-------------SCO socket I/O-------------\n");
+  sco_io_stats = cras_client_get_sco_io_stats(client);
+  printf("Wake ups: %u\n", sco_io_stats->wakeups);
+  printf("Read: %u packets, %u erroneous, %u recvmmsg calls\n",
+         sco_io_stats->packets_read, sco_io_stats->packets_erroneous,
+         sco_io_stats->recv_calls);
+  printf("Written: %u packets, %u sendmmsg calls\n",
+         sco_io_stats->packets_written, sco_io_stats->send_calls);
+  printf("Packets per read batch:");
+  for (i = 0; i < CRAS_SCO_MAX_BATCH; i++) {
+    printf(" %d:%u", i + 1, sco_io_stats->read_batches[i]);
+  }
+  printf("\n");
+  if (sco_io_stats->num_read_delays) {
+    printf("Read delay: max %u us, average %" PRIu64 " us\n",
+           sco_io_stats->max_read_delay_us,
+           sco_io_stats->sum_read_delay_us / sco_io_stats->num_read_delays);
+  }
+
   // Signal main thread we are done after the last chunk.
   signal_done();
 }
@@ -1539,6 +1576,64 @@ static void main_thread_debug_info(struct cras_client* client) {
   signal_done();
 }
 
+static void dsp_debug_info(struct cras_client* client) {
+  const struct cras_dsp_debug_info* info;
+  unsigned int i, j;
+  int k;
+
+  info = cras_client_get_dsp_debug_info(client);
+  printf("DSP profile:\n");
+  for (i = 0; i < info->num_pipelines; i++) {
+    const struct dsp_pipeline_debug_info* p = &info->pipelines[i];
+
+    printf("Pipeline %u (%s): rate %u, channels %u -> %u\n", i, p->purpose,
+           p->sample_rate, p->input_channels, p->output_channels);
+    printf("  blocks %" PRIu64 ", samples %" PRIu64 "\n", p->blocks,
+           p->samples);
+    if (p->blocks) {
+      printf("  time per block: avg %" PRIu64 "ns, min %" PRIu64
+             "ns, max %" PRIu64 "ns\n",
+             p->total_ns / p->blocks, p->min_ns, p->max_ns);
+    }
+    for (j = 0; j < p->num_modules; j++) {
+      const struct dsp_module_debug_info* m = &p->modules[j];
+
+      printf("  [%u] %s (%s)%s\n", j, m->title, m->label,
+             m->run ? "" : " not run");
+      if (!m->blocks) {
+        continue;
+      }
+      printf("    blocks %" PRIu64 ", samples %" PRIu64 "\n", m->blocks,
+             m->samples);
+      printf("    time per block: avg %" PRIu64 "ns, max %" PRIu64 "ns\n",
+             m->total_ns / m->blocks, m->max_ns);
+      if (m->samples && p->sample_rate) {
+        printf("    cpu load: %.3f%%\n",
+               m->total_ns * 1e-9 / m->samples * p->sample_rate * 100);
+      }
+      printf("    denormals %" PRIu64 ", nans %" PRIu64 "\n", m->denormals,
+             m->nans);
+      printf("    time histogram:\n");
+      for (k = 0; k < CRAS_DSP_HISTOGRAM_BUCKETS; k++) {
+        if (!m->histogram[k]) {
+          continue;
+        }
+        if (k == CRAS_DSP_HISTOGRAM_BUCKETS - 1) {
+          printf("      >= %10lluns: %u\n",
+                 1ULL << (CRAS_DSP_HISTOGRAM_MIN_SHIFT + k - 1),
+                 m->histogram[k]);
+        } else {
+          printf("       < %10lluns: %u\n",
+                 1ULL << (CRAS_DSP_HISTOGRAM_MIN_SHIFT + k), m->histogram[k]);
+        }
+      }
+    }
+  }
+
+  // Signal main thread we are done after the last chunk.
+  signal_done();
+}
+
 static void print_cras_audio_thread_snapshot(
     const struct cras_audio_thread_snapshot* snapshot,
     time_t sec_offset,
@@ -2015,6 +2110,14 @@ static void show_main_thread_debug_info(struct cras_client* client) {
   wait_done_timeout(2);
 }
 
+static void show_dsp_debug_info(struct cras_client* client) {
+  cras_client_run_thread(client);
+  cras_client_connected_wait(client);  // To synchronize data.
+  cras_client_update_dsp_debug_info(client, dsp_debug_info);
+
+  wait_done_timeout(2);
+}
+
 static void hotword_models_cb(struct cras_client* client,
                               const char* hotword_models) {
   printf("Hotword models: %s\n", hotword_models);
@@ -2178,6 +2281,8 @@ static struct option long_options[] = {
 	{"dump_main",           no_argument,            0, 'N'},
 	{"set_aec_ref",         required_argument,      0, 'O'},
 	{"playback_file",       required_argument,      0, 'P'},
+	{"dump_dsp_profile",    no_argument,            0, 'Q'},
+	{"set_dsp_control",     required_argument,      0, 'R'},
 	{"stream_type",         required_argument,      0, 'T'},
 	{"print_nodes_inlined", no_argument,            0, 'U'},
 	{"request_floop_mask",  required_argument,      0, 'V'},
@@ -2247,6 +2352,9 @@ static void show_usage() {
   printf(
       "--dump_dsp - "
       "Print status of dsp to syslog.\n");
+  printf(
+      "--dump_dsp_profile - "
+      "Dumps the run time of each dsp module.\n");
   printf(
       "--dump_server_info - "
       "Print status of the server.\n");
@@ -2344,6 +2452,9 @@ static void show_usage() {
   printf(
       "--select_output <N>:<M> - "
       "Select the ionode with the given id as preferred output\n");
+  printf(
+      "--set_dsp_control <title>:<port>:<value> - "
+      "Set the control port of the dsp plugin with the given title\n");
   printf(
       "--set_hotword_model <N>:<M>:<model> - "
       "Set the model to node\n");
@@ -2786,6 +2897,21 @@ int main(int argc, char** argv) {
       case 'P':
         playback_file = optarg;
         break;
+      case 'Q':
+        show_dsp_debug_info(client);
+        break;
+      case 'R': {
+        const char* title = strtok(optarg, ":");
+        const char* port = strtok(NULL, ":");
+        const char* value = strtok(NULL, ":");
+
+        if (!title || !port || !value) {
+          show_usage();
+          return -EINVAL;
+        }
+        cras_client_set_dsp_control(client, title, atoi(port), atof(value));
+        break;
+      }
       case 'T':
         stream_type = atoi(optarg);
         break;